@@ -53,3 +53,59 @@ struct scnhdr {
         _long           s_flags;        /* flags */
       };
  
+
+/* The symbolic header, which f_symptr points to, if the file has a
+ * symbol table.  Only the external symbols are of interest to us: they
+ * are an array of "iextMax" struct extr's at file offset cbExtOffset,
+ * whose names are in the "issExtMax" bytes at cbSsExtOffset.
+ */
+
+#define magicSym	0x7009
+
+typedef struct hdrr {
+        short   magic;          /* magicSym                             */
+        short   vstamp;         /* version stamp                        */
+        _long   ilineMax;       /* line numbers                         */
+        _long   cbLine;
+        _long   cbLineOffset;
+        _long   idnMax;         /* dense numbers                        */
+        _long   cbDnOffset;
+        _long   ipdMax;         /* procedure descriptors                */
+        _long   cbPdOffset;
+        _long   isymMax;        /* local symbols                        */
+        _long   cbSymOffset;
+        _long   ioptMax;        /* optimization symbols                 */
+        _long   cbOptOffset;
+        _long   iauxMax;        /* auxiliary symbols                    */
+        _long   cbAuxOffset;
+        _long   issMax;         /* local strings                        */
+        _long   cbSsOffset;
+        _long   issExtMax;      /* external strings                     */
+        _long   cbSsExtOffset;
+        _long   ifdMax;         /* file descriptors                     */
+        _long   cbFdOffset;
+        _long   crfd;           /* relative file descriptors            */
+        _long   cbRfdOffset;
+        _long   iextMax;        /* external symbols                     */
+        _long   cbExtOffset;
+      } HDRR;
+
+/* An external symbol.  "bits" packs (from the low bit up) the symbol
+ * type (6 bits), its storage class (5), a reserved bit, and an index
+ * (20).
+ */
+
+typedef struct extr {
+        unsigned short  flags;  /* jmptbl, cobol_main, weakext         */
+        short   ifd;            /* the file it is defined in            */
+        _long   iss;            /* its name, in the external strings    */
+        _long   value;          /* its value: for a procedure, where    */
+        unsigned _long  bits;   /* st, sc, reserved, index              */
+      } EXTR;
+
+#define SymbolType(bits)	((bits) & 0x3f)
+#define SymbolClass(bits)	(((bits) >> 6) & 0x1f)
+
+#define stProc          6       /* a procedure                          */
+#define stStaticProc    14      /* a static procedure                   */
+#define scText          1       /* in the text segment                  */
@@ -15,6 +15,15 @@
  *	.data	-- initialized data
  *	.bss/.sbss -- uninitialized data (should be zero'd on program startup)
  *
+ * If the COFF file has a symbol table, the names and addresses of its
+ * procedures are kept, in a symbol table after the segments (see
+ * noff.h), for the profiler.
+ *
+ * With -p, the NOFF file is paged: the segments are laid out in the file
+ * as they are in memory, a page at a time (see noff.h), rather than
+ * packed back to back.  With -z, it is compressed: each of those pages
+ * is compressed on its own.
+ *
  * Copyright (c) 1992-1993 The Regents of the University of California.
  * All rights reserved.  See copyright.h for copyright notice and limitation 
  * of liability and disclaimer of warranty provisions.
@@ -89,17 +98,185 @@ void Write(int fd, char *buf, int nBytes)
     }
 }
 
+/* The code and data, as they are laid out in memory, for -z */
+unsigned char *image = NULL;
+int imageSize = 0;
+
+/* Put "size" bytes of a segment in the image, at "virtualAddr" */
+void SaveInImage(char *buf, int virtualAddr, int size)
+{
+    int end = virtualAddr + size;
+
+    end = ((end + NOFFPAGESIZE - 1) / NOFFPAGESIZE) * NOFFPAGESIZE;
+    if (end > imageSize) {
+	image = realloc(image, end);
+	memset(image + imageSize, 0, end - imageSize);
+	imageSize = end;
+    }
+    memcpy(image + virtualAddr, buf, size);
+}
+
+/* Compress "inSize" bytes at "in" into "out" (which must have room for
+ * inSize + inSize / 8 + 1 bytes), as described in noff.h, and return
+ * how many bytes that took.  Each match is the longest there is.
+ */
+int CompressPage(unsigned char *in, int inSize, unsigned char *out)
+{
+    int i = 0, o = 0, flags = 0, bit = 8;
+
+    while (i < inSize) {
+	int best = 0, bestOffset = 0, j, n;
+
+	if (bit == 8) {		/* start a new group */
+	    flags = o++;
+	    out[flags] = 0;
+	    bit = 0;
+	}
+	for (j = (i > NOFFLZMAXOFFSET) ? i - NOFFLZMAXOFFSET : 0; j < i; j++) {
+	    for (n = 0; (n < NOFFLZMAXMATCH) && (i + n < inSize)
+			&& (in[j + n] == in[i + n]); n++)
+		;
+	    if (n > best) {
+		best = n;
+		bestOffset = i - j;
+	    }
+	}
+	if (best >= NOFFLZMINMATCH) {
+	    out[flags] |= 1 << bit;
+	    out[o++] = bestOffset >> 4;
+	    out[o++] = ((bestOffset & 0xf) << 4) | (best - NOFFLZMINMATCH);
+	    i += best;
+	} else
+	    out[o++] = in[i++];
+	bit++;
+    }
+    return o;
+}
+
+/* Write the image at "inNoffFile", compressed a page at a time, after
+ * its page index; return where it ends.
+ */
+int WriteCompressed(int fdOut, int inNoffFile)
+{
+    NoffPageIndex index;
+    int *offsets, where, p, n;
+    unsigned char out[NOFFPAGESIZE + NOFFPAGESIZE / 8 + 1];
+
+    index.numPages = imageSize / NOFFPAGESIZE;
+    index.pageSize = NOFFPAGESIZE;
+    offsets = (int *) malloc((index.numPages + 1) * sizeof(int));
+    where = inNoffFile + sizeof(index) + (index.numPages + 1) * sizeof(int);
+    lseek(fdOut, where, 0);
+    for (p = 0; p < index.numPages; p++) {
+	offsets[p] = where;
+	n = CompressPage(image + p * NOFFPAGESIZE, NOFFPAGESIZE, out);
+	if (n >= NOFFPAGESIZE)
+	    Write(fdOut, (char *) image + p * NOFFPAGESIZE, n = NOFFPAGESIZE);
+	else
+	    Write(fdOut, (char *) out, n);
+	where += n;
+    }
+    offsets[p] = where;
+    printf("Compressed %d pages (%d bytes) to %d bytes\n", index.numPages,
+	   imageSize, where - offsets[0]);
+    lseek(fdOut, inNoffFile, 0);
+    Write(fdOut, (char *) &index, sizeof(index));
+    Write(fdOut, (char *) offsets, (index.numPages + 1) * sizeof(int));
+    free(offsets);
+    return where;
+}
+
+/* for qsort: order symbols by address */
+int CompareSymbols(const void *a, const void *b)
+{
+    return ((NoffSymbol *) a)->value - ((NoffSymbol *) b)->value;
+}
+
+/* Write a NOFF symbol table at "inNoffFile", with the external
+ * procedures in the text segment, out of the COFF symbolic header at
+ * "symPtr".  If there isn't one we understand, write nothing.
+ */
+void CopySymbols(int fdIn, int fdOut, int symPtr, int inNoffFile)
+{
+    HDRR symh;
+    EXTR *ext;
+    char *strings, *names;
+    NoffSymbolHeader symH;
+    NoffSymbol *symbols;
+    int i, n, length;
+
+    lseek(fdIn, symPtr, 0);
+    ReadStruct(fdIn, symh);
+    if (ShortToHost(symh.magic) != magicSym) {
+	fprintf(stderr, "Unknown symbol table, not copied\n");
+	return;
+    }
+    symh.iextMax = WordToHost(symh.iextMax);
+    symh.cbExtOffset = WordToHost(symh.cbExtOffset);
+    symh.issExtMax = WordToHost(symh.issExtMax);
+    symh.cbSsExtOffset = WordToHost(symh.cbSsExtOffset);
+
+    ext = (EXTR *) malloc(symh.iextMax * sizeof(EXTR));
+    lseek(fdIn, symh.cbExtOffset, 0);
+    Read(fdIn, (char *) ext, symh.iextMax * sizeof(EXTR));
+    strings = malloc(symh.issExtMax + 1);
+    lseek(fdIn, symh.cbSsExtOffset, 0);
+    Read(fdIn, strings, symh.issExtMax);
+    strings[symh.issExtMax] = '\0';
+
+    symbols = (NoffSymbol *) malloc(symh.iextMax * sizeof(NoffSymbol));
+    names = malloc(symh.issExtMax + 1);
+    symH.symMagic = NOFFSYMMAGIC;
+    symH.stringSize = 0;
+    for (i = n = 0; i < symh.iextMax; i++) {
+	unsigned int bits = WordToHost(ext[i].bits);
+	unsigned int iss = WordToHost(ext[i].iss);
+
+	if (((SymbolType(bits) != stProc)
+		&& (SymbolType(bits) != stStaticProc))
+	    || (SymbolClass(bits) != scText) || (iss >= symh.issExtMax))
+	    continue;
+	length = strlen(&strings[iss]) + 1;
+	symbols[n].value = WordToHost(ext[i].value);
+	symbols[n].name = symH.stringSize;
+	strcpy(&names[symH.stringSize], &strings[iss]);
+	symH.stringSize += length;
+	n++;
+    }
+    symH.numSymbols = n;
+    qsort(symbols, n, sizeof(NoffSymbol), CompareSymbols);
+    printf("Keeping %d procedure symbols\n", n);
+
+    lseek(fdOut, inNoffFile, 0);
+    Write(fdOut, (char *) &symH, sizeof(symH));
+    Write(fdOut, (char *) symbols, n * sizeof(NoffSymbol));
+    Write(fdOut, names, symH.stringSize);
+    free(ext);
+    free(strings);
+    free(symbols);
+    free(names);
+}
+
 int main (int argc, char **argv)
 {
     int fdIn, fdOut, numsections, i, inNoffFile;
+    int paged = 0, compressed = 0, imageEnd = 0;
     struct filehdr fileh;
     struct aouthdr systemh;
     struct scnhdr *sections;
     char *buffer;
     NoffHeader noffH;
 
-    if (argc < 2) {
-	fprintf(stderr, "Usage: %s <coffFileName> <noffFileName>\n", argv[0]);
+    for (; (argc > 1) && (argv[1][0] == '-'); argc--, argv++)
+	if (!strcmp(argv[1], "-p"))
+	    paged = 1;
+	else if (!strcmp(argv[1], "-z"))
+	    compressed = 1;
+	else
+	    argc = 0;
+    if (argc < 3) {
+	fprintf(stderr, "Usage: %s [-p | -z] <coffFileName> <noffFileName>\n",
+		argv[0]);
 	exit(1);
     }
     
@@ -152,7 +329,8 @@ int main (int argc, char **argv)
  /* initialize the NOFF header, in case not all the segments are defined
   * in the COFF file
   */
-    noffH.noffMagic = NOFFMAGIC;
+    noffH.noffMagic = compressed ? NOFFLZMAGIC
+			: (paged ? NOFFPAGEDMAGIC : NOFFMAGIC);
     noffH.code.size = 0;
     noffH.initData.size = 0;
     noffH.uninitData.size = 0;
@@ -168,15 +346,24 @@ int main (int argc, char **argv)
 	if (sections[i].s_size == 0) {
 		/* do nothing! */	
 	} else if (!strcmp(sections[i].s_name, ".text")) {
+	    if (paged) {	/* where it is in memory, after the header */
+		inNoffFile = NOFFPAGESIZE + sections[i].s_paddr;
+		lseek(fdOut, inNoffFile, 0);
+	    }
 	    noffH.code.virtualAddr = sections[i].s_paddr;
-	    noffH.code.inFileAddr = inNoffFile;
+	    noffH.code.inFileAddr = compressed ? -1 : inNoffFile;
 	    noffH.code.size = sections[i].s_size;
     	    lseek(fdIn, sections[i].s_scnptr, 0);
     	    buffer = malloc(sections[i].s_size);
     	    Read(fdIn, buffer, sections[i].s_size);
-    	    Write(fdOut, buffer, sections[i].s_size);
+	    if (compressed)
+		SaveInImage(buffer, sections[i].s_paddr, sections[i].s_size);
+	    else
+		Write(fdOut, buffer, sections[i].s_size);
     	    free(buffer);
 	    inNoffFile += sections[i].s_size;
+	    if (inNoffFile > imageEnd)
+		imageEnd = inNoffFile;
  	} else if (!strcmp(sections[i].s_name, ".data")
 	  		|| !strcmp(sections[i].s_name, ".rdata")) {
   	    /* need to check if we have both .data and .rdata 
@@ -186,15 +373,24 @@ int main (int argc, char **argv)
 	        unlink(noffFileName);
 	        exit(1);
 	    }
+	    if (paged) {
+		inNoffFile = NOFFPAGESIZE + sections[i].s_paddr;
+		lseek(fdOut, inNoffFile, 0);
+	    }
 	    noffH.initData.virtualAddr = sections[i].s_paddr;
-	    noffH.initData.inFileAddr = inNoffFile;
+	    noffH.initData.inFileAddr = compressed ? -1 : inNoffFile;
 	    noffH.initData.size = sections[i].s_size;
     	    lseek(fdIn, sections[i].s_scnptr, 0);
     	    buffer = malloc(sections[i].s_size);
     	    Read(fdIn, buffer, sections[i].s_size);
-    	    Write(fdOut, buffer, sections[i].s_size);
+	    if (compressed)
+		SaveInImage(buffer, sections[i].s_paddr, sections[i].s_size);
+	    else
+		Write(fdOut, buffer, sections[i].s_size);
     	    free(buffer);
 	    inNoffFile += sections[i].s_size;
+	    if (inNoffFile > imageEnd)
+		imageEnd = inNoffFile;
 	} else if (!strcmp(sections[i].s_name, ".bss") ||
 			!strcmp(sections[i].s_name, ".sbss")) {
   	    /* need to check if we have both .bss and .sbss -- make sure they 
@@ -219,6 +415,24 @@ int main (int argc, char **argv)
 	    exit(1);
 	}
     }
+    if (paged && (imageEnd % NOFFPAGESIZE != 0)) {
+	/* zero the rest of the last page (a gap between the segments is
+	 * a hole in the file, which reads as zero too) */
+	int pad = NOFFPAGESIZE - imageEnd % NOFFPAGESIZE;
+
+	buffer = calloc(pad, 1);
+	lseek(fdOut, imageEnd, 0);
+	Write(fdOut, buffer, pad);
+	free(buffer);
+	imageEnd += pad;
+    }
+    if (paged)
+	inNoffFile = (imageEnd > 0) ? imageEnd : NOFFPAGESIZE;
+    if (compressed)
+	inNoffFile = WriteCompressed(fdOut, sizeof(NoffHeader));
+    fileh.f_symptr = WordToHost(fileh.f_symptr);
+    if (fileh.f_symptr != 0)
+	CopySymbols(fdIn, fdOut, fileh.f_symptr, inNoffFile);
     lseek(fdOut, 0, 0);
     Write(fdOut, (char *)&noffH, sizeof(NoffHeader));
     close(fdIn);
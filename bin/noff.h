@@ -5,10 +5,65 @@
  *	code (read-only), initialized data, and unitialized data
  */
 
+#ifndef NOFF_H
+#define NOFF_H
+
 #define NOFFMAGIC	0xbadfad 	/* magic number denoting Nachos 
 					 * object code file 
 					 */
 
+/* A paged NOFF file (made by coff2noff -p) has the same header, but
+ * with NOFFPAGEDMAGIC, and its code and initialized data are laid out
+ * in the file just as they are in the address space: every segment's
+ * inFileAddr is its virtualAddr plus the same multiple of
+ * NOFFPAGESIZE (the first page holds the header), any gap between
+ * them is zero, and so is the rest of the last page they use.  Each
+ * page of the program is thus one aligned, page-sized piece of the
+ * file, which the kernel can read (or map) by itself.
+ */
+
+#define NOFFPAGEDMAGIC	0xbadfae	/* magic number denoting a paged
+					 * Nachos object code file
+					 */
+#define NOFFPAGESIZE	128		/* pages in a paged file: the
+					 * machine's PageSize
+					 */
+
+/* A compressed NOFF file (made by coff2noff -z) holds the same pages as
+ * a paged one, but each compressed on its own, so that any page can be
+ * read and decompressed by itself, on a page fault.  Its magic number
+ * is NOFFLZMAGIC.  The segments in its header say where the code and
+ * data go, and how big they are, but not where they are in the file
+ * (inFileAddr is -1): after the header comes a NoffPageIndex, then
+ * "numPages" + 1 ints, the file offset of each compressed page and of
+ * the end of the last one; then the pages; then the symbol table, if
+ * there is one.  Page "p" is virtual page "p", from address 0.
+ *
+ * A compressed page is a sequence of items, in groups of eight, each
+ * group preceded by a flag byte whose bit i (from the low bit) says
+ * whether item i is a literal byte (0) or a match (1).  A match is
+ * two bytes, which hold how far back the bytes to copy start in what
+ * has been decompressed so far (1 to NOFFLZMAXOFFSET), in the high 12
+ * bits, and how many there are, less NOFFLZMINMATCH, in the low 4.
+ * A page that doesn't get smaller is stored as it is (it is then
+ * NOFFPAGESIZE bytes long).
+ */
+
+#define NOFFLZMAGIC	0xbadfaf	/* magic number denoting a
+					 * compressed Nachos object code file
+					 */
+#define NOFFLZMINMATCH	3		/* shortest match worth encoding */
+#define NOFFLZMAXMATCH	(NOFFLZMINMATCH + 15)	/* longest match */
+#define NOFFLZMAXOFFSET	4095		/* furthest back a match can be */
+
+typedef struct noffPageIndex {
+   int numPages;		/* pages of code and data */
+   int pageSize;		/* NOFFPAGESIZE */
+} NoffPageIndex;
+
+#define IsNoffMagic(m)	(((m) == NOFFMAGIC) || ((m) == NOFFPAGEDMAGIC) \
+			 || ((m) == NOFFLZMAGIC))
+
 typedef struct segment {
   int virtualAddr;		/* location of segment in virt addr space */
   int inFileAddr;		/* location of segment in this file */
@@ -23,3 +78,29 @@ typedef struct noffHeader {
 				 * should be zero'ed before use 
 				 */
 } NoffHeader;
+
+/* After the segments, a NOFF file may have a symbol table: the names
+ * and addresses of the procedures in the code, so that the profiler
+ * can say which one each sample was in.  It is a NoffSymbolHeader,
+ * then "numSymbols" NoffSymbol's, sorted by address, then their
+ * names, null-terminated, "stringSize" bytes in all.  Files without
+ * one still load; the profile just has no names in it.
+ */
+
+#define NOFFSYMMAGIC	0xbad5ab	/* magic number denoting a NOFF
+					 * symbol table
+					 */
+
+typedef struct noffSymbolHeader {
+   int symMagic;		/* should be NOFFSYMMAGIC */
+   int numSymbols;		/* procedures listed */
+   int stringSize;		/* bytes of names, after the list */
+} NoffSymbolHeader;
+
+typedef struct noffSymbol {
+   int value;			/* address of the procedure */
+   int name;			/* offset of its name, from the start
+				 * of the names */
+} NoffSymbol;
+
+#endif /* NOFF_H */
@@ -38,6 +38,12 @@ Thread::Thread(const char* threadName)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    level = 0;
+    cpu = -1;
+    affinity = -1;
+    account = stats->NewThread(name);
+    readySince = stats->totalTicks;
+    realTime = NULL;
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -60,6 +66,9 @@ Thread::~Thread()
     DEBUG('t', "Deleting thread \"%s\"\n", name);
 
     ASSERT(this != currentThread);
+    if (realTime != NULL)
+	scheduler->SetRealTime(this, 0, 0, 0);	// give back its load
+    stats->EndThread(account);
     if (stack != NULL)
 		DeallocBoundedArray((char *) stack, StackSize * sizeof(_int));
 }
@@ -240,6 +249,21 @@ Thread::Sleep ()
     scheduler->Run(nextThread); // returns when we've been signalled
 }
 
+//----------------------------------------------------------------------
+// Thread::SleepFor
+// 	Relinquish the CPU until "ticks" of simulated time have passed,
+//	on the alarm clock (see alarm.h), rather than spinning with Yield:
+//	the thread is not on the ready list until its time comes.
+//----------------------------------------------------------------------
+
+void
+Thread::SleepFor(int ticks)
+{
+    ASSERT(this == currentThread);
+    
+    alarmClock->SleepUntil(stats->totalTicks + ticks);
+}
+
 //----------------------------------------------------------------------
 // ThreadFinish, InterruptEnable, ThreadPrint
 //	Dummy functions because C++ does not allow a pointer to a member
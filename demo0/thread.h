@@ -39,6 +39,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "stats.h"
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -63,6 +64,25 @@ enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 // external function, dummy routine whose sole job is to call Thread::Print
 extern void ThreadPrint(_int arg);	 
 
+// The parameters of a real-time thread (see Scheduler::SetRealTime),
+// all in ticks, and where the job it is running is up to.  Each time
+// the thread wakes up, it starts a job that must be done (that is,
+// the thread must block again) "deadline" ticks later, using at most
+// "budget" ticks of CPU; it starts at most one job every "period".
+
+class RealTime {
+  public:
+    int period;			// the least time between job starts
+    int deadline;		// how long after it starts a job is due
+    int budget;			// the CPU time a job may use
+    int load;			// budget / min(deadline, period), per mille
+
+    int jobDeadline;		// when the current job is due
+    int budgetLeft;		// the CPU time it has left
+    int nextRelease;		// the earliest the next job may start
+    bool jobDone;		// is the thread waiting for its next job?
+};
+
 // The following class defines a "thread control block" -- which
 // represents a single thread of execution.
 //
@@ -95,15 +115,35 @@ class Thread {
 						// other thread is runnable
     void Sleep();  				// Put the thread to sleep and 
 						// relinquish the processor
+    void SleepFor(int ticks);			// Sleep until "ticks" of
+						// simulated time have passed
     void Finish();  				// The thread is done executing
     
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
+    ThreadStatus getStatus() { return status; }
+    int getLevel() { return level; }	// feedback queue level (see
+    void setLevel(int l) { level = l; }	// scheduler.h)
+    int getCPU() { return cpu; }	// the CPU it last ran on, or -1
+    void setCPU(int c) { cpu = c; }
+    int getAffinity() { return affinity; }	// the CPUs it may run on,
+    void setAffinity(int mask) { affinity = mask; }	// a bit for each
     char* getName() { return (name); }
     void Print() { printf("%s, ", name); }
     void Println(void);
 
+    Thread *queueNext;			// the next thread on the ThreadQueue
+					// this one is on (see threadqueue.h)
+    int queueKey;			// its key there, if sorted
+
+    ThreadStats *account;		// the CPU time charged to it, etc.
+					// (see Scheduler::Run)
+    int readySince;			// when it was last put on the
+					// ready list
+    RealTime *realTime;			// its real-time parameters, or
+					// NULL if it is not real-time
+
   private:
     // some of the private data for this class is listed above
     
@@ -111,6 +151,10 @@ class Thread {
 					// NULL if this is the main thread
 					// (If NULL, don't deallocate stack)
     ThreadStatus status;		// ready, running or blocked
+    int level;				// its level in the ready queue
+    int cpu;				// the CPU whose queue it is on
+    int affinity;			// bit c set if it may run on CPU c
+					// (all set, to begin with)
     char* name;
 
     void StackAllocate(VoidFunctionPtr func, _int arg);
@@ -11,10 +11,10 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	Once all the entries in the directory are used, it grows by a
+//	sector of entries -- if its file can grow, which the files of
+//	the original file system can't: then no more files can be
+//	created in it.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,6 +24,24 @@
 #include "utility.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "system.h"
+#include "synch.h"
+
+//----------------------------------------------------------------------
+// HashName
+// 	Hash file name "name".  Only the first FileNameMaxLen characters
+//	count, as when names are compared.
+//----------------------------------------------------------------------
+
+static unsigned int
+HashName(char *name)
+{
+    unsigned int hash = 0;
+
+    for (int i = 0; (i < FileNameMaxLen) && (name[i] != '\0'); i++)
+	hash = hash * 31 + (unsigned char) name[i];
+    return hash;
+}
 
 //----------------------------------------------------------------------
 // Directory::Directory
@@ -41,6 +59,9 @@ Directory::Directory(int size)
     tableSize = size;
     for (int i = 0; i < tableSize; i++)
 	table[i].inUse = FALSE;
+    buckets = NULL;
+    chain = NULL;
+    BuildIndex();
 }
 
 //----------------------------------------------------------------------
@@ -51,11 +72,14 @@ Directory::Directory(int size)
 Directory::~Directory()
 { 
     delete [] table;
+    delete [] buckets;
+    delete [] chain;
 } 
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk, and rebuild the
+//	hash index.  The directory has as many entries as the file holds.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,7 +87,15 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
+    int size = file->Length() / sizeof(DirectoryEntry);
+
+    if (size != tableSize) {
+	delete [] table;
+	table = new DirectoryEntry[size];
+	tableSize = size;
+    }
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    BuildIndex();
 }
 
 //----------------------------------------------------------------------
@@ -79,10 +111,57 @@ Directory::WriteBack(OpenFile *file)
     (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
 }
 
+//----------------------------------------------------------------------
+// Directory::BuildIndex
+// 	Set up the hash index over the names of the entries in use, and
+//	the list of free entries (in order, so that names are added at
+//	the front of the table, as they always were).
+//----------------------------------------------------------------------
+
+void
+Directory::BuildIndex()
+{
+    int i;
+
+    delete [] buckets;
+    delete [] chain;
+    for (numBuckets = 1; numBuckets < tableSize; numBuckets <<= 1)
+	;
+    buckets = new int[numBuckets];
+    chain = new int[tableSize + 1];		// at least one
+    for (i = 0; i < numBuckets; i++)
+	buckets[i] = -1;
+    firstFree = -1;
+    for (i = tableSize - 1; i >= 0; i--)
+	if (table[i].inUse) {
+	    int *bucket = Bucket(table[i].name);
+
+	    chain[i] = *bucket;
+	    *bucket = i;
+	} else {
+	    chain[i] = firstFree;
+	    firstFree = i;
+	}
+}
+
+//----------------------------------------------------------------------
+// Directory::Bucket
+// 	Return the head of the hash chain for file name "name".
+//
+//	"name" -- the file name to hash
+//----------------------------------------------------------------------
+
+int *
+Directory::Bucket(char *name)
+{
+    return &buckets[HashName(name) & (numBuckets - 1)];
+}
+
 //----------------------------------------------------------------------
 // Directory::FindIndex
 // 	Look up file name in directory, and return its location in the table of
 //	directory entries.  Return -1 if the name isn't in the directory.
+//	Only the entries on the name's hash chain need to be looked at.
 //
 //	"name" -- the file name to look up
 //----------------------------------------------------------------------
@@ -90,8 +169,8 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+    for (int i = *Bucket(name); i != -1; i = chain[i])
+        if (!strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
     return -1;		// name not in directory
 }
@@ -129,17 +208,125 @@ Directory::Find(char *name)
 bool
 Directory::Add(char *name, int newSector)
 { 
+    int i = firstFree;
+    int *bucket;
+
     if (FindIndex(name) != -1)
 	return FALSE;
+    if (i == -1)
+	return FALSE;	// no space.  Fix when we have extensible files.
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    firstFree = chain[i];
+    table[i].inUse = TRUE;
+    table[i].isDirectory = FALSE;
+    strncpy(table[i].name, name, FileNameMaxLen); 
+    table[i].name[FileNameMaxLen] = '\0';
+    table[i].sector = newSector;
+    bucket = Bucket(table[i].name);
+    chain[i] = *bucket;
+    *bucket = i;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::AddDirectory
+// 	Add the name of a directory into the directory.  Return TRUE if
+//	successful, FALSE as for Add.
+//
+//	"name" -- the name of the directory being added
+//	"newSector" -- the disk sector containing its header
+//----------------------------------------------------------------------
+
+bool
+Directory::AddDirectory(char *name, int newSector)
+{
+    if (!Add(name, newSector))
+	return FALSE;
+    table[FindIndex(name)].isDirectory = TRUE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::IsDirectory
+// 	Return TRUE if "name" is in the directory, and is a directory.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsDirectory(char *name)
+{
+    int i = FindIndex(name);
+
+    return (bool)((i != -1) && table[i].isDirectory);
+}
+
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return TRUE if there are no names in the directory.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsEmpty()
+{
+    for (int i = 0; i < numBuckets; i++)
+	if (buckets[i] != -1)
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Grow
+// 	Add DirectoryGrowth free entries at the end of the directory, and
+//	of "file", the file it is stored in, so that more names can be
+//	added.  The new entries are written to the file at once, along
+//	with its header, so the file has them even if the directory isn't
+//	written back.  Return FALSE if the file can't grow (it has a fixed
+//	size, or the disk is full).
+//
+//	"file" -- file containing the directory contents
+//----------------------------------------------------------------------
+
+bool
+Directory::Grow(OpenFile *file)
+{
+    int size = tableSize + DirectoryGrowth;
+    int length = DirectoryGrowth * sizeof(DirectoryEntry);
+    DirectoryEntry *newTable;
+    int i;
+
+    if (!file->Preallocate(size * sizeof(DirectoryEntry)))
+	return FALSE;
+    newTable = new DirectoryEntry[size];
+    for (i = 0; i < tableSize; i++)
+	newTable[i] = table[i];
+    bzero((char *)&newTable[tableSize], length);	// all free
+    if (file->WriteAt((char *)&newTable[tableSize], length,
+		      tableSize * sizeof(DirectoryEntry)) != length) {
+	delete [] newTable;
+	return FALSE;
+    }
+    file->WriteBack();
+    DEBUG('f', "Directory grown to %d entries\n", size);
+    delete [] table;
+    table = newTable;
+    tableSize = size;
+    BuildIndex();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Entry
+// 	Return where the header of the file in entry "i" is, and set
+//	"name" to its name; or return -1 if entry "i" isn't in use.  For
+//	going through every file in the directory, "i" from 0 to Size().
+//----------------------------------------------------------------------
+
+int
+Directory::Entry(int i, char **name)
+{
+    if ((i < 0) || (i >= tableSize) || !table[i].inUse)
+	return -1;
+    *name = table[i].name;
+    return table[i].sector;
 }
 
 //----------------------------------------------------------------------
@@ -153,17 +340,27 @@ Directory::Add(char *name, int newSector)
 bool
 Directory::Remove(char *name)
 { 
-    int i = FindIndex(name);
+    int *ptr;
 
-    if (i == -1)
+    for (ptr = Bucket(name); *ptr != -1; ptr = &chain[*ptr])
+        if (!strncmp(table[*ptr].name, name, FileNameMaxLen))
+	    break;
+    if (*ptr == -1)
 	return FALSE; 		// name not in directory
+
+    int i = *ptr;
+
+    *ptr = chain[i];		// off its hash chain, onto the free list
     table[i].inUse = FALSE;
+    chain[i] = firstFree;
+    firstFree = i;
     return TRUE;	
 }
 
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory. 
+// 	List all the file names in the directory; the names of
+//	directories are followed by a "/".
 //----------------------------------------------------------------------
 
 void
@@ -171,7 +368,7 @@ Directory::List()
 {
    for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+	    printf("%s%s\n", table[i].name, table[i].isDirectory ? "/" : "");
 }
 
 //----------------------------------------------------------------------
@@ -195,3 +392,225 @@ Directory::Print()
     printf("\n");
     delete hdr;
 }
+
+//----------------------------------------------------------------------
+// DirectoryIterator::DirectoryIterator
+// 	Get ready to go through the directory stored in "dirFile", from the
+//	start.  Nothing is read until Next is called.
+//----------------------------------------------------------------------
+
+DirectoryIterator::DirectoryIterator(OpenFile *dirFile)
+{
+    file = dirFile;
+    position = 0;
+    numEntries = 0;
+    next = 0;
+}
+
+//----------------------------------------------------------------------
+// DirectoryIterator::Next
+// 	Return the next entry of the directory that is in use, reading
+//	the next sector of entries when we have looked at all the last
+//	one held, or NULL at the end of the file.  The entry is only good
+//	until the next call.
+//----------------------------------------------------------------------
+
+DirectoryEntry *
+DirectoryIterator::Next()
+{
+    for (;;) {
+	if (next == numEntries) {
+	    position += numEntries * sizeof(DirectoryEntry);
+	    numEntries = file->ReadAt((char *)entries, sizeof(entries),
+				      position) / sizeof(DirectoryEntry);
+	    next = 0;
+	    if (numEntries == 0)
+		return NULL;		// the end of the directory
+	}
+	if (entries[next++].inUse)
+	    return &entries[next - 1];
+    }
+}
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty dentry cache, able to hold "size" lookups.
+//	All the entries start out unused, on the LRU list.
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache(int size)
+{
+    numEntries = size;
+    entries = new Dentry[numEntries];
+    hashTable = new Dentry *[numEntries];
+    lruFirst = lruLast = NULL;
+    for (int i = 0; i < numEntries; i++) {
+	Dentry *dentry = &entries[i];
+
+	dentry->parent = -1;
+	dentry->hashNext = NULL;
+	hashTable[i] = NULL;
+	dentry->lruPrev = lruLast;
+	dentry->lruNext = NULL;
+	if (lruLast == NULL)
+	    lruFirst = dentry;
+	else
+	    lruLast->lruNext = dentry;
+	lruLast = dentry;
+    }
+    lock = new Lock("dentry cache");
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the dentry cache.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+    delete lock;
+    delete [] hashTable;
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	If the result of looking up "name" in the directory whose header
+//	is at sector "parent" is in the cache, return TRUE, and set
+//	"sector" and "isDirectory" to it (sector is -1 if the name isn't
+//	there).  Otherwise, return FALSE.
+//----------------------------------------------------------------------
+
+bool
+DentryCache::Lookup(int parent, char *name, int *sector, bool *isDirectory)
+{
+    Dentry *dentry;
+
+    lock->Acquire();
+    dentry = Find(parent, name);
+    if (dentry != NULL) {
+	*sector = dentry->sector;
+	*isDirectory = dentry->isDirectory;
+	MoveToFront(dentry);
+	stats->numDentryHits++;
+    } else
+	stats->numDentryMisses++;
+    lock->Release();
+    return (bool)(dentry != NULL);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Enter
+// 	Remember that "name", in the directory whose header is at sector
+//	"parent", is at "sector" (or isn't there, if "sector" is -1).  If
+//	the name is cached already, we just update it; otherwise we take
+//	the least recently used entry.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Enter(int parent, char *name, int sector, bool isDirectory)
+{
+    Dentry *dentry, **bucket;
+
+    lock->Acquire();
+    dentry = Find(parent, name);
+    if (dentry == NULL) {
+	dentry = lruLast;
+	if (dentry->parent != -1)
+	    Unhash(dentry);
+	dentry->parent = parent;
+	strncpy(dentry->name, name, FileNameMaxLen);
+	dentry->name[FileNameMaxLen] = '\0';
+	bucket = Bucket(parent, name);
+	dentry->hashNext = *bucket;
+	*bucket = dentry;
+    }
+    dentry->sector = sector;
+    dentry->isDirectory = isDirectory;
+    MoveToFront(dentry);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Purge
+// 	Forget every lookup in the directory whose header was at sector
+//	"parent"; it has been removed, and the sector may be reused.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Purge(int parent)
+{
+    lock->Acquire();
+    for (int i = 0; i < numEntries; i++)
+	if (entries[i].parent == parent) {
+	    Unhash(&entries[i]);
+	    entries[i].parent = -1;
+	}
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Bucket
+// 	Return the head of the hash chain for "name" in "parent".
+//----------------------------------------------------------------------
+
+Dentry **
+DentryCache::Bucket(int parent, char *name)
+{
+    return &hashTable[(HashName(name) + parent * 31u) % numEntries];
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Find
+// 	Return the entry caching "name" in "parent", or NULL.
+//----------------------------------------------------------------------
+
+Dentry *
+DentryCache::Find(int parent, char *name)
+{
+    Dentry *dentry;
+
+    for (dentry = *Bucket(parent, name); dentry != NULL;
+						dentry = dentry->hashNext)
+	if ((dentry->parent == parent) &&
+			!strncmp(dentry->name, name, FileNameMaxLen))
+	    return dentry;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Unhash
+// 	Take "dentry" (which is in use) off its hash chain.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Unhash(Dentry *dentry)
+{
+    Dentry **ptr;
+
+    for (ptr = Bucket(dentry->parent, dentry->name); *ptr != dentry;
+							ptr = &(*ptr)->hashNext)
+	;
+    *ptr = dentry->hashNext;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::MoveToFront
+// 	Move "dentry" to the front of the LRU list.
+//----------------------------------------------------------------------
+
+void
+DentryCache::MoveToFront(Dentry *dentry)
+{
+    if (dentry == lruFirst)
+	return;
+    dentry->lruPrev->lruNext = dentry->lruNext;	// not first, so has a prev
+    if (dentry->lruNext == NULL)
+	lruLast = dentry->lruPrev;
+    else
+	dentry->lruNext->lruPrev = dentry->lruPrev;
+    dentry->lruPrev = NULL;
+    dentry->lruNext = lruFirst;
+    lruFirst->lruPrev = dentry;
+    lruFirst = dentry;
+}
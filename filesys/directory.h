@@ -6,6 +6,22 @@
 //	where to find its file header (the data structure describing
 //	where to find the file's data blocks) on disk.
 //
+//	An entry can also name another directory, stored as a file just
+//	like the root directory, so directories form a tree.  Walking a
+//	path down the tree would cost reading one directory file per
+//	step, so the file system keeps a "dentry cache" of the names it
+//	has looked up recently -- including the ones it didn't find.
+//
+//	In memory, the directory also has a hash index over the names,
+//	rebuilt whenever it is read in from disk, so that looking a name
+//	up costs the same however big the directory is.  The free
+//	entries are kept on a list too, so adding a name doesn't search.
+//
+//	A directory that is full can grow, a sector of entries at a time,
+//	if its file can (see Grow).  To go through the names without
+//	reading in the whole table, as listing them does, there is a
+//	DirectoryIterator, which reads the file a sector at a time.
+//
 //      We assume mutual exclusion is provided by the caller.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -19,8 +35,15 @@
 
 #include "openfile.h"
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+class Lock;
+
+#define FileNameMaxLen 		23	// for simplicity, we assume 
+					// file names are <= 23 characters
+					// long (so an entry is 32 bytes)
+#define DentryCacheSize		64	// names kept in the dentry cache
+#define DirectoryGrowth		(int)(SectorSize / sizeof(DirectoryEntry))
+					// entries added when a directory
+					// grows: a sector's worth
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -32,6 +55,7 @@
 class DirectoryEntry {
   public:
     bool inUse;				// Is this directory entry in use?
+    bool isDirectory;			// Does it name a directory?
     int sector;				// Location on disk to find the 
 					//   FileHeader for this file 
     char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
@@ -46,7 +70,8 @@ class DirectoryEntry {
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// from/to disk.  The number of entries is taken from the size of
+// the file, when the directory is read in.
 
 class Directory {
   public:
@@ -62,6 +87,17 @@ class Directory {
 					// FileHeader for file: "name"
 
     bool Add(char *name, int newSector);  // Add a file name into the directory
+    bool AddDirectory(char *name, int newSector);
+					// Add the name of a directory
+    bool IsDirectory(char *name);	// Is "name" there, and a directory?
+    bool IsEmpty();			// Is no entry in use?
+    bool IsFull() { return (bool)(firstFree == -1); }
+					// Is every entry in use?
+    bool Grow(OpenFile *file);		// Add DirectoryGrowth free entries,
+					// at the end of "file"
+    int Size() { return tableSize; }	// How many entries there are
+    int Entry(int i, char **name);	// The header sector of entry "i",
+					// and its name; -1 if it is unused
 
     bool Remove(char *name);		// Remove a file from the directory
 
@@ -76,8 +112,93 @@ class Directory {
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
 
+    int numBuckets;			// Size of the hash index (a power
+					// of two, at least tableSize)
+    int *buckets;			// First entry in each hash chain,
+					// or -1
+    int *chain;				// For each entry in use, the next
+					// one in its hash chain; for each
+					// free entry, the next free one
+    int firstFree;			// First free entry, or -1 if full
+
+    void BuildIndex();			// Set up the hash index and the
+					// free list from the table
+    int *Bucket(char *name);		// The hash chain "name" belongs in
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
 };
 
+// The following class goes through the entries in use of the directory
+// stored in a file, reading them in a sector at a time, so that listing
+// a directory, or finding whether it is empty, doesn't read in all of
+// it.  The directory must not change while it is gone through.
+
+class DirectoryIterator {
+  public:
+    DirectoryIterator(OpenFile *file);	// Start at the first entry of the
+					// directory in "file"
+
+    DirectoryEntry *Next();		// The next entry in use, or NULL
+					// once there are no more
+
+  private:
+    OpenFile *file;			// The directory
+    int position;			// Where in it "entries" came from
+    int numEntries;			// How many entries were read there
+    int next;				// The next one to look at
+    DirectoryEntry entries[DirectoryGrowth];
+					// A sector of entries
+};
+
+// The following class defines an entry in the dentry cache: the result
+// of looking up "name" in the directory whose header is at "parent".
+
+class Dentry {
+  public:
+    int parent;				// sector of the directory's header,
+					// -1 if the entry is unused
+    char name[FileNameMaxLen + 1];	// the name looked up in it
+    int sector;				// what we found: the header of the
+					// file, or -1 if there is no such name
+    bool isDirectory;			// is it a directory?
+    Dentry *hashNext;			// the next entry in the same bucket
+    Dentry *lruPrev;			// the entries used just after and
+    Dentry *lruNext;			// just before this one
+};
+
+// The following class defines the dentry cache, a fixed number of
+// recent lookups, found by hashing, and replaced least recently used
+// first.  The file system keeps it up to date as it adds and removes
+// names, so an entry never disagrees with the directory on disk.
+
+class DentryCache {
+  public:
+    DentryCache(int size);		// An empty cache of "size" lookups
+    ~DentryCache();
+
+    bool Lookup(int parent, char *name, int *sector, bool *isDirectory);
+					// If "name" in "parent" is cached,
+					// return TRUE, and what was found
+    void Enter(int parent, char *name, int sector, bool isDirectory);
+					// Remember the result of a lookup
+					// (sector -1 if nothing was found)
+    void Purge(int parent);		// Forget every name in "parent",
+					// because it has been removed
+
+  private:
+    int numEntries;
+    Dentry *entries;
+    Dentry **hashTable;			// the entries in use, one chain
+					// per bucket (numEntries of them)
+    Dentry *lruFirst;			// most recently used
+    Dentry *lruLast;			// least recently used
+    Lock *lock;				// lookups that share the directory
+					// tree still change the cache
+
+    Dentry **Bucket(int parent, char *name);
+    Dentry *Find(int parent, char *name);
+    void Unhash(Dentry *dentry);	// take it off its hash chain
+    void MoveToFront(Dentry *dentry);	// make it most recently used
+};
+
 #endif // DIRECTORY_H
@@ -26,6 +26,7 @@
 
 #include "system.h"
 #include "filehdr.h"
+#include "log.h"
 
 //----------------------------------------------------------------------
 // FileHeader::Allocate
@@ -54,6 +55,8 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
 // 	De-allocate all the space allocated for data blocks for this file.
+//	A sector shared with a clone (cf. FileSystem::Clone) stays: it
+//	just has one file fewer.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -61,9 +64,15 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
+    unsigned char *shares = (fileSystem != NULL) ? fileSystem->GetShares()
+						 : NULL;
+
     for (int i = 0; i < numSectors; i++) {
 	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	freeMap->Clear((int) dataSectors[i]);
+	if ((shares != NULL) && (shares[dataSectors[i]] > 0))
+	    shares[dataSectors[i]]--;	// another file still has it
+	else
+	    freeMap->Clear((int) dataSectors[i]);
     }
 }
 
@@ -120,6 +129,92 @@ FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::MoveSectors
+// 	Move the file's data sectors that are among the "count" from
+//	"first" on to the head of the log, for the cleaner (see
+//	FileSystem::CleanSegments).  Return TRUE if any moved, so that
+//	the header must be written back.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool
+FileHeader::MoveSectors(BitMap *freeMap, int first, int count)
+{
+    Log *log = fileSystem->GetLog();
+    char *data = new char[SectorSize];
+    bool moved = FALSE;
+
+    for (int i = 0; i < numSectors; i++) {
+	int sector = dataSectors[i], newSector;
+
+	if ((sector < first) || (sector >= first + count))
+	    continue;
+	if ((newSector = log->Allocate(freeMap)) == -1)
+	    break;			// the log is full
+	synchDisk->ReadSector(sector, data);
+	synchDisk->WriteSector(newSector, data);
+	freeMap->Clear(sector);
+	dataSectors[i] = newSector;
+	moved = TRUE;
+    }
+    delete [] data;
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Share
+// 	Count one more file as having each of this file's data sectors:
+//	a clone of it, with a copy of this header.  Return FALSE if some
+//	sector is shared by too many already (the counts are then partly
+//	changed, and must be read in again).
+//
+//	"shares" is how many files, besides one, have each sector
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Share(unsigned char *shares)
+{
+    for (int i = 0; i < numSectors; i++) {
+	if (shares[dataSectors[i]] == MaxShares)
+	    return FALSE;
+	shares[dataSectors[i]]++;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Unshare
+// 	Before data block "i" is written: if another file shares its
+//	sector, copy it to a free sector, and make that the block's, so
+//	the other file doesn't see the write.  Return the sector the block
+//	is in now, or -1 if there is no free sector; if it changed, the
+//	header must be written back.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"shares" is how many files, besides one, have each sector
+//----------------------------------------------------------------------
+
+int
+FileHeader::Unshare(BitMap *freeMap, unsigned char *shares, int i)
+{
+    int sector = dataSectors[i], newSector;
+    char *data;
+
+    if (shares[sector] == 0)
+	return sector;			// it is this file's alone
+    if ((newSector = freeMap->Find()) == -1)
+	return -1;
+    data = new char[SectorSize];
+    synchDisk->ReadSector(sector, data);
+    synchDisk->WriteSector(newSector, data);
+    delete [] data;
+    shares[sector]--;
+    dataSectors[i] = newSector;
+    return newSector;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -19,6 +19,7 @@
 
 #define NumDirect 	(int)((SectorSize - 2 * sizeof(int)) / sizeof(int))
 #define MaxFileSize 	(NumDirect * SectorSize)
+#define MaxShares	255	// files sharing a sector, besides one
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
@@ -56,6 +57,17 @@ class FileHeader {
 
     void Print();			// Print the contents of the file.
 
+    bool MoveSectors(BitMap *freeMap, int first, int count);
+					// Move its sectors among these to
+					// the head of the log
+
+    bool CanShare() { return TRUE; }	// Can its sectors be shared with a
+					// clone (cf. FileSystem::Clone)?
+    bool Share(unsigned char *shares);	// Count one more file having each
+    int Unshare(BitMap *freeMap, unsigned char *shares, int i);
+					// Give data block "i" a sector of its
+					// own, if it is shared
+
   private:
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
@@ -12,19 +12,31 @@
 // 	The file system consists of several data structures:
 //	   A bitmap of free disk sectors (cf. bitmap.h)
 //	   A directory of file names and file headers
+//	   A dentry cache of recent lookups (cf. directory.h)
+//	   A journal of the changes to all of these (cf. journal.h)
+//	   On a log-structured disk, an inode map saying where each
+//	    file header is (cf. log.h)
+//	   Once a file has been cloned, a count of the files sharing
+//	    each sector (see Clone)
 //
 //      Both the bitmap and the directory are represented as normal
 //	files.  Their file headers are located in specific sectors
 //	(sector 0 and sector 1), so that the file system can find them 
 //	on bootup.
 //
+//	On a log-structured disk, a directory entry holds a file's inode
+//	number rather than the sector of its header (the bitmap and the
+//	root directory are inodes 0 and 1, at sectors 0 and 1 still), and
+//	a cleaner thread keeps enough of the log clean (see CleanSegments).
+//
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
 //	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
+//	open during all this time) -- in one journal transaction, so that
+//	they all go to the journal first, in one sequential write.  If the operation fails, and we have
 //	modified part of the directory and/or bitmap, we simply discard
 //	the changed version, without writing it back to disk.
 //
@@ -33,11 +45,10 @@
 //	   there is no synchronization for concurrent accesses
 //	   files have a fixed size, set when the file is created
 //	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   only a limited number of files can be added to each directory
+//	   only the metadata is journaled: if Nachos exits in the middle
+//	    of writing a file, the file may have some of the new data and
+//	    not the rest
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -50,6 +61,10 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "journal.h"
+#include "log.h"
+#include "synch.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -59,11 +74,43 @@
 
 // Initial file sizes for the bitmap and directory; until the file system
 // supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// of files that can be loaded onto the disk.  (A disk formatted with a
+// smaller directory still works: the directory is as big as its file.)
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		10
+#define NumDirEntries 		64
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
+// The size of every other directory, made with MakeDirectory.
+#define NumSubDirEntries	16
+#define SubDirectoryFileSize	(sizeof(DirectoryEntry) * NumSubDirEntries)
+
+// The file in the root directory holding the share counts, made by the
+// first Clone, and how many sectors CopyFile moves at a time.  (The
+// name is an array, as Find and Create take a char *.)
+static char SharesName[] = ".shares";
+#define CopyChunk		32
+
+bool logStructured = FALSE;		// see FileSystem::FileSystem
+
+//----------------------------------------------------------------------
+// FileSystemCleaner, FileSystemClean
+// 	The body of the log cleaner thread, and what the log calls to clean
+//	segments.  These are C routines because C++ can't handle pointers
+//	to member functions.
+//----------------------------------------------------------------------
+
+static void
+FileSystemCleaner(_int arg)
+{
+    ((FileSystem *)arg)->Cleaner();
+}
+
+static void
+FileSystemClean(_int arg)
+{
+    ((FileSystem *)arg)->CleanSegments();
+}
+
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
@@ -74,15 +121,36 @@
 //	If format = FALSE, we just have to open the files
 //	representing the bitmap and the directory.
 //
+//	Either way, we then keep the bitmap and the directory in memory
+//	while Nachos is running, so that Create, Open and Remove don't
+//	have to read them in again each time.
+//
+//	Formatting also sets up an empty journal; otherwise, the journal
+//	is replayed first, to finish any operations cut short last time.
+//
+//	If "logStructured" is set (-lfs), formatting also sets up the log
+//	(cf. log.h); otherwise, the disk is log-structured if it was
+//	formatted that way.  On a log-structured disk, we start the
+//	cleaner thread.
+//
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
 
 FileSystem::FileSystem(bool format)
 { 
+    lock = new RWLock("file system");
     DEBUG('f', "Initializing the file system.\n");
+    freeMap = new BitMap(NumSectors);
+    directory = new Directory(NumDirEntries);
+    dentries = new DentryCache(DentryCacheSize);
+    journal = new Journal;
+    log = NULL;
+    writer = NULL;
+    nested = 0;
+    sharesFile = NULL;
+    shares = NULL;
+    headerChanges = 0;
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
 
@@ -92,6 +160,12 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
+	journal->Format(freeMap);
+	if (logStructured) {
+	    log = new Log;
+	    log->Format(freeMap, divRoundUp(FreeMapFileSize, SectorSize)
+				 + divRoundUp(DirectoryFileSize, SectorSize));
+	}
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
@@ -128,17 +202,267 @@ FileSystem::FileSystem(bool format)
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
-
-        delete freeMap; 
-	delete directory; 
+	}
 	delete mapHdr; 
 	delete dirHdr;
-	}
     } else {
     // if we are not formatting the disk, just open the files representing
     // the bitmap and directory; these are left open while Nachos is running
+	journal->Recover();
+	log = new Log;
+	if (!log->Load()) {
+	    delete log;			// it isn't log-structured
+	    log = NULL;
+	}
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+	freeMap->FetchFrom(freeMapFile);
+	directory->FetchFrom(directoryFile);
+	if (directory->Find(SharesName) != -1)
+	    OpenShares(directory->Find(SharesName), FALSE);
+    }
+    if (log != NULL) {
+	Thread *cleaner = new Thread("log cleaner");
+
+	log->SetCleaner(FileSystemClean, (_int) this);
+	cleaner->Fork(FileSystemCleaner, (_int) this);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Reload
+// 	Throw away any changes made to the in-memory bitmap and directory,
+//	by reading them in again.  Used when an operation fails half way
+//	through; the copies on disk are only changed once it has worked.
+//
+//	The write lock must be held.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Reload()
+{
+    freeMap->FetchFrom(freeMapFile);
+    directory->FetchFrom(directoryFile);
+    if (log != NULL)
+	log->FetchFrom();
+    if (shares != NULL)
+	sharesFile->ReadAt((char *)shares, NumSectors, 0);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LockForWrite, FileSystem::UnlockForWrite
+// 	Lock the file system, to change the directory and the bitmap; the
+//	changes made until it is unlocked are one journal transaction.
+//----------------------------------------------------------------------
+
+void
+FileSystem::LockForWrite()
+{
+    lock->AcquireWrite();
+    writer = currentThread;
+    journal->Begin();
+}
+
+void
+FileSystem::UnlockForWrite()
+{
+    journal->End();
+    writer = NULL;
+    lock->ReleaseWrite();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AcquireFreeMap
+// 	Return the bitmap of free sectors, for an open file that needs to
+//	allocate more space, locking out every other operation on the
+//	file system until ReleaseFreeMap is called.
+//
+//	On a log-structured disk, a directory being written by Create or
+//	Remove needs sectors too, with the file system locked already by
+//	the same thread; then there is nothing to lock.
+//----------------------------------------------------------------------
+
+BitMap *
+FileSystem::AcquireFreeMap()
+{
+    if (writer == currentThread) {
+	nested++;
+	journal->Begin();
+    } else
+	LockForWrite();
+    return freeMap;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReleaseFreeMap
+// 	Let other operations on the file system go ahead again, after
+//	AcquireFreeMap; if the bitmap was "changed", write it back first.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ReleaseFreeMap(bool changed)
+{
+    if (changed) {
+	freeMap->WriteBack(freeMapFile);
+	if (log != NULL)
+	    log->WriteBack();
+    }
+    if (nested > 0) {
+	nested--;
+	journal->End();
+    } else
+	UnlockForWrite();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::BeginUpdate, FileSystem::EndUpdate
+// 	Make the metadata sectors (file headers, index blocks) an open
+//	file writes between the two calls one journal transaction.  The
+//	caller must not hold the file system lock, nor take it in between:
+//	the lock always comes first, then the journal.
+//----------------------------------------------------------------------
+
+void
+FileSystem::BeginUpdate()
+{
+    journal->Begin();
+}
+
+void
+FileSystem::EndUpdate()
+{
+    journal->End();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindHeader, FileSystem::PlaceHeader
+// 	Return the sector holding the header of the file at "sector" (as
+//	a directory entry has it), or the sector to write it to, once it
+//	has changed.  That is "sector" itself, unless the disk is
+//	log-structured: then "sector" is an inode number, and the header
+//	is wherever the log put it (see Log::PlaceHeader).
+//
+//	The write lock must be held, for PlaceHeader.
+//----------------------------------------------------------------------
+
+int
+FileSystem::FindHeader(int sector)
+{
+    return (log != NULL) ? log->Locate(sector) : sector;
+}
+
+int
+FileSystem::PlaceHeader(int sector)
+{
+    return (log != NULL) ? log->PlaceHeader(freeMap, sector) : sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WalkPath
+// 	Find the directory that should hold the last component of "path":
+//	set "parent" to the sector of its header, and copy the last
+//	component into "name" (which has room for FileNameMaxLen
+//	characters, and the '\0').  Components are separated by "/"; all
+//	paths start from the root directory, with or without a "/".
+//
+//	Return FALSE if some directory along the way doesn't exist (or
+//	isn't a directory), if a component is too long, or if the path
+//	has no components at all.
+//
+//	At least the read lock must be held.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::WalkPath(char *path, int *parent, char *name)
+{
+    int sector = DirectorySector;
+    bool isDirectory;
+
+    for (;;) {
+	int length = 0;
+
+	while (*path == '/')
+	    path++;
+	while ((*path != '/') && (*path != '\0')) {
+	    if (length == FileNameMaxLen)
+		return FALSE;		// name too long
+	    name[length++] = *path++;
+	}
+	name[length] = '\0';
+	while (*path == '/')
+	    path++;
+	if (*path == '\0')
+	    break;			// that was the last component
+	sector = LookupName(sector, name, &isDirectory);
+	if ((sector == -1) || !isDirectory)
+	    return FALSE;
+    }
+    *parent = sector;
+    return (bool)(name[0] != '\0');
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LookupName
+// 	Return the sector of the header of "name", in the directory whose
+//	header is at sector "parent", and set "isDirectory" to whether it
+//	is a directory; return -1 if there is no such name.  If the dentry
+//	cache knows the answer we are done; otherwise we read the
+//	directory, and remember what we found (or didn't).
+//
+//	At least the read lock must be held.
+//----------------------------------------------------------------------
+
+int
+FileSystem::LookupName(int parent, char *name, bool *isDirectory)
+{
+    Directory *dir;
+    OpenFile *dirFile;
+    int sector;
+
+    if (dentries->Lookup(parent, name, &sector, isDirectory))
+	return sector;
+    dir = FetchDirectory(parent, &dirFile);
+    sector = dir->Find(name);
+    *isDirectory = dir->IsDirectory(name);
+    ReleaseDirectory(dir, dirFile);
+    dentries->Enter(parent, name, sector, *isDirectory);
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FetchDirectory
+// 	Return the directory whose header is at "sector", and set "file"
+//	to the open file holding it.  The root directory is always in
+//	memory; any other is read in, and ReleaseDirectory must be called
+//	when we are done with it.
+//----------------------------------------------------------------------
+
+Directory *
+FileSystem::FetchDirectory(int sector, OpenFile **file)
+{
+    Directory *dir;
+
+    if (sector == DirectorySector) {
+	*file = directoryFile;
+	return directory;
+    }
+    *file = new OpenFile(sector);
+    dir = new Directory(NumSubDirEntries);
+    dir->FetchFrom(*file);
+    return dir;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReleaseDirectory
+// 	We are done with directory "dir", from FetchDirectory.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ReleaseDirectory(Directory *dir, OpenFile *file)
+{
+    if (dir != directory) {
+	delete dir;
+	delete file;
     }
 }
 
@@ -148,69 +472,126 @@ FileSystem::FileSystem(bool format)
 //	Since we can't increase the size of files dynamically, we have
 //	to give Create the initial size of the file.
 //
+//	"name" -- path name of file to be created
+//	"initialSize" -- size of file to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Create(char *name, int initialSize)
+{
+    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    return CreateEntry(name, initialSize, FALSE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::MakeDirectory
+// 	Create a new, empty directory (similar to UNIX mkdir).
+//
+//	"name" -- path name of directory to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::MakeDirectory(char *name)
+{
+    DEBUG('f', "Making directory %s\n", name);
+    return CreateEntry(name, SubDirectoryFileSize, TRUE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateEntry
+// 	Create a file, or a directory, in the Nachos file system.
+//
 //	The steps to create a file are:
+//	  Find the directory it goes in
 //	  Make sure the file doesn't already exist
+//	  If the directory is full, grow it (see Directory::Grow)
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
 //	  Add the name to the directory
 //	  Store the new file header on disk 
+//	  (For a directory, store its contents, an empty directory)
 //	  Flush the changes to the bitmap and the directory back to disk
 //
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
+//	If we fail part way through, the in-memory bitmap and directory
+//	(and inode map) may have been changed, so we read them in again.
 //
 // 	Create fails if:
+//		a directory in the path doesn't exist
 //   		file is already in directory
-//	 	no free space for file header
-//	 	no free entry for file in directory
+//	 	no free space for file header (or no free inode)
+//	 	no free entry for file in directory, and it can't grow
 //	 	no free space for data blocks for the file 
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
+// 	Creating a file changes the directory and the bitmap, so it
+//	locks out every other operation on the file system.
 //
-//	"name" -- name of file to be created
+//	"name" -- path name of file to be created
 //	"initialSize" -- size of file to be created
+//	"isDirectory" -- is it a directory?
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Create(char *name, int initialSize)
+FileSystem::CreateEntry(char *name, int initialSize, bool isDirectory)
 {
-    Directory *directory;
-    BitMap *freeMap;
+    Directory *dir;
+    OpenFile *dirFile;
     FileHeader *hdr;
-    int sector;
+    char leaf[FileNameMaxLen + 1];
+    int parent, sector, hdrSector;
     bool success;
 
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
-
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-
-    if (directory->Find(name) != -1)
+    LockForWrite();
+    if (!WalkPath(name, &parent, leaf)) {
+	UnlockForWrite();
+	return FALSE;			// no such directory
+    }
+    dir = FetchDirectory(parent, &dirFile);
+    if (dir->Find(leaf) != -1)
       success = FALSE;			// file is already in directory
+    else if (dir->IsFull() && !dir->Grow(dirFile))
+      success = FALSE;			// no space in directory
     else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
-        sector = freeMap->Find();	// find a sector to hold the file header
+	if (log != NULL)
+	    sector = log->NewInode();	// the header goes in the log
+	else
+	    sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
+        else if (!(isDirectory ? dir->AddDirectory(leaf, sector) :
+						dir->Add(leaf, sector)))
             success = FALSE;	// no space in directory
 	else {
     	    hdr = new FileHeader;
 	    if (!hdr->Allocate(freeMap, initialSize))
             	success = FALSE;	// no space on disk for data
+	    else if ((hdrSector = PlaceHeader(sector)) == -1)
+		success = FALSE;	// no space in the log for the header
 	    else {	
 	    	success = TRUE;
 		// everthing worked, flush all changes back to disk
-    	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
+    	    	hdr->WriteBack(hdrSector); 		
+		if (isDirectory) {
+		    OpenFile *file = new OpenFile(sector);
+		    Directory *empty = new Directory(NumSubDirEntries);
+
+		    empty->WriteBack(file);
+		    delete empty;
+		    delete file;
+		}
+    	    	dir->WriteBack(dirFile);
     	    	freeMap->WriteBack(freeMapFile);
+		if (log != NULL)
+		    log->WriteBack();
+		dentries->Enter(parent, leaf, sector, isDirectory);
 	    }
             delete hdr;
 	}
-        delete freeMap;
+	if (!success)
+	    Reload();			// undo the changes
     }
-    delete directory;
+    ReleaseDirectory(dir, dirFile);
+    UnlockForWrite();
     return success;
 }
 
@@ -218,75 +599,367 @@ FileSystem::Create(char *name, int initialSize)
 // FileSystem::Open
 // 	Open a file for reading and writing.  
 //	To open a file:
-//	  Find the location of the file's header, using the directory 
+//	  Find the location of the file's header, by walking down the
+//	    directories on its path (mostly in the dentry cache)
 //	  Bring the header into memory
+//	Any number of files can be opened at once, since that only reads
+//	the directories.  A directory can't be opened.
 //
-//	"name" -- the text name of the file to be opened
+//	"name" -- the path name of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
-    int sector;
+    char leaf[FileNameMaxLen + 1];
+    int parent, sector;
+    bool isDirectory;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name); 
-    if (sector >= 0) 		
-	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
+    lock->AcquireRead();
+    if (WalkPath(name, &parent, leaf)) {
+	sector = LookupName(parent, leaf, &isDirectory);
+	if ((sector >= 0) && !isDirectory)
+	    openFile = new OpenFile(sector);	// name was found in directory 
+    }
+    lock->ReleaseRead();
     return openFile;				// return NULL if not found
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Remove
 // 	Delete a file from the file system.  This requires:
-//	    Remove it from the directory
+//	    Remove it from its directory
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
 //	    Write changes to directory, bitmap back to disk
+//	    Remember, in the dentry cache, that it is gone
+//	A directory can be removed too, as long as it is empty.
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
-//	in the file system.
+//	in the file system (or is a directory that isn't empty).
 //
-//	"name" -- the text name of the file to be removed
+//	"name" -- the path name of the file to be removed
 //----------------------------------------------------------------------
 
 bool
 FileSystem::Remove(char *name)
 { 
-    Directory *directory;
-    BitMap *freeMap;
+    Directory *dir;
+    OpenFile *dirFile;
     FileHeader *fileHdr;
-    int sector;
+    char leaf[FileNameMaxLen + 1];
+    int parent, sector;
+    bool isDirectory;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
+    LockForWrite();
+    if (!WalkPath(name, &parent, leaf)) {
+	UnlockForWrite();
+	return FALSE;			// no such directory
+    }
+    dir = FetchDirectory(parent, &dirFile);
+    sector = dir->Find(leaf);
+    isDirectory = dir->IsDirectory(leaf);
+    if (isDirectory && (sector != -1)) {
+	OpenFile *file = new OpenFile(sector);
+	DirectoryIterator *contents = new DirectoryIterator(file);
+
+	if (contents->Next() != NULL)
+	    sector = -1;		// can't remove it: not empty
+	delete contents;
+	delete file;
+    }
     if (sector == -1) {
-       delete directory;
+       ReleaseDirectory(dir, dirFile);
+       UnlockForWrite();
        return FALSE;			 // file not found 
     }
     fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
+    fileHdr->FetchFrom(FindHeader(sector));
 
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
-
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
-    freeMap->Clear(sector);			// remove header block
-    directory->Remove(name);
+    fileHdr->Deallocate(freeMap);  		// remove data blocks (the
+						// ones no clone shares)
+    freeMap->Clear(FindHeader(sector));		// remove header block
+    if (log != NULL)
+	log->FreeInode(sector);
+    dir->Remove(leaf);
+    OpenFile::Removed(sector);			// if it is open, forget it
 
     freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
+    if (log != NULL)
+	log->WriteBack();
+    if (shares != NULL)
+	WriteShares();
+    dir->WriteBack(dirFile);        		// flush to disk
+    dentries->Enter(parent, leaf, -1, FALSE);
+    if (isDirectory)
+	dentries->Purge(sector);
     delete fileHdr;
-    delete directory;
-    delete freeMap;
+    ReleaseDirectory(dir, dirFile);
+    UnlockForWrite();
     return TRUE;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::Preallocate
+// 	Give the file "name" sectors for its first "size" bytes, all at
+//	once, without changing its length (see OpenFile::Preallocate), so
+//	that a file whose size is known ahead of time, like a log, is laid
+//	out in as few runs as possible, and writing it allocates nothing.
+//
+//	Return TRUE if that worked, FALSE if there is no such file or not
+//	enough free sectors.
+//
+//	"name" -- the name of the file
+//	"size" -- how many bytes it should have room for
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Preallocate(char *name, int size)
+{
+    OpenFile *openFile = Open(name);
+    bool success;
+
+    if (openFile == NULL)
+	return FALSE;			// file not found
+    success = openFile->Preallocate(size);
+    delete openFile;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CopyFile
+// 	Copy the Nachos file "from" to a new one, "to".  Unlike copying it
+//	through a user program, a sector or a small buffer at a time, this
+//	moves CopyChunk sectors at once, through ReadAt and WriteAt, which
+//	read or write each run of whole sectors that is consecutive on
+//	disk in one request (cf. SynchDisk::ReadSectors).
+//
+//	Return FALSE if "from" doesn't exist, or "to" couldn't be made, or
+//	there wasn't room for all of it (then there is no "to" either).
+//----------------------------------------------------------------------
+
+bool
+FileSystem::CopyFile(char *from, char *to)
+{
+    OpenFile *src, *dst;
+    char *buffer;
+    int length, position, amount;
+    bool success = TRUE;
+
+    DEBUG('f', "Copying file %s to %s\n", from, to);
+    if ((src = Open(from)) == NULL)
+	return FALSE;			// file not found
+    length = src->Length();
+    if (!Create(to, length) || ((dst = Open(to)) == NULL)) {
+	delete src;
+	return FALSE;
+    }
+    buffer = new char[CopyChunk * SectorSize];
+    for (position = 0; position < length; position += amount) {
+	amount = min(CopyChunk * SectorSize, length - position);
+	if ((src->ReadAt(buffer, amount, position) != amount)
+		|| (dst->WriteAt(buffer, amount, position) != amount)) {
+	    success = FALSE;		// out of space
+	    break;
+	}
+    }
+    delete [] buffer;
+    delete dst;
+    delete src;
+    if (!success)
+	Remove(to);
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Clone
+// 	Make a new file "to" with the same contents as "from", without
+//	copying them: its header points to the same data sectors, and the
+//	share counts say that one more file has each of them.  Whichever
+//	file writes a shared sector first gets a copy of its own then
+//	(see OpenFile::Unshare), and Remove only frees a sector that no
+//	other file shares.  So a snapshot of a file costs a header.
+//
+//	The share counts -- for each sector, how many files have it
+//	besides one -- are kept in memory, and in the file SharesName,
+//	made by the first Clone; a disk never cloned doesn't have it.
+//
+//	Only headers that are a table of sectors can share them; with any
+//	other (cf. FileHeader::CanShare), or on a log-structured disk,
+//	whose cleaner moves sectors from file to file, this is CopyFile.
+//	Pages of "from" mapped into memory, and written there, are only
+//	in the clone if they were written back first.
+//
+//	Return FALSE if "from" doesn't exist (or is a directory), or "to"
+//	does already, or there is no room for it.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Clone(char *from, char *to)
+{
+    Directory *dir;
+    OpenFile *dirFile;
+    FileHeader *hdr = new FileHeader;
+    char leaf[FileNameMaxLen + 1];
+    int parent, sector = -1, newSector;
+    bool isDirectory, success = FALSE;
+
+    if ((log != NULL) || !hdr->CanShare() || !MakeShares()) {
+	delete hdr;
+	return CopyFile(from, to);	// the sectors can't be shared
+    }
+    DEBUG('f', "Cloning file %s as %s\n", from, to);
+    LockForWrite();
+    if (WalkPath(from, &parent, leaf))
+	sector = LookupName(parent, leaf, &isDirectory);
+    if ((sector != -1) && !isDirectory && WalkPath(to, &parent, leaf)) {
+	dir = FetchDirectory(parent, &dirFile);
+	hdr->FetchFrom(sector);
+	if ((dir->Find(leaf) == -1) && ((newSector = freeMap->Find()) != -1)
+		&& dir->Add(leaf, newSector) && hdr->Share(shares)) {
+	    success = TRUE;
+	    hdr->WriteBack(newSector);
+	    dir->WriteBack(dirFile);
+	    freeMap->WriteBack(freeMapFile);
+	    WriteShares();
+	    dentries->Enter(parent, leaf, newSector, FALSE);
+	} else
+	    Reload();			// undo the changes
+	ReleaseDirectory(dir, dirFile);
+    }
+    UnlockForWrite();
+    delete hdr;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::MakeShares
+// 	Make sure there are share counts, making the file SharesName, all
+//	zero, if need be.  Return FALSE if it couldn't be made (the disk
+//	may be too big for a file to hold a count for every sector).
+//----------------------------------------------------------------------
+
+bool
+FileSystem::MakeShares()
+{
+    if (shares != NULL)
+	return TRUE;
+    if (!Create(SharesName, NumSectors))
+	return (bool)(shares != NULL);	// another thread may have made it
+    LockForWrite();
+    OpenShares(directory->Find(SharesName), TRUE);
+    UnlockForWrite();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::OpenShares, FileSystem::WriteShares
+// 	Open the file of share counts, whose header is at "sector", and
+//	read them in -- or, if "format", make them all zero -- and write
+//	them back, once they have changed.
+//----------------------------------------------------------------------
+
+void
+FileSystem::OpenShares(int sector, bool format)
+{
+    sharesFile = new OpenFile(sector);
+    shares = new unsigned char[NumSectors];
+    if (format) {
+	bzero(shares, NumSectors);
+	WriteShares();
+    } else
+	sharesFile->ReadAt((char *)shares, NumSectors, 0);
+}
+
+void
+FileSystem::WriteShares()
+{
+    sharesFile->WriteAt((char *)shares, NumSectors, 0);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::SharesChanged
+// 	An open file has just given itself a copy of a shared sector, and
+//	written its header back (see OpenFile::Unshare), with the bitmap
+//	acquired: write the share counts back too, and count the change,
+//	so that every other OpenFile knows to read its header again.
+//----------------------------------------------------------------------
+
+void
+FileSystem::SharesChanged()
+{
+    WriteShares();
+    headerChanges++;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Cleaner
+// 	The log cleaner thread: each time the log says clean segments are
+//	running low, lock the file system and clean some more.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Cleaner()
+{
+    for (;;) {
+	log->WaitForCleaning();
+	DEBUG('f', "Cleaning the log\n");
+	AcquireFreeMap();
+	log->Clean();
+	ReleaseFreeMap(TRUE);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CleanSegments
+// 	Clean segments of the log, until MinCleanSegments of them are clean,
+//	or none is worth cleaning.  To clean a segment, we go through the
+//	inode map, and move every sector that a file has in the segment
+//	-- data, index blocks, header -- to the head of the log.
+//
+//	Open files are left alone, as their headers are in memory (and
+//	may be written back, over what we would write); a segment holding
+//	some of their sectors doesn't get clean yet.  So don't the
+//	sectors of a file being created, which isn't in the inode map
+//	yet.
+//
+//	The write lock must be held (see Log::Clean).
+//----------------------------------------------------------------------
+
+void
+FileSystem::CleanSegments()
+{
+    bool *tried = new bool[NumSectors / SegmentSectors];
+    FileHeader *hdr = new FileHeader;
+    int victim, first, live, i;
+
+    for (i = 0; i < NumSectors / SegmentSectors; i++)
+	tried[i] = FALSE;
+    while (log->NeedsCleaning(freeMap)
+	    && ((victim = log->PickVictim(freeMap, tried)) != -1)) {
+	first = log->SegmentStart(victim);
+	live = log->LiveSectors(freeMap, victim);
+	DEBUG('f', "Cleaning segment %d, %d sectors in use\n", victim, live);
+	for (i = FirstLoggedInode; i < NumInodes; i++) {
+	    int sector = log->Locate(i);
+
+	    if ((sector == -1) || log->IsOpen(i))
+		continue;
+	    hdr->FetchFrom(sector);
+	    if (hdr->MoveSectors(freeMap, first, SegmentSectors)
+		    || ((sector >= first) && (sector < first + SegmentSectors)))
+		hdr->WriteBack(log->PlaceHeader(freeMap, i));
+	}
+	stats->numCleanerMoves += live - log->LiveSectors(freeMap, victim);
+	if (log->LiveSectors(freeMap, victim) == 0)
+	    stats->numSegmentsCleaned++;
+    }
+    delete hdr;
+    delete [] tried;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
 // 	List all the files in the file system directory.
@@ -295,11 +968,46 @@ FileSystem::Remove(char *name)
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
-
-    directory->FetchFrom(directoryFile);
+    lock->AcquireRead();
     directory->List();
-    delete directory;
+    lock->ReleaseRead();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::List
+// 	List the files in directory "name" (the root directory if "name"
+//	is "/").  The directory is read a sector at a time, as the names
+//	are printed, rather than all at once (see DirectoryIterator).
+//
+//	Return FALSE if there is no such directory.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::List(char *name)
+{
+    char leaf[FileNameMaxLen + 1];
+    int parent, sector = DirectorySector;
+    bool isDirectory = TRUE;
+    OpenFile *file;
+    DirectoryIterator *entries;
+    DirectoryEntry *entry;
+
+    lock->AcquireRead();
+    if (WalkPath(name, &parent, leaf))
+	sector = LookupName(parent, leaf, &isDirectory);
+    if ((sector == -1) || !isDirectory) {
+	lock->ReleaseRead();
+	return FALSE;
+    }
+    file = (sector == DirectorySector) ? directoryFile : new OpenFile(sector);
+    entries = new DirectoryIterator(file);
+    while ((entry = entries->Next()) != NULL)
+	printf("%s%s\n", entry->name, entry->isDirectory ? "/" : "");
+    delete entries;
+    if (file != directoryFile)
+	delete file;
+    lock->ReleaseRead();
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -317,9 +1025,8 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
+    lock->AcquireRead();
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
     bitHdr->Print();
@@ -328,14 +1035,10 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
-
-    directory->FetchFrom(directoryFile);
     directory->Print();
+    lock->ReleaseRead();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
 } 
@@ -20,9 +20,10 @@
 //	file system (in a file named "DISK"). 
 //
 //	In the "real" implementation, there are two key data structures used 
-//	in the file system.  There is a single "root" directory, listing
-//	all of the files in the file system; unlike UNIX, the baseline
-//	system does not provide a hierarchical directory structure.  
+//	in the file system.  There is a "root" directory, listing files
+//	and other directories, which list files and directories in turn;
+//	file names are paths through this tree, like "/usr/bin/sh" (there
+//	is no current directory: every path starts from the root).
 //	In addition, there is a bitmap for allocating
 //	disk sectors.  Both the root directory and the bitmap are themselves
 //	stored as files in the Nachos file system -- this causes an interesting
@@ -38,6 +39,14 @@
 #include "copyright.h"
 #include "openfile.h"
 
+class RWLock;
+class BitMap;
+class Directory;
+class DentryCache;
+class Journal;
+class Log;
+class Thread;
+
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
 				// implementation is available
@@ -65,6 +74,9 @@ class FileSystem {
 };
 
 #else // FILESYS
+extern bool logStructured;		// format the disk with the
+					// log-structured layout (-lfs)?
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -76,20 +88,96 @@ class FileSystem {
 
     bool Create(char *name, int initialSize);  	
 					// Create a file (UNIX creat)
+    bool MakeDirectory(char *name);	// Create a directory (UNIX mkdir)
 
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 
-    bool Remove(char *name);  		// Delete a file (UNIX unlink)
+    bool Remove(char *name);  		// Delete a file (UNIX unlink), or
+					// an empty directory
+
+    bool Preallocate(char *name, int size);
+					// Reserve sectors for "size" bytes
+					// of a file (Linux fallocate)
+
+    bool CopyFile(char *from, char *to);
+					// Copy a file to a new one, a run of
+					// sectors at a time
+    bool Clone(char *from, char *to);	// Make a new file sharing the data
+					// sectors of another, until either
+					// one writes them
+    unsigned char *GetShares() { return shares; }
+					// How many files besides one have
+					// each sector (NULL if none ever
+					// shared any)
+    void SharesChanged();		// A file stopped sharing a sector,
+					// and its header was written back
+    int HeaderChanges() { return headerChanges; }
+					// How many times that has happened
 
     void List();			// List all the files in the file system
+    bool List(char *name);		// List the files in a directory
 
     void Print();			// List all the files and their contents
 
+    BitMap *AcquireFreeMap();		// Lock the file system, and return
+					// the bitmap, to allocate space
+    void ReleaseFreeMap(bool changed);	// Unlock it, writing the bitmap
+					// back if it was changed
+    void BeginUpdate();			// Journal the metadata written from
+    void EndUpdate();			// here to there as one operation
+
+    Log *GetLog() { return log; }	// The log, if the disk is
+					// log-structured (NULL if not)
+    void Cleaner();			// The cleaner thread's body
+    void CleanSegments();		// Clean the log (with the file
+					// system locked)
+
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   RWLock* lock;			// Open and List only read the
+					// directory and the bitmap, and can
+					// share them; Create and Remove
+					// change them, and can't
+   BitMap* freeMap;			// In-memory copies of the bitmap and
+   Directory* directory;		// the directory, written back
+					// whenever they are changed
+   DentryCache* dentries;		// Recent lookups of path components
+   Journal* journal;			// Where metadata changes go first
+   Log* log;				// The inode map and the head of the
+					// log, if the disk is log-structured
+   Thread* writer;			// The thread holding the lock to
+					// write, if any
+   int nested;				// How many AcquireFreeMaps it has
+					// made while holding it already
+   OpenFile* sharesFile;		// The share counts, as a file
+   unsigned char* shares;		// and in memory (see Clone)
+   int headerChanges;
+
+   bool MakeShares();			// Set up the share counts
+   void OpenShares(int sector, bool format);
+					// Read them in (or zero them)
+   void WriteShares();			// Write them back
+
+   void Reload();			// Read the bitmap and directory in
+					// again, undoing a failed change
+   void LockForWrite();			// Lock the file system, to change
+   void UnlockForWrite();		// it, and journal the changes
+   int FindHeader(int sector);		// Where the header of the file at
+					// "sector" (in a directory entry) is
+   int PlaceHeader(int sector);		// Where to write it
+   bool CreateEntry(char *name, int initialSize, bool isDirectory);
+					// Create a file or a directory
+   bool WalkPath(char *path, int *parent, char *name);
+					// Find the directory holding the
+					// last component of "path"
+   int LookupName(int parent, char *name, bool *isDirectory);
+					// Look "name" up in a directory
+   Directory* FetchDirectory(int sector, OpenFile **file);
+   void ReleaseDirectory(Directory *dir, OpenFile *file);
+					// Get (and give back) a directory
 };
 
 #endif // FILESYS
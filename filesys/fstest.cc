@@ -3,6 +3,7 @@
 //
 //	We implement:
 //	   Copy -- copy a file from UNIX to Nachos
+//	   BuildImage -- copy a whole list of files from UNIX to Nachos
 //	   Print -- cat the contents of a Nachos file 
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
@@ -20,16 +21,21 @@
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "bitmap.h"
 
 #define TransferSize 	10 	// make it small, just to be difficult
+#define MaxPathLength	255	// longest file name in a manifest (see
+				// BuildImage)
 
 //----------------------------------------------------------------------
-// Copy
-// 	Copy the contents of the UNIX file "from" to the Nachos file "to"
+// CopyIn
+// 	Copy the contents of the UNIX file "from" to the Nachos file "to",
+//	"chunkSize" bytes at a time (0: all at once), and return its
+//	length; -1 if it couldn't be copied.
 //----------------------------------------------------------------------
 
-void
-Copy(char *from, char *to)
+static int
+CopyIn(char *from, char *to, int chunkSize)
 {
     FILE *fp;
     OpenFile* openFile;
@@ -39,7 +45,7 @@ Copy(char *from, char *to)
 // Open UNIX file
     if ((fp = fopen(from, "r")) == NULL) {	 
 	printf("Copy: couldn't open input file %s\n", from);
-	return;
+	return -1;
     }
 
 // Figure out length of UNIX file
@@ -52,21 +58,100 @@ Copy(char *from, char *to)
     if (!fileSystem->Create(to, fileLength)) {	 // Create Nachos file
 	printf("Copy: couldn't create output file %s\n", to);
 	fclose(fp);
-	return;
+	return -1;
     }
     
     openFile = fileSystem->Open(to);
     ASSERT(openFile != NULL);
     
-// Copy the data in TransferSize chunks
-    buffer = new char[TransferSize];
-    while ((amountRead = fread(buffer, sizeof(char), TransferSize, fp)) > 0)
+// Copy the data in chunkSize chunks
+    if (chunkSize <= 0)
+	chunkSize = max(fileLength, 1);
+    buffer = new char[chunkSize];
+    while ((amountRead = fread(buffer, sizeof(char), chunkSize, fp)) > 0)
 	openFile->Write(buffer, amountRead);	
     delete [] buffer;
 
 // Close the UNIX and the Nachos files
     delete openFile;
     fclose(fp);
+    return fileLength;
+}
+
+//----------------------------------------------------------------------
+// Copy
+// 	Copy the contents of the UNIX file "from" to the Nachos file "to"
+//----------------------------------------------------------------------
+
+void
+Copy(char *from, char *to)
+{
+    (void) CopyIn(from, to, TransferSize);
+}
+
+//----------------------------------------------------------------------
+// BuildImage
+// 	Copy every file listed in the UNIX file "manifest" into Nachos,
+//	in one run, to build a disk to test with (usually a freshly
+//	formatted one, with -f).  Each line of the manifest is
+//
+//	    <unix file> [<nachos file>]
+//
+//	where the Nachos name is the last component of the UNIX one, if
+//	it isn't given.  Blank lines, and lines starting with '#', are
+//	skipped.  The directories in a Nachos path are made first, if
+//	they aren't there already.
+//
+//	Each file is written in one go, so that its data is laid out
+//	in as few runs of sectors as the free map allows, and written in
+//	as few disk requests; with a cache as big as the disk (-cache),
+//	nothing at all is written until the Sync at the end.  The layout
+//	is whatever the file system being built uses, since it is the
+//	file system that does the writing.
+//----------------------------------------------------------------------
+
+void
+BuildImage(char *manifest)
+{
+    FILE *fp;
+    char line[2 * MaxPathLength + 2], from[MaxPathLength + 1];
+    char to[MaxPathLength + 1];
+    int startTicks = stats->totalTicks;
+    int numFiles = 0, numBytes = 0, numFree, length, i;
+    BitMap *freeMap;
+
+    if ((fp = fopen(manifest, "r")) == NULL) {
+	printf("BuildImage: couldn't open manifest %s\n", manifest);
+	return;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	int n = sscanf(line, "%255s %255s", from, to);
+
+	if ((n < 1) || (from[0] == '#'))
+	    continue;
+	if (n < 2)
+	    strcpy(to, (strrchr(from, '/') != NULL) ? strrchr(from, '/') + 1
+						     : from);
+	for (i = 1; to[i] != '\0'; i++)	// make its directories
+	    if (to[i] == '/') {
+		to[i] = '\0';
+		DEBUG('f', "Making directory %s, for %s\n", to, from);
+		(void) fileSystem->MakeDirectory(to);	// it may be there
+		to[i] = '/';
+	    }
+	if ((length = CopyIn(from, to, 0)) >= 0) {
+	    numFiles++;
+	    numBytes += length;
+	}
+    }
+    fclose(fp);
+    synchDisk->Sync();
+
+    freeMap = fileSystem->AcquireFreeMap();
+    numFree = freeMap->NumClear();
+    fileSystem->ReleaseFreeMap(FALSE);
+    printf("Image: %d files, %d bytes, %d sectors free, in %d ticks\n",
+	   numFiles, numBytes, numFree, stats->totalTicks - startTicks);
 }
 
 //----------------------------------------------------------------------
@@ -0,0 +1,372 @@
+// journal.cc
+//	Routines to journal the file system's metadata.  See journal.h.
+//
+//	A record is written in one request, straight to the disk (not
+//	just into the cache), before the sectors it holds are unpinned;
+//	so none of them can reach its own place on the disk before the
+//	record is safe in the journal.  If we crash while writing it, its
+//	checksum is wrong, and Recover stops there: that transaction never
+//	happened.
+//
+//	A record doesn't wrap around the end of the log: if it doesn't fit,
+//	it goes at the start, and the sectors left at the end are skipped
+//	(Recover, not finding the next record where the last one ended,
+//	looks at the start of the log).
+//
+//	A transaction that writes more sectors than a record can hold (or
+//	than the cache can keep pinned) is only journaled up to there; the
+//	rest of its writes go to the cache as if there were no journal.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal.  Nothing is journaled until Format or
+//	Recover has found a place on the disk for it.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    enabled = FALSE;
+    lock = new Lock("journal");
+    owner = NULL;
+    depth = count = limit = 0;
+    overflowed = FALSE;
+    sequence = 1;
+    head = used = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Set up an empty journal on a disk being formatted: mark its sectors
+//	as in use in "freeMap", and write its header.
+//----------------------------------------------------------------------
+
+void
+Journal::Format(BitMap *freeMap)
+{
+    for (int i = 0; i < JournalSectors; i++)
+	freeMap->Mark(JournalSector + i);
+    sequence = 1;
+    head = used = 0;
+    WriteHeader();
+    Enable();
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Find the journal, when Nachos starts up, and redo every operation
+//	whose record is in it: write each sector in each record again,
+//	oldest first, then write them all back and empty the journal.
+//	Operations that were done already are just done again.
+//
+//	A disk formatted before there was a journal has none, so we don't
+//	journal anything on it.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    char *data = new char[(MaxRecordSectors + 1) * SectorSize];
+    JournalHeader *header = (JournalHeader *)data;
+    JournalRecord *record = (JournalRecord *)data;
+    int pos, redone = 0;
+
+    synchDisk->ReadSector(JournalSector, data);
+    if (header->magic != JournalMagic) {
+	DEBUG('f', "No journal on the disk.\n");
+	delete [] data;
+	return;
+    }
+    sequence = header->sequence;
+    pos = header->start;
+    for (;;) {
+	if (!ReadRecord(pos, data)) {
+	    if ((pos == 0) || !ReadRecord(0, data))
+		break;
+	    pos = 0;			// it didn't fit at the end
+	}
+	DEBUG('f', "Redoing journal record %d, %d sectors\n", sequence,
+	      record->count);
+	for (int i = 0; i < record->count; i++)
+	    synchDisk->WriteSector(record->sectors[i],
+				   &data[(i + 1) * SectorSize]);
+	pos += 1 + record->count;
+	sequence++;
+	redone++;
+    }
+    delete [] data;
+    DEBUG('f', "Redid %d journal records.\n", redone);
+
+    synchDisk->Sync();			// checkpoint what we redid
+    head = used = 0;
+    WriteHeader();
+    Enable();
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a transaction: until the matching End, the sectors the
+//	current thread writes are part of it.  A transaction started
+//	inside another one (by the same thread) is just part of it; any
+//	other thread waits for the transaction to end.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    if (!enabled)
+	return;
+    if (owner == currentThread) {
+	depth++;
+	return;
+    }
+    lock->Acquire();
+    owner = currentThread;
+    depth = 1;
+    count = 0;
+    overflowed = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	End a transaction.  If it isn't inside another one, write its
+//	record to the journal, and let its sectors go to the disk.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    if (!enabled)
+	return;
+    ASSERT(owner == currentThread);
+    if (--depth > 0)
+	return;
+    Commit();
+    owner = NULL;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Capture
+// 	SynchDisk::WriteSector has just written "sector" into the cache.
+//	Return TRUE if the current thread is in a transaction, which the
+//	sector is now part of: it must then stay pinned in the cache until
+//	the transaction's record is written.  The cache lock is held.
+//----------------------------------------------------------------------
+
+bool
+Journal::Capture(int sector)
+{
+    if (owner != currentThread)
+	return FALSE;
+    for (int i = 0; i < count; i++)
+	if (sectors[i] == sector)
+	    return TRUE;		// written again
+    if (overflowed || (count == limit)) {
+	if (!overflowed)
+	    DEBUG('f', "Transaction too big to journal\n");
+	overflowed = TRUE;
+	return FALSE;
+    }
+    sectors[count++] = sector;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Write all the sectors the records in the journal hold back to
+//	their own places (along with every other dirty sector), and then
+//	empty the journal.  Called by the flusher, in place of
+//	SynchDisk::Sync.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    lock->Acquire();			// no transaction half way through
+    DoCheckpoint();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the current transaction's record to the journal: a
+//	JournalRecord, then a copy of each sector it wrote (which are
+//	still in the cache, pinned), all in one request.  If the log has
+//	no room for it, we checkpoint first.  Then we unpin the sectors,
+//	for the flusher to write back.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    int need = count + 1, pos = head, skip = 0;
+    char *data;
+    JournalRecord *record;
+
+    if (count == 0)
+	return;				// it didn't change anything
+    if (pos + need > LogSectors) {	// start over at the beginning
+	skip = LogSectors - pos;
+	pos = 0;
+    }
+    if (used + skip + need > LogSectors) {
+	DoCheckpoint();
+	pos = skip = 0;
+    }
+
+    data = new char[need * SectorSize];
+    record = (JournalRecord *)data;
+    bzero(data, SectorSize);
+    record->magic = JournalMagic;
+    record->sequence = sequence;
+    record->count = count;
+    for (int i = 0; i < count; i++) {
+	record->sectors[i] = sectors[i];
+	synchDisk->ReadSector(sectors[i], &data[(i + 1) * SectorSize]);
+    }
+    record->checksum = Checksum(data);
+    DEBUG('f', "Journal record %d, %d sectors, at %d\n", sequence, count,
+	  pos);
+    WriteThrough(JournalSector + 1 + pos, need, data);
+    delete [] data;
+
+    head = pos + need;
+    used += skip + need;
+    sequence++;
+    stats->numJournalRecords++;
+    stats->numJournalSectors += count;
+    for (int i = 0; i < count; i++)
+	synchDisk->Unpin(sectors[i]);
+}
+
+//----------------------------------------------------------------------
+// Journal::DoCheckpoint
+// 	Checkpoint, with the lock held (by us, or because it is our own
+//	transaction that needs room in the log).  Sectors still pinned,
+//	which are not in any record yet, are not written back.
+//----------------------------------------------------------------------
+
+void
+Journal::DoCheckpoint()
+{
+    synchDisk->Sync();
+    if (used == 0)
+	return;				// the journal is empty already
+    DEBUG('f', "Journal checkpoint, at record %d\n", sequence);
+    head = used = 0;
+    WriteHeader();
+    stats->numJournalCheckpoints++;
+}
+
+//----------------------------------------------------------------------
+// Journal::ReadRecord
+// 	Read the record at "pos" in the log into "data" (which has room
+//	for the largest one).  Return FALSE if it isn't the next one we
+//	expect, or wasn't written completely.
+//----------------------------------------------------------------------
+
+bool
+Journal::ReadRecord(int pos, char *data)
+{
+    JournalRecord *record = (JournalRecord *)data;
+
+    if (pos >= LogSectors)
+	return FALSE;
+    synchDisk->ReadSector(JournalSector + 1 + pos, data);
+    if ((record->magic != JournalMagic) || (record->sequence != sequence)
+	    || (record->count <= 0) || (record->count > MaxRecordSectors)
+	    || (pos + 1 + record->count > LogSectors))
+	return FALSE;
+    synchDisk->ReadSectors(JournalSector + 2 + pos, record->count,
+			   &data[SectorSize]);
+    return (bool)(Checksum(data) == record->checksum);
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the journal header: the journal starts at "head", with
+//	record "sequence".
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader()
+{
+    char data[SectorSize];
+    JournalHeader *header = (JournalHeader *)data;
+
+    bzero(data, SectorSize);
+    header->magic = JournalMagic;
+    header->sequence = sequence;
+    header->start = head;
+    WriteThrough(JournalSector, 1, data);
+}
+
+//----------------------------------------------------------------------
+// Journal::Enable
+// 	Start journaling, now that there is a journal on the disk: have
+//	the sector cache tell us about the sectors written.  A record can
+//	only hold as many sectors as half the cache, so that pinning them
+//	leaves room for everything else; without a cache, there is no
+//	journaling at all.
+//----------------------------------------------------------------------
+
+void
+Journal::Enable()
+{
+    limit = min(MaxRecordSectors, synchDisk->CacheSize() / 2);
+    enabled = (bool)(limit > 0);
+    if (enabled)
+	synchDisk->SetJournal(this);
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteThrough
+// 	Write "numSectors" sectors from "sector" on, from "data", to the disk
+//	itself (not just the cache), returning once they are written.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteThrough(int sector, int numSectors, char *data)
+{
+    synchDisk->Wait(synchDisk->StartWrite(sector, numSectors, data, NULL, 0));
+}
+
+//----------------------------------------------------------------------
+// Journal::Checksum
+// 	Return the checksum of the record in "data": of its JournalRecord
+//	(but the checksum), and of every sector that follows it.
+//----------------------------------------------------------------------
+
+int
+Journal::Checksum(char *data)
+{
+    JournalRecord *record = (JournalRecord *)data;
+    int saved = record->checksum;
+    int *words = (int *)data;
+    unsigned int sum = 0;
+
+    record->checksum = 0;
+    for (int i = 0; i < (record->count + 1) * SectorSize / (int)sizeof(int);
+									i++)
+	sum = sum * 31 + (unsigned int) words[i];
+    record->checksum = saved;
+    return (int) sum;
+}
@@ -0,0 +1,120 @@
+// journal.h
+//	Data structures for the file system's metadata journal: a small
+//	region of the disk, written sequentially, where the sectors each
+//	file system operation changes (headers, bitmap, directories) are
+//	written first, all together.
+//
+//	Each operation is a transaction.  While it runs, the sectors it
+//	writes stay in the sector cache, pinned (see SynchDisk); when it
+//	is done, they are appended to the journal in one disk request --
+//	a record -- and only then unpinned, for the flusher to write back
+//	to where they belong, along with everything else that is dirty.
+//	Several operations thus cost one sequential write each, instead
+//	of a seek to each sector they change.
+//
+//	Once the flusher has written everything back, the records are no
+//	longer needed: that is a checkpoint, and the journal starts over.
+//	After a crash, the records since the last checkpoint are simply
+//	written again (see Recover), so that each operation either
+//	happened completely or not at all.
+//
+//	On disk, the journal is JournalSectors sectors from JournalSector
+//	on.  The first holds a JournalHeader; the rest is the log, a
+//	circular list of records.  A record is a JournalRecord sector,
+//	followed by a copy of each sector it lists.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "bitmap.h"
+#include "synch.h"
+
+#define JournalSector		2	// where the journal starts (right
+					// after the bitmap and directory
+					// headers)
+#define JournalSectors		64	// how long it is, header included
+#define LogSectors		(JournalSectors - 1)
+#define JournalMagic		0x4a524e4c	// marks a journal sector
+#define MaxRecordSectors	(int)((SectorSize - 4 * sizeof(int)) \
+							/ sizeof(int))
+					// sectors one record can hold
+
+// The following class defines the journal header, the first sector of
+// the journal: where the records not checkpointed yet start.
+
+class JournalHeader {
+  public:
+    int magic;				// JournalMagic
+    int sequence;			// sequence number of the first record
+    int start;				// where it is in the log
+};
+
+// The following class defines the first sector of a record, listing
+// the sectors whose new contents follow it.
+
+class JournalRecord {
+  public:
+    int magic;				// JournalMagic
+    int sequence;			// one more than the record before
+    int count;				// how many sectors follow
+    int checksum;			// of the above, and of all of them, so
+					// a record only partly written is
+					// recognized
+    int sectors[MaxRecordSectors];	// where each one belongs
+};
+
+// The following class defines the journal.
+
+class Journal {
+  public:
+    Journal();				// Nothing is journaled until Format
+    ~Journal();				// or Recover finds a journal
+
+    void Format(BitMap *freeMap);	// Set up an empty journal on a new
+					// disk, marking its sectors in use
+    void Recover();			// Find the journal on the disk, if
+					// any, and redo the records in it
+
+    void Begin();			// Start a transaction (or one inside
+					// the current one)
+    void End();				// End it, writing its record
+    bool Capture(int sector);		// Called by SynchDisk: should
+					// "sector", just written, be kept in
+					// the cache for the transaction?
+    void Checkpoint();			// Write everything cached back, and
+					// empty the journal (the flusher's
+					// job)
+
+  private:
+    bool enabled;			// Is there a journal to write to?
+    Lock *lock;				// One transaction at a time
+    Thread *owner;			// The thread running it
+    int depth;				// How many Begins it is inside
+    int sectors[MaxRecordSectors];	// The sectors it has written
+    int count;
+    int limit;				// How many it may pin in the cache
+    bool overflowed;			// Did it write more?
+    int sequence;			// Sequence number of the next record
+    int head;				// Where it goes in the log
+    int used;				// Log sectors holding records since
+					// the last checkpoint (or skipped)
+
+    void Commit();			// Write the transaction's record
+    void DoCheckpoint();		// Checkpoint, with the lock held
+    bool ReadRecord(int pos, char *data);
+					// Read a record back, if it is whole
+    void WriteHeader();			// Write the journal header
+    void Enable();			// Start journaling
+    void WriteThrough(int sector, int numSectors, char *data);
+					// Write to the disk, not the cache
+    static int Checksum(char *data);	// Checksum of a record
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,485 @@
+// log.cc
+//	Routines to manage the log-structured layout: the inode map, and
+//	the head of the log.  See log.h.
+//
+//	A segment is clean when the bitmap has none of its sectors in
+//	use (and it isn't the current one).  Once the head of the log has
+//	gone through the current segment, it is written to the disk, all
+//	of it in one request, and the head moves on to the next clean
+//	segment after it.  The last ReservedSegments clean segments are
+//	kept for the cleaner; if the head of the log gets that far, the
+//	cleaner is run right away, and the log is full if that doesn't
+//	help.  Sectors moved to the head of the log are just marked in
+//	use there, and cleared where they were.
+//
+//	The inode map is kept in memory, like the bitmap, and written back
+//	(the sectors of it that changed) along with the bitmap.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "log.h"
+#include "system.h"
+
+// The number of inode map entries in each of its sectors.
+#define InodesPerSector		(int)(SectorSize / sizeof(int))
+
+//----------------------------------------------------------------------
+// Log::Log
+// 	Initialize the log.  Its place on the disk is set by Format or
+//	Load.
+//----------------------------------------------------------------------
+
+Log::Log()
+{
+    firstSegment = numSegments = 0;
+    current = -1;
+    head = 0;
+    for (int i = 0; i < NumInodes; i++) {
+	inodes[i] = -1;
+	opens[i] = 0;
+    }
+    for (int j = 0; j < InodeMapSectors; j++)
+	changed[j] = FALSE;
+    cleaner = NULL;
+    cleanerArg = 0;
+    cleaning = FALSE;
+    cleanNeeded = new Semaphore("log cleaner", 0);
+}
+
+//----------------------------------------------------------------------
+// Log::~Log
+// 	De-allocate the log.
+//----------------------------------------------------------------------
+
+Log::~Log()
+{
+    delete cleanNeeded;
+}
+
+//----------------------------------------------------------------------
+// Log::Format
+// 	Set up the log on a disk being formatted: mark the log header and
+//	the inode map as in use in "freeMap", and write them, with no
+//	files yet.  The segments start past them, and past the "reserved"
+//	sectors the bitmap and directory files are about to be given (so
+//	those never move either), on a track boundary.
+//----------------------------------------------------------------------
+
+void
+Log::Format(BitMap *freeMap, int reserved)
+{
+    char data[SectorSize];
+    LogHeader *header = (LogHeader *)data;
+    int i;
+
+    for (i = 0; i <= InodeMapSectors; i++)
+	freeMap->Mark(LogSector + i);
+    firstSegment = divRoundUp(LogSector + 1 + InodeMapSectors + reserved,
+			      SegmentSectors) * SegmentSectors;
+    numSegments = (NumSectors - firstSegment) / SegmentSectors;
+    ASSERT(numSegments > MinCleanSegments);
+
+    bzero(data, SectorSize);
+    header->magic = LogMagic;
+    header->firstSegment = firstSegment;
+    synchDisk->WriteSector(LogSector, data);
+    for (i = 0; i < NumInodes; i++)
+	inodes[i] = -1;
+    for (i = 0; i < InodeMapSectors; i++)
+	changed[i] = TRUE;
+    WriteBack();
+}
+
+//----------------------------------------------------------------------
+// Log::Load
+// 	Find the log when Nachos starts up, and read in the inode map.
+//	Return FALSE if the disk wasn't formatted with one.  The head of
+//	the log starts out in a clean segment, whatever segment it was in
+//	before.
+//----------------------------------------------------------------------
+
+bool
+Log::Load()
+{
+    char data[SectorSize];
+    LogHeader *header = (LogHeader *)data;
+
+    synchDisk->ReadSector(LogSector, data);
+    if (header->magic != LogMagic)
+	return FALSE;
+    firstSegment = header->firstSegment;
+    numSegments = (NumSectors - firstSegment) / SegmentSectors;
+    FetchFrom();
+    DEBUG('f', "Log-structured disk, %d segments from sector %d\n",
+	  numSegments, firstSegment);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Log::Locate
+// 	Return the sector holding the header of file "inumber", or -1 if
+//	there is no such file.  The headers of the bitmap and the root
+//	directory are in the sectors of the same numbers.
+//----------------------------------------------------------------------
+
+int
+Log::Locate(int inumber)
+{
+    ASSERT((inumber >= 0) && (inumber < NumInodes));
+    if (!IsLogged(inumber))
+	return inumber;
+    return inodes[inumber];
+}
+
+//----------------------------------------------------------------------
+// Log::NewInode
+// 	Return an inode number for a new file, or -1 if they are all in
+//	use.  It isn't in use until PlaceHeader gives it a header.  An
+//	inode whose file was removed while still open isn't reused until
+//	it is closed.
+//----------------------------------------------------------------------
+
+int
+Log::NewInode()
+{
+    for (int i = FirstLoggedInode; i < NumInodes; i++)
+	if ((inodes[i] == -1) && (opens[i] == 0))
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Log::PlaceHeader
+// 	Return the sector to write the header of file "inumber" to, now
+//	that it has changed: a new sector at the head of the log (the old
+//	one is freed, and the inode map updated), unless it is fresh
+//	already.  If the log is full, the header is written where it is;
+//	-1 means a new file can't be given one.
+//----------------------------------------------------------------------
+
+int
+Log::PlaceHeader(BitMap *freeMap, int inumber)
+{
+    int old = inodes[inumber];
+    int sector;
+
+    ASSERT(IsLogged(inumber));
+    if ((old != -1) && IsFresh(old))
+	return old;
+    sector = Allocate(freeMap);
+    if (sector == -1)
+	return old;
+    if (old != -1)
+	freeMap->Clear(old);
+    inodes[inumber] = sector;
+    changed[inumber / InodesPerSector] = TRUE;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// Log::FreeInode
+// 	File "inumber" has been removed (and its header freed).
+//----------------------------------------------------------------------
+
+void
+Log::FreeInode(int inumber)
+{
+    ASSERT(IsLogged(inumber));
+    inodes[inumber] = -1;
+    changed[inumber / InodesPerSector] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Log::FetchFrom
+// 	Read the inode map in from the disk, throwing away any changes
+//	not written back.
+//----------------------------------------------------------------------
+
+void
+Log::FetchFrom()
+{
+    synchDisk->ReadSectors(LogSector + 1, InodeMapSectors, (char *)inodes);
+    for (int j = 0; j < InodeMapSectors; j++)
+	changed[j] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Log::WriteBack
+// 	Write the sectors of the inode map that changed back to the disk.
+//----------------------------------------------------------------------
+
+void
+Log::WriteBack()
+{
+    for (int j = 0; j < InodeMapSectors; j++)
+	if (changed[j]) {
+	    synchDisk->WriteSector(LogSector + 1 + j,
+				   (char *)&inodes[j * InodesPerSector]);
+	    changed[j] = FALSE;
+	}
+}
+
+//----------------------------------------------------------------------
+// Log::Allocate
+// 	Return the next free sector at the head of the log, marked in use
+//	in "freeMap", moving the head on to a new segment if the current
+//	one is used up.  Return -1 if the disk is full.
+//----------------------------------------------------------------------
+
+int
+Log::Allocate(BitMap *freeMap)
+{
+    for (;;) {
+	if (current != -1) {
+	    int end = SegmentStart(current) + SegmentSectors;
+
+	    while ((head < end) && freeMap->Test(head))
+		head++;
+	    if (head < end) {
+		freeMap->Mark(head);
+		return head++;
+	    }
+	}
+	if (!NextSegment(freeMap))
+	    return -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// Log::Reserve
+// 	Return TRUE if "count" sectors can be allocated, running the
+//	cleaner first if they can't.
+//----------------------------------------------------------------------
+
+bool
+Log::Reserve(BitMap *freeMap, int count)
+{
+    if (NumFree(freeMap) < count)
+	Clean();
+    return (bool)(NumFree(freeMap) >= count);
+}
+
+//----------------------------------------------------------------------
+// Log::IsFresh
+// 	Return TRUE if "sector" has been allocated in the current segment:
+//	writing it again is as good as writing at the head of the log.
+//----------------------------------------------------------------------
+
+bool
+Log::IsFresh(int sector)
+{
+    return (bool)((current != -1) && (sector >= SegmentStart(current))
+		  && (sector < head));
+}
+
+//----------------------------------------------------------------------
+// Log::Rewrite
+// 	A file is about to write "sector" again.  Unless it is fresh, give
+//	it a new sector at the head of the log instead, freeing the old
+//	one, and return that; the caller copies whatever it needs of the
+//	old contents, and points the file at the new sector.  If the log
+//	is full, the sector is written where it is.
+//----------------------------------------------------------------------
+
+int
+Log::Rewrite(BitMap *freeMap, int sector)
+{
+    int moved;
+
+    if (IsFresh(sector))
+	return sector;
+    moved = Allocate(freeMap);
+    if (moved == -1)
+	return sector;
+    ASSERT(freeMap->Test(sector));	// ought to be marked!
+    freeMap->Clear(sector);
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// Log::SetCleaner
+// 	"func(arg)" is to be called, with the file system locked, to clean
+//	segments.
+//----------------------------------------------------------------------
+
+void
+Log::SetCleaner(VoidFunctionPtr func, _int arg)
+{
+    cleaner = func;
+    cleanerArg = arg;
+}
+
+//----------------------------------------------------------------------
+// Log::Clean
+// 	Clean segments now.  The cleaner allocates sectors itself, to
+//	move the ones it cleans out into, which may bring us back here:
+//	then, it is already running, and may use the reserved segments.
+//----------------------------------------------------------------------
+
+void
+Log::Clean()
+{
+    if (cleaning || (cleaner == NULL))
+	return;
+    cleaning = TRUE;
+    (*cleaner)(cleanerArg);
+    cleaning = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Log::WaitForCleaning
+// 	Wait until the head of the log goes on to a new segment, with few
+//	clean ones left.
+//----------------------------------------------------------------------
+
+void
+Log::WaitForCleaning()
+{
+    cleanNeeded->P();
+}
+
+//----------------------------------------------------------------------
+// Log::NeedsCleaning
+// 	Return TRUE if there are fewer than MinCleanSegments clean segments.
+//----------------------------------------------------------------------
+
+bool
+Log::NeedsCleaning(BitMap *freeMap)
+{
+    return (bool)(NumClean(freeMap) < MinCleanSegments);
+}
+
+//----------------------------------------------------------------------
+// Log::PickVictim
+// 	Return the segment the cleaner should clean next: the one with
+//	the fewest sectors still in use (but some), among those "tried"
+//	doesn't mark, which it then does.  Return -1 if none of them is
+//	worth cleaning.
+//----------------------------------------------------------------------
+
+int
+Log::PickVictim(BitMap *freeMap, bool *tried)
+{
+    int best = -1, fewest = MaxLiveSectors + 1;
+
+    for (int segment = 0; segment < numSegments; segment++) {
+	int live;
+
+	if ((segment == current) || tried[segment])
+	    continue;
+	live = LiveSectors(freeMap, segment);
+	if ((live > 0) && (live < fewest)) {
+	    best = segment;
+	    fewest = live;
+	}
+    }
+    if (best != -1)
+	tried[best] = TRUE;
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Log::LiveSectors
+// 	Return how many sectors of "segment" are in use.
+//----------------------------------------------------------------------
+
+int
+Log::LiveSectors(BitMap *freeMap, int segment)
+{
+    int start = SegmentStart(segment);
+    int live = 0;
+
+    for (int sector = start; sector < start + SegmentSectors; sector++)
+	if (freeMap->Test(sector))
+	    live++;
+    return live;
+}
+
+//----------------------------------------------------------------------
+// Log::NumClean
+// 	Return how many segments are clean, not counting the current one.
+//----------------------------------------------------------------------
+
+int
+Log::NumClean(BitMap *freeMap)
+{
+    int clean = 0;
+
+    for (int segment = 0; segment < numSegments; segment++)
+	if ((segment != current) && (LiveSectors(freeMap, segment) == 0))
+	    clean++;
+    return clean;
+}
+
+//----------------------------------------------------------------------
+// Log::NumFree
+// 	Return how many sectors Allocate can give out before the log is
+//	full: what is left of the current segment, and the clean segments
+//	(but the reserved ones, unless the cleaner is asking).
+//----------------------------------------------------------------------
+
+int
+Log::NumFree(BitMap *freeMap)
+{
+    int clean = NumClean(freeMap);
+    int count = 0;
+
+    if (current != -1)
+	for (int sector = head; sector < SegmentStart(current) + SegmentSectors;
+								sector++)
+	    if (!freeMap->Test(sector))
+		count++;
+    if (!cleaning)
+	clean = max(clean - ReservedSegments, 0);
+    return count + clean * SegmentSectors;
+}
+
+//----------------------------------------------------------------------
+// Log::NextSegment
+// 	The current segment is used up: write it to the disk (all the
+//	sectors of it still in the cache, in one request), and move the
+//	head of the log to the next clean segment after it.  If that
+//	leaves few clean segments, wake up the cleaner thread; if only the
+//	reserved ones are left, run the cleaner first.
+//
+//	Return FALSE if there is no clean segment to go on to.
+//----------------------------------------------------------------------
+
+bool
+Log::NextSegment(BitMap *freeMap)
+{
+    int previous = current;
+    int clean, segment, i;
+
+    if (current != -1) {
+	synchDisk->SyncSectors(SegmentStart(current), SegmentSectors);
+	stats->numLogSegments++;
+	current = -1;
+    }
+    clean = NumClean(freeMap);
+    if ((clean <= ReservedSegments) && !cleaning) {
+	DEBUG('f', "Log almost full, cleaning\n");
+	Clean();
+	if (current != -1)
+	    return TRUE;		// the cleaner moved the head on
+	clean = NumClean(freeMap);
+    }
+    if ((clean == 0) || ((clean <= ReservedSegments) && !cleaning))
+	return FALSE;			// the disk is full
+
+    for (i = 1; i <= numSegments; i++) {
+	segment = (previous + i) % numSegments;
+	if (LiveSectors(freeMap, segment) == 0)
+	    break;
+    }
+    ASSERT(i <= numSegments);
+    DEBUG('f', "Log head moves to segment %d\n", segment);
+    current = segment;
+    head = SegmentStart(segment);
+    if (clean - 1 < MinCleanSegments)
+	cleanNeeded->V();
+    return TRUE;
+}
@@ -0,0 +1,161 @@
+// log.h
+//	Data structures for the log-structured layout of the file system,
+//	which a disk can be given when it is formatted (-lfs).
+//
+//	Normally a file's sectors stay where they were allocated, and each
+//	write goes back to them, so writing a few sectors of many files
+//	(or of one big one) means a seek for each.  In the log-structured
+//	layout, the disk past the fixed part (bitmap, directory, journal)
+//	is cut into segments, one track each, and everything written to
+//	a file -- its data, its index blocks, its header -- goes to the
+//	next free sector of the current segment, the head of the log,
+//	wherever it was before.  The old copy is simply freed.  Writes
+//	thus go to the disk in order, a segment at a time, at the speed
+//	the disk reads and writes a whole track.
+//
+//	Since a file's header moves too, directories don't hold the
+//	sector of a header, but an inode number; the inode map, kept in
+//	the sectors after the log header, says where each header is now.
+//	The bitmap and the root directory don't move: they are inodes 0
+//	and 1, with their headers in sectors 0 and 1, as always.
+//
+//	The log is only written into clean segments, ones with every
+//	sector free.  Once few are left, the cleaner takes the segment
+//	with the fewest sectors still in use, and moves those to the head
+//	of the log (see FileSystem::CleanSegments); the segment is then
+//	clean.  The bitmap says which sectors are still in use, so no
+//	segment summaries are needed: the disk is small enough for the
+//	cleaner to find the files using a segment by going through the
+//	inode map.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef LOG_H
+#define LOG_H
+
+#include "disk.h"
+#include "bitmap.h"
+#include "journal.h"
+
+#define LogSector		(JournalSector + JournalSectors)
+					// where the log header is (right
+					// after the journal); the inode map
+					// follows it
+#define InodeMapSectors		4
+#define NumInodes		(int)(InodeMapSectors * SectorSize \
+								/ sizeof(int))
+#define FirstLoggedInode	2	// inodes before this (the bitmap and
+					// the root directory) never move
+#define LogMagic		0x4c4f4753	// marks the log header
+#define SegmentSectors		SectorsPerTrack
+#define MinCleanSegments	4	// the cleaner keeps this many clean
+#define ReservedSegments	1	// only the cleaner may use the last
+					// one(s), to move sectors into
+#define MaxLiveSectors		(SegmentSectors * 3 / 4)
+					// a segment with more sectors in use
+					// isn't worth cleaning
+
+// The following class defines the log header, which says where the
+// segments start.
+
+class LogHeader {
+  public:
+    int magic;				// LogMagic
+    int firstSegment;			// the sector the first segment
+					// starts at
+};
+
+// The following class defines the log: the inode map, and where the
+// head of the log is.  Every routine that changes anything must be
+// called with the file system locked for writing (see
+// FileSystem::AcquireFreeMap).
+
+class Log {
+  public:
+    Log();				// The log is set up by Format or Load
+    ~Log();
+
+    void Format(BitMap *freeMap, int reserved);
+					// Set up the log on a new disk,
+					// marking its sectors in use;
+					// "reserved" more sectors, for the
+					// bitmap and directory, go before
+					// the first segment
+    bool Load();			// Find the log on the disk; FALSE if
+					// the disk doesn't have one
+
+    bool IsLogged(int inumber) { return (bool)(inumber >= FirstLoggedInode); }
+					// Does this file's header move?
+    int Locate(int inumber);		// Where its header is now, -1 if
+					// there is no such file
+    int NewInode();			// A free inode number, -1 if none
+    int PlaceHeader(BitMap *freeMap, int inumber);
+					// Where to write the header, once it
+					// has changed, -1 if there is no room
+    void FreeInode(int inumber);	// The file has been removed
+    void FetchFrom();			// Read the inode map in again
+    void WriteBack();			// Write the inode map back, if it
+					// changed
+
+    int Allocate(BitMap *freeMap);	// A sector at the head of the log,
+					// -1 if the disk is full
+    bool Reserve(BitMap *freeMap, int count);
+					// Can "count" be allocated?
+    bool IsFresh(int sector);		// Has it been allocated in the
+					// current segment?  (If so, it can be
+					// written where it is.)
+    int Rewrite(BitMap *freeMap, int sector);
+					// Move a sector about to be written to
+					// the head of the log, unless it is
+					// fresh; return where it is now
+
+    void Opened(int inumber) { opens[inumber]++; }
+    void Closed(int inumber) { opens[inumber]--; }
+    bool IsOpen(int inumber) { return (bool)(opens[inumber] > 0); }
+					// The cleaner leaves files that are
+					// open alone, as their headers are in
+					// memory
+
+    void SetCleaner(VoidFunctionPtr func, _int arg);
+					// What cleans segments, when we
+					// run out
+    void Clean();			// Call it (unless it is running)
+    void WaitForCleaning();		// Wait until clean segments run low
+					// (the cleaner thread)
+    bool NeedsCleaning(BitMap *freeMap);
+					// Are there too few clean segments?
+    int PickVictim(BitMap *freeMap, bool *tried);
+					// The segment to clean next, -1 if
+					// none (not "tried" yet) is worth it
+    int SegmentStart(int segment)
+		{ return firstSegment + segment * SegmentSectors; }
+    int LiveSectors(BitMap *freeMap, int segment);
+					// How many of its sectors are in use
+
+  private:
+    int firstSegment;			// Where the segments start
+    int numSegments;
+    int current;			// The segment at the head of the log,
+					// -1 if none yet
+    int head;				// The next sector to try in it
+    int inodes[NumInodes];		// The inode map: where each header
+					// is, -1 if the inode is free
+    bool changed[InodeMapSectors];	// Which of its sectors must be
+					// written back
+    int opens[NumInodes];		// How many OpenFiles each file has
+    VoidFunctionPtr cleaner;		// Moves sectors out of segments
+    _int cleanerArg;
+    bool cleaning;			// Is it running?
+    Semaphore *cleanNeeded;		// The cleaner thread waits on this
+
+    int NumClean(BitMap *freeMap);	// How many segments are clean
+    int NumFree(BitMap *freeMap);	// How many sectors can be allocated
+    bool NextSegment(BitMap *freeMap);	// Move the head of the log on to
+					// the next clean segment
+};
+
+#endif // LOG_H
@@ -14,21 +14,41 @@
 #include "copyright.h"
 #include "filehdr.h"
 #include "openfile.h"
+#include "log.h"
 #include "system.h"
 
+ResidentPage *OpenFile::residentPages[ResidentBuckets];
+int OpenFile::numResident = 0;
+
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
 //	into memory while the file is open.
 //
+//	On a log-structured disk, "sector" is an inode number, and the log
+//	says where the header is (cf. log.h).  It is told the file is open,
+//	so the cleaner leaves it alone.
+//
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
     hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    log = (fileSystem != NULL) ? fileSystem->GetLog() : NULL;
+    if ((log != NULL) && !log->IsLogged(sector))
+	log = NULL;
+    inumber = sector;
+    if (log != NULL) {
+	hdr->FetchFrom(log->Locate(sector));
+	log->Opened(sector);
+    } else
+	hdr->FetchFrom(sector);
     seekPosition = 0;
+    sequentialEnd = 0;
+    readAheadWindow = 0;
+    readAheadSector = 0;
+    headerChanges = (fileSystem != NULL) ? fileSystem->HeaderChanges() : 0;
 }
 
 //----------------------------------------------------------------------
@@ -38,6 +58,8 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
+    if (log != NULL)
+	log->Closed(inumber);
     delete hdr;
 }
 
@@ -95,13 +117,28 @@ OpenFile::Write(char *into, int numBytes)
 //	sector at a time.  Thus:
 //
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   We read the full sectors that are part of the request straight
+//	   into the caller's buffer (each run of them that is consecutive
+//	   on disk is a single disk request).  A partial sector (only the first and
+//	   last can be) is read into the OpenFile's sector buffer, and we
+//	   only copy the part we are interested in.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   Full sectors are written straight from the caller's buffer, in
+//	   runs, as for ReadAt.  For
+//	   a sector that will be partially written, we must first read it
+//	   into the sector buffer, so that we don't overwrite the unmodified
+//	   portion; we then copy in the data that will be modified, and
+//	   write it back.
+//
+//	A sector of a page that is mapped into memory (see MapPage) is
+//	copied from, or to, the frame that holds it instead.
+//
+//	Before WriteAt writes a sector that a clone shares, it gives the
+//	file a copy of its own (see Unshare); if there is no room for
+//	that, it writes only as far as the sector before.
+//
+//	So there is no allocation per call; but two threads must not use
+//	the same OpenFile at once (they would share its sector buffer).
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -114,8 +151,9 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int i, firstSector, lastSector;
+    int start, end, diskSector, run;
+    ResidentPage *r;
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
@@ -123,20 +161,29 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 	numBytes = fileLength - position;
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
+    Sharing();
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    for (i = firstSector; i <= lastSector; i++) {
+	start = max(position, i * SectorSize);
+	end = min(position + numBytes, (i + 1) * SectorSize);
+	diskSector = hdr->ByteToSector(i * SectorSize);
+	if ((r = Resident(i)) != NULL)		// mapped: the frame has it
+	    bcopy(&r->memory[start - i * SectorSize], &into[start - position],
+		  end - start);
+	else if (end - start == SectorSize) {	// a run of full sectors
+	    run = FullRun(i, position + numBytes, diskSector);
+	    synchDisk->ReadSectors(diskSector, run, &into[start - position]);
+	    i += run - 1;
+	} else {					// copy the part we want
+	    synchDisk->ReadSector(diskSector, sectorBuf);
+	    bcopy(&sectorBuf[start - i * SectorSize], &into[start - position],
+		  end - start);
+	}
+    }
+    ReadAhead(position, numBytes);
     return numBytes;
 }
 
@@ -144,9 +191,9 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int i, firstSector, lastSector;
+    int start, end, diskSector, run;
+    ResidentPage *r;
 
     if ((numBytes <= 0) || (position >= fileLength))  // For original Nachos file system
 //    if ((numBytes <= 0) || (position > fileLength))  // For lab4 ...  
@@ -158,29 +205,248 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    if (Sharing()) {
+	lastSector = Unshare(firstSector, lastSector) - 1;
+	if (lastSector < firstSector)
+	    return 0;			// no room to copy the first sector
+	numBytes = min(numBytes, (lastSector + 1) * SectorSize - position);
+    }
 
-    buf = new char[numSectors * SectorSize];
+    for (i = firstSector; i <= lastSector; i++) {
+	start = max(position, i * SectorSize);
+	end = min(position + numBytes, (i + 1) * SectorSize);
+	diskSector = hdr->ByteToSector(i * SectorSize);
+	if ((r = Resident(i)) != NULL) {	// mapped: write the frame
+	    bcopy(&from[start - position], &r->memory[start - i * SectorSize],
+		  end - start);
+	    r->dirty = TRUE;
+	} else if (end - start == SectorSize) {	// a run of full sectors
+	    run = FullRun(i, position + numBytes, diskSector);
+	    synchDisk->WriteSectors(diskSector, run, &from[start - position]);
+	    i += run - 1;
+	} else {					// read, modify, write
+	    synchDisk->ReadSector(diskSector, sectorBuf);
+	    bcopy(&from[start - position], &sectorBuf[start - i * SectorSize],
+		  end - start);
+	    synchDisk->WriteSector(diskSector, sectorBuf);
+	}
+    }
+    return numBytes;
+}
 
-    firstAligned = (bool)(position == (firstSector * SectorSize));
-    lastAligned = (bool)((position + numBytes) == ((lastSector + 1) * SectorSize));
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	After reading "numBytes" at "position", guess what will be read
+//	next, and ask the disk to start reading it into the sector cache.
+//
+//	If this read starts where the last one ended, the file is being
+//	read sequentially, so we read ahead the next readAheadWindow
+//	sectors after it -- InitialReadAhead at first, doubling with each
+//	sequential read, up to MaxReadAhead.  Any other read stops the
+//	read-ahead, until the reads are sequential again.  We only ask
+//	for sectors we haven't asked for already.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int position, int numBytes)
+{
+    int fileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int next = divRoundUp(position + numBytes, SectorSize);
+    int i, to, diskSector, run;
 
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
+    if (position != sequentialEnd) {	// a random read
+	sequentialEnd = position + numBytes;
+	readAheadWindow = 0;
+	readAheadSector = 0;
+	return;
+    }
+    sequentialEnd = position + numBytes;
+    if (readAheadWindow == 0)
+	readAheadWindow = InitialReadAhead;
+    else
+	readAheadWindow = min(2 * readAheadWindow, MaxReadAhead);
 
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+    to = min(next + readAheadWindow, fileSectors);
+    for (i = max(next, readAheadSector); i < to; i += run) {
+	diskSector = hdr->ByteToSector(i * SectorSize);
+	for (run = 1; (i + run < to) &&
+	    (hdr->ByteToSector((i + run) * SectorSize) == diskSector + run);
+								run++)
+	    ;
+	synchDisk->ReadAhead(diskSector, run);
+    }
+    readAheadSector = max(readAheadSector, to);
+}
 
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
-    return numBytes;
+//----------------------------------------------------------------------
+// OpenFile::FullRun
+// 	Return how many sectors of the file, starting with sector "i"
+//	(which is at "diskSector" on disk, and is wholly part of a
+//	request that ends at byte "end"), are wholly part of the request
+//	and consecutive on disk, and not mapped, so can be transferred
+//	all at once.
+//----------------------------------------------------------------------
+
+int
+OpenFile::FullRun(int i, int end, int diskSector)
+{
+    int run;
+
+    for (run = 1; ((i + run + 1) * SectorSize <= end) &&
+	    (hdr->ByteToSector((i + run) * SectorSize) == diskSector + run)
+	    && (Resident(i + run) == NULL);			run++)
+	;
+    return run;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Resident
+// 	Return the entry for page "page" of this file if it is mapped
+//	into memory, NULL if it isn't.  Nothing to look through, unless
+//	some file is mapped.
+//----------------------------------------------------------------------
+
+ResidentPage *
+OpenFile::Resident(int page)
+{
+    ResidentPage *r;
+
+    if (numResident == 0)
+	return NULL;
+    for (r = residentPages[(inumber + page) % ResidentBuckets]; r != NULL;
+	    r = r->next)
+	if ((r->inumber == inumber) && (r->page == page))
+	    return r;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Sharing
+// 	Return TRUE if some file has been cloned (cf. FileSystem::Clone),
+//	so this one's sectors may be shared.  If since the header was read
+//	an OpenFile has given a sector a copy of its own, and written its
+//	header back, it might have been this file's: read it in again.
+//	(Clones are never made on a log-structured disk.)
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Sharing()
+{
+    if ((fileSystem == NULL) || (fileSystem->GetShares() == NULL))
+	return FALSE;
+    if (headerChanges != fileSystem->HeaderChanges()) {
+	headerChanges = fileSystem->HeaderChanges();
+	hdr->FetchFrom(inumber);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Unshare
+// 	Copy on write: before sectors "first" to "last" of the file are
+//	written, give each that is shared with another file a sector of
+//	its own (cf. FileHeader::Unshare), and write the header back.
+//	Return the first one left shared, for want of a free sector --
+//	"last" + 1, if none is.  Nothing is locked unless some are shared.
+//----------------------------------------------------------------------
+
+int
+OpenFile::Unshare(int first, int last)
+{
+    unsigned char *shares = fileSystem->GetShares();
+    BitMap *freeMap;
+    bool changed = FALSE;
+    int i, sector, newSector;
+
+    for (i = first; i <= last; i++)
+	if (shares[hdr->ByteToSector(i * SectorSize)] > 0)
+	    break;
+    if (i > last)
+	return i;			// none is shared
+    freeMap = fileSystem->AcquireFreeMap();
+    Sharing();				// another OpenFile of it may have
+					// copied them, while we waited
+    for (i = first; i <= last; i++) {
+	sector = hdr->ByteToSector(i * SectorSize);
+	if ((newSector = hdr->Unshare(freeMap, shares, i)) == -1)
+	    break;			// the disk is full
+	if (newSector != sector)
+	    changed = TRUE;
+    }
+    if (changed) {
+	hdr->WriteBack(inumber);
+	fileSystem->SharesChanged();
+	headerChanges = fileSystem->HeaderChanges();
+    }
+    fileSystem->ReleaseFreeMap(changed);
+    return i;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::MapPage
+// 	Read "numBytes" (at most a sector) of the file, at "position"
+//	(the start of a sector), into "into", which is a frame the page
+//	is being mapped into.  From now on the frame is the page's only
+//	cached copy: the sector cache forgets its own (if it was dirty,
+//	so is the page), and ReadAt and WriteAt use the frame, until
+//	UnmapPage.
+//
+//	If the page is mapped already, into another address space, that
+//	frame stays its copy, and this one is just read from it.  A page
+//	whose sector is shared with a clone is given its own first, so
+//	that the frame is only ever this file's.
+//----------------------------------------------------------------------
+
+void
+OpenFile::MapPage(char *into, int numBytes, int position)
+{
+    int page = position / SectorSize;
+    ResidentPage *r;
+
+    ASSERT((position % SectorSize == 0) && (numBytes <= SectorSize));
+    ReadAt(into, numBytes, position);
+    if ((numBytes <= 0) || (Resident(page) != NULL))
+	return;
+    if (Sharing() && (Unshare(page, page) == page))
+	return;				// no room: just a copy, then
+    r = new ResidentPage;
+    r->inumber = inumber;
+    r->page = page;
+    r->memory = into;
+    r->dirty = synchDisk->Forget(hdr->ByteToSector(position));
+    r->next = residentPages[(inumber + page) % ResidentBuckets];
+    residentPages[(inumber + page) % ResidentBuckets] = r;
+    numResident++;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::UnmapPage
+// 	The page of the file at "position" is leaving the frame "from"
+//	it was mapped into.  If the frame was its copy, the sector cache
+//	is again: if ReadAt or WriteAt changed it in the meantime, write
+//	it back.  (Writing back what was written through the mapping is
+//	up to the caller, which knows whether it was.)  The file may have
+//	been cloned since it was mapped, so the sector may be shared, and
+//	need a copy of its own first.
+//----------------------------------------------------------------------
+
+void
+OpenFile::UnmapPage(char *from, int position)
+{
+    int page = position / SectorSize;
+    ResidentPage *r, **ptr;
+
+    for (ptr = &residentPages[(inumber + page) % ResidentBuckets];
+	    (r = *ptr) != NULL; ptr = &r->next)
+	if ((r->inumber == inumber) && (r->page == page))
+	    break;
+    if ((r == NULL) || (r->memory != from))	// a copy, not the page
+	return;
+    *ptr = r->next;
+    numResident--;
+    if (r->dirty && (!Sharing() || (Unshare(page, page) > page)))
+	synchDisk->WriteSector(hdr->ByteToSector(position), from);
+    delete r;
 }
 
 //----------------------------------------------------------------------
@@ -193,3 +459,17 @@ OpenFile::Length()
 { 
     return hdr->FileLength(); 
 }
+
+//----------------------------------------------------------------------
+// OpenFile::Preallocate
+// 	Return TRUE if the file has sectors for its first "size" bytes.
+//	Files here get all their sectors when they are created, and can't
+//	grow, so there is nothing to allocate.
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Preallocate(int size)
+{
+    return (bool)(size <= divRoundUp(hdr->FileLength(), SectorSize)
+							* SectorSize);
+}
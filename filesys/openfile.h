@@ -22,6 +22,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "disk.h"
 
 #ifdef FILESYS_STUB			// Temporarily implement calls to 
 					// Nachos file system as calls to UNIX!
@@ -52,6 +53,10 @@ class OpenFile {
 		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+
+    void MapPage(char *into, int numBytes, int position)
+		{ ReadAt(into, numBytes, position); }
+    void UnmapPage(char *from, int position) {}
     
   private:
     int file;
@@ -60,6 +65,28 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class Log;
+
+#define InitialReadAhead	2	// sectors read ahead, at first
+#define MaxReadAhead		16	// ... and at most
+#define ResidentBuckets		64	// buckets in the table of resident
+					// pages
+
+// The following class defines a page of a file that is mapped into
+// memory: the frame that holds it is its only cached copy (the sector
+// cache drops its own), so ReadAt and WriteAt go to the frame instead,
+// until the page is unmapped.  Pages are kept by the file's header
+// sector, so every OpenFile of the file finds them.
+
+class ResidentPage {
+  public:
+    int inumber;			// the file's header sector
+    int page;				// which page of the file
+    char *memory;			// where it is
+    bool dirty;				// written since it was mapped, other
+					// than through the mapping?
+    ResidentPage *next;			// the next in the same bucket
+};
 
 class OpenFile {
   public:
@@ -85,10 +112,57 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+    bool Preallocate(int size);		// Have sectors for "size" bytes?
+    void WriteBack() {}			// Write the header back (nothing to
+					// do: it only changes in Unshare,
+					// which writes it back itself)
+
+    void MapPage(char *into, int numBytes, int position);
+					// Read the page of the file at
+					// "position" into memory, to be
+					// mapped, and make that its only copy
+    void UnmapPage(char *from, int position);
+					// It is no longer mapped: write it
+					// back, if ReadAt/WriteAt changed it
+
+    static void Removed(int sector) {}	// The file at "sector" has been
+					// removed (nothing to do: each
+					// OpenFile has its own header, never
+					// written back)
     
   private:
     FileHeader *hdr;			// Header for this file 
+    Log *log;				// The log, if the header is in it
+    int inumber;			// Where the directory says it is
     int seekPosition;			// Current position within the file
+    char sectorBuf[SectorSize];		// For the partial sectors of a
+					// ReadAt or WriteAt
+    int sequentialEnd;			// Where the last read ended
+    int readAheadWindow;		// How many sectors to read ahead of
+					// a sequential read (0 after a
+					// random one)
+    int readAheadSector;		// Sectors before this one have been
+					// read ahead already
+    int headerChanges;			// FileSystem::HeaderChanges(), when
+					// the header was read
+
+    void ReadAhead(int position, int numBytes);
+					// Read ahead, if reads are sequential
+    int FullRun(int i, int end, int diskSector);
+					// How many sectors from "i" on
+					// can be transferred at once
+    ResidentPage *Resident(int page);	// Page "page" of this file, if it
+					// is mapped into memory
+    bool Sharing();			// Might its sectors be shared? (and
+					// read the header in again, if it
+					// might have changed)
+    int Unshare(int first, int last);	// Give the sectors from "first" to
+					// "last" a copy of their own, if
+					// shared
+
+    static ResidentPage *residentPages[ResidentBuckets];
+    static int numResident;		// How many pages are mapped, of any
+					// file
 };
 
 #endif // FILESYS
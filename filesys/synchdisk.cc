@@ -5,10 +5,36 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	The physical disk can only handle one operation at a time, so
+//	requests made while it is busy wait in a queue, and each time the
+//	disk interrupt says a request is done, the next one is picked off
+//	the queue and started.  Which one is up to the disk scheduling
+//	policy: taking them in arrival order makes the disk head wander
+//	back and forth, while the others keep the seeks short.
+//
+//	The queue is shared with the interrupt handler, so it is
+//	protected by disabling interrupts, as in Semaphore::P.
+//
+//	Above all that is the sector cache: a hash table of buffers, by
+//	sector, with the buffers also on an LRU list, from whose end the
+//	buffer for a sector that isn't cached is taken.  Writes are only
+//	written back to the disk when a buffer is taken for another
+//	sector, or by the flusher thread, or by Sync.  While a buffer is
+//	being read or written it is marked busy, so that the lock on the
+//	cache need not be held while waiting for the disk.
+//
+//	A request can be for a run of consecutive sectors, which the disk
+//	does in one go, rather than paying for a seek and an interrupt per
+//	sector.  Sync writes runs of dirty sectors that way, and ReadSectors
+//	reads the sectors that aren't cached that way.
+//
+//	An asynchronous request is queued just the same, but no thread
+//	sleeps on it: when the disk is done with it, the interrupt
+//	handler counts it off the request's handle, and once they are all
+//	done, calls the callback and signals the handle's semaphore.  It
+//	goes through the cache as far as it can without waiting for the
+//	disk: cached sectors are copied from (or into) the cache, others
+//	are read (or written) straight to (or from) the caller's buffer.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +42,8 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "journal.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -26,9 +54,34 @@
 static void
 DiskRequestDone (_int arg)
 {
-    SynchDisk* dsk = (SynchDisk *)arg;	// disk -> dsk
+    DiskArm *arm = (DiskArm *)arg;
+
+    arm->owner->RequestDone(arm);
+}
+
+//----------------------------------------------------------------------
+// DiskFlusher, DiskFlushDue
+// 	The body of the flusher thread, and the handler for the timer
+//	interrupt that wakes it up.  These are C routines for the same
+//	reason as DiskRequestDone.
+//----------------------------------------------------------------------
+
+static void
+DiskFlusher(_int arg)
+{
+    ((SynchDisk *)arg)->Flusher();
+}
+
+static void
+DiskFlushDue(_int arg)
+{
+    ((SynchDisk *)arg)->FlushDue();
+}
 
-    dsk->RequestDone();					// disk -> dsk
+static void
+DiskReadAheader(_int arg)
+{
+    ((SynchDisk *)arg)->ReadAheader();
 }
 
 //----------------------------------------------------------------------
@@ -36,15 +89,57 @@ DiskRequestDone (_int arg)
 // 	Initialize the synchronous interface to the physical disk, in turn
 //	initializing the physical disk.
 //
+//	Requests are scheduled C-LOOK, unless SetPolicy says otherwise,
+//	and DefaultCacheSize sectors are cached, unless SetCacheSize says
+//	otherwise.  We also start the flusher and read-ahead threads.
+//
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"disks" -- how many disks to stripe the sectors across; the
+//	   second is in "name".1, the third in "name".2, and so on
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(const char* name)
+SynchDisk::SynchDisk(const char* name, int disks)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, (_int) this);
+    char *diskName = new char[strlen(name) + 8];
+
+    ASSERT((disks > 0) && (disks <= MaxDisks));
+    policy = CLOOKDiskScheduling;
+    numDisks = disks;
+    for (int i = 0; i < numDisks; i++) {
+	DiskArm *arm = &arms[i];
+
+	if (i == 0)
+	    strcpy(diskName, name);
+	else
+	    sprintf(diskName, "%s.%d", name, i);
+	arm->owner = this;
+	arm->active = arm->pending = NULL;
+	arm->headSector = 0;		// where the Disk starts out, too
+	arm->ascending = TRUE;
+	arm->disk = new Disk(diskName, DiskRequestDone, (_int) arm);
+    }
+    delete [] diskName;
+
+    numBuffers = 0;
+    buffers = NULL;
+    hashTable = NULL;
+    cacheLock = new Lock("sector cache");
+    bufferFree = new Condition("sector cache buffer free");
+    flushNeeded = new Semaphore("sector cache flush", 0);
+    flushScheduled = FALSE;
+    journal = NULL;
+    readAheadHead = readAheadLength = 0;
+    readAheadNeeded = new Semaphore("sector cache read-ahead", 0);
+    SetCacheSize(DefaultCacheSize);
+
+    Thread *flusher = new Thread("disk flusher");
+
+    flusher->Fork(DiskFlusher, (_int) this);
+
+    Thread *readAheader = new Thread("disk read-ahead");
+
+    readAheader->Fork(DiskReadAheader, (_int) this);
 }
 
 //----------------------------------------------------------------------
@@ -55,15 +150,66 @@ SynchDisk::SynchDisk(const char* name)
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
-    delete lock;
-    delete semaphore;
+    for (int i = 0; i < numDisks; i++) {
+	ASSERT(arms[i].active == NULL);
+	delete arms[i].disk;
+    }
+    delete [] buffers;
+    delete [] hashTable;
+    delete cacheLock;
+    delete bufferFree;
+    delete flushNeeded;
+    delete readAheadNeeded;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SetCacheSize
+// 	Cache "count" sectors (none, if "count" is 0).  Nothing may be
+//	cached yet, except clean sectors, which are simply dropped.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::SetCacheSize(int count)
+{
+    int i;
+
+    ASSERT(count >= 0);
+    for (i = 0; i < numBuffers; i++)
+	ASSERT(!buffers[i].dirty && !buffers[i].busy);
+    delete [] buffers;
+    delete [] hashTable;
+    numBuffers = count;
+    buffers = NULL;
+    hashTable = NULL;
+    lruFirst = lruLast = NULL;
+    if (numBuffers == 0)
+	return;
+
+    buffers = new CacheBuffer[numBuffers];
+    hashTable = new CacheBuffer *[numBuffers];
+    for (i = 0; i < numBuffers; i++) {
+	CacheBuffer *buffer = &buffers[i];
+
+	hashTable[i] = NULL;
+	buffer->sector = -1;		// not in the hash table
+	buffer->valid = buffer->dirty = buffer->busy = FALSE;
+	buffer->prefetched = buffer->pinned = FALSE;
+	buffer->hashNext = NULL;
+	buffer->lruPrev = lruLast;	// put it at the end
+	buffer->lruNext = NULL;
+	if (lruLast == NULL)
+	    lruFirst = buffer;
+	else
+	    lruLast->lruNext = buffer;
+	lruLast = buffer;
+    }
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
 // 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+//	after the data has been read.  If the sector is cached, there is
+//	nothing to read from the disk.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
@@ -72,16 +218,41 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    CacheBuffer *buffer;
+
+    if (numBuffers == 0) {
+	Transfer(sectorNumber, data, FALSE);
+	return;
+    }
+    cacheLock->Acquire();
+    buffer = GetBuffer(sectorNumber);
+    if (buffer->valid) {
+	stats->numCacheHits++;
+	if (buffer->prefetched) {
+	    stats->numReadAheadHits++;
+	    buffer->prefetched = FALSE;
+	}
+    } else {
+	stats->numCacheMisses++;
+	cacheLock->Release();		// the buffer is ours while busy
+	Transfer(sectorNumber, buffer->data, FALSE);
+	cacheLock->Acquire();
+	buffer->valid = TRUE;
+    }
+    bcopy(buffer->data, data, SectorSize);
+    PutBuffer(buffer);
+    cacheLock->Release();
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector.  With the
+//	cache, this only writes the cached copy: the sector is written to
+//	the disk later (but at most FlushInterval ticks later).
+//
+//	Writing a cached sector with what it already holds changes
+//	nothing, so it doesn't make the sector dirty.  A sector written in
+//	a journal transaction is pinned, until the journal unpins it.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -90,20 +261,926 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    CacheBuffer *buffer;
+
+    if (numBuffers == 0) {
+	Transfer(sectorNumber, data, TRUE);
+	return;
+    }
+    cacheLock->Acquire();
+    buffer = GetBuffer(sectorNumber);	// no need to read it in: we are
+    if (!buffer->valid || bcmp(data, buffer->data, SectorSize)) {
+	bcopy(data, buffer->data, SectorSize);	// replacing all of it
+	buffer->valid = buffer->dirty = TRUE;
+	if ((journal != NULL) && journal->Capture(sectorNumber))
+	    buffer->pinned = TRUE;
+	ScheduleFlush();
+    }
+    PutBuffer(buffer);
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Unpin
+// 	The journal has written the sector "sectorNumber", which a
+//	transaction pinned, to the journal: let it be written back and
+//	replaced like any other.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Unpin(int sectorNumber)
+{
+    CacheBuffer *buffer;
+
+    cacheLock->Acquire();
+    for (buffer = hashTable[sectorNumber % numBuffers]; buffer != NULL;
+	    buffer = buffer->hashNext)
+	if (buffer->sector == sectorNumber)
+	    break;
+    ASSERT((buffer != NULL) && buffer->pinned);
+    buffer->pinned = FALSE;
+    ScheduleFlush();
+    bufferFree->Broadcast(cacheLock);	// it can be replaced now
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Forget
+// 	The caller has a copy of sector "sectorNumber", and will keep it
+//	up to date itself (a page of a mapped file, see
+//	OpenFile::MapPage): drop the cached copy, so there aren't two,
+//	and put the buffer at the end of the LRU list, to be used first.
+//	Return TRUE if it was dirty, so that the caller's copy now is.
+//
+//	A pinned sector must stay until the journal is done with it, so
+//	it is kept (it is still the same as the caller's copy, at least).
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::Forget(int sectorNumber)
+{
+    CacheBuffer *buffer, **ptr;
+    bool wasDirty;
+
+    if (numBuffers == 0)
+	return FALSE;
+    cacheLock->Acquire();
+    for (;;) {
+	for (buffer = hashTable[sectorNumber % numBuffers]; buffer != NULL;
+		buffer = buffer->hashNext)
+	    if (buffer->sector == sectorNumber)
+		break;
+	if ((buffer == NULL) || !buffer->busy)
+	    break;
+	bufferFree->Wait(cacheLock);
+    }
+    if ((buffer == NULL) || buffer->pinned) {
+	cacheLock->Release();
+	return FALSE;
+    }
+    for (ptr = &hashTable[sectorNumber % numBuffers]; *ptr != buffer;
+	    ptr = &(*ptr)->hashNext)
+	;
+    *ptr = buffer->hashNext;
+    wasDirty = buffer->dirty;
+    buffer->sector = -1;
+    buffer->valid = buffer->dirty = buffer->prefetched = FALSE;
+    if (buffer != lruLast) {		// so not last: it has a next
+	if (buffer->lruPrev == NULL)
+	    lruFirst = buffer->lruNext;
+	else
+	    buffer->lruPrev->lruNext = buffer->lruNext;
+	buffer->lruNext->lruPrev = buffer->lruPrev;
+	buffer->lruPrev = lruLast;
+	buffer->lruNext = NULL;
+	lruLast->lruNext = buffer;
+	lruLast = buffer;
+    }
+    cacheLock->Release();
+    return wasDirty;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ScheduleFlush
+// 	Make sure the flusher wakes up FlushInterval ticks from now (at
+//	most), now that there is a dirty sector.  The cache lock must be
+//	held.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ScheduleFlush()
+{
+    if (!flushScheduled) {
+	flushScheduled = TRUE;
+	interrupt->Schedule(DiskFlushDue, (_int) this, FlushInterval, DiskInt);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read "count" consecutive disk sectors, starting at "firstSector",
+//	into "data".  Cached sectors are copied from the cache, as in
+//	ReadSector; each run of sectors that aren't cached is read from
+//	the disk in a single request, straight into "data" (so a long
+//	read doesn't push everything else out of the cache).
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int firstSector, int count, char* data)
+{
+    char **pieces = new char *[count];
+    int i, run;
+
+    for (i = 0; i < count; i++)
+	pieces[i] = &data[i * SectorSize];
+    for (i = 0; i < count; i += run) {
+	if (numBuffers > 0) {
+	    cacheLock->Acquire();
+	    if (IsCached(firstSector + i)) {
+		cacheLock->Release();
+		ReadSector(firstSector + i, pieces[i]);
+		run = 1;
+		continue;
+	    }
+	    for (run = 1; (i + run < count) && !IsCached(firstSector + i + run);
+								run++)
+		;
+	    stats->numCacheMisses += run;
+	    cacheLock->Release();
+	} else
+	    run = count;
+	TransferRun(firstSector + i, run, &pieces[i], FALSE);
+    }
+    delete [] pieces;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectors
+// 	Write "count" consecutive disk sectors, starting at "firstSector",
+//	from "data".  With the cache, this writes the cached copies (and
+//	Sync writes them back together); without it, the run is written
+//	in one request.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectors(int firstSector, int count, char* data)
+{
+    int i;
+
+    if (numBuffers > 0) {
+	for (i = 0; i < count; i++)
+	    WriteSector(firstSector + i, &data[i * SectorSize]);
+	return;
+    }
+
+    char **pieces = new char *[count];
+
+    for (i = 0; i < count; i++)
+	pieces[i] = &data[i * SectorSize];
+    TransferRun(firstSector, count, pieces, TRUE);
+    delete [] pieces;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartRead, SynchDisk::StartWrite
+// 	Start reading (writing) "count" consecutive disk sectors, starting
+//	at "firstSector", into (from) "data", and return a handle for the
+//	request without waiting for the disk.  "data" must be left alone
+//	until the request is done.
+//
+//	"callback" -- if not NULL, called with "arg" once the request is
+//	   done, from the disk interrupt handler (or, if there was nothing
+//	   for the disk to do, before we return)
+//----------------------------------------------------------------------
+
+AsyncDiskRequest *
+SynchDisk::StartRead(int firstSector, int count, char* data,
+		     VoidFunctionPtr callback, _int arg)
+{
+    return Start(firstSector, count, data, FALSE, callback, arg);
+}
+
+AsyncDiskRequest *
+SynchDisk::StartWrite(int firstSector, int count, char* data,
+		      VoidFunctionPtr callback, _int arg)
+{
+    return Start(firstSector, count, data, TRUE, callback, arg);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Wait
+// 	Wait until the asynchronous "request" is done (it may be already),
+//	and then free it.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Wait(AsyncDiskRequest *request)
+{
+    request->done->P();
+    delete request->done;
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Write every dirty sector in the cache back to the disk.  Sectors
+//	dirtied while we are at it may or may not be written, and sectors
+//	pinned by a journal transaction aren't.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync()
+{
+    SyncSectors(0, NumSectors);
+    for (int i = 0; i < numDisks; i++)
+	arms[i].disk->Flush();		// in case the disk file is mapped
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SyncSectors
+// 	Write the dirty sectors in the cache among the "count" sectors
+//	starting at "firstSector" back to the disk, as Sync does for all
+//	of them (the log writes each segment out this way, once it is
+//	full).
+//
+//	First we take all the dirty buffers no one is using, in order of
+//	sector, and write each run of consecutive sectors among them in
+//	one request.  Then we wait for any that were busy.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::SyncSectors(int firstSector, int count)
+{
+    CacheBuffer **dirty = new CacheBuffer *[numBuffers + 1];
+    char **pieces = new char *[numBuffers + 1];
+    int numDirty = 0;
+    int i, j, run;
+
+    cacheLock->Acquire();
+    for (i = 0; i < numBuffers; i++) {
+	CacheBuffer *buffer = &buffers[i];
+
+	if (!buffer->dirty || buffer->busy || buffer->pinned
+		|| (buffer->sector < firstSector)
+		|| (buffer->sector >= firstSector + count))
+	    continue;
+	for (j = numDirty; (j > 0) && (dirty[j - 1]->sector > buffer->sector);
+									j--)
+	    dirty[j] = dirty[j - 1];	// insertion sort, by sector
+	dirty[j] = buffer;
+	numDirty++;
+	buffer->busy = TRUE;
+    }
+    cacheLock->Release();
+    for (i = 0; i < numDirty; i += run) {
+	pieces[i] = dirty[i]->data;
+	for (run = 1; (i + run < numDirty)
+		&& (dirty[i + run]->sector == dirty[i]->sector + run); run++)
+	    pieces[i + run] = dirty[i + run]->data;
+	TransferRun(dirty[i]->sector, run, &pieces[i], TRUE);
+    }
+    cacheLock->Acquire();
+    for (i = 0; i < numDirty; i++) {
+	dirty[i]->dirty = FALSE;
+	stats->numCacheWriteBacks++;
+	PutBuffer(dirty[i]);
+    }
+    delete [] dirty;
+    delete [] pieces;
+
+    for (i = 0; i < numBuffers; i++) {
+	CacheBuffer *buffer = &buffers[i];
+
+	if ((buffer->sector < firstSector)
+		|| (buffer->sector >= firstSector + count))
+	    continue;
+	while (buffer->busy)
+	    bufferFree->Wait(cacheLock);
+	if (buffer->dirty && !buffer->pinned
+		&& (buffer->sector >= firstSector)
+		&& (buffer->sector < firstSector + count)) {
+	    buffer->busy = TRUE;
+	    cacheLock->Release();
+	    Transfer(buffer->sector, buffer->data, TRUE);
+	    cacheLock->Acquire();
+	    buffer->dirty = FALSE;
+	    stats->numCacheWriteBacks++;
+	    PutBuffer(buffer);
+	}
+    }
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flusher
+// 	The flusher thread: each time the timer set by WriteSector goes
+//	off, write all dirty sectors back.  When nothing is dirty, no
+//	timer is set, and the flusher doesn't keep Nachos from halting.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flusher()
+{
+    for (;;) {
+	flushNeeded->P();
+	DEBUG('f', "Flushing the sector cache\n");
+	if (journal != NULL)
+	    journal->Checkpoint();	// which syncs, and empties it
+	else
+	    Sync();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadAhead
+// 	Ask the read-ahead thread to read the "count" sectors starting at
+//	"firstSector" into the cache, and return right away.  This is only
+//	a hint: if the queue is full, or there is no cache, we forget it.
+//	No more than half the cache is read ahead at once, so as not to
+//	throw out everything else.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadAhead(int firstSector, int count)
+{
+    if ((numBuffers == 0) || (count <= 0))
+	return;
+    cacheLock->Acquire();
+    if (readAheadLength < ReadAheadQueueSize) {
+	int i = (readAheadHead + readAheadLength++) % ReadAheadQueueSize;
+
+	readAheadFirst[i] = firstSector;
+	readAheadCount[i] = min(count, max(numBuffers / 2, 1));
+	readAheadNeeded->V();
+    }
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadAheader
+// 	The read-ahead thread: take each run of sectors off the queue, and
+//	read the ones that aren't cached yet.  We mark a buffer busy for
+//	each, so that a thread that asks for one of them in the meantime
+//	waits for it, and then read each run of them in one request, as
+//	Sync writes them.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadAheader()
+{
+    CacheBuffer **run = NULL;		// the buffers being read, and
+    char **pieces = NULL;		// their data
+    int size = 0;			// how big those two arrays are
+
+    for (;;) {
+	readAheadNeeded->P();
+	cacheLock->Acquire();
+
+	int first = readAheadFirst[readAheadHead];
+	int count = readAheadCount[readAheadHead];
+	int i, n = 0;
+
+	readAheadHead = (readAheadHead + 1) % ReadAheadQueueSize;
+	readAheadLength--;
+	if (count > size) {
+	    delete [] run;
+	    delete [] pieces;
+	    size = count;
+	    run = new CacheBuffer *[size];
+	    pieces = new char *[size];
+	}
+	DEBUG('f', "Reading ahead %d sectors from %d\n", count, first);
+	for (i = 0; i <= count; i++) {
+	    CacheBuffer *buffer = NULL;
+
+	    if ((i < count) && !IsCached(first + i)) {
+		buffer = GetBuffer(first + i);
+		if (buffer->valid) {	// someone read it meanwhile
+		    PutBuffer(buffer);
+		    buffer = NULL;
+		}
+	    }
+	    if (buffer != NULL) {
+		run[n] = buffer;
+		pieces[n++] = buffer->data;
+		continue;
+	    }
+	    if (n == 0)
+		continue;
+	    cacheLock->Release();	// the buffers are ours while busy
+	    TransferRun(run[0]->sector, n, pieces, FALSE);
+	    cacheLock->Acquire();
+	    while (n > 0) {
+		buffer = run[--n];
+		buffer->valid = buffer->prefetched = TRUE;
+		stats->numReadAheadSectors++;
+		PutBuffer(buffer);
+	    }
+	}
+	cacheLock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FlushDue
+// 	Timer interrupt handler: wake up the flusher.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FlushDue()
+{
+    flushScheduled = FALSE;
+    flushNeeded->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::IsCached
+// 	Return TRUE if there is a buffer for "sector" (whether or not it
+//	has been read in yet).  The cache lock must be held.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::IsCached(int sector)
+{
+    CacheBuffer *buffer;
+
+    for (buffer = hashTable[sector % numBuffers]; buffer != NULL;
+	    buffer = buffer->hashNext)
+	if (buffer->sector == sector)
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::GetBuffer
+// 	Return the buffer for "sector", marked busy, waiting if another
+//	thread is using it.  If the sector isn't cached, we take the least
+//	recently used buffer that isn't busy, writing it back first if it
+//	is dirty; the buffer returned is then not valid, for the caller
+//	to fill in.
+//
+//	The cache lock must be held; it is released while we wait.
+//----------------------------------------------------------------------
+
+CacheBuffer *
+SynchDisk::GetBuffer(int sector)
+{
+    CacheBuffer *buffer, **ptr;
+
+    for (;;) {
+	for (buffer = hashTable[sector % numBuffers]; buffer != NULL;
+		buffer = buffer->hashNext)
+	    if (buffer->sector == sector)
+		break;
+	if (buffer != NULL) {		// cached
+	    if (!buffer->busy)
+		break;
+	    bufferFree->Wait(cacheLock);
+	    continue;
+	}
+
+	for (buffer = lruLast; (buffer != NULL)
+		&& (buffer->busy || buffer->pinned); buffer = buffer->lruPrev)
+	    ;
+	if (buffer == NULL) {		// every buffer is in use
+	    bufferFree->Wait(cacheLock);
+	    continue;
+	}
+	if (buffer->dirty) {		// write it back, then look again,
+	    buffer->busy = TRUE;	// as anything may have happened
+	    cacheLock->Release();	// in the meantime
+	    Transfer(buffer->sector, buffer->data, TRUE);
+	    cacheLock->Acquire();
+	    buffer->dirty = FALSE;
+	    stats->numCacheWriteBacks++;
+	    PutBuffer(buffer);
+	    continue;
+	}
+
+	if (buffer->sector >= 0) {	// take it out of its bucket
+	    for (ptr = &hashTable[buffer->sector % numBuffers];
+		    *ptr != buffer; ptr = &(*ptr)->hashNext)
+		;
+	    *ptr = buffer->hashNext;
+	}
+	buffer->sector = sector;
+	buffer->valid = FALSE;
+	buffer->prefetched = FALSE;
+	buffer->hashNext = hashTable[sector % numBuffers];
+	hashTable[sector % numBuffers] = buffer;
+	break;
+    }
+    buffer->busy = TRUE;
+    MoveToFront(buffer);
+    return buffer;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PutBuffer
+// 	The caller is done with "buffer"; let anyone waiting for a buffer
+//	look again.  The cache lock must be held.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::PutBuffer(CacheBuffer *buffer)
+{
+    buffer->busy = FALSE;
+    bufferFree->Broadcast(cacheLock);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MoveToFront
+// 	Move "buffer" to the front of the LRU list.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::MoveToFront(CacheBuffer *buffer)
+{
+    if (buffer == lruFirst)
+	return;
+    buffer->lruPrev->lruNext = buffer->lruNext;	// not first, so has a prev
+    if (buffer->lruNext == NULL)
+	lruLast = buffer->lruPrev;
+    else
+	buffer->lruNext->lruPrev = buffer->lruPrev;
+    buffer->lruPrev = NULL;
+    buffer->lruNext = lruFirst;
+    lruFirst->lruPrev = buffer;
+    lruFirst = buffer;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Read or write a disk sector, bypassing the cache.  Return only
+//	after the data has been read or written.
+//
+//	"sector" -- the disk sector to read or write
+//	"data" -- the buffer holding (or to hold) its contents
+//	"writing" -- TRUE to write it, FALSE to read it
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int sector, char *data, bool writing)
+{
+    TransferRun(sector, 1, &data, writing);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::TransferRun
+// 	Read or write "count" consecutive disk sectors, starting at
+//	"sector", bypassing the cache, in one request to the disk.
+//
+//	"data" -- data[i] is the buffer for sector "sector" + i
+//----------------------------------------------------------------------
+
+void
+SynchDisk::TransferRun(int sector, int count, char **data, bool writing)
+{
+    DiskRequest request;
+
+    request.sector = sector;
+    request.count = count;
+    request.data = data;
+    request.writing = writing;
+    Request(&request);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Request
+// 	Send a request to the disk, or if the disk is busy, put it at the
+//	end of the queue; then sleep until it is done.
+//
+//	"request" -- the request, with the sector, buffer and direction
+//	   filled in
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Request(DiskRequest *request)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    request->thread = currentThread;
+    request->async = NULL;
+    Queue(request);
+    currentThread->Sleep();		// until RequestDone wakes us up
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Queue
+// 	Send a request to the disk, or if the disk is busy, put it at the
+//	end of the queue.  Interrupts must be off.
+//
+//	With several disks, the request is split into a piece for each
+//	disk with any of its sectors, and each piece is queued for its
+//	disk.  Sector "s" of the array is in stripe s / StripeUnit, and
+//	stripe k is the (k / numDisks)th on disk k % numDisks; so the
+//	sectors of a run that fall on the same disk are a run there too.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Queue(DiskRequest *request)
+{
+    DiskRequest *piece[MaxDisks];
+    int i, stripe, d;
+
+    ASSERT(interrupt->getLevel() == IntOff);
+    request->whole = NULL;
+    request->pieces = 0;
+    if (numDisks == 1) {
+	QueueOn(&arms[0], request);
+	return;
+    }
+    for (d = 0; d < numDisks; d++)
+	piece[d] = NULL;
+    for (i = 0; i < request->count; i++) {
+	stripe = (request->sector + i) / StripeUnit;
+	d = stripe % numDisks;
+	if (piece[d] == NULL) {
+	    piece[d] = new DiskRequest;
+	    piece[d]->sector = (stripe / numDisks) * StripeUnit
+				+ (request->sector + i) % StripeUnit;
+	    piece[d]->count = 0;
+	    piece[d]->data = new char *[request->count];
+	    piece[d]->writing = request->writing;
+	    piece[d]->thread = NULL;
+	    piece[d]->async = NULL;
+	    piece[d]->whole = request;
+	    request->pieces++;
+	}
+	piece[d]->data[piece[d]->count++] = request->data[i];
+    }
+    for (d = 0; d < numDisks; d++)
+	if (piece[d] != NULL)
+	    QueueOn(&arms[d], piece[d]);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::QueueOn
+// 	Send a request (or a piece of one) to the disk "arm", or if it is
+//	busy, put it at the end of its queue.  Interrupts must be off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::QueueOn(DiskArm *arm, DiskRequest *request)
+{
+    DiskRequest **ptr;
+
+    request->next = NULL;
+    if (arm->active == NULL)
+	StartRequest(arm, request);
+    else {
+	for (ptr = &arm->pending; *ptr != NULL; ptr = &(*ptr)->next)
+	    ;
+	*ptr = request;
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Start
+// 	Start an asynchronous request (see StartRead and StartWrite).
+//
+//	A read copies the cached sectors from the cache, as ReadSectors
+//	does, and queues a request for each run of the others.  A write
+//	copies the new contents into the cached sectors -- which are then
+//	clean, as the disk is about to get them too -- and queues one
+//	request for all of it.  We may wait for a cached sector that
+//	another thread is using, but never for the disk.
+//
+//	The handle counts one more disk request than it really has
+//	until everything is queued, so that it can't be done before then.
+//----------------------------------------------------------------------
+
+AsyncDiskRequest *
+SynchDisk::Start(int firstSector, int count, char *data, bool writing,
+		 VoidFunctionPtr callback, _int arg)
+{
+    AsyncDiskRequest *request = new AsyncDiskRequest;
+    CacheBuffer *buffer;
+    IntStatus oldLevel;
+    int i, run;
+
+    request->outstanding = 1;		// until it is all queued
+    request->callback = callback;
+    request->callbackArg = arg;
+    request->done = new Semaphore("asynchronous disk request", 0);
+    if (numBuffers == 0)
+	QueueRun(request, firstSector, count, data, writing);
+    else if (writing) {
+	cacheLock->Acquire();
+	for (i = 0; i < count; i++)
+	    if (IsCached(firstSector + i)) {
+		buffer = GetBuffer(firstSector + i);
+		bcopy(&data[i * SectorSize], buffer->data, SectorSize);
+		buffer->valid = TRUE;
+		buffer->dirty = FALSE;
+		PutBuffer(buffer);
+	    }
+	QueueRun(request, firstSector, count, data, TRUE);
+	cacheLock->Release();
+    } else {
+	cacheLock->Acquire();
+	for (i = 0; i < count; i += run) {
+	    run = 1;
+	    if (IsCached(firstSector + i)) {
+		buffer = GetBuffer(firstSector + i);
+		bcopy(buffer->data, &data[i * SectorSize], SectorSize);
+		stats->numCacheHits++;
+		if (buffer->prefetched) {
+		    stats->numReadAheadHits++;
+		    buffer->prefetched = FALSE;
+		}
+		PutBuffer(buffer);
+		continue;
+	    }
+	    while ((i + run < count) && !IsCached(firstSector + i + run))
+		run++;
+	    stats->numCacheMisses += run;
+	    QueueRun(request, firstSector + i, run, &data[i * SectorSize],
+		     FALSE);
+	}
+	cacheLock->Release();
+    }
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    FinishAsync(request);		// now it can be done
+    (void) interrupt->SetLevel(oldLevel);
+    return request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::QueueRun
+// 	Queue a disk request for "count" consecutive sectors, starting at
+//	"sector", to or from "data", as part of the asynchronous request
+//	"async".
+//----------------------------------------------------------------------
+
+void
+SynchDisk::QueueRun(AsyncDiskRequest *async, int sector, int count,
+		    char *data, bool writing)
+{
+    DiskRequest *request = new DiskRequest;
+    IntStatus oldLevel;
+
+    request->sector = sector;
+    request->count = count;
+    request->data = new char *[count];
+    for (int i = 0; i < count; i++)
+	request->data[i] = &data[i * SectorSize];
+    request->writing = writing;
+    request->thread = NULL;
+    request->async = async;
+    oldLevel = interrupt->SetLevel(IntOff);
+    async->outstanding++;
+    Queue(request);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FinishAsync
+// 	One of the disk requests of "async" is done; if it was the last,
+//	call the callback, and wake up whoever waits for it.  Interrupts
+//	must be off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FinishAsync(AsyncDiskRequest *async)
+{
+    ASSERT(async->outstanding > 0);
+    if (--async->outstanding > 0)
+	return;
+    if (async->callback != NULL)
+	(*async->callback)(async->callbackArg);
+    async->done->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::NextRequest
+// 	Take the request the disk should do next off the queue, and
+//	return it (or NULL, if nothing is waiting).  We only look at which
+//	track each request is on, as the seek is what the policies try to
+//	keep short:
+//
+//	FIFODiskScheduling: the oldest request.
+//	SSTFDiskScheduling: the one on the nearest track.
+//	SCANDiskScheduling: the nearest one ahead, in the direction the
+//	   head is sweeping; the sweep turns around when there are none
+//	   left that way (so this is really LOOK: it doesn't go on to the
+//	   edge of the disk).
+//	CLOOKDiskScheduling: the nearest one ahead, going up; when there
+//	   are none, the lowest one (the head jumps back down, and sweeps
+//	   up again), so that no track waits for more than one sweep.
+//
+//	Requests on the head's track count as ahead either way; ties go
+//	to the oldest request.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::NextRequest(DiskArm *arm)
+{
+    DiskRequest **ptr, **best = NULL;
+    int head = arm->headSector / SectorsPerTrack;
+    int distance, bestDistance = 0;
+
+    for (ptr = &arm->pending; *ptr != NULL; ptr = &(*ptr)->next) {
+	int track = (*ptr)->sector / SectorsPerTrack;
+
+	switch (policy) {
+	  case FIFODiskScheduling:
+	    distance = 0;
+	    break;
+	  case SSTFDiskScheduling:
+	    distance = (track >= head) ? track - head : head - track;
+	    break;
+	  case SCANDiskScheduling:
+	    if (arm->ascending)
+		distance = (track >= head) ? track - head
+					   : numTracks + head - track;
+	    else
+		distance = (track <= head) ? head - track
+					   : numTracks + track - head;
+	    break;
+	  default:			// CLOOKDiskScheduling
+	    distance = (track >= head) ? track - head
+				       : numTracks + track;
+	    break;
+	}
+	if ((best == NULL) || (distance < bestDistance)) {
+	    best = ptr;
+	    bestDistance = distance;
+	}
+    }
+    if (best == NULL)
+	return NULL;
+
+    DiskRequest *request = *best;
+
+    *best = request->next;
+    if ((policy == SCANDiskScheduling) && (bestDistance >= numTracks))
+	arm->ascending = (bool) !arm->ascending;  // nothing was left ahead
+    return request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartRequest
+// 	Send "request" to the (idle) disk "arm", and note how far the
+//	head has to seek for it.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartRequest(DiskArm *arm, DiskRequest *request)
+{
+    int from = arm->headSector / SectorsPerTrack;
+    int to = request->sector / SectorsPerTrack;
+
+    ASSERT(arm->active == NULL);
+    arm->active = request;
+    stats->numDiskRequests++;
+    stats->numDiskSeekTracks += (to >= from) ? to - from : from - to;
+    arm->headSector = request->sector + request->count - 1;
+    if (request->writing)
+	arm->disk->WriteSectors(request->sector, request->count,
+				request->data);
+    else
+	arm->disk->ReadSectors(request->sector, request->count,
+			       request->data);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler, for the disk "arm".  Wake up the thread
+//	waiting for the disk request that just finished (or, if it is
+//	part of an asynchronous request, count it done), and start the
+//	disk's next one, if any.  If it was a piece of a request, the
+//	request is only done once all its pieces are.
 //----------------------------------------------------------------------
 
 void
-SynchDisk::RequestDone()
+SynchDisk::RequestDone(DiskArm *arm)
 { 
-    semaphore->V();
+    DiskRequest *request = arm->active;
+
+    ASSERT(request != NULL);
+    arm->active = NULL;
+    if (request->whole != NULL) {
+	DiskRequest *whole = request->whole;
+
+	delete [] request->data;
+	delete request;
+	request = (--whole->pieces == 0) ? whole : NULL;
+    }
+    if (request == NULL)
+	;				// other pieces still to do
+    else if (request->async == NULL)
+	scheduler->ReadyToRun(request->thread);
+    else {
+	AsyncDiskRequest *async = request->async;
+
+	delete [] request->data;
+	delete request;
+	FinishAsync(async);
+    }
+    request = NextRequest(arm);
+    if (request != NULL)
+	StartRequest(arm, request);
 }
@@ -14,6 +14,106 @@
 #include "disk.h"
 #include "synch.h"
 
+// Disk scheduling policies: the order in which requests waiting for the
+// disk are sent to it (see SynchDisk::NextRequest).
+
+enum DiskSchedulingPolicy { FIFODiskScheduling,	// arrival order
+			    SSTFDiskScheduling,	// shortest seek first
+			    SCANDiskScheduling,	// elevator, both ways
+			    CLOOKDiskScheduling };	// sweep up, then
+						// jump back to the lowest
+
+class AsyncDiskRequest;
+class Journal;
+class SynchDisk;
+
+#define MaxDisks	8		// disks striped together, at most
+#define StripeUnit	4		// sectors in a row on each disk, before
+					// the next disk's turn
+
+// The following class defines a request waiting for the disk.  It lives
+// on the stack of the thread that made it, which sleeps until the
+// request is done -- unless it is part of an asynchronous request, in
+// which case it is allocated, and deleted when it is done.
+//
+// With several disks striped together, a request is split into a piece
+// for each disk it touches, each an allocated request of its own; the
+// request is done when the last of them is.
+
+class DiskRequest {
+  public:
+    int sector;				// the first sector to read or write
+    int count;				// how many (consecutive) sectors
+    char **data;			// and the buffer for each
+    bool writing;			// is it a write?
+    Thread *thread;			// the thread waiting for it, or
+    AsyncDiskRequest *async;		// the asynchronous request it is
+					// part of
+    DiskRequest *whole;			// the request this is a piece of, or
+					// NULL (then "sector" is on the
+					// whole array, not on one disk)
+    int pieces;				// pieces not done yet, if it was
+					// split
+    DiskRequest *next;			// the next request waiting
+};
+
+// The following class defines one of the disks in the array: the disk,
+// and the requests for it.  Each disk has its own arm, so each does
+// one request at a time, but all of them can be busy at once.
+
+class DiskArm {
+  public:
+    SynchDisk *owner;			// the array it is part of
+    Disk *disk;				// the disk
+    DiskRequest *active;		// the request the disk is doing,
+					// NULL if it is idle
+    DiskRequest *pending;		// requests waiting for it, in
+					// arrival order
+    int headSector;			// where the last request left the
+					// head
+    bool ascending;			// which way SCAN is sweeping
+};
+
+// The following class defines an asynchronous request, as started by
+// SynchDisk::StartRead or StartWrite: the handle for finding out when
+// it is done.  It may take several requests to the disk (a read takes
+// one for each run of sectors that aren't cached).
+
+class AsyncDiskRequest {
+  public:
+    int outstanding;			// disk requests not done yet
+    VoidFunctionPtr callback;		// called once they are all done,
+    _int callbackArg;			// unless NULL
+    Semaphore *done;			// V'ed once they are all done
+};
+
+#define DefaultCacheSize	32	// sectors cached, unless -cache says
+#define FlushInterval		50000	// ticks a sector may stay dirty,
+					// before the flusher writes it
+#define ReadAheadQueueSize	8	// read-ahead runs waiting for the
+					// read-ahead thread
+
+// The following class defines a buffer in the sector cache, holding a
+// copy of one disk sector.
+
+class CacheBuffer {
+  public:
+    int sector;				// which sector, -1 if none
+    bool valid;				// has it been read in (or written)?
+    bool dirty;				// is it newer than the disk?
+    bool busy;				// is a thread using it?  (Possibly
+					// waiting for the disk to read or
+					// write it.)
+    bool prefetched;			// was it read ahead, and not yet
+					// asked for?
+    bool pinned;			// must it stay in the cache, dirty,
+					// until the journal lets it go?
+    char data[SectorSize];		// the contents
+    CacheBuffer *hashNext;		// the next buffer in the same bucket
+    CacheBuffer *lruPrev;		// the buffers used just after and
+    CacheBuffer *lruNext;		// just before this one
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -23,11 +123,39 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  StartRead and StartWrite, on the other hand, return
+// right away, with a handle to wait for the request with (or a callback
+// is called when it is done), so that a thread can get on with
+// something else while the disk works.
+//
+// Any number of threads can have a request outstanding.  The disk gets
+// one at a time; the others wait in a queue, from which the next one
+// is picked, by the disk scheduling policy, when the disk finishes.
+//
+// There can be several disks, striped together (RAID-0), each a UNIX
+// file of its own: the first StripeUnit sectors are on the first disk,
+// the next StripeUnit on the second, and so on, round and round.  Each
+// disk has its own queue, and works on its own requests while the
+// others work on theirs, so a long run of sectors, which is split
+// across all of them, takes about as long as its share on one disk.
+// The array has as many sectors as one disk would: the rest of each
+// disk goes unused.
+//
+// On the way, sectors go through a cache, so that the sectors the file
+// system uses over and over (the free map, directories, file headers)
+// are read from the disk only once.  Writes only go into the cache; a
+// flusher thread writes the dirty sectors back, FlushInterval ticks
+// after the first of them was dirtied, and Sync writes them all back
+// right away -- except for sectors a journal transaction has pinned,
+// which stay until the transaction's record is in the journal (see
+// journal.h).  Similarly, ReadAhead asks a read-ahead thread to read
+// sectors into the cache, in the background, before they are needed.
 class SynchDisk {
   public:
-    SynchDisk(const char* name);    		// Initialize a synchronous disk,
-					// by initializing the raw Disk.
+    SynchDisk(const char* name, int disks = 1);
+					// Initialize a synchronous disk,
+					// by initializing the raw Disk (or
+					// "disks" of them, striped).
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
@@ -37,17 +165,120 @@ class SynchDisk {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+    void ReadSectors(int firstSector, int count, char* data);
+    void WriteSectors(int firstSector, int count, char* data);
+					// The same, for "count" consecutive
+					// sectors; the sectors that aren't
+					// cached are read all in one request
     
-    void RequestDone();			// Called by the disk device interrupt
+    AsyncDiskRequest *StartRead(int firstSector, int count, char* data,
+				VoidFunctionPtr callback, _int arg);
+    AsyncDiskRequest *StartWrite(int firstSector, int count, char* data,
+				 VoidFunctionPtr callback, _int arg);
+					// Start reading/writing "count"
+					// consecutive sectors, and return
+					// without waiting; "callback(arg)",
+					// if "callback" isn't NULL, is called
+					// once it is done -- from the disk
+					// interrupt handler, so it must not
+					// block
+    bool IsDone(AsyncDiskRequest *request)
+			{ return (bool)(request->outstanding == 0); }
+    void Wait(AsyncDiskRequest *request);
+					// Wait until "request" is done, and
+					// free it; every request started
+					// must be waited for
+    
+    void Sync();			// Write all dirty sectors back to the
+					// disk, returning once they are written
+    void SyncSectors(int firstSector, int count);
+					// The same, for the dirty sectors
+					// among "count" from "firstSector" on
+
+    void SetPolicy(DiskSchedulingPolicy p) { policy = p; }
+					// Choose how to order requests
+    void SetCacheSize(int numBuffers);	// Cache that many sectors (0 turns
+					// the cache off); must be called
+					// before the disk is used
+    int CacheSize() { return numBuffers; }
+    void SetJournal(Journal *j) { journal = j; }
+					// Pin the sectors written in a
+					// journal transaction
+    void Unpin(int sectorNumber);	// The journal is done with it
+    bool Forget(int sectorNumber);	// Drop the cached copy, as the caller
+					// has its own now; return TRUE if it
+					// was dirty
+    void ReadAhead(int firstSector, int count);
+					// Start reading "count" sectors into
+					// the cache, without waiting
+    void Flusher();			// The flusher thread's body
+    void FlushDue();			// Called by the timer interrupt
+					// set for the flusher
+    void ReadAheader();			// The read-ahead thread's body
+    
+    void RequestDone(DiskArm *arm);	// Called by the disk device interrupt
 					// handler, to signal that the
-					// current disk operation is complete.
+					// current operation of one of the
+					// disks is complete.
 
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskArm arms[MaxDisks];		// The raw disk devices
+    int numDisks;			// How many there are
+    DiskSchedulingPolicy policy;	// How to order the requests
+
+    int numBuffers;			// The size of the cache
+    CacheBuffer *buffers;
+    CacheBuffer **hashTable;		// Buffers by sector, numBuffers
+					// buckets
+    CacheBuffer *lruFirst;		// The buffers, most recently used
+    CacheBuffer *lruLast;		// first
+    Lock *cacheLock;			// Protects the cache
+    Condition *bufferFree;		// Signalled when a buffer stops
+					// being busy
+    Semaphore *flushNeeded;		// The flusher waits on this
+    bool flushScheduled;		// Is the flusher timer set?
+    Journal *journal;			// Journal to tell about writes, if
+					// any
+    int readAheadFirst[ReadAheadQueueSize];	// Runs of sectors for
+    int readAheadCount[ReadAheadQueueSize];	// the read-ahead thread,
+    int readAheadHead;			// a circular queue
+    int readAheadLength;
+    Semaphore *readAheadNeeded;		// The read-ahead thread waits on
+					// this
+
+    bool IsCached(int sector);		// Is there a buffer for "sector"?
+    CacheBuffer *GetBuffer(int sector);	// Find (or make room for) the
+					// buffer for "sector", and mark it
+					// busy
+    void PutBuffer(CacheBuffer *buffer);	// Done with a busy buffer
+    void MoveToFront(CacheBuffer *buffer);	// It is the most recently
+					// used now
+    void ScheduleFlush();		// Set the flusher's timer, if it
+					// isn't set
+    void Transfer(int sector, char *data, bool writing);
+					// Read or write the disk, bypassing
+					// the cache
+    void TransferRun(int sector, int count, char **data, bool writing);
+					// The same, for a run of sectors
+    void Request(DiskRequest *request);	// Queue a request, and wait for it
+    void Queue(DiskRequest *request);	// Queue a request (with interrupts
+					// off)
+    void QueueOn(DiskArm *arm, DiskRequest *request);
+					// Queue a request (or piece of one)
+					// for one of the disks
+    AsyncDiskRequest *Start(int firstSector, int count, char *data,
+			    bool writing, VoidFunctionPtr callback, _int arg);
+					// Start an asynchronous request
+    void QueueRun(AsyncDiskRequest *async, int sector, int count,
+		  char *data, bool writing);
+					// Queue a run of sectors for it
+    void FinishAsync(AsyncDiskRequest *async);
+					// One of its disk requests is done
+    DiskRequest *NextRequest(DiskArm *arm);
+					// Take the next request to do off
+					// a disk's queue, NULL if none
+    void StartRequest(DiskArm *arm, DiskRequest *request);
+					// Send a request to the disk
 };
 
 #endif // SYNCHDISK_H
@@ -29,7 +29,12 @@
 
 Scheduler::Scheduler()
 { 
-    readyList = new List; 
+    readyList[0][0] = new ThreadQueue; 	// priorities, rather than levels,
+    numReady[0] = 0;			// and only the one CPU
+    numCPUs = 1;
+    cpu = 0;
+    policy = FIFOScheduling;
+    sliceStart = lastBoost = 0;
 } 
 
 //----------------------------------------------------------------------
@@ -39,7 +44,7 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    delete readyList[0][0]; 
 } 
 
 //----------------------------------------------------------------------
@@ -56,7 +61,7 @@ Scheduler::ReadyToRun (Thread *thread)
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
     thread->setStatus(READY);
-    readyList->SortedInsert((void*)thread, thread->getPriority());
+    readyList[0][0]->SortedInsert(thread, thread->getPriority());
     //readyList->Append((void *)thread);
 }
 
@@ -71,7 +76,7 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->Remove();
+    return readyList[0][0]->Remove();
 }
 
 //----------------------------------------------------------------------
@@ -105,6 +110,8 @@ Scheduler::Run (Thread *nextThread)
 
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
+    stats->totalTicks += switchTicks;	    // which costs something
+    stats->systemTicks += switchTicks;
     
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
@@ -144,5 +151,21 @@ void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    readyList[0][0]->Mapcar((VoidFunctionPtr) ThreadPrint);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TimerTick
+// 	Called at each timer interrupt.  This scheduler only knows about
+//	priorities, not feedback levels, so every tick ends the slice.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::TimerTick()
+{
+    if (policy == FeedbackScheduling)
+	DEBUG('t', "No feedback queue here, using priorities\n");
+    if (numCPUs > 1)
+	DEBUG('t', "Only one CPU here\n");
+    return TRUE;
 }
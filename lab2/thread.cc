@@ -38,6 +38,7 @@ Thread::Thread(const char* threadName)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    affinity = -1;
     priority = 9;   //ĬȼΪ9
 
 #ifdef USER_PROGRAM
@@ -52,6 +53,7 @@ Thread::Thread(const char* threadName,int threadPriority)
     stackTop = NULL; //ջָ
     stack = NULL; //Ķջ
     status = JUST_CREATED;
+    affinity = -1;
     if (threadPriority > 99)
         priority = 99;
     if (threadPriority < 0)
@@ -252,6 +254,21 @@ Thread::Sleep ()
     scheduler->Run(nextThread); // returns when we've been signalled
 }
 
+//----------------------------------------------------------------------
+// Thread::SleepFor
+// 	Relinquish the CPU until "ticks" of simulated time have passed,
+//	on the alarm clock (see alarm.h), rather than spinning with Yield:
+//	the thread is not on the ready list until its time comes.
+//----------------------------------------------------------------------
+
+void
+Thread::SleepFor(int ticks)
+{
+    ASSERT(this == currentThread);
+    
+    alarmClock->SleepUntil(stats->totalTicks + ticks);
+}
+
 //----------------------------------------------------------------------
 // ThreadFinish, InterruptEnable, ThreadPrint
 //	Dummy functions because C++ does not allow a pointer to a member
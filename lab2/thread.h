@@ -96,17 +96,25 @@ class Thread {
 						// other thread is runnable
     void Sleep();  				// Put the thread to sleep and 
 						// relinquish the processor
+    void SleepFor(int ticks);			// Sleep until "ticks" of
+						// simulated time have passed
     void Finish();  				// The thread is done executing
     
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
+    int getAffinity() { return affinity; }	// the CPUs it may run on,
+    void setAffinity(int mask) { affinity = mask; }	// a bit for each
     char* getName() { return (name); }
     void Print() { printf("%s, ", name); }
     int getPriority() {
         return priority;
     }
 
+    Thread *queueNext;			// the next thread on the ThreadQueue
+					// this one is on (see threadqueue.h)
+    int queueKey;			// its key there, if sorted
+
   private:
     // some of the private data for this class is listed above
     
@@ -114,6 +122,8 @@ class Thread {
 					// NULL if this is the main thread
 					// (If NULL, don't deallocate stack)
     ThreadStatus status;		// ready, running or blocked
+    int affinity;			// bit c set if it may run on CPU c
+					// (all set, to begin with)
     char* name;
     int priority;   //̬ȼ
 
@@ -8,7 +8,8 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
+// Usage: nachos -d <debugflags> -rs <random seed #> -ring <spsc|mpmc>
+//		-bench <count>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
@@ -18,6 +19,11 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -ring runs the producers and consumers on a lock-free ring,
+//	without semaphores
+//    -bench runs the thread system microbenchmarks (cf. synchbench.h),
+//	each thread doing <count> operations, and times <count> messages
+//	through the ring, instead of the producers and consumers
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
@@ -52,10 +58,12 @@
 
 #include "utility.h"
 #include "system.h"
+#include "synchbench.h"
 
 // External functions used by this file
 
-extern void ProdCons(void), Copy(char *unixFile, char *nachosFile);
+extern void ProdCons(char *kind), RingBench(char *kind, int count);
+extern void Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
@@ -85,7 +93,19 @@ main(int argc, char **argv)
     (void) Initialize(argc, argv);
     
 #ifdef THREADS
-    ProdCons();
+    char *ringKind = NULL;
+    int benchCount = 0;
+
+    for (int i = 1; i < argc - 1; i++)
+	if (!strcmp(argv[i], "-ring"))
+	    ringKind = argv[i + 1];
+	else if (!strcmp(argv[i], "-bench"))
+	    benchCount = atoi(argv[i + 1]);
+    if (benchCount > 0) {
+	SynchBench(benchCount);
+	RingBench(ringKind, benchCount);
+    } else
+	ProdCons(ringKind);
 #endif
 
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
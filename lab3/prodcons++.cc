@@ -22,6 +22,7 @@
 
 #include "synch.h"
 #include "ring.h"
+#include "synchbench.h"
 
 #define BUFF_SIZE 3  // the size of the round buffer
 #define N_PROD    2  // the number of producers 
@@ -43,6 +44,8 @@ Semaphore *nempty, *nfull; //two semaphores for empty and full slots
 Semaphore *mutex;          //semaphore for the mutual exclusion
     
 Ring *ring;
+SPSCRing *spscRing;		// or, if one of these is set, use it
+MPMCRing *mpmcRing;		// instead, without semaphores
 
 
 
@@ -78,6 +81,13 @@ Producer(_int which)
 
       // Put the code for synchronization before  ring->Put(message) here.  //synchronizationͬ
       // ...
+      if (spscRing != NULL) {
+	spscRing->Put(message);
+	continue;
+      } else if (mpmcRing != NULL) {
+	mpmcRing->Put(message);
+	continue;
+      }
       nempty->P();
       mutex->P();
 
@@ -110,7 +120,7 @@ Consumer(_int which)
     // to form a output file name for this consumer thread.
     // all the messages received by this consumer will be recorded in 
     // this file.
-    sprintf(fname, "tmp_%d", which);
+    sprintf(fname, "tmp_%ld", (long) which);	// _int may be long
 
     // create a file. Note that this is a UNIX system call.
     if ( (fd = creat(fname, 0600) ) == -1) 
@@ -123,15 +133,21 @@ Consumer(_int which)
 
       // Put the code for synchronization before ring->Get(message) here.
       // ...
-      nfull->P();
-      mutex->P();
-
-      ring->Get(message);
-
-      // Put the code for synchronization after ring->Get(message) here.
-      // ...
-      mutex->V();
-      nempty->V();
+      if (spscRing != NULL)
+	spscRing->Get(message);
+      else if (mpmcRing != NULL)
+	mpmcRing->Get(message);
+      else {
+	nfull->P();
+	mutex->P();
+
+	ring->Get(message);
+
+	// Put the code for synchronization after ring->Get(message) here.
+	// ...
+	mutex->V();
+	nempty->V();
+      }
 
       // form a string to record the message
       sprintf(str,"producer id --> %d; Message number --> %d;\n", 
@@ -152,12 +168,16 @@ Consumer(_int which)
 // ProdCons
 // 	Set up semaphores for shared round buffer and 
 //	create and fork producers and consumer threads
+//
+//	"kind" -- "spsc" or "mpmc" to use that lock-free ring (see ring.h)
+//		instead of a Ring and semaphores; an SPSC ring runs
+//		just one producer and one consumer
 //----------------------------------------------------------------------
 
 void
-ProdCons()
+ProdCons(char *kind)
 {
-    int i;
+    int i, nProd = N_PROD, nCons = N_CONS;
     DEBUG('t', "Entering ProdCons");
 
     // Put the code to construct all the semaphores here.
@@ -169,9 +189,16 @@ ProdCons()
     //BUFF_SIZE here.
     // ...    
     ring = new Ring(BUFF_SIZE);
+    spscRing = NULL;
+    mpmcRing = NULL;
+    if ((kind != NULL) && !strcmp(kind, "spsc")) {
+	spscRing = new SPSCRing(BUFF_SIZE);
+	nProd = nCons = 1;
+    } else if ((kind != NULL) && !strcmp(kind, "mpmc"))
+	mpmcRing = new MPMCRing(BUFF_SIZE);
 
     // create and fork N_PROD of producer threads 
-    for (i=0; i < N_PROD; i++) 
+    for (i=0; i < nProd; i++) 
     {
       // this statemet is to form a string to be used as the name for 
       // produder i. 
@@ -186,7 +213,7 @@ ProdCons()
     };
 
     // create and fork N_CONS of consumer threads 
-    for (i=0; i < N_CONS; i++) 
+    for (i=0; i < nCons; i++) 
     {
       // this statemet is to form a string to be used as the name for 
       // consumer i. 
@@ -201,3 +228,86 @@ ProdCons()
     };
 }
 
+//----------------------------------------------------------------------
+// RingBench
+// 	Measure the throughput of the ring: one producer Puts "count"
+//	messages and one consumer Gets them, with nothing else running,
+//	and print the cost per message (see synchbench.h).
+//
+//	"kind" -- the ring, as for ProdCons
+//	"count" -- how many messages to send
+//----------------------------------------------------------------------
+
+static int benchMessages;		// messages to send, in RingBench
+static Semaphore *ringDone;		// V'ed by each of its threads
+
+static void
+BenchProducer(_int which)
+{
+    slot message(0, 0);
+
+    for (int num = 0; num < benchMessages; num++) {
+	message.thread_id = which;
+	message.value = num;
+	if (spscRing != NULL)
+	    spscRing->Put(&message);
+	else if (mpmcRing != NULL)
+	    mpmcRing->Put(&message);
+	else {
+	    nempty->P();
+	    mutex->P();
+	    ring->Put(&message);
+	    mutex->V();
+	    nfull->V();
+	}
+    }
+    ringDone->V();
+}
+
+static void
+BenchConsumer(_int which)
+{
+    slot message(0, 0);
+
+    for (int num = 0; num < benchMessages; num++) {
+	if (spscRing != NULL)
+	    spscRing->Get(&message);
+	else if (mpmcRing != NULL)
+	    mpmcRing->Get(&message);
+	else {
+	    nfull->P();
+	    mutex->P();
+	    ring->Get(&message);
+	    mutex->V();
+	    nempty->V();
+	}
+	ASSERT(message.value == num);		// in order, and none lost
+    }
+    ringDone->V();
+}
+
+void
+RingBench(char *kind, int count)
+{
+    mutex = new Semaphore("mutex", 1);
+    nempty = new Semaphore("nempty", BUFF_SIZE);
+    nfull = new Semaphore("nfull", 0);
+    ring = new Ring(BUFF_SIZE);
+    spscRing = NULL;
+    mpmcRing = NULL;
+    if ((kind != NULL) && !strcmp(kind, "spsc"))
+	spscRing = new SPSCRing(BUFF_SIZE);
+    else if ((kind != NULL) && !strcmp(kind, "mpmc"))
+	mpmcRing = new MPMCRing(BUFF_SIZE);
+    benchMessages = count;
+    ringDone = new Semaphore("ring done", 0);
+
+    BenchStart((spscRing != NULL) ? "ring-spsc"
+	: (mpmcRing != NULL) ? "ring-mpmc" : "ring");
+    (new Thread("bench producer"))->Fork(BenchProducer, 0);
+    (new Thread("bench consumer"))->Fork(BenchConsumer, 0);
+    ringDone->P();
+    ringDone->P();
+    BenchEnd(count);
+    delete ringDone;
+}
@@ -12,6 +12,7 @@ extern int exit(int st);
 }
 
 #include "ring.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // slot::slot
@@ -95,6 +96,38 @@ Ring::Get(slot *message)
     out = (out + 1) % size;
 }
 
+//----------------------------------------------------------------------
+// Ring::PutBatch
+// 	Put "n" messages into the next "n" empty slots.  As with Put, we
+//	assume the caller has done the necessary synchronization -- but
+//	it only has to enter its critical section once for all of them.
+//
+//	"messages" -- the messages to be put in the buffer
+//	"n" -- how many there are
+//----------------------------------------------------------------------
+
+void
+Ring::PutBatch(slot *messages, int n)
+{
+    for (int i = 0; i < n; i++)
+	Put(&messages[i]);
+}
+
+//----------------------------------------------------------------------
+// Ring::GetBatch
+// 	Get messages from the next "n" full slots (see PutBatch).
+//
+//	"messages" -- where to put the messages from the buffer
+//	"n" -- how many to get
+//----------------------------------------------------------------------
+
+void
+Ring::GetBatch(slot *messages, int n)
+{
+    for (int i = 0; i < n; i++)
+	Get(&messages[i]);
+}
+
 int
 Ring::Empty()
 {
@@ -107,4 +140,222 @@ Ring::Full()
     return ((in + 1) % size) == out;
 }
 
+//----------------------------------------------------------------------
+// SPSCRing::SPSCRing
+// 	Initialize an empty single-producer, single-consumer ring.
+//
+// 	"sz" -- maximum number of elements in the ring buffer at any time
+//----------------------------------------------------------------------
+
+SPSCRing::SPSCRing(int sz)
+{
+    if (sz < 1) {
+	fprintf(stderr, "Error: SPSCRing: size %d too small\n", sz);
+	exit(1);
+    }
+    size = sz;
+    buffer = new slot[size];
+    in = out = 0;
+}
 
+SPSCRing::~SPSCRing()
+{
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// SPSCRing::TryPut
+// 	Put a message in the ring, unless it is full.  We see the
+//	consumer's latest "out" (acquire), so the slot is really free;
+//	and publish "in" only after the slot is written (release).
+//----------------------------------------------------------------------
+
+bool
+SPSCRing::TryPut(slot *message)
+{
+    unsigned int myIn = in;
+
+    if (myIn - __atomic_load_n(&out, __ATOMIC_ACQUIRE) == (unsigned) size)
+	return FALSE;
+    buffer[myIn % size] = *message;
+    __atomic_store_n(&in, myIn + 1, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SPSCRing::TryGet
+// 	Get a message from the ring, unless it is empty (see TryPut).
+//----------------------------------------------------------------------
+
+bool
+SPSCRing::TryGet(slot *message)
+{
+    unsigned int myOut = out;
+
+    if (__atomic_load_n(&in, __ATOMIC_ACQUIRE) == myOut)
+	return FALSE;
+    *message = buffer[myOut % size];
+    __atomic_store_n(&out, myOut + 1, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SPSCRing::Put, SPSCRing::Get
+// 	Put or get a message, yielding the CPU until there is room (or
+//	something to get).
+//----------------------------------------------------------------------
+
+void
+SPSCRing::Put(slot *message)
+{
+    while (!TryPut(message))
+	currentThread->Yield();
+}
+
+void
+SPSCRing::Get(slot *message)
+{
+    while (!TryGet(message))
+	currentThread->Yield();
+}
+
+int
+SPSCRing::Empty()
+{
+    return __atomic_load_n(&in, __ATOMIC_ACQUIRE) ==
+	   __atomic_load_n(&out, __ATOMIC_ACQUIRE);
+}
+
+int
+SPSCRing::Full()
+{
+    return __atomic_load_n(&in, __ATOMIC_ACQUIRE) -
+	   __atomic_load_n(&out, __ATOMIC_ACQUIRE) == (unsigned) size;
+}
+
+//----------------------------------------------------------------------
+// MPMCRing::MPMCRing
+// 	Initialize an empty multi-producer, multi-consumer ring, of at
+//	least "sz" cells (rounded up to a power of two).  Cell i is
+//	first due to be filled at position i.
+//----------------------------------------------------------------------
+
+MPMCRing::MPMCRing(int sz)
+{
+    unsigned int size = 1;
+
+    if (sz < 1) {
+	fprintf(stderr, "Error: MPMCRing: size %d too small\n", sz);
+	exit(1);
+    }
+    while (size < (unsigned) sz)
+	size <<= 1;
+    mask = size - 1;
+    cells = new MPMCCell[size];
+    for (unsigned int i = 0; i < size; i++)
+	cells[i].sequence = i;
+    in = out = 0;
+}
+
+MPMCRing::~MPMCRing()
+{
+    delete [] cells;
+}
+
+//----------------------------------------------------------------------
+// MPMCRing::TryPut
+// 	Put a message in the ring, unless it is full.  The cell at our
+//	position is free if its sequence number is the position; then we
+//	claim the position, fill the cell, and hand it to the consumers
+//	by setting the sequence number one higher.
+//----------------------------------------------------------------------
+
+bool
+MPMCRing::TryPut(slot *message)
+{
+    unsigned int pos = __atomic_load_n(&in, __ATOMIC_RELAXED);
+
+    for (;;) {
+	MPMCCell *cell = &cells[pos & mask];
+	int diff = (int)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE)
+			 - pos);
+
+	if (diff == 0) {		// free: try to claim it
+	    if (__atomic_compare_exchange_n(&in, &pos, pos + 1, FALSE,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		cell->message = *message;
+		__atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+		return TRUE;
+	    }				// (else pos is the new "in")
+	} else if (diff < 0)		// not yet emptied: full
+	    return FALSE;
+	else				// someone else got there first
+	    pos = __atomic_load_n(&in, __ATOMIC_RELAXED);
+    }
+}
+
+//----------------------------------------------------------------------
+// MPMCRing::TryGet
+// 	Get a message from the ring, unless it is empty.  The cell at our
+//	position is full if its sequence number is one past it; once we
+//	have emptied it, it is due to be filled a lap later.
+//----------------------------------------------------------------------
+
+bool
+MPMCRing::TryGet(slot *message)
+{
+    unsigned int pos = __atomic_load_n(&out, __ATOMIC_RELAXED);
+
+    for (;;) {
+	MPMCCell *cell = &cells[pos & mask];
+	int diff = (int)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE)
+			 - (pos + 1));
+
+	if (diff == 0) {		// full: try to claim it
+	    if (__atomic_compare_exchange_n(&out, &pos, pos + 1, FALSE,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		*message = cell->message;
+		__atomic_store_n(&cell->sequence, pos + mask + 1,
+				 __ATOMIC_RELEASE);
+		return TRUE;
+	    }
+	} else if (diff < 0)		// not yet filled: empty
+	    return FALSE;
+	else
+	    pos = __atomic_load_n(&out, __ATOMIC_RELAXED);
+    }
+}
+
+//----------------------------------------------------------------------
+// MPMCRing::Put, MPMCRing::Get
+// 	Put or get a message, yielding the CPU until there is room (or
+//	something to get).
+//----------------------------------------------------------------------
+
+void
+MPMCRing::Put(slot *message)
+{
+    while (!TryPut(message))
+	currentThread->Yield();
+}
+
+void
+MPMCRing::Get(slot *message)
+{
+    while (!TryGet(message))
+	currentThread->Yield();
+}
+
+int
+MPMCRing::Empty()
+{
+    return __atomic_load_n(&in, __ATOMIC_ACQUIRE) ==
+	   __atomic_load_n(&out, __ATOMIC_ACQUIRE);
+}
+
+int
+MPMCRing::Full()
+{
+    return __atomic_load_n(&in, __ATOMIC_ACQUIRE) -
+	   __atomic_load_n(&out, __ATOMIC_ACQUIRE) == mask + 1;
+}
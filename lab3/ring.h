@@ -33,6 +33,9 @@ class Ring {
     void Put(slot *message); // Put a message the next empty slot.
     
     void Get(slot *message); // Get a message from the next  full slot.
+
+    void PutBatch(slot *messages, int n);	// Put "n" messages, and
+    void GetBatch(slot *messages, int n);	// get "n", in one go
                                             
     int Full();       // Returns non-0 if the ring is full, 0 otherwise.
     int Empty();      // Returns non-0 if the ring is empty, 0 otherwise.
@@ -43,4 +46,78 @@ class Ring {
     slot *buffer;       // A pointer to an array for the ring buffer.
 };
 
+// The following two ring buffers need no semaphores: their indices are
+// updated with atomic operations, so they are safe even between threads
+// that really run at the same time.  (In Nachos, a Put on a full ring
+// or a Get on an empty one just yields until the other side catches
+// up; TryPut and TryGet return FALSE instead.)
+//
+// Each index is written by one side and read by the other, so each
+// is padded out to a cache line of its own -- otherwise every Put would
+// take the line away from the consumer, and every Get from the producer.
+
+#define CacheLineSize	64
+
+// A ring for exactly one producer and one consumer.  "in" and "out"
+// count Puts and Gets; each is only written by its own side.
+
+class SPSCRing {
+  public:
+    SPSCRing(int sz);
+    ~SPSCRing();
+
+    void Put(slot *message);
+    void Get(slot *message);
+    bool TryPut(slot *message);	// FALSE if the ring is full
+    bool TryGet(slot *message);	// FALSE if the ring is empty
+
+    int Full();
+    int Empty();
+
+  private:
+    int size;
+    slot *buffer;
+    char pad0[CacheLineSize];
+    unsigned int in;		// written only by the producer
+    char pad1[CacheLineSize];
+    unsigned int out;		// written only by the consumer
+    char pad2[CacheLineSize];
+};
+
+// A ring for any number of producers and consumers.  Each cell has a
+// sequence number saying whose turn it is: a producer may fill the
+// cell when it equals the producer's position, a consumer may empty it
+// when it is one more.  A thread claims a position by compare-and-swap
+// on "in" or "out", so the cells themselves are never locked.  The
+// size is rounded up to a power of two.
+
+class MPMCCell {
+  public:
+    unsigned int sequence;
+    slot message;
+};
+
+class MPMCRing {
+  public:
+    MPMCRing(int sz);
+    ~MPMCRing();
+
+    void Put(slot *message);
+    void Get(slot *message);
+    bool TryPut(slot *message);	// FALSE if the ring is full
+    bool TryGet(slot *message);	// FALSE if the ring is empty
+
+    int Full();
+    int Empty();
+
+  private:
+    unsigned int mask;		// size - 1
+    MPMCCell *cells;
+    char pad0[CacheLineSize];
+    unsigned int in;		// next position to fill
+    char pad1[CacheLineSize];
+    unsigned int out;		// next position to empty
+    char pad2[CacheLineSize];
+};
+
 
@@ -11,8 +11,13 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	Priority scheduling: the ready thread with the most urgent
+//	(lowest) priority runs first, FIFO among equal priorities.  Each
+//	priority has its own queue, and a bitmap records which of them are
+//	not empty, so both ReadyToRun and FindNextToRun take constant time.
+//
+//	Or, stride scheduling (see scheduler.h), with the ready threads in
+//	a heap, so that both take O(log n) time.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,30 +27,43 @@
 #include "scheduler.h"
 #include "system.h"
 
+#include <strings.h>			// for ffs
+
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
-// 	Initialize the list of ready but not running threads to empty.
+// 	Initialize the lists of ready but not running threads to empty.
 //----------------------------------------------------------------------
 
 Scheduler::Scheduler()
 { 
-    readyList = new List; 
+    for (int p = 0; p < NumPriorities; p++)
+	readyList[p] = new List; 
+    for (int w = 0; w < ReadyMaskWords; w++)
+	readyMask[w] = 0;
+    policy = FIFOScheduling;
+    heapMax = 16;
+    heap = new Thread *[heapMax];
+    heapSize = 0;
+    globalPass = 0;
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
-// 	De-allocate the list of ready threads.
+// 	De-allocate the lists of ready threads.
 //----------------------------------------------------------------------
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    for (int p = 0; p < NumPriorities; p++)
+	delete readyList[p]; 
+    delete [] heap;
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
-//	Put it on the ready list, for later scheduling onto the CPU.
+//	Put it at the end of the ready list for its priority, for later
+//	scheduling onto the CPU.
 //
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
@@ -53,11 +71,18 @@ Scheduler::~Scheduler()
 void
 Scheduler::ReadyToRun (Thread *thread)
 {
+    int priority = thread->getPriority();
+
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
+    ASSERT((priority >= 0) && (priority < NumPriorities));
     thread->setStatus(READY);
-    readyList->SortedInsert((void*)thread, thread->getPriority());
-    //readyList->Append((void *)thread);
+    if (policy == StrideScheduling) {
+	HeapInsert(thread);
+	return;
+    }
+    readyList[priority]->Append((void *)thread);
+    readyMask[priority / 32] |= 1 << (priority % 32);
 }
 
 //----------------------------------------------------------------------
@@ -71,7 +96,149 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->Remove();
+    if (policy == StrideScheduling)
+	return HeapRemove();
+
+    int priority = TopPriority();
+
+    if (priority == NumPriorities)
+	return NULL;
+
+    Thread *thread = (Thread *)readyList[priority]->Remove();
+
+    if (readyList[priority]->IsEmpty())
+	readyMask[priority / 32] &= ~(1 << (priority % 32));
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TopPriority
+// 	Return the most urgent priority that has a thread ready, from the
+//	bitmap, or NumPriorities if no thread is ready.
+//----------------------------------------------------------------------
+
+int
+Scheduler::TopPriority ()
+{
+    for (int w = 0; w < ReadyMaskWords; w++)
+	if (readyMask[w] != 0)
+	    return w * 32 + ffs(readyMask[w]) - 1;
+    return NumPriorities;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::WouldSwitch
+// 	Return TRUE if yielding would switch "thread" (the running thread)
+//	for another: if a thread of the same or a more urgent priority is
+//	ready, or, with stride scheduling, if any thread is.  A thread
+//	only less urgent than it would just be put back, so Thread::Yield
+//	can skip the round trip through the ready list.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::WouldSwitch (Thread *thread)
+{
+    if (policy == StrideScheduling)
+	return (bool)(heapSize > 0);
+    return (bool)(TopPriority() <= thread->getPriority());
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Reprioritize
+// 	Give "thread" the effective priority "priority" (see Lock, in
+//	synch.cc).  If it is on the ready list, it moves to the end of the
+//	queue for its new priority.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Reprioritize (Thread *thread, int priority)
+{
+    int old = thread->getPriority();
+
+    ASSERT((priority >= 0) && (priority < NumPriorities));
+    if ((thread->getStatus() != READY) || (priority == old)
+	    || (policy == StrideScheduling)) {	// the heap doesn't care
+	thread->setEffectivePriority(priority);
+	return;
+    }
+
+    List *queue = readyList[old];
+    List *others = new List;
+    Thread *t;
+
+    while ((t = (Thread *)queue->Remove()) != NULL)	// take it out
+	if (t != thread)
+	    others->Append((void *)t);
+    readyList[old] = others;
+    delete queue;
+    if (others->IsEmpty())
+	readyMask[old / 32] &= ~(1 << (old % 32));
+    thread->setEffectivePriority(priority);
+    ReadyToRun(thread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::HeapInsert
+// 	Put "thread" in the heap of ready threads, by its pass.  A thread
+//	that has been blocked for a while would have a pass far behind
+//	everyone else's, and could then run for as long as it took to
+//	catch up; so no thread comes back with a pass lower than that of
+//	the last thread picked.
+//----------------------------------------------------------------------
+
+void
+Scheduler::HeapInsert (Thread *thread)
+{
+    int i, parent;
+
+    if (thread->pass < globalPass)
+	thread->pass = globalPass;
+    if (heapSize == heapMax) {			// make room
+	Thread **bigger = new Thread *[2 * heapMax];
+
+	for (i = 0; i < heapSize; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	heapMax *= 2;
+    }
+    for (i = heapSize++; i > 0; i = parent) {	// sift up
+	parent = (i - 1) / 2;
+	if (heap[parent]->pass <= thread->pass)
+	    break;
+	heap[i] = heap[parent];
+    }
+    heap[i] = thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::HeapRemove
+// 	Take the ready thread with the lowest pass out of the heap, and
+//	advance its pass by its stride.  Return NULL if the heap is empty.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::HeapRemove ()
+{
+    Thread *thread, *last;
+    int i, child;
+
+    if (heapSize == 0)
+	return NULL;
+    thread = heap[0];
+    last = heap[--heapSize];
+    for (i = 0; (child = 2 * i + 1) < heapSize; i = child) {	// sift down
+	if ((child + 1 < heapSize) && (heap[child + 1]->pass < heap[child]->pass))
+	    child++;
+	if (last->pass <= heap[child]->pass)
+	    break;
+	heap[i] = heap[child];
+    }
+    heap[i] = last;
+
+    globalPass = thread->pass;
+    thread->pass += StrideOne / thread->getTickets();
+    return thread;
 }
 
 //----------------------------------------------------------------------
@@ -105,6 +272,8 @@ Scheduler::Run (Thread *nextThread)
 
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
+    stats->totalTicks += switchTicks;	    // which costs something
+    stats->systemTicks += switchTicks;
     
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
@@ -144,5 +313,8 @@ void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int p = 0; p < NumPriorities; p++)
+	readyList[p]->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int i = 0; i < heapSize; i++)
+	heap[i]->Print();
 }
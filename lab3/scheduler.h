@@ -13,6 +13,30 @@
 #include "list.h"
 #include "thread.h"
 
+// Scheduling policies, chosen at boot (see threads/system.cc).  Here,
+// scheduling is by priority (FIFOScheduling means FIFO within each
+// priority, and there is no feedback queue), or by stride scheduling.
+
+enum SchedulingPolicy { FIFOScheduling, FeedbackScheduling,
+			StrideScheduling };
+
+// Stride scheduling gives each thread a share of the CPU proportional
+// to its tickets.  Each thread has a "pass"; the ready thread with the
+// lowest pass runs next, and its pass then goes up by its stride,
+// StrideOne / tickets -- so a thread with twice the tickets gets picked
+// twice as often.  The ready threads are kept in a heap by pass.
+
+#define StrideOne	(1 << 20)
+
+// Priorities run from 0 (the most urgent) to NumPriorities - 1; there
+// is a FIFO ready queue for each, and a bitmap of which queues are
+// not empty, so that finding the next thread doesn't depend on how many
+// threads are ready.
+
+#define NumPriorities	100
+#define ReadyMaskWords	4		// enough 32-bit words for a bit
+					// per priority
+
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
@@ -25,12 +49,37 @@ class Scheduler {
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.  ̷߳䵽
     Thread* FindNextToRun();		// Dequeue first thread on the ready  
 					// list, if any, and return thread.
+    bool WouldSwitch(Thread *thread);	// Is any ready thread as urgent
+					// as "thread"?  (Without taking
+					// it off the ready list)
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
+    void Reprioritize(Thread *thread, int priority);
+					// Change the (effective) priority
+					// of a thread, which may be ready
+
+    void SetPolicy(SchedulingPolicy p) { policy = p; }
+    void SetCPUs(int n) {}		// only one CPU here
+    void SetNodes(int n) {}		// (so one NUMA node)
+    bool TimerTick() { return TRUE; }	// every tick ends the slice
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
+    SchedulingPolicy policy;
+    List *readyList[NumPriorities];	// queues of threads that are ready
+				// to run, but not running, by priority
+    unsigned int readyMask[ReadyMaskWords];	// bit p set if queue p
+				// is not empty
+
+    Thread **heap;		// with stride scheduling, the ready
+				// threads, a heap by pass
+    int heapSize;		// how many threads are in the heap
+    int heapMax;		// how many it has room for
+    int globalPass;		// pass of the last thread picked
+
+    int TopPriority();		// the most urgent priority with a
+				// thread ready, or NumPriorities if none
+    void HeapInsert(Thread *thread);
+    Thread *HeapRemove();	// take off the thread with the lowest pass
 };
 
 #endif // SCHEDULER_H
@@ -0,0 +1,385 @@
+// synch.cc 
+//	Routines for synchronizing threads.  Three kinds of
+//	synchronization routines are defined here: semaphores, locks 
+//   	and condition variables (the implementation of the last two
+//	are left to the reader).
+//
+// Any implementation of a synchronization routine needs some
+// primitive atomic operation.  We assume Nachos is running on
+// a uniprocessor, and thus atomicity can be provided by
+// turning off interrupts.  While interrupts are disabled, no
+// context switch can occur, and thus the current thread is guaranteed
+// to hold the CPU throughout, until interrupts are reenabled.
+//
+// Because some of these routines might be called with interrupts
+// already disabled (Semaphore::V for one), instead of turning
+// on interrupts at the end of the atomic operation, we always simply
+// re-set the interrupt state back to its original value (whether
+// that be disabled or enabled).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "synch.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Semaphore::Semaphore
+// 	Initialize a semaphore, so that it can be used for synchronization.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//	"initialValue" is the initial value of the semaphore.
+//----------------------------------------------------------------------
+
+Semaphore::Semaphore(const char* debugName, int initialValue)
+{
+    name = (char*)debugName;
+    value = initialValue;
+    queue = new List;
+}
+
+//----------------------------------------------------------------------
+// Semaphore::~Semaphore
+// 	De-allocate semaphore, when no longer needed.  Assume no one
+//	is still waiting on the semaphore!
+//----------------------------------------------------------------------
+
+Semaphore::~Semaphore()
+{
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// Semaphore::P
+// 	Wait until semaphore value > 0, then decrement.  Checking the
+//	value and decrementing must be done atomically, so we
+//	need to disable interrupts before checking the value.
+//
+//	Note that Thread::Sleep assumes that interrupts are disabled
+//	when it is called.
+//----------------------------------------------------------------------
+
+void
+Semaphore::P()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
+    
+    while (value == 0) { 			// semaphore not available
+	queue->Append((void *)currentThread);	// so go to sleep
+	currentThread->Sleep();
+    } 
+    value--; 					// semaphore available, 
+						// consume its value
+    
+    (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
+}
+
+//----------------------------------------------------------------------
+// Semaphore::V
+// 	Increment semaphore value, waking up a waiter if necessary.
+//	As with P(), this operation must be atomic, so we need to disable
+//	interrupts.  Scheduler::ReadyToRun() assumes that threads
+//	are disabled when it is called.
+//----------------------------------------------------------------------
+
+void
+Semaphore::V()
+{
+    Thread *thread;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    thread = (Thread *)queue->Remove();
+    if (thread != NULL)	   // make thread ready, consuming the V immediately
+	scheduler->ReadyToRun(thread);
+    value++;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+
+//----------------------------------------------------------------------
+// Lock::Lock
+// 	Initialize a lock, so that it can be used for synchronization.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+
+Lock::Lock(const char* debugName) 
+{
+    name = (char*)debugName;
+    owner = NULL;
+    waiters = new List;
+    nextHeld = NULL;
+}
+
+
+//----------------------------------------------------------------------
+// Lock::~Lock
+// 	De-allocate lock, when no longer needed.  As with semaphore,
+//	assume no one is still waiting on the lock.
+//----------------------------------------------------------------------
+Lock::~Lock() 
+{
+    delete waiters;
+}
+
+//----------------------------------------------------------------------
+// Lock::Acquire
+//      Wait until the lock is free, then take it.  Record which 
+//      thread acquired the lock in order to assure that only the
+//      same thread releases it.
+//
+//	While we wait, our priority is passed on to the owner (see
+//	Donate).  The lock is handed to us directly by Release, so when
+//	we wake up it is ours.
+//----------------------------------------------------------------------
+void Lock::Acquire() 
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);  // disable interrupts
+
+    ASSERT(owner != currentThread);	// no recursive locking
+    if (owner != NULL) {
+	currentThread->waitingOn = this;
+	waiters->Append((void *)currentThread);
+	Donate(currentThread->getPriority());
+	currentThread->Sleep();
+	ASSERT(owner == currentThread);	// Release gave it to us
+    } else {
+	owner = currentThread;		// record the new owner of the lock
+	nextHeld = currentThread->heldLocks;
+	currentThread->heldLocks = this;
+    }
+    (void) interrupt->SetLevel(oldLevel); // re-enable interrupts
+}
+
+//----------------------------------------------------------------------
+// Lock::Release
+//      Set the lock to be free, and check that the currentThread is
+//      allowed to release this lock.  We give up whatever priority we
+//      inherited through the lock, and hand it on to the most urgent
+//      thread waiting for it (which then inherits from whoever is
+//      still waiting).
+//----------------------------------------------------------------------
+void Lock::Release() 
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);  // disable interrupts
+    Lock **ptr;
+    int priority;
+
+    // Ensure: a) lock is BUSY  b) this thread is the same one that acquired it.
+    ASSERT(currentThread == owner);        
+    for (ptr = &owner->heldLocks; *ptr != this; ptr = &(*ptr)->nextHeld)
+	ASSERT(*ptr != NULL);
+    *ptr = nextHeld;			// we no longer hold it
+    owner = NULL;                          // clear the owner
+
+    priority = currentThread->getBasePriority();	// what is left?
+    for (Lock *held = currentThread->heldLocks; held != NULL;
+	    held = held->nextHeld)
+	if (held->WaiterPriority() < priority)
+	    priority = held->WaiterPriority();
+    scheduler->Reprioritize(currentThread, priority);
+
+    if (!waiters->IsEmpty()) {		// hand the lock on
+	Thread *thread = RemoveWaiter();
+
+	thread->waitingOn = NULL;
+	owner = thread;
+	nextHeld = thread->heldLocks;
+	thread->heldLocks = this;
+	if (WaiterPriority() < thread->getPriority())
+	    thread->setEffectivePriority(WaiterPriority());
+	scheduler->ReadyToRun(thread);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::WaiterPriority
+// 	Return the most urgent priority of the threads waiting for the
+//	lock, or NumPriorities if there are none.
+//----------------------------------------------------------------------
+
+int Lock::WaiterPriority()
+{
+    int priority = NumPriorities;
+    List *others = new List;
+    Thread *thread;
+
+    while ((thread = (Thread *)waiters->Remove()) != NULL) {
+	if (thread->getPriority() < priority)
+	    priority = thread->getPriority();
+	others->Append((void *)thread);
+    }
+    delete waiters;
+    waiters = others;
+    return priority;
+}
+
+//----------------------------------------------------------------------
+// Lock::Donate
+// 	A thread with priority "priority" is now waiting for the lock.
+//	If that is more urgent than the owner's, raise the owner's
+//	priority to it; and if the owner is itself blocked on a lock,
+//	pass it on to that lock's owner too, and so on down the chain.
+//----------------------------------------------------------------------
+
+void Lock::Donate(int priority)
+{
+    for (Lock *l = this; (l != NULL) && (l->owner != NULL);
+	    l = l->owner->waitingOn) {
+	if (l->owner->getPriority() <= priority)
+	    break;			// already at least that urgent
+	DEBUG('t', "Thread \"%s\" inherits priority %d through lock %s\n",
+	      l->owner->getName(), priority, l->name);
+	scheduler->Reprioritize(l->owner, priority);
+    }
+}
+
+//----------------------------------------------------------------------
+// Lock::RemoveWaiter
+// 	Take the most urgent of the threads waiting for the lock off the
+//	list (the first to wait, among equals).
+//----------------------------------------------------------------------
+
+Thread *Lock::RemoveWaiter()
+{
+    int priority = WaiterPriority();
+    List *others = new List;
+    Thread *thread, *chosen = NULL;
+
+    while ((thread = (Thread *)waiters->Remove()) != NULL)
+	if ((chosen == NULL) && (thread->getPriority() == priority))
+	    chosen = thread;
+	else
+	    others->Append((void *)thread);
+    delete waiters;
+    waiters = others;
+    return chosen;
+}
+
+//----------------------------------------------------------------------
+// Lock::AddWaiter
+//      "thread" (which is asleep, waiting on a condition that has just
+//      been signalled) should now wait for the lock, just as if it had
+//      called Acquire: Release will hand the lock to it, and meanwhile
+//      its priority is passed on to our owner.  Interrupts are assumed
+//      to be off.
+//----------------------------------------------------------------------
+void Lock::AddWaiter(Thread *thread)
+{
+    ASSERT(interrupt->getLevel() == IntOff);
+    thread->waitingOn = this;
+    waiters->Append((void *)thread);
+    Donate(thread->getPriority());
+}
+
+//----------------------------------------------------------------------
+// Lock::isHeldByCurrentThread
+//----------------------------------------------------------------------
+bool Lock::isHeldByCurrentThread()
+{
+    bool result;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    result = currentThread == owner;
+    (void) interrupt->SetLevel(oldLevel);
+    return(result);
+}
+
+//----------------------------------------------------------------------
+// Condition::Condition
+// 	Initialize a condition variable, so that it can be used for 
+//      synchronization.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+Condition::Condition(const char* debugName) 
+{ 
+    name = (char*)debugName;
+    queue = new List;
+    lock = NULL;
+}
+
+//----------------------------------------------------------------------
+// Condition::~Condition
+// 	De-allocate a condition variable, when no longer needed.  As
+//      with semaphore, assume no one is still waiting on the condition.
+//----------------------------------------------------------------------
+
+Condition::~Condition() 
+{ 
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// Condition::Wait
+//
+//      Release the lock, relinquish the CPU until signaled, then
+//      re-acquire the lock.  Signal puts us on the lock's waiters, and
+//      Release hands us the lock, so when we wake up it is ours.
+//
+//      Pre-conditions:  currentThread is holding the lock; threads in
+//      the queue are waiting on the same lock.
+//----------------------------------------------------------------------
+void Condition::Wait(Lock* conditionLock) 
+{ 
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(conditionLock->isHeldByCurrentThread());  // check pre-condition
+    if(queue->IsEmpty()) {
+	lock = conditionLock;  // helps to enforce pre-condition
+    } 
+    ASSERT(lock == conditionLock); // another pre-condition
+    queue->Append(currentThread);  // add this thread to the waiting list
+    conditionLock->Release();      // release the lock
+    currentThread->Sleep();        // goto sleep
+    ASSERT(conditionLock->isHeldByCurrentThread());  // awaken, holding
+						     // the lock again
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Condition::Signal
+//      Wake up a thread, if there are any waiting on the condition.
+//   
+//      Pre-conditions:  currentThread is holding the lock; threads in
+//      the queue are waiting on the same lock.
+//----------------------------------------------------------------------
+void Condition::Signal(Lock* conditionLock) 
+{ 
+    Thread *nextThread;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    if(!queue->IsEmpty()) {
+	ASSERT(lock == conditionLock);
+	nextThread = (Thread *)queue->Remove();
+	conditionLock->AddWaiter(nextThread);	// wake it for the lock
+    } 
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Condition::Broadcast
+//      Wake up all threads waiting on the condition.   
+//
+//      Pre-conditions:  currentThread is holding the lock; threads in
+//      the queue are waiting on the same lock.
+//----------------------------------------------------------------------
+void Condition::Broadcast(Lock* conditionLock) 
+{ 
+    Thread *nextThread;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    if(!queue->IsEmpty()) {
+	ASSERT(lock == conditionLock);
+	while( (nextThread = (Thread *)queue->Remove()) ) {
+	    conditionLock->AddWaiter(nextThread);  // wake it for the lock
+	}
+    } 
+    (void) interrupt->SetLevel(oldLevel);
+}
@@ -24,6 +24,73 @@
 					// execution stack, for detecting 
 					// stack overflows
 
+// Getting an execution stack from the host is expensive -- an allocation
+// plus two mprotect calls to fence it (see AllocBoundedArray) -- and
+// threads are created and finished constantly, so when a thread is
+// deleted we keep its stack, still fenced, for the next Fork.
+//
+// Since threads can ask for different stack sizes, stacks are pooled
+// by size class: class i holds stacks of MinStackSize << i words, and
+// a request is rounded up to the size of its class.  Stacks bigger
+// than the largest class are not pooled.
+
+#define StackPoolSize	32		// most stacks kept per class
+#define NumStackClasses	6		// MinStackSize up to 32 times that
+
+static int *stackPool[NumStackClasses][StackPoolSize];
+					// stacks free for reuse
+static int stackPoolCount[NumStackClasses];	// how many there are
+
+//----------------------------------------------------------------------
+// StackClass
+//	Return the size class for a stack of "size" words, rounding "size"
+//	up to the size of the class; -1 if it is too big for any class.
+//----------------------------------------------------------------------
+
+static int
+StackClass(int *size)
+{
+    int which, classSize = MinStackSize;
+
+    for (which = 0; which < NumStackClasses; which++, classSize <<= 1)
+	if (*size <= classSize) {
+	    *size = classSize;
+	    return which;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// GetStack, PutStack
+//	Take an execution stack of "size" words from the pool, allocating
+//	a new one only if there is none of that class; and give one back
+//	to the pool, or to the host if the pool is full.
+//----------------------------------------------------------------------
+
+static int *
+GetStack(int size)
+{
+    int which = StackClass(&size);
+
+    if ((which >= 0) && (stackPoolCount[which] > 0)) {
+	stats->numStackPoolHits++;
+	return stackPool[which][--stackPoolCount[which]];
+    }
+    stats->numStackPoolMisses++;
+    return (int *) AllocBoundedArray(size * sizeof(_int));
+}
+
+static void
+PutStack(int *stack, int size)
+{
+    int which = StackClass(&size);
+
+    if ((which >= 0) && (stackPoolCount[which] < StackPoolSize))
+	stackPool[which][stackPoolCount[which]++] = stack;
+    else
+	DeallocBoundedArray((char *) stack, size * sizeof(_int));
+}
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -37,8 +104,14 @@ Thread::Thread(const char* threadName)
     name = (char*)threadName;
     stackTop = NULL;
     stack = NULL;
+    stackSize = 0;
     status = JUST_CREATED;
     priority = 9;   //ĬȼΪ9
+    effectivePriority = priority;
+    tickets = DefaultTickets;
+    pass = 0;
+    waitingOn = NULL;
+    heldLocks = NULL;
 
 #ifdef USER_PROGRAM
     space = NULL;
@@ -51,13 +124,53 @@ Thread::Thread(const char* threadName,int threadPriority)
     name = (char*)threadName;
     stackTop = NULL; //ջָ
     stack = NULL; //Ķջ
+    stackSize = 0;
     status = JUST_CREATED;
     if (threadPriority > 99)
         priority = 99;
-    if (threadPriority < 0)
+    else if (threadPriority < 0)
         priority = 0;
     else
         priority = threadPriority;
+    effectivePriority = priority;
+    tickets = DefaultTickets;
+    pass = 0;
+    waitingOn = NULL;
+    heldLocks = NULL;
+#ifdef USER_PROGRAM
+    space = NULL;
+#endif
+}
+
+//----------------------------------------------------------------------
+// Thread::Thread
+// 	The same, with "threadTickets", the thread's share of the CPU
+//	under stride scheduling (at least one).
+//----------------------------------------------------------------------
+
+Thread::Thread(const char* threadName, int threadPriority, int threadTickets)
+{
+    name = (char*)threadName;
+    stackTop = NULL;
+    stack = NULL;
+    stackSize = 0;
+    status = JUST_CREATED;
+    if (threadPriority > 99)
+        priority = 99;
+    else if (threadPriority < 0)
+        priority = 0;
+    else
+        priority = threadPriority;
+    effectivePriority = priority;
+    if (threadTickets > StrideOne)
+        tickets = StrideOne;
+    else if (threadTickets < 1)
+        tickets = 1;
+    else
+        tickets = threadTickets;
+    pass = 0;
+    waitingOn = NULL;
+    heldLocks = NULL;
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -81,7 +194,7 @@ Thread::~Thread()
 
     ASSERT(this != currentThread);
     if (stack != NULL)
-		DeallocBoundedArray((char *) stack, StackSize * sizeof(_int));
+		PutStack(stack, stackSize);	// keep it for the next Fork
 }
 
 //----------------------------------------------------------------------
@@ -95,17 +208,26 @@ Thread::~Thread()
 //	to the structure as "arg".
 //
 // 	Implemented as the following steps:
-//		1. Allocate a stack
+//		1. Allocate a stack (reusing that of a deleted thread,
+//		if there is one)
 //		2. Initialize the stack so that a call to SWITCH will
 //		cause it to run the procedure
 //		3. Put the thread on the ready queue
 // 	
 //	"func" is the procedure to run concurrently.
 //	"arg" is a single argument to be passed to the procedure.
+//	"size" is the size of its stack, in words: a thread that doesn't
+//	need much can ask for a smaller stack than the default StackSize
 //----------------------------------------------------------------------
 
 void 
-Thread::Fork(VoidFunctionPtr func, _int arg)    //func(arg)
+Thread::Fork(VoidFunctionPtr func, _int arg)
+{
+    Fork(func, arg, StackSize);
+}
+
+void 
+Thread::Fork(VoidFunctionPtr func, _int arg, int size)    //func(arg)
 {
 #ifdef HOST_ALPHA
     DEBUG('t', "Forking thread \"%s\" with func = 0x%lx, arg = %ld\n",
@@ -116,7 +238,8 @@ Thread::Fork(VoidFunctionPtr func, _int arg)    //
 #endif
     
     //Ϊ̷߳ջռ䲢ʼ
-    StackAllocate(func, arg);
+    ASSERT(size > 0);
+    StackAllocate(func, arg, size);
 
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
     //
@@ -144,7 +267,7 @@ Thread::CheckOverflow()
 {
     if (stack != NULL)
 #ifdef HOST_SNAKE			// Stacks grow upward on the Snakes
-	ASSERT((unsigned int)stack[StackSize - 1] == STACK_FENCEPOST);
+	ASSERT((unsigned int)stack[stackSize - 1] == STACK_FENCEPOST);
 #else
 	ASSERT((unsigned int)*stack == STACK_FENCEPOST);
 #endif
@@ -185,9 +308,11 @@ Thread::Finish ()
 //	If so, put the thread on the end of the ready list, so that
 //	it will eventually be re-scheduled.
 //
-//	NOTE: returns immediately if no other thread on the ready queue.
-//	Otherwise returns when the thread eventually works its way
-//	to the front of the ready list and gets re-scheduled.
+//	NOTE: returns immediately if no other thread on the ready queue
+//	is as urgent as this one (see Scheduler::WouldSwitch), without
+//	touching the ready list.  Otherwise returns when the thread
+//	eventually works its way to the front of the ready list and gets
+//	re-scheduled.
 //
 //	NOTE: we disable interrupts, so that looking at the thread
 //	on the front of the ready list, and switching to it, can be done
@@ -207,6 +332,10 @@ Thread::Yield ()
     
     DEBUG('t', "Yielding thread \"%s\"\n", getName());
     
+    if (!scheduler->WouldSwitch(this)) {
+	(void) interrupt->SetLevel(oldLevel);
+	return;
+    }
     nextThread = scheduler->FindNextToRun();
     if (nextThread != NULL) {
 	scheduler->ReadyToRun(this);
@@ -252,6 +381,21 @@ Thread::Sleep ()
     scheduler->Run(nextThread); // returns when we've been signalled
 }
 
+//----------------------------------------------------------------------
+// Thread::SleepFor
+// 	Relinquish the CPU until "ticks" of simulated time have passed,
+//	on the alarm clock (see alarm.h), rather than spinning with Yield:
+//	the thread is not on the ready list until its time comes.
+//----------------------------------------------------------------------
+
+void
+Thread::SleepFor(int ticks)
+{
+    ASSERT(this == currentThread);
+    
+    alarmClock->SleepUntil(stats->totalTicks + ticks);
+}
+
 //----------------------------------------------------------------------
 // ThreadFinish, InterruptEnable, ThreadPrint
 //	Dummy functions because C++ does not allow a pointer to a member
@@ -274,24 +418,27 @@ void ThreadPrint(_int arg){ Thread *t = (Thread *)arg; t->Print(); }
 //
 //	"func" is the procedure to be forked
 //	"arg" is the parameter to be passed to the procedure
+//	"size" is how big the stack must be, in words
 //----------------------------------------------------------------------
 
 void
-Thread::StackAllocate (VoidFunctionPtr func, _int arg)
+Thread::StackAllocate (VoidFunctionPtr func, _int arg, int size)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(_int));
+    (void) StackClass(&size);		// all of its class is ours to use
+    stackSize = size;
+    stack = GetStack(stackSize);
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
     stackTop = stack + 16;	// HP requires 64-byte frame marker
-    stack[StackSize - 1] = STACK_FENCEPOST;
+    stack[stackSize - 1] = STACK_FENCEPOST;
 #else
     // i386 & MIPS & SPARC & ALPHA stack works from high addresses to low addresses
 #ifdef HOST_SPARC
     // SPARC stack must contains at least 1 activation record to start with.
-    stackTop = stack + StackSize - 96;
+    stackTop = stack + stackSize - 96;
 #else  // HOST_MIPS  || HOST_i386 || HOST_ALPHA
-    stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
+    stackTop = stack + stackSize - 4;	// -4 to be on the safe side!
 #ifdef HOST_i386
     // the 80386 passes the return address on the stack.  In order for
     // SWITCH() to go to ThreadRoot when we switch to this thread, the
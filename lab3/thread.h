@@ -54,7 +54,9 @@
 
 // Size of the thread's private execution stack.
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
-#define StackSize	(sizeof(_int) * 1024)	// in words
+#define StackSize	(sizeof(_int) * 1024)	// in words, by default
+#define MinStackSize	256			// smallest we hand out
+#define DefaultTickets	100			// share of the CPU, by default
 
 
 // Thread state
@@ -63,6 +65,8 @@ enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 // external function, dummy routine whose sole job is to call Thread::Print
 extern void ThreadPrint(_int arg);	 
 
+class Lock;
+
 // The following class defines a "thread control block" -- which
 // represents a single thread of execution.
 //
@@ -84,6 +88,9 @@ class Thread {
   public:
     Thread(const char* debugName);		// initialize a Thread 
     Thread(const char* debugName, int threadPriority);  //ɴȼĹ캯
+    Thread(const char* debugName, int threadPriority, int threadTickets);
+					// ... with tickets, for stride
+					// scheduling (see scheduler.h)
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
 					// must not be running when delete 
@@ -92,10 +99,14 @@ class Thread {
     // basic thread operations
 
     void Fork(VoidFunctionPtr func, _int arg); 	// Make thread run (*func)(arg)
+    void Fork(VoidFunctionPtr func, _int arg, int size);
+						// ... on a stack of "size" words
     void Yield();  				// Relinquish the CPU if any 
 						// other thread is runnable
     void Sleep();  				// Put the thread to sleep and 
 						// relinquish the processor
+    void SleepFor(int ticks);			// Sleep until "ticks" of
+						// simulated time have passed
     void Finish();  				// The thread is done executing
     
     void CheckOverflow();   			// Check if thread has 
@@ -104,8 +115,22 @@ class Thread {
     char* getName() { return (name); }
     void Print() { printf("%s, ", name); }
     int getPriority() {
-        return priority;
+        return effectivePriority;
     }
+    int getBasePriority() { return priority; }
+    void setEffectivePriority(int p) { effectivePriority = p; }
+					// only for Lock (see synch.cc)
+    ThreadStatus getStatus() { return status; }
+    int getTickets() { return tickets; }
+    int pass;				// for stride scheduling: when it is
+					// next due to run (see scheduler.h)
+
+    // Priority inheritance: a thread holding a Lock runs at the priority
+    // of the most urgent thread waiting for it, if that is higher than
+    // its own.
+    Lock *waitingOn;			// the lock we are blocked on, if any
+    Lock *heldLocks;			// the locks we hold, chained through
+					// Lock::nextHeld
 
   private:
     // some of the private data for this class is listed above
@@ -113,11 +138,16 @@ class Thread {
     int* stack; 	 		// Bottom of the stack 
 					// NULL if this is the main thread
 					// (If NULL, don't deallocate stack)
+    int stackSize;			// size of the stack, in words
     ThreadStatus status;		// ready, running or blocked
     char* name;
     int priority;   //̬ȼ
+    int effectivePriority;		// "priority", or a more urgent one
+					// inherited through a lock we hold
+    int tickets;			// its share of the CPU, with stride
+					// scheduling
 
-    void StackAllocate(VoidFunctionPtr func, _int arg);
+    void StackAllocate(VoidFunctionPtr func, _int arg, int size);
     					// Allocate a stack for thread.
 					// Used internally by Fork()
 
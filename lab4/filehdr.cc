@@ -155,6 +155,47 @@ FileHeader::SetLength(int length)
     this->numBytes = length;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::NumRuns
+// 	Return how many runs of consecutive sectors the file's data is in
+//	-- how many seeks reading all of it takes, at least.  A file made
+//	by appending to it a little at a time may be in many, as each
+//	ExtendSpace takes whatever sectors are free.
+//----------------------------------------------------------------------
+
+int
+FileHeader::NumRuns()
+{
+    int runs = 0;
+
+    for (int i = 0; i < numSectors; i++)
+	if ((i == 0) || (dataSectors[i] != dataSectors[i - 1] + 1))
+	    runs++;
+    return runs;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MoveData
+// 	Copy each of the file's data sectors to the run of sectors from
+//	"start" on, in order, and make the header point to them.  The old
+//	sectors are left as they are, and still allocated, and the header
+//	is only changed in memory: so until the caller writes it back, the
+//	file on disk is still the old one (cf. FileSystem::Defragment).
+//----------------------------------------------------------------------
+
+void
+FileHeader::MoveData(int start)
+{
+    char *data = new char[SectorSize];
+
+    for (int i = 0; i < numSectors; i++) {
+	synchDisk->ReadSector(dataSectors[i], data);
+	synchDisk->WriteSector(start + i, data);
+	dataSectors[i] = start + i;
+    }
+    delete [] data;
+}
+
 bool
 FileHeader::ExtendSpace(BitMap* freeMap, int appendSize)
 {
@@ -162,11 +203,19 @@ FileHeader::ExtendSpace(BitMap* freeMap, int appendSize)
     numSectors = divRoundUp(appendSize, SectorSize) + oriSectors;	//
 //    printf("newSectorsNum is %d\n", numSectors);
     //ʣ
-    if (freeMap->NumClear() < numSectors - oriSectors) 
+    if ((freeMap->NumClear() < numSectors - oriSectors)
+            || (numSectors > NumDirect))
     {
         numSectors = oriSectors;
         return FALSE;		// not enough space
     }
+    int run = freeMap->FindRun(numSectors - oriSectors);
+
+    if (run >= 0) {		// the new sectors all in a row
+        for (int i = oriSectors; i < numSectors; i++)
+            dataSectors[i] = run + i - oriSectors;
+        return TRUE;
+    }
     //ʣ
     for (int i = oriSectors; i < numSectors; i++)	//
         dataSectors[i] = freeMap->Find();
@@ -53,6 +53,11 @@ class FileHeader {
 
     int FileLength();			// Return the length of the file 
 					// in bytes
+    int AllocatedSectors() { return numSectors; }
+					// Return how many data sectors the
+					// file has (there may be more than
+					// its length needs, if they were
+					// preallocated)
 
     void Print();			// Print the contents of the file.
 
@@ -60,6 +65,11 @@ class FileHeader {
 
     bool ExtendSpace(BitMap* freeMap, int appendSize);
 
+    int NumRuns();			// How many runs of consecutive
+					// sectors the data is in
+    void MoveData(int start);		// Copy the data to the sectors from
+					// "start" on, and point to them
+
   private:
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
@@ -21,12 +21,13 @@
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
-//	For those operations (such as Create, Remove) that modify the
-//	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	The contents of the two files are kept in memory too, so that
+//	Create, Open and Remove don't have to read them in each time.
+//	Operations that modify the directory and/or bitmap (such as
+//	Create, Remove) change the copies in memory, and mark them dirty;
+//	they are only written back to disk by Sync (once main has run its
+//	commands, say).  If an operation fails part way through, it
+//	undoes what it had changed.
 //
 // 	Our implementation at this point has the following restrictions:
 //
@@ -64,6 +65,8 @@
 #define NumDirEntries 		10
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
+bool logStructured = FALSE;		// -lfs; this file system ignores it
+
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
@@ -74,15 +77,18 @@
 //	If format = FALSE, we just have to open the files
 //	representing the bitmap and the directory.
 //
+//	Either way, we then keep the bitmap and the directory in memory.
+//
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
 
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    freeMap = new BitMap(NumSectors);
+    directory = new Directory(NumDirEntries);
+    freeMapDirty = directoryDirty = FALSE;
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
 
@@ -128,17 +134,50 @@ FileSystem::FileSystem(bool format)
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
-
-        delete freeMap; 
-	delete directory; 
+	}
 	delete mapHdr; 
 	delete dirHdr;
-	}
     } else {
     // if we are not formatting the disk, just open the files representing
     // the bitmap and directory; these are left open while Nachos is running
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+	freeMap->FetchFrom(freeMapFile);
+	directory->FetchFrom(directoryFile);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	Close the bitmap and the directory.  Any changes to them must
+//	already have been written back (see Sync): no disk I/O can be
+//	done this late.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    delete freeMap;
+    delete directory;
+    delete freeMapFile;
+    delete directoryFile;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Write the bitmap and the directory back to disk, if they have
+//	changed since they were last written.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Sync()
+{
+    if (freeMapDirty) {
+	freeMap->WriteBack(freeMapFile);
+	freeMapDirty = FALSE;
+    }
+    if (directoryDirty) {
+	directory->WriteBack(directoryFile);
+	directoryDirty = FALSE;
     }
 }
 
@@ -150,18 +189,20 @@ FileSystem::FileSystem(bool format)
 //
 //	The steps to create a file are:
 //	  Make sure the file doesn't already exist
+//	  If the directory is full, grow it (see Directory::Grow)
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
 //	  Add the name to the directory
 //	  Store the new file header on disk 
-//	  Flush the changes to the bitmap and the directory back to disk
+//	  Mark the bitmap and the directory dirty
 //
-//	Return TRUE if everything goes ok, otherwise, return FALSE.
+//	Return TRUE if everything goes ok, otherwise, return FALSE,
+//	with the header's sector and the name taken back out again.
 //
 // 	Create fails if:
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
+//	 	no free entry for file in directory, and no room to grow it
 //	 	no free space for data blocks for the file 
 //
 // 	Note that this implementation assumes there is no concurrent access
@@ -174,43 +215,40 @@ FileSystem::FileSystem(bool format)
 bool
 FileSystem::Create(char *name, int initialSize)
 {
-    Directory *directory;
-    BitMap *freeMap;
     FileHeader *hdr;
     int sector;
     bool success;
 
     DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-
     if (directory->Find(name) != -1)
       success = FALSE;			// file is already in directory
-    else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
+    else if (directory->IsFull() && !directory->Grow(directoryFile))
+      success = FALSE;			// no space in directory
+    else {				// (growing it wrote its new entries,
+					// and took sectors from the bitmap)
         sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
+        else if (!directory->Add(name, sector)) {
             success = FALSE;	// no space in directory
-	else {
+	    freeMap->Clear(sector);
+	} else {
     	    hdr = new FileHeader;
-	    if (!hdr->Allocate(freeMap, initialSize))
+	    if (!hdr->Allocate(freeMap, initialSize)) {
             	success = FALSE;	// no space on disk for data
-	    else {	
+		directory->Remove(name);
+		freeMap->Clear(sector);
+	    } else {	
 	    	success = TRUE;
-		// everthing worked, flush all changes back to disk
+		// everthing worked; the header goes to disk now, the
+		// bitmap and directory when they are next synced
     	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
-    	    	freeMap->WriteBack(freeMapFile);
+		freeMapDirty = directoryDirty = TRUE;
 	    }
             delete hdr;
 	}
-        delete freeMap;
     }
-    delete directory;
     return success;
 }
 
@@ -227,16 +265,13 @@ FileSystem::Create(char *name, int initialSize)
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
     int sector;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
     sector = directory->Find(name); 
     if (sector >= 0) 		
 	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
     return openFile;				// return NULL if not found
 }
 
@@ -246,7 +281,7 @@ FileSystem::Open(char *name)
 //	    Remove it from the directory
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
-//	    Write changes to directory, bitmap back to disk
+//	    Mark the directory and bitmap dirty
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
@@ -257,49 +292,70 @@ FileSystem::Open(char *name)
 bool
 FileSystem::Remove(char *name)
 { 
-    Directory *directory;
-    BitMap *freeMap;
     FileHeader *fileHdr;
     int sector;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
     sector = directory->Find(name);
-    if (sector == -1) {
-       delete directory;
+    if (sector == -1)
        return FALSE;			 // file not found 
-    }
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
-
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
     directory->Remove(name);
+    OpenFile::Removed(sector);			// if it is open, forget it
 
-    freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
+    freeMapDirty = directoryDirty = TRUE;	// written back by Sync
     delete fileHdr;
-    delete directory;
-    delete freeMap;
     return TRUE;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::Preallocate
+// 	Give the file "name" sectors for its first "size" bytes, all at
+//	once, without changing its length (see OpenFile::Preallocate), so
+//	that a file whose size is known ahead of time, like a log, is laid
+//	out in as few runs as possible, and writing it allocates nothing.
+//
+//	Return TRUE if that worked, FALSE if there is no such file or not
+//	enough free sectors.
+//
+//	"name" -- the name of the file
+//	"size" -- how many bytes it should have room for
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Preallocate(char *name, int size)
+{
+    OpenFile *openFile = Open(name);
+    bool success;
+
+    if (openFile == NULL)
+	return FALSE;			// file not found
+    success = openFile->Preallocate(size);
+    delete openFile;
+    return success;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
-// 	List all the files in the file system directory.
+// 	List all the files in the file system directory, reading it a
+//	sector at a time (see DirectoryIterator), once any changes to it
+//	have been written back.
 //----------------------------------------------------------------------
 
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    Sync();
 
-    directory->FetchFrom(directoryFile);
-    directory->List();
-    delete directory;
+    DirectoryIterator *entries = new DirectoryIterator(directoryFile);
+    DirectoryEntry *entry;
+
+    while ((entry = entries->Next()) != NULL)
+	printf("%s%s\n", entry->name, entry->isDirectory ? "/" : "");
+    delete entries;
 }
 
 //----------------------------------------------------------------------
@@ -317,8 +373,6 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -328,14 +382,106 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
-
-    directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
 } 
+
+//----------------------------------------------------------------------
+// FileSystem::FragmentationReport
+// 	Print how scattered each file is -- how many runs of consecutive
+//	sectors its data is in, and how long they are on average -- and
+//	then how scattered the free space is: a file that grows a little
+//	at a time (see ExtendSpace) ends up in many short runs, each one
+//	a seek to read, and leaves the free sectors in short runs too.
+//----------------------------------------------------------------------
+
+void
+FileSystem::FragmentationReport()
+{
+    FileHeader *hdr = new FileHeader;
+    char *name;
+    int sector, runs;
+    int freeSectors = 0, freeRuns = 0, largest = 0, run = 0;
+
+    printf("File\t\tSectors\tRuns\tAverage run\n");
+    for (int i = 0; i < directory->Size(); i++) {
+	if ((sector = directory->Entry(i, &name)) == -1)
+	    continue;
+	hdr->FetchFrom(sector);
+	runs = hdr->NumRuns();
+	printf("%-9s\t%d\t%d\t%.1f\n", name, hdr->AllocatedSectors(), runs,
+		(runs > 0) ? (double) hdr->AllocatedSectors() / runs : 0.0);
+    }
+
+    for (int i = 0; i <= NumSectors; i++) {
+	if ((i < NumSectors) && !freeMap->Test(i)) {
+	    freeSectors++;
+	    run++;
+	} else if (run > 0) {
+	    freeRuns++;
+	    if (run > largest)
+		largest = run;
+	    run = 0;
+	}
+    }
+    printf("Free: %d sectors in %d runs, the largest %d sectors\n",
+	freeSectors, freeRuns, largest);
+    delete hdr;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Defragment
+// 	Move each file whose data is in more than one run into a single
+//	run of free sectors, if there is one long enough.  This is safe to
+//	stop at any point: the new sectors are marked in use on disk before
+//	anything is copied into them, the file only switches to them when
+//	its header -- a single sector -- is written back, and only then are
+//	the old ones freed.  So a crash leaves either the old file or the
+//	new one, and at worst some sectors marked in use that aren't.
+//
+//	A file that is open is left alone, since its header is in memory
+//	(see OpenFile), and writing that back would undo the move.
+//
+//	Return how many files were moved.
+//----------------------------------------------------------------------
+
+int
+FileSystem::Defragment()
+{
+    FileHeader *hdr = new FileHeader;
+    FileHeader old;
+    char *name;
+    int sector, start, moved = 0;
+
+    for (int i = 0; i < directory->Size(); i++) {
+	if ((sector = directory->Entry(i, &name)) == -1)
+	    continue;
+	if (OpenFile::IsOpen(sector))
+	    continue;
+	hdr->FetchFrom(sector);
+	if (hdr->NumRuns() <= 1)
+	    continue;
+
+	start = freeMap->FindRun(hdr->AllocatedSectors());
+	if (start == -1)
+	    continue;			// no run long enough; leave it be
+	freeMapDirty = TRUE;
+	Sync();				// the new sectors are taken
+
+	old = *hdr;
+	hdr->MoveData(start);
+	hdr->WriteBack(sector);		// the file is now in the new ones
+
+	old.Deallocate(freeMap);
+	freeMapDirty = TRUE;
+	Sync();				// and the old ones are free
+	DEBUG('f', "Moved \"%s\" to sectors %d-%d\n", name, start,
+		start + hdr->AllocatedSectors() - 1);
+	moved++;
+    }
+    delete hdr;
+    return moved;
+}
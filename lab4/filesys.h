@@ -65,6 +65,12 @@ class FileSystem {
 };
 
 #else // FILESYS
+class BitMap;
+class Directory;
+
+extern bool logStructured;		// format the disk log-structured
+					// (-lfs)?  Not supported here
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -73,6 +79,7 @@ class FileSystem {
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+    ~FileSystem();			// Close the bitmap and directory
 
     bool Create(char *name, int initialSize);  	
 					// Create a file (UNIX creat)
@@ -81,15 +88,36 @@ class FileSystem {
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 
+    bool Preallocate(char *name, int size);
+					// Reserve sectors for "size" bytes
+					// of a file (Linux fallocate)
+
     void List();			// List all the files in the file system
 
     void Print();			// List all the files and their contents
 
+    void FragmentationReport();		// How scattered the files, and the
+					// free sectors, are
+    int Defragment();			// Move each file that is in pieces
+					// to a single run of sectors
+
+    void Sync();			// Write the bitmap and directory back
+					// to disk, if they have changed
+    BitMap *FreeMap() { return freeMap; }
+					// The bitmap of free sectors, for an
+					// open file to allocate more from;
+    void FreeMapChanged() { freeMapDirty = TRUE; }
+					// ... and if it did
+
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   BitMap *freeMap;			// The contents of the two files, kept
+   Directory *directory;		// in memory while Nachos is running,
+   bool freeMapDirty;			// and whether each has changed since
+   bool directoryDirty;			// it was last written back
 };
 
 #endif // FILESYS
@@ -4,8 +4,10 @@
 //	We implement:
 //	   Copy -- copy a file from UNIX to Nachos
 //	   Print -- cat the contents of a Nachos file 
-//	   Perftest -- a stress test for the Nachos file system
-//		read and write a really large file in tiny chunks
+//	   Perftest -- a stress test for the Nachos file system:
+//		large files read and written sequentially and at random,
+//		many small files, files created and removed, and files
+//		that grow, with the cost of each
 //		(won't work on baseline system!)
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -22,6 +24,7 @@
 #include "stats.h"
 
 #include "directory.h"
+#include "filehdr.h"
 
 
 #define TransferSize 	10 	// make it small, just to be difficult
@@ -273,80 +276,330 @@ Print(char *name)
 
 //----------------------------------------------------------------------
 // PerformanceTest
-// 	Stress the Nachos file system by creating a large file, writing
-//	it out a bit at a time, reading it back a bit at a time, and then
-//	deleting the file.
+// 	Stress the Nachos file system with a suite of workloads, and
+//	print what each cost: the simulated time it took, the disk
+//	requests it made, and how far the head moved for them.  The
+//	numbers are the baseline for judging changes to the cache, the
+//	disk layout, the journal, and the disk scheduler.
 //
-//	Implemented as three separate routines:
-//	  FileWrite -- write the file
-//	  FileRead -- read the file
-//	  PerformanceTest -- overall control, and print out performance #'s
+//	The workloads are:
+//	  SequentialTest -- write a large file, and read it back, in
+//		chunks of several sizes
+//	  RandomReadTest -- read small pieces of a large file, at random
+//	  CreateRemoveTest -- create and remove a file, over and over
+//	  SmallFilesTest -- write, read back, and remove many small files
+//	  AppendTest -- grow two files at once, a little at a time
+//
+//	Each one is bracketed by PerfStart and PerfEnd, which syncs the
+//	sector cache, so that the writes it left dirty are charged to it.
 //----------------------------------------------------------------------
 
 #define FileName 	(char *)"TestFile"
-#define Contents 	(char *)"1234567890"
+#define Contents 	((char *)"1234567890")
 #define ContentSize 	strlen(Contents)
-#define FileSize 	((int)(ContentSize * 100))
+#define LargeChunkSize	(10 * SectorSize)
+#define LargeFileSize	((MaxFileSize / LargeChunkSize) * LargeChunkSize)
+				// a multiple of every chunk size
+#define RandomReadSize	128	// bytes in each random read
+#define NumRandomReads	200
+#define NumStorms	50	// files created and removed
+#define NumSmallFiles	8	// (the directory only holds 10)
+#define SmallFileSize	100
+#define AppendSize	50	// bytes added to a file at a time
+
+static int perfTicks, perfReads, perfWrites, perfRequests, perfSeekTracks;
+
+//----------------------------------------------------------------------
+// PerfStart, PerfEnd
+// 	Note the counters at the start of a workload; and at the end,
+//	write back what it left in the cache, and print how much the
+//	counters went up by.
+//
+//	"what" -- the workload, to print
+//----------------------------------------------------------------------
+
+static void
+PerfStart(const char *what)
+{
+    printf("%s\n", what);
+    perfTicks = stats->totalTicks;
+    perfReads = stats->numDiskReads;
+    perfWrites = stats->numDiskWrites;
+    perfRequests = stats->numDiskRequests;
+    perfSeekTracks = stats->numDiskSeekTracks;
+}
+
+static void
+PerfEnd()
+{
+    int requests;
+
+    fileSystem->Sync();			// the bitmap and directory, then
+    synchDisk->Sync();			// every sector cached
+    requests = stats->numDiskRequests - perfRequests;
+    printf("  ticks %d, disk reads %d, writes %d, average seek %.2f tracks\n",
+	stats->totalTicks - perfTicks, stats->numDiskReads - perfReads,
+	stats->numDiskWrites - perfWrites, (requests == 0) ? 0.0
+	: (double) (stats->numDiskSeekTracks - perfSeekTracks) / requests);
+}
 
-static void 
-FileWrite()
+//----------------------------------------------------------------------
+// FillPattern
+// 	Fill "buffer" with the bytes that belong at "position" of a test
+//	file (the digits of Contents, over and over), so that what is read
+//	back can be checked.
+//----------------------------------------------------------------------
+
+static void
+FillPattern(char *buffer, int numBytes, int position)
+{
+    for (int i = 0; i < numBytes; i++)
+	buffer[i] = Contents[(position + i) % ContentSize];
+}
+
+//----------------------------------------------------------------------
+// FileWrite, FileRead
+// 	Write the file "name", "fileSize" bytes long, sequentially, in
+//	"chunkSize" byte chunks; or read it back, and check it, the same
+//	way.  Return FALSE if something went wrong.
+//----------------------------------------------------------------------
+
+static bool 
+FileWrite(char *name, int fileSize, int chunkSize)
 {
     OpenFile *openFile;    
-    int i, numBytes;
+    char *buffer = new char[chunkSize];
+    int i;
 
-    printf("Sequential write of %d byte file, in %d byte chunks\n", 
-	FileSize, ContentSize);
-    if (!fileSystem->Create(FileName, 0)) {
-      printf("Perf test: can't create %s\n", FileName);
-      return;
+    if (!fileSystem->Create(name, 0)) {
+	printf("Perf test: can't create %s\n", name);
+	delete [] buffer;
+	return FALSE;
     }
-    openFile = fileSystem->Open(FileName);
+    openFile = fileSystem->Open(name);
     if (openFile == NULL) {
-	printf("Perf test: unable to open %s\n", FileName);
-	return;
+	printf("Perf test: unable to open %s\n", name);
+	delete [] buffer;
+	return FALSE;
     }
-    for (i = 0; i < FileSize; i += ContentSize) {
-        numBytes = openFile->Write(Contents, ContentSize);
-	if (numBytes < 10) {
-	    printf("Perf test: unable to write %s\n", FileName);
+    for (i = 0; i < fileSize; i += chunkSize) {
+	FillPattern(buffer, chunkSize, i);
+	if (openFile->Write(buffer, chunkSize) < chunkSize) {
+	    printf("Perf test: unable to write %s\n", name);
 	    delete openFile;
-	    return;
+	    delete [] buffer;
+	    return FALSE;
 	}
     }
 
 //  Write the inode back to the disk, because we have changed it
     openFile->WriteBack();
-    printf("inodes have been written back\n");
     
     delete openFile;	// close file
+    delete [] buffer;
+    return TRUE;
 }
 
-static void 
-FileRead()
+static bool 
+FileRead(char *name, int fileSize, int chunkSize)
 {
     OpenFile *openFile;    
-    char *buffer = new char[ContentSize];
-    int i, numBytes;
-
-    printf("Sequential read of %d byte file, in %d byte chunks\n", 
-	FileSize, ContentSize);
+    char *buffer = new char[chunkSize];
+    char *expected = new char[chunkSize];
+    int i;
+    bool ok = TRUE;
 
-    if ((openFile = fileSystem->Open(FileName)) == NULL) {
-	printf("Perf test: unable to open file %s\n", FileName);
+    if ((openFile = fileSystem->Open(name)) == NULL) {
+	printf("Perf test: unable to open file %s\n", name);
 	delete [] buffer;
-	return;
+	delete [] expected;
+	return FALSE;
     }
-    for (i = 0; i < FileSize; i += ContentSize) {
-        numBytes = openFile->Read(buffer, ContentSize);
-	if ((numBytes < 10) || strncmp(buffer, Contents, ContentSize)) {
-	    printf("Perf test: unable to read %s\n", FileName);
-	    delete openFile;
-	    delete [] buffer;
-	    return;
+    for (i = 0; ok && (i < fileSize); i += chunkSize) {
+	FillPattern(expected, chunkSize, i);
+	if ((openFile->Read(buffer, chunkSize) < chunkSize)
+		|| memcmp(buffer, expected, chunkSize)) {
+	    printf("Perf test: unable to read %s\n", name);
+	    ok = FALSE;
 	}
     }
     delete [] buffer;
+    delete [] expected;
     delete openFile;	// close file
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// SequentialTest
+// 	Write a large file, and read it back, in "chunkSize" byte chunks.
+//----------------------------------------------------------------------
+
+static void
+SequentialTest(int chunkSize)
+{
+    char what[80];
+
+    sprintf(what, "Sequential write of %d byte file, in %d byte chunks", 
+	LargeFileSize, chunkSize);
+    PerfStart(what);
+    if (!FileWrite(FileName, LargeFileSize, chunkSize))
+	return;
+    PerfEnd();
+
+    sprintf(what, "Sequential read of %d byte file, in %d byte chunks", 
+	LargeFileSize, chunkSize);
+    PerfStart(what);
+    if (FileRead(FileName, LargeFileSize, chunkSize))
+	PerfEnd();
+    if (!fileSystem->Remove(FileName))
+	printf("Perf test: unable to remove %s\n", FileName);
+}
+
+//----------------------------------------------------------------------
+// RandomReadTest
+// 	Read RandomReadSize bytes at each of NumRandomReads random places
+//	in a large file (which isn't counted), checking each.
+//----------------------------------------------------------------------
+
+static void
+RandomReadTest()
+{
+    char what[80];
+    char buffer[RandomReadSize], expected[RandomReadSize];
+    OpenFile *openFile;
+
+    if (!FileWrite(FileName, LargeFileSize, LargeChunkSize))
+	return;
+    openFile = fileSystem->Open(FileName);
+    ASSERT(openFile != NULL);
+
+    sprintf(what, "Random reads of %d bytes, from %d byte file", 
+	RandomReadSize, LargeFileSize);
+    PerfStart(what);
+    for (int i = 0; i < NumRandomReads; i++) {
+	int position = Random() % (LargeFileSize - RandomReadSize);
+
+	FillPattern(expected, RandomReadSize, position);
+	if ((openFile->ReadAt(buffer, RandomReadSize, position)
+		    < RandomReadSize)
+		|| memcmp(buffer, expected, RandomReadSize)) {
+	    printf("Perf test: unable to read %s\n", FileName);
+	    break;
+	}
+    }
+    PerfEnd();
+    delete openFile;
+    if (!fileSystem->Remove(FileName))
+	printf("Perf test: unable to remove %s\n", FileName);
+}
+
+//----------------------------------------------------------------------
+// CreateRemoveTest
+// 	Create an empty file and remove it again, NumStorms times.
+//----------------------------------------------------------------------
+
+static void
+CreateRemoveTest()
+{
+    char what[80];
+
+    sprintf(what, "Create and remove of an empty file, %d times", NumStorms);
+    PerfStart(what);
+    for (int i = 0; i < NumStorms; i++)
+	if (!fileSystem->Create(FileName, 0)
+		|| !fileSystem->Remove(FileName)) {
+	    printf("Perf test: unable to create and remove %s\n", FileName);
+	    break;
+	}
+    PerfEnd();
+}
+
+//----------------------------------------------------------------------
+// SmallFilesTest
+// 	Write NumSmallFiles files of SmallFileSize bytes each, read them
+//	all back, and remove them.
+//----------------------------------------------------------------------
+
+static void
+SmallFilesTest()
+{
+    char what[80], name[FileNameMaxLen + 1];
+    int i;
+
+    sprintf(what, "Write of %d files of %d bytes", NumSmallFiles,
+	SmallFileSize);
+    PerfStart(what);
+    for (i = 0; i < NumSmallFiles; i++) {
+	sprintf(name, "Small%d", i);
+	if (!FileWrite(name, SmallFileSize, SmallFileSize))
+	    return;
+    }
+    PerfEnd();
+
+    sprintf(what, "Read of %d files of %d bytes", NumSmallFiles,
+	SmallFileSize);
+    PerfStart(what);
+    for (i = 0; i < NumSmallFiles; i++) {
+	sprintf(name, "Small%d", i);
+	FileRead(name, SmallFileSize, SmallFileSize);
+    }
+    PerfEnd();
+
+    sprintf(what, "Remove of %d files", NumSmallFiles);
+    PerfStart(what);
+    for (i = 0; i < NumSmallFiles; i++) {
+	sprintf(name, "Small%d", i);
+	if (!fileSystem->Remove(name))
+	    printf("Perf test: unable to remove %s\n", name);
+    }
+    PerfEnd();
+}
+
+//----------------------------------------------------------------------
+// AppendTest
+// 	Grow two files, in turn, AppendSize bytes at a time, opening and
+//	closing them for each append (like two logs), until each holds
+//	half a large file; then read both back.
+//----------------------------------------------------------------------
+
+static void
+AppendTest()
+{
+    char what[80], buffer[AppendSize];
+    char *names[2] = { (char *)"AppendA", (char *)"AppendB" };
+    int fileSize = ((LargeFileSize / 2) / AppendSize) * AppendSize;
+    int i, f;
+
+    for (f = 0; f < 2; f++)
+	if (!fileSystem->Create(names[f], 0)) {
+	    printf("Perf test: can't create %s\n", names[f]);
+	    return;
+	}
+    sprintf(what, "Append to two %d byte files, %d bytes at a time",
+	fileSize, AppendSize);
+    PerfStart(what);
+    for (i = 0; i < fileSize; i += AppendSize)
+	for (f = 0; f < 2; f++) {
+	    OpenFile *openFile = fileSystem->Open(names[f]);
+
+	    ASSERT(openFile != NULL);
+	    FillPattern(buffer, AppendSize, i);
+	    openFile->Seek(openFile->Length());
+	    if (openFile->Write(buffer, AppendSize) < AppendSize)
+		printf("Perf test: unable to append to %s\n", names[f]);
+	    delete openFile;
+	}
+    PerfEnd();
+
+    sprintf(what, "Sequential read of the two files, in %d byte chunks",
+	AppendSize);
+    PerfStart(what);
+    for (f = 0; f < 2; f++)
+	FileRead(names[f], fileSize, AppendSize);
+    PerfEnd();
+    for (f = 0; f < 2; f++)
+	if (!fileSystem->Remove(names[f]))
+	    printf("Perf test: unable to remove %s\n", names[f]);
 }
 
 void
@@ -354,12 +607,12 @@ PerformanceTest()
 {
     printf("Starting file system performance test:\n");
     stats->Print();
-    FileWrite();
-    FileRead();
-    if (!fileSystem->Remove(FileName)) {
-      printf("Perf test: unable to remove %s\n", FileName);
-      return;
-    }
+    SequentialTest(ContentSize);
+    SequentialTest(SectorSize);
+    SequentialTest(LargeChunkSize);
+    RandomReadTest();
+    CreateRemoveTest();
+    SmallFilesTest();
+    AppendTest();
     stats->Print();
 }
-
@@ -11,7 +11,7 @@
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+//		-p <nachos file> -r <nachos file> -l -D -t -frag -defrag
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
 //              -z
@@ -33,6 +33,8 @@
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
+//    -frag prints how scattered each file, and the free space, is
+//    -defrag moves each file that is in pieces to one run of sectors
 //
 //  NETWORK
 //    -n sets the network reliability
@@ -147,6 +149,11 @@ main(int argc, char **argv)
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-frag")) {	// fragmentation report
+            fileSystem->FragmentationReport();
+	} else if (!strcmp(*argv, "-defrag")) {	// defragment, and report
+            printf("Moved %d files\n", fileSystem->Defragment());
+            fileSystem->FragmentationReport();
 	}
 #endif // FILESYS
 #ifdef NETWORK
@@ -160,6 +167,9 @@ main(int argc, char **argv)
         }
 #endif // NETWORK
     }
+#ifdef FILESYS
+    fileSystem->Sync();		// write back the bitmap and directory
+#endif // FILESYS
 
     currentThread->Finish();	// NOTE: if the procedure "main" 
 				// returns, then the program "nachos"
@@ -5,7 +5,14 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open -- one copy of it, however many
+//	times the file is opened, in the open-file table (see SharedFile).
+//	It is written back when the last OpenFile of the file is closed,
+//	if it changed.
+//	Each operation on the file holds the file's lock, so threads take
+//	turns with a file, but not with the file system: threads using
+//	different files run at the same time, their disk requests queued
+//	up together.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -14,32 +21,137 @@
 #include "copyright.h"
 #include "filehdr.h"
 #include "openfile.h"
+#include "synch.h"
 #include "system.h"
 
+// The open-file table: a SharedFile for each file that is open.
+static SharedFile *openFiles = NULL;
+static Lock *tableLock = NULL;		// Held while it is looked at or
+					// changed; never while waiting for
+					// a file's lock or the file system
+
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless the file is open
+//	already: then we share the header (and the rest of the SharedFile)
+//	with the OpenFiles it has.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    if (tableLock == NULL)
+	tableLock = new Lock("open-file table");
+    tableLock->Acquire();
+    for (file = openFiles; file != NULL; file = file->next)
+	if (file->sector == sector)
+	    break;
+    if (file == NULL) {			// not open yet
+	file = new SharedFile;
+	file->sector = sector;
+	file->hdr = new FileHeader;
+	file->hdr->FetchFrom(sector);
+	file->lock = new Lock("file");
+	file->refs = 0;
+	file->appendLength = 0;
+	file->headerDirty = FALSE;
+	file->removed = FALSE;
+	file->next = openFiles;
+	openFiles = file;
+    }
+    file->refs++;
+    tableLock->Release();
+    hdr = file->hdr;
     seekPosition = 0;
+    sequentialEnd = 0;
+    readAheadWindow = 0;
+    readAheadSector = 0;
     this->sector = sector;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	The last OpenFile of a file takes it out of the open-file table;
+//	appended bytes still in the append buffer are written first, and
+//	then the header, if it changed.
+//
+//	That is done without the table locked (the file system may be
+//	waiting for it, to open a directory, while we wait to write the
+//	header), so we check again afterwards: the file may have been
+//	opened again meanwhile.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    SharedFile **ptr;
+
+    for (;;) {
+	tableLock->Acquire();
+	if ((file->refs > 1)
+		|| ((file->appendLength == 0) && !file->headerDirty))
+	    break;
+	tableLock->Release();
+	WriteBack();
+    }
+    if (--file->refs == 0) {
+	for (ptr = &openFiles; *ptr != file; ptr = &(*ptr)->next)
+	    ;
+	*ptr = file->next;
+	delete file->lock;
+	delete file->hdr;
+	delete file;
+    }
+    tableLock->Release();
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Removed
+// 	The file whose header the directory gave as "sector" has been
+//	removed.  If it is open, it is no longer found in the open-file
+//	table (a new file may get the sector), and its header is not
+//	written back when it is closed.
+//----------------------------------------------------------------------
+
+void
+OpenFile::Removed(int sector)
+{
+    SharedFile *file;
+
+    if (tableLock == NULL)
+	return;				// nothing was ever opened
+    tableLock->Acquire();
+    for (file = openFiles; file != NULL; file = file->next)
+	if (file->sector == sector) {
+	    file->sector = -1;
+	    file->removed = TRUE;
+	}
+    tableLock->Release();
+}
+
+//----------------------------------------------------------------------
+// OpenFile::IsOpen
+// 	Return TRUE if the file whose header is at "sector" is open, so
+//	that its header is in memory, and may be written back over what
+//	is on disk.
+//----------------------------------------------------------------------
+
+bool
+OpenFile::IsOpen(int sector)
+{
+    SharedFile *file;
+    bool open = FALSE;
+
+    if (tableLock == NULL)
+	return FALSE;			// nothing was ever opened
+    tableLock->Acquire();
+    for (file = openFiles; file != NULL; file = file->next)
+	if (file->sector == sector)
+	    open = TRUE;
+    tableLock->Release();
+    return open;
 }
 
 //----------------------------------------------------------------------
@@ -96,13 +208,27 @@ OpenFile::Write(char *into, int numBytes)
 //	sector at a time.  Thus:
 //
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   We read the full sectors that are part of the request straight
+//	   into the caller's buffer (each run of them that is consecutive
+//	   on disk is a single disk request).  A partial sector (only the first and
+//	   last can be) is read into the OpenFile's sector buffer, and we
+//	   only copy the part we are interested in.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   Full sectors are written straight from the caller's buffer, in
+//	   runs, as for ReadAt.  For
+//	   a sector that will be partially written, we must first read it
+//	   into the sector buffer, so that we don't overwrite the unmodified
+//	   portion; we then copy in the data that will be modified, and
+//	   write it back.
+//
+//	   Bytes written past the end of the file are appended: they only
+//	   go into the append buffer, and get sectors later, many at once
+//	   (see Append).  A write that leaves a hole, though, allocates
+//	   the sectors for it right away, as it doesn't happen often.
+//
+//	So there is no allocation per call.  The file's lock is held
+//	throughout, so other threads wait to use the file (but not other
+//	files).
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -114,12 +240,18 @@ OpenFile::Write(char *into, int numBytes)
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
-
-    if ((numBytes <= 0) || (position >= fileLength))
+    int fileLength;
+    int i, firstSector, lastSector;
+    int start, end, diskSector, run;
+
+    file->lock->Acquire();
+    if ((file->appendLength > 0) && (position + numBytes > hdr->FileLength()))
+	FlushAppends();			// it reads bytes not written yet
+    fileLength = hdr->FileLength();
+    if ((numBytes <= 0) || (position >= fileLength)) {
+	file->lock->Release();
     	return 0; 				// check request
+    }
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
@@ -127,17 +259,23 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    for (i = firstSector; i <= lastSector; i++) {
+	start = max(position, i * SectorSize);
+	end = min(position + numBytes, (i + 1) * SectorSize);
+	diskSector = hdr->ByteToSector(i * SectorSize);
+	if (end - start == SectorSize) {	// a run of full sectors
+	    run = FullRun(i, position + numBytes, diskSector);
+	    synchDisk->ReadSectors(diskSector, run, &into[start - position]);
+	    i += run - 1;
+	} else {					// copy the part we want
+	    synchDisk->ReadSector(diskSector, sectorBuf);
+	    bcopy(&sectorBuf[start - i * SectorSize], &into[start - position],
+		  end - start);
+	}
+    }
+    ReadAhead(position, numBytes);
+    file->lock->Release();
     return numBytes;
 }
 
@@ -189,58 +327,223 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 int
 OpenFile::WriteAt(char* from, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char* buf;
-    //    printf("seekPosition is %d,fileLength is %d\n",seekPosition,fileLength);
-    if (numBytes < 0)  
+    int length;
+    int inside;
+
+    if (numBytes <= 0)
         return 0;				// check request
-    if (seekPosition >= fileLength)	//ļָ볬ļС
-    {
-        numSectors = divRoundUp(fileLength, SectorSize);	//ǰ
-        int numPosition = seekPosition + numBytes;	//޸ĺָ
-        if (numPosition > numSectors * SectorSize)	//ָλóռ
-        {
-            AllocateSpace(numPosition - numSectors * SectorSize);//¿ռ
-            fileLength += numBytes;	
-        }
-        hdr->SetLength(numPosition);	//޸ļС
+    file->lock->Acquire();
+    length = hdr->FileLength() + file->appendLength;
+    DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n",
+        numBytes, position, length);
+    if (position > length) {		// leaves a hole: allocate it all
+	FlushAppends();			// now, as before
+	numBytes = Extend(from, numBytes, position);
+	file->lock->Release();
+	return numBytes;
     }
 
-    if (fileLength == 0) return 0;
-    DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n",
-        numBytes, position, fileLength);
+    inside = min(numBytes, length - position);	// what is in the file
+    if (inside > 0) {				// already
+	if (position + inside > hdr->FileLength())
+	    FlushAppends();		// it changes buffered bytes
+	WriteInPlace(from, inside, position);
+    }
+    if (numBytes > inside)
+	Append(&from[inside], numBytes - inside);
+    file->lock->Release();
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WriteInPlace
+// 	Write "numBytes" at "position", all of which lie in sectors the
+//	file already has (see WriteAt).
+//----------------------------------------------------------------------
+
+void
+OpenFile::WriteInPlace(char *from, int numBytes, int position)
+{
+    int i, firstSector, lastSector;
+    int start, end, diskSector, run;
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-    //    printf("firstSector is %d,lastSector is %d\n",firstSector,lastSector);
-    buf = new char[numSectors * SectorSize];
 
-    firstAligned = (bool)(position == (firstSector * SectorSize));
-    lastAligned = (bool)((position + numBytes) == ((lastSector + 1) * SectorSize));
+    for (i = firstSector; i <= lastSector; i++) {
+	start = max(position, i * SectorSize);
+	end = min(position + numBytes, (i + 1) * SectorSize);
+	diskSector = hdr->ByteToSector(i * SectorSize);
+	if (end - start == SectorSize) {	// a run of full sectors
+	    run = FullRun(i, position + numBytes, diskSector);
+	    synchDisk->WriteSectors(diskSector, run, &from[start - position]);
+	    i += run - 1;
+	} else {					// read, modify, write
+	    synchDisk->ReadSector(diskSector, sectorBuf);
+	    bcopy(&from[start - position], &sectorBuf[start - i * SectorSize],
+		  end - start);
+	    synchDisk->WriteSector(diskSector, sectorBuf);
+	}
+    }
+}
 
-    // read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize],
-            SectorSize, lastSector * SectorSize);
+//----------------------------------------------------------------------
+// OpenFile::Append
+// 	Add "numBytes" to the end of the file.  What fits in the sectors
+//	the file already has (the rest of its last sector, or sectors that
+//	were preallocated) is written there; the rest goes into the
+//	append buffer, which stands for the sectors just past the end of
+//	the file.  No sectors are allocated for it until it is full, or
+//	the file is written back or closed (see FlushAppends), so a lot
+//	of small writes cost one allocation (one trip to the free map)
+//	per AppendBufferSectors sectors, instead of one per sector.
+//
+//	While there are bytes in the buffer, the header's length is a
+//	whole number of sectors, and the buffer starts there.
+//----------------------------------------------------------------------
 
-    // copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+void
+OpenFile::Append(char *from, int numBytes)
+{
+    int length = hdr->FileLength();
+    int allocated = hdr->AllocatedSectors() * SectorSize;
+    int n;
+
+    if ((file->appendLength == 0) && (length < allocated)) {
+	n = min(numBytes, allocated - length);	// fill in what we have
+	hdr->SetLength(length + n);
+	file->headerDirty = TRUE;
+	WriteInPlace(from, n, length);
+	from += n;
+	numBytes -= n;
+    }
+    while (numBytes > 0) {
+	n = min(numBytes, AppendBufferSectors * SectorSize - file->appendLength);
+	bcopy(from, &file->appendBuf[file->appendLength], n);
+	file->appendLength += n;
+	from += n;
+	numBytes -= n;
+	if (file->appendLength == AppendBufferSectors * SectorSize)
+	    FlushAppends();
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::FlushAppends
+// 	Allocate sectors for the bytes in the append buffer, all at once,
+//	and write them there.  The buffer is a whole number of sectors, so
+//	we write whole sectors, even if the last one isn't full.
+//
+//	If the disk is full, the buffered bytes are lost, as they would be
+//	with the write that added them failing; we drop them from the file.
+//----------------------------------------------------------------------
 
-    // write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize),
-            &buf[(i - firstSector) * SectorSize]);
-    delete[] buf;
+void
+OpenFile::FlushAppends()
+{
+    int length = hdr->FileLength();
+    int numBytes = file->appendLength;
+
+    if (numBytes == 0)
+	return;
+    file->appendLength = 0;
+    if (!AllocateSpace(numBytes)) {
+	DEBUG('f', "No room for %d appended bytes\n", numBytes);
+	return;
+    }
+    hdr->SetLength(length + numBytes);
+    file->headerDirty = TRUE;
+    WriteInPlace(file->appendBuf,
+		 divRoundUp(numBytes, SectorSize) * SectorSize, length);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Extend
+// 	Write "numBytes" at "position", which is past the end of the file,
+//	allocating the sectors for the hole, and for what is written, right
+//	away.  Return the number of bytes written.
+//----------------------------------------------------------------------
+
+int
+OpenFile::Extend(char *from, int numBytes, int position)
+{
+    int allocated = hdr->AllocatedSectors() * SectorSize;
+
+    if ((position + numBytes > allocated)
+	    && !AllocateSpace(position + numBytes - allocated))
+	return 0;
+    hdr->SetLength(position + numBytes);
+    file->headerDirty = TRUE;
+    WriteInPlace(from, numBytes, position);
     return numBytes;
 }
 
 
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	After reading "numBytes" at "position", guess what will be read
+//	next, and ask the disk to start reading it into the sector cache.
+//
+//	If this read starts where the last one ended, the file is being
+//	read sequentially, so we read ahead the next readAheadWindow
+//	sectors after it -- InitialReadAhead at first, doubling with each
+//	sequential read, up to MaxReadAhead.  Any other read stops the
+//	read-ahead, until the reads are sequential again.  We only ask
+//	for sectors we haven't asked for already.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int position, int numBytes)
+{
+    int fileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int next = divRoundUp(position + numBytes, SectorSize);
+    int i, to, diskSector, run;
+
+    if (position != sequentialEnd) {	// a random read
+	sequentialEnd = position + numBytes;
+	readAheadWindow = 0;
+	readAheadSector = 0;
+	return;
+    }
+    sequentialEnd = position + numBytes;
+    if (readAheadWindow == 0)
+	readAheadWindow = InitialReadAhead;
+    else
+	readAheadWindow = min(2 * readAheadWindow, MaxReadAhead);
+
+    to = min(next + readAheadWindow, fileSectors);
+    for (i = max(next, readAheadSector); i < to; i += run) {
+	diskSector = hdr->ByteToSector(i * SectorSize);
+	for (run = 1; (i + run < to) &&
+	    (hdr->ByteToSector((i + run) * SectorSize) == diskSector + run);
+								run++)
+	    ;
+	synchDisk->ReadAhead(diskSector, run);
+    }
+    readAheadSector = max(readAheadSector, to);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::FullRun
+// 	Return how many sectors of the file, starting with sector "i"
+//	(which is at "diskSector" on disk, and is wholly part of a
+//	request that ends at byte "end"), are wholly part of the request
+//	and consecutive on disk, so can be transferred all at once.
+//----------------------------------------------------------------------
+
+int
+OpenFile::FullRun(int i, int end, int diskSector)
+{
+    int run;
+
+    for (run = 1; ((i + run + 1) * SectorSize <= end) &&
+	    (hdr->ByteToSector((i + run) * SectorSize) == diskSector + run);
+								run++)
+	;
+    return run;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -249,24 +552,95 @@ OpenFile::WriteAt(char* from, int numBytes, int position)
 int
 OpenFile::Length() 
 { 
-    return hdr->FileLength(); 
+    int length;
+
+    file->lock->Acquire();
+    length = hdr->FileLength() + file->appendLength;	// the buffer is
+    file->lock->Release();				// at the end
+    return length;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::WriteBack
+// 	Write the file header back to disk, once any appended bytes have
+//	been given their sectors.
+//
+//	Nothing is written if the header hasn't changed since it was last
+//	written back, or if the file has been removed (the appended
+//	bytes are then dropped, having nowhere to go either).
+//
+//	WriteHeader does the work, for an OpenFile routine that holds the
+//	file's lock already.
+//----------------------------------------------------------------------
+
 void
 OpenFile::WriteBack()
 {
-    hdr->WriteBack(sector);
+    file->lock->Acquire();
+    WriteHeader();
+    file->lock->Release();
 }
 
 void
+OpenFile::WriteHeader()
+{
+    if (file->removed) {
+	file->appendLength = 0;
+	file->headerDirty = FALSE;
+	return;
+    }
+    FlushAppends();
+    if (!file->headerDirty)
+	return;
+    file->headerDirty = FALSE;
+    hdr->WriteBack(sector);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Preallocate
+// 	Make sure the file has sectors for its first "size" bytes, without
+//	changing its length, so that writing up to there allocates nothing
+//	(and doesn't touch the free map).  The new sectors are allocated
+//	all at once, so they are as few runs of sectors as the free map
+//	allows, and the header is written back right away, to record them.
+//
+//	Return FALSE if the disk doesn't have room for them.
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Preallocate(int size)
+{
+    int allocated;
+    bool success = TRUE;
+
+    file->lock->Acquire();
+    FlushAppends();			// they come before the new sectors
+    allocated = hdr->AllocatedSectors() * SectorSize;
+    if (size > allocated) {
+	success = AllocateSpace(size - allocated);
+	if (success)
+	    WriteHeader();
+    }
+    file->lock->Release();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::AllocateSpace
+// 	Give the file sectors for "size" more bytes, past its last sector.
+//	Return FALSE if there aren't enough free sectors.
+//----------------------------------------------------------------------
+
+bool
 OpenFile::AllocateSpace(int size)
 {
-    BitMap* freeMap;
-    freeMap = new BitMap(NumSectors);	//½һλͼ
-    OpenFile* freeMapFile;
-    freeMapFile = new OpenFile(0);	//0Ӧļ򿪴½freeMap
-    freeMap->FetchFrom(freeMapFile);	//ӴжλͼϢ
-    hdr->ExtendSpace(freeMap, size);	//ļͷʵ
-    freeMap->WriteBack(freeMapFile);	//дرͼϢ
-    delete freeMap;
-}
\ No newline at end of file
+    BitMap* freeMap = fileSystem->FreeMap();	// the file system's copy
+    bool success;
+
+    success = hdr->ExtendSpace(freeMap, size);	//ļͷʵ
+    if (success) {
+	fileSystem->FreeMapChanged();	// written back when it syncs
+	file->headerDirty = TRUE;
+    }
+    return success;
+}
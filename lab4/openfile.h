@@ -12,6 +12,8 @@
 //	In this baseline implementation of the file system, we don't 
 //	worry about concurrent accesses to the file system
 //	by different threads -- this is part of the assignment.
+//	(Each file now has a lock, shared by all the OpenFiles of it:
+//	see SharedFile.)
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,6 +24,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "disk.h"
 
 #ifdef FILESYS_STUB			// Temporarily implement calls to 
 					// Nachos file system as calls to UNIX!
@@ -60,6 +63,36 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class Lock;
+
+#define InitialReadAhead	2	// sectors read ahead, at first
+#define MaxReadAhead		16	// ... and at most
+#define AppendBufferSectors	8	// sectors appended before they are
+					// allocated
+
+// The following class defines what all the OpenFiles of one file have
+// in common: its header, the bytes appended to it that have no sectors
+// yet, and a lock, so that only one thread at a time reads or writes
+// the file (threads using different files don't wait for each other).
+// There is one for each file that is open, in the open-file table,
+// found by the sector the directory gives for the file.
+
+class SharedFile {
+  public:
+    int sector;				// Where the directory says the header
+					// is (cf. OpenFile::OpenFile)
+    FileHeader *hdr;			// The header, while the file is open
+    Lock *lock;				// Held for each operation on the file
+    int refs;				// How many OpenFiles it has
+    char appendBuf[AppendBufferSectors * SectorSize];
+					// Bytes appended to the file, that
+    int appendLength;			// have no sectors yet
+    bool headerDirty;			// Has the header changed, since it
+					// was written back?
+    bool removed;			// Has the file been removed (so the
+					// header has nowhere to go)?
+    SharedFile *next;			// The next file in the table
+};
 
 class OpenFile {
   public:
@@ -85,14 +118,47 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
-    void WriteBack();
+    void WriteBack();			// Write the header back to disk
 
-    void AllocateSpace(int size);
+    bool Preallocate(int size);		// Give the file sectors for "size"
+					// bytes, for writing into later
 
+    static void Removed(int sector);	// The file at "sector" has been
+					// removed
+    static bool IsOpen(int sector);	// Is the file at "sector" open?
 
   private:
-    FileHeader *hdr;			// Header for this file 
+    SharedFile *file;			// What it shares with other OpenFiles
+					// of the same file
+    FileHeader *hdr;			// Header for this file (file->hdr)
     int seekPosition;			// Current position within the file
+    char sectorBuf[SectorSize];		// For the partial sectors of a
+					// ReadAt or WriteAt
+    int sequentialEnd;			// Where the last read ended
+    int readAheadWindow;		// How many sectors to read ahead of
+					// a sequential read (0 after a
+					// random one)
+    int readAheadSector;		// Sectors before this one have been
+					// read ahead already
+
+    // The routines below must be called with file->lock held.
+    void ReadAhead(int position, int numBytes);
+					// Read ahead, if reads are sequential
+    void WriteInPlace(char *from, int numBytes, int position);
+					// Write bytes that have sectors
+    void Append(char *from, int numBytes);
+					// Write bytes past the end of the file
+    void FlushAppends();		// Give the appended bytes sectors, and
+					// write them
+    int Extend(char *from, int numBytes, int position);
+					// Write past the end, leaving a hole
+    int FullRun(int i, int end, int diskSector);
+					// How many sectors from "i" on
+					// can be transferred at once
+    void WriteHeader();			// WriteBack
+    bool AllocateSpace(int size);	// Add sectors for "size" more bytes
+					// to the file; FALSE if the disk is
+					// full
     int sector;                 //
 };
 
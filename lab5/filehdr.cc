@@ -26,6 +26,70 @@
 
 #include "system.h"
 #include "filehdr.h"
+#include "log.h"
+
+//----------------------------------------------------------------------
+// TheLog, NewSector, HaveRoom
+// 	Return the log, if the disk is log-structured (NULL while the file
+//	system is being set up, as the bitmap and root directory are
+//	never in the log); allocate a sector, at the head of the log if
+//	there is one; and say whether "count" more can be allocated.
+//----------------------------------------------------------------------
+
+static Log *
+TheLog()
+{
+    return (fileSystem != NULL) ? fileSystem->GetLog() : NULL;
+}
+
+static int
+NewSector(BitMap *freeMap)
+{
+    Log *log = TheLog();
+
+    return (log != NULL) ? log->Allocate(freeMap) : freeMap->Find();
+}
+
+static bool
+HaveRoom(BitMap *freeMap, int count)
+{
+    Log *log = TheLog();
+
+    if (log != NULL)
+        return log->Reserve(freeMap, count);
+    return (bool)(freeMap->NumClear() >= count);
+}
+
+//----------------------------------------------------------------------
+// FindRun
+// 	Find the first run of "want" free sectors on the disk; or if there
+//	is none that long, the longest run there is.  Return its length,
+//	and put its first sector in "start".
+//----------------------------------------------------------------------
+
+static int
+FindRun(BitMap *freeMap, int want, int *start)
+{
+    int best = 0, sector, end;
+
+    *start = -1;
+    for (sector = 0; sector < NumSectors; sector = end) {
+        if (freeMap->Test(sector)) {
+            end = sector + 1;
+            continue;
+        }
+        for (end = sector; (end < NumSectors) && !freeMap->Test(end); end++)
+            if (end - sector == want)
+                break;
+        if (end - sector > best) {
+            best = end - sector;
+            *start = sector;
+            if (best == want)
+                break;
+        }
+    }
+    return best;
+}
 
 //----------------------------------------------------------------------
 // FileHeader::Allocate
@@ -34,6 +98,13 @@
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	A file small enough to be inline gets no sectors at all.  Otherwise
+//	we try to put the file in as few extents as possible (ideally, a
+//	single run of sectors, so that reading it needs no seeks); only if
+//	that takes more than MaxExtents do we allocate it a sector at a
+//	time, in the indexed format.  On a log-structured disk, there are
+//	no extents: the sectors are allocated in the log anyway.
+//
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -41,29 +112,35 @@
 bool
 FileHeader::Allocate(BitMap *freeMap, int fileSize)
 { 
+    indexLoaded = indexDirty = FALSE;
+    ForgetIndex();
     numBytes = fileSize;  //ֽ
     numSectors  = divRoundUp(fileSize, SectorSize); //
     if (freeMap->NumClear() < numSectors)   //ʣ
         return FALSE;		// not enough space
-    else if ((NumDirect - 1) + NumDirect2 < numSectors) //numSectors>29+32һļ
+    else if (numSectors > MaxFileSectors)
         return false;
-    else if (numSectors < NumDirect) //numSectors<30ֻһ
-    {
-        for (int i = 0; i < numSectors; i++)
-        {
-            dataSectors[i] = freeMap->Find();   //ռ
-            dataSectors[NumDirect-1] = -1;//dataSectrs[29] = -1; ļֻ0-2829intֽڵ
-        }
+
+    int wanted = numSectors;
+
+    numSectors = 0;
+    if ((fileSystem != NULL) && (TheLog() == NULL)
+	    && (fileSize <= InlineSize)) {
+        bzero(InlineData(), InlineSize);
+        dataSectors[NumDirect - 1] = InlineFormat;
+        return TRUE;
     }
-    else {  //ö
-        for (int i = 0; i < NumDirect; i++)
-            dataSectors[i] = freeMap->Find(); //һǶĵַ
-        int dataSectors2[NumDirect2];
-        for (int i = 0; i < numSectors - NumDirect + 1; i++) //-һ29
-            dataSectors2[i] = freeMap->Find();
-        synchDisk->WriteSector(dataSectors[NumDirect - 1], (char*)dataSectors2);  //
+    if (TheLog() == NULL) {
+        dataSectors[NumDirect - 1] = ExtentFormat;
+        if (AddExtents(freeMap, wanted))
+            return TRUE;
+        FreeExtents(freeMap, 0);	// too fragmented
+        numSectors = 0;
     }
-    return TRUE;
+    for (int i = 0; i < NumDirect - 1; i++)
+        dataSectors[i] = -1;
+    dataSectors[NumDirect - 1] = IndexedFormat;
+    return AddIndexed(freeMap, wanted);
 }
 
 //----------------------------------------------------------------------
@@ -76,6 +153,30 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
+    if (IsInline())
+        return;				// no sectors
+    if (IsExtents()) {
+        FreeExtents(freeMap, 0);
+        return;
+    }
+    if (IsIndexed()) {
+        int n = numSectors;
+
+        for (int i = 0; (i < n) && (i < SingleIndirect); i++) {
+            ASSERT(freeMap->Test(dataSectors[i]));  // ought to be marked!
+            freeMap->Clear(dataSectors[i]);
+        }
+        if ((n -= SingleIndirect) > 0)
+            FreeTree(freeMap, dataSectors[SingleIndirect], 1,
+                     min(n, NumIndexed1));
+        if ((n -= NumIndexed1) > 0)
+            FreeTree(freeMap, dataSectors[DoubleIndirect], 2,
+                     min(n, NumIndexed2));
+        if ((n -= NumIndexed2) > 0)
+            FreeTree(freeMap, dataSectors[TripleIndirect], 3, n);
+        ForgetIndex();
+        return;
+    }
     if (numSectors < NumDirect) {   //ֻһ
         for (int i = 0; i < numSectors; i++) {
             ASSERT(freeMap->Test((int)dataSectors[i]));  // ought to be marked!
@@ -83,8 +184,7 @@ FileHeader::Deallocate(BitMap *freeMap)
         }
     }
     else {   //ö
-        int dataSectors2[NumDirect2];
-        synchDisk->ReadSector(dataSectors[NumDirect - 1], (char*)dataSectors2);
+        LoadIndex();
         //ͷһ
         for (int i = 0; i < NumDirect; i++) {
             ASSERT(freeMap->Test((int)dataSectors[i]));  // ought to be marked!
@@ -109,6 +209,8 @@ void
 FileHeader::FetchFrom(int sector)
 {
     synchDisk->ReadSector(sector, (char *)this);
+    indexLoaded = indexDirty = FALSE;
+    ForgetIndex();
 }
 
 //----------------------------------------------------------------------
@@ -116,12 +218,33 @@ FileHeader::FetchFrom(int sector)
 // 	Write the modified contents of the file header back to disk. 
 //
 //	"sector" is the disk sector to contain the file header
+//
+//	If the second-level index block was changed, it is written too.
 //----------------------------------------------------------------------
 
 void
 FileHeader::WriteBack(int sector)
 {
     synchDisk->WriteSector(sector, (char *)this); 
+    if (indexDirty) {
+        synchDisk->WriteSector(dataSectors[NumDirect - 1], (char*)dataSectors2);
+        indexDirty = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadIndex
+// 	Make sure the in-memory copy of the second-level index block is
+//	there, reading it in from disk the first time.
+//----------------------------------------------------------------------
+
+void
+FileHeader::LoadIndex()
+{
+    if (!indexLoaded) {
+        synchDisk->ReadSector(dataSectors[NumDirect - 1], (char*)dataSectors2);
+        indexLoaded = TRUE;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -138,11 +261,15 @@ int
 FileHeader::ByteToSector(int offset)
 {
     int oriSector = offset / SectorSize;
+    ASSERT(!IsInline());		// the bytes have no sector
+    if (IsExtents())
+        return ExtentSector(oriSector);
+    if (IsIndexed())
+        return IndexedSector(oriSector);
     if (oriSector < NumDirect - 1)  //Ŵһ
         return(dataSectors[oriSector]);
     else {  //Ŵڶ
-        int dataSectors2[NumDirect2];
-        synchDisk->ReadSector(dataSectors[NumDirect - 1], (char*)dataSectors2);
+        LoadIndex();
         return(dataSectors2[oriSector - NumDirect + 1]);
     }
 }
@@ -158,6 +285,19 @@ FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::Capacity
+// 	Return how many bytes the file has room for without allocating
+//	anything: InlineSize, if its bytes are inline, or else all of its
+//	sectors.
+//----------------------------------------------------------------------
+
+int
+FileHeader::Capacity()
+{
+    return IsInline() ? InlineSize : numSectors * SectorSize;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -169,6 +309,47 @@ FileHeader::Print()
 {
     int i, j, k;
     char *data = new char[SectorSize];
+    if (IsInline()) {
+        printf("FileHeader contents.  File size: %d.  Inline.\n", numBytes);
+        printf("File contents:\n");
+        for (k = 0; k < numBytes; k++) {
+            if ('\040' <= InlineData()[k] && InlineData()[k] <= '\176')
+                printf("%c", InlineData()[k]);
+            else
+                printf("\\%x", (unsigned char)InlineData()[k]);
+        }
+        printf("\n");
+        delete [] data;
+        return;
+    }
+    if (IsExtents() || IsIndexed()) {
+        if (IsExtents()) {
+            printf("FileHeader contents.  File size: %d.  File extents:\n", numBytes);
+            for (i = k = 0; k < numSectors; i++) {
+                printf("%d-%d ", dataSectors[2 * i],
+                    dataSectors[2 * i] + dataSectors[2 * i + 1] - 1);
+                k += dataSectors[2 * i + 1];
+            }
+        } else {
+            printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
+            for (i = 0; i < numSectors; i++)
+                printf("%d ", IndexedSector(i));
+        }
+        printf("\nFile contents:\n");
+        for (i = k = 0; i < numSectors; i++) {
+            synchDisk->ReadSector(IsExtents() ? ExtentSector(i)
+                                              : IndexedSector(i), data);
+            for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
+                if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
+                    printf("%c", data[j]);
+                else
+                    printf("\\%x", (unsigned char)data[j]);
+            }
+            printf("\n");
+        }
+        delete [] data;
+        return;
+    }
     //ֻһ
     if (numSectors < NumDirect) {
         printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
@@ -188,8 +369,7 @@ FileHeader::Print()
     }
     //ö
     else {
-        int dataSectors2[NumDirect2];
-        synchDisk->ReadSector(dataSectors[NumDirect - 1], (char*)dataSectors2);
+        LoadIndex();
         printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
         //ӡ
         for (i = 0; i < NumDirect - 1; i++) //һ
@@ -231,6 +411,33 @@ FileHeader::SetLength(int length)
 bool
 FileHeader::ExtendSpace(BitMap* freeMap, int appendSize)
 {
+    if (IsInline()) {			// growing out of the header
+        if (!MoveOutInline(freeMap))
+            return FALSE;
+        if (appendSize == 0)
+            return TRUE;
+    }
+    if (IsExtents() || IsIndexed()) {
+        int count = divRoundUp(appendSize, SectorSize);
+
+        if (!HaveRoom(freeMap, count)
+                || (numSectors + count > MaxFileSectors))
+            return FALSE;
+        if (IsExtents()) {
+            int oriSectors = numSectors;
+            int oriExtents[NumDirect];
+
+            bcopy((char *)dataSectors, (char *)oriExtents, sizeof(dataSectors));
+            if (AddExtents(freeMap, count))
+                return TRUE;
+            FreeExtents(freeMap, oriSectors);	// too fragmented: undo,
+            numSectors = oriSectors;		// and switch formats
+            bcopy((char *)oriExtents, (char *)dataSectors, sizeof(dataSectors));
+            if (!ExtentsToIndexed(freeMap))
+                return FALSE;
+        }
+        return AddIndexed(freeMap, count);
+    }
     int oriSectors = numSectors; //ԭ
     numSectors = divRoundUp(appendSize, SectorSize) + oriSectors;	//
     //ʣ
@@ -248,10 +455,9 @@ FileHeader::ExtendSpace(BitMap* freeMap, int appendSize)
     else {
         //ֻһ
         if (numSectors < NumDirect) {
-            for (int i = oriSectors; i < numSectors; i++) {
+            for (int i = oriSectors; i < numSectors; i++)
                 dataSectors[i] = freeMap->Find();
-                return true;
-            }
+            return true;
         }
         //ö
         else {
@@ -261,20 +467,508 @@ FileHeader::ExtendSpace(BitMap* freeMap, int appendSize)
                 {
                     dataSectors[i] = freeMap->Find();
                 }
-                int dataSectors2[NumDirect2];
                 for (int i = 0; i < numSectors - NumDirect + 1; i++)
                     dataSectors2[i] = freeMap->Find();
-                synchDisk->WriteSector(dataSectors[NumDirect - 1], (char*)dataSectors2);  //
+                indexLoaded = indexDirty = TRUE;	// written out by WriteBack
             }
             //ö
             else {
-                int dataSectors2[NumDirect2];
-                synchDisk->ReadSector(dataSectors[NumDirect - 1], (char*)dataSectors2);
+                LoadIndex();
                 for (int i = oriSectors - NumDirect + 1; i < numSectors - NumDirect + 1; i++)
                     dataSectors2[i] = freeMap->Find();      //еļдԼչ
-                synchDisk->WriteSector(dataSectors[NumDirect - 1], (char*)dataSectors2);  //
+                indexDirty = TRUE;	// written out by WriteBack
             }
             return true;
         }
     }
 }
+
+//----------------------------------------------------------------------
+// FileHeader::MoveOutInline
+// 	The file is growing past what fits in the header: give the bytes
+//	held inline a sector of their own (none, if there are none), and
+//	switch to the extent format.  Return FALSE, leaving the file as it
+//	was, if the disk is full.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::MoveOutInline(BitMap *freeMap)
+{
+    char data[SectorSize];
+    int wanted = divRoundUp(numBytes, SectorSize);
+
+    ASSERT(IsInline() && (wanted <= 1));
+    if (!HaveRoom(freeMap, wanted))
+        return FALSE;
+    bzero(data, SectorSize);
+    bcopy(InlineData(), data, numBytes);
+    bzero(InlineData(), InlineSize);
+    numSectors = 0;
+    dataSectors[NumDirect - 1] = ExtentFormat;
+    ASSERT(AddExtents(freeMap, wanted));	// one sector is always a run
+    if (wanted > 0)
+        synchDisk->WriteSector(ExtentSector(0), data);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ExtentSector
+// 	Return the sector holding data block "i" of a file made of
+//	extents.
+//----------------------------------------------------------------------
+
+int
+FileHeader::ExtentSector(int i)
+{
+    for (int e = 0; ; e++) {
+        ASSERT(e < MaxExtents);
+        if (i < dataSectors[2 * e + 1])
+            return dataSectors[2 * e] + i;
+        i -= dataSectors[2 * e + 1];
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddExtents
+// 	Allocate "count" more sectors at the end of a file made of
+//	extents.  We first grow the last extent, as far as the sectors
+//	right after it are free, then add new extents, each the first free
+//	run long enough for the rest (or else the longest free run).
+//
+//	Return FALSE if that would take more than MaxExtents extents; the
+//	sectors allocated so far are then still in the header (numSectors
+//	counts them), for the caller to free.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AddExtents(BitMap *freeMap, int count)
+{
+    int n, covered, start, length;
+
+    for (n = covered = 0; covered < numSectors; n++)
+        covered += dataSectors[2 * n + 1];
+    if (n > 0) {
+        int *last = &dataSectors[2 * (n - 1)];
+        int end = last[0] + last[1];
+
+        while ((count > 0) && (end < NumSectors) && !freeMap->Test(end)) {
+            freeMap->Mark(end++);
+            last[1]++;
+            numSectors++;
+            count--;
+        }
+    }
+    while (count > 0) {
+        if (n == MaxExtents)
+            return FALSE;
+        length = FindRun(freeMap, count, &start);
+        if (length == 0)
+            return FALSE;
+        for (int i = 0; i < length; i++)
+            freeMap->Mark(start + i);
+        dataSectors[2 * n] = start;
+        dataSectors[2 * n + 1] = length;
+        n++;
+        numSectors += length;
+        count -= length;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeExtents
+// 	Give back the sectors of a file made of extents, from data block
+//	"from" to the end.  The header itself is left for the caller to
+//	fix up.
+//----------------------------------------------------------------------
+
+void
+FileHeader::FreeExtents(BitMap *freeMap, int from)
+{
+    for (int i = from; i < numSectors; i++) {
+        int sector = ExtentSector(i);
+
+        ASSERT(freeMap->Test(sector));	// ought to be marked!
+        freeMap->Clear(sector);
+    }
+}
+
+//----------------------------------------------------------------------
+// IndexBlocks
+// 	Return how many index blocks a file of "n" data blocks needs, in
+//	the indexed format.
+//----------------------------------------------------------------------
+
+static int
+IndexBlocks(int n)
+{
+    int blocks = 0;
+
+    if ((n -= SingleIndirect) > 0)	// the single indirect block
+        blocks++;
+    if ((n -= NumIndexed1) > 0)		// the doubly indirect one, and
+        blocks += 1 + divRoundUp(min(n, NumIndexed2), NumIndexed1);
+    if ((n -= NumIndexed2) > 0)		// the triply indirect one, ...
+        blocks += 1 + divRoundUp(n, NumIndexed2) + divRoundUp(n, NumIndexed1);
+    return blocks;
+}
+
+// The number of data blocks under each entry of an index block, by the
+// level of the block (1 is just above the data).
+
+static const int EntrySpan[4] = { 0, 1, NumIndexed1, NumIndexed2 };
+
+//----------------------------------------------------------------------
+// FileHeader::ForgetIndex
+// 	Forget the index blocks kept from the last lookups (the header
+//	has been read in again, or its blocks freed).
+//----------------------------------------------------------------------
+
+void
+FileHeader::ForgetIndex()
+{
+    for (int level = 1; level <= 3; level++)
+        lastIndexSector[level - 1] = -1;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::GetIndex
+// 	Return the index block in "sector", which is "level" levels above
+//	the data blocks.  It is kept in lastIndex[level - 1], so if it was
+//	the last block used at that level, there is nothing to read.
+//----------------------------------------------------------------------
+
+int *
+FileHeader::GetIndex(int sector, int level)
+{
+    ASSERT(sector >= 0);
+    if (lastIndexSector[level - 1] != sector) {
+        synchDisk->ReadSector(sector, (char *)lastIndex[level - 1]);
+        lastIndexSector[level - 1] = sector;
+    }
+    return lastIndex[level - 1];
+}
+
+//----------------------------------------------------------------------
+// FileHeader::NewIndex
+// 	Allocate a new index block, "level" levels above the data, with no
+//	entries yet, and return its sector.  It is left in lastIndex, for
+//	the caller to fill in and PutIndex.
+//----------------------------------------------------------------------
+
+int
+FileHeader::NewIndex(BitMap *freeMap, int level)
+{
+    int sector = NewSector(freeMap);
+
+    ASSERT(sector >= 0);
+    for (int i = 0; i < NumDirect2; i++)
+        lastIndex[level - 1][i] = -1;
+    lastIndexSector[level - 1] = sector;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::PutIndex
+// 	Write the index block kept at "level" back to the disk.
+//----------------------------------------------------------------------
+
+void
+FileHeader::PutIndex(int level)
+{
+    synchDisk->WriteSector(lastIndexSector[level - 1],
+                           (char *)lastIndex[level - 1]);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IndexedSector
+// 	Return the sector holding data block "i", with the indexed format.
+//----------------------------------------------------------------------
+
+int
+FileHeader::IndexedSector(int i)
+{
+    if (i < SingleIndirect)
+        return dataSectors[i];
+    if ((i -= SingleIndirect) < NumIndexed1)
+        return ReadEntry(dataSectors[SingleIndirect], 1, i);
+    if ((i -= NumIndexed1) < NumIndexed2)
+        return ReadEntry(dataSectors[DoubleIndirect], 2, i);
+    i -= NumIndexed2;
+    ASSERT(i < NumIndexed3);
+    return ReadEntry(dataSectors[TripleIndirect], 3, i);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ReadEntry
+// 	Return the sector of the "i"th data block below the index block
+//	in "sector", "level" levels above the data.
+//----------------------------------------------------------------------
+
+int
+FileHeader::ReadEntry(int sector, int level, int i)
+{
+    int *block = GetIndex(sector, level);
+
+    if (level == 1)
+        return block[i];
+    return ReadEntry(block[i / EntrySpan[level]], level - 1,
+                     i % EntrySpan[level]);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetIndexedSector
+// 	Make "sector" data block "i", with the indexed format.
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetIndexedSector(BitMap *freeMap, int i, int sector)
+{
+    if (i < SingleIndirect)
+        dataSectors[i] = sector;
+    else if ((i -= SingleIndirect) < NumIndexed1)
+        WriteEntry(freeMap, &dataSectors[SingleIndirect], 1, i, sector);
+    else if ((i -= NumIndexed1) < NumIndexed2)
+        WriteEntry(freeMap, &dataSectors[DoubleIndirect], 2, i, sector);
+    else {
+        i -= NumIndexed2;
+        ASSERT(i < NumIndexed3);
+        WriteEntry(freeMap, &dataSectors[TripleIndirect], 3, i, sector);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::WriteEntry
+// 	Make "sector" the "i"th data block below the index block in
+//	"*sectorPtr", "level" levels above the data.  If there is no such
+//	index block yet (*sectorPtr is -1), allocate it.
+//
+//	Each index block changed is written back right away (to the
+//	sector cache); the header itself is left for WriteBack.  On a
+//	log-structured disk, it is written to the head of the log, and
+//	the entry above it changed to match.
+//----------------------------------------------------------------------
+
+void
+FileHeader::WriteEntry(BitMap *freeMap, int *sectorPtr, int level, int i,
+                       int sector)
+{
+    Log *log = TheLog();
+    int *block;
+
+    if (*sectorPtr == -1) {
+        *sectorPtr = NewIndex(freeMap, level);
+        block = lastIndex[level - 1];
+    } else {
+        block = GetIndex(*sectorPtr, level);
+        if (log != NULL) {
+            *sectorPtr = log->Rewrite(freeMap, *sectorPtr);
+            lastIndexSector[level - 1] = *sectorPtr;
+        }
+    }
+    if (level == 1)
+        block[i] = sector;
+    else				// the levels below use other slots
+        WriteEntry(freeMap, &block[i / EntrySpan[level]], level - 1,
+                   i % EntrySpan[level], sector);
+    PutIndex(level);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddIndexed
+// 	Allocate "count" more data blocks at the end of a file with the
+//	indexed format, along with the index blocks they need.  Return
+//	FALSE if there isn't room on the disk for all of that.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AddIndexed(BitMap *freeMap, int count)
+{
+    if (!HaveRoom(freeMap, count + IndexBlocks(numSectors + count)
+                                  - IndexBlocks(numSectors)))
+        return FALSE;
+    for (; count > 0; count--) {
+        int sector = NewSector(freeMap);
+
+        SetIndexedSector(freeMap, numSectors++, sector);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeTree
+// 	Free the first "count" data blocks below the index block in
+//	"sector", "level" levels above the data, and the index blocks
+//	themselves.
+//----------------------------------------------------------------------
+
+void
+FileHeader::FreeTree(BitMap *freeMap, int sector, int level, int count)
+{
+    int *block = GetIndex(sector, level);
+
+    for (int k = 0; count > 0; k++) {
+        int n = min(count, EntrySpan[level]);
+
+        if (level == 1) {
+            ASSERT(freeMap->Test(block[k]));	// ought to be marked!
+            freeMap->Clear(block[k]);
+        } else
+            FreeTree(freeMap, block[k], level - 1, n);
+        count -= n;
+    }
+    ASSERT(freeMap->Test(sector));
+    freeMap->Clear(sector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ExtentsToIndexed
+// 	Convert a file made of extents to the indexed format, keeping its
+//	data where it is (when it can't grow in extents any more).  Return
+//	FALSE, leaving it as it was, if there isn't room on the disk for
+//	the index blocks.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::ExtentsToIndexed(BitMap *freeMap)
+{
+    FileHeader old = *this;
+    int i;
+
+    if (freeMap->NumClear() < IndexBlocks(numSectors))
+        return FALSE;
+    for (i = 0; i < NumDirect - 1; i++)
+        dataSectors[i] = -1;
+    dataSectors[NumDirect - 1] = IndexedFormat;
+    ForgetIndex();
+    for (i = 0; i < numSectors; i++)
+        SetIndexedSector(freeMap, i, old.ExtentSector(i));
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Relocate
+// 	Move data block "i" to the head of the log, as it is about to be
+//	written (unless it is there already: see Log::Rewrite).  If only
+//	part of it will be written ("copy"), the rest is copied over.
+//	Return TRUE if it moved, so that the header must be written back.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Relocate(BitMap *freeMap, int i, bool copy)
+{
+    Log *log = TheLog();
+    char data[SectorSize];
+    int sector, newSector;
+
+    if ((log == NULL) || !IsIndexed())
+        return FALSE;
+    sector = IndexedSector(i);
+    if (log->IsFresh(sector))
+        return FALSE;
+    if (copy)
+        synchDisk->ReadSector(sector, data);
+    newSector = log->Rewrite(freeMap, sector);
+    if (newSector == sector)
+        return FALSE;			// the log is full: write it in place
+    if (copy)
+        synchDisk->WriteSector(newSector, data);
+    SetIndexedSector(freeMap, i, newSector);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// MoveSector
+// 	Move the sector in "*sectorPtr" to the head of the log, if it is
+//	one of those from "first" to "last" (not included).  Return TRUE if
+//	it moved.
+//----------------------------------------------------------------------
+
+static bool
+MoveSector(BitMap *freeMap, int *sectorPtr, int first, int last)
+{
+    char data[SectorSize];
+    int sector;
+
+    if ((*sectorPtr < first) || (*sectorPtr >= last))
+        return FALSE;
+    synchDisk->ReadSector(*sectorPtr, data);
+    sector = TheLog()->Rewrite(freeMap, *sectorPtr);
+    if (sector == *sectorPtr)
+        return FALSE;			// the log is full
+    synchDisk->WriteSector(sector, data);
+    *sectorPtr = sector;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MoveSectors
+// 	Move the file's sectors that are among the "count" from "first"
+//	on -- data and index blocks -- to the head of the log, for the
+//	cleaner (see FileSystem::CleanSegments).  An index block whose
+//	entries changed is moved too.  Return TRUE if anything moved, so
+//	that the header must be written back.
+//
+//	Only files with the indexed format are in the log.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::MoveSectors(BitMap *freeMap, int first, int count)
+{
+    int n = numSectors, last = first + count;
+    bool moved = FALSE;
+
+    if ((TheLog() == NULL) || !IsIndexed())
+        return FALSE;
+    for (int i = 0; (i < n) && (i < SingleIndirect); i++)
+        if (MoveSector(freeMap, &dataSectors[i], first, last))
+            moved = TRUE;
+    if (((n -= SingleIndirect) > 0)
+            && MoveTree(freeMap, &dataSectors[SingleIndirect], 1,
+                        min(n, NumIndexed1), first, last))
+        moved = TRUE;
+    if (((n -= NumIndexed1) > 0)
+            && MoveTree(freeMap, &dataSectors[DoubleIndirect], 2,
+                        min(n, NumIndexed2), first, last))
+        moved = TRUE;
+    if (((n -= NumIndexed2) > 0)
+            && MoveTree(freeMap, &dataSectors[TripleIndirect], 3, n,
+                        first, last))
+        moved = TRUE;
+    ForgetIndex();			// the blocks kept may have moved
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MoveTree
+// 	MoveSectors, for the first "count" data blocks below the index
+//	block in "*sectorPtr", "level" levels above the data, and the
+//	index blocks themselves.  Return TRUE if "*sectorPtr" changed.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::MoveTree(BitMap *freeMap, int *sectorPtr, int level, int count,
+                     int first, int last)
+{
+    int block[NumDirect2];
+    bool changed = FALSE;
+    int sector;
+
+    synchDisk->ReadSector(*sectorPtr, (char *)block);
+    for (int k = 0; count > 0; k++) {
+        int n = min(count, EntrySpan[level]);
+
+        if ((level == 1) ? MoveSector(freeMap, &block[k], first, last)
+                : MoveTree(freeMap, &block[k], level - 1, n, first, last))
+            changed = TRUE;
+        count -= n;
+    }
+    if (!changed && ((*sectorPtr < first) || (*sectorPtr >= last)))
+        return FALSE;			// nothing to write
+    sector = TheLog()->Rewrite(freeMap, *sectorPtr);
+    synchDisk->WriteSector(sector, (char *)block);
+    if (sector == *sectorPtr)
+        return FALSE;
+    *sectorPtr = sector;
+    return TRUE;
+}
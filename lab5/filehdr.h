@@ -19,7 +19,28 @@
 
 #define NumDirect 	(int)((SectorSize - 2 * sizeof(int)) / sizeof(int)) 
 #define NumDirect2  (SectorSize/sizeof(int))
-#define MaxFileSize 	((NumDirect-1+NumDirect2) * SectorSize)
+
+#define ExtentFormat	-2	// in dataSectors[NumDirect - 1]: the header
+				// lists extents, not sectors
+#define MaxExtents	((NumDirect - 1) / 2)	// {start, length} pairs
+
+#define IndexedFormat	-3	// in dataSectors[NumDirect - 1]: the header
+				// has direct and 1-, 2- and 3-level
+				// indirect pointers
+#define SingleIndirect	(NumDirect - 4)	// where those indirect pointers
+#define DoubleIndirect	(NumDirect - 3)	// are, in dataSectors (the
+#define TripleIndirect	(NumDirect - 2)	// direct ones come first)
+#define NumIndexed1	(int)NumDirect2	// data blocks under each of them
+#define NumIndexed2	(NumIndexed1 * NumIndexed1)
+#define NumIndexed3	(NumIndexed2 * NumIndexed1)
+
+#define InlineFormat	-4	// in dataSectors[NumDirect - 1]: the file's
+				// bytes are in the header itself
+#define InlineSize	((NumDirect - 1) * (int)sizeof(int))
+				// how many bytes fit there
+
+#define MaxFileSectors	(SingleIndirect + NumIndexed1 + NumIndexed2 + NumIndexed3)
+#define MaxFileSize 	(MaxFileSectors * SectorSize)
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
@@ -35,6 +56,38 @@
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
 // reading it from disk.
+//
+// A header comes in one of two formats.  Newly allocated files are
+// made of extents (runs of consecutive sectors): dataSectors then
+// holds up to MaxExtents {start, length} pairs, and its last entry is
+// ExtentFormat.  Only when the free sectors are too fragmented for that
+// do we fall back on the indexed format, like a UNIX i-node: direct
+// pointers to the first data blocks, then one pointer each to a
+// single, a doubly and a triply indirect block, which lets a file be
+// as big as the disk.
+//
+// A file of at most InlineSize bytes has no data sectors at all: its
+// bytes are kept in the header, in place of dataSectors (whose last
+// entry is then InlineFormat), so reading it takes one sector, not
+// two.  ExtendSpace moves them out to a sector of their own, in the
+// extent format, once the file grows past that.  (Only files created
+// once the file system is up are inline, and not on a log-structured
+// disk.)
+//
+// Headers in the original format -- a table of sectors, whose last
+// entry is -1 or the sector of a second-level index block -- as on old
+// disks, are still read as before, but never created.
+//
+// Only the first sector's worth of the object is the on-disk header.
+// Past that, the in-memory header keeps a copy of the second-level
+// index block, read in the first time it is needed and written out
+// (if it was changed) by WriteBack, so that reading through a large
+// file reads the index once rather than once per sector.
+//
+// On a log-structured disk (cf. log.h), files are always given the
+// indexed format, their sectors are allocated at the head of the log,
+// and an index block is moved there each time it is changed; Relocate
+// does the same for a data block about to be written.
 
 class FileHeader {
   public:
@@ -54,6 +107,16 @@ class FileHeader {
 
     int FileLength();			// Return the length of the file 
 					// in bytes
+    int AllocatedSectors() { return numSectors; }
+					// Return how many data sectors the
+					// file has (there may be more than
+					// its length needs, if they were
+					// preallocated)
+    int Capacity();			// How many bytes it has room for,
+					// in its sectors or inline
+    bool IsInline() { return (bool)(dataSectors[NumDirect - 1] == InlineFormat); }
+    char *InlineData() { return (char *)dataSectors; }
+					// Where the bytes are, if inline
 
     void Print();			// Print the contents of the file.
 
@@ -61,11 +124,81 @@ class FileHeader {
 
     bool ExtendSpace(BitMap* freeMap, int appendSize);
 
+    bool Relocate(BitMap *freeMap, int i, bool copy);
+					// Move data block "i" to the head of
+					// the log, before it is written
+    bool MoveSectors(BitMap *freeMap, int first, int count);
+					// Move its sectors among these to
+					// the head of the log
+
+    bool CanShare() { return FALSE; }	// Extents and index blocks are
+    bool Share(unsigned char *shares) { return FALSE; }
+					// rewritten in place, so FileSystem::
+					// Clone copies instead
+
   private:
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
     int dataSectors[NumDirect];		// Disk sector numbers for each data 
 					// block in the file
+
+    // The rest is not on disk (FetchFrom and WriteBack only move the
+    // fields above, which fill one sector)
+    int dataSectors2[NumDirect2];	// The second-level index block,
+					// if indexLoaded
+    bool indexLoaded;			// Is dataSectors2 valid?
+    bool indexDirty;			// Must WriteBack write it out?
+
+    void LoadIndex();			// Read in dataSectors2, if needed
+
+    bool MoveOutInline(BitMap *freeMap);
+					// Give the bytes held inline a
+					// sector, in the extent format
+
+    bool IsExtents() { return (bool)(dataSectors[NumDirect - 1] == ExtentFormat); }
+    int ExtentSector(int i);		// The sector holding the "i"th data
+					// block, with extents
+    bool AddExtents(BitMap *freeMap, int count);
+					// Add "count" sectors at the end, in
+					// as few extents as possible
+    void FreeExtents(BitMap *freeMap, int from);
+					// Free the sectors from "from" on
+
+    // With the indexed format, the last index block used at each level
+    // is kept, so that reading through a file doesn't read its index
+    // blocks over and over.
+    int lastIndexSector[3];		// The sector of each, -1 if none
+    int lastIndex[3][NumDirect2];	// and its contents
+
+    bool IsIndexed() { return (bool)(dataSectors[NumDirect - 1] == IndexedFormat); }
+    void ForgetIndex();			// Invalidate the index blocks kept
+    int *GetIndex(int sector, int level);
+					// Return the index block at "sector",
+					// "level" levels above the data,
+					// reading it into lastIndex if needed
+    int NewIndex(BitMap *freeMap, int level);
+					// Allocate a new one (all -1)
+    void PutIndex(int level);		// Write lastIndex[level - 1] back
+    int IndexedSector(int i);		// The sector holding the "i"th data
+					// block, with the indexed format
+    void SetIndexedSector(BitMap *freeMap, int i, int sector);
+					// Make it "sector", allocating any
+					// index blocks needed on the way
+    int ReadEntry(int sector, int level, int i);
+    void WriteEntry(BitMap *freeMap, int *sectorPtr, int level, int i,
+		    int sector);		// The same, below an index block
+    bool AddIndexed(BitMap *freeMap, int count);
+					// Add "count" sectors at the end
+    void FreeTree(BitMap *freeMap, int sector, int level, int count);
+					// Free the first "count" data blocks
+					// under an index block, and it
+    bool ExtentsToIndexed(BitMap *freeMap);
+					// Switch from extents to the indexed
+					// format
+    bool MoveTree(BitMap *freeMap, int *sectorPtr, int level, int count,
+		  int first, int last);
+					// MoveSectors, for the first "count"
+					// data blocks below an index block
 };
 
 #endif // FILEHDR_H
@@ -19,6 +19,8 @@
 #include "system.h"
 #include "addrspace.h"
 #include "noff.h"
+#include "compressed.h"
+#include "syscall.h"
 
 //***********************************************************************
 
@@ -58,6 +60,30 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// PagedBase
+// 	If "noffH" is the header of a paged NOFF file (see noff.h) laid
+//	out in pages of our PageSize, return where virtual address 0
+//	would be in the file, so that virtual page "p" is the PageSize
+//	bytes at PagedBase + p * PageSize.  Otherwise, return -1.
+//----------------------------------------------------------------------
+
+static int
+PagedBase(NoffHeader *noffH)
+{
+    int base = noffH->code.inFileAddr - noffH->code.virtualAddr;
+
+    if ((noffH->noffMagic != NOFFPAGEDMAGIC) || (NOFFPAGESIZE != PageSize))
+	return -1;
+    if (noffH->code.size == 0)
+	base = noffH->initData.inFileAddr - noffH->initData.virtualAddr;
+    if ((base % PageSize != 0) || ((noffH->initData.size > 0)
+	    && (noffH->initData.inFileAddr - noffH->initData.virtualAddr
+		!= base)))
+	return -1;
+    return base;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -77,7 +103,7 @@ AddrSpace::AddrSpace(OpenFile *executable)
 {
 
     bool flag = false;
-    for(int i = 0; i < NumPhysPages; i++)
+    for(int i = 0; i < MaxSpaces; i++)
     {
         if(!ProgMap[i]){
             ProgMap[i] = 1;
@@ -87,15 +113,18 @@ AddrSpace::AddrSpace(OpenFile *executable)
         }
     }
     ASSERT(flag);
+    for (int id = 0; id < MaxOpenFiles; id++)
+	openFiles[id] = NULL;		// no files open, but the console
 
     NoffHeader noffH;
     unsigned int i, size;
+    int base;
 
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
+    if (!IsNoffMagic(noffH.noffMagic) && 
+		IsNoffMagic(WordToHost(noffH.noffMagic)))
     	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    ASSERT(IsNoffMagic(noffH.noffMagic));
 
 // how big is address space?
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
@@ -104,7 +133,7 @@ AddrSpace::AddrSpace(OpenFile *executable)
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
 //******************************************
-    ASSERT(numPages <= NumPhysPages && numPages <= freeMM_map->NumClear());		// check we're not trying
+    ASSERT(numPages <= numPhysPages && numPages <= freeMM_map->NumClear());		// check we're not trying
 						// to run anything too big --
 						// at least until we have
 						// virtual memory
@@ -129,7 +158,25 @@ AddrSpace::AddrSpace(OpenFile *executable)
 // and the stack segment
     //bzero(machine->mainMemory, size);
 
-// then, copy in the code and data segments into memory
+// then, copy in the code and data segments into memory; from a paged
+// or compressed file (see noff.h), a page at a time, each into its own
+// frame
+    if (noffH.noffMagic == NOFFLZMAGIC) {
+	CompressedImage image(executable);
+
+	ASSERT(image.NumPages() <= (int) numPages);
+	for (i = 0; i < (unsigned int) image.NumPages(); i++)
+	    image.ReadPage(i,
+		&(machine->mainMemory[pageTable[i].physicalPage * PageSize]));
+    } else if ((base = PagedBase(&noffH)) >= 0) {
+	int end = max(noffH.code.virtualAddr + noffH.code.size,
+		      noffH.initData.virtualAddr + noffH.initData.size);
+
+	for (i = 0; i < (unsigned int) divRoundUp(end, PageSize); i++)
+	    executable->ReadAt(
+		&(machine->mainMemory[pageTable[i].physicalPage * PageSize]),
+		PageSize, base + i * PageSize);
+    } else {
      if (noffH.code.size > 0) {
         DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
             noffH.code.virtualAddr, noffH.code.size);
@@ -155,6 +202,7 @@ AddrSpace::AddrSpace(OpenFile *executable)
         executable->ReadAt(&(machine->mainMemory[data_phy_addr]),
             noffH.initData.size, noffH.initData.inFileAddr);
     }
+    }
 
 
     Print();
@@ -169,6 +217,8 @@ AddrSpace::AddrSpace(OpenFile *executable)
 AddrSpace::~AddrSpace()
 {
     ProgMap[spaceID] = 0;
+    for (int id = 0; id < MaxOpenFiles; id++)
+	delete openFiles[id];		// close what the program left open
     for (int i = 0; i < numPages; i++) {
          freeMM_map->Clear(pageTable[i].physicalPage);
 
@@ -177,6 +227,56 @@ AddrSpace::~AddrSpace()
 
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::AddFile
+// 	Enter an open file in our table of open files, for the Open system
+//	call.  Return its OpenFileId, or -1 if the table is full.  The
+//	ids of the console, ConsoleInput and ConsoleOutput, are never
+//	handed out.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddFile(OpenFile *file)
+{
+    for (int id = ConsoleOutput + 1; id < MaxOpenFiles; id++)
+	if (openFiles[id] == NULL) {
+	    openFiles[id] = file;
+	    return id;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GetFile
+// 	Return the file open as "id", or NULL if "id" is not open to a
+//	file (including the console's ids, which are handled apart).
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::GetFile(int id)
+{
+    if (id < 0 || id >= MaxOpenFiles)
+	return NULL;
+    return openFiles[id];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RemoveFile
+// 	Take "id" out of our table of open files, for the Close system
+//	call, and return the file it was open to (NULL if none), for the
+//	caller to close.
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::RemoveFile(int id)
+{
+    OpenFile *file = GetFile(id);
+
+    if (file != NULL)
+	openFiles[id] = NULL;
+    return file;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::InitRegisters
 // 	Set the initial values for the user-level register set.
@@ -230,7 +330,8 @@ void AddrSpace::SaveState()
 
 void AddrSpace::RestoreState() 
 {
-    printf("restore the progress with the spaceId: %d\n",spaceID);
+    DEBUG('a', "Restoring address space %d\n", spaceID);
+    machine->FlushMicroTLB();
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
 }
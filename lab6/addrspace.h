@@ -20,6 +20,8 @@
 
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxOpenFiles		16	// OpenFileIds per address space,
+					// counting the console's two
 
 
 
@@ -37,12 +39,25 @@ class AddrSpace {
     void RestoreState();		// info on a context switch 
 
     int getSpaceID(){return spaceID;}
+    bool SharesFrames() { return FALSE; }
+					// Can other spaces write any of our
+					// frames?  Never: none are shared
 
     void Print();
+
+    int AddFile(OpenFile *file);	// Give "file" an OpenFileId, -1 if
+					// too many are open
+    OpenFile *GetFile(int id);		// The file open as "id", NULL if
+					// none (or it is the console)
+    OpenFile *RemoveFile(int id);	// Take "id" out of the table, and
+					// return what it was
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     int spaceID;
+    OpenFile *openFiles[MaxOpenFiles];	// what each OpenFileId is open to;
+					// ConsoleInput and ConsoleOutput
+					// are always NULL
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
 };
@@ -23,14 +23,65 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "system.h"
+#include "trace.h"
+#include "syscall.h"
+#include "synchconsole.h"
+#include "synch.h"
 
 // String definitions for debugging messages
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "network send", "network recv",
+			"alarm"};
+
+//----------------------------------------------------------------------
+// The process table
+// 	The exit status of each process started by Exec, indexed by its
+//	SpaceId, for Join.  An entry is all that is left of a process once
+//	it has exited, and is used again by the next process to get that
+//	SpaceId; so Join only finds the most recent process Exec'ed with a
+//	given SpaceId, but the table never grows, however many programs
+//	are run.
+//----------------------------------------------------------------------
+
+class Process {
+  public:
+    bool inUse;			// has Exec started a process with this
+				// SpaceId?
+    bool hasExited;		// has it Exited yet?
+    int exitStatus;		// what it passed to Exit
+    Condition *exited;		// Broadcast when it Exits, for Join
+};
+
+static Process processes[MaxSpaces];	// by SpaceId (cf. ProgMap)
+static Lock *processLock = NULL;	// for "exited"
+
+//----------------------------------------------------------------------
+// ExecProcess
+// 	Where the thread running a program started by Exec begins: set up
+//	the registers, load the page table, and run.
+//----------------------------------------------------------------------
+
+static void
+ExecProcess(_int arg)
+{
+    currentThread->space->InitRegisters();	// set the initial register
+						// values
+    currentThread->space->RestoreState();	// load page table register
+    machine->Run();			// jump to the user progam
+    ASSERT(FALSE);			// machine->Run never returns;
+					// the address space exits
+					// by doing the syscall "exit"
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Exec
+// 	Exec(name): start running the program in the file "name" as a
+//	new process, in a thread of its own, alongside the caller, which
+//	gets its SpaceId back (or -1, if the name is bad).
+//----------------------------------------------------------------------
 
-//****************************************
 void
 Interrupt::Exec()
 {
@@ -38,48 +89,398 @@ Interrupt::Exec()
     //read argument
     char filename[50];
     int addr=machine->ReadRegister(4);
-    int i=0;
-    do{
-       machine->ReadMem(addr+i,1,(int *)&filename[i]);//read filename from mainMemory
-    }while(filename[i++]!='\0');
+    if (machine->CopyInString(addr, filename, sizeof(filename)) < 0) {
+	printf("Exec: bad file name at 0x%x\n", addr);
+	machine->WriteRegister(2, -1);
+	return;
+    }
 
     printf("Exec(%s):\n",filename); 
 
-//yunxing
     OpenFile *executable = fileSystem->Open(filename);
     AddrSpace *space;
 
     if (executable == NULL) {
 	printf("Unable to open file %s\n", filename);
+	machine->WriteRegister(2, -1);
 	return;
     }
     space = new AddrSpace(executable);
-    Thread *thread = new Thread("forked thread");
-//把当前线程送入就绪队列
-    IntStatus oldLevel = interrupt->SetLevel(IntOff);
-    scheduler->ReadyToRun(currentThread);	// ReadyToRun assumes that interrupts 
-					// are disabled!
-    (void) interrupt->SetLevel(oldLevel);  
-
-    currentThread=thread;
+    delete executable;			// close file
 
-    thread->space = space;
+    Thread *thread = new Thread("user process");
+    Process *p = &processes[space->getSpaceID()];
 
-    delete executable;			// close file
+    if (processLock == NULL)
+	processLock = new Lock("process table");
+    if (p->exited == NULL)
+	p->exited = new Condition("exited");
+    p->inUse = TRUE;
+    p->hasExited = FALSE;
+    p->exitStatus = 0;
 
-    space->InitRegisters();		// set the initial register values
-    space->RestoreState();		// load page table register
+    thread->space = space;
+    thread->Fork(ExecProcess, 0);
 
     //return spaceID
     machine->WriteRegister(2,space->getSpaceID());
+}
 
-    machine->Run();			// jump to the user progam
-    ASSERT(FALSE);			// machine->Run never returns;
-					// the address space exits
-					// by doing the syscall "exit"
+//----------------------------------------------------------------------
+// Interrupt::Exit
+// 	Exit(status): end the caller's process.  Its address space is
+//	deleted at once (giving back its frames and its SpaceId), so that
+//	all that is left of it is its exit status, in the process table;
+//	anyone waiting in Join for it is woken up, and its thread finishes.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Exit()
+{
+    AddrSpace *space = currentThread->space;
+    int id = space->getSpaceID();
+    Process *p = &processes[id];
+
+    printf("Exit(%d) from space %d\n", machine->ReadRegister(4), id);
+    if (p->inUse) {			// Exec started it
+	processLock->Acquire();
+	p->hasExited = TRUE;
+	p->exitStatus = machine->ReadRegister(4);
+	p->exited->Broadcast(processLock);
+	processLock->Release();
+    }
+    currentThread->space = NULL;
+    delete space;
+    currentThread->Finish();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Join
+// 	Join(id): wait for the process Exec returned "id" for to Exit,
+//	and return its exit status (at once, if it already has); -1 if
+//	there is no such process.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Join()
+{
+    int id = machine->ReadRegister(4);
+    Process *p;
+
+    if ((id < 0) || (id >= MaxSpaces) || !processes[id].inUse) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    p = &processes[id];
+    processLock->Acquire();
+    while (!p->hasExited)
+	p->exited->Wait(processLock);
+    processLock->Release();
+    machine->WriteRegister(2, p->exitStatus);
+}
+
+//----------------------------------------------------------------------
+// The file system calls
+// 	Create, Open, Read, Write and Close, and ReadV and WriteV, which
+//	read into or write from several buffers in one call, on the files
+//	in the caller's table of open files (see AddrSpace::AddFile), or
+//	on the console, for ConsoleInput and ConsoleOutput.  Names and
+//	data are moved to and from user memory with CopyIn and CopyOut,
+//	which translate each page once, not each byte; data goes through
+//	a kernel buffer of at most TransferSize bytes at a time.
+//
+//	Each puts its result in r2: 0 or -1 for Create and Close, an
+//	OpenFileId or -1 for Open, and the number of bytes moved, or -1,
+//	for the rest.
+//----------------------------------------------------------------------
+
+#define MaxFileNameLength	50	// including the null
+#define TransferSize		(8 * PageSize)
+
+static SynchConsole *synchConsole = NULL;
+
+//----------------------------------------------------------------------
+// TheConsole
+// 	Return the console, setting it up the first time.  It is not set
+//	up until a program uses it, since from then on it polls the
+//	keyboard, and so Nachos never runs out of things to do.
+//----------------------------------------------------------------------
+
+static SynchConsole *
+TheConsole()
+{
+    if (synchConsole == NULL)
+	synchConsole = new SynchConsole(NULL, NULL);
+    return synchConsole;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Create
+// 	Create(name): create an empty file called "name".
+//----------------------------------------------------------------------
+
+void
+Interrupt::Create()
+{
+    char name[MaxFileNameLength];
+    int addr = machine->ReadRegister(4);
+
+    if (machine->CopyInString(addr, name, sizeof(name)) < 0
+		|| !fileSystem->Create(name, 0)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    DEBUG('a', "Created file %s\n", name);
+    machine->WriteRegister(2, 0);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Open
+// 	Open(name): open the file "name", and enter it in the caller's
+//	table of open files.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Open()
+{
+    char name[MaxFileNameLength];
+    int addr = machine->ReadRegister(4);
+    OpenFile *file;
+    int id;
+
+    if (machine->CopyInString(addr, name, sizeof(name)) < 0
+		|| (file = fileSystem->Open(name)) == NULL) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    id = currentThread->space->AddFile(file);
+    if (id < 0)
+	delete file;			// too many open
+    DEBUG('a', "Opened file %s as %d\n", name, id);
+    machine->WriteRegister(2, id);
+}
+
+//----------------------------------------------------------------------
+// FetchVector
+// 	Copy in the user's array of "count" (address, size) pairs at
+//	"addr", for ReadV or WriteV, into "vec", two words per pair, and
+//	return the total size; or -1 if there are too many pairs, or the
+//	array can't be read, or a size is negative.  Read and Write are
+//	done as vectors of one pair, too.
+//----------------------------------------------------------------------
+
+static int
+FetchVector(int addr, int count, int *vec)
+{
+    int total = 0;
+
+    if (count < 0 || count > MaxIoVecs
+		|| !machine->CopyIn(addr, (char *) vec, count * 2 * sizeof(int)))
+	return -1;
+    for (int i = 0; i < 2 * count; i++)
+	vec[i] = WordToHost(vec[i]);
+    for (int i = 0; i < count; i++) {
+	if (vec[2 * i + 1] < 0)
+	    return -1;
+	total += vec[2 * i + 1];
+    }
+    return total;
+}
+
+//----------------------------------------------------------------------
+// CopyVector
+// 	Move "size" bytes between the kernel buffer "buffer" and the user
+//	buffers in "vec", starting "*offset" bytes into buffer "*seg", and
+//	move that position on past them.  CopyIn if "in", else CopyOut.
+//	Return FALSE if part of user memory could not be translated.
+//
+//	The buffers must hold at least "size" more bytes.
+//----------------------------------------------------------------------
+
+static bool
+CopyVector(int *vec, int *seg, int *offset, char *buffer, int size, bool in)
+{
+    while (size > 0) {
+	int addr = vec[2 * *seg] + *offset;
+	int chunk = min(size, vec[2 * *seg + 1] - *offset);
+
+	if (chunk == 0) {		// on to the next buffer
+	    (*seg)++;
+	    *offset = 0;
+	    continue;
+	}
+	if (in ? !machine->CopyIn(addr, buffer, chunk)
+	       : !machine->CopyOut(addr, buffer, chunk))
+	    return FALSE;
+	buffer += chunk;
+	size -= chunk;
+	*offset += chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ReadVector, WriteVector
+// 	Read "total" bytes from "file" (the console if NULL) into the user
+//	buffers in "vec", scattering them, or write them from the buffers,
+//	gathering them, a kernel buffer full at a time.  However many
+//	small buffers there are, the file is read or written once per
+//	TransferSize bytes.  Return how many bytes were moved.
+//
+//	Reading from the console stops at the end of a line; reading from
+//	a file stops at its end.
+//----------------------------------------------------------------------
+
+static int
+ReadVector(OpenFile *file, int *vec, int total)
+{
+    char *buffer = new char[min(total, TransferSize)];
+    int done = 0, seg = 0, offset = 0;
+    int chunk, numRead;
+
+    while (done < total) {
+	chunk = min(total - done, TransferSize);
+	if (file == NULL)
+	    numRead = TheConsole()->Read(buffer, chunk);
+	else
+	    numRead = file->Read(buffer, chunk);
+	if (numRead <= 0
+		|| !CopyVector(vec, &seg, &offset, buffer, numRead, FALSE))
+	    break;
+	done += numRead;
+	if (file == NULL || numRead < chunk)
+	    break;			// a line, or the end of the file
+    }
+    delete [] buffer;
+    return done;
+}
+
+static int
+WriteVector(OpenFile *file, int *vec, int total)
+{
+    char *buffer = new char[min(total, TransferSize)];
+    int done = 0, seg = 0, offset = 0;
+    int chunk;
+
+    while (done < total) {
+	chunk = min(total - done, TransferSize);
+	if (!CopyVector(vec, &seg, &offset, buffer, chunk, TRUE))
+	    break;
+	if (file == NULL)
+	    TheConsole()->Write(buffer, chunk);
+	else if (file->Write(buffer, chunk) < chunk)
+	    break;			// the disk is full
+	done += chunk;
+    }
+    delete [] buffer;
+    return done;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Read
+// 	Read(buffer, size, id): read up to "size" bytes into "buffer".
+//	From the console, that is a line (waiting for at least one
+//	character); from a file, all of them, unless it ends first.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Read()
+{
+    int vec[2];
+    int id = machine->ReadRegister(6);
+    OpenFile *file = currentThread->space->GetFile(id);
+
+    vec[0] = machine->ReadRegister(4);
+    vec[1] = machine->ReadRegister(5);
+    if (vec[1] < 0 || (file == NULL && id != ConsoleInput)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, ReadVector(file, vec, vec[1]));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Write
+// 	Write(buffer, size, id): write "size" bytes from "buffer".
+//----------------------------------------------------------------------
+
+void
+Interrupt::Write()
+{
+    int vec[2];
+    int id = machine->ReadRegister(6);
+    OpenFile *file = currentThread->space->GetFile(id);
+
+    vec[0] = machine->ReadRegister(4);
+    vec[1] = machine->ReadRegister(5);
+    if (vec[1] < 0 || (file == NULL && id != ConsoleOutput)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, WriteVector(file, vec, vec[1]));
+}
 
+//----------------------------------------------------------------------
+// Interrupt::ReadV
+// 	ReadV(vec, count, id): read into the "count" buffers described by
+//	"vec", in order, as one Read of the total size would.
+//----------------------------------------------------------------------
 
-  
+void
+Interrupt::ReadV()
+{
+    int vec[2 * MaxIoVecs];
+    int id = machine->ReadRegister(6);
+    OpenFile *file = currentThread->space->GetFile(id);
+    int total = FetchVector(machine->ReadRegister(4),
+			    machine->ReadRegister(5), vec);
+
+    if (total < 0 || (file == NULL && id != ConsoleInput)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, ReadVector(file, vec, total));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::WriteV
+// 	WriteV(vec, count, id): write the "count" buffers described by
+//	"vec", in order, as one Write of them all, pasted together, would.
+//----------------------------------------------------------------------
+
+void
+Interrupt::WriteV()
+{
+    int vec[2 * MaxIoVecs];
+    int id = machine->ReadRegister(6);
+    OpenFile *file = currentThread->space->GetFile(id);
+    int total = FetchVector(machine->ReadRegister(4),
+			    machine->ReadRegister(5), vec);
+
+    if (total < 0 || (file == NULL && id != ConsoleOutput)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, WriteVector(file, vec, total));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Close
+// 	Close(id): take "id" out of the caller's table, and close the file.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Close()
+{
+    OpenFile *file = currentThread->space->RemoveFile(
+					machine->ReadRegister(4));
+
+    if (file == NULL) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    delete file;
+    machine->WriteRegister(2, 0);
 }
 
 //******************************************
@@ -118,6 +519,7 @@ Interrupt::Interrupt()
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    numIdleTasks = nextIdleTask = 0;
 }
 
 //----------------------------------------------------------------------
@@ -223,6 +625,7 @@ Interrupt::OneTick()
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
 					// interrupts disabled)
+    CheckWatchedFiles();		// see if there is any host input
     while (CheckIfDue(FALSE))		// check for pending interrupts
 	;
     ChangeLevel(IntOff, IntOn);		// re-enable interrupts
@@ -261,14 +664,20 @@ Interrupt::YieldOnReturn()
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
 //
+//	First, though, the idle tasks get the time until then (see
+//	RunIdleTasks).
+//
 //	If there are no pending interrupts, stop.  There's nothing
-//	more for us to do.
+//	more for us to do -- unless the console or the network is
+//	waiting for input, in which case we wait for it (see sysdep.cc).
 //----------------------------------------------------------------------
 void
 Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+    (void) WaitForWatchedFiles(FALSE);	// give input a moment to arrive
+    RunIdleTasks();			// and the kernel, background work
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
@@ -279,10 +688,16 @@ Interrupt::Idle()
 					// a runnable thread
     }
 
+    // if there are no pending interrupts, wait for input from outside
+    if (WaitForWatchedFiles(TRUE)) {
+        status = SystemMode;
+	return;				// its interrupt is now pending
+    }
+
     // if there are no pending interrupts, and nothing is on the ready
     // queue, it is time to stop.   If the console or the network is 
-    // operating, there are *always* pending interrupts, so this code
-    // is not reached.  Instead, the halt must be invoked by the user program.
+    // operating, we always wait for input, so this code is not
+    // reached.  Instead, the halt must be invoked by the user program.
 
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
@@ -290,15 +705,85 @@ Interrupt::Idle()
     Halt();
 }
 
+//----------------------------------------------------------------------
+// Interrupt::AddIdleTask
+// 	Have func(arg) called while the machine is idle (see RunIdleTasks),
+//	to do work that needn't be done straight away -- zeroing free
+//	frames, say, or writing back dirty buffers -- so that it isn't
+//	done when a page fault or a write needs it instead.
+//
+//	Each call should do a bounded slice of the work (one frame, one
+//	buffer), and return TRUE if it did any.  It is called with
+//	interrupts off, outside any thread, so it must not wait; a thread
+//	it makes ready runs after the next interrupt.
+//----------------------------------------------------------------------
+
+void
+Interrupt::AddIdleTask(IdleFunctionPtr func, _int arg)
+{
+    ASSERT(numIdleTasks < MaxIdleTasks);
+    idleTasks[numIdleTasks] = func;
+    idleArgs[numIdleTasks] = arg;
+    numIdleTasks++;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RunIdleTasks
+// 	The machine is idle: use the time until the next interrupt, which
+//	Idle would otherwise just skip, for the idle tasks.  Call them in
+//	turn, charging IdleSliceTicks of system time for each slice of
+//	work done, for as long as another slice fits before the interrupt
+//	is due, and until none of them has anything to do.  What doesn't
+//	fit is done the next time the machine is idle.
+//
+//	If the machine is about to stop, there's no point.
+//----------------------------------------------------------------------
+
+void
+Interrupt::RunIdleTasks()
+{
+    PendingInterrupt *next;
+    int when, numQuiet = 0;
+
+    if (numIdleTasks == 0)
+	return;
+    next = (PendingInterrupt *) pending->SortedRemove(&when);
+    if (next == NULL)
+	return;				// nothing pending: about to stop
+    bool onlyTimer = (next->type == TimerInt) && pending->IsEmpty();
+    pending->SortedInsert(next, when);	// (just looking)
+    if (onlyTimer)
+	return;				// no more than the timer: ditto
+
+    while ((numQuiet < numIdleTasks)
+		&& (when - stats->totalTicks >= IdleSliceTicks)) {
+	int task = nextIdleTask;
+
+	nextIdleTask = (nextIdleTask + 1) % numIdleTasks;
+	if ((*idleTasks[task])(idleArgs[task])) {
+	    stats->totalTicks += IdleSliceTicks;
+	    stats->systemTicks += IdleSliceTicks;
+	    numQuiet = 0;
+	} else
+	    numQuiet++;
+    }
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Halt
 // 	Shut down Nachos cleanly, printing out performance statistics.
+//	If a user program asked for it, first finish writing what it
+//	wrote to the console (when the machine is idle, there are no
+//	threads left to wait for that).
 //----------------------------------------------------------------------
 void
 Interrupt::Halt()
 {
+    if ((synchConsole != NULL) && (status != IdleMode))
+	synchConsole->Flush();
     printf("Machine halting!\n\n");
     stats->Print();
+    TraceDump();
     Cleanup();     // Never returns.
 }
 
@@ -377,6 +862,8 @@ Interrupt::CheckIfDue(bool advanceClock)
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
+    TraceRecord(TraceInterrupt, intTypeNames[toOccur->type],
+		stats->totalTicks - toOccur->when, interruptTicks);
 #ifdef USER_PROGRAM
     if (machine != NULL)
     	machine->DelayedLoad(0, 0);
@@ -385,7 +872,13 @@ Interrupt::CheckIfDue(bool advanceClock)
     status = SystemMode;			// whatever we were doing,
 						// we are now going to be
 						// running in the kernel
+    int start = stats->totalTicks;
+    unsigned long long hostTime = HostNanoseconds();
+
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
+    stats->RecordInterrupt(toOccur->type, intTypeNames[toOccur->type],
+			   start - toOccur->when, stats->totalTicks - start,
+			   HostNanoseconds() - hostTime);
     status = old;				// restore the machine status
     inHandler = FALSE;
     delete toOccur;
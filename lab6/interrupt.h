@@ -48,9 +48,10 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network.  (The kernel also schedules an
+// AlarmInt, for the alarm clock; see alarm.h.)
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				NetworkSendInt, NetworkRecvInt};
+				NetworkSendInt, NetworkRecvInt, AlarmInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -69,6 +70,15 @@ class PendingInterrupt {
     IntType type;		// for debugging
 };
 
+// An idle task: something for the kernel to do, a slice at a time,
+// when the machine would otherwise be idle (see Interrupt::AddIdleTask).
+// Returns TRUE if it did some work, FALSE if it had none to do.
+
+typedef bool (*IdleFunctionPtr)(_int arg);
+
+#define MaxIdleTasks	8		// idle tasks there can be
+#define IdleSliceTicks	SystemTick	// charged for each slice of work
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -89,10 +99,22 @@ class Interrupt {
     void Idle(); 			// The ready queue is empty, roll 
 					// simulated time forward until the 
 					// next interrupt
+    void AddIdleTask(IdleFunctionPtr func, _int arg);
+					// Have func(arg) called, a slice at
+					// a time, while the machine is idle
 
     void Halt(); 			// quit and print out stats
 //***********************************************
-    void Exec();
+    void Exec();			// run a program, as a new process
+    void Exit();			// end the caller's process
+    void Join();			// wait for a process to Exit
+    void Create();			// the file system calls, on
+    void Open();			// files in the caller's table of
+    void Read();			// open files (see AddrSpace), or
+    void Write();			// the console
+    void Close();
+    void ReadV();			// Read and Write, on several
+    void WriteV();			// buffers at once
     
     void YieldOnReturn();		// cause a context switch on return 
 					// from an interrupt handler
@@ -123,10 +145,17 @@ class Interrupt {
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
 
+    IdleFunctionPtr idleTasks[MaxIdleTasks];	// the idle tasks,
+    _int idleArgs[MaxIdleTasks];	// and their arguments
+    int numIdleTasks;
+    int nextIdleTask;			// the one to call next
+
     // these functions are internal to the interrupt simulation code
 
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    void RunIdleTasks();		// Do idle work until the next
+					// interrupt is due
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
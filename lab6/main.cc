@@ -9,7 +9,7 @@
 // 	Most of this file is not needed until later assignments.
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+//		-s -mem <pages> -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -e <network orderability>
@@ -23,6 +23,8 @@
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -mem sets the size of physical memory, in pages (default
+//	DefaultPhysPages, see machine.h)
 //    -x runs a user program
 //    -c tests the console
 //
@@ -18,6 +18,7 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+Alarm *alarmClock;			// threads waiting for a time
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -31,7 +32,7 @@ SynchDisk   *synchDisk;
 Machine *machine;	// user program memory and registers
 //**********************
 BitMap *freeMM_map;
-bool ProgMap[NumPhysPages];       //to set pid
+bool ProgMap[MaxSpaces];       //to set pid
 #endif
 
 #ifdef NETWORK
@@ -63,6 +64,7 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(_int dummy)
 {
+    alarmClock->Tick();
     if (interrupt->getStatus() != IdleMode)
 	interrupt->YieldOnReturn();
 }
@@ -115,6 +117,12 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	if (!strcmp(*argv, "-mem")) {
+	    ASSERT(argc > 1);
+	    numPhysPages = atoi(*(argv + 1));	// see machine.h
+	    ASSERT(numPhysPages > 0);
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -143,6 +151,7 @@ Initialize(int argc, char **argv)
     scheduler = new Scheduler();		// initialize the ready queue
     if (randomYield)				// start the timer (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
+    alarmClock = new Alarm();
 
     threadToBeDestroyed = NULL;
 
@@ -156,11 +165,11 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, FALSE, FALSE, FALSE, 0, 0);	// this must come first
 //*******************************************************************************
-    freeMM_map = new BitMap(NumPhysPages);
+    freeMM_map = new BitMap(numPhysPages);
     
-    bzero(ProgMap,NumPhysPages);    //0
+    bzero(ProgMap,MaxSpaces);    //0
 #endif
 
 #ifdef FILESYS
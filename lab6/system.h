@@ -15,6 +15,7 @@
 #include "interrupt.h"
 #include "stats.h"
 #include "timer.h"
+#include "alarm.h"
 
 // Initialization and cleanup routines
 extern void Initialize(int argc, char **argv); 	// Initialization,
@@ -28,6 +29,7 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
+extern Alarm *alarmClock;			// the kernel's, on top of it
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -35,7 +37,8 @@ extern Machine* machine;	// user program memory and registers
 //********************************
 #include "bitmap.h"
 extern BitMap *freeMM_map;
-extern bool ProgMap[NumPhysPages];//max 32
+#define MaxSpaces	32	// address spaces there can be at once
+extern bool ProgMap[MaxSpaces];//max 32
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
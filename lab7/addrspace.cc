@@ -18,7 +18,11 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
+#include "swapcache.h"
+#include "shm.h"
+#include "pipe.h"
 #include "noff.h"
+#include "syscall.h"
 //#include<math.h>
 
 //***********************************************************************
@@ -31,31 +35,30 @@ AddrSpace::Print()
 	printf("============================================\n"); 
 	printf("  VirtPage, PhysPage, valid, dirty,  use\n"); 
 	for (int i=0; i < numPages; i++) { 
-	printf("\t%d,\t%d,\t%d,\t%d,\t%d\n", pageTable[i].virtualPage,pageTable[i].physicalPage,pageTable[i].valid,pageTable[i].dirty,pageTable[i].use); 
+	TranslationEntry *entry = pageTable->Lookup(i);
+
+	if (entry == NULL)		// no leaf: nothing mapped
+		continue;
+	printf("\t%d,\t%d,\t%d,\t%d,\t%d\n", entry->virtualPage,entry->physicalPage,entry->valid,entry->dirty,entry->use); 
 	} 
 	printf("============================================\n\n"); 
 }
 
 //----------------------------------------------------------------------
-// SwapHeader
-// 	Do little endian to big endian conversion on the bytes in the 
-//	object file header, in case the file was generated on a little
-//	endian machine, and we're now running on a big endian machine.
+// NewSpaceID
+// 	Find a free address space identifier, and mark it in use.
 //----------------------------------------------------------------------
 
-static void 
-SwapHeader (NoffHeader *noffH)
+static int
+NewSpaceID()
 {
-	noffH->noffMagic = WordToHost(noffH->noffMagic);
-	noffH->code.size = WordToHost(noffH->code.size);
-	noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
-	noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
-	noffH->initData.size = WordToHost(noffH->initData.size);
-	noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
-	noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
-	noffH->uninitData.size = WordToHost(noffH->uninitData.size);
-	noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
-	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
+    for (int i = 0; i < MaxSpaces; i++)
+        if (!ProgMap[i]) {
+            ProgMap[i] = 1;
+            return i;
+        }
+    ASSERT(FALSE);
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -64,7 +67,10 @@ SwapHeader (NoffHeader *noffH)
 //	Load the program from a file "executable", and set everything
 //	up so that we can start executing user instructions.
 //
-//	Assumes that the object code file is in NOFF format.
+//	Assumes that the object code file is in NOFF format.  The file
+//	and its header come from the program cache (see sharedtext.h), so
+//	if some other address space is running the same program we don't
+//	have to look it up in the directory or read its header again.
 //
 //	First, set up the translation from program memory to physical 
 //	memory.  For now, this is really simple (1:1), since we are
@@ -75,35 +81,33 @@ SwapHeader (NoffHeader *noffH)
 
 AddrSpace::AddrSpace(char *filename)
 {
-
-    bool flag = false;
-    for(int i = 0; i < NumPhysPages; i++)
-    {
-        if(!ProgMap[i]){
-            ProgMap[i] = 1;
-            flag = true;
-            spaceID=i;
-            break;
-        }
+    spaceID = NewSpaceID();
+    console = 0;			// the first, until we are told
+    profile = NULL;
+    for (int id = 0; id < MaxOpenFiles; id++) {
+	openFiles[id] = NULL;		// no files open, but the console
+	pipeEnds[id].pipe = NULL;
     }
-    ASSERT(flag);
-    OpenFile *executable = fileSystem->Open(filename);
+    for (int i = 0; i < MaxMappedFiles; i++)
+	mappedFiles[i].file = NULL;
+    for (int i = 0; i < MaxAttachedSegments; i++)
+	attached[i].segment = NULL;
+    numThreads = 1;
+    for (int i = 0; i < MaxUserThreads; i++)
+	stacks[i].thread = NULL;
+    text = SharedText::Attach(filename, this);
 
-    if (executable == NULL) {
+    if (text == NULL) {
 	printf("Unable to open file %s\n", filename);
 	return;
     }
-    this->filename=filename;
-   // this->executable=executable;
 	
-    NoffHeader noffH;
     unsigned int i, size;
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    executable = text->getExecutable();
+    noffH = *text->getHeader();
+    if (machine->IsProfiling())
+	profile = new Profile(filename, executable, &noffH);
 
 // how big is address space?
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
@@ -116,145 +120,1275 @@ AddrSpace::AddrSpace(char *filename)
 	
     int numFrames =max(MaxNumPhysPages,necessaryFrames+1); 
    
-    ASSERT(numFrames <= NumPhysPages && numFrames <= freeMM_map->NumClear());		// check we're not trying
+    numFrames = min(numFrames, coreMap->NumFrames());	// with -frames
+    ASSERT(numFrames <= numPhysPages);		// check we're not trying
 						// to run anything too big --
-						// at least until we have
-						// virtual memory
+						// frames that are in use are
+						// taken from other processes
+// With page-fault-frequency control (see replacePage), we don't start
+// out with a fixed number of frames: we take only what is free, and let
+// the fault rate decide how much more the program gets.
+    if (pffInterval > 0)
+	numFrames = min(min(necessaryFrames + 1, coreMap->NumFree()),
+			(int)numPages);
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n", 
 					numPages, size);
-// first, set up the translation 
-    pageTable = new TranslationEntry[numPages];
-
-	for (i=0;i<numFrames;i++){
-			 pageTable[i].virtualPage = i;
-			pageTable[i].physicalPage = freeMM_map->Find();
-			pageTable[i].valid = true;
-			pageTable[i].use = false;
-			pageTable[i].dirty = false;
-			pageTable[i].readOnly = false; 
-		
-	}
-
-	for(i;i<numPages;i++){
-		    pageTable[i].virtualPage = i;
-			pageTable[i].physicalPage = -1;
-			pageTable[i].valid = false;
-	}
-// zero out the entire address space, to zero the unitialized data segment 
-// and the stack segment
-    //bzero(machine->mainMemory, size);
+// first, set up the translation; nothing is in memory yet
+    pageTable = new PageTable(numPages, twoLevelPageTables);
+// Work out where each page comes from when it is first touched: pages
+// holding any code or initialized data are read from the executable
+// (which we keep open), and the rest -- the uninitialized data and the
+// stack -- are just zero-filled.  A page only gets a swap slot once it
+// has been written and then evicted.
+// Pages holding nothing but code are shared with every other address
+// space running the same program (see sharedtext.h).
+    pageSource = new PageSource[numPages];
+    swapSlot = new int[numPages];
+    prefetched = new bool[numPages];
+    for (i = 0; i < numPages; i++) {
+	if (text->IsShared(i) && !Overlaps(&noffH.initData, i))
+	    pageSource[i] = PageShared;
+	else if (Overlaps(&noffH.code, i) || Overlaps(&noffH.initData, i))
+	    pageSource[i] = PageFromFile;
+	else
+	    pageSource[i] = PageZeroFill;
+	swapSlot[i] = -1;
+	prefetched[i] = false;
+    }
+    heapStart = numPages;		// empty, until Sbrk
+    heapBreak = heapStart * PageSize;
+    argc = 0;
+    argv = NULL;
+    virtualTime = lastFault = 0;
+    runningSince = stats->userTicks;
 
-// then, copy in the code and data segments into memory
+// the pages we start out with are brought in later, by StartLoading,
+// in the thread that is to run the program -- not by whoever is
+// creating the address space, which need not wait for the disk
 //主存预加载
-    if (noffH.code.size > 0) {
-        DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
-            noffH.code.virtualAddr, noffH.code.size);
-
-    //code start from this page
-    int code_page = noffH.code.virtualAddr/PageSize;
-    //calculate physical address using page and offset (0);
-    int code_phy_addr = pageTable[code_page].physicalPage *PageSize;
-    //read memory
-        executable->ReadAt(&(machine->mainMemory[code_phy_addr]),
-            noffH.code.size, noffH.code.inFileAddr);
+    preloadPages = numFrames;
+    for (i = 0; i < MaxInTransit; i++)
+	inTransit[i] = -1;
+    loadLock = new Lock("page load lock");
+    pageLoaded = new Condition("page loaded");
+    loaderDone = NULL;
+    stopLoading = false;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create a copy of address space "parent", for the Fork system
+//	call, without copying any memory.  The child's page table starts
+//	out as a copy of the parent's: each resident page is mapped to
+//	the same frame in both, the frame is shared in the core map, and
+//	the page is made read-only in *both* -- so the first write to it,
+//	by either, raises a ReadOnlyException and only then is the page
+//	copied (see CopyOnWrite).  Shared code is mapped as usual.
+//
+//	A page that is not resident needs no copying either, unless it is
+//	only in the parent's swap slot: the child gets a copy of the slot.
+//	A resident page whose contents came from swap is marked dirty in
+//	the child, so that it gets written to a slot of the child's own if
+//	it is evicted.
+//
+//	The child starts with no files open, but the console (the
+//	parent's console): the parent's are its own, to read, write and
+//	close.  It does get the
+//	parent's pipe ends, though, so the two can talk.  Nor does it get
+//	the files the parent has mapped in, or the shared memory segments
+//	it has attached; their pages are holes.
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(AddrSpace *parent)
+{
+    unsigned int i;
+
+    spaceID = NewSpaceID();
+    console = parent->console;
+    for (int id = 0; id < MaxOpenFiles; id++) {
+	openFiles[id] = NULL;		// no files open, but the console
+	pipeEnds[id].pipe = NULL;
     }
-    if (noffH.initData.size > 0) {
-        DEBUG('a', "Initializing data segment, at 0x%x, size %d\n", 
-            noffH.initData.virtualAddr, noffH.initData.size);
-    //data start from this page
-    int data_page = noffH.initData.virtualAddr/PageSize;
-    //first data's offset of this page
-    int data_offset = noffH.initData.virtualAddr%PageSize;
-    //calculate physical address using page and offset ;
-    int data_phy_addr = pageTable[data_page].physicalPage *PageSize + data_offset;  
-    //read memory
-        executable->ReadAt(&(machine->mainMemory[data_phy_addr]),
-            noffH.initData.size, noffH.initData.inFileAddr);
+    InheritPipes(parent);
+    for (i = 0; i < MaxMappedFiles; i++)
+	mappedFiles[i].file = NULL;
+    for (i = 0; i < MaxAttachedSegments; i++)
+	attached[i].segment = NULL;
+    numThreads = 1;			// just the one that called Fork
+    for (i = 0; i < MaxUserThreads; i++)
+	stacks[i].thread = NULL;
+    text = SharedText::Attach(parent->text->getName(), this);
+    ASSERT(text != NULL);
+    executable = text->getExecutable();
+    noffH = parent->noffH;
+    profile = NULL;
+    if (machine->IsProfiling())
+	profile = new Profile(parent->text->getName(), executable, &noffH);
+    numPages = parent->numPages;
+    heapStart = parent->heapStart;
+    heapBreak = parent->heapBreak;
+    argc = 0;				// it is running already
+    argv = NULL;
+    necessaryFrames = parent->necessaryFrames;
+    DEBUG('a', "Forking address space %d as %d, num pages %d\n",
+	  parent->spaceID, spaceID, numPages);
+
+    pageTable = new PageTable(numPages, twoLevelPageTables);
+    pageSource = new PageSource[numPages];
+    swapSlot = new int[numPages];
+    prefetched = new bool[numPages];
+    for (i = 0; i < numPages; i++) {
+	TranslationEntry *entry = parent->pageTable->Lookup(i);
+
+	pageSource[i] = parent->pageSource[i];
+	swapSlot[i] = -1;
+	prefetched[i] = false;
+	if ((pageSource[i] == PageMapped) || (pageSource[i] == PageSegment)) {
+	    pageSource[i] = PageUnmapped;	// and left unmapped
+	    continue;
+	}
+	if ((entry != NULL) && entry->valid) {
+	    TranslationEntry *copy = pageTable->Entry(i);
+
+	    *copy = *entry;
+	    copy->use = false;
+	    if (pageSource[i] == PageShared)
+		continue;
+	    coreMap->ShareFrame(entry->physicalPage, this);
+	    entry->readOnly = copy->readOnly = true;
+	    if (pageSource[i] == PageInSwap)
+		copy->dirty = true;
+	} else if (pageSource[i] == PageInSwap) {
+	    char buffer[PageSize];
+
+	    swapSlot[i] = swapMap->Find();
+	    ASSERT(swapSlot[i] >= 0);		// out of swap space
+	    coreMap->ReadSwap(parent->swapSlot[i], buffer);
+	    swapFile->WriteAt(buffer, PageSize, swapSlot[i] * PageSize);
+	}
     }
-//printf("VVVVVAAAAA%d,%d\n",noffH.code.virtualAddr,noffH.initData.virtualAddr);
-//printf("@@@@@@@@@@%d,%d\n",noffH.code.inFileAddr,noffH.initData.inFileAddr);
-    delete executable;
+    virtualTime = lastFault = 0;
+    runningSince = stats->userTicks;
+    preloadPages = 0;			// it has all it needs
+    for (i = 0; i < MaxInTransit; i++)
+	inTransit[i] = -1;
+    loadLock = new Lock("page load lock");
+    pageLoaded = new Condition("page loaded");
+    loaderDone = NULL;
+    stopLoading = false;
     Print();
-
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space, printing what paging it did, and
+//	adding that to the totals.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+    char name[20];
+
+    if (loaderDone != NULL) {		// wait for the loader to stop,
+	stopLoading = true;		// after the page it is on
+	loaderDone->P();
+	delete loaderDone;
+    }
+    sprintf(name, "space %d", spaceID);
+    vmCounts.Print(name);
+    vmTotals->Add(&vmCounts);
     ProgMap[spaceID] = 0;
+    SetArguments(0, NULL);
+    for (int i = 0; i < MaxMappedFiles; i++)
+	if (mappedFiles[i].file != NULL)	// write back what changed
+	    Unmap(mappedFiles[i].firstPage * PageSize);
+    for (int i = 0; i < MaxAttachedSegments; i++)
+	if (attached[i].segment != NULL)
+	    DetachSegment(attached[i].firstPage * PageSize);
+    for (int id = 0; id < MaxOpenFiles; id++) {
+	delete openFiles[id];		// close what the program left open
+	ClosePipeEnd(id);
+    }
     for (int i = 0; i < numPages; i++) {
-		if(pageTable[i].valid)
-			freeMM_map->Clear(pageTable[i].physicalPage);
+		TranslationEntry *entry = pageTable->Lookup(i);
+
+		if((entry != NULL) && entry->valid){
+			if(entry->use)
+				PageUsed(i);
+			if (pageSource[i] != PageShared)	// else text's
+				coreMap->ReleaseFrame(entry->physicalPage,
+				    this);	// may be shared after a Fork
+		}
 
     }
-   delete [] pageTable;
+    for (int i = 0; i < numPages; i++)
+	if (swapSlot[i] >= 0)
+	    coreMap->FreeSwapSlot(swapSlot[i]);
+    delete [] pageSource;
+    delete [] swapSlot;
+    delete [] prefetched;
+    text->Detach(this);		// may free the shared code frames,
+				// and close the program
+   delete pageTable;
+   delete loadLock;
+   delete pageLoaded;
 
 }
 
 //*******************************************************************
 
-int
-AddrSpace::findReplacedPage()
-{
-	printf("oldpage finding\n");
-	for (int i=necessaryFrames;i< numPages;i++){
-		if(pageTable[i].valid)
-			return i;
-	}
-}
-	 
+//----------------------------------------------------------------------
+// AddrSpace::replacePage
+// 	Bring in the page that "badVAddr" lies in, after a page fault.
+//	The core map gives us a frame -- a free one, or one taken from
+//	whichever process the replacement policy chose -- and we fill it
+//	with one page-sized read of the page's swap slot.
+//
+//	Since user programs tend to walk through memory in order, we also
+//	"fault around": while there are free frames, we bring in up to
+//	faultAroundPages of the following pages that are not resident, so
+//	that the program doesn't have to fault on each of them in turn.
+//	We never evict anything to do this.
+//
+//	If page-fault-frequency control is on (pffInterval > 0), the
+//	number of frames each program holds follows its fault rate: a
+//	program that faults again within pffInterval of its own (virtual)
+//	time just gets the new frame, and so grows, while one that has
+//	gone longer than that without faulting gives up every page it
+//	hasn't used since its last fault (see Trim) -- putting them on the
+//	free list for whoever needs them, rather than waiting for the
+//	replacement policy to get round to them.
+//----------------------------------------------------------------------
+
 void 
 AddrSpace::replacePage(int badVAddr)
 {
 	int newPage=badVAddr/PageSize;
-	int oldPage=findReplacedPage();
-	printf("%d out，%d in\n",oldPage,newPage);
-	writeback(oldPage);
-	pageTable[oldPage].valid=false;
-	pageTable[newPage].physicalPage=pageTable[oldPage].physicalPage;
-	pageTable[newPage].valid=true;
-	pageTable[newPage].dirty = false;
-	pageTable[newPage].readOnly = false;
+	int start = stats->totalTicks;
+	bool major;
+
+	ASSERT((newPage >= 0) && (newPage < numPages));
+	if (pageSource[newPage] == PageUnmapped) {
+		printf("Access to unmapped address 0x%x\n", badVAddr);
+		ASSERT(FALSE);
+	}
+	if (pffInterval > 0) {
+		int now = VirtualTime();
+
+		if (now - lastFault > pffInterval)
+			Trim();
+		lastFault = now;
+	}
+	major = LoadPage(newPage);
+	for (int page = newPage + 1, n = 0; (page < numPages)
+		&& (n < faultAroundPages) && (coreMap->NumFree() > 0); page++) {
+		if (pageTable->IsValid(page) || (pageSource[page] == PageUnmapped))
+			continue;
+		LoadPage(page);
+		prefetched[page] = true;
+		stats->numPagesPrefetched++;
+		n++;
+	}
+	vmCounts.RecordFault(major, stats->totalTicks - start);
 	
+	Print();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadPage
+// 	Bring virtual page "page" into a frame from the core map (evicting
+//	some page if none is free), and map it.  Where its contents come
+//	from depends on the page:
+//		PageFromFile -- read the code and/or data it holds from the
+//			executable (whatever else is in the page is zero);
+//			from a paged or compressed executable, that is a
+//			single read of the page
+//		PageZeroFill -- never written: the frame is just zeroed,
+//			with no I/O at all, if it hasn't been already
+//			(see CoreMap::ZeroFreeFrame)
+//		PageInSwap -- one page-sized read of its swap slot
+//		PageShared -- mapped read-only to the frame shared by all
+//			users of the program, which is only read in if
+//			none of them has it resident
+//		PageMapped -- read from the part of the mapped file it holds
+//
+//	Returns TRUE if the page had to be read from disk (a major fault),
+//	FALSE if not (a minor one).
+//
+//	The page is only mapped once it is all there, so that no other
+//	thread in the address space -- the loader streaming in the first
+//	pages, say -- sees it half read; and a thread that wants a page
+//	being read in by another waits for it, rather than reading it
+//	into a second frame.
+//----------------------------------------------------------------------
 
-	//read to MM
-       
-	    OpenFile *executable = fileSystem->Open(filename);
+bool
+AddrSpace::LoadPage(int page)
+{
+	TranslationEntry *entry = pageTable->Entry(page);
+	int frame, slot, i;
+	char *memory;
+	bool zeroed, readIn = true;
+
+	loadLock->Acquire();
+	for (;;) {
+		for (i = 0; (i < MaxInTransit) && (inTransit[i] != page); i++)
+			;
+		if (i == MaxInTransit)
+			break;
+		pageLoaded->Wait(loadLock);	// someone is reading it in
+	}
+	if (pageTable->IsValid(page)) {		// ... and now it's in
+		loadLock->Release();
+		return false;
+	}
+	for (slot = 0; inTransit[slot] >= 0; slot++)
+		ASSERT(slot + 1 < MaxInTransit);
+	inTransit[slot] = page;
+	loadLock->Release();
+
+	if (pageSource[page] == PageShared) {	// no frame of our own
+		frame = text->Fault(page, &readIn);
+		DEBUG('a', "Page %d of space %d in, shared frame %d\n",
+		      page, spaceID, frame);
+		entry->physicalPage=frame;
+		entry->dirty = false;
+		entry->use = false;
+		entry->readOnly = true;
+		Loaded(page);
+		return readIn;
+	}
+	frame = coreMap->AllocFrame(this, page,
+		(pageSource[page] == PageZeroFill) ? &zeroed : NULL);
+	memory = &(machine->mainMemory[frame * PageSize]);
+	DEBUG('a', "Page %d of space %d in, frame %d\n", page, spaceID,
+	      frame);
+	entry->physicalPage=frame;
+	entry->dirty = false;
+	entry->use = false;
+	entry->readOnly = false;
+
+	switch (pageSource[page]) {
+	  case PageFromFile:
+	    if (text->ReadPage(page, memory))	// just one read
+		break;
+	    bzero(memory, PageSize);
+	    ReadSegment(&noffH.code, page, memory);
+	    ReadSegment(&noffH.initData, page, memory);
+	    break;
+	  case PageZeroFill:			// unless already done,
+	    if (!zeroed)			// while idle
+		bzero(memory, PageSize);
+	    readIn = false;
+	    break;
+	  case PageInSwap:
+	    if (coreMap->ReclaimSwap(swapSlot[page], memory)) {
+		swapSlot[page] = -1;		// still being paged out: the
+		entry->dirty = true;		// slot is the daemon's, and
+		readIn = false;			// this is the only copy
+	    } else if ((swapCache != NULL)
+		       && swapCache->Take(swapSlot[page], memory)) {
+		entry->dirty = true;		// the slot's copy, if any,
+		readIn = false;			// is out of date
+	    } else
+		swapFile->ReadAt(memory, PageSize, swapSlot[page] * PageSize);
+	    break;
+	  case PageMapped: {
+	    MappedFile *m = FindMapping(page);
+	    int offset = (page - m->firstPage) * PageSize;
+
+	    bzero(memory, PageSize);
+	    m->file->MapPage(memory, min(PageSize, m->length - offset), offset);
+	    break;
+	  }
+	  case PageShared:			// handled above
+	  case PageSegment:			// always mapped, never faults
+	  case PageUnmapped:			// see replacePage
+	    ASSERT(FALSE);
+	}
+	machine->InvalidateDecodeCache(frame * PageSize, PageSize);
+	Loaded(page);
+	coreMap->Unpin(frame);
+	return readIn;
+}
 
-	    if (executable == NULL) {
-		printf("Unable to open file %s\n", filename);
+//----------------------------------------------------------------------
+// AddrSpace::Loaded
+// 	Virtual page "page" has been read in, by LoadPage: map it, and
+//	wake up anyone waiting for it.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Loaded(int page)
+{
+	loadLock->Acquire();
+	pageTable->Entry(page)->valid = true;
+	for (int i = 0; i < MaxInTransit; i++)
+		if (inTransit[i] == page)
+			inTransit[i] = -1;
+	pageLoaded->Broadcast(loadLock);
+	loadLock->Release();
+}
+
+//----------------------------------------------------------------------
+// StreamHelper
+// 	The body of the loader thread.  Needs to be a C routine, because
+//	C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+StreamHelper(_int arg)
+{
+	((AddrSpace *) arg)->StreamPages();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::StartLoading
+// 	Called by the thread that is to run the program, before it starts
+//	it: bring in the first StartPages pages -- the entry point, and
+//	the code after it -- and fork a loader thread to stream in the
+//	rest of the pages we start out with, while the program runs.
+//	Only this thread waits for the disk; whoever created the address
+//	space (Exec, say) has long since gone on.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::StartLoading()
+{
+	int first = min(StartPages, preloadPages);
+
+	for (int page = 0; page < first; page++)
+		LoadPage(page);
+	if (first == preloadPages) {
+		Print();
 		return;
-	    }
-	    executable->ReadAt(&(machine->mainMemory[pageTable[newPage].physicalPage]),PageSize, newPage*PageSize);
-	    delete executable;
-	
+	}
+	loaderDone = new Semaphore("loader done", 0);
+	(new Thread("loader"))->Fork(StreamHelper, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::StreamPages
+// 	The loader thread: bring in the rest of the pages we start out
+//	with, one after another, skipping any the program has faulted in
+//	already.  If the address space is deleted first, stop.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::StreamPages()
+{
+	for (int page = StartPages; (page < preloadPages) && !stopLoading;
+	     page++)
+		if (!pageTable->IsValid(page)
+		    && (pageSource[page] != PageUnmapped))
+			LoadPage(page);
+	DEBUG('a', "Streamed in the first %d pages of space %d\n",
+	      preloadPages, spaceID);
 	Print();
-       //printf("\n%s\n",&(machine->mainMemory[pageTable[newPage].physicalPage]));
-	
+	loaderDone->V();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Overlaps
+// 	Return TRUE if any of segment "seg" of the executable lies in
+//	virtual page "page".
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Overlaps(Segment *seg, int page)
+{
+	return (bool)((seg->size > 0)
+		&& (seg->virtualAddr < (page + 1) * PageSize)
+		&& (seg->virtualAddr + seg->size > page * PageSize));
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReadSegment
+// 	Read the part of segment "seg" of the executable that lies in
+//	virtual page "page" into "memory", the frame holding the page.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReadSegment(Segment *seg, int page, char *memory)
+{
+	int start, end;
+
+	if (!Overlaps(seg, page))
+		return;
+	start = max(seg->virtualAddr, page * PageSize);
+	end = min(seg->virtualAddr + seg->size, (page + 1) * PageSize);
+	executable->ReadAt(memory + (start - page * PageSize), end - start,
+	    seg->inFileAddr + (start - seg->virtualAddr));
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageUsed
+// 	The use bit of virtual page "page" was found set, just before
+//	it is cleared (by the clock) or the page goes away.  If the page
+//	was brought in by fault-around, count the prefetch as a hit.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageUsed(int page)
+{
+	if (prefetched[page]) {
+		prefetched[page] = false;
+		stats->numPrefetchHits++;
+		vmCounts.prefetchHits++;
+	}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOnWrite
+// 	The user wrote to a read-only page, at "badVAddr".  If it is a
+//	page we share with a forked parent or child, it is now time to
+//	copy it: we take a frame from the core map (keeping the shared one
+//	pinned meanwhile, so that it can't be the victim), copy the page
+//	into it, and drop our hold on the shared frame.  If we turn out to
+//	be the last one using the frame, there is nothing to copy.  Either
+//	way, the page becomes writable again and the write is retried.
+//
+//	Returns FALSE if the page really is read-only (i.e., it is code).
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyOnWrite(int badVAddr)
+{
+	int page = badVAddr / PageSize;
+	TranslationEntry *entry = pageTable->Lookup(page);
+	int shared, frame;
+
+	ASSERT((entry != NULL) && entry->valid);
+	if (pageSource[page] == PageShared)
+		return FALSE;
+	shared = entry->physicalPage;
+	if (coreMap->IsShared(shared)) {
+		coreMap->Pin(shared);
+		frame = coreMap->AllocFrame(this, page);
+		bcopy(&(machine->mainMemory[shared * PageSize]),
+		    &(machine->mainMemory[frame * PageSize]), PageSize);
+		coreMap->Unpin(shared);
+		coreMap->ReleaseFrame(shared, this);
+		machine->InvalidateDecodeCache(frame * PageSize, PageSize);
+		coreMap->Unpin(frame);
+		entry->physicalPage = frame;
+		stats->numCopyOnWrite++;
+		DEBUG('a', "Copied page %d of space %d to frame %d\n", page,
+		      spaceID, frame);
+	}
+	entry->readOnly = false;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Trim
+// 	Shrink our resident set to the pages we have used since the last
+//	time (i.e., since the last page fault, for replacePage): every
+//	page of our own whose use bit is clear is written back if it is
+//	dirty, unmapped, and its frame given back to the core map.  The
+//	use bits of the pages we keep are cleared, to start the next
+//	interval.  Shared code is left to the core map.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Trim()
+{
+	for (int page = 0; page < numPages; page++) {
+		TranslationEntry *entry = pageTable->Lookup(page);
+
+		if ((entry == NULL) || !entry->valid
+		    || (pageSource[page] == PageShared)
+		    || (pageSource[page] == PageSegment))
+			continue;
+		if (entry->use) {
+			PageUsed(page);
+			entry->use = false;
+		} else {
+			int frame = entry->physicalPage;
+
+			Evict(page);
+			coreMap->ReleaseFrame(frame, this);
+			stats->numPagesTrimmed++;
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::VirtualTime
+// 	Return how many user instructions this address space has run:
+//	its own clock, which only ticks while it is running.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::VirtualTime()
+{
+	if (currentThread->space == this)
+		return virtualTime + (stats->userTicks - runningSince);
+	return virtualTime;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Evict
+// 	The core map is taking the frame holding virtual page "page"
+//	away from us (maybe for another process): write the page back
+//	to its swap slot (or to its file, if it is mapped) if it is
+//	dirty, and unmap it.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Evict(int page)
+{
+	TranslationEntry *entry = pageTable->Lookup(page);
+
+	DEBUG('a', "Page %d of space %d out\n", page, spaceID);
+	ASSERT((entry != NULL) && entry->valid);
+	if (entry->use)
+		PageUsed(page);
+	prefetched[page] = false;
+	vmCounts.evictions++;
+	writeback(page);
+	entry->valid=false;
+	entry->physicalPage=-1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageOut
+// 	Like Evict, for the page-out daemon (see CoreMap::PickPages): but
+//	rather than write a dirty page to its swap slot, copy it into
+//	"buffer", for the daemon to write, and return the slot (getting
+//	one, if it has none yet).  Return -1 if the page is clean.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::PageOut(int page, char *buffer)
+{
+	TranslationEntry *entry = pageTable->Lookup(page);
+	int slot = -1;
+
+	ASSERT((entry != NULL) && entry->valid && CanPageOut(page));
+	if (entry->use)
+		PageUsed(page);
+	prefetched[page] = false;
+	vmCounts.evictions++;
+	if (pageSource[page] == PageMapped) {	// clean (see CanPageOut)
+		MappedFile *m = FindMapping(page);
+
+		m->file->UnmapPage(&(machine->mainMemory[
+		    entry->physicalPage * PageSize]),
+		    (page - m->firstPage) * PageSize);
+	} else if (entry->dirty) {
+		vmCounts.writeBacks++;
+		if (swapSlot[page] < 0) {	// first time out: get a slot
+			swapSlot[page] = swapMap->Find();
+			ASSERT(swapSlot[page] >= 0);	// out of swap space
+		}
+		slot = swapSlot[page];
+		bcopy(&(machine->mainMemory[entry->physicalPage * PageSize]),
+		    buffer, PageSize);
+		pageSource[page] = PageInSwap;
+	}
+	entry->valid = false;
+	entry->physicalPage = -1;
+	return slot;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CanPageOut
+// 	Return TRUE unless "page" is a dirty page of a mapped file, which
+//	only writeback, writing to the file, can evict.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CanPageOut(int page)
+{
+	TranslationEntry *entry = pageTable->Lookup(page);
+
+	return (bool)!((entry != NULL) && entry->dirty
+		       && (pageSource[page] == PageMapped));
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageTableEntry
+// 	Return this address space's translation for virtual page "vpn",
+//	for the core map to check its use and dirty bits.  Returns NULL
+//	if "vpn" is beyond the end of the address space.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::PageTableEntry(int vpn)
+{
+    return pageTable->Entry(vpn);
 }
 	
 void 
 AddrSpace::writeback(int oldPage)
 {
-	if(pageTable[oldPage].dirty){
-		printf("writeback to disk，spaceId:%d,oldPage:%d\n",spaceID,oldPage);
-		OpenFile *executable = fileSystem->Open(filename);
+	TranslationEntry *entry = pageTable->Entry(oldPage);
 
-		    if (executable == NULL) {
-			printf("Unable to open file %s\n", filename);
+	if (pageSource[oldPage] == PageMapped) {
+		MappedFile *m = FindMapping(oldPage);
+		int offset = (oldPage - m->firstPage) * PageSize;
+
+		m->file->UnmapPage(&(machine->mainMemory[
+		    entry->physicalPage * PageSize]), offset);
+		if (!entry->dirty)
 			return;
-		    }
-		executable->WriteAt(&(machine->mainMemory[pageTable[oldPage].physicalPage]),PageSize,oldPage*PageSize);
-		delete executable;
+		stats->numPageWriteBacks++;
+		vmCounts.writeBacks++;
+		m->file->WriteAt(&(machine->mainMemory[
+		    entry->physicalPage * PageSize]),
+		    min(PageSize, m->length - offset), offset);
+		return;
+	}
+	if(entry->dirty){
+		if (swapSlot[oldPage] < 0) {	// first time out: get a slot
+			swapSlot[oldPage] = swapMap->Find();
+			ASSERT(swapSlot[oldPage] >= 0);	// out of swap space
+		}
+		stats->numPageWriteBacks++;
+		vmCounts.writeBacks++;
+		printf("writeback to swap，spaceId:%d,oldPage:%d\n",spaceID,oldPage);
+		if ((swapCache == NULL) || !swapCache->Put(swapSlot[oldPage],
+		    &(machine->mainMemory[entry->physicalPage * PageSize])))
+			swapFile->WriteAt(&(machine->mainMemory[entry->physicalPage * PageSize]),
+			    PageSize, swapSlot[oldPage] * PageSize);
+		pageSource[oldPage] = PageInSwap;
 	}
 }
 
 //*******************************************************************
+//----------------------------------------------------------------------
+// AddrSpace::AddFile
+// 	Enter an open file in our table of open files, for the Open system
+//	call.  Return its OpenFileId, or -1 if the table is full.  The
+//	ids of the console, ConsoleInput and ConsoleOutput, are never
+//	handed out, nor are those of pipe ends.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddFile(OpenFile *file)
+{
+    for (int id = ConsoleOutput + 1; id < MaxOpenFiles; id++)
+	if ((openFiles[id] == NULL) && (pipeEnds[id].pipe == NULL)) {
+	    openFiles[id] = file;
+	    return id;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GetFile
+// 	Return the file open as "id", or NULL if "id" is not open to a
+//	file (including the console's ids, which are handled apart).
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::GetFile(int id)
+{
+    if (id < 0 || id >= MaxOpenFiles)
+	return NULL;
+    return openFiles[id];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RemoveFile
+// 	Take "id" out of our table of open files, for the Close system
+//	call, and return the file it was open to (NULL if none), for the
+//	caller to close.
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::RemoveFile(int id)
+{
+    OpenFile *file = GetFile(id);
+
+    if (file != NULL)
+	openFiles[id] = NULL;
+    return file;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddPipeEnd
+// 	Open an end of "pipe" -- the write end if "writing", else the read
+//	end -- as an OpenFileId, for the Pipe system call.  Return the
+//	id, or -1 if the table is full.  Like files, pipe ends never get
+//	the console's ids.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddPipeEnd(PipeBuffer *pipe, bool writing)
+{
+    for (int id = ConsoleOutput + 1; id < MaxOpenFiles; id++)
+	if ((openFiles[id] == NULL) && (pipeEnds[id].pipe == NULL)) {
+	    pipe->Open(writing);
+	    pipeEnds[id].pipe = pipe;
+	    pipeEnds[id].writing = writing;
+	    return id;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GetPipe
+// 	Return the pipe "id" is the write end of, if "writing", else the
+//	read end of; or NULL if it is no such thing.
+//----------------------------------------------------------------------
+
+PipeBuffer *
+AddrSpace::GetPipe(int id, bool writing)
+{
+    if (id < 0 || id >= MaxOpenFiles || pipeEnds[id].writing != writing)
+	return NULL;
+    return pipeEnds[id].pipe;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ClosePipeEnd
+// 	Close the pipe end open as "id", for the Close system call, or
+//	as we go away.  Return FALSE if "id" is not a pipe end.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::ClosePipeEnd(int id)
+{
+    if (id < 0 || id >= MaxOpenFiles || pipeEnds[id].pipe == NULL)
+	return FALSE;
+    pipeEnds[id].pipe->Close(pipeEnds[id].writing);
+    pipeEnds[id].pipe = NULL;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::InheritPipes
+// 	Open each pipe end "parent" has open, in a new address space, as
+//	the same id: for Fork, and for Exec, so that a process can start
+//	the processes of a pipeline, connected by pipes it made.
+//
+//	Only the ids that are free in a new address space -- all of them,
+//	but the console's -- are free to inherit; and the child has no
+//	files open yet, so they are.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::InheritPipes(AddrSpace *parent)
+{
+    for (int id = 0; id < MaxOpenFiles; id++)
+	if (parent->pipeEnds[id].pipe != NULL) {
+	    ASSERT(openFiles[id] == NULL && pipeEnds[id].pipe == NULL);
+	    parent->pipeEnds[id].pipe->Open(parent->pipeEnds[id].writing);
+	    pipeEnds[id] = parent->pipeEnds[id];
+	}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Map
+// 	Map all of "file" into the address space, for the Mmap system
+//	call, and return the virtual address it starts at; or -1 if it is
+//	empty, or too many files are mapped already.  Nothing is read now:
+//	each page is read from the file when it is first touched (see
+//	LoadPage), and written back to the file if it is dirty when it
+//	is evicted or unmapped (see writeback).  The bytes of the last
+//	page past the end of the file read as zero, and are not written
+//	back; the file does not grow.
+//
+//	The pages go in the first hole big enough left by Munmap, or
+//	else past the end of the address space (above the stack).
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Map(OpenFile *file)
+{
+	int length = file->Length();
+	MappedFile *m = NULL;
+
+	for (int i = 0; i < MaxMappedFiles; i++)
+		if (mappedFiles[i].file == NULL) {
+			m = &mappedFiles[i];
+			break;
+		}
+	if ((m == NULL) || (length <= 0))
+		return -1;
+	m->numPages = divRoundUp(length, PageSize);
+	m->firstPage = FindPages(m->numPages);
+	m->length = length;
+	m->file = file;
+	for (int page = m->firstPage; page < m->firstPage + m->numPages; page++)
+		pageSource[page] = PageMapped;
+	DEBUG('a', "Mapped %d bytes at page %d of space %d\n", length,
+	      m->firstPage, spaceID);
+	return m->firstPage * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Unmap
+// 	Unmap the file mapped at "addr", for the Munmap system call (and
+//	when the address space goes away): write back its dirty pages,
+//	free their frames, and leave a hole in the address space where
+//	they were.  The file is closed, unless it is still open too, or
+//	mapped elsewhere.  Returns FALSE if no file is mapped at "addr".
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Unmap(int addr)
+{
+	MappedFile *m = NULL;
+	OpenFile *file;
+
+	for (int i = 0; i < MaxMappedFiles; i++)
+		if ((mappedFiles[i].file != NULL)
+		    && (mappedFiles[i].firstPage * PageSize == addr))
+			m = &mappedFiles[i];
+	if (m == NULL)
+		return FALSE;
+	for (int page = m->firstPage; page < m->firstPage + m->numPages; page++) {
+		if (pageTable->IsValid(page)) {
+			int frame = pageTable->Lookup(page)->physicalPage;
+
+			Evict(page);
+			coreMap->ReleaseFrame(frame, this);
+		}
+		pageSource[page] = PageUnmapped;
+	}
+	pageTable->Discard(m->firstPage, m->numPages);
+	file = m->file;
+	m->file = NULL;
+	if (!IsMapped(file)) {
+		for (int id = 0; id < MaxOpenFiles; id++)
+			if (openFiles[id] == file)
+				return TRUE;	// still open
+		delete file;
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsMapped
+// 	Return TRUE if "file" is mapped into the address space, so that
+//	closing it must wait until it is unmapped.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsMapped(OpenFile *file)
+{
+	for (int i = 0; i < MaxMappedFiles; i++)
+		if (mappedFiles[i].file == file)
+			return TRUE;
+	return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindMapping
+// 	Return the mapped file that virtual page "page" is part of.
+//----------------------------------------------------------------------
+
+MappedFile *
+AddrSpace::FindMapping(int page)
+{
+	for (int i = 0; i < MaxMappedFiles; i++) {
+		MappedFile *m = &mappedFiles[i];
+
+		if ((m->file != NULL) && (page >= m->firstPage)
+		    && (page < m->firstPage + m->numPages))
+			return m;
+	}
+	ASSERT(FALSE);
+	return NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AttachSegment
+// 	Map the shared memory segment "segment" into the address space,
+//	for ShmAttach, and return the virtual address it starts at; or -1
+//	if too many segments are attached already.  Its pages are mapped
+//	read-write to the segment's frames now, and stay mapped: they
+//	never fault, and are never evicted (see shm.h).
+//
+//	Like a mapped file, the segment goes in the first hole big enough,
+//	or else past the end of the address space.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AttachSegment(SharedSegment *segment)
+{
+	AttachedSegment *a = NULL;
+
+	for (int i = 0; i < MaxAttachedSegments; i++)
+		if (attached[i].segment == NULL) {
+			a = &attached[i];
+			break;
+		}
+	if (a == NULL)
+		return -1;
+	a->segment = segment;
+	a->firstPage = FindPages(segment->NumPages());
+	for (int i = 0; i < segment->NumPages(); i++) {
+		int page = a->firstPage + i;
+		TranslationEntry *entry = pageTable->Entry(page);
+
+		pageSource[page] = PageSegment;
+		entry->physicalPage = segment->Frame(i);
+		entry->valid = true;
+		entry->readOnly = false;
+		entry->use = false;
+		entry->dirty = false;
+	}
+	segment->Attach();
+	DEBUG('a', "Attached segment %d at page %d of space %d\n",
+	      segment->getID(), a->firstPage, spaceID);
+	return a->firstPage * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::DetachSegment
+// 	Unmap the shared memory segment attached at "addr", for ShmDetach
+//	(and when the address space goes away), leaving a hole where it
+//	was.  The segment itself goes away if no one else has it attached.
+//	Returns FALSE if no segment is attached at "addr".
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::DetachSegment(int addr)
+{
+	AttachedSegment *a = NULL;
+
+	for (int i = 0; i < MaxAttachedSegments; i++)
+		if ((attached[i].segment != NULL)
+		    && (attached[i].firstPage * PageSize == addr))
+			a = &attached[i];
+	if (a == NULL)
+		return FALSE;
+	for (int i = 0; i < a->segment->NumPages(); i++) {
+		int page = a->firstPage + i;
+		TranslationEntry *entry = pageTable->Entry(page);
+
+		entry->valid = false;
+		entry->physicalPage = -1;
+		pageSource[page] = PageUnmapped;
+	}
+	pageTable->Discard(a->firstPage, a->segment->NumPages());
+	a->segment->Detach();
+	a->segment = NULL;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SharesFrames
+// 	Return TRUE if other address spaces can write any of our frames:
+//	if we have a shared memory segment attached.  (Code and pages
+//	copied on write are shared read-only, and a mapped file's pages
+//	are our own.)  Then our user code can't be run on a host thread
+//	of its own (see Scheduler::Gang).
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::SharesFrames()
+{
+	for (int i = 0; i < MaxAttachedSegments; i++)
+		if (attached[i].segment != NULL)
+			return TRUE;
+	return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddThread
+// 	Give "thread", started by ThreadCreate, a stack of its own in the
+//	address space, and return the address of its top (less a bit, as
+//	in InitRegisters); -1 if we have MaxUserThreads already.  Like
+//	the first thread's, the stack is UserStackSize bytes, zero-filled
+//	when first touched, and it goes in a hole left by Unmap or by an
+//	exited thread, if there is one, or else past the end.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddThread(Thread *thread)
+{
+	int count = divRoundUp(UserStackSize, PageSize);
+
+	for (int i = 0; i < MaxUserThreads; i++)
+		if (stacks[i].thread == NULL) {
+			stacks[i].thread = thread;
+			stacks[i].firstPage = FindPages(count);
+			for (int page = stacks[i].firstPage;
+			     page < stacks[i].firstPage + count; page++)
+				pageSource[page] = PageZeroFill;
+			numThreads++;
+			DEBUG('a', "Thread stack at page %d of space %d\n",
+			      stacks[i].firstPage, spaceID);
+			return (stacks[i].firstPage + count) * PageSize - 16;
+		}
+	return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RemoveThread
+// 	"thread" has called Exit.  If ThreadCreate started it, give back
+//	its stack -- its frames and swap slots, with nothing written back
+//	-- leaving a hole.  Return FALSE if it was the last thread in the
+//	address space, which can then go away.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::RemoveThread(Thread *thread)
+{
+	int count = divRoundUp(UserStackSize, PageSize);
+
+	for (int i = 0; i < MaxUserThreads; i++) {
+		if (stacks[i].thread != thread)
+			continue;
+		for (int page = stacks[i].firstPage;
+		     page < stacks[i].firstPage + count; page++)
+			FreePage(page);
+		pageTable->Discard(stacks[i].firstPage, count);
+		stacks[i].thread = NULL;
+	}
+	numThreads--;
+	return (bool)(numThreads > 0);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsCreatedThread
+// 	Return TRUE if "thread" was started by ThreadCreate (and so has a
+//	stack in "stacks"), rather than being the address space's first.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsCreatedThread(Thread *thread)
+{
+	for (int i = 0; i < MaxUserThreads; i++)
+		if (stacks[i].thread == thread)
+			return TRUE;
+	return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FreePage
+// 	Give back "page": its frame and its swap slot, with nothing
+//	written back; and leave a hole in its place.  For an exited
+//	thread's stack, or the part of the heap Sbrk gave up.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::FreePage(int page)
+{
+	TranslationEntry *entry = pageTable->Lookup(page);
+
+	if ((entry != NULL) && entry->valid) {
+		if (entry->use)
+			PageUsed(page);
+		coreMap->ReleaseFrame(entry->physicalPage, this);
+		entry->valid = false;
+	}
+	if (swapSlot[page] >= 0) {
+		coreMap->FreeSwapSlot(swapSlot[page]);
+		swapSlot[page] = -1;
+	}
+	pageSource[page] = PageUnmapped;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Sbrk
+// 	Move the end of the heap on by "increment" bytes (back, if it is
+//	negative), for the Sbrk system call, and return where it ended
+//	before; or -1 if that would take it below where it starts or more
+//	than MaxHeapSize past it.
+//
+//	Nothing is allocated now: the new pages are zero-filled when they
+//	are first touched, through the page fault path (see LoadPage), so
+//	a program pays only for the part of its heap it uses.  Pages the
+//	heap gives up are freed now, and become holes again.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Sbrk(int increment)
+{
+	int oldBreak = heapBreak, newBreak = heapBreak + increment;
+	int oldTop = divRoundUp(oldBreak, PageSize);
+	int newTop = divRoundUp(newBreak, PageSize);
+
+	if ((newBreak < heapStart * PageSize)
+	    || (newBreak > heapStart * PageSize + MaxHeapSize))
+		return -1;
+	if (newTop > (int) numPages)
+		Grow(newTop);
+	for (int page = oldTop; page < newTop; page++)
+		pageSource[page] = PageZeroFill;	// a hole, till now
+	for (int page = newTop; page < oldTop; page++)
+		FreePage(page);
+	if (newTop < oldTop)
+		pageTable->Discard(newTop, oldTop - newTop);
+	heapBreak = newBreak;
+	DEBUG('a', "Heap of space %d ends at 0x%x\n", spaceID, heapBreak);
+	return oldBreak;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindPages
+// 	Find "count" consecutive pages that aren't part of the address
+//	space, for Map or AddThread, and return the first.  If no hole left by Unmap
+//	is big enough, the address space grows by "count" pages, and the
+//	new page table is installed, in case it is the current one.
+//
+//	The pages kept for the heap, up to MaxHeapSize past its start,
+//	are never used, so that it can always grow.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::FindPages(int count)
+{
+	int heapLimit = heapStart + MaxHeapSize / PageSize;
+	int first = 0;
+
+	for (int page = 0; page < (int) numPages; page++) {
+		if ((pageSource[page] != PageUnmapped) || (page < heapLimit))
+			first = page + 1;
+		else if (page - first + 1 == count)
+			return first;
+	}
+	first = max(numPages, heapLimit);
+	Grow(first + count);
+	return first;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Grow
+// 	Make the address space "newNumPages" pages long, adding holes to
+//	the end, and install the new page table, in case it is the
+//	current one.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Grow(int newNumPages)
+{
+	PageSource *oldSource = pageSource;
+	int *oldSlot = swapSlot;
+	bool *oldPrefetched = prefetched;
+	int first = numPages;
+
+	ASSERT(newNumPages > (int) numPages);
+	numPages = newNumPages;
+	pageTable->Grow(numPages);
+	pageSource = new PageSource[numPages];
+	swapSlot = new int[numPages];
+	prefetched = new bool[numPages];
+	for (int page = 0; page < (int) numPages; page++) {
+		if (page < first) {
+			pageSource[page] = oldSource[page];
+			swapSlot[page] = oldSlot[page];
+			prefetched[page] = oldPrefetched[page];
+			continue;
+		}
+		pageSource[page] = PageUnmapped;
+		swapSlot[page] = -1;
+		prefetched[page] = false;
+	}
+	delete [] oldSource;
+	delete [] oldSlot;
+	delete [] oldPrefetched;
+	if (currentThread->space == this)
+		pageTable->Install();
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::InitRegisters
 // 	Set the initial values for the user-level register set.
@@ -263,6 +1397,12 @@ AddrSpace::writeback(int oldPage)
 //	that we can immediately jump to user code.  Note that these
 //	will be saved/restored into the currentThread->userRegisters
 //	when this thread is context switched out.
+//
+//	If the program has arguments (see SetArguments), they go at the
+//	top of the stack, each string copied out in one piece, with the
+//	array of pointers to them below, ending in NULL; main(argc, argv)
+//	gets the count in r4, and the array in r5.  Our page table must
+//	already be the machine's, for that.
 //----------------------------------------------------------------------
 
 void
@@ -285,6 +1425,46 @@ AddrSpace::InitRegisters()
    // accidentally reference off the end!
     machine->WriteRegister(StackReg, numPages * PageSize - 16);
     DEBUG('a', "Initializing stack register to %d\n", numPages * PageSize - 16);
+    if (argv == NULL)
+	return;
+
+    int ptrs[MaxExecArgs + 1];
+    int sp = numPages * PageSize - 16;
+    bool copied = TRUE;
+
+    for (i = 0; i < argc; i++) {
+	int length = strlen(argv[i]) + 1;
+
+	sp -= length;
+	ptrs[i] = WordToMachine(sp);
+	copied = (bool)(copied && machine->CopyOut(sp, argv[i], length));
+    }
+    ptrs[argc] = 0;
+    sp = (sp - (argc + 1) * sizeof(int)) & ~3;	// word-aligned
+    copied = (bool)(copied && machine->CopyOut(sp, (char *) ptrs,
+					       (argc + 1) * sizeof(int)));
+    ASSERT(copied);			// the stack is always there
+    machine->WriteRegister(4, argc);
+    machine->WriteRegister(5, sp);
+    machine->WriteRegister(StackReg, sp - 16);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SetArguments
+// 	Keep "count" argument strings, "args", for InitRegisters to pass
+//	the program.  They, and the array, are ours now, to delete; any
+//	we had before are deleted.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SetArguments(int count, char **args)
+{
+    for (int i = 0; i < argc; i++)
+	delete [] argv[i];
+    delete [] argv;
+    ASSERT(count <= MaxExecArgs);
+    argc = count;
+    argv = args;
 }
 
 //----------------------------------------------------------------------
@@ -292,23 +1472,95 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	We stop our virtual clock (see VirtualTime).
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
-{}
+{
+    virtualTime += stats->userTicks - runningSince;
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	start our virtual clock again.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
-    printf("restore the progress with the spaceId: %d\n",spaceID);
-    machine->pageTable = pageTable;
-    machine->pageTableSize = numPages;
+    DEBUG('a', "Restoring address space %d\n", spaceID);
+    runningSince = stats->userTicks;
+    pageTable->Install();
+}
+
+//----------------------------------------------------------------------
+// VMCounts::VMCounts
+// 	Start counting from zero.
+//----------------------------------------------------------------------
+
+VMCounts::VMCounts()
+{
+    majorFaults = minorFaults = evictions = writeBacks = prefetchHits = 0;
+    for (int i = 0; i < FaultBuckets; i++)
+	faultLatency[i] = 0;
+}
+
+//----------------------------------------------------------------------
+// VMCounts::RecordFault
+// 	Count a page fault, in the latency histogram too.
+//
+//	"major" -- did the page have to be read from disk?
+//	"ticks" -- how long it took to map the page
+//----------------------------------------------------------------------
+
+void
+VMCounts::RecordFault(bool major, int ticks)
+{
+    if (major)
+	majorFaults++;
+    else
+	minorFaults++;
+    faultLatency[HistogramBucket(ticks, FaultBuckets)]++;
+}
+
+//----------------------------------------------------------------------
+// VMCounts::Add
+// 	Add the counts in "other" to ours.
+//----------------------------------------------------------------------
+
+void
+VMCounts::Add(VMCounts *other)
+{
+    majorFaults += other->majorFaults;
+    minorFaults += other->minorFaults;
+    evictions += other->evictions;
+    writeBacks += other->writeBacks;
+    prefetchHits += other->prefetchHits;
+    for (int i = 0; i < FaultBuckets; i++)
+	faultLatency[i] += other->faultLatency[i];
+}
+
+//----------------------------------------------------------------------
+// VMCounts::Print
+// 	Print the counts, and the latency histogram, if there were any
+//	faults.
+//
+//	"name" -- what they were counted for
+//----------------------------------------------------------------------
+
+void
+VMCounts::Print(const char *name)
+{
+    char title[60];
+
+    printf("Paging, %s: major faults %d, minor faults %d, evictions %d, "
+	   "writebacks %d, prefetch hits %d\n", name, majorFaults,
+	   minorFaults, evictions, writeBacks, prefetchHits);
+    if (majorFaults + minorFaults == 0)
+	return;
+    sprintf(title, "Fault latency, %s (ticks)", name);
+    PrintHistogram(title, faultLatency, FaultBuckets);
 }
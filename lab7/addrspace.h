@@ -17,12 +17,137 @@
 #include "filesys.h"
 #include "bitmap.h"
 #include "machine.h"
+#include "noff.h"
+#include "sharedtext.h"
+#include "pagetable.h"
+#include "profile.h"
 
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxOpenFiles		16	// OpenFileIds per address space,
+					// counting the console's two
 
 #define MaxNumPhysPages  5//每个进程固定分5帧
 
+// Where the contents of a virtual page come from, the next time it
+// is brought into memory.
+
+enum PageSource { PageFromFile,		// code/initialized data, in the
+					// executable
+		  PageZeroFill,		// never written; all zeroes
+		  PageInSwap,		// written back to its swap slot
+		  PageShared,		// pure code, shared read-only with
+					// other users of the program
+		  PageMapped,		// part of a file mapped by Mmap
+		  PageSegment,		// part of a shared memory segment:
+					// always mapped to its frame
+		  PageUnmapped };	// not part of the address space
+					// (anymore): a hole left by Munmap
+
+#define MaxMappedFiles		4	// Mmaps per address space
+
+// A file mapped into an address space by Mmap.  Its pages are read in
+// from the file when they are first touched, and written back to the
+// file, rather than to swap, when they are evicted or unmapped.
+
+class MappedFile {
+  public:
+    OpenFile *file;			// NULL if this slot is free
+    int firstPage;			// where in the address space it is
+    int numPages;
+    int length;				// how many bytes of the file are
+					// mapped: all it had, at Mmap
+};
+
+#define MaxAttachedSegments	4	// ShmAttaches per address space
+
+class SharedSegment;
+
+// A shared memory segment attached to an address space by ShmAttach.
+
+class AttachedSegment {
+  public:
+    SharedSegment *segment;		// NULL if this slot is free
+    int firstPage;			// where in the address space it is
+};
+
+class PipeBuffer;
+
+// One end of a pipe, open in an address space as an OpenFileId.  Pipe
+// ends and files share the ids.
+
+class PipeEnd {
+  public:
+    PipeBuffer *pipe;			// NULL if this id is not a pipe end
+    bool writing;			// the write end, else the read end
+};
+
+#define MaxExecArgs		16	// arguments Exec can pass a program
+#define MaxArgSize		(UserStackSize / 4)
+					// ... and how long they can be, in
+					// all, counting the '\0's (they go
+					// on the stack)
+
+#define MaxHeapSize		(512 * PageSize)
+					// how far Sbrk can grow the heap
+
+#define MaxUserThreads		8	// threads ThreadCreate can add to
+					// an address space
+
+#define StartPages		2	// pages a program started by Exec
+					// needs before it can run; the rest
+					// of the ones it starts with are
+					// streamed in while it runs
+#define MaxInTransit	(MaxUserThreads + 2)
+					// pages of an address space that
+					// can be being read in at once (one
+					// for each thread, and the loader)
+
+class Thread;
+class Lock;
+class Condition;
+class Semaphore;
+
+#define FaultBuckets		16	// the fault latency histogram, in
+					// ticks (see HistogramBucket)
+
+// What paging cost an address space: printed when it is deleted, and
+// added to the totals for them all (vmTotals), printed at Halt.  A
+// major fault had to read the page from disk (from the executable, a
+// mapped file or swap); a minor one didn't (a zero-filled page, one
+// reclaimed from the page-out daemon, or shared code some other
+// program had already brought in).  Pages brought in by fault-around
+// are not faults, but are counted as prefetch hits once used.
+
+class VMCounts {
+  public:
+    VMCounts();				// all zero, to begin with
+
+    void RecordFault(bool major, int ticks);
+					// count a fault, that took "ticks"
+    void Add(VMCounts *other);		// add "other"'s counts to ours
+    void Print(const char *name);	// print them all
+
+    int majorFaults;
+    int minorFaults;
+    int evictions;			// pages taken from us, by the
+					// replacement policy or the daemon
+    int writeBacks;			// ... that were dirty, and so were
+					// written back
+    int prefetchHits;			// pages fault-around brought in,
+					// that were then used
+    int faultLatency[FaultBuckets];	// ticks from the fault to the
+					// page being mapped
+};
+
+// The stack of a thread started by ThreadCreate, in the address space
+// it shares with the others.
+
+class UserStack {
+  public:
+    Thread *thread;			// NULL if this slot is free
+    int firstPage;			// where in the address space it is
+};
 
 class AddrSpace {
   public:
@@ -30,31 +155,162 @@ class AddrSpace {
     AddrSpace(char *filename);	// Create an address space,
 					// initializing it with the program
 					// stored in the file "executable"
+					// (none of it is in memory yet)
+    AddrSpace(AddrSpace *parent);	// Create a copy-on-write copy of
+					// "parent", for Fork
     ~AddrSpace();			// De-allocate an address space
 
+    void SetArguments(int count, char **args);
+					// The arguments to pass the program
+					// (the address space keeps "args")
+    void StartLoading();		// Bring in the pages the program
+					// needs to start, and stream in the
+					// rest of its first ones
+    void StreamPages();			// The loader thread doing that
     void InitRegisters();		// Initialize user-level CPU registers,
-					// before jumping to user code
+					// before jumping to user code; and
+					// push the arguments on the stack
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
     int getSpaceID(){return spaceID;}
+    int getConsole() { return console; }	// the console ConsoleInput
+    void setConsole(int c) { console = c; }	// and ConsoleOutput are
+						// on (see AddConsole)
+    Profile *getProfile() { return profile; }
+					// Where PC samples are counted, NULL
+					// if we aren't profiling
 
     void Print();
 	
-	int findReplacedPage();
 	 //executable要保留,增加置换页的函数
-	void replacePage(int badVAddr);  //
+	void replacePage(int badVAddr);  // bring in a page after a fault
+	void Evict(int page);		// give up the frame holding "page"
+	int PageOut(int page, char *buffer);
+					// the same, for the page-out
+					// daemon: copy it to "buffer" if
+					// it's dirty, and return its slot
+	bool CanPageOut(int page);	// could the daemon take "page"?
+	void PageUsed(int page);	// note that "page" has been used
+	bool CopyOnWrite(int badVAddr);	// give us our own copy of the
+					// page written at "badVAddr"
 	
 	void writeback(int oldPage);
+
+    int Map(OpenFile *file);		// Map all of "file" in; return the
+					// address it is at, -1 if no room
+    bool Unmap(int addr);		// Unmap the file mapped at "addr"
+					// (closing it, if it isn't open as
+					// well); FALSE if there is none
+    bool IsMapped(OpenFile *file);	// Is "file" mapped in?
+
+    int AttachSegment(SharedSegment *segment);
+					// Map "segment" in; return the
+					// address it is at, -1 if no room
+    bool DetachSegment(int addr);	// Unmap the segment attached at
+					// "addr"; FALSE if there is none
+    bool SharesFrames();		// Can other spaces write any of our
+					// frames (has a segment attached)?
+
+    int AddThread(Thread *thread);	// Give "thread" a stack of its own;
+					// return its top, -1 if too many
+    bool RemoveThread(Thread *thread);	// "thread" has exited: give back
+					// its stack; FALSE if it was the
+					// last thread
+    bool IsCreatedThread(Thread *thread);
+					// Did ThreadCreate start "thread"?
+
+    int AddFile(OpenFile *file);	// Give "file" an OpenFileId, -1 if
+					// too many are open
+    OpenFile *GetFile(int id);		// The file open as "id", NULL if
+					// none (or it is the console)
+    OpenFile *RemoveFile(int id);	// Take "id" out of the table, and
+					// return what it was
+
+    int AddPipeEnd(PipeBuffer *pipe, bool writing);
+					// Open an end of "pipe" as an
+					// OpenFileId; -1 if too many are open
+    PipeBuffer *GetPipe(int id, bool writing);
+					// The pipe "id" is the read (or
+					// write) end of, NULL if none
+    bool ClosePipeEnd(int id);		// Close the pipe end "id"; FALSE if
+					// it isn't one
+    void InheritPipes(AddrSpace *parent);
+					// Open the pipe ends "parent" has,
+					// as the same ids
+
+    int Sbrk(int increment);		// Grow (or shrink) the heap by
+					// "increment" bytes; return where
+					// it ended before, -1 if it can't
+
+    TranslationEntry *PageTableEntry(int vpn);
+					// Return the translation for virtual
+					// page "vpn", NULL if out of range
 	
   private:
-    TranslationEntry *pageTable;	// Assume linear page table translation
-					// for now!
+    PageTable *pageTable;		// linear, or two-level with -spt
+					// (see pagetable.h)
     int spaceID;
+    int console;			// which console is ours
+    Profile *profile;			// Our profile, if profiling (it
+					// outlives us, to be printed at Halt)
     unsigned int numPages;		// Number of pages in the virtual 
-   char *filename;
-	//OpenFile *executable;   //整个虚拟内存空间
+    OpenFile *executable;		// the program, open for page faults
+					// (owned by "text", and shared)
+    NoffHeader noffH;			// where its segments are
+    PageSource *pageSource;		// where each page comes from
+    SharedText *text;			// the program's shared code pages
+    int *swapSlot;			// swap slot holding each virtual page,
+					// -1 if none yet (see swapMap)
+    bool *prefetched;			// brought in by fault-around, and
+					// not yet seen used
+    int virtualTime;			// user instructions we have run, up
+					// to the last SaveState
+    int runningSince;			// stats->userTicks at RestoreState
+    int lastFault;			// virtual time of our last page fault
+    int VirtualTime();			// user instructions we have run
+    void Trim();			// give up the pages not used lately
+    bool Overlaps(Segment *seg, int page);
+    void ReadSegment(Segment *seg, int page, char *memory);
+					// read the part of "seg" in "page"
+    OpenFile *openFiles[MaxOpenFiles];	// what each OpenFileId is open to;
+					// ConsoleInput and ConsoleOutput
+					// are always NULL
+    PipeEnd pipeEnds[MaxOpenFiles];	// ... or the pipe end it is
+    MappedFile mappedFiles[MaxMappedFiles];
+					// the files mapped in by Mmap
+    MappedFile *FindMapping(int page);	// the file mapped at "page"
+    AttachedSegment attached[MaxAttachedSegments];
+					// the segments attached by ShmAttach
+    int numThreads;			// threads running in us
+    UserStack stacks[MaxUserThreads];	// the stacks of those started by
+					// ThreadCreate
+    int FindPages(int count);		// "count" pages not in the address
+					// space, for Map and AddThread; the
+					// first of them
+    void Grow(int newNumPages);		// add holes to the end of the
+					// address space
+    void FreePage(int page);		// give back "page", and make it
+					// a hole
+    int heapStart;			// the first page of the heap, just
+					// past the stack; the pages up to
+					// MaxHeapSize past it are kept for it
+    int heapBreak;			// where the heap ends now (bytes)
+    int argc;				// the arguments, for InitRegisters
+    char **argv;			// (NULL if none)
+    VMCounts vmCounts;			// our paging, so far
+    bool LoadPage(int page);		// bring "page" into memory; TRUE
+					// if it had to be read from disk
+    void Loaded(int page);		// "page" is in: map it
+    int preloadPages;			// how many pages we start out with
+    int inTransit[MaxInTransit];	// pages being read in, -1 for none
+    Lock *loadLock;			// protects inTransit
+    Condition *pageLoaded;		// signalled when one of them is in
+    Semaphore *loaderDone;		// V'ed when StreamPages is done, if
+					// it was started (NULL if not)
+    bool stopLoading;			// tell it to give up, as we are
+					// being deleted
     int necessaryFrames;  //初始时，固定分配的最大帧数
 					// address space
 };
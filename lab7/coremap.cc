@@ -0,0 +1,781 @@
+// coremap.cc
+//	Routines to manage the core map: who owns each physical page
+//	frame, and which frame to take when memory is full.
+//
+//	The use and dirty bits that the replacement policies look at are
+//	kept by the hardware (Machine::Translate) in the owner's page
+//	table entry, so we find them from the entry's owner (or owners,
+//	for shared code and for frames shared copy-on-write after a Fork)
+//	and virtual page.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "coremap.h"
+#include "addrspace.h"
+#include "sharedtext.h"
+#include "shm.h"
+#include "synch.h"
+#include "swapcache.h"
+
+//----------------------------------------------------------------------
+// ZeroFrameTask
+// 	Dummy function because C++ does not allow a pointer to a member
+//	function: the idle task that fills the zeroed stack.
+//----------------------------------------------------------------------
+
+static bool
+ZeroFrameTask(_int arg)
+{
+    return ((CoreMap *) arg)->ZeroFreeFrame();
+}
+
+//----------------------------------------------------------------------
+// PageOutThread
+// 	Dummy function because C++ does not allow a pointer to a member
+//	function: the body of the page-out daemon.
+//----------------------------------------------------------------------
+
+static void
+PageOutThread(_int arg)
+{
+    ((CoreMap *) arg)->PageOut();
+}
+
+//----------------------------------------------------------------------
+// CoreMap::CoreMap
+// 	Initialize the core map, with every frame free.
+//
+//	The frames past the first "frames" are never put on the free
+//	stack, so nothing is ever loaded into them: that is how we run
+//	with less memory than the machine has, to see how programs do
+//	with fewer frames (-frames, see system.cc).
+//
+//	The free frames are zeroed, for the zeroed stack, while the
+//	machine is idle (see ZeroFreeFrame).  The page-out daemon keeps
+//	between an eighth and a quarter of the frames free, once started.
+//
+//	"replacement" -- how to choose which page to evict when memory
+//		is full
+//	"frames" -- how many frames to use
+//----------------------------------------------------------------------
+
+CoreMap::CoreMap(ReplacementPolicy replacement, int frames)
+{
+    ASSERT((frames > 0) && (frames <= numPhysPages));
+    policy = replacement;
+    numFrames = frames;
+    map = new CoreMapEntry[numPhysPages];	// as big as memory is
+    freeFrames = new int[numPhysPages];
+    zeroedFrames = new int[numPhysPages];
+    numFree = numZeroed = 0;
+    for (int i = numPhysPages - 1; i >= 0; i--) {	// so frame 0 is on top
+	map[i].owner = NULL;
+	map[i].text = NULL;
+	map[i].segment = NULL;
+	map[i].sharers = NULL;
+	map[i].virtualPage = -1;
+	map[i].pinned = FALSE;
+	map[i].loadStamp = 0;
+	if (i < numFrames)
+	    freeFrames[numFree++] = i;
+    }
+    numLoads = 0;
+    clockHand = 0;
+    pageOutWanted = NULL;
+    pageOutAwake = FALSE;
+    lowWater = max(1, numFrames / 8);
+    highWater = max(lowWater + 1, numFrames / 4);
+    picking = FALSE;
+    numOut = 0;
+    interrupt->AddIdleTask(ZeroFrameTask, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// CoreMap::~CoreMap
+// 	De-allocate the core map.
+//----------------------------------------------------------------------
+
+CoreMap::~CoreMap()
+{
+    delete [] map;
+    delete [] freeFrames;
+    delete [] zeroedFrames;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::AllocFrame
+// 	Find a frame to hold virtual page "virtualPage" of address space
+//	"space".  If there is no free frame, the replacement policy picks
+//	a resident page -- of any address space -- which is written back
+//	(if dirty) and unmapped by its owner, and we take its frame.
+//
+//	The frame is returned pinned, so that it can't be taken away again
+//	while the caller is filling it; the caller must Unpin it.
+//
+//	A caller that is going to zero the frame passes "zeroed", to be
+//	given a frame that already is, if there is one: *zeroed is then
+//	TRUE, and it needn't.  Other callers get a zeroed frame only if
+//	there is no other free.
+//----------------------------------------------------------------------
+
+int
+CoreMap::AllocFrame(AddrSpace *space, int virtualPage, bool *zeroed)
+{
+    int frame = GetFrame(zeroed);
+
+    map[frame].owner = space;
+    map[frame].virtualPage = virtualPage;
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::AllocSharedFrame
+// 	Like AllocFrame, but for page "virtualPage" of the shared code
+//	"text", which owns the frame on behalf of all its users.
+//----------------------------------------------------------------------
+
+int
+CoreMap::AllocSharedFrame(SharedText *text, int virtualPage)
+{
+    int frame = GetFrame(NULL);
+
+    map[frame].text = text;
+    map[frame].virtualPage = virtualPage;
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::AllocSegmentFrame
+// 	Like AllocFrame, but for page "page" of the shared memory segment
+//	"segment", which owns the frame on behalf of all the address
+//	spaces attached to it.  The frame is left pinned, until it is
+//	freed.
+//----------------------------------------------------------------------
+
+int
+CoreMap::AllocSegmentFrame(SharedSegment *segment, int page, bool *zeroed)
+{
+    int frame = GetFrame(zeroed);
+
+    map[frame].segment = segment;
+    map[frame].virtualPage = page;
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::GetFrame
+// 	Take a frame off the free stack or, if there is none, evict the
+//	page chosen by the replacement policy: its owner (or, for shared
+//	code, every address space sharing it) unmaps it, writing it back
+//	first if it is dirty.  A frame shared copy-on-write is unmapped by
+//	the owner and by each sharer, each writing the page to its own
+//	swap slot.  The frame is returned pinned.
+//
+//	If "zeroed" is given, a frame off the zeroed stack is preferred,
+//	and *zeroed set if we took one; otherwise, one off the other.
+//----------------------------------------------------------------------
+
+int
+CoreMap::GetFrame(bool *zeroed)
+{
+    int frame;
+
+    if (zeroed != NULL)
+	*zeroed = FALSE;
+    if ((numZeroed > 0) && ((zeroed != NULL) || (numFree == 0))) {
+	frame = PopFrame(zeroedFrames, &numZeroed);
+	if (zeroed != NULL) {
+	    *zeroed = TRUE;
+	    stats->numZeroedFramesUsed++;
+	}
+    } else if (numFree > 0)
+	frame = PopFrame(freeFrames, &numFree);
+    else {
+	frame = FindVictim();
+	stats->numPagesEvicted++;
+	DEBUG('a', "Evicting page %d from frame %d\n",
+	      map[frame].virtualPage, frame);
+	if (map[frame].text != NULL)
+	    map[frame].text->Evict(map[frame].virtualPage);
+	else {
+	    map[frame].owner->Evict(map[frame].virtualPage);
+	    while (map[frame].sharers != NULL) {
+		CoreMapSharer *sharer = map[frame].sharers;
+
+		sharer->space->Evict(map[frame].virtualPage);
+		map[frame].sharers = sharer->next;
+		delete sharer;
+	    }
+	}
+	map[frame].owner = NULL;
+	map[frame].text = NULL;
+    }
+    map[frame].pinned = TRUE;
+    map[frame].loadStamp = numLoads++;
+    if ((pageOutWanted != NULL) && !pageOutAwake && (NumFree() < lowWater)) {
+	pageOutAwake = TRUE;		// running low: wake the daemon
+	pageOutWanted->V();
+    }
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::PopFrame
+// 	Take a frame off the free stack "stack", holding "*count" frames.
+//	Without NUMA, that is the one on top.  With it, it is the topmost
+//	one on the current thread's node, which is swapped to the top
+//	first; if there isn't one, the frame on top is remote.
+//----------------------------------------------------------------------
+
+int
+CoreMap::PopFrame(int *stack, int *count)
+{
+    ASSERT(*count > 0);
+    if (machine->NumNodes() > 1) {
+	int node = scheduler->NodeOf(currentThread->getCPU());
+	int i;
+
+	for (i = *count - 1; i >= 0; i--)
+	    if (machine->FrameNode(stack[i]) == node)
+		break;
+	if (i >= 0) {
+	    int frame = stack[i];
+
+	    stack[i] = stack[*count - 1];
+	    stack[*count - 1] = frame;
+	} else
+	    stats->numRemoteFrames++;
+    }
+    return stack[--(*count)];
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FreeFrame
+// 	Give back a frame, e.g., when the address space owning it is
+//	deleted.  This just pushes it on the free stack.
+//----------------------------------------------------------------------
+
+void
+CoreMap::FreeFrame(int frame)
+{
+    ASSERT((frame >= 0) && (frame < numPhysPages));
+    ASSERT((map[frame].owner != NULL) || (map[frame].text != NULL)
+	   || (map[frame].segment != NULL));
+    ASSERT(map[frame].sharers == NULL);
+    map[frame].owner = NULL;
+    map[frame].text = NULL;
+    map[frame].segment = NULL;
+    map[frame].virtualPage = -1;
+    map[frame].pinned = FALSE;
+    freeFrames[numFree++] = frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ZeroFreeFrame
+// 	Zero one of the free frames, and move it to the zeroed stack.
+//	Called while the machine is idle, a frame per slice of idle time,
+//	so that the page faults that need a zeroed frame don't have to
+//	zero it themselves.  Returns FALSE if there are none left to zero.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::ZeroFreeFrame()
+{
+    int frame;
+
+    if (numFree == 0)
+	return FALSE;
+    frame = freeFrames[--numFree];
+    bzero(&(machine->mainMemory[frame * PageSize]), PageSize);
+    zeroedFrames[numZeroed++] = frame;
+    stats->numFramesZeroed++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::StartPageOut
+// 	Fork the page-out daemon (for -pageout, see system.cc).  It waits
+//	until GetFrame finds free frames running low.
+//----------------------------------------------------------------------
+
+void
+CoreMap::StartPageOut()
+{
+    ASSERT(pageOutWanted == NULL);
+    pageOutWanted = new Semaphore("page-out", 0);
+    (new Thread("page-out"))->Fork(PageOutThread, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// CoreMap::PageOut
+// 	The body of the page-out daemon: each time it is woken, evict
+//	pages, a cluster at a time, until highWater frames are free (or
+//	there is nothing else it can evict), and go back to sleep.
+//
+//	Choosing the pages and copying them out is done with interrupts
+//	off, so that no one sees a page half evicted; only the write to
+//	swap, after, lets other threads run.
+//----------------------------------------------------------------------
+
+void
+CoreMap::PageOut()
+{
+    for (;;) {
+	pageOutAwake = FALSE;
+	pageOutWanted->P();
+	while (NumFree() < highWater) {
+	    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+	    int numFreed = PickPages();
+
+	    (void) interrupt->SetLevel(oldLevel);
+	    if (numFreed == 0)
+		break;			// all pinned, or not ours to evict
+	    WriteCluster();
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// CoreMap::PickPages
+// 	Evict pages chosen by the replacement policy, until highWater
+//	frames are free or PageOutCluster dirty ones have been copied out
+//	for WriteCluster, and free their frames.  The cluster ends up
+//	sorted by swap slot, so that pages in consecutive slots can be
+//	written together.  Returns the number of frames freed.
+//
+//	Only pages that can be copied out are picked (see IsCandidate):
+//	none that is shared copy-on-write, and no dirty page of a mapped
+//	file.  Those are left for GetFrame to evict.
+//----------------------------------------------------------------------
+
+int
+CoreMap::PickPages()
+{
+    int numFreed = 0;
+
+    ASSERT(numOut == 0);
+    picking = TRUE;
+    while ((NumFree() < highWater) && (numOut < PageOutCluster)
+		&& AnyCandidate()) {
+	int frame = FindVictim();
+	int vpn = map[frame].virtualPage;
+
+	DEBUG('a', "Paging out page %d from frame %d\n", vpn, frame);
+	if (map[frame].text != NULL)
+	    map[frame].text->Evict(vpn);	// code: never dirty
+	else {
+	    int slot = map[frame].owner->PageOut(vpn,
+						 &outBuffer[numOut * PageSize]);
+
+	    if (slot >= 0) {
+		outSlots[numOut] = slot;
+		outFreed[numOut] = FALSE;
+		numOut++;
+	    }
+	}
+	FreeFrame(frame);
+	numFreed++;
+	stats->numPagesPagedOut++;
+    }
+    picking = FALSE;
+
+    for (int i = 1; i < numOut; i++)		// sort by slot
+	for (int j = i; (j > 0) && (outSlots[j - 1] > outSlots[j]); j--) {
+	    char page[PageSize];
+	    int slot = outSlots[j];
+
+	    bcopy(&outBuffer[j * PageSize], page, PageSize);
+	    bcopy(&outBuffer[(j - 1) * PageSize], &outBuffer[j * PageSize],
+		  PageSize);
+	    bcopy(page, &outBuffer[(j - 1) * PageSize], PageSize);
+	    outSlots[j] = outSlots[j - 1];
+	    outSlots[j - 1] = slot;
+	}
+    return numFreed;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::WriteCluster
+// 	Write the pages PickPages copied out to their swap slots, one
+//	write for each run of consecutive slots; then give back the slots
+//	whose pages were deleted, or faulted back in, meanwhile.
+//----------------------------------------------------------------------
+
+void
+CoreMap::WriteCluster()
+{
+    int i, j;
+
+    for (i = 0; i < numOut; i = j) {
+	for (j = i + 1; (j < numOut) && (outSlots[j] == outSlots[j - 1] + 1);
+	     j++)
+	    ;
+	swapFile->WriteAt(&outBuffer[i * PageSize], (j - i) * PageSize,
+			  outSlots[i] * PageSize);
+	stats->numPageOutWrites++;
+    }
+    for (i = 0; i < numOut; i++)
+	if (outFreed[i])
+	    swapMap->Clear(outSlots[i]);
+    numOut = 0;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::PagingOut
+// 	Return where in the cluster being written swap slot "slot" is, or
+//	-1 if it isn't.
+//----------------------------------------------------------------------
+
+int
+CoreMap::PagingOut(int slot)
+{
+    for (int i = 0; i < numOut; i++)
+	if (outSlots[i] == slot)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ReadSwap
+// 	Read the page in swap slot "slot" into "into": from the cluster,
+//	if the daemon is still writing it, or from the swap cache, if the
+//	page is there; else from the swap file.
+//----------------------------------------------------------------------
+
+void
+CoreMap::ReadSwap(int slot, char *into)
+{
+    int i = PagingOut(slot);
+
+    if (i >= 0)
+	bcopy(&outBuffer[i * PageSize], into, PageSize);
+    else if ((swapCache != NULL) && swapCache->Read(slot, into))
+	return;
+    else
+	swapFile->ReadAt(into, PageSize, slot * PageSize);
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ReclaimSwap
+// 	A page is being faulted back in from swap slot "slot".  If the
+//	daemon is still writing it, copy it from the cluster into "into",
+//	and return TRUE: the caller then has the only up-to-date copy,
+//	and must treat the page as dirty, and the slot as no longer its
+//	own (the daemon frees it, when the write is done).  Otherwise,
+//	return FALSE, and the caller reads the swap file.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::ReclaimSwap(int slot, char *into)
+{
+    int i = PagingOut(slot);
+
+    if ((i < 0) || outFreed[i])
+	return FALSE;
+    bcopy(&outBuffer[i * PageSize], into, PageSize);
+    outFreed[i] = TRUE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FreeSwapSlot
+// 	Give back swap slot "slot", unless the daemon is still writing
+//	it, in which case it gives it back when it is done -- so that no
+//	one else can be given the slot, and have the daemon's write land
+//	on top of theirs.
+//----------------------------------------------------------------------
+
+void
+CoreMap::FreeSwapSlot(int slot)
+{
+    int i = PagingOut(slot);
+
+    if (i >= 0)
+	outFreed[i] = TRUE;
+    else {
+	if (swapCache != NULL)
+	    swapCache->Drop(slot);
+	swapMap->Clear(slot);
+    }
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ShareFrame
+// 	After a Fork, "space" maps "frame" -- which some other address
+//	space owns -- at the same virtual page, read-only, until one of
+//	them writes to it (see AddrSpace::CopyOnWrite).
+//----------------------------------------------------------------------
+
+void
+CoreMap::ShareFrame(int frame, AddrSpace *space)
+{
+    CoreMapSharer *sharer = new CoreMapSharer;
+
+    ASSERT((map[frame].owner != NULL) && (map[frame].text == NULL));
+    sharer->space = space;
+    sharer->next = map[frame].sharers;
+    map[frame].sharers = sharer;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ReleaseFrame
+// 	"space" no longer maps "frame": it has taken a copy of the page,
+//	or is being deleted.  If other address spaces still share the
+//	frame, take "space" off the list (handing ownership on to a
+//	sharer, if "space" was the owner); otherwise, free the frame.
+//----------------------------------------------------------------------
+
+void
+CoreMap::ReleaseFrame(int frame, AddrSpace *space)
+{
+    CoreMapSharer **ptr, *sharer;
+
+    ASSERT((frame >= 0) && (frame < numPhysPages));
+    if (map[frame].sharers == NULL) {
+	ASSERT(map[frame].owner == space);
+	FreeFrame(frame);
+	return;
+    }
+    if (map[frame].owner == space) {
+	sharer = map[frame].sharers;
+	map[frame].owner = sharer->space;
+	map[frame].sharers = sharer->next;
+    } else {
+	for (ptr = &map[frame].sharers; *ptr != NULL; ptr = &(*ptr)->next)
+	    if ((*ptr)->space == space)
+		break;
+	ASSERT(*ptr != NULL);
+	sharer = *ptr;
+	*ptr = sharer->next;
+    }
+    delete sharer;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Print
+// 	Print the contents of the core map, for debugging.
+//----------------------------------------------------------------------
+
+void
+CoreMap::Print()
+{
+    printf("Core map: %d frames free, %d of them zeroed\n", NumFree(),
+	   numZeroed);
+    for (int i = 0; i < numPhysPages; i++)
+	if (map[i].owner != NULL) {
+	    printf("\tframe %d: space %d", i, map[i].owner->getSpaceID());
+	    for (CoreMapSharer *s = map[i].sharers; s != NULL; s = s->next)
+		printf(",%d", s->space->getSpaceID());
+	    printf(", page %d%s\n", map[i].virtualPage,
+		   map[i].pinned ? ", pinned" : "");
+	} else if (map[i].text != NULL)
+	    printf("\tframe %d: code of %s, page %d%s\n", i,
+		   map[i].text->getName(), map[i].virtualPage,
+		   map[i].pinned ? ", pinned" : "");
+	else if (map[i].segment != NULL)
+	    printf("\tframe %d: shared segment %d, page %d\n", i,
+		   map[i].segment->getID(), map[i].virtualPage);
+}
+
+//----------------------------------------------------------------------
+// CoreMap::IsCandidate
+// 	Return TRUE if "frame" holds a page that may be evicted: it is
+//	not free, and not pinned.  The page-out daemon leaves alone the
+//	frames that PickPages can't copy out (see there).
+//----------------------------------------------------------------------
+
+bool
+CoreMap::IsCandidate(int frame)
+{
+    if (picking && (map[frame].owner != NULL)
+	    && ((map[frame].sharers != NULL)
+		|| !map[frame].owner->CanPageOut(map[frame].virtualPage)))
+	return FALSE;
+    return (bool)(((map[frame].owner != NULL) || (map[frame].text != NULL))
+		  && !map[frame].pinned);
+}
+
+//----------------------------------------------------------------------
+// CoreMap::AnyCandidate
+// 	Return TRUE if there is a frame FindVictim could pick, since it
+//	insists that there is.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::AnyCandidate()
+{
+    for (int i = 0; i < numPhysPages; i++)
+	if (IsCandidate(i))
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::IsUsed, IsDirty
+// 	Return the use or dirty bit of the page in "frame", from its
+//	owner's page table entry.  Shared code is used if any of the
+//	address spaces sharing it used it, and is never dirty.  A frame
+//	shared copy-on-write is used (or dirty) if it is for the owner or
+//	for any sharer.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::IsUsed(int frame)
+{
+    int vpn = map[frame].virtualPage;
+
+    if (map[frame].text != NULL)
+	return map[frame].text->IsUsed(vpn);
+    for (CoreMapSharer *s = map[frame].sharers; s != NULL; s = s->next)
+	if (s->space->PageTableEntry(vpn)->use)
+	    return TRUE;
+    return map[frame].owner->PageTableEntry(vpn)->use;
+}
+
+bool
+CoreMap::IsDirty(int frame)
+{
+    int vpn = map[frame].virtualPage;
+
+    if (map[frame].text != NULL)
+	return FALSE;
+    for (CoreMapSharer *s = map[frame].sharers; s != NULL; s = s->next)
+	if (s->space->PageTableEntry(vpn)->dirty)
+	    return TRUE;
+    return map[frame].owner->PageTableEntry(vpn)->dirty;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ClearUse
+// 	Clear the use bit of the page in "frame", telling its owner first
+//	that the page was used (and each sharer, for a frame shared
+//	copy-on-write).
+//----------------------------------------------------------------------
+
+void
+CoreMap::ClearUse(int frame)
+{
+    int vpn = map[frame].virtualPage;
+
+    if (map[frame].text != NULL) {
+	map[frame].text->ClearUse(vpn);
+	return;
+    }
+    for (CoreMapSharer *s = map[frame].sharers; s != NULL; s = s->next)
+	if (s->space->PageTableEntry(vpn)->use) {
+	    s->space->PageUsed(vpn);
+	    s->space->PageTableEntry(vpn)->use = FALSE;
+	}
+    if (map[frame].owner->PageTableEntry(vpn)->use) {
+	map[frame].owner->PageUsed(vpn);
+	map[frame].owner->PageTableEntry(vpn)->use = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FindVictim
+// 	Choose a frame to evict, according to the policy selected at boot.
+//	There must be at least one frame that is not pinned.
+//----------------------------------------------------------------------
+
+int
+CoreMap::FindVictim()
+{
+    switch (policy) {
+      case FIFOReplacement:
+	return FindFIFOVictim();
+      case ClockReplacement:
+	return FindClockVictim();
+      case EnhancedClockReplacement:
+	return FindEnhancedClockVictim();
+    }
+    ASSERT(FALSE);
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FindFIFOVictim
+// 	Evict the page that was loaded longest ago.
+//----------------------------------------------------------------------
+
+int
+CoreMap::FindFIFOVictim()
+{
+    int victim = -1;
+
+    for (int i = 0; i < numPhysPages; i++)
+	if (IsCandidate(i)
+		&& ((victim < 0) || (map[i].loadStamp < map[victim].loadStamp)))
+	    victim = i;
+    ASSERT(victim >= 0);
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FindClockVictim
+// 	Second chance: sweep the frames in a circle, starting where we
+//	left off.  A page whose use bit is set (the hardware sets it in
+//	Machine::Translate) has its bit cleared and is passed over; the
+//	first page found with the bit clear is evicted.  At worst, this
+//	takes one full turn to clear every bit, plus one frame.
+//----------------------------------------------------------------------
+
+int
+CoreMap::FindClockVictim()
+{
+    for (int n = 0; n <= 2 * numPhysPages; n++) {
+	int frame = clockHand;
+
+	clockHand = (clockHand + 1) % numPhysPages;
+	if (!IsCandidate(frame))
+	    continue;
+	if (!IsUsed(frame))
+	    return frame;
+	ClearUse(frame);
+    }
+    ASSERT(FALSE);		// every frame is pinned
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FindEnhancedClockVictim
+// 	Like the clock, but also consider the dirty bit, since evicting
+//	a dirty page costs a write to the swap file.  Going round from
+//	the hand, we take the first of, in order of preference:
+//		1. a page that is neither used nor dirty (no bits cleared);
+//		2. a page that is not used, but dirty (clearing use bits
+//		   as we go, so that the next round finds a victim).
+//	and repeat if there was none.
+//----------------------------------------------------------------------
+
+int
+CoreMap::FindEnhancedClockVictim()
+{
+    for (int round = 0; round < 2; round++) {
+	int i, frame;
+
+	for (i = 0; i < numPhysPages; i++) {	// not used, not dirty
+	    frame = (clockHand + i) % numPhysPages;
+	    if (IsCandidate(frame) && !IsUsed(frame) && !IsDirty(frame)) {
+		clockHand = (frame + 1) % numPhysPages;
+		return frame;
+	    }
+	}
+	for (i = 0; i < numPhysPages; i++) {	// not used, but dirty
+	    frame = (clockHand + i) % numPhysPages;
+	    if (!IsCandidate(frame))
+		continue;
+	    if (!IsUsed(frame)) {
+		clockHand = (frame + 1) % numPhysPages;
+		return frame;
+	    }
+	    ClearUse(frame);
+	}
+    }
+    ASSERT(FALSE);		// every frame is pinned
+    return -1;
+}
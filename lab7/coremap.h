@@ -0,0 +1,190 @@
+// coremap.h
+//	Data structures to keep track of physical memory: the core map,
+//	or inverted page table.
+//
+//	There is one entry per physical page frame, recording which
+//	address space owns it, which of that address space's virtual
+//	pages it holds, and whether it is pinned (must not be evicted,
+//	e.g., because a page is being read into it).
+//
+//	A frame holding shared code (see sharedtext.h) is owned by the
+//	SharedText rather than by any one address space.  After a Fork,
+//	a frame can also be mapped (read-only, copy-on-write) by several
+//	address spaces at the same virtual page: the owner, plus a list
+//	of sharers.
+//
+//	A frame of a shared memory segment (see shm.h) is owned by the
+//	segment, and stays pinned for as long as the segment lasts.
+//
+//	Free frames are kept on a stack, so allocating a free frame, or
+//	giving one back when an address space is deleted, is O(1).  A
+//	second stack holds free frames already zeroed, by an idle task
+//	(see Interrupt::AddIdleTask), so that a page that is to start out
+//	all zeroes -- stack or heap growth -- can be mapped without
+//	zeroing it in the page fault.
+//
+//	With the NUMA model on (see Machine::SetNUMA), a frame on the node
+//	of the CPU the faulting thread is on is taken off either stack in
+//	preference to any other, even if it is further down.
+//
+//	When no frame is free, the replacement policy picks a victim
+//	among the frames of *all* address spaces, so that a process that
+//	needs memory can take it from one that is leaving its frames idle.
+//
+//	With -pageout, a page-out daemon (see PageOut) keeps frames free
+//	ahead of the page faults that need them: when fewer than a low
+//	watermark are left, it evicts pages until there are a high
+//	watermark's worth, writing the dirty ones out PageOutCluster at a
+//	time, in as few swap file writes as their slots allow.  Evicted
+//	pages are copied out of their frames first, so the frames are
+//	free at once; a page faulted back in while its write is still
+//	going on is copied back from there (see ReclaimSwap).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef COREMAP_H
+#define COREMAP_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "machine.h"
+
+class AddrSpace;
+class SharedText;
+class SharedSegment;
+class Semaphore;
+
+#define PageOutCluster	8	// most dirty pages the page-out daemon
+				// copies out before writing them to swap
+
+// Page replacement policies, chosen at boot with -rp (see system.cc).
+// Each picks which resident page to evict when no frame is free.
+
+enum ReplacementPolicy { FIFOReplacement,	// oldest page loaded
+			 ClockReplacement,	// second chance on the use bit
+			 EnhancedClockReplacement };	// prefer clean pages too
+
+// The following class defines one of the other address spaces
+// sharing a frame with its owner, copy-on-write (see AddrSpace::Fork).
+
+class CoreMapSharer {
+  public:
+    AddrSpace *space;		// the address space sharing the frame
+    CoreMapSharer *next;	// the next one
+};
+
+// The following class defines an entry in the core map.
+
+class CoreMapEntry {
+  public:
+    AddrSpace *owner;		// address space using the frame, NULL if free
+    SharedText *text;		// or, the shared code it holds (see
+				// sharedtext.h)
+    SharedSegment *segment;	// or, the shared memory segment it is part
+				// of (see shm.h)
+    CoreMapSharer *sharers;	// other address spaces mapping the frame
+				// copy-on-write, NULL if none
+    int virtualPage;		// which of its pages is in the frame
+    bool pinned;		// if TRUE, the frame may not be evicted
+    unsigned int loadStamp;	// when the page was loaded (for FIFO)
+};
+
+// The following class defines the core map.
+
+class CoreMap {
+  public:
+    CoreMap(ReplacementPolicy replacement, int frames);
+				// all frames start out free; only the
+				// first "frames" are ever used
+    ~CoreMap();
+
+    int AllocFrame(AddrSpace *space, int virtualPage, bool *zeroed = NULL);
+				// Return a frame to hold "virtualPage" of
+				// "space", evicting a page if none is free.
+				// The frame is returned pinned.  If
+				// "zeroed" is given, a zeroed frame is
+				// taken if there is one, and *zeroed
+				// says whether it was
+    int AllocSharedFrame(SharedText *text, int virtualPage);
+				// The same, for a page of shared code
+    int AllocSegmentFrame(SharedSegment *segment, int page,
+			  bool *zeroed = NULL);
+				// The same, for a page of a shared memory
+				// segment; it is never unpinned
+    void FreeFrame(int frame);	// Give a frame back (when its page is
+				// evicted by its owner, or deleted)
+
+    void ShareFrame(int frame, AddrSpace *space);
+				// Add "space" to the address spaces
+				// mapping "frame" copy-on-write
+    bool IsShared(int frame) { return (bool)(map[frame].sharers != NULL); }
+				// is "frame" mapped by more than one
+				// address space?
+    void ReleaseFrame(int frame, AddrSpace *space);
+				// "space" no longer maps "frame"; free it
+				// if no one else does
+
+    void Pin(int frame) { map[frame].pinned = TRUE; }
+    void Unpin(int frame) { map[frame].pinned = FALSE; }
+
+    void StartPageOut();	// Fork the page-out daemon
+    void PageOut();		// What the daemon does: never returns
+    void ReadSwap(int slot, char *into);
+				// Read swap slot "slot", which may still
+				// be being written by the daemon
+    bool ReclaimSwap(int slot, char *into);
+				// If "slot" is still being written, copy
+				// it, and leave it to the daemon to free
+    void FreeSwapSlot(int slot);	// Give back a swap slot (when the
+				// daemon is done with it)
+
+    bool ZeroFreeFrame();	// Zero a free frame, and put it on the
+				// zeroed stack; FALSE if there is none
+    int NumFree() { return numFree + numZeroed; }	// number of free
+								// frames
+    int NumFrames() { return numFrames; }	// number of frames used
+    void Print();		// print the owner of each frame
+
+  private:
+    CoreMapEntry *map;			// one entry per physical frame
+    int *freeFrames;			// stack of free frames
+    int numFree;			// number of frames on the stack
+    int *zeroedFrames;			// stack of free frames known to
+    int numZeroed;			// be all zeroes, and how many
+    int numFrames;			// frames we may use (the rest of
+					// physical memory is left alone)
+    ReplacementPolicy policy;		// how to choose a victim
+    unsigned int numLoads;		// number of pages loaded so far
+    int clockHand;			// next frame the clock looks at
+
+    Semaphore *pageOutWanted;		// the daemon waits on this, if it
+					// has been started
+    bool pageOutAwake;			// ... or is already at work
+    int lowWater, highWater;		// free frames it keeps between
+    bool picking;			// the daemon is choosing victims
+    char outBuffer[PageOutCluster * PageSize];	// the pages it is
+    int outSlots[PageOutCluster];	// writing, to these slots, sorted
+    bool outFreed[PageOutCluster];	// (give the slot back when done?)
+    int numOut;				// how many
+
+    int GetFrame(bool *zeroed);	// take a free frame, or evict a page
+    int PopFrame(int *stack, int *count);
+				// take a frame off a free stack, a local
+				// one if we can
+    bool IsCandidate(int frame);	// could "frame" be evicted?
+    bool IsUsed(int frame);	// is the use bit of its page set?
+    bool IsDirty(int frame);	// is the dirty bit of its page set?
+    void ClearUse(int frame);	// clear the use bit of the page in "frame"
+    int FindVictim();		// pick a resident page to evict
+    bool AnyCandidate();	// is there a page FindVictim could pick?
+    int PickPages();		// evict a cluster for the daemon
+    void WriteCluster();	// ... and write it to swap
+    int PagingOut(int slot);	// where in the cluster "slot" is, or -1
+    int FindFIFOVictim();
+    int FindClockVictim();
+    int FindEnhancedClockVictim();
+};
+
+#endif // COREMAP_H
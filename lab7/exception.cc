@@ -57,30 +57,106 @@ void AdvancePC() {
 }
 //****************************************
 
+// What ExceptionHandler does with the PC for a system call: advance it
+// past the syscall instruction when the call returns, or before making
+// the call (for the calls that start a thread, or switch to one, which
+// must see the PC already advanced), or nothing, if the call never
+// returns.
+
+enum SyscallPC { AdvanceAfter, AdvanceBefore, NoReturn };
+
+// An entry in the system call table, which is indexed by the code.
+
+class SyscallEntry {
+  public:
+    int code;				// SC_*, its index in the table
+    const char *name;			// for the statistics
+    void (Interrupt::*handler)();	// what does it
+    SyscallPC pc;
+};
+
+static SyscallEntry syscalls[] = {
+    { SC_Halt,		"Halt",		&Interrupt::Halt,	NoReturn },
+    { SC_Exit,		"Exit",		&Interrupt::Exit,	NoReturn },
+    { SC_Exec,		"Exec",		&Interrupt::Exec,	AdvanceAfter },
+    { SC_Join,		"Join",		&Interrupt::Join,	AdvanceAfter },
+    { SC_Create,	"Create",	&Interrupt::Create,	AdvanceAfter },
+    { SC_Open,		"Open",		&Interrupt::Open,	AdvanceAfter },
+    { SC_Read,		"Read",		&Interrupt::Read,	AdvanceAfter },
+    { SC_Write,		"Write",	&Interrupt::Write,	AdvanceAfter },
+    { SC_Close,		"Close",	&Interrupt::Close,	AdvanceAfter },
+    { SC_Fork,		"Fork",		&Interrupt::Fork,	AdvanceBefore },
+    { SC_Yield,		"Yield",	&Interrupt::Yield,	AdvanceBefore },
+    { SC_ReadV,		"ReadV",	&Interrupt::ReadV,	AdvanceAfter },
+    { SC_WriteV,	"WriteV",	&Interrupt::WriteV,	AdvanceAfter },
+    { SC_Mmap,		"Mmap",		&Interrupt::Mmap,	AdvanceAfter },
+    { SC_Munmap,	"Munmap",	&Interrupt::Munmap,	AdvanceAfter },
+    { SC_ThreadCreate,	"ThreadCreate",	&Interrupt::ThreadCreate, AdvanceBefore },
+    { SC_ShmCreate,	"ShmCreate",	&Interrupt::ShmCreate,	AdvanceAfter },
+    { SC_ShmAttach,	"ShmAttach",	&Interrupt::ShmAttach,	AdvanceAfter },
+    { SC_ShmDetach,	"ShmDetach",	&Interrupt::ShmDetach,	AdvanceAfter },
+    { SC_Pipe,		"Pipe",		&Interrupt::Pipe,	AdvanceAfter },
+    { SC_RingEnter,	"RingEnter",	&Interrupt::RingEnter,	AdvanceAfter },
+    { SC_Sbrk,		"Sbrk",		&Interrupt::Sbrk,	AdvanceAfter },
+    { SC_SetAffinity,	"SetAffinity",	&Interrupt::SetAffinity, AdvanceBefore },
+    { SC_Memcpy,	"Memcpy",	&Interrupt::Memcpy,	AdvanceAfter },
+    { SC_Memset,	"Memset",	&Interrupt::Memset,	AdvanceAfter },
+};
+
+#define NumSyscallEntries	((int) (sizeof(syscalls) / sizeof(syscalls[0])))
+
+//----------------------------------------------------------------------
+// Syscall
+// 	Do the system call with code "type", through the table above, and
+//	count it, and the simulated and host time it took, in the
+//	statistics (see Statistics::PrintSyscalls).  Return FALSE if there
+//	is no such call.
+//----------------------------------------------------------------------
+
+static bool
+Syscall(int type)
+{
+    SyscallEntry *entry;
+    int ticks;
+    unsigned long long hostTime;
+
+    if (type < 0 || type >= NumSyscallEntries)
+	return FALSE;
+    entry = &syscalls[type];
+    ASSERT(entry->code == type);	// the table is out of order
+    ASSERT(type < NumSyscalls);		// ... or too big for the stats
+
+    DEBUG('a', "System call %s\n", entry->name);
+    stats->syscallName[type] = entry->name;
+    stats->syscallCount[type]++;
+    ticks = stats->totalTicks;
+    hostTime = HostNanoseconds();
+    if (entry->pc == AdvanceBefore)
+	AdvancePC();
+    (interrupt->*entry->handler)();
+    if (entry->pc == AdvanceAfter)
+	AdvancePC();
+    stats->syscallTicks[type] += stats->totalTicks - ticks;
+    stats->syscallHostTime[type] += HostNanoseconds() - hostTime;
+    return TRUE;
+}
+
 void
 ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
 
-    if (which == SyscallException) {
-	switch(type){	
-	    case SC_Halt:
-		DEBUG('a', "Shutdown, initiated by user program.\n");
-   		interrupt->Halt();
-		return;
-	    case SC_Exec:
-
-		interrupt->Exec();
-		AdvancePC();
-		return;
-	
-	}
+    if ((which == SyscallException) && Syscall(type))
+	return;
+    //缺页异常处理
+    if(which == PageFaultException){
+	interrupt->PageFault();
+    }
+    // a write to a read-only page: copy-on-write, after a Fork
+    else if(which == ReadOnlyException){
+	interrupt->ReadOnlyFault();
     }
-	//缺页异常处理
-	else if(which == PageFaultException){
-		interrupt->PageFault();
-	}
-	else{
+    else{
 	printf("Unexpected user mode exception %d %d\n", which, type);
 	ASSERT(FALSE);
     }
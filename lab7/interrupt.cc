@@ -23,26 +23,199 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "system.h"
+#include "trace.h"
+#include "syscall.h"
+#include "synchconsole.h"
+#include "shm.h"
+#include "pipe.h"
 
 // String definitions for debugging messages
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "network send", "network recv",
+			"alarm"};
 
 			
 			
+//----------------------------------------------------------------------
+// The process table
+// 	What we know about each process started by Exec, indexed by its
+//	SpaceId, for Join, and so that at Halt we can say how long each
+//	one took (its turnaround, from Exec to Exit), how often it page
+//	faulted, and how long they all took together (the makespan, from
+//	the first Exec to the last Exit).  The pages evicted, and written
+//	back, while it ran are counted too: those are for the whole
+//	machine, so they are only the process's own if it ran alone.
+//
+//	The entries are kept, in the order the processes were started,
+//	until Halt, so a process can be joined after it has exited.  A
+//	SpaceId is used again once its process has exited, though, so Join
+//	only finds the most recent process Exec'ed with a given SpaceId.
+//----------------------------------------------------------------------
+
+class Process {
+  public:
+    char name[50];		// the program
+    char args[50];		// its arguments, after argv[0]
+    int spaceID;
+    int startTicks;		// when it was Exec'ed
+    int endTicks;		// when it Exited, -1 if it hasn't
+    int numFaults;		// page faults it took
+    int numEvictions;		// pages evicted while it ran (at Exec,
+    int numWriteBacks;		// minus the totals then), and written back
+    int exitStatus;		// what it passed to Exit
+    Semaphore *exited;		// V'ed when it Exits, for Join
+    Process *next;		// the next process Exec'ed
+};
+
+static Process *processes[MaxSpaces];	// by SpaceId (cf. ProgMap),
+					// NULL if Exec didn't start it
+static Process *firstProcess = NULL;	// every one, in the order they
+static Process *lastProcess = NULL;	// were started
+static int firstExec = -1;		// when the first Exec was
+static int lastExit = -1;		// and the last Exit
+static int numExeced = 0;		// processes Exec'ed
+
+// pages evicted, and written back, so far: by page faults and by the
+// page-out daemon together
+#define EvictionsNow()	(stats->numPagesEvicted + stats->numPagesPagedOut)
+#define WriteBacksNow()	(stats->numPageWriteBacks + stats->numPageOutWrites)
+
+//----------------------------------------------------------------------
+// PrintProcesses
+// 	At Halt, print the turnaround and page faults of each process
+//	that Exec started, and the makespan of them all, with the time
+//	the CPU was idle.
+//----------------------------------------------------------------------
+
+static void
+PrintProcesses()
+{
+    if (numExeced == 0)
+	return;
+    for (Process *p = firstProcess; p != NULL; p = p->next)
+	if (p->endTicks < 0)
+	    printf("Process %d (%s%s): still running, page faults %d, "
+		   "evictions %d, writebacks %d\n", p->spaceID, p->name,
+		   p->args, p->numFaults, EvictionsNow() + p->numEvictions,
+		   WriteBacksNow() + p->numWriteBacks);
+	else
+	    printf("Process %d (%s%s): turnaround %d, page faults %d, "
+		   "evictions %d, writebacks %d, exit %d\n", p->spaceID,
+		   p->name, p->args, p->endTicks - p->startTicks,
+		   p->numFaults, p->numEvictions, p->numWriteBacks,
+		   p->exitStatus);
+    printf("Multiprogramming: %d processes, makespan %d, idle %d\n",
+	   numExeced, ((lastExit < 0) ? stats->totalTicks : lastExit)
+	   - firstExec, stats->idleTicks);
+}
+
 //****************************************
 void
 Interrupt::PageFault()
 {// The failing virtual address on an exception
 	int badVAddr= machine->ReadRegister(BadVAddrReg);
 	AddrSpace *space=currentThread->space;
+	Process *p = processes[space->getSpaceID()];
+
+	stats->numPageFaults++;
+	if ((p != NULL) && (p->endTicks < 0))	// Exec started it
+		p->numFaults++;
 	space->replacePage(badVAddr);
 }
 
+//----------------------------------------------------------------------
+// Interrupt::ReadOnlyFault
+// 	The user program wrote to a page mapped read-only.  That is how
+//	we find out that a page shared copy-on-write, after a Fork, has to
+//	be copied; a write to the program's code is a real error.
+//----------------------------------------------------------------------
+
+void
+Interrupt::ReadOnlyFault()
+{
+	int badVAddr = machine->ReadRegister(BadVAddrReg);
+
+	if (!currentThread->space->CopyOnWrite(badVAddr)) {
+		printf("Write to read-only address 0x%x\n", badVAddr);
+		ASSERT(FALSE);
+	}
+}
+
 			
-//****************************************
+//----------------------------------------------------------------------
+// ExecProcess
+// 	Where the thread running a program started by Exec begins: bring
+//	in the first pages of the program (the rest stream in), set up
+//	the registers, load the page table, and run.
+//----------------------------------------------------------------------
+
+static void
+ExecProcess(_int arg)
+{
+    currentThread->space->StartLoading();
+    currentThread->space->RestoreState();	// load page table register
+    currentThread->space->InitRegisters();	// set the initial register
+						// values, and push the
+						// arguments
+    machine->Run();			// jump to the user progam
+    ASSERT(FALSE);			// machine->Run never returns;
+					// the address space exits
+					// by doing the syscall "exit"
+}
+
+//----------------------------------------------------------------------
+// FetchArguments
+// 	Copy in the NULL-terminated array of argument strings at "addr",
+//	for Exec, each string with one CopyInString, into new strings in
+//	"args"; and return how many there are, or -1 if there are too
+//	many, or they are too long (see MaxArgSize), or can't be read.
+//	No array at all (NULL) is no arguments.
+//----------------------------------------------------------------------
+
+static int
+FetchArguments(int addr, char **args)
+{
+    char buffer[MaxArgSize];
+    int count = 0, size = 0, ptr, length;
+
+    if (addr == 0)
+	return 0;
+    for (;;) {
+	if (!machine->CopyIn(addr + count * sizeof(int), (char *) &ptr,
+			     sizeof(int)))
+	    break;
+	ptr = WordToHost(ptr);
+	if (ptr == 0)
+	    return count;
+	if (count == MaxExecArgs || size == MaxArgSize)
+	    break;
+	length = machine->CopyInString(ptr, buffer, MaxArgSize - size);
+	if (length < 0)
+	    break;
+	args[count] = new char[length + 1];
+	strcpy(args[count++], buffer);
+	size += length + 1;
+    }
+    while (count > 0)
+	delete [] args[--count];
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Exec
+// 	Exec(name, argv): start running the program in the file "name" as
+//	a new process, in a thread of its own, alongside the caller, which
+//	gets its SpaceId back (or -1, if the name or the arguments are
+//	bad).  The program's main(argc, argv) gets a copy of "argv", a
+//	NULL-terminated array of strings (which may be NULL, for none),
+//	on its stack.
+//
+//	Only the program's header is read here; its pages are read in by
+//	the new thread (see AddrSpace::StartLoading), so the caller goes
+//	on running while they are.
+//----------------------------------------------------------------------
 
 void
 Interrupt::Exec()
@@ -51,45 +224,903 @@ Interrupt::Exec()
     //read argument
     char filename[50];
     int addr=machine->ReadRegister(4);
-    int i=0;
-    do{
-       machine->ReadMem(addr+i,1,(int *)&filename[i]);//read filename from mainMemory
-    }while(filename[i++]!='\0');
+    if (machine->CopyInString(addr, filename, sizeof(filename)) < 0) {
+	printf("Exec: bad file name at 0x%x\n", addr);
+	machine->WriteRegister(2, -1);
+	return;
+    }
 
-    printf("Exec(%s):\n",filename); 
+    char **args = new char *[MaxExecArgs];
+    int argc = FetchArguments(machine->ReadRegister(5), args);
+
+    if (argc < 0) {
+	printf("Exec: bad arguments at 0x%x\n", machine->ReadRegister(5));
+	delete [] args;
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    printf("Exec(%s), %d arguments:\n", filename, argc);
 
-    
     AddrSpace *space;
 
     space = new AddrSpace(filename);
-    Thread *thread = new Thread("forked thread");
-//把当前线程送入就绪队列
-    IntStatus oldLevel = interrupt->SetLevel(IntOff);
-    scheduler->ReadyToRun(currentThread);	// ReadyToRun assumes that interrupts 
-					// are disabled!
-    (void) interrupt->SetLevel(oldLevel);  
+    space->setConsole(currentThread->space->getConsole());
+    space->InheritPipes(currentThread->space);
+    space->SetArguments(argc, args);
+    Thread *thread = new Thread("user process");
+    Process *p = new Process;
 
-    currentThread=thread;
+    strcpy(p->name, filename);
+    p->args[0] = '\0';
+    for (int i = 1; i < argc; i++)
+	if (strlen(p->args) + strlen(args[i]) + 2 <= sizeof(p->args)) {
+	    strcat(p->args, " ");
+	    strcat(p->args, args[i]);
+	}
+    p->spaceID = space->getSpaceID();
+    p->startTicks = stats->totalTicks;
+    p->endTicks = -1;
+    p->numFaults = 0;
+    p->numEvictions = -EvictionsNow();
+    p->numWriteBacks = -WriteBacksNow();
+    p->exitStatus = 0;
+    p->exited = new Semaphore("exited", 0);
+    p->next = NULL;
+    if (lastProcess == NULL)
+	firstProcess = p;
+    else
+	lastProcess->next = p;
+    lastProcess = p;
+    processes[p->spaceID] = p;
+    if (firstExec < 0)
+	firstExec = stats->totalTicks;
+    numExeced++;
 
     thread->space = space;
-
-    //delete executable;			// close file
-
-    space->InitRegisters();		// set the initial register values
-    space->RestoreState();		// load page table register
+    thread->Fork(ExecProcess, 0);
 
     //return spaceID
     machine->WriteRegister(2,space->getSpaceID());
+}
 
-    machine->Run();			// jump to the user progam
-    ASSERT(FALSE);			// machine->Run never returns;
-					// the address space exits
-					// by doing the syscall "exit"
+//----------------------------------------------------------------------
+// Interrupt::Exit
+// 	Exit(status): end the calling thread, and with it, if it was the
+//	last thread in its address space, the process.  Then the address
+//	space is deleted (giving back its frames and swap slots), and
+//	anyone waiting in Join for the process is woken up.  The exit
+//	status of the process is the one its first thread gave, not those
+//	of the threads it started with ThreadCreate.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Exit()
+{
+    AddrSpace *space = currentThread->space;
+    int id = space->getSpaceID();
+    Process *p = processes[id];
+
+    printf("Exit(%d) from space %d\n", machine->ReadRegister(4), id);
+    if ((p != NULL) && (p->endTicks < 0)	// Exec started it
+	    && !space->IsCreatedThread(currentThread))
+	p->exitStatus = machine->ReadRegister(4);
+    currentThread->space = NULL;
+    if (space->RemoveThread(currentThread))
+	currentThread->Finish();	// the others carry on
+    if ((p != NULL) && (p->endTicks < 0)) {
+	p->endTicks = lastExit = stats->totalTicks;
+	p->numEvictions += EvictionsNow();
+	p->numWriteBacks += WriteBacksNow();
+	p->exited->V();
+    }
+    delete space;
+    currentThread->Finish();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Join
+// 	Join(id): wait for the process Exec returned "id" for to Exit,
+//	and return its exit status (at once, if it already has); -1 if
+//	there is no such process.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Join()
+{
+    int id = machine->ReadRegister(4);
+    Process *p;
+
+    if ((id < 0) || (id >= MaxSpaces) || (processes[id] == NULL)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    p = processes[id];
+    if (p->endTicks < 0) {
+	p->exited->P();
+	p->exited->V();			// for anyone else joining it
+    }
+    machine->WriteRegister(2, p->exitStatus);
+}
+
+
+//----------------------------------------------------------------------
+// ForkedProcess
+// 	Where the thread running a process created by Fork starts: load
+//	the registers and page table set up for it, and run.
+//----------------------------------------------------------------------
+
+static void
+ForkedProcess(_int arg)
+{
+    currentThread->RestoreUserState();
+    currentThread->space->RestoreState();
+    machine->Run();
+    ASSERT(FALSE);			// machine->Run never returns
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Fork
+// 	The Fork system call: create a new process, running in a copy of
+//	the caller's address space.  Nothing is copied now -- the pages
+//	are shared copy-on-write (see AddrSpace::AddrSpace(AddrSpace *)),
+//	so forking and then calling Exec is cheap.
+//
+//	The child starts with the caller's registers, as of the return
+//	from the system call (the PC has already been advanced), except
+//	that Fork returns 0 to it, while the caller gets the child's
+//	SpaceId.  If the argument "func" is not zero, the child calls it
+//	instead of returning.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Fork()
+{
+    int func = machine->ReadRegister(4);
+    int pc = machine->ReadRegister(PCReg);
+    int nextPC = machine->ReadRegister(NextPCReg);
+    AddrSpace *space = new AddrSpace(currentThread->space);
+    Thread *thread = new Thread("forked process");
+
+    printf("Fork: space %d forked as %d\n",
+	   currentThread->space->getSpaceID(), space->getSpaceID());
+    thread->space = space;
+    machine->WriteRegister(2, 0);	// the child's view of it
+    if (func != 0) {
+	machine->WriteRegister(PCReg, func);
+	machine->WriteRegister(NextPCReg, func + 4);
+    }
+    thread->SaveUserState();
+    machine->WriteRegister(PCReg, pc);
+    machine->WriteRegister(NextPCReg, nextPC);
+    machine->WriteRegister(2, space->getSpaceID());
+    thread->Fork(ForkedProcess, 0);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::ThreadCreate
+// 	ThreadCreate(func, arg): start a new thread in the caller's
+//	address space, with a stack of its own there (see AddThread),
+//	which calls func(arg).  It starts at the "root" the stub in
+//	start.s passes in r6, which calls "func" -- in r5, with "arg" in
+//	r4 -- and then Exit.  The new thread shares the page table, so
+//	switching between it and the caller costs no page table switch
+//	(see Scheduler::Run).  Returns 0 to the caller, or -1 if the
+//	address space has too many threads.
+//----------------------------------------------------------------------
+
+void
+Interrupt::ThreadCreate()
+{
+    int func = machine->ReadRegister(4);
+    int arg = machine->ReadRegister(5);
+    int root = machine->ReadRegister(6);
+    int pc = machine->ReadRegister(PCReg);
+    int nextPC = machine->ReadRegister(NextPCReg);
+    int sp = machine->ReadRegister(StackReg);
+    AddrSpace *space = currentThread->space;
+    Thread *thread = new Thread("user thread");
+    int stack = space->AddThread(thread);
+
+    if (stack < 0) {
+	delete thread;
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    DEBUG('a', "ThreadCreate: 0x%x(%d) in space %d, stack at 0x%x\n",
+	  func, arg, space->getSpaceID(), stack);
+    thread->space = space;
+    machine->WriteRegister(PCReg, root);
+    machine->WriteRegister(NextPCReg, root + 4);
+    machine->WriteRegister(StackReg, stack);
+    machine->WriteRegister(4, arg);
+    machine->WriteRegister(5, func);
+    thread->SaveUserState();
+    machine->WriteRegister(PCReg, pc);
+    machine->WriteRegister(NextPCReg, nextPC);
+    machine->WriteRegister(StackReg, sp);
+    machine->WriteRegister(4, func);
+    machine->WriteRegister(5, arg);
+    machine->WriteRegister(2, 0);
+    thread->Fork(ForkedProcess, 0);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Yield
+// 	Yield(): give up the CPU to another thread that is ready to run,
+//	if there is one.  The PC has already been advanced, for when we
+//	are switched back to.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Yield()
+{
+    currentThread->Yield();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SetAffinity
+// 	SetAffinity(mask): let the caller run only on the CPUs in "mask"
+//	(all of them, if it is 0), and return the mask it had, or -1 if
+//	"mask" has none of the CPUs in it.  If the caller's CPU is not in
+//	the new mask, it yields, and the scheduler moves it to one that
+//	is.  The PC has already been advanced, for that.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SetAffinity()
+{
+    int mask = machine->ReadRegister(4);
+    int cpus = (1 << scheduler->NumCPUs()) - 1;
+    int c = currentThread->getCPU();
+
+    if (mask == 0)
+	mask = -1;
+    if ((mask & cpus) == 0) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, currentThread->getAffinity());
+    currentThread->setAffinity(mask);
+    if ((c >= 0) && !((mask >> c) & 1))
+	currentThread->Yield();
+}
+
+//----------------------------------------------------------------------
+// The file system calls
+// 	Create, Open, Read, Write and Close, and ReadV and WriteV, which
+//	read into or write from several buffers in one call, on the files
+//	in the caller's table of open files (see AddrSpace::AddFile), or
+//	on the console, for ConsoleInput and ConsoleOutput.  Names and
+//	data are moved to and from user memory with CopyIn and CopyOut,
+//	which translate each page once, not each byte; data goes through
+//	a kernel buffer of at most TransferSize bytes at a time.
+//
+//	Each puts its result in r2: 0 or -1 for Create and Close, an
+//	OpenFileId or -1 for Open, and the number of bytes moved, or -1,
+//	for the rest.
+//
+//	There can be several consoles, each a pair of UNIX files, so that
+//	several users can each have a session -- a shell, say -- of their
+//	own.  Each address space is on one of them (see getConsole), as
+//	the processes it starts are; console 0 is stdin and stdout.  Each
+//	console's keyboard is just one more file for the host to watch
+//	for input (see WatchFile), so having more of them costs nothing
+//	while they are quiet.
+//----------------------------------------------------------------------
+
+#define MaxFileNameLength	50	// including the null
+#define TransferSize		(8 * PageSize)
+#define MaxConsoles		4	// consoles, counting stdin/stdout
+
+static SynchConsole *consoles[MaxConsoles];	// each, once it is used
+static char *consoleIn[MaxConsoles];	// the UNIX files of each (NULL
+static char *consoleOut[MaxConsoles];	// for stdin and stdout)
+static int numConsoles = 1;		// console 0 is always there
+
+//----------------------------------------------------------------------
+// AddConsole
+// 	Add a console, reading the keyboard from the UNIX file "readFile",
+//	and writing the display to "writeFile", and return its number.
+//----------------------------------------------------------------------
+
+int
+AddConsole(char *readFile, char *writeFile)
+{
+    ASSERT(numConsoles < MaxConsoles);
+    consoleIn[numConsoles] = readFile;
+    consoleOut[numConsoles] = writeFile;
+    return numConsoles++;
+}
+
+//----------------------------------------------------------------------
+// TheConsole
+// 	Return the caller's console, setting it up the first time.  It is
+//	not set up until a program uses it, since from then on it waits
+//	for the keyboard, and so Nachos never runs out of things to do.
+//----------------------------------------------------------------------
+
+static SynchConsole *
+TheConsole()
+{
+    int which = currentThread->space->getConsole();
+
+    if (consoles[which] == NULL)
+	consoles[which] = new SynchConsole(consoleIn[which],
+					   consoleOut[which]);
+    return consoles[which];
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Create
+// 	Create(name): create an empty file called "name".
+//----------------------------------------------------------------------
+
+void
+Interrupt::Create()
+{
+    char name[MaxFileNameLength];
+    int addr = machine->ReadRegister(4);
+
+    if (machine->CopyInString(addr, name, sizeof(name)) < 0
+		|| !fileSystem->Create(name, 0)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    DEBUG('a', "Created file %s\n", name);
+    machine->WriteRegister(2, 0);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Open
+// 	Open(name): open the file "name", and enter it in the caller's
+//	table of open files.
+//
+//	Open, Read, Write and Close are done by DoOpen, DoRead, DoWrite
+//	and DoClose, which take their arguments and return their results
+//	as plain ints, so that RingEnter can do them too.
+//----------------------------------------------------------------------
+
+static int
+DoOpen(int addr)
+{
+    char name[MaxFileNameLength];
+    OpenFile *file;
+    int id;
+
+    if (machine->CopyInString(addr, name, sizeof(name)) < 0
+		|| (file = fileSystem->Open(name)) == NULL)
+	return -1;
+    id = currentThread->space->AddFile(file);
+    if (id < 0)
+	delete file;			// too many open
+    DEBUG('a', "Opened file %s as %d\n", name, id);
+    return id;
+}
+
+void
+Interrupt::Open()
+{
+    machine->WriteRegister(2, DoOpen(machine->ReadRegister(4)));
+}
+
+//----------------------------------------------------------------------
+// FetchVector
+// 	Copy in the user's array of "count" (address, size) pairs at
+//	"addr", for ReadV or WriteV, into "vec", two words per pair, and
+//	return the total size; or -1 if there are too many pairs, or the
+//	array can't be read, or a size is negative.  Read and Write are
+//	done as vectors of one pair, too.
+//----------------------------------------------------------------------
+
+static int
+FetchVector(int addr, int count, int *vec)
+{
+    int total = 0;
+
+    if (count < 0 || count > MaxIoVecs
+		|| !machine->CopyIn(addr, (char *) vec, count * 2 * sizeof(int)))
+	return -1;
+    for (int i = 0; i < 2 * count; i++)
+	vec[i] = WordToHost(vec[i]);
+    for (int i = 0; i < count; i++) {
+	if (vec[2 * i + 1] < 0)
+	    return -1;
+	total += vec[2 * i + 1];
+    }
+    return total;
+}
+
+//----------------------------------------------------------------------
+// CopyVector
+// 	Move "size" bytes between the kernel buffer "buffer" and the user
+//	buffers in "vec", starting "*offset" bytes into buffer "*seg", and
+//	move that position on past them.  CopyIn if "in", else CopyOut.
+//	Return FALSE if part of user memory could not be translated.
+//
+//	The buffers must hold at least "size" more bytes.
+//----------------------------------------------------------------------
+
+static bool
+CopyVector(int *vec, int *seg, int *offset, char *buffer, int size, bool in)
+{
+    while (size > 0) {
+	int addr = vec[2 * *seg] + *offset;
+	int chunk = min(size, vec[2 * *seg + 1] - *offset);
+
+	if (chunk == 0) {		// on to the next buffer
+	    (*seg)++;
+	    *offset = 0;
+	    continue;
+	}
+	if (in ? !machine->CopyIn(addr, buffer, chunk)
+	       : !machine->CopyOut(addr, buffer, chunk))
+	    return FALSE;
+	buffer += chunk;
+	size -= chunk;
+	*offset += chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ReadVector, WriteVector
+// 	Read "total" bytes from "file" (the console if NULL) into the user
+//	buffers in "vec", scattering them, or write them from the buffers,
+//	gathering them, a kernel buffer full at a time.  However many
+//	small buffers there are, the file is read or written once per
+//	TransferSize bytes.  Return how many bytes were moved.
+//
+//	Reading from the console stops at the end of a line; reading from
+//	a file stops at its end.
+//----------------------------------------------------------------------
+
+static int
+ReadVector(OpenFile *file, int *vec, int total)
+{
+    char *buffer = new char[min(total, TransferSize)];
+    int done = 0, seg = 0, offset = 0;
+    int chunk, numRead;
+
+    while (done < total) {
+	chunk = min(total - done, TransferSize);
+	if (file == NULL)
+	    numRead = TheConsole()->Read(buffer, chunk);
+	else
+	    numRead = file->Read(buffer, chunk);
+	if (numRead <= 0
+		|| !CopyVector(vec, &seg, &offset, buffer, numRead, FALSE))
+	    break;
+	done += numRead;
+	if (file == NULL || numRead < chunk)
+	    break;			// a line, or the end of the file
+    }
+    delete [] buffer;
+    return done;
+}
+
+static int
+WriteVector(OpenFile *file, int *vec, int total)
+{
+    char *buffer = new char[min(total, TransferSize)];
+    int done = 0, seg = 0, offset = 0;
+    int chunk;
+
+    while (done < total) {
+	chunk = min(total - done, TransferSize);
+	if (!CopyVector(vec, &seg, &offset, buffer, chunk, TRUE))
+	    break;
+	if (file == NULL)
+	    TheConsole()->Write(buffer, chunk);
+	else if (file->Write(buffer, chunk) < chunk)
+	    break;			// the disk is full
+	done += chunk;
+    }
+    delete [] buffer;
+    return done;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Read
+// 	Read(buffer, size, id): read up to "size" bytes into "buffer".
+//	From the console, that is a line (waiting for at least one
+//	character); from a file, all of them, unless it ends first; from
+//	a pipe, what is in it (waiting for at least one byte), straight
+//	out of its ring (see PipeBuffer::Read).
+//----------------------------------------------------------------------
+
+static int
+DoRead(int addr, int size, int id)
+{
+    int vec[2];
+    OpenFile *file = currentThread->space->GetFile(id);
+    PipeBuffer *pipe = currentThread->space->GetPipe(id, FALSE);
+
+    vec[0] = addr;
+    vec[1] = size;
+    if (pipe != NULL && size >= 0)
+	return pipe->Read(addr, size);
+    if (size < 0 || (file == NULL && id != ConsoleInput))
+	return -1;
+    return ReadVector(file, vec, size);
+}
+
+void
+Interrupt::Read()
+{
+    machine->WriteRegister(2, DoRead(machine->ReadRegister(4),
+				     machine->ReadRegister(5),
+				     machine->ReadRegister(6)));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Write
+// 	Write(buffer, size, id): write "size" bytes from "buffer".  To a
+//	pipe, that waits while the pipe is full (see PipeBuffer::Write).
+//----------------------------------------------------------------------
+
+static int
+DoWrite(int addr, int size, int id)
+{
+    int vec[2];
+    OpenFile *file = currentThread->space->GetFile(id);
+    PipeBuffer *pipe = currentThread->space->GetPipe(id, TRUE);
+
+    vec[0] = addr;
+    vec[1] = size;
+    if (pipe != NULL && size >= 0)
+	return pipe->Write(addr, size);
+    if (size < 0 || (file == NULL && id != ConsoleOutput))
+	return -1;
+    return WriteVector(file, vec, size);
+}
+
+void
+Interrupt::Write()
+{
+    machine->WriteRegister(2, DoWrite(machine->ReadRegister(4),
+				      machine->ReadRegister(5),
+				      machine->ReadRegister(6)));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::ReadV
+// 	ReadV(vec, count, id): read into the "count" buffers described by
+//	"vec", in order, as one Read of the total size would.
+//----------------------------------------------------------------------
+
+void
+Interrupt::ReadV()
+{
+    int vec[2 * MaxIoVecs];
+    int id = machine->ReadRegister(6);
+    OpenFile *file = currentThread->space->GetFile(id);
+    int total = FetchVector(machine->ReadRegister(4),
+			    machine->ReadRegister(5), vec);
+
+    if (total < 0 || (file == NULL && id != ConsoleInput)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, ReadVector(file, vec, total));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::WriteV
+// 	WriteV(vec, count, id): write the "count" buffers described by
+//	"vec", in order, as one Write of them all, pasted together, would.
+//----------------------------------------------------------------------
+
+void
+Interrupt::WriteV()
+{
+    int vec[2 * MaxIoVecs];
+    int id = machine->ReadRegister(6);
+    OpenFile *file = currentThread->space->GetFile(id);
+    int total = FetchVector(machine->ReadRegister(4),
+			    machine->ReadRegister(5), vec);
+
+    if (total < 0 || (file == NULL && id != ConsoleOutput)) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, WriteVector(file, vec, total));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Close
+// 	Close(id): take "id" out of the caller's table, and close the file
+//	-- unless it is mapped, in which case Munmap will -- or the pipe
+//	end.
+//----------------------------------------------------------------------
+
+static int
+DoClose(int id)
+{
+    OpenFile *file = currentThread->space->RemoveFile(id);
+
+    if (file == NULL)
+	return currentThread->space->ClosePipeEnd(id) ? 0 : -1;
+    if (!currentThread->space->IsMapped(file))
+	delete file;			// else Munmap closes it
+    return 0;
+}
+
+void
+Interrupt::Close()
+{
+    machine->WriteRegister(2, DoClose(machine->ReadRegister(4)));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RingEnter
+// 	RingEnter(ring): do the requests the caller has queued in the
+//	SyscallRing at "ring", in its own memory, in order, and post a
+//	completion for each -- as many as there are, or as there is room
+//	for completions -- all for one trap.  Return how many were done,
+//	or -1 if the ring can't be read or written.  See syscall.h.
+//
+//	The caller owns reqTail and doneHead, and we own reqHead and
+//	doneTail: those are all we write back, with the completions.  A
+//	request that is not an Open, Read, Write or Close completes as -1.
+//----------------------------------------------------------------------
+
+#define RingHeads	(4 * sizeof(int))	// where things are in a
+#define RingReq(i)	(RingHeads + ((unsigned) (i) % RingEntries) \
+			 * sizeof(RingRequest))		// SyscallRing
+#define RingDone(i)	(RingHeads + RingEntries * sizeof(RingRequest) \
+			 + ((unsigned) (i) % RingEntries) * sizeof(RingCompletion))
+
+void
+Interrupt::RingEnter()
+{
+    int ring = machine->ReadRegister(4);
+    int heads[4], numDone = 0;
+    int reqHead, reqTail, doneHead, doneTail;
+
+    if (!machine->CopyIn(ring, (char *) heads, sizeof(heads))) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    reqHead = WordToHost(heads[0]);
+    reqTail = WordToHost(heads[1]);
+    doneHead = WordToHost(heads[2]);
+    doneTail = WordToHost(heads[3]);
+    while ((reqHead != reqTail) && (doneTail - doneHead < RingEntries)) {
+	RingRequest req;
+	RingCompletion done;
+	int result;
+
+	if (!machine->CopyIn(ring + RingReq(reqHead),
+			     (char *) &req, sizeof(req)))
+	    break;
+	req.op = WordToHost(req.op);
+	req.arg1 = WordToHost(req.arg1);
+	req.arg2 = WordToHost(req.arg2);
+	req.arg3 = WordToHost(req.arg3);
+	switch (req.op) {
+	  case SC_Open:
+	    result = DoOpen(req.arg1);
+	    break;
+	  case SC_Read:
+	    result = DoRead(req.arg1, req.arg2, req.arg3);
+	    break;
+	  case SC_Write:
+	    result = DoWrite(req.arg1, req.arg2, req.arg3);
+	    break;
+	  case SC_Close:
+	    result = DoClose(req.arg1);
+	    break;
+	  default:
+	    result = -1;
+	    break;
+	}
+	done.tag = req.tag;		// the caller's, untouched
+	done.result = WordToMachine(result);
+	if (!machine->CopyOut(ring + RingDone(doneTail),
+			      (char *) &done, sizeof(done)))
+	    break;
+	reqHead++;
+	doneTail++;
+	numDone++;
+    }
+    DEBUG('a', "RingEnter: %d requests done\n", numDone);
+    heads[0] = WordToMachine(reqHead);
+    heads[3] = WordToMachine(doneTail);
+    if (!machine->CopyOut(ring, (char *) &heads[0], sizeof(int))
+	    || !machine->CopyOut(ring + 3 * sizeof(int), (char *) &heads[3],
+				 sizeof(int))) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, numDone);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Mmap
+// 	Mmap(id): map the whole of the file open as "id" into the caller's
+//	address space, and return the address it starts at, or -1.  The
+//	program can then use the file as memory, with no Read or Write
+//	calls: its pages are brought in by page faults, and written back
+//	to the file (see AddrSpace::Map).
+//----------------------------------------------------------------------
+
+void
+Interrupt::Mmap()
+{
+    OpenFile *file = currentThread->space->GetFile(machine->ReadRegister(4));
+
+    if (file == NULL) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, currentThread->space->Map(file));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Munmap
+// 	Munmap(addr): unmap the file Mmap mapped at "addr", writing back
+//	the pages that changed.  Returns 0, or -1 if nothing is mapped
+//	there.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Munmap()
+{
+    if (!currentThread->space->Unmap(machine->ReadRegister(4))) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, 0);
+}
+
+//----------------------------------------------------------------------
+// The shared memory calls
+// 	ShmCreate(size): make a shared memory segment of "size" bytes,
+//	and return its identifier, or -1.  ShmAttach(id): map segment
+//	"id" into the caller's address space, and return the address it
+//	starts at, or -1.  ShmDetach(addr): unmap the segment attached at
+//	"addr", returning 0, or -1 if there is none.  See shm.h.
+//----------------------------------------------------------------------
+
+void
+Interrupt::ShmCreate()
+{
+    machine->WriteRegister(2, SharedSegment::Create(machine->ReadRegister(4)));
+}
+
+void
+Interrupt::ShmAttach()
+{
+    SharedSegment *segment = SharedSegment::Find(machine->ReadRegister(4));
+
+    if (segment == NULL) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, currentThread->space->AttachSegment(segment));
+}
+
+void
+Interrupt::ShmDetach()
+{
+    if (!currentThread->space->DetachSegment(machine->ReadRegister(4))) {
+	machine->WriteRegister(2, -1);
+	return;
+    }
+    machine->WriteRegister(2, 0);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Sbrk
+// 	Sbrk(increment): move the end of the caller's heap on by
+//	"increment" bytes, and return where it was, or -1.  The memory is
+//	only allocated as it is touched (see AddrSpace::Sbrk).
+//----------------------------------------------------------------------
 
+void
+Interrupt::Sbrk()
+{
+    machine->WriteRegister(2,
+			   currentThread->space->Sbrk(machine->ReadRegister(4)));
+}
+
+//----------------------------------------------------------------------
+// ChargeMemOp
+// 	Charge the caller of Memcpy or Memset for "size" bytes of it:
+//	memOpCost ticks of system time for each 1024 (see system.h).
+//----------------------------------------------------------------------
+
+static void
+ChargeMemOp(int size)
+{
+    int count = (int) (((long long) size * memOpCost + 1023) / 1024);
+
+    if (count > 0)
+	interrupt->ManyTicks(count);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Memcpy
+// 	Memcpy(to, from, size): copy "size" bytes of the caller's memory
+//	from "from" to "to", a page at a time, with the host's memcpy,
+//	rather than by a user loop of loads and stores.  Returns 0, or -1
+//	if the ranges overlap or part of them is not a valid address.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Memcpy()
+{
+    int to = machine->ReadRegister(4);
+    int from = machine->ReadRegister(5);
+    int size = machine->ReadRegister(6);
+    int result = 0;
+
+    if (size < 0 || ((to < from + size) && (from < to + size)))
+	result = -1;
+    else if (!machine->CopyUser(to, from, size))
+	result = -1;
+    machine->WriteRegister(2, result);
+    ChargeMemOp(size);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Memset
+// 	Memset(to, c, size): set "size" bytes of the caller's memory, from
+//	"to" on, to the byte "c", a page at a time, with the host's
+//	memset.  Returns 0, or -1 if part of the range is not a valid
+//	address.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Memset()
+{
+    int to = machine->ReadRegister(4);
+    int c = machine->ReadRegister(5);
+    int size = machine->ReadRegister(6);
+    int result = 0;
 
-  
+    if (size < 0 || !machine->FillUser(to, c & 0xff, size))
+	result = -1;
+    machine->WriteRegister(2, result);
+    ChargeMemOp(size);
 }
 
+//----------------------------------------------------------------------
+// Interrupt::Pipe
+// 	Pipe(ends): make a pipe, open its read end and its write end in
+//	the caller's table, and store their ids in ends[0] and ends[1].
+//	Returns 0, or -1 if the table is full or "ends" can't be written.
+//	See pipe.h.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Pipe()
+{
+    AddrSpace *space = currentThread->space;
+    PipeBuffer *pipe = new PipeBuffer;
+    int ends[2], result = 0;
+
+    pipe->Open(FALSE);			// our own hold on it, until done
+    ends[0] = space->AddPipeEnd(pipe, FALSE);
+    ends[1] = space->AddPipeEnd(pipe, TRUE);
+    if (ends[0] < 0 || ends[1] < 0)
+	result = -1;
+    else {
+	int words[2];
+
+	words[0] = WordToMachine(ends[0]);
+	words[1] = WordToMachine(ends[1]);
+	if (!machine->CopyOut(machine->ReadRegister(4), (char *) words,
+			      sizeof(words)))
+	    result = -1;
+    }
+    if (result < 0) {
+	space->ClosePipeEnd(ends[0]);	// not an end, if it is -1
+	space->ClosePipeEnd(ends[1]);
+    }
+    pipe->Close(FALSE);			// the last hold, if it failed
+    machine->WriteRegister(2, result);
+}
 
 //******************************************
 
@@ -123,10 +1154,12 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, _int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new EventQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    tickless = FALSE;
+    numIdleTasks = nextIdleTask = 0;
 }
 
 //----------------------------------------------------------------------
@@ -137,7 +1170,7 @@ Interrupt::Interrupt()
 Interrupt::~Interrupt()
 {
     while (!pending->IsEmpty())
-	delete pending->Remove();
+	delete (PendingInterrupt *)(pending->Remove(NULL));
     delete pending;
 }
 
@@ -215,16 +1248,32 @@ Interrupt::Enable()
 //----------------------------------------------------------------------
 void
 Interrupt::OneTick()
+{
+    ManyTicks(1);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::ManyTicks
+// 	Advance simulated time by "count" ticks in one step, and then
+//	check if there are any pending interrupts to be called.  Any
+//	interrupt that became due during those ticks is called now,
+//	in the order they were scheduled to occur.
+//
+//	"count" -- the number of ticks to charge, e.g., the number of
+//		user instructions just run by the basic-block engine
+//----------------------------------------------------------------------
+void
+Interrupt::ManyTicks(int count)
 {
     MachineStatus old = status;
 
 // advance simulated time
     if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
-	stats->systemTicks += SystemTick;
+        stats->totalTicks += count * systemTick;
+	stats->systemTicks += count * systemTick;
     } else {					// USER_PROGRAM
-	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
+	stats->totalTicks += count * userTick;
+	stats->userTicks += count * userTick;
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
@@ -232,6 +1281,7 @@ Interrupt::OneTick()
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
 					// interrupts disabled)
+    CheckWatchedFiles();		// see if there is any host input
     while (CheckIfDue(FALSE))		// check for pending interrupts
 	;
     ChangeLevel(IntOff, IntOn);		// re-enable interrupts
@@ -244,6 +1294,48 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::TicksUntilDue
+// 	Return how many ticks of simulated time can go by before the
+//	earliest pending interrupt is due, i.e., how far the clock can
+//	be advanced (by SkipTicks) without having to call CheckIfDue.
+//	If nothing is pending, the answer is "a very long time".
+//
+//	Note that the answer is only good until something new is
+//	scheduled.
+//----------------------------------------------------------------------
+int
+Interrupt::TicksUntilDue()
+{
+    int when;
+
+    if (pending->Peek(&when) == NULL)
+	return 0x3fffffff;
+    if (when - stats->totalTicks <= 1)
+	return 0;
+    return when - stats->totalTicks - 1;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SkipTicks
+// 	Advance simulated time by "count" ticks, just as OneTick would,
+//	but without checking for pending interrupts.  The caller must
+//	know (from TicksUntilDue) that none can become due.
+//
+//	"count" -- the number of ticks to charge
+//----------------------------------------------------------------------
+void
+Interrupt::SkipTicks(int count)
+{
+    if (status == SystemMode) {
+        stats->totalTicks += count * systemTick;
+	stats->systemTicks += count * systemTick;
+    } else {
+	stats->totalTicks += count * userTick;
+	stats->userTicks += count * userTick;
+    }
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -270,14 +1362,20 @@ Interrupt::YieldOnReturn()
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
 //
+//	First, though, the idle tasks get the time until then (see
+//	RunIdleTasks).
+//
 //	If there are no pending interrupts, stop.  There's nothing
-//	more for us to do.
+//	more for us to do -- unless the console or the network is
+//	waiting for input, in which case we wait for it (see sysdep.cc).
 //----------------------------------------------------------------------
 void
 Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+    (void) WaitForWatchedFiles(FALSE);	// give input a moment to arrive
+    RunIdleTasks();			// and the kernel, background work
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
@@ -288,10 +1386,16 @@ Interrupt::Idle()
 					// a runnable thread
     }
 
+    // if there are no pending interrupts, wait for input from outside
+    if (WaitForWatchedFiles(TRUE)) {
+        status = SystemMode;
+	return;				// its interrupt is now pending
+    }
+
     // if there are no pending interrupts, and nothing is on the ready
     // queue, it is time to stop.   If the console or the network is 
-    // operating, there are *always* pending interrupts, so this code
-    // is not reached.  Instead, the halt must be invoked by the user program.
+    // operating, we always wait for input, so this code is not
+    // reached.  Instead, the halt must be invoked by the user program.
 
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
@@ -299,15 +1403,94 @@ Interrupt::Idle()
     Halt();
 }
 
+//----------------------------------------------------------------------
+// Interrupt::AddIdleTask
+// 	Have func(arg) called while the machine is idle (see RunIdleTasks),
+//	to do work that needn't be done straight away -- zeroing free
+//	frames, say, or writing back dirty buffers -- so that it isn't
+//	done when a page fault or a write needs it instead.
+//
+//	Each call should do a bounded slice of the work (one frame, one
+//	buffer), and return TRUE if it did any.  It is called with
+//	interrupts off, outside any thread, so it must not wait; a thread
+//	it makes ready runs after the next interrupt.
+//----------------------------------------------------------------------
+
+void
+Interrupt::AddIdleTask(IdleFunctionPtr func, _int arg)
+{
+    ASSERT(numIdleTasks < MaxIdleTasks);
+    idleTasks[numIdleTasks] = func;
+    idleArgs[numIdleTasks] = arg;
+    numIdleTasks++;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RunIdleTasks
+// 	The machine is idle: use the time until the next interrupt, which
+//	Idle would otherwise just skip, for the idle tasks.  Call them in
+//	turn, charging IdleSliceTicks of system time for each slice of
+//	work done, for as long as another slice fits before the interrupt
+//	is due, and until none of them has anything to do.  What doesn't
+//	fit is done the next time the machine is idle.
+//
+//	If the machine is about to stop, there's no point.
+//----------------------------------------------------------------------
+
+void
+Interrupt::RunIdleTasks()
+{
+    PendingInterrupt *next;
+    int when, numQuiet = 0;
+
+    if (numIdleTasks == 0)
+	return;
+    next = (PendingInterrupt *) pending->Peek(&when);
+    if (next == NULL)
+	return;				// nothing pending: about to stop
+    if ((next->type == TimerInt) && (pending->NumInQueue() == 1))
+	return;				// no more than the timer: ditto
+
+    while ((numQuiet < numIdleTasks)
+		&& (when - stats->totalTicks >= IdleSliceTicks)) {
+	int task = nextIdleTask;
+
+	nextIdleTask = (nextIdleTask + 1) % numIdleTasks;
+	if ((*idleTasks[task])(idleArgs[task])) {
+	    stats->totalTicks += IdleSliceTicks;
+	    stats->systemTicks += IdleSliceTicks;
+	    numQuiet = 0;
+	} else
+	    numQuiet++;
+    }
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Halt
 // 	Shut down Nachos cleanly, printing out performance statistics.
+//	If a user program asked for it, first finish writing what was
+//	written to the consoles (when the machine is idle, there are no
+//	threads left to wait for that).  And write back what the file
+//	system has only cached.
 //----------------------------------------------------------------------
 void
 Interrupt::Halt()
 {
+    for (int i = 0; i < numConsoles; i++)
+	if ((consoles[i] != NULL) && (status != IdleMode))
+	    consoles[i]->Flush();
+#ifdef FILESYS
+    synchDisk->Sync();			// don't lose what is only cached
+#endif
     printf("Machine halting!\n\n");
     stats->Print();
+#ifdef USER_PROGRAM
+    PrintProfiles();
+    PrintProcesses();
+    if (vmTotals != NULL)
+	vmTotals->Print("all address spaces");
+#endif
+    TraceDump();
     Cleanup();     // Never returns.
 }
 
@@ -316,7 +1499,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it on the event queue (a heap
+//	ordered by "when").
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -337,7 +1521,7 @@ Interrupt::Schedule(VoidFunctionPtr handler, _int arg, int fromNow, IntType type
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(toOccur, when);
 }
 
 //----------------------------------------------------------------------
@@ -351,7 +1535,8 @@ Interrupt::Schedule(VoidFunctionPtr handler, _int arg, int fromNow, IntType type
 //		so we should simply advance the clock to when the next 
 //		pending interrupt would occur (if any).  If the pending
 //		interrupt is just the time-slice daemon, however, then 
-//		we're done!
+//		we're done!  In tickless mode, the time-slice daemon
+//		is skipped over, straight to the next other interrupt.
 //----------------------------------------------------------------------
 bool
 Interrupt::CheckIfDue(bool advanceClock)
@@ -363,8 +1548,13 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = (PendingInterrupt *)pending->Peek(&when);
+
+    if (advanceClock && tickless && (toOccur != NULL)
+		&& (toOccur->type == TimerInt) && (pending->NumInQueue() > 1)) {
+	SkipIdleTicks();
+	toOccur = (PendingInterrupt *)pending->Peek(&when);
+    }
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
@@ -372,20 +1562,22 @@ Interrupt::CheckIfDue(bool advanceClock)
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
-	return FALSE;
+    } else if (when > stats->totalTicks) {	// not time yet, leave it
+	return FALSE;				// at the head of the queue
     }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& (pending->NumInQueue() == 1))
 	 return FALSE;
-    }
+
+    (void) pending->Remove(NULL);		// the handler may schedule
+						// more interrupts
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
+    TraceRecord(TraceInterrupt, intTypeNames[toOccur->type],
+		stats->totalTicks - toOccur->when, interruptTicks);
 #ifdef USER_PROGRAM
     if (machine != NULL)
     	machine->DelayedLoad(0, 0);
@@ -394,13 +1586,49 @@ Interrupt::CheckIfDue(bool advanceClock)
     status = SystemMode;			// whatever we were doing,
 						// we are now going to be
 						// running in the kernel
+    int start = stats->totalTicks;
+    unsigned long long hostTime = HostNanoseconds();
+
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
+    stats->totalTicks += interruptTicks;	// and pay for taking it
+    stats->systemTicks += interruptTicks;
+    stats->RecordInterrupt(toOccur->type, intTypeNames[toOccur->type],
+			   start - toOccur->when, stats->totalTicks - start,
+			   HostNanoseconds() - hostTime);
     status = old;				// restore the machine status
     inHandler = FALSE;
     delete toOccur;
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Interrupt::SkipIdleTicks
+// 	The machine is idle, and the next interrupt due is the timer's.
+//	Its handler would have nothing to preempt, so rather than taking
+//	it every timerTicks until something else happens, move it (in
+//	whole periods, so the ticks stay where they would have been) to
+//	after the next other pending interrupt.  Nothing is running, so
+//	no time slice is shortened or stretched.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SkipIdleTicks()
+{
+    PendingInterrupt *tick = (PendingInterrupt *)pending->Remove(NULL);
+    int next, skipped;
+
+    ASSERT(tick->type == TimerInt);
+    (void) pending->Peek(&next);	// the next other interrupt
+    skipped = divRoundUp(next - tick->when, timerTicks);
+    if (skipped > 0) {
+	DEBUG('i', "Idle; skipping %d timer interrupts, to time %d\n",
+	      skipped, next);
+	tick->when += skipped * timerTicks;
+	stats->numTicksSkipped += skipped;
+    }
+    pending->Insert(tick, tick->when);	// after "next", if at the same
+}					// time
+
 //----------------------------------------------------------------------
 // PrintPending
 // 	Print information about an interrupt that is scheduled to occur.
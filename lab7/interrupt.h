@@ -37,6 +37,7 @@
 
 #include "copyright.h"
 #include "list.h"
+#include "eventqueue.h"
 
 // Interrupts can be disabled (IntOff) or enabled (IntOn)
 enum IntStatus { IntOff, IntOn };
@@ -48,9 +49,10 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network.  (The kernel also schedules an
+// AlarmInt, for the alarm clock; see alarm.h.)
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				NetworkSendInt, NetworkRecvInt};
+				NetworkSendInt, NetworkRecvInt, AlarmInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -69,6 +71,15 @@ class PendingInterrupt {
     IntType type;		// for debugging
 };
 
+// An idle task: something for the kernel to do, a slice at a time,
+// when the machine would otherwise be idle (see Interrupt::AddIdleTask).
+// Returns TRUE if it did some work, FALSE if it had none to do.
+
+typedef bool (*IdleFunctionPtr)(_int arg);
+
+#define MaxIdleTasks	8		// idle tasks there can be
+#define IdleSliceTicks	SystemTick	// charged for each slice of work
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -89,16 +100,49 @@ class Interrupt {
     void Idle(); 			// The ready queue is empty, roll 
 					// simulated time forward until the 
 					// next interrupt
+    void AddIdleTask(IdleFunctionPtr func, _int arg);
+					// Have func(arg) called, a slice at
+					// a time, while the machine is idle
 
     void Halt(); 			// quit and print out stats
 //***********************************************
-    void Exec();
+    void Exec();			// run a program, as a new process
+    void Exit();			// end the caller's process
+    void Join();			// wait for a process to Exit
+    void Create();			// the file system calls, on
+    void Open();			// files in the caller's table of
+    void Read();			// open files (see AddrSpace), or
+    void Write();			// the console
+    void Close();
+    void RingEnter();			// several of those, for one trap
+    void ReadV();			// Read and Write, on several
+    void WriteV();			// buffers at once
+    void Mmap();			// map a file into the caller's
+    void Munmap();			// address space, and unmap it
+    void ShmCreate();			// make a shared memory segment,
+    void ShmAttach();			// map it into the caller's address
+    void ShmDetach();			// space, and unmap it
+    void Pipe();			// a pipe, read and written by Read
+					// and Write
+    void Sbrk();			// grow the caller's heap
+    void Fork();			// copy-on-write copy of the caller
+    void ThreadCreate();		// a new thread in the caller's space
+    void Yield();			// let another thread run
+    void SetAffinity();			// choose the CPUs the caller may
+					// run on
+    void Memcpy();			// copy or set the caller's memory,
+    void Memset();			// at host speed
 	void PageFault();
+	void ReadOnlyFault();		// a write to a read-only page
 //**************************************************
     
     void YieldOnReturn();		// cause a context switch on return 
 					// from an interrupt handler
 
+    void SetTickless(bool on) { tickless = on; }
+					// if TRUE, don't take timer
+					// interrupts while idle
+
     MachineStatus getStatus() { return status; } // idle, kernel, user
     void setStatus(MachineStatus st) { status = st; }
 
@@ -115,20 +159,38 @@ class Interrupt {
     					// by the hardware device simulators.
     
     void OneTick();       		// Advance simulated time
+    void ManyTicks(int count);		// Advance simulated time by "count"
+					// ticks at once (e.g., for a whole
+					// block of user instructions)
+    int TicksUntilDue();		// How many ticks can go by before
+					// the next interrupt is due?
+    void SkipTicks(int count);		// Advance simulated time by "count"
+					// ticks, without checking for
+					// interrupts (see TicksUntilDue)
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    EventQueue *pending;	// the interrupts scheduled to occur
+				// in the future, earliest first
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    bool tickless;		// skip timer interrupts while idle?
+
+    IdleFunctionPtr idleTasks[MaxIdleTasks];	// the idle tasks,
+    _int idleArgs[MaxIdleTasks];	// and their arguments
+    int numIdleTasks;
+    int nextIdleTask;			// the one to call next
 
     // these functions are internal to the interrupt simulation code
 
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    void RunIdleTasks();		// Do idle work until the next
+					// interrupt is due
+    void SkipIdleTicks();		// Move the timer past the next
+					// other interrupt
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
@@ -8,9 +8,22 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
+// Usage: nachos -d <debugflags> -rs <random seed #> -tickless -lockstat
+//		-trace <file>
+//		-smp <# of CPUs> -numa <nodes> <ticks>
+//		-quantum <ticks> -usertick <ticks> -systick <ticks>
+//		-intcost <ticks> -switchcost <ticks>
+//		-s -dc -bb -jit -bt -hp -prof <ticks>
+//		-l1 <size> <line> <ways> <penalty> -rp <policy> -pf <pages>
+//		-pff <interval> -frames <n> -pageout -zswap <bytes>
+//		-memcost <ticks>
+//		-mem <pages> -spt
+//		-x <nachos file> -c <consoleIn> <consoleOut>
+//		-xc <consoleIn> <consoleOut> <nachos file>
+//		-f -ds <policy> -cache <sectors> -raid <disks> -tracks <n>
+//		-mmap -ssd -lfs
+//		-diskmap <file>
+//		-cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -e <network orderability>
 //              -m <machine id>
@@ -19,15 +32,83 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -smp simulates that many CPUs, each with its own ready queue
+//    -numa splits the CPUs and memory between <nodes> NUMA nodes, charging
+//	<ticks> more for each user access to another node's memory; page
+//	faults take a free frame on the faulting CPU's node if there is one
+//    -tickless skips timer interrupts while there is nothing to run
+//    -lockstat profiles every lock, semaphore and condition, and prints
+//	those waited for longest at Halt
+//    -trace records context switches, interrupts, disk requests and
+//	exceptions, and writes them to <file> at Halt, as a Chrome trace
+//    -quantum sets the time slice (the ticks between timer interrupts)
+//    -usertick, -systick set the ticks charged per user instruction,
+//	and per re-enabling of interrupts in the kernel
+//    -intcost, -switchcost set the ticks charged for taking an
+//	interrupt, and for a context switch
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
-//    -x runs a user program
+//    -dc caches decoded user instructions instead of decoding every fetch
+//    -bb runs straight-line user code a basic block at a time
+//    -jit also compiles the blocks run most often to host code (implies -bb)
+//    -bt batches tick accounting between pending interrupts
+//    -hp runs the user code of the threads the other CPUs (-smp) would
+//	run next on host threads, alongside the running thread's, up to
+//	the next pending interrupt (needs -bt, and no -dc, -bb, -l1 or
+//	-numa; see mipspar.cc)
+//    -prof samples the PC every <ticks> of user time, and prints where
+//	each program spent its time (by procedure, if its NOFF file has
+//	symbols) at Halt
+//    -l1 models L1 instruction and data caches of <size> bytes each, with
+//	<line>-byte lines, <ways>-way associative, charging <penalty>
+//	ticks for each miss
+//    -rp selects the page replacement policy: fifo, clock (the default)
+//	or eclock (enhanced clock, which prefers clean pages)
+//    -pf on a page fault, also brings in up to this many following pages
+//	(if there are free frames)
+//    -pff page-fault-frequency control: a program that goes this many
+//	instructions without a page fault gives up the pages it hasn't
+//	used since the last one
+//    -memcost charges this many system ticks for each 1024 bytes copied
+//	or set by the Memcpy and Memset system calls (default 32)
+//    -frames runs user programs in only this many page frames of
+//	physical memory
+//    -pageout runs a page-out daemon, which keeps frames free ahead
+//	of the page faults that need them, writing dirty pages to swap
+//	in clusters
+//    -zswap keeps evicted pages, compressed, in this many bytes of
+//	host memory, in front of the swap file (see swapcache.h)
+//    -mem sets the size of physical memory, in pages (default
+//	DefaultPhysPages, see machine.h)
+//    -spt gives each address space a two-level page table, whose
+//	leaves are only allocated for the parts it uses, rather than a
+//	linear one (see pagetable.h)
+//    -x runs a user program (which may Exec others, concurrently;
+//	at Halt, the turnaround and page faults of each are printed)
+//    -xc runs a user program on a console of its own, reading the
+//	keyboard from <consoleIn> and writing the display to <consoleOut>,
+//	alongside the others (give it once for each session)
 //    -c tests the console
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -ds selects the disk scheduling policy: fifo, sstf, scan or
+//	clook (the default)
+//    -cache sets the number of sectors cached (0 turns the cache off)
+//    -raid stripes the disk across <disks> UNIX files, DISK, DISK.1,
+//	and so on, which work in parallel; use the same number every
+//	time, as it decides which sectors are where
+//    -tracks sets the size of the disk, when formatting it (with -f)
+//    -mmap maps the file holding the disk into memory, rather than
+//	reading and writing it sector by sector
+//    -ssd times the disk as flash (see disk.h), with no seek or
+//	rotation, rather than as a spinning disk
+//    -lfs gives the disk a log-structured layout, when formatting it
+//	(with -f)
+//    -diskmap writes how many times each disk sector was read or
+//	written to <file> at Halt
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
@@ -61,6 +142,8 @@
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
+extern void StartSession(char *file, int console);
+extern int AddConsole(char *readFile, char *writeFile);
 extern void MailTest(int networkID);
 extern void SynchTest(void);
 
@@ -103,6 +186,10 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-xc")) {	// ... on another console
+	    ASSERT(argc > 3);
+	    StartSession(*(argv + 3), AddConsole(*(argv + 1), *(argv + 2)));
+	    argCount = 4;
         } else if (!strcmp(*argv, "-c")) {      // test the console
 	    if (argc == 1)
 	        ConsoleTest(NULL, NULL);
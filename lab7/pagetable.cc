@@ -0,0 +1,213 @@
+// pagetable.cc
+//	Routines to manage the page table of an address space, linear or
+//	two-level.  See pagetable.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "pagetable.h"
+
+//----------------------------------------------------------------------
+// PageTable::PageTable
+// 	Make a page table for "pages" pages, none of them mapped.  A
+//	linear table has all its entries now; a two-level one starts out
+//	as just a directory, with no leaves.
+//
+//	"pages" -- the size of the address space, in pages
+//	"twoLevel" -- make a two-level table, rather than a linear one
+//----------------------------------------------------------------------
+
+PageTable::PageTable(int pages, bool twoLevel)
+{
+    ASSERT(pages > 0);
+    numPages = pages;
+    numLeaves = 0;
+    if (twoLevel) {
+	linear = NULL;
+	directorySize = divRoundUp(numPages, PageLeafSize);
+	directory = new TranslationEntry *[directorySize];
+	for (int i = 0; i < directorySize; i++)
+	    directory[i] = NULL;
+    } else {
+	linear = new TranslationEntry[numPages];
+	Clear(linear, 0, numPages);
+	directory = NULL;
+	directorySize = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// PageTable::~PageTable
+// 	De-allocate a page table, and whatever leaves it has.
+//----------------------------------------------------------------------
+
+PageTable::~PageTable()
+{
+    delete [] linear;
+    for (int i = 0; i < directorySize; i++)
+	delete [] directory[i];
+    delete [] directory;
+}
+
+//----------------------------------------------------------------------
+// PageTable::Clear
+// 	Set up "count" entries, starting at "entries", as unmapped
+//	translations of the pages starting at "first".
+//----------------------------------------------------------------------
+
+void
+PageTable::Clear(TranslationEntry *entries, int first, int count)
+{
+    for (int i = 0; i < count; i++) {
+	entries[i].virtualPage = first + i;
+	entries[i].physicalPage = -1;
+	entries[i].valid = FALSE;
+	entries[i].readOnly = FALSE;
+	entries[i].use = FALSE;
+	entries[i].dirty = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// PageTable::Entry
+// 	Return the translation of virtual page "vpn", to read or to fill
+//	in; in a two-level table, its leaf is allocated if it has none
+//	yet.  Returns NULL if "vpn" is beyond the end of the table.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+PageTable::Entry(int vpn)
+{
+    if ((vpn < 0) || (vpn >= numPages))
+	return NULL;
+    if (linear != NULL)
+	return &linear[vpn];
+
+    TranslationEntry **leaf = &directory[vpn / PageLeafSize];
+
+    if (*leaf == NULL) {
+	*leaf = new TranslationEntry[PageLeafSize];
+	Clear(*leaf, vpn - vpn % PageLeafSize, PageLeafSize);
+	numLeaves++;
+	stats->numPageTableLeaves++;
+	DEBUG('a', "Page table leaf %d allocated, %d in all\n",
+	      vpn / PageLeafSize, numLeaves);
+    }
+    return &(*leaf)[vpn % PageLeafSize];
+}
+
+//----------------------------------------------------------------------
+// PageTable::Lookup
+// 	Return the translation of virtual page "vpn", only to look at:
+//	NULL if it is beyond the end of the table, or if it has no leaf
+//	yet -- and so can't be mapped.  Use this to scan the table, so as
+//	not to allocate leaves for the holes.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+PageTable::Lookup(int vpn)
+{
+    if ((vpn < 0) || (vpn >= numPages))
+	return NULL;
+    if (linear != NULL)
+	return &linear[vpn];
+    if (directory[vpn / PageLeafSize] == NULL)
+	return NULL;
+    return &directory[vpn / PageLeafSize][vpn % PageLeafSize];
+}
+
+//----------------------------------------------------------------------
+// PageTable::IsValid
+// 	Return TRUE if virtual page "vpn" is mapped to a frame.
+//----------------------------------------------------------------------
+
+bool
+PageTable::IsValid(int vpn)
+{
+    TranslationEntry *entry = Lookup(vpn);
+
+    return (bool)((entry != NULL) && entry->valid);
+}
+
+//----------------------------------------------------------------------
+// PageTable::Grow
+// 	Make the table "newNumPages" pages long, the new pages at the end
+//	unmapped.  A linear table is copied into a bigger one; a two-level
+//	table only needs a bigger directory, if the new pages don't fit
+//	in the leaves it has room for -- the leaves themselves stay put.
+//----------------------------------------------------------------------
+
+void
+PageTable::Grow(int newNumPages)
+{
+    int oldNumPages = numPages;
+
+    ASSERT(newNumPages > numPages);
+    numPages = newNumPages;
+    if (linear != NULL) {
+	TranslationEntry *oldLinear = linear;
+
+	linear = new TranslationEntry[numPages];
+	for (int i = 0; i < oldNumPages; i++)
+	    linear[i] = oldLinear[i];
+	Clear(&linear[oldNumPages], oldNumPages, numPages - oldNumPages);
+	delete [] oldLinear;
+	return;
+    }
+    if (divRoundUp(numPages, PageLeafSize) > directorySize) {
+	TranslationEntry **oldDirectory = directory;
+	int oldSize = directorySize;
+
+	directorySize = divRoundUp(numPages, PageLeafSize);
+	directory = new TranslationEntry *[directorySize];
+	for (int i = 0; i < directorySize; i++)
+	    directory[i] = (i < oldSize) ? oldDirectory[i] : NULL;
+	delete [] oldDirectory;
+    }
+}
+
+//----------------------------------------------------------------------
+// PageTable::Discard
+// 	Free the leaves of a two-level table that lie wholly inside the
+//	"count" pages starting at "first", which have just become a hole
+//	(say, the part of the heap Sbrk gave up): none of those pages may
+//	still be mapped.  A linear table has nothing to free.
+//----------------------------------------------------------------------
+
+void
+PageTable::Discard(int first, int count)
+{
+    if (linear != NULL)
+	return;
+    for (int i = divRoundUp(first, PageLeafSize);
+	 (i + 1) * PageLeafSize <= first + count; i++) {
+	if (directory[i] == NULL)
+	    continue;
+	for (int j = 0; j < PageLeafSize; j++)
+	    ASSERT(!directory[i][j].valid);
+	delete [] directory[i];
+	directory[i] = NULL;
+	machine->FlushMicroTLB();	// it may have held on to the leaf
+	numLeaves--;
+	stats->numPageTableLeavesFreed++;
+    }
+}
+
+//----------------------------------------------------------------------
+// PageTable::Install
+// 	Tell the machine to translate through this page table, on a
+//	context switch (or after it grows, for the one running).  The
+//	machine forgets the last translations it made, through the old.
+//----------------------------------------------------------------------
+
+void
+PageTable::Install()
+{
+    machine->FlushMicroTLB();
+    machine->pageTable = linear;
+    machine->pageDirectory = directory;
+    machine->pageTableSize = numPages;
+}
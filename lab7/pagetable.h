@@ -0,0 +1,69 @@
+// pagetable.h
+//	Data structures for the page table of an address space.
+//
+//	By default, a page table is a linear array of translations, one
+//	for every page of the address space, whether it is used or not.
+//	With Sbrk and Mmap, though, an address space can be large and
+//	mostly holes -- MaxHeapSize kept for the heap, mapped files and
+//	thread stacks past that -- so with -spt each address space gets a
+//	two-level table instead (see translate.h): a directory, with a
+//	leaf of PageLeafSize translations for each part of the address
+//	space that is actually used.  A leaf is only allocated when one of
+//	its pages is first mapped, and holes need none, so the table takes
+//	kernel memory in proportion to the pages that are touched.
+//
+//	Either way, the machine walks the table itself, on every
+//	translation (see Machine::Translate).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PAGETABLE_H
+#define PAGETABLE_H
+
+#include "copyright.h"
+#include "translate.h"
+
+// The following class defines the page table of one address space.
+// Growing a linear table moves its entries, so no one should keep a
+// pointer to one across a Grow.
+
+class PageTable {
+  public:
+    PageTable(int pages, bool twoLevel);
+					// A table of "pages" pages, with
+					// nothing mapped
+    ~PageTable();			// De-allocate it, and its leaves
+
+    TranslationEntry *Entry(int vpn);	// The translation of "vpn" (its
+					// leaf allocated, if need be); NULL
+					// if out of range
+    TranslationEntry *Lookup(int vpn);	// The same, but NULL if it has no
+					// leaf (so it is invalid), rather
+					// than allocating one
+    bool IsValid(int vpn);		// Is "vpn" mapped?
+
+    void Grow(int newNumPages);		// Add pages to the end, unmapped
+    void Discard(int first, int count);	// Free the leaves lying wholly in
+					// these pages, none of them mapped
+
+    void Install();			// Make this the machine's page table
+    int NumPages() { return numPages; }
+    int NumLeaves() { return numLeaves; }
+					// Leaves allocated (0 if linear)
+
+  private:
+    int numPages;			// pages in the address space
+    TranslationEntry *linear;		// the linear table, or NULL
+    TranslationEntry **directory;	// ... or the two-level table's
+					// directory; NULL leaves map nothing
+    int directorySize;			// leaves the directory has room for
+    int numLeaves;			// ... and those allocated
+
+    void Clear(TranslationEntry *entries, int first, int count);
+					// Unmap "count" entries, for the
+					// pages starting at "first"
+};
+
+#endif // PAGETABLE_H
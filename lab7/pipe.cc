@@ -0,0 +1,145 @@
+// pipe.cc
+//	Routines to read and write pipes.  See pipe.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "pipe.h"
+
+//----------------------------------------------------------------------
+// PipeBuffer::PipeBuffer
+// 	Make an empty pipe.  Its ends are opened by Open.
+//----------------------------------------------------------------------
+
+PipeBuffer::PipeBuffer()
+{
+    head = count = 0;
+    numReaders = numWriters = 0;
+    lock = new Lock("pipe");
+    notEmpty = new Condition("pipe not empty");
+    notFull = new Condition("pipe not full");
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::~PipeBuffer
+// 	De-allocate a pipe, once no end of it is open.
+//----------------------------------------------------------------------
+
+PipeBuffer::~PipeBuffer()
+{
+    delete notEmpty;
+    delete notFull;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Open, Close
+// 	Count the ends open for reading and for writing.  When the last
+//	writer goes, readers waiting for data are woken up, to find the
+//	end of the stream; when the last reader goes, writers waiting for
+//	room are woken up, to give up.  When the last of both has gone,
+//	the pipe is deleted.
+//----------------------------------------------------------------------
+
+void
+PipeBuffer::Open(bool writing)
+{
+    lock->Acquire();
+    if (writing)
+	numWriters++;
+    else
+	numReaders++;
+    lock->Release();
+}
+
+void
+PipeBuffer::Close(bool writing)
+{
+    bool last;
+
+    lock->Acquire();
+    if (writing) {
+	ASSERT(numWriters > 0);
+	if (--numWriters == 0)
+	    notEmpty->Broadcast(lock);
+    } else {
+	ASSERT(numReaders > 0);
+	if (--numReaders == 0)
+	    notFull->Broadcast(lock);
+    }
+    last = (bool)((numReaders == 0) && (numWriters == 0));
+    lock->Release();
+    if (last)
+	delete this;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Read
+// 	Read up to "size" bytes from the pipe into user memory at "addr",
+//	for the Read system call: wait until there is at least one (or
+//	no writer left), and copy out as many as there are, in at most
+//	two pieces (the ring may wrap around).  Return how many, 0 at the
+//	end of the stream, or -1 if user memory couldn't be written.
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Read(int addr, int size)
+{
+    int n, first;
+
+    lock->Acquire();
+    while ((count == 0) && (numWriters > 0))
+	notEmpty->Wait(lock);
+    n = min(size, count);
+    first = min(n, PipeSize - head);
+    if (!machine->CopyOut(addr, &ring[head], first)
+	    || !machine->CopyOut(addr + first, ring, n - first)) {
+	lock->Release();
+	return -1;
+    }
+    head = (head + n) % PipeSize;
+    count -= n;
+    if (n > 0)
+	notFull->Broadcast(lock);
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Write
+// 	Write "size" bytes from user memory at "addr" into the pipe, for
+//	the Write system call: as many at a time as there is room for,
+//	waiting while the ring is full.  Return how many were written;
+//	fewer if every read end was closed, or user memory couldn't be
+//	read, and -1 if that happened before any were.
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Write(int addr, int size)
+{
+    int done = 0;
+
+    lock->Acquire();
+    while (done < size) {
+	int n, tail, first;
+
+	while ((count == PipeSize) && (numReaders > 0))
+	    notFull->Wait(lock);
+	if (numReaders == 0)
+	    break;			// no one will ever read it
+	n = min(size - done, PipeSize - count);
+	tail = (head + count) % PipeSize;
+	first = min(n, PipeSize - tail);
+	if (!machine->CopyIn(addr + done, &ring[tail], first)
+		|| !machine->CopyIn(addr + done + first, ring, n - first))
+	    break;
+	count += n;
+	done += n;
+	notEmpty->Broadcast(lock);
+    }
+    lock->Release();
+    return (done > 0) ? done : (size > 0) ? -1 : 0;
+}
@@ -0,0 +1,63 @@
+// pipe.h
+//	Data structures for pipes: streams of bytes from one process to
+//	another, through a ring buffer in the kernel.
+//
+//	A pipe has two ends, a read end and a write end, which are in the
+//	tables of open files of any number of address spaces (Pipe puts
+//	both in the caller's; Fork and Exec pass them on to the new
+//	process), and are read and written with Read and Write, like
+//	files.  Data is copied straight between user memory and the ring,
+//	a page at a time (see Machine::CopyIn), with no other buffer.
+//
+//	Reading waits until there is something to read, and returns what
+//	there is, up to the size asked for; once every write end is
+//	closed, and the ring is empty, it returns 0, for the end of the
+//	stream.  Writing waits while the ring is full, until all of it is
+//	written -- unless every read end is closed, when it gives up.
+//	The waits are on conditions, with a lock around the ring.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "copyright.h"
+#include "synch.h"
+
+#define PipeSize	(4 * PageSize)	// bytes a pipe holds
+
+// The following class defines a pipe (PipeBuffer, as Pipe is the system
+// call, in syscall.h).
+
+class PipeBuffer {
+  public:
+    PipeBuffer();			// An empty pipe, with no ends open
+
+    void Open(bool writing);		// Open an end (the write end if
+					// "writing")
+    void Close(bool writing);		// Close one; when both sides are
+					// all closed, the pipe goes away
+    int Read(int addr, int size);	// Read up to "size" bytes into user
+					// memory at "addr"; -1 if it isn't
+					// all there
+    int Write(int addr, int size);	// Write "size" bytes from "addr";
+					// return how many, -1 if none could be
+
+  private:
+    ~PipeBuffer();
+
+    char ring[PipeSize];		// the data, from "head" on
+    int head;				// where the next byte to read is
+    int count;				// how many bytes there are
+    int numReaders;			// ends open for reading
+    int numWriters;			// ... and writing
+    Lock *lock;				// for all of the above
+    Condition *notEmpty;		// signalled when there is data, or
+					// no writer left
+    Condition *notFull;			// signalled when there is room, or
+					// no reader left
+};
+
+#endif // PIPE_H
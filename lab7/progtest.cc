@@ -26,6 +26,7 @@ StartProcess(char *filename)
     
     space = new AddrSpace(filename);    
     currentThread->space = space;
+    space->StartLoading();		// the first pages; the rest stream in
 
     //delete executable;			// close file
 
@@ -38,6 +39,33 @@ StartProcess(char *filename)
 					// by doing the syscall "exit"
 }
 
+//----------------------------------------------------------------------
+// StartSession
+// 	Run a user program on console "console" (see AddConsole), in a
+//	thread of its own, so that the caller can go on to start others.
+//	The programs it Execs are on the same console.
+//----------------------------------------------------------------------
+
+static void
+RunSession(_int arg)
+{
+    currentThread->space->StartLoading();
+    currentThread->space->InitRegisters();
+    currentThread->space->RestoreState();
+    machine->Run();
+    ASSERT(FALSE);
+}
+
+void
+StartSession(char *filename, int console)
+{
+    Thread *thread = new Thread("session");
+
+    thread->space = new AddrSpace(filename);
+    thread->space->setConsole(console);
+    thread->Fork(RunSession, 0);
+}
+
 // Data structures needed for the console test.  Threads making
 // I/O requests wait on a Semaphore to delay until the I/O completes.
 
@@ -0,0 +1,317 @@
+// sharedtext.cc
+//	Routines to share the code pages of a program between all of the
+//	address spaces running it.  See sharedtext.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "sharedtext.h"
+#include "addrspace.h"
+#include "compressed.h"
+
+static SharedText *textCache = NULL;	// the programs being shared
+
+//----------------------------------------------------------------------
+// SwapHeader
+// 	Do little endian to big endian conversion on the bytes in the 
+//	object file header, in case the file was generated on a little
+//	endian machine, and we're now running on a big endian machine.
+//----------------------------------------------------------------------
+
+static void 
+SwapHeader (NoffHeader *noffH)
+{
+	noffH->noffMagic = WordToHost(noffH->noffMagic);
+	noffH->code.size = WordToHost(noffH->code.size);
+	noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
+	noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
+	noffH->initData.size = WordToHost(noffH->initData.size);
+	noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
+	noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
+	noffH->uninitData.size = WordToHost(noffH->uninitData.size);
+	noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
+	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
+}
+
+//----------------------------------------------------------------------
+// PagedBase
+// 	If "noffH" is the header of a paged NOFF file (see noff.h) laid
+//	out in pages of our PageSize, return where virtual address 0
+//	would be in the file, so that virtual page "p" is the PageSize
+//	bytes at PagedBase + p * PageSize.  Otherwise, return -1.
+//----------------------------------------------------------------------
+
+static int
+PagedBase(NoffHeader *noffH)
+{
+    int base = noffH->code.inFileAddr - noffH->code.virtualAddr;
+
+    if ((noffH->noffMagic != NOFFPAGEDMAGIC) || (NOFFPAGESIZE != PageSize))
+	return -1;
+    if (noffH->code.size == 0)
+	base = noffH->initData.inFileAddr - noffH->initData.virtualAddr;
+    if ((base % PageSize != 0) || ((noffH->initData.size > 0)
+	    && (noffH->initData.inFileAddr - noffH->initData.virtualAddr
+		!= base)))
+	return -1;
+    return base;
+}
+
+//----------------------------------------------------------------------
+// SharedText::Attach
+// 	Return the shared code of the program in file "filename", adding
+//	"space" to the address spaces using it.  If no one is running the
+//	program yet, we open it, read and check its NOFF header, and set
+//	up a new SharedText for it, with none of its pages resident.
+//
+//	Returns NULL if there is no file "filename".
+//
+//	"filename" -- the executable (the key for the cache)
+//	"space" -- the new user
+//----------------------------------------------------------------------
+
+SharedText *
+SharedText::Attach(char *filename, AddrSpace *space)
+{
+    SharedText *text;
+
+    for (text = textCache; text != NULL; text = text->next)
+	if (!strcmp(text->name, filename))
+	    break;
+    if (text == NULL) {
+	OpenFile *executable = fileSystem->Open(filename);
+	NoffHeader noffH;
+
+	if (executable == NULL)
+	    return NULL;
+	executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
+	if (!IsNoffMagic(noffH.noffMagic) && 
+		IsNoffMagic(WordToHost(noffH.noffMagic)))
+	    SwapHeader(&noffH);
+	ASSERT(IsNoffMagic(noffH.noffMagic));
+	text = new SharedText(filename, executable, &noffH);
+	text->next = textCache;
+	textCache = text;
+    }
+    ASSERT(text->numUsers < MaxSpaces);
+    text->users[text->numUsers++] = space;
+    DEBUG('a', "Sharing %s, with %d users\n", filename,
+	  text->numUsers);
+    return text;
+}
+
+//----------------------------------------------------------------------
+// SharedText::Detach
+// 	Remove "space" from the users of this code.  When the last user
+//	goes away, the program stays in the cache, idle, and is moved to
+//	the front; the cache is kept in order of when programs went idle,
+//	so any idle programs beyond the first MaxIdlePrograms are the
+//	ones unused the longest, and we delete them (giving their frames
+//	back, and closing them).
+//----------------------------------------------------------------------
+
+void
+SharedText::Detach(AddrSpace *space)
+{
+    int i;
+
+    for (i = 0; i < numUsers; i++)
+	if (users[i] == space)
+	    break;
+    ASSERT(i < numUsers);
+    users[i] = users[--numUsers];
+    if (numUsers > 0)
+	return;
+
+    SharedText **ptr, *text;
+    int idle = 0;
+
+    for (ptr = &textCache; *ptr != this; ptr = &(*ptr)->next)
+	;
+    *ptr = next;
+    next = textCache;
+    textCache = this;
+    for (ptr = &textCache; *ptr != NULL; ) {
+	text = *ptr;
+	if ((text->numUsers == 0) && (++idle > MaxIdlePrograms)) {
+	    DEBUG('a', "Dropping %s from the program cache\n", text->name);
+	    *ptr = text->next;
+	    delete text;
+	} else
+	    ptr = &text->next;
+    }
+}
+
+//----------------------------------------------------------------------
+// SharedText::SharedText
+// 	Set up the shared code for the program in "filename", which is the
+//	open file "file", with (checked) header "header".  Only pages
+//	that lie wholly within the code segment are shared.
+//----------------------------------------------------------------------
+
+SharedText::SharedText(char *filename, OpenFile *file, NoffHeader *header)
+{
+    Segment *code = &header->code;
+
+    name = new char[strlen(filename) + 1];
+    strcpy(name, filename);
+    executable = file;
+    noffH = *header;
+    pagedBase = PagedBase(header);
+    image = (header->noffMagic == NOFFLZMAGIC) ?
+		new CompressedImage(file) : NULL;
+    firstPage = divRoundUp(code->virtualAddr, PageSize);
+    lastPage = (code->virtualAddr + code->size) / PageSize;
+    if (lastPage < firstPage)
+	lastPage = firstPage;
+    frames = new int[lastPage - firstPage + 1];	// at least one
+    for (int i = firstPage; i < lastPage; i++)
+	frames[i - firstPage] = -1;
+    users = new AddrSpace *[MaxSpaces];
+    numUsers = 0;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// SharedText::~SharedText
+// 	Give back the frames holding the code, and close the program.
+//----------------------------------------------------------------------
+
+SharedText::~SharedText()
+{
+    for (int i = firstPage; i < lastPage; i++)
+	if (frames[i - firstPage] >= 0)
+	    coreMap->FreeFrame(frames[i - firstPage]);
+    delete [] frames;
+    delete [] users;
+    delete image;
+    delete executable;
+    delete [] name;
+}
+
+//----------------------------------------------------------------------
+// SharedText::IsShared
+// 	Return TRUE if virtual page "vpn" is one of the shared code pages.
+//----------------------------------------------------------------------
+
+bool
+SharedText::IsShared(int vpn)
+{
+    return (bool)((vpn >= firstPage) && (vpn < lastPage));
+}
+
+//----------------------------------------------------------------------
+// SharedText::Fault
+// 	Return the frame holding shared page "vpn", for an address space
+//	that faulted on it.  If some other user already brought it in,
+//	there is nothing to read; otherwise we get a frame from the core
+//	map and read the page from the executable.
+//
+//	"readIn" -- if not NULL, set to whether the page had to be read
+//----------------------------------------------------------------------
+
+int
+SharedText::Fault(int vpn, bool *readIn)
+{
+    int *frame = &frames[vpn - firstPage];
+
+    ASSERT(IsShared(vpn));
+    if (readIn != NULL)
+	*readIn = (bool)(*frame < 0);
+    if (*frame < 0) {
+	int f = coreMap->AllocSharedFrame(this, vpn);
+
+	if (!ReadPage(vpn, &(machine->mainMemory[f * PageSize])))
+	    executable->ReadAt(&(machine->mainMemory[f * PageSize]), PageSize,
+		noffH.code.inFileAddr
+		    + (vpn * PageSize - noffH.code.virtualAddr));
+	machine->InvalidateDecodeCache(f * PageSize, PageSize);
+	coreMap->Unpin(f);
+	*frame = f;
+    } else
+	DEBUG('a', "Page %d of %s is already in frame %d\n", vpn, name,
+	      *frame);
+    return *frame;
+}
+
+//----------------------------------------------------------------------
+// SharedText::ReadPage
+// 	Read virtual page "vpn" of the program's code and data into the
+//	PageSize bytes at "memory", if the executable lets us do it with
+//	a single read: if it is compressed, by decompressing the page,
+//	and if it is paged, by reading the page as it is.  Return FALSE,
+//	having read nothing, if it is neither.
+//----------------------------------------------------------------------
+
+bool
+SharedText::ReadPage(int vpn, char *memory)
+{
+    if (image != NULL) {
+	if (vpn < image->NumPages())
+	    image->ReadPage(vpn, memory);
+	else				// past the code and data
+	    bzero(memory, PageSize);
+	return TRUE;
+    }
+    if (pagedBase >= 0) {
+	executable->ReadAt(memory, PageSize, pagedBase + vpn * PageSize);
+	return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// SharedText::IsUsed
+// 	Return TRUE if the use bit of shared page "vpn" is set in any of
+//	the address spaces that have it mapped.
+//----------------------------------------------------------------------
+
+bool
+SharedText::IsUsed(int vpn)
+{
+    for (int i = 0; i < numUsers; i++) {
+	TranslationEntry *entry = users[i]->PageTableEntry(vpn);
+
+	if (entry->valid && entry->use)
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// SharedText::ClearUse
+// 	Clear the use bit of shared page "vpn" in every user (telling
+//	each user that had it set, as CoreMap::ClearUse does).
+//----------------------------------------------------------------------
+
+void
+SharedText::ClearUse(int vpn)
+{
+    for (int i = 0; i < numUsers; i++) {
+	TranslationEntry *entry = users[i]->PageTableEntry(vpn);
+
+	if (entry->valid && entry->use) {
+	    users[i]->PageUsed(vpn);
+	    entry->use = FALSE;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// SharedText::Evict
+// 	The core map is taking the frame holding shared page "vpn" away.
+//	Code is never dirty, so all we do is unmap it from every user;
+//	the next user to touch it reads it in again.
+//----------------------------------------------------------------------
+
+void
+SharedText::Evict(int vpn)
+{
+    for (int i = 0; i < numUsers; i++)
+	if (users[i]->PageTableEntry(vpn)->valid)
+	    users[i]->Evict(vpn);
+    frames[vpn - firstPage] = -1;
+}
@@ -0,0 +1,103 @@
+// sharedtext.h
+//	Data structures for sharing the code of a program between all
+//	of the address spaces that are running it.
+//
+//	Code is never written, so every process started (through Exec)
+//	from the same executable can map the very same frames, read-only.
+//	A SharedText keeps track of which of those frames are resident,
+//	and of the address spaces using them; it is found by file name,
+//	and created by the first address space to run the program.
+//
+//	Only pages that hold nothing but code are shared; a page that
+//	also holds some data (or bss) is private to each address space.
+//
+//	Shared frames are in the core map like any other, and can be
+//	evicted; since they are never dirty, that just means unmapping
+//	them from every user.
+//
+//	The SharedText also caches the program itself: the open file, and
+//	its NOFF header, already checked and byte-swapped.  So starting
+//	the program again while some address space is still running it
+//	needs no directory lookup and no header I/O, and all the users
+//	read their pages through the one open file.  When the last user
+//	goes away we keep the program cached (with whatever code pages are
+//	still resident, which the core map can take back like any other),
+//	so that running it again -- from the shell, say -- is cheap too;
+//	only the MaxIdlePrograms most recently used idle programs are kept.
+//
+//	If the program is paged or compressed (see noff.h), each page of
+//	it can be read by itself (see ReadPage); of a compressed program,
+//	we keep the page index too.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SHAREDTEXT_H
+#define SHAREDTEXT_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "machine.h"
+#include "noff.h"
+
+class AddrSpace;
+class OpenFile;
+class CompressedImage;
+
+#define MaxIdlePrograms	4	// programs no one is running, kept cached
+
+// The following class defines the shared code segment of a program.
+
+class SharedText {
+  public:
+    static SharedText *Attach(char *filename, AddrSpace *space);
+				// Find (or create) the shared code for the
+				// program "filename", and add "space" to
+				// its users; NULL if there is no such file
+    void Detach(AddrSpace *space);
+				// Remove "space" from the users; once the
+				// last one goes away, the program is idle
+
+    bool IsShared(int vpn);	// is virtual page "vpn" a shared one?
+    int Fault(int vpn, bool *readIn = NULL);
+				// return the frame holding "vpn", reading
+				// it in if it is not resident (and then
+				// setting *readIn)
+
+// Routines used by the core map, for frames holding shared code
+    bool IsUsed(int vpn);	// has any user touched "vpn" lately?
+    void ClearUse(int vpn);	// clear the use bit in every user
+    void Evict(int vpn);	// unmap "vpn" from every user
+
+    char *getName() { return name; }
+    OpenFile *getExecutable() { return executable; }
+    NoffHeader *getHeader() { return &noffH; }
+    bool ReadPage(int vpn, char *memory);
+				// read page "vpn" of the code and data into
+				// "memory" with one read; FALSE if the file
+				// is neither paged nor compressed
+
+  private:
+    SharedText(char *filename, OpenFile *file, NoffHeader *header);
+    ~SharedText();
+
+    char *name;			// the program's file name (the cache key)
+    OpenFile *executable;	// the program, open while it is shared
+    NoffHeader noffH;		// where its segments are, in memory and
+				// the file
+    int pagedBase;		// where virtual address 0 is in a paged
+				// executable; -1 if it isn't
+    CompressedImage *image;	// page index of a compressed executable,
+				// or NULL
+    int firstPage;		// shared pages are [firstPage, lastPage)
+    int lastPage;
+    int *frames;		// frame holding each shared page, or -1
+    AddrSpace **users;		// the address spaces sharing it (at
+				// most MaxSpaces)
+    int numUsers;
+
+    SharedText *next;		// next program in the cache
+};
+
+#endif // SHAREDTEXT_H
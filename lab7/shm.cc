@@ -0,0 +1,107 @@
+// shm.cc
+//	Routines to manage shared memory segments.  See shm.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "shm.h"
+
+static SharedSegment *segments[MaxSegments];	// by identifier, NULL if
+						// free
+
+//----------------------------------------------------------------------
+// SharedSegment::Create
+// 	Make a shared memory segment of "size" bytes, for ShmCreate, and
+//	return its identifier: the lowest free one.  Return -1 if there
+//	are MaxSegments already, or if it would take more than half of
+//	the frames: since a segment's frames stay pinned, the rest are all
+//	that the processes have to page in.
+//----------------------------------------------------------------------
+
+int
+SharedSegment::Create(int size)
+{
+    int numPages = divRoundUp(size, PageSize);
+
+    if ((size <= 0) || (numPages > coreMap->NumFrames() / 2))
+	return -1;
+    for (int id = 0; id < MaxSegments; id++)
+	if (segments[id] == NULL) {
+	    segments[id] = new SharedSegment(id, numPages);
+	    return id;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// SharedSegment::Find
+// 	Return segment "id", for ShmAttach; NULL if there is none.
+//----------------------------------------------------------------------
+
+SharedSegment *
+SharedSegment::Find(int id)
+{
+    if ((id < 0) || (id >= MaxSegments))
+	return NULL;
+    return segments[id];
+}
+
+//----------------------------------------------------------------------
+// SharedSegment::SharedSegment
+// 	Make segment "which", of "pages" pages: take a frame from the core
+//	map for each (evicting other pages, if need be), and zero it.  The
+//	frames stay pinned.
+//----------------------------------------------------------------------
+
+SharedSegment::SharedSegment(int which, int pages)
+{
+    id = which;
+    numPages = pages;
+    numAttached = 0;
+    frames = new int[numPages];
+    for (int page = 0; page < numPages; page++) {
+	bool zeroed;
+
+	frames[page] = coreMap->AllocSegmentFrame(this, page, &zeroed);
+	if (!zeroed)
+	    bzero(&(machine->mainMemory[frames[page] * PageSize]), PageSize);
+	machine->InvalidateDecodeCache(frames[page] * PageSize, PageSize);
+    }
+    DEBUG('a', "Shared memory segment %d: %d pages\n", id, numPages);
+}
+
+//----------------------------------------------------------------------
+// SharedSegment::~SharedSegment
+// 	Give the frames back to the core map, and free our identifier.
+//----------------------------------------------------------------------
+
+SharedSegment::~SharedSegment()
+{
+    for (int page = 0; page < numPages; page++)
+	coreMap->FreeFrame(frames[page]);
+    delete [] frames;
+    segments[id] = NULL;
+}
+
+//----------------------------------------------------------------------
+// SharedSegment::Attach, Detach
+// 	Count the address spaces mapping the segment; when the last of
+//	them detaches, the segment goes away.
+//----------------------------------------------------------------------
+
+void
+SharedSegment::Attach()
+{
+    numAttached++;
+}
+
+void
+SharedSegment::Detach()
+{
+    ASSERT(numAttached > 0);
+    if (--numAttached == 0)
+	delete this;
+}
@@ -0,0 +1,60 @@
+// shm.h
+//	Data structures for shared memory segments: memory that several
+//	address spaces map at once, so that user processes can exchange
+//	data with loads and stores, without the kernel copying anything
+//	(as it does for Read and Write).
+//
+//	A segment is made by ShmCreate, which gets it its frames from the
+//	core map at once, zeroed; every address space that attaches it
+//	(ShmAttach) maps those very frames, read-write.  The frames are
+//	pinned for as long as the segment lasts: they are never evicted,
+//	so the page tables of all the users stay right without the core
+//	map having to find them.  (So a segment may use at most half of
+//	the frames.)
+//
+//	A segment is known by its identifier, a small integer, which the
+//	processes sharing it must agree on -- say, by the one that made it
+//	passing it on in a file, or just by making the first one, 0.  It
+//	lasts until the last address space attached to it detaches (or
+//	exits).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SHM_H
+#define SHM_H
+
+#include "copyright.h"
+
+#define MaxSegments	8	// shared memory segments at once
+
+// The following class defines a shared memory segment.
+
+class SharedSegment {
+  public:
+    static int Create(int size);	// Make a segment of "size" bytes;
+					// return its identifier, -1 if
+					// there is no room
+    static SharedSegment *Find(int id);	// The segment "id", NULL if none
+
+    void Attach();			// An address space has mapped us
+    void Detach();			// ... and no longer does; the last
+					// to go deletes us
+
+    int getID() { return id; }
+    int NumPages() { return numPages; }
+    int Frame(int page) { return frames[page]; }
+					// the frame holding "page" of us
+
+  private:
+    SharedSegment(int which, int pages);
+    ~SharedSegment();
+
+    int id;				// our index in the table of segments
+    int numPages;			// how big we are
+    int *frames;			// the frame holding each page
+    int numAttached;			// address spaces mapping us
+};
+
+#endif // SHM_H
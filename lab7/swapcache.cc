@@ -0,0 +1,175 @@
+// swapcache.cc
+//	Routines to keep evicted pages, compressed, in host memory, in
+//	front of the swap file.  See swapcache.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "swapcache.h"
+#include "compressed.h"
+
+//----------------------------------------------------------------------
+// SwapCache::SwapCache
+// 	Initialize an empty pool.
+//
+//	"bytes" -- how many bytes of compressed pages it can hold
+//	"slots" -- the swap slots there are
+//----------------------------------------------------------------------
+
+SwapCache::SwapCache(int bytes, int slots)
+{
+    ASSERT(bytes > 0);
+    size = bytes;
+    numSlots = slots;
+    used = 0;
+    data = new char *[numSlots];
+    length = new int[numSlots];
+    newer = new int[numSlots];
+    older = new int[numSlots];
+    for (int i = 0; i < numSlots; i++)
+	data[i] = NULL;
+    newest = oldest = -1;
+}
+
+SwapCache::~SwapCache()
+{
+    for (int i = 0; i < numSlots; i++)
+	delete [] data[i];
+    delete [] data;
+    delete [] length;
+    delete [] newer;
+    delete [] older;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Put
+// 	A dirty page is being evicted to swap slot "slot": compress it,
+//	and keep it, writing the oldest pages out to make room if need be.
+//	Return FALSE, keeping nothing, if it doesn't compress well enough
+//	to be worth it; the caller writes it to the swap file instead.
+//
+//	"page" -- the PageSize bytes of the page
+//----------------------------------------------------------------------
+
+bool
+SwapCache::Put(int slot, char *page)
+{
+    char buffer[PageSize + PageSize / 8 + 1];
+    int n = CompressPage(page, buffer);
+
+    ASSERT((slot >= 0) && (slot < numSlots) && (data[slot] == NULL));
+    if ((n > SwapCacheMaxSize) || (n > size)) {
+	stats->numSwapCacheRejects++;
+	return FALSE;
+    }
+    while (used + n > size)
+	WriteOldest();
+    data[slot] = new char[n];
+    bcopy(buffer, data[slot], n);
+    length[slot] = n;
+    used += n;
+    newer[slot] = -1;			// it goes on the new end
+    older[slot] = newest;
+    if (newest >= 0)
+	newer[newest] = slot;
+    else
+	oldest = slot;
+    newest = slot;
+    stats->numSwapCacheStores++;
+    stats->swapCacheBytesIn += PageSize;
+    stats->swapCacheBytesOut += n;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Take
+// 	A page is being faulted in from swap slot "slot".  If we have it,
+//	decompress it into "into", forget it, and return TRUE: the caller
+//	then has the only up-to-date copy, and must treat the page as
+//	dirty.  Otherwise, return FALSE, and the caller reads the swap
+//	file.
+//----------------------------------------------------------------------
+
+bool
+SwapCache::Take(int slot, char *into)
+{
+    if (!Read(slot, into)) {
+	stats->numSwapCacheMisses++;
+	return FALSE;
+    }
+    Unlink(slot);
+    stats->numSwapCacheHits++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Read
+// 	Decompress the page for swap slot "slot" into "into", and return
+//	TRUE; or FALSE, if we don't have it.  We keep it, either way.
+//----------------------------------------------------------------------
+
+bool
+SwapCache::Read(int slot, char *into)
+{
+    if (data[slot] == NULL)
+	return FALSE;
+    DecompressPage(data[slot], length[slot], into);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Drop
+// 	Swap slot "slot" is being freed: forget its page, if we have it.
+//----------------------------------------------------------------------
+
+void
+SwapCache::Drop(int slot)
+{
+    if (data[slot] != NULL)
+	Unlink(slot);
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Unlink
+// 	Take the page for swap slot "slot" out of the pool, and out of
+//	the list of pages in the order they came in.
+//----------------------------------------------------------------------
+
+void
+SwapCache::Unlink(int slot)
+{
+    if (newer[slot] >= 0)
+	older[newer[slot]] = older[slot];
+    else
+	newest = older[slot];
+    if (older[slot] >= 0)
+	newer[older[slot]] = newer[slot];
+    else
+	oldest = newer[slot];
+    used -= length[slot];
+    delete [] data[slot];
+    data[slot] = NULL;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::WriteOldest
+// 	Make room, by writing the page that has been here longest to its
+//	swap slot, and forgetting it.  It is taken out of the pool before
+//	the write, which may let other threads run.
+//----------------------------------------------------------------------
+
+void
+SwapCache::WriteOldest()
+{
+    char page[PageSize];
+    int slot = oldest;
+
+    ASSERT(slot >= 0);
+    DecompressPage(data[slot], length[slot], page);
+    Unlink(slot);
+    swapFile->WriteAt(page, PageSize, slot * PageSize);
+    stats->numSwapCacheWrites++;
+}
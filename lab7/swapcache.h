@@ -0,0 +1,66 @@
+// swapcache.h
+//	Data structures for the compressed swap cache: a pool of host
+//	memory, in front of the swap file, that evicted pages are
+//	compressed into instead of being written out.
+//
+//	When a dirty page is evicted, it is compressed (as coff2noff
+//	compresses executables, see noff.h) and kept in the pool, under
+//	its swap slot; a fault on it is served by decompressing it, with
+//	no disk I/O at all.  Once the pool is full, the pages that went
+//	in longest ago are decompressed and written to their slots, to
+//	make room.  A page that doesn't compress to at most
+//	SwapCacheMaxSize bytes isn't worth keeping, and goes straight to
+//	the swap file, as it would without the cache.
+//
+//	The pool holds the only copy of a page, and gives it up when the
+//	page is faulted back in, so that the page is then dirty: the copy
+//	in its slot, if any, is out of date.
+//
+//	Compressing and decompressing cost host time, but no simulated
+//	time, as reading a compressed executable doesn't.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAPCACHE_H
+#define SWAPCACHE_H
+
+#include "copyright.h"
+
+#define SwapCacheMaxSize	(PageSize * 3 / 4)
+					// the most a compressed page may
+					// take, to be kept
+
+// The following class defines the pool, with room for "size" bytes of
+// compressed pages, for swap slots 0 to numSlots - 1.
+
+class SwapCache {
+  public:
+    SwapCache(int bytes, int slots);	// an empty pool
+    ~SwapCache();
+
+    bool Put(int slot, char *page);	// compress "page", on its way to
+					// swap slot "slot", into the pool;
+					// FALSE if it must be written out
+    bool Take(int slot, char *into);	// decompress the page for "slot"
+					// into "into", and drop it; FALSE
+					// if it isn't here
+    bool Read(int slot, char *into);	// the same, keeping it here
+    void Drop(int slot);		// forget "slot"'s page, if we have
+					// it (the slot is being freed)
+
+  private:
+    int size;				// bytes the pool can hold
+    int used;				// ... and holds now
+    int numSlots;
+    char **data;			// each slot's compressed page, or
+    int *length;			// NULL; and how long it is
+    int *newer, *older;			// the slots we have, in the order
+    int newest, oldest;			// they came in (-1 ends the list)
+
+    void Unlink(int slot);		// take "slot" out of the pool
+    void WriteOldest();			// write the oldest page to swap
+};
+
+#endif // SWAPCACHE_H
@@ -7,6 +7,11 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "trace.h"
+#ifdef USER_PROGRAM
+#include "addrspace.h"
+#include "swapcache.h"
+#endif
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -18,6 +23,7 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+Alarm *alarmClock;			// threads waiting for a time
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -30,8 +36,17 @@ SynchDisk   *synchDisk;
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
 //**********************
-BitMap *freeMM_map;
-bool ProgMap[NumPhysPages];       //to set pid
+CoreMap *coreMap;
+VMCounts *vmTotals;
+int faultAroundPages = 0;	// no prefetching unless asked for
+int pffInterval = 0;		// no working set control unless asked for
+int memOpCost = 32;		// a little over a user tick a word
+bool twoLevelPageTables = FALSE;	// linear page tables unless asked for
+bool ProgMap[MaxSpaces];       //to set pid
+BitMap *swapMap;
+OpenFile *swapFile;
+static char SwapFileName[] = "SWAP";	// the file swapFile is
+SwapCache *swapCache;
 #endif
 
 #ifdef NETWORK
@@ -63,6 +78,7 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(_int dummy)
 {
+    alarmClock->Tick();
     if (interrupt->getStatus() != IdleMode)
 	interrupt->YieldOnReturn();
 }
@@ -83,13 +99,37 @@ Initialize(int argc, char **argv)
     int argCount;
     char* debugArgs = "";
     bool randomYield = FALSE;
+    bool tickless = FALSE;	// no timer interrupts while idle
+    bool lockStats = FALSE;	// profile lock contention
+    int numCPUs = 1;		// simulated processors
+    int numNodes = 1;		// NUMA nodes they and memory are on
+    int remoteTicks = 0;	// extra ticks for a remote memory access
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool cacheDecoded = FALSE;	// keep decoded user instructions
+    bool runBlocks = FALSE;	// run user code a basic block at a time
+    bool jit = FALSE;		// compile hot blocks to host code
+    bool batchTicks = FALSE;	// only check interrupts when one is due
+    bool parallel = FALSE;	// run other CPUs' user code on host threads
+    ReplacementPolicy replacementPolicy = ClockReplacement;
+    int memoryFrames = 0;	// physical page frames to use (0: all)
+    bool pageOut = FALSE;	// run the page-out daemon
+    int swapCacheSize = 0;	// bytes of compressed swap cache (0: none)
+    int profileTicks = 0;	// user ticks between PC samples (0: none)
+    int l1Size = 0;		// bytes in each L1 cache (0: no cache model),
+    int l1Line = 0, l1Ways = 0;	// their shape,
+    int l1Penalty = 0;		// and the ticks a miss costs
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    DiskSchedulingPolicy diskPolicy = CLOOKDiskScheduling;
+    int cacheSize = DefaultCacheSize;	// sectors in the sector cache
+    int numDisks = 1;			// disks striped together
+    char *diskMap = NULL;	// where to write the disk heatmap
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     double order = 1;           // network orderability
@@ -111,15 +151,163 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-smp")) {
+	    ASSERT(argc > 1);
+	    numCPUs = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-numa")) {
+	    ASSERT(argc > 2);
+	    numNodes = atoi(*(argv + 1));	// see Machine::SetNUMA
+	    ASSERT(numNodes > 0);
+	    remoteTicks = atoi(*(argv + 2));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-tickless"))
+	    tickless = TRUE;
+	else if (!strcmp(*argv, "-lockstat"))
+	    lockStats = TRUE;
+	else if (!strcmp(*argv, "-trace")) {
+	    ASSERT(argc > 1);
+	    TraceInit(*(argv + 1));		// see trace.cc
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-quantum")) {
+	    ASSERT(argc > 1);
+	    timerTicks = atoi(*(argv + 1));
+	    ASSERT(timerTicks > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-usertick")) {
+	    ASSERT(argc > 1);
+	    userTick = atoi(*(argv + 1));
+	    ASSERT(userTick > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-systick")) {
+	    ASSERT(argc > 1);
+	    systemTick = atoi(*(argv + 1));
+	    ASSERT(systemTick > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-intcost")) {
+	    ASSERT(argc > 1);
+	    interruptTicks = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-switchcost")) {
+	    ASSERT(argc > 1);
+	    switchTicks = atoi(*(argv + 1));
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	if (!strcmp(*argv, "-dc"))
+	    cacheDecoded = TRUE;
+	if (!strcmp(*argv, "-bb"))
+	    runBlocks = TRUE;
+	if (!strcmp(*argv, "-jit"))
+	    runBlocks = jit = TRUE;
+	if (!strcmp(*argv, "-bt"))
+	    batchTicks = TRUE;
+	if (!strcmp(*argv, "-hp"))
+	    parallel = TRUE;			// see mipspar.cc
+	if (!strcmp(*argv, "-prof")) {
+	    ASSERT(argc > 1);
+	    profileTicks = atoi(*(argv + 1));	// see profile.h
+	    ASSERT(profileTicks > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-l1")) {
+	    ASSERT(argc > 4);
+	    l1Size = atoi(*(argv + 1));		// see memcache.h
+	    l1Line = atoi(*(argv + 2));
+	    l1Ways = atoi(*(argv + 3));
+	    l1Penalty = atoi(*(argv + 4));
+	    argCount = 5;
+	} else if (!strcmp(*argv, "-pf")) {
+	    ASSERT(argc > 1);
+	    faultAroundPages = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pff")) {
+	    ASSERT(argc > 1);
+	    pffInterval = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-memcost")) {
+	    ASSERT(argc > 1);
+	    memOpCost = atoi(*(argv + 1));
+	    ASSERT(memOpCost >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-rp")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fifo"))
+		replacementPolicy = FIFOReplacement;
+	    else if (!strcmp(*(argv + 1), "clock"))
+		replacementPolicy = ClockReplacement;
+	    else if (!strcmp(*(argv + 1), "eclock"))
+		replacementPolicy = EnhancedClockReplacement;
+	    else
+		printf("Unknown replacement policy %s, using clock\n",
+		       *(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-frames")) {
+	    ASSERT(argc > 1);
+	    memoryFrames = atoi(*(argv + 1));	// see CoreMap::CoreMap
+	    ASSERT(memoryFrames > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-mem")) {
+	    ASSERT(argc > 1);
+	    numPhysPages = atoi(*(argv + 1));	// see machine.h
+	    ASSERT(numPhysPages > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pageout"))
+	    pageOut = TRUE;
+	else if (!strcmp(*argv, "-zswap")) {
+	    ASSERT(argc > 1);
+	    swapCacheSize = atoi(*(argv + 1));	// see swapcache.h
+	    ASSERT(swapCacheSize > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-spt"))
+	    twoLevelPageTables = TRUE;		// see pagetable.h
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-ds")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fifo"))
+		diskPolicy = FIFODiskScheduling;
+	    else if (!strcmp(*(argv + 1), "sstf"))
+		diskPolicy = SSTFDiskScheduling;
+	    else if (!strcmp(*(argv + 1), "scan"))
+		diskPolicy = SCANDiskScheduling;
+	    else if (!strcmp(*(argv + 1), "clook"))
+		diskPolicy = CLOOKDiskScheduling;
+	    else
+		printf("Unknown disk scheduling policy %s, using clook\n",
+		       *(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cache")) {
+	    ASSERT(argc > 1);
+	    cacheSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-raid")) {
+	    ASSERT(argc > 1);
+	    numDisks = atoi(*(argv + 1));	// see SynchDisk::SynchDisk
+	    ASSERT((numDisks > 0) && (numDisks <= MaxDisks));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tracks")) {
+	    ASSERT(argc > 1);
+	    numTracks = atoi(*(argv + 1));	// see Disk::Disk
+	    ASSERT(numTracks > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-diskmap")) {
+	    ASSERT(argc > 1);
+	    diskMap = *(argv + 1);		// see Statistics::PrintDisk
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-mmap"))
+	    mapDisk = TRUE;			// see Disk::Disk
+	else if (!strcmp(*argv, "-ssd"))
+	    diskModel = FlashDisk;		// see Disk::RunLatency
+	else if (!strcmp(*argv, "-lfs"))
+	    logStructured = TRUE;		// see FileSystem::FileSystem
+
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-n")) {
 	    ASSERT(argc > 1);
@@ -139,10 +327,15 @@ Initialize(int argc, char **argv)
 
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
+    stats->lockStats = lockStats;
     interrupt = new Interrupt;			// start up interrupt handling
+    interrupt->SetTickless(tickless);
     scheduler = new Scheduler();		// initialize the ready queue
+    scheduler->SetCPUs(numCPUs);
+    scheduler->SetNodes(numNodes);
     if (randomYield)				// start the timer (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
+    alarmClock = new Alarm();
 
     threadToBeDestroyed = NULL;
 
@@ -156,21 +349,49 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, cacheDecoded, runBlocks,
+							batchTicks, 0, 0);	// this must come first
+    machine->SetProfiling(profileTicks);
+    if (jit)
+	machine->EnableJIT();
+    if (l1Size > 0)
+	machine->SetCaches(l1Size, l1Line, l1Ways, l1Penalty);
+    machine->SetNUMA(numNodes, remoteTicks);
+    if (parallel && !machine->SetParallel()) {
+	printf("Usage: -hp, with -smp <CPUs> of at least 2 and -bt, and "
+	       "no -dc, -bb, -l1 or -numa\n");
+	Exit(1);
+    }
 //*******************************************************************************
-    freeMM_map = new BitMap(NumPhysPages);
+    coreMap = new CoreMap(replacementPolicy,
+			  (memoryFrames > 0) ? memoryFrames : numPhysPages);
+    vmTotals = new VMCounts;
     
-    bzero(ProgMap,NumPhysPages);    //0
+    bzero(ProgMap,MaxSpaces);    //0
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    stats->diskMapFile = diskMap;
+    synchDisk = new SynchDisk("DISK", numDisks);
+    synchDisk->SetPolicy(diskPolicy);
+    synchDisk->SetCacheSize(cacheSize);
 #endif
 
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
 
+#ifdef USER_PROGRAM
+    swapMap = new BitMap(NumSwapSlots);		// needs the file system
+    fileSystem->Create(SwapFileName, NumSwapSlots * PageSize);
+    swapFile = fileSystem->Open(SwapFileName);
+    ASSERT(swapFile != NULL);
+    if (swapCacheSize > 0)
+	swapCache = new SwapCache(swapCacheSize, NumSwapSlots);
+    if (pageOut)
+	coreMap->StartPageOut();
+#endif
+
 #ifdef NETWORK
     postOffice = new PostOffice(netname, rely, order, 10);
 #endif
@@ -191,7 +412,12 @@ Cleanup()
 #ifdef USER_PROGRAM
     delete machine;
 //****************************************
-    delete freeMM_map;
+    delete coreMap;
+    delete vmTotals;
+    delete swapCache;
+    delete swapFile;
+    fileSystem->Remove(SwapFileName);
+    delete swapMap;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -15,6 +15,7 @@
 #include "interrupt.h"
 #include "stats.h"
 #include "timer.h"
+#include "alarm.h"
 
 // Initialization and cleanup routines
 extern void Initialize(int argc, char **argv); 	// Initialization,
@@ -28,14 +29,39 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
+extern Alarm *alarmClock;			// the kernel's, on top of it
 
 #ifdef USER_PROGRAM
 #include "machine.h"
 extern Machine* machine;	// user program memory and registers
 //********************************
 #include "bitmap.h"
-extern BitMap *freeMM_map;
-extern bool ProgMap[NumPhysPages];//max 32
+#include "coremap.h"
+extern CoreMap *coreMap;	// who owns each physical page frame
+class VMCounts;
+extern VMCounts *vmTotals;	// the paging of every address space
+				// deleted so far (see addrspace.h)
+extern int faultAroundPages;	// how many pages to prefetch on a fault
+extern int pffInterval;		// page-fault-frequency interval, in
+				// instructions; 0 for none
+extern int memOpCost;		// system ticks charged for each 1024
+				// bytes of a Memcpy or Memset
+extern bool twoLevelPageTables;	// give address spaces two-level page
+				// tables, for sparse address spaces
+#define MaxSpaces	32	// address spaces there can be at once
+extern bool ProgMap[MaxSpaces];//max 32
+
+// Backing store for demand paging: a single swap file, shared by all
+// address spaces, divided into page-sized slots.  (Its name,
+// SwapFileName, is in system.cc.)
+#define NumSwapSlots	1024
+
+class OpenFile;
+extern BitMap *swapMap;		// which swap slots are in use
+extern OpenFile *swapFile;	// the swap file, open while Nachos runs
+class SwapCache;
+extern SwapCache *swapCache;	// compressed pages in front of it, NULL
+				// if none (see swapcache.h)
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
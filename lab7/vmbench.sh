@@ -0,0 +1,45 @@
+#!/bin/sh
+# vmbench.sh
+#	Compare the page replacement policies: run ../test/vmdrive.noff
+#	(which runs vmstress with each of its access patterns in turn)
+#	under each policy, in a few page frames, and tabulate what the
+#	kernel prints for each run at Halt.  Run by "make vmbench".
+#
+#	One line is printed per run, with fields separated by tabs (the
+#	first line names them):
+#
+#	    policy	the replacement policy (-rp)
+#	    run		vmstress's arguments: the pattern and its sizes
+#	    faults	page faults the run took
+#	    evictions	pages evicted while it ran
+#	    writebacks	dirty pages written back while it ran
+#	    ticks	its turnaround, from Exec to Exit
+#
+#	usage: vmbench.sh [nachos [frames [policy ...]]]
+#
+# Copyright (c) 1992-1993 The Regents of the University of California.
+# All rights reserved.  See copyright.h for copyright notice and limitation
+# of liability and disclaimer of warranty provisions.
+
+nachos=${1:-./nachos}
+frames=${2:-24}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] && shift
+policies=${*:-"fifo clock eclock"}
+status=0
+
+printf "policy\trun\tfaults\tevictions\twritebacks\tticks\n"
+for policy in $policies; do
+    out=`$nachos -rp $policy -frames $frames -x ../test/vmdrive.noff \
+	    </dev/null 2>&1 \
+	| sed -n 's/^Process [0-9]* ([^ ]*vmstress[^ ]* \(.*\)): turnaround \([0-9]*\), page faults \([0-9]*\), evictions \([0-9]*\), writebacks \([0-9]*\), exit 0$/\1	\3	\4	\5	\2/p'`
+    if [ -z "$out" ]; then
+	echo "vmbench: no run finished under $policy" >&2
+	status=1
+	continue
+    fi
+    echo "$out" | while read line; do
+	printf "%s\t%s\n" $policy "$line"
+    done
+done
+exit $status
@@ -22,6 +22,8 @@ static void ConsoleReadPoll(_int c)
 { Console *console = (Console *)c; console->CheckCharAvail(); }
 static void ConsoleWriteDone(_int c)
 { Console *console = (Console *)c; console->WriteDone(); }
+static void ConsoleInputReady(_int c)
+{ interrupt->Schedule(ConsoleReadPoll, c, ConsoleTime, ConsoleReadInt); }
 
 //----------------------------------------------------------------------
 // Console::Console
@@ -55,8 +57,8 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
     putBusy = FALSE;
     incoming = EOF;
 
-    // start polling for incoming packets
-    interrupt->Schedule(ConsoleReadPoll, (_int)this, ConsoleTime, ConsoleReadInt);
+    // poll for incoming characters once there are some (see sysdep.cc)
+    WatchFile(readFileNo, ConsoleInputReady, (_int)this);
 }
 
 //----------------------------------------------------------------------
@@ -66,6 +68,7 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
 
 Console::~Console()
 {
+    UnwatchFile(readFileNo);
     if (readFileNo != 0)
 	Close(readFileNo);
     if (writeFileNo != 1)
@@ -74,13 +77,14 @@ Console::~Console()
 
 //----------------------------------------------------------------------
 // Console::CheckCharAvail()
-// 	Periodically called to check if a character is available for
-//	input from the simulated keyboard (eg, has it been typed?).
+// 	Called to check if a character is available for input from the
+//	simulated keyboard (eg, has it been typed?), once the input file
+//	has something in it (see sysdep.cc).
 //
 //	Only read it in if there is buffer space for it (if the previous
-//	character has been grabbed out of the buffer by the Nachos kernel).
-//	Invoke the "read" interrupt handler, once the character has been 
-//	put into the buffer. 
+//	character has been grabbed out of the buffer by the Nachos kernel);
+//	otherwise, try again later.  Invoke the "read" interrupt handler,
+//	once the character has been put into the buffer. 
 //----------------------------------------------------------------------
 
 void
@@ -88,19 +92,22 @@ Console::CheckCharAvail()
 {
     char c;
 
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(ConsoleReadPoll, (_int)this, ConsoleTime, 
-			ConsoleReadInt);
-
-    // do nothing if character is already buffered, or none to be read
-    if ((incoming != EOF) || !PollFile(readFileNo))
-	return;	  
-
-    // otherwise, read character and tell user about it
-    Read(readFileNo, &c, sizeof(char));
-    incoming = c ;
-    stats->numConsoleCharsRead++;
-    (*readHandler)(handlerArg);	
+    // if a character is already buffered, poll again later
+    if (incoming != EOF) {
+	interrupt->Schedule(ConsoleReadPoll, (_int)this, ConsoleTime, 
+			    ConsoleReadInt);
+	return;
+    }
+
+    // otherwise, read character (if there still is one) and tell user
+    // about it, and then wait for the next
+    if (PollFile(readFileNo)) {
+	Read(readFileNo, &c, sizeof(char));
+	incoming = c ;
+	stats->numConsoleCharsRead++;
+	(*readHandler)(handlerArg);	
+    }
+    WatchFile(readFileNo, ConsoleInputReady, (_int)this);
 }
 
 //----------------------------------------------------------------------
@@ -114,7 +121,7 @@ void
 Console::WriteDone()
 {
     putBusy = FALSE;
-    stats->numConsoleCharsWritten++;
+    stats->numConsoleCharsWritten += putCount;
     (*writeHandler)(handlerArg);
 }
 
@@ -145,6 +152,25 @@ Console::PutChar(char ch)
     ASSERT(putBusy == FALSE);
     WriteFile(writeFileNo, &ch, sizeof(char));
     putBusy = TRUE;
+    putCount = 1;
     interrupt->Schedule(ConsoleWriteDone, (_int)this, ConsoleTime,
 					ConsoleWriteInt);
 }
+
+//----------------------------------------------------------------------
+// Console::PutChars()
+// 	Write "count" characters to the simulated display, with a single
+//	host write, and schedule an interrupt for when the last of them
+//	would have been put on the display, one at a time.
+//----------------------------------------------------------------------
+
+void
+Console::PutChars(char *from, int count)
+{
+    ASSERT((putBusy == FALSE) && (count > 0));
+    WriteFile(writeFileNo, from, count);
+    putBusy = TRUE;
+    putCount = count;
+    interrupt->Schedule(ConsoleWriteDone, (_int)this, count * ConsoleTime,
+					ConsoleWriteInt);
+}
@@ -16,6 +16,7 @@
 #include "copyright.h"
 #include "disk.h"
 #include "system.h"
+#include "trace.h"
 
 // We put this at the front of the UNIX file representing the
 // disk, to make it less likely we will accidentally treat a useful file 
@@ -25,6 +26,10 @@
 
 #define DiskSize 	(MagicSize + (NumSectors * SectorSize)) //128Kֽ
 
+int numTracks = 0;
+bool mapDisk = FALSE;
+DiskModel diskModel = RotationalDisk;
+
 // dummy procedure because we can't take a pointer of a member function
 static void DiskDone(_int arg) { ((Disk *)arg)->HandleInterrupt(); } //cppֻһԱָһָ࣬
 
@@ -34,6 +39,15 @@ static void DiskDone(_int arg) { ((Disk *)arg)->HandleInterrupt(); } //cppֻ
 //	if it doesn't exist), and check the magic number to make sure it's 
 // 	ok to treat it as Nachos disk storage.
 //
+//	The size of the disk is set when it is formatted, with -tracks
+//	(or else it is NumTracks); after that, it is how big the UNIX file
+//	is.  A disk can be made bigger by formatting it with more tracks,
+//	but not smaller: for that, remove the file.
+//
+//	If mapDisk is set, we then map the UNIX file into memory, so that
+//	a request is just a copy, rather than a system call or two; the
+//	simulated time it takes is the same.
+//
 //	"name" -- text name of the file simulating the Nachos disk
 //	"callWhenDone" -- interrupt handler to be called when disk read/write
 //	   request completes
@@ -45,7 +59,8 @@ Disk::Disk(const char* name, VoidFunctionPtr callWhenDone, _int callArg)
     int magicNum;
     int tmp = 0;
 
-    DEBUG('d', "Initializing the disk, 0x%x 0x%x\n", callWhenDone, callArg); 
+    DEBUG('d', "Initializing the disk, 0x%lx 0x%lx\n", (long) callWhenDone,
+	  (long) callArg);
     handler = callWhenDone; //жϴ
     handlerArg = callArg; //handlerĲ
     lastSector = 0;
@@ -55,7 +70,18 @@ Disk::Disk(const char* name, VoidFunctionPtr callWhenDone, _int callArg)
     if (fileno >= 0) {		 	// file exists, check magic number 
 	Read(fileno, (char *) &magicNum, MagicSize);
 	ASSERT(magicNum == MagicNumber);
+	Lseek(fileno, 0, 2);		// to the end, to find the size
+	int fileTracks = (Tell(fileno) - MagicSize)
+				/ (SectorSize * SectorsPerTrack);
+	if (numTracks <= fileTracks)
+	    numTracks = fileTracks;
+	else {				// grow it
+	    Lseek(fileno, DiskSize - sizeof(int), 0);
+	    WriteFile(fileno, (char *)&tmp, sizeof(int));
+	}
     } else {				// file doesn't exist, create it
+	if (numTracks == 0)
+	    numTracks = NumTracks;
         fileno = OpenForWrite((char*)name);
 	magicNum = MagicNumber;  
 	WriteFile(fileno, (char *) &magicNum, MagicSize); // write magic number
@@ -64,7 +90,11 @@ Disk::Disk(const char* name, VoidFunctionPtr callWhenDone, _int callArg)
         Lseek(fileno, DiskSize - sizeof(int), 0);	 //DiskSize-4
 	WriteFile(fileno, (char *)&tmp, sizeof(int));   //дDiskӳ
     }
+    image = NULL;
+    if (mapDisk)
+	image = MapFile(fileno, DiskSize);
     active = FALSE;
+    stats->CountSectors(NumSectors);
 }
 
 //----------------------------------------------------------------------
@@ -75,9 +105,25 @@ Disk::Disk(const char* name, VoidFunctionPtr callWhenDone, _int callArg)
 
 Disk::~Disk()
 {
+    if (image != NULL)
+	UnmapFile(image, DiskSize);
     Close(fileno);
 }
 
+//----------------------------------------------------------------------
+// Disk::Flush()
+// 	Make sure the UNIX file holds everything written to the disk so
+//	far.  Writes go straight to the file, unless it is mapped into
+//	memory; then we have to ask for the mapped pages to be written.
+//----------------------------------------------------------------------
+
+void
+Disk::Flush()
+{
+    if (image != NULL)
+	SyncMappedFile(image, DiskSize);
+}
+
 //----------------------------------------------------------------------
 // Disk::PrintSector()
 // 	Dump the data in a disk read/write request, for debugging.
@@ -115,40 +161,103 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)  
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE); //ӵǰŵĿʱ
-
-    ASSERT(!active);				// only one request at a time 
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors)); //ǷںϷΧ֮
-    
-    DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0); //0128*0+41128*1+4
-    Read(fileno, data, SectorSize);
-    if (DebugIsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
-    
-    active = TRUE;  //õǰæ״̬
-    UpdateLast(sectorNumber);
-    stats->numDiskReads++;
-    interrupt->Schedule(DiskDone, (_int) this, ticks, DiskInt); //ticksʱжϣ̲ɣDiskDoneжϴ
+    Transfer(sectorNumber, 1, &data, FALSE);
 }
 
 void
 Disk::WriteRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    Transfer(sectorNumber, 1, &data, TRUE);
+}
 
-    ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+//----------------------------------------------------------------------
+// Disk::ReadSectors/WriteSectors
+// 	Simulate a request to read/write a run of "count" consecutive
+//	disk sectors, starting at "firstSector".  The whole run is read or
+//	written to the UNIX file at once, and there is just one interrupt,
+//	when the last sector is done.
+//
+//	"firstSector" -- the first disk sector to read/write
+//	"count" -- how many sectors
+//	"data" -- data[i] is the buffer for sector firstSector + i
+//----------------------------------------------------------------------
+
+void
+Disk::ReadSectors(int firstSector, int count, char** data)
+{
+    Transfer(firstSector, count, data, FALSE);
+}
+
+void
+Disk::WriteSectors(int firstSector, int count, char** data)
+{
+    Transfer(firstSector, count, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// Disk::Transfer
+// 	Do a read or write request, for a run of "count" sectors starting
+//	at "firstSector":
+//	   Do the read/write immediately to the UNIX file
+//	   Set up an interrupt handler to be called later,
+//	      that will notify the caller when the simulator says
+//	      the operation has completed.
+//
+//	Note that a disk only allows an entire sector to be read/written,
+//	not part of a sector.
+//----------------------------------------------------------------------
+
+void
+Disk::Transfer(int firstSector, int count, char** data, bool writing)
+{
+    int trackStart, rotation;
+    bool bufferHit;
+    int ticks = RunLatency(firstSector, count, writing, &trackStart,
+			   &rotation, &bufferHit);
+    int i;
+
+    ASSERT(!active);				// only one request at a time 
+    ASSERT((firstSector >= 0) && (count > 0)
+		&& (firstSector + count <= NumSectors));
     
-    DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG('d', "%s %d sectors from sector %d\n",
+	  writing ? "Writing" : "Reading", count, firstSector);
+    TraceRecord(TraceDisk, writing ? "disk write" : "disk read", firstSector,
+		ticks);
+    if (image != NULL) {
+	char *sector = &image[SectorSize * firstSector + MagicSize];
+
+	for (i = 0; i < count; i++, sector += SectorSize)
+	    if (writing)
+		bcopy(data[i], sector, SectorSize);
+	    else
+		bcopy(sector, data[i], SectorSize);
+    } else if (writing)
+	WriteVector(fileno, data, count, SectorSize,
+		    SectorSize * firstSector + MagicSize);
+    else
+	ReadVector(fileno, data, count, SectorSize,
+		   SectorSize * firstSector + MagicSize);
     if (DebugIsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (i = 0; i < count; i++)
+	    PrintSector(writing, firstSector + i, data[i]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
-    stats->numDiskWrites++;
+    stats->RecordDiskAccess(firstSector, count,
+			    (diskModel == FlashDisk) ? 0 :
+				abs(firstSector / SectorsPerTrack
+				    - lastSector / SectorsPerTrack),
+			    rotation, bufferHit);
+    UpdateLast(firstSector);
+    if (count > 1) {			// the head went on from there
+	if (trackStart >= 0)
+	    bufferInit = trackStart;
+	lastSector = firstSector + count - 1;
+    }
+    if (writing)
+	stats->numDiskWrites += count;
+    else
+	stats->numDiskReads += count;
     interrupt->Schedule(DiskDone, (_int) this, ticks, DiskInt);
 }
 
@@ -227,31 +336,120 @@ Disk::ModuloDiff(int to, int from) //Ѱ
 //   	read requests to the current track to be satisfied more quickly.
 //   	The contents of the track buffer are discarded after every seek to 
 //   	a new track.
+//
+//	If "rotationDelay" is not NULL, it is set to the rotational
+//	latency, and if "bufferHit" is not NULL, to whether the track
+//	buffer held the sector.
 //----------------------------------------------------------------------
 
 int
-Disk::ComputeLatency(int newSector, bool writing) //Ѱ
+Disk::ComputeLatency(int newSector, bool writing, int *rotationDelay,
+		     bool *bufferHit) //Ѱ
 {
     int rotation;
     int seek = TimeToSeek(newSector, &rotation);
     int timeAfter = stats->totalTicks + seek + rotation;
 
+    if (rotationDelay != NULL)
+	*rotationDelay = 0;
+    if (bufferHit != NULL)
+	*bufferHit = FALSE;
+
 #ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
     // check if track buffer applies
     if ((writing == FALSE) && (seek == 0) 
 		&& (((timeAfter - bufferInit) / RotationTime) 
 	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
         DEBUG('d', "Request latency = %d\n", RotationTime);
+	if (bufferHit != NULL)
+	    *bufferHit = TRUE;
 	return RotationTime; // time to transfer sector from the track buffer
     }
 #endif
 
     rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+    if (rotationDelay != NULL)
+	*rotationDelay = rotation;
 
     DEBUG('d', "Request latency = %d\n", seek + rotation + RotationTime);
     return(seek + rotation + RotationTime);
 }
 
+//----------------------------------------------------------------------
+// Disk::RunLatency
+// 	Return how long it will take to read/write "count" consecutive
+//	sectors, starting at "firstSector".  The first sector takes as
+//	long as ComputeLatency says; each one after it on the same track
+//	is the very next to rotate past the head, so it takes just
+//	RotationTime more.  Going on to the next track means a seek of
+//	one track, and waiting for its first sector to come around.
+//
+//	If the run goes on to other tracks, "trackStart" is set to when
+//	the head got to the last one (and the track buffer started being
+//	loaded); otherwise it is set to -1.  "rotation" and "bufferHit"
+//	are set as ComputeLatency sets them, for the first sector.
+//----------------------------------------------------------------------
+
+int
+Disk::RunLatency(int firstSector, int count, bool writing, int *trackStart,
+		 int *rotation, bool *bufferHit)
+{
+    if (diskModel == FlashDisk) {
+	*trackStart = -1;
+	*rotation = 0;
+	*bufferHit = FALSE;
+	return FlashLatency(firstSector, count, writing);
+    }
+
+    int ticks = ComputeLatency(firstSector, writing, rotation, bufferHit);
+
+    *trackStart = -1;
+    for (int sector = firstSector + 1; sector < firstSector + count; sector++) {
+	if ((sector % SectorsPerTrack) != 0) {
+	    ticks += RotationTime;
+	    continue;
+	}
+	int arrive = stats->totalTicks + ticks + SeekTime;
+	int over = arrive % RotationTime;
+
+	if (over > 0)			// round up to the next full sector
+	    arrive += RotationTime - over;
+	*trackStart = arrive;
+	ticks = arrive - stats->totalTicks
+		+ ModuloDiff(sector, arrive / RotationTime) * RotationTime
+		+ RotationTime;
+    }
+    DEBUG('d', "Run latency = %d\n", ticks);
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// Disk::FlashLatency
+// 	Return how long it will take flash to read/write "count"
+//	consecutive sectors, starting at "firstSector".  The channels
+//	are all idle (a request only comes once the last one is done),
+//	and each takes the sectors of the run that are on it one after
+//	another; the request is done when the busiest channel is.
+//----------------------------------------------------------------------
+
+int
+Disk::FlashLatency(int firstSector, int count, bool writing)
+{
+    int busy[FlashChannels];
+    int ticks = 0;
+
+    for (int i = 0; i < FlashChannels; i++)
+	busy[i] = 0;
+    for (int sector = firstSector; sector < firstSector + count; sector++) {
+	int *channel = &busy[sector % FlashChannels];
+
+	*channel += writing ? FlashProgramTime : FlashReadTime;
+	ticks = max(ticks, *channel);
+    }
+    DEBUG('d', "Flash latency = %d\n", ticks);
+    return ticks;
+}
+
 //----------------------------------------------------------------------
 // Disk::UpdateLast
 //   	Keep track of the most recently requested sector.  So we can know
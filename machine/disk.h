@@ -1,6 +1,7 @@
 // disk.h 
 //	Data structures to emulate a physical disk.  A physical disk
-//	can accept (one at a time) requests to read/write a disk sector;
+//	can accept (one at a time) requests to read/write a disk sector,
+//	or a run of consecutive sectors;
 //	when the request is satisfied, the CPU gets an interrupt, and 
 //	the next request can be sent to the disk.
 //
@@ -45,13 +46,37 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// All that is for a spinning disk.  With -ssd, the disk is modeled as
+// flash instead: there is no seek and no rotation, so where a sector
+// is doesn't matter, but programming (writing) a sector takes longer
+// than reading it.  The sectors are spread over FlashChannels channels
+// (sector s on channel s % FlashChannels), each of which works on one
+// sector at a time, but all at once: so a run of sectors takes about
+// 1/FlashChannels as long as the same number one at a time.
 
 #define SectorSize 		128	// number of bytes per disk sector
 #define SectorsPerTrack 	32	// number of sectors per disk track 
-#define NumTracks 		32	// number of tracks per disk
-#define NumSectors 		(SectorsPerTrack * NumTracks)
+#define NumTracks 		32	// number of tracks on a new disk,
+					// unless -tracks says otherwise
+#define NumSectors 		(SectorsPerTrack * numTracks)
 					// total # of sectors per disk
 
+#define FlashReadTime		100	// ticks for flash to read a sector
+#define FlashProgramTime	600	// ... and to program one
+#define FlashChannels		4	// channels working in parallel
+
+// How the time a request takes is modeled.
+
+enum DiskModel { RotationalDisk,	// seek, rotation, track buffer
+		 FlashDisk };		// constant read and program times
+
+extern int numTracks;		// tracks on this disk: 0 until the Disk
+				// is opened (or as -tracks set it), then
+				// from the size of the disk file
+extern bool mapDisk;		// map the disk file into memory (-mmap)?
+extern DiskModel diskModel;	// spinning disk or flash (-ssd)?
+
 class Disk {
   public:
     Disk(const char* name, VoidFunctionPtr callWhenDone, _int callArg);
@@ -66,17 +91,33 @@ class Disk {
     					// the disk and return immediately.
     					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
+    void ReadSectors(int firstSector, int count, char** data);
+    void WriteSectors(int firstSector, int count, char** data);
+					// The same, for "count" consecutive
+					// sectors, starting at firstSector;
+					// data[i] is the buffer for sector
+					// firstSector + i.  Only one
+					// interrupt, at the end of the run.
 
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
 
-    int ComputeLatency(int newSector, bool writing);	 //Ѱӳ
+    void Flush();			// Make sure every request done so far
+					// is in the UNIX file
+
+    int ComputeLatency(int newSector, bool writing, int *rotationDelay = NULL,
+		       bool *bufferHit = NULL);	 //Ѱӳ
     					// Return how long a request to 
 					// newSector will take: 
-					// (seek + rotational delay + transfer)
+					// (seek + rotational delay + transfer),
+					// and, if asked, the rotational
+					// delay, and if the track buffer
+					// has the sector
 
   private:
     int fileno;				// UNIX file number for simulated disk 
+    char *image;			// The UNIX file mapped into memory,
+					// or NULL (see mapDisk)
     VoidFunctionPtr handler;		// Interrupt handler, to be invoked 
 					// when any disk request finishes
     _int handlerArg;			// Argument to interrupt handler 
@@ -85,6 +126,13 @@ class Disk {
     int bufferInit;			// When the track buffer started  Ѱ
 					// being loaded
 
+    void Transfer(int firstSector, int count, char** data, bool writing);
+    int RunLatency(int firstSector, int count, bool writing,
+		   int *trackStart, int *rotation, bool *bufferHit);
+					// how long a run takes, and when
+					// it gets to its last track
+    int FlashLatency(int firstSector, int count, bool writing);
+					// ... if the disk is flash
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track  Ѱ
     int ModuloDiff(int to, int from);        // # sectors between to and fromѰ
     void UpdateLast(int newSector); //Ѱ
@@ -0,0 +1,199 @@
+// eventqueue.cc
+//	Routines to manage the queue of future hardware events, as a
+//	binary min-heap stored in an array.
+//
+//	The array doubles in size whenever it fills up, so there is no
+//	fixed limit on the number of outstanding events.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "eventqueue.h"
+
+#define InitialQueueSize 16	// initial number of heap slots
+
+//----------------------------------------------------------------------
+// EventQueue::EventQueue
+//	Initialize an event queue, empty to start with.
+//----------------------------------------------------------------------
+
+EventQueue::EventQueue()
+{
+    numAllocated = InitialQueueSize;
+    heap = new EventQueueEntry[numAllocated];
+    numInQueue = 0;
+    nextSeq = 0;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::~EventQueue
+//	De-allocate the heap array.  As with List, we do *not* de-allocate
+//	the items themselves; that is up to the caller.
+//----------------------------------------------------------------------
+
+EventQueue::~EventQueue()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Insert
+//      Put an "item" on the queue, to come out in increasing order
+//	of "sortKey".  Grows the heap array if it is full.
+//
+//	"item" is the thing to put on the queue, it can be a pointer to
+//		anything.
+//	"sortKey" is the time at which the item is to occur.
+//----------------------------------------------------------------------
+
+void
+EventQueue::Insert(void *item, int sortKey)
+{
+    if (numInQueue == numAllocated) {
+	EventQueueEntry *bigger = new EventQueueEntry[numAllocated * 2];
+
+	for (int i = 0; i < numInQueue; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	numAllocated *= 2;
+    }
+    heap[numInQueue].item = item;
+    heap[numInQueue].key = sortKey;
+    heap[numInQueue].seq = nextSeq++;
+    numInQueue++;
+    SiftUp(numInQueue - 1);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Peek
+//      Look at the item with the smallest key, without removing it.
+//
+// Returns:
+//	Pointer to the item, NULL if the queue is empty.
+//	Sets *keyPtr to the item's key, if keyPtr is not NULL.
+//----------------------------------------------------------------------
+
+void *
+EventQueue::Peek(int *keyPtr)
+{
+    if (IsEmpty())
+	return NULL;
+    if (keyPtr != NULL)
+	*keyPtr = heap[0].key;
+    return heap[0].item;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Remove
+//      Remove the item with the smallest key from the queue.
+//
+// Returns:
+//	Pointer to the removed item, NULL if the queue is empty.
+//	Sets *keyPtr to the item's key, if keyPtr is not NULL.
+//----------------------------------------------------------------------
+
+void *
+EventQueue::Remove(int *keyPtr)
+{
+    void *item = Peek(keyPtr);
+
+    if (item == NULL)
+	return NULL;
+    numInQueue--;
+    if (numInQueue > 0) {
+	heap[0] = heap[numInQueue];
+	SiftDown(0);
+    }
+    return item;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Mapcar
+//	Apply a function to each item on the queue.  The items are
+//	visited in heap order, which is not necessarily sorted order.
+//
+//	"func" is the procedure to apply to each item on the queue.
+//----------------------------------------------------------------------
+
+void
+EventQueue::Mapcar(VoidFunctionPtr func)
+{
+    for (int i = 0; i < numInQueue; i++)
+	(*func)((_int)heap[i].item);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Before
+//	Return TRUE if the event in slot "i" should fire before the
+//	event in slot "j": an earlier time, or the same time and an
+//	earlier insertion.
+//----------------------------------------------------------------------
+
+bool
+EventQueue::Before(int i, int j)
+{
+    if (heap[i].key != heap[j].key)
+	return (bool)(heap[i].key < heap[j].key);
+    return (bool)(heap[i].seq < heap[j].seq);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Swap
+//	Exchange the contents of two heap slots.
+//----------------------------------------------------------------------
+
+void
+EventQueue::Swap(int i, int j)
+{
+    EventQueueEntry tmp = heap[i];
+
+    heap[i] = heap[j];
+    heap[j] = tmp;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::SiftUp
+//	Move the entry in slot "i" towards the root until its parent
+//	comes before it.
+//----------------------------------------------------------------------
+
+void
+EventQueue::SiftUp(int i)
+{
+    while (i > 0) {
+	int parent = (i - 1) / 2;
+
+	if (!Before(i, parent))
+	    break;
+	Swap(i, parent);
+	i = parent;
+    }
+}
+
+//----------------------------------------------------------------------
+// EventQueue::SiftDown
+//	Move the entry in slot "i" towards the leaves until it comes
+//	before both of its children.
+//----------------------------------------------------------------------
+
+void
+EventQueue::SiftDown(int i)
+{
+    for (;;) {
+	int child = 2 * i + 1;
+
+	if (child >= numInQueue)
+	    break;
+	if ((child + 1 < numInQueue) && Before(child + 1, child))
+	    child++;
+	if (!Before(child, i))
+	    break;
+	Swap(i, child);
+	i = child;
+    }
+}
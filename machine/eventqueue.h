@@ -0,0 +1,72 @@
+// eventqueue.h
+//	Data structures to keep track of the hardware events (interrupts)
+//	that are scheduled to occur in the future.
+//
+//	The event queue is a binary min-heap ordered by the simulated time
+//	at which each event is to fire.  Inserting an event costs
+//	O(log n), looking at the earliest event costs O(1), and removing
+//	it costs O(log n).  Compare this with a sorted List, where every
+//	insert walks the list.
+//
+//	Events scheduled for the same time come out in the order they
+//	were inserted, just as with List::SortedInsert, so the simulation
+//	stays deterministic.
+//
+//	NOTE: Mutual exclusion must be provided by the caller (the interrupt
+//	simulation only touches the queue with interrupts disabled).
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The following class defines a single slot in the heap.  "seq" breaks
+// ties between events with the same key, in favor of the oldest.
+
+class EventQueueEntry {
+  public:
+    void *item;			// the event itself (e.g., a PendingInterrupt)
+    int key;			// when the event is to occur
+    unsigned seq;		// insertion order, for FIFO ties
+};
+
+// The following class defines a priority queue of "things", keyed by
+// an integer, with the smallest key at the front.
+
+class EventQueue {
+  public:
+    EventQueue();		// initialize the queue, empty to start with
+    ~EventQueue();		// de-allocate the queue (but not the items)
+
+    void Insert(void *item, int sortKey);	// put item on the queue
+    void *Peek(int *keyPtr);	// return (but do not remove) the item
+				// with the smallest key; NULL if empty
+    void *Remove(int *keyPtr);	// remove and return the item with the
+				// smallest key; NULL if empty
+
+    bool IsEmpty() { return (bool)(numInQueue == 0); }
+    int NumInQueue() { return numInQueue; }
+
+    void Mapcar(VoidFunctionPtr func);	// apply "func" to every item
+					// on the queue (in heap order)
+
+  private:
+    EventQueueEntry *heap;	// heap[0] is the earliest event
+    int numInQueue;		// number of events in the queue
+    int numAllocated;		// size of the heap array
+    unsigned nextSeq;		// sequence number for the next Insert
+
+    bool Before(int i, int j);	// does heap[i] come before heap[j]?
+    void Swap(int i, int j);
+    void SiftUp(int i);		// restore heap order after an insert
+    void SiftDown(int i);	// restore heap order after a remove
+};
+
+#endif // EVENTQUEUE_H
@@ -23,12 +23,14 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "system.h"
+#include "trace.h"
 
 // String definitions for debugging messages
 
 static const char *intLevelNames[] = { "off", "on"};
 static const char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "network send", "network recv",
+			"checkpoint", "alarm"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -60,10 +62,13 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, _int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new EventQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    interruptedStatus = SystemMode;
+    tickless = FALSE;
+    numIdleTasks = nextIdleTask = 0;
 }
 
 //----------------------------------------------------------------------
@@ -74,7 +79,7 @@ Interrupt::Interrupt()
 Interrupt::~Interrupt()
 {
     while (!pending->IsEmpty())
-	    delete (ListElement *)(pending->Remove());
+	delete (PendingInterrupt *)(pending->Remove(NULL));
     delete pending;
 }
 
@@ -149,16 +154,32 @@ Interrupt::Enable()
 //----------------------------------------------------------------------
 void
 Interrupt::OneTick()
+{
+    ManyTicks(1);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::ManyTicks
+// 	Advance simulated time by "count" ticks in one step, and then
+//	check if there are any pending interrupts to be called.  Any
+//	interrupt that became due during those ticks is called now,
+//	in the order they were scheduled to occur.
+//
+//	"count" -- the number of ticks to charge, e.g., the number of
+//		user instructions just run by the basic-block engine
+//----------------------------------------------------------------------
+void
+Interrupt::ManyTicks(int count)
 {
     MachineStatus old = status;
 
 // advance simulated time
     if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
-	stats->systemTicks += SystemTick;
+        stats->totalTicks += count * systemTick;
+	stats->systemTicks += count * systemTick;
     } else {					// USER_PROGRAM
-	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
+	stats->totalTicks += count * userTick;
+	stats->userTicks += count * userTick;
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
@@ -166,6 +187,7 @@ Interrupt::OneTick()
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
 					// interrupts disabled)
+    CheckWatchedFiles();		// see if there is any host input
     while (CheckIfDue(FALSE))		// check for pending interrupts
 	;
     ChangeLevel(IntOff, IntOn);		// re-enable interrupts
@@ -178,6 +200,48 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::TicksUntilDue
+// 	Return how many ticks of simulated time can go by before the
+//	earliest pending interrupt is due, i.e., how far the clock can
+//	be advanced (by SkipTicks) without having to call CheckIfDue.
+//	If nothing is pending, the answer is "a very long time".
+//
+//	Note that the answer is only good until something new is
+//	scheduled.
+//----------------------------------------------------------------------
+int
+Interrupt::TicksUntilDue()
+{
+    int when;
+
+    if (pending->Peek(&when) == NULL)
+	return 0x3fffffff;
+    if (when - stats->totalTicks <= 1)
+	return 0;
+    return when - stats->totalTicks - 1;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SkipTicks
+// 	Advance simulated time by "count" ticks, just as OneTick would,
+//	but without checking for pending interrupts.  The caller must
+//	know (from TicksUntilDue) that none can become due.
+//
+//	"count" -- the number of ticks to charge
+//----------------------------------------------------------------------
+void
+Interrupt::SkipTicks(int count)
+{
+    if (status == SystemMode) {
+        stats->totalTicks += count * systemTick;
+	stats->systemTicks += count * systemTick;
+    } else {
+	stats->totalTicks += count * userTick;
+	stats->userTicks += count * userTick;
+    }
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -204,14 +268,20 @@ Interrupt::YieldOnReturn()
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
 //
+//	First, though, the idle tasks get the time until then (see
+//	RunIdleTasks).
+//
 //	If there are no pending interrupts, stop.  There's nothing
-//	more for us to do.
+//	more for us to do -- unless the console or the network is
+//	waiting for input, in which case we wait for it (see sysdep.cc).
 //----------------------------------------------------------------------
 void
 Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+    (void) WaitForWatchedFiles(FALSE);	// give input a moment to arrive
+    RunIdleTasks();			// and the kernel, background work
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
@@ -222,10 +292,16 @@ Interrupt::Idle()
 					// a runnable thread
     }
 
+    // if there are no pending interrupts, wait for input from outside
+    if (WaitForWatchedFiles(TRUE)) {
+        status = SystemMode;
+	return;				// its interrupt is now pending
+    }
+
     // if there are no pending interrupts, and nothing is on the ready
     // queue, it is time to stop.   If the console or the network is 
-    // operating, there are *always* pending interrupts, so this code
-    // is not reached.  Instead, the halt must be invoked by the user program.
+    // operating, we always wait for input, so this code is not
+    // reached.  Instead, the halt must be invoked by the user program.
 
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
@@ -233,6 +309,68 @@ Interrupt::Idle()
     Halt();
 }
 
+//----------------------------------------------------------------------
+// Interrupt::AddIdleTask
+// 	Have func(arg) called while the machine is idle (see RunIdleTasks),
+//	to do work that needn't be done straight away -- zeroing free
+//	frames, say, or writing back dirty buffers -- so that it isn't
+//	done when a page fault or a write needs it instead.
+//
+//	Each call should do a bounded slice of the work (one frame, one
+//	buffer), and return TRUE if it did any.  It is called with
+//	interrupts off, outside any thread, so it must not wait; a thread
+//	it makes ready runs after the next interrupt.
+//----------------------------------------------------------------------
+
+void
+Interrupt::AddIdleTask(IdleFunctionPtr func, _int arg)
+{
+    ASSERT(numIdleTasks < MaxIdleTasks);
+    idleTasks[numIdleTasks] = func;
+    idleArgs[numIdleTasks] = arg;
+    numIdleTasks++;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RunIdleTasks
+// 	The machine is idle: use the time until the next interrupt, which
+//	Idle would otherwise just skip, for the idle tasks.  Call them in
+//	turn, charging IdleSliceTicks of system time for each slice of
+//	work done, for as long as another slice fits before the interrupt
+//	is due, and until none of them has anything to do.  What doesn't
+//	fit is done the next time the machine is idle.
+//
+//	If the machine is about to stop, there's no point.
+//----------------------------------------------------------------------
+
+void
+Interrupt::RunIdleTasks()
+{
+    PendingInterrupt *next;
+    int when, numQuiet = 0;
+
+    if (numIdleTasks == 0)
+	return;
+    next = (PendingInterrupt *) pending->Peek(&when);
+    if (next == NULL)
+	return;				// nothing pending: about to stop
+    if ((next->type == TimerInt) && (pending->NumInQueue() == 1))
+	return;				// no more than the timer: ditto
+
+    while ((numQuiet < numIdleTasks)
+		&& (when - stats->totalTicks >= IdleSliceTicks)) {
+	int task = nextIdleTask;
+
+	nextIdleTask = (nextIdleTask + 1) % numIdleTasks;
+	if ((*idleTasks[task])(idleArgs[task])) {
+	    stats->totalTicks += IdleSliceTicks;
+	    stats->systemTicks += IdleSliceTicks;
+	    numQuiet = 0;
+	} else
+	    numQuiet++;
+    }
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Halt
 // 	Shut down Nachos cleanly, printing out performance statistics.
@@ -242,6 +380,10 @@ Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
     stats->Print();
+#ifdef USER_PROGRAM
+    PrintProfiles();
+#endif
+    TraceDump();
     Cleanup();     // Never returns.
 }
 
@@ -250,7 +392,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it on the event queue (a heap
+//	ordered by "when").
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -271,7 +414,7 @@ Interrupt::Schedule(VoidFunctionPtr handler, _int arg, int fromNow, IntType type
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(toOccur, when);
 }
 
 //----------------------------------------------------------------------
@@ -285,7 +428,8 @@ Interrupt::Schedule(VoidFunctionPtr handler, _int arg, int fromNow, IntType type
 //		so we should simply advance the clock to when the next 
 //		pending interrupt would occur (if any).  If the pending
 //		interrupt is just the time-slice daemon, however, then 
-//		we're done!
+//		we're done!  In tickless mode, the time-slice daemon
+//		is skipped over, straight to the next other interrupt.
 //----------------------------------------------------------------------
 bool
 Interrupt::CheckIfDue(bool advanceClock)
@@ -297,8 +441,13 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = (PendingInterrupt *)pending->Peek(&when);
+
+    if (advanceClock && tickless && (toOccur != NULL)
+		&& (toOccur->type == TimerInt) && (pending->NumInQueue() > 1)) {
+	SkipIdleTicks();
+	toOccur = (PendingInterrupt *)pending->Peek(&when);
+    }
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
@@ -306,35 +455,151 @@ Interrupt::CheckIfDue(bool advanceClock)
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
-	return FALSE;
+    } else if (when > stats->totalTicks) {	// not time yet, leave it
+	return FALSE;				// at the head of the queue
     }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& (pending->NumInQueue() == 1))
 	 return FALSE;
-    }
+
+    (void) pending->Remove(NULL);		// the handler may schedule
+						// more interrupts
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
+    TraceRecord(TraceInterrupt, intTypeNames[toOccur->type],
+		stats->totalTicks - toOccur->when, interruptTicks);
 #ifdef USER_PROGRAM
     if (machine != NULL)
     	machine->DelayedLoad(0, 0);
 #endif
     inHandler = TRUE;
+    interruptedStatus = old;
     status = SystemMode;			// whatever we were doing,
 						// we are now going to be
 						// running in the kernel
+    int start = stats->totalTicks;
+    unsigned long long hostTime = HostNanoseconds();
+
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
+    stats->totalTicks += interruptTicks;	// and pay for taking it
+    stats->systemTicks += interruptTicks;
+    stats->RecordInterrupt(toOccur->type, intTypeNames[toOccur->type],
+			   start - toOccur->when, stats->totalTicks - start,
+			   HostNanoseconds() - hostTime);
     status = old;				// restore the machine status
     inHandler = FALSE;
     delete toOccur;
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Interrupt::SkipIdleTicks
+// 	The machine is idle, and the next interrupt due is the timer's.
+//	Its handler would have nothing to preempt, so rather than taking
+//	it every timerTicks until something else happens, move it (in
+//	whole periods, so the ticks stay where they would have been) to
+//	after the next other pending interrupt.  Nothing is running, so
+//	no time slice is shortened or stretched.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SkipIdleTicks()
+{
+    PendingInterrupt *tick = (PendingInterrupt *)pending->Remove(NULL);
+    int next, skipped;
+
+    ASSERT(tick->type == TimerInt);
+    (void) pending->Peek(&next);	// the next other interrupt
+    skipped = divRoundUp(next - tick->when, timerTicks);
+    if (skipped > 0) {
+	DEBUG('i', "Idle; skipping %d timer interrupts, to time %d\n",
+	      skipped, next);
+	tick->when += skipped * timerTicks;
+	stats->numTicksSkipped += skipped;
+    }
+    pending->Insert(tick, tick->when);	// after "next", if at the same
+}					// time
+
+//----------------------------------------------------------------------
+// Interrupt::SavePending
+// 	Write the interrupts pending to a checkpoint: how many there
+//	are, then the type of each, and how many ticks from now it is
+//	due.  The handlers are not saved; they are put back by the
+//	devices, when the machine that restores the checkpoint boots.
+//
+//	"fd" -- the checkpoint, an open host file
+//----------------------------------------------------------------------
+
+static int savingTo;			// the fd for SavePendingOne
+
+static void
+SavePendingOne(_int arg)
+{
+    PendingInterrupt *pend = (PendingInterrupt *)arg;
+    int saved[2];
+
+    saved[0] = pend->type;
+    saved[1] = pend->when - stats->totalTicks;
+    WriteFile(savingTo, (char *) saved, sizeof(saved));
+}
+
+void
+Interrupt::SavePending(int fd)
+{
+    int numPending = pending->NumInQueue();
+
+    WriteFile(fd, (char *) &numPending, sizeof(int));
+    savingTo = fd;
+    pending->Mapcar(SavePendingOne);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RestorePending
+// 	Read back what SavePending wrote, once the clock has been set to
+//	the time of the checkpoint.  Every interrupt pending now was
+//	scheduled by a device as we booted; each is moved to when the
+//	first one of its type, not yet matched, was due when the
+//	checkpoint was taken.  Any other keeps its distance from the time
+//	we booted.
+//
+//	"fd" -- the checkpoint, read up to the pending interrupts
+//	"bootTicks" -- the clock, before it was set
+//----------------------------------------------------------------------
+
+void
+Interrupt::RestorePending(int fd, int bootTicks)
+{
+    EventQueue *restored = new EventQueue();
+    PendingInterrupt *pend;
+    int numSaved, *saved, i;
+
+    Read(fd, (char *) &numSaved, sizeof(int));
+    ASSERT(numSaved >= 0);
+    saved = new int[2 * numSaved + 1];
+    Read(fd, (char *) saved, 2 * numSaved * sizeof(int));
+
+    while ((pend = (PendingInterrupt *)pending->Remove(NULL)) != NULL) {
+	int when = stats->totalTicks + (pend->when - bootTicks);
+
+	for (i = 0; i < numSaved; i++)
+	    if (saved[2 * i] == pend->type) {
+		when = stats->totalTicks + saved[2 * i + 1];
+		saved[2 * i] = -1;		// matched
+		break;
+	    }
+	DEBUG('i', "Restored the %s interrupt, to time %d\n",
+	      intTypeNames[pend->type], when);
+	pend->when = when;
+	restored->Insert(pend, when);
+    }
+    delete pending;
+    pending = restored;
+    delete [] saved;
+}
+
 //----------------------------------------------------------------------
 // PrintPending
 // 	Print information about an interrupt that is scheduled to occur.
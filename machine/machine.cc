@@ -9,7 +9,12 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "mipsjit.h"
+#include "memcache.h"
 #include "system.h"
+#include "trace.h"
+
+int numPhysPages = DefaultPhysPages;	// the size of mainMemory, in pages
 
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
@@ -50,9 +55,22 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"cacheDecoded" -- if TRUE, keep the decoded form of each instruction
+//		word, rather than re-decoding it every time it is executed.
+//	"runBlocks" -- if TRUE, run straight-line user code a basic block
+//		at a time (see mipsblock.cc).
+//	"batch" -- if TRUE, only check for pending interrupts when one
+//		could actually be due (see Machine::Run).
+//	"tlbEntries" -- the number of entries in the TLB; if 0, there is
+//		no TLB, and the linear page table is used instead.
+//	"ways" -- the associativity of the TLB; must divide "tlbEntries",
+//		and be at least 2, since one instruction can touch two
+//		pages (its own, and the one it loads or stores), and if
+//		they fought over a single slot we would never make progress.
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool cacheDecoded, bool runBlocks, bool batch,
+		 int tlbEntries, int ways)
 {
     int i;
 
@@ -61,17 +79,70 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
-#else	// use linear page table
-    tlb = NULL;
+    if (tlbEntries > 0) {
+	ASSERT((ways >= 2) && (tlbEntries % ways == 0));
+	tlbSize = tlbEntries;
+	tlbWays = ways;
+	tlbSets = tlbEntries / ways;
+	tlb = new TranslationEntry[tlbSize];
+	tlbASID = new int[tlbSize];
+	for (i = 0; i < tlbSize; i++) {
+	    tlb[i].valid = FALSE;
+	    tlbASID[i] = 0;
+	}
+	tlbNextVictim = new int[tlbSets];
+	for (i = 0; i < tlbSets; i++)
+	    tlbNextVictim[i] = 0;
+    } else {			// use linear page table
+	tlbSize = tlbWays = tlbSets = 0;
+	tlb = NULL;
+	tlbASID = NULL;
+	tlbNextVictim = NULL;
+    }
+    FlushMicroTLB();
+    asid = 0;
     pageTable = NULL;
-#endif
+    pageDirectory = NULL;
+
+    if (cacheDecoded) {
+	decodeCache = new Instruction[MemorySize / 4];
+	decodeValid = new bool[MemorySize / 4];
+	for (i = 0; i < MemorySize / 4; i++)
+	    decodeValid[i] = FALSE;
+    } else {
+	decodeCache = NULL;
+	decodeValid = NULL;
+    }
+    if (runBlocks) {
+	blockTable = new Block *[MemorySize / 4];
+	for (i = 0; i < MemorySize / 4; i++)
+	    blockTable[i] = NULL;
+	blocksInFrame = new int[numPhysPages];
+	for (i = 0; i < numPhysPages; i++)
+	    blocksInFrame[i] = 0;
+    } else {
+	blockTable = NULL;
+	blocksInFrame = NULL;
+    }
+    numBlockFlushes = 0;
+    codeCache = NULL;
+    jitActive = 0;
+    icache = dcache = NULL;
+    missPenalty = 0;
+    numNodes = 1;
+    remoteTicks = 0;
+    timedMemory = FALSE;
+    superPages = FALSE;
+    cacheCounts = NULL;
 
     singleStep = debug;
+    batchTicks = batch;
+    profileTicks = nextSample = 0;
+    numTraps = 0;
+    afterBranch = FALSE;
+    helpers = NULL;
+    numHelpers = 0;
+    runningAhead = stoppedAhead = FALSE;
     CheckEndian();
 }
 
@@ -83,8 +154,55 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
+    if (tlb != NULL) {
         delete [] tlb;
+	delete [] tlbASID;
+	delete [] tlbNextVictim;
+    }
+    if (decodeCache != NULL) {
+	delete [] decodeCache;
+	delete [] decodeValid;
+    }
+    if (blockTable != NULL) {
+	for (int i = 0; i < numPhysPages; i++)
+	    FlushBlocks(i);
+	delete [] blockTable;
+	delete [] blocksInFrame;
+    }
+    if (codeCache != NULL)
+	delete codeCache;
+    if (icache != NULL) {
+	delete icache;
+	delete dcache;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodeCache
+// 	Throw away the decoded form of any instruction words (and any
+//	basic blocks) that overlap "size" bytes of physical memory
+//	starting at "physAddr".  Called
+//	by WriteMem, and by the kernel whenever it loads a page of
+//	mainMemory directly (e.g., from the executable).
+//
+//	"physAddr" -- the first byte of physical memory that changed
+//	"size" -- the number of bytes that changed
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodeCache(int physAddr, int size)
+{
+    if (size <= 0)
+	return;
+    ASSERT((physAddr >= 0) && (physAddr + size <= MemorySize));
+    if (decodeValid != NULL)
+	for (int i = physAddr / 4; i <= (physAddr + size - 1) / 4; i++)
+	    decodeValid[i] = FALSE;
+    if (blockTable != NULL)
+	for (int f = physAddr / PageSize; f <= (physAddr + size - 1) / PageSize;
+									f++)
+	    if (blocksInFrame[f] > 0)
+		FlushBlocks(f);
 }
 
 //----------------------------------------------------------------------
@@ -93,6 +211,10 @@ Machine::~Machine()
 //	the user program either invoked a system call, or some exception
 //	occured (such as the address translation failed).
 //
+//	If we are running ahead (see RunAhead), we don't trap: we just
+//	stop, with nothing changed, and the instruction is run again
+//	later, on the host thread the kernel runs on.
+//
 //	"which" -- the cause of the kernel trap
 //	"badVaddr" -- the virtual address causing the trap, if appropriate
 //----------------------------------------------------------------------
@@ -100,13 +222,24 @@ Machine::~Machine()
 void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
+    if (runningAhead) {
+	stoppedAhead = TRUE;
+	return;
+    }
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
+    if (which == SyscallException)
+	TraceRecord(TraceSyscall, "syscall", registers[2], 0);
+    else
+	TraceRecord(TraceFault, exceptionNames[which], badVAddr, 0);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+    numTraps++;				// the kernel may schedule interrupts
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
+    FlushMicroTLB();			// the kernel may have changed the
+					// translations
     interrupt->setStatus(UserMode);
 }
 
@@ -26,15 +26,26 @@
 #include "translate.h"
 #include "disk.h"
 
+class Block;			// a translated basic block (mipsblock.h)
+class CodeCache;		// where the JIT puts host code (mipsjit.h)
+class MemoryCache;		// a model of an L1 cache (memcache.h)
+class CacheCounts;		// ... and its hit rates
+class HelperCPU;		// a CPU run on a host thread (mipspar.h)
+
 // Definitions related to the size, and format of user memory
 
 #define PageSize 	SectorSize 	// set the page size equal to
 					// the disk sector size, for
 					// simplicity
 
-#define NumPhysPages    32
-#define MemorySize 	(NumPhysPages * PageSize)
+#define DefaultPhysPages 32		// page frames of physical memory,
+					// unless -mem says otherwise
+#define MemorySize 	(numPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+#define TLBWays		4		// default associativity of the TLB
+
+extern int numPhysPages;		// page frames of physical memory; set
+					// at boot, before the Machine is made
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -52,6 +63,15 @@ enum ExceptionType { NoException,           // Everything ok!
 		     NumExceptionTypes
 };
 
+// The kinds of memory access, each with its own entry in the micro-TLB
+// (see Machine::Translate).
+
+enum AccessType { FetchAccess,		// an instruction fetch
+		  LoadAccess,		// a data read
+		  StoreAccess,		// a data write
+		  NumAccessTypes
+};
+
 // User program CPU state.  The full set of MIPS registers, plus a few
 // more because we need to be able to start/stop a user program between
 // any two instructions (thus we need to keep track of things like load
@@ -101,13 +121,18 @@ class Instruction {
 // If we were to implement more of the UNIX system calls, we ought to be
 // able to run Nachos on top of Nachos!
 //
-// The procedures in this class are defined in machine.cc, mipssim.cc, and
-// translate.cc.
+// The procedures in this class are defined in machine.cc, mipssim.cc,
+// mipsblock.cc, mipsjit.cc, mipspar.cc, and translate.cc.
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, bool cacheDecoded, bool runBlocks, bool batchTicks,
+	    int tlbEntries, int tlbWays);
+				// Initialize the simulation of the hardware
 				// for running user programs
+    Machine(Machine *parent);	// A helper CPU, for parallel mode: no
+				// TLB, caches or decoded instructions of
+				// its own, and "parent"'s memory
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -118,13 +143,83 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    bool CopyIn(int virtAddr, char *buffer, int size);
+				// copy "size" bytes of user memory into
+				// a kernel buffer
+    bool CopyOut(int virtAddr, char *buffer, int size);
+				// copy "size" bytes of a kernel buffer
+				// out to user memory
+    int CopyInString(int virtAddr, char *buffer, int maxSize);
+				// copy a null-terminated user string into
+				// a kernel buffer; return its length
+    bool CopyUser(int toAddr, int fromAddr, int size);
+				// copy "size" bytes of user memory to
+				// elsewhere in user memory
+    bool FillUser(int virtAddr, int value, int size);
+				// set "size" bytes of user memory to
+				// "value"
+    void SetProfiling(int ticks);
+				// sample the PC every "ticks" user ticks,
+				// for the profiler (0: don't)
+    bool IsProfiling() { return (bool)(profileTicks > 0); }
+    void EnableJIT();		// compile hot basic blocks to host code
+				// (needs "runBlocks"; see mipsjit.cc)
+    void SetCaches(int size, int lineSize, int ways, int penalty);
+				// model L1 I- and D-caches of "size"
+				// bytes each, charging "penalty" ticks
+				// a miss (see memcache.h)
+    bool CachesEnabled() { return (bool)(icache != NULL); }
+    void EnableSuperPages() { superPages = TRUE; }
+				// let the kernel load superpage
+				// translations into the TLB
+    bool SuperPagesEnabled() { return superPages; }
+    void SetNUMA(int nodes, int ticks);
+				// split memory between "nodes" nodes,
+				// charging "ticks" for a remote access
+    int NumNodes() { return numNodes; }
+    int FrameNode(int frame) { return frame * numNodes / numPhysPages; }
+				// the node that "frame" is on
+    bool SetParallel();		// run the other CPUs' next threads
+				// alongside the running one, on host
+				// threads (see mipspar.cc); FALSE if
+				// this machine can't
+
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
-    void OneInstruction(Instruction *instr); 	
+    void OneInstruction(Instruction *decoded); 	
     				// Run one instruction of a user program.
+    void RunFast(Instruction *instr);
+    void RunInstrumented(Instruction *instr);
+				// Run's loops: with nothing watching,
+				// and with the debugger, the profiler or
+				// tracing on
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
+    int RunAhead(int maxCount);	// Run at most "maxCount" instructions,
+				// stopping short of any that would trap;
+				// return how many were run
+    int RunParallel(int maxCount);
+				// ... and, alongside, those of the threads
+				// the other CPUs would run next
+    int RunBlock(int maxCount);	// Run (at most "maxCount" instructions of)
+				// the basic block of user instructions at
+				// the PC; return how many were run
+    void FlushBlocks(int frame);
+				// Throw away the basic blocks in a frame
+    void CompileBlock(Block *block);
+				// Compile a hot block to host code
+    void FlushCodeCache();	// Throw away all the compiled code
+    void CountInstruction(int opCode, bool taken, unsigned long long cycles);
+				// Count an instruction run, if we are
+				// counting them (-DINSTR_STATS)
+    TranslationEntry *TLBVictim(int vpn, bool superPage = FALSE);
+				// Return the TLB slot that a translation
+				// for "vpn" (or its superpage) should be
+				// loaded into
+    int TranslateForCopy(int virtAddr, bool writing);
+				// Translate a user address for the kernel,
+				// letting it handle a fault first
     
     bool ReadMem(int addr, int size, int* value);
     bool WriteMem(int addr, int size, int value);
@@ -132,12 +227,24 @@ class Machine {
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
     
-    ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
+    ExceptionType Translate(int virtAddr, int* physAddr, int size,
+			    bool writing, bool fetching = FALSE);
     				// Translate an address, and check for 
 				// alignment.  Set the use and dirty bits in 
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+				// "fetching" is for instruction fetches
+    void ChargeAccess(bool fetching, int physAddr);
+				// Charge for a user memory access, if
+				// they are timed (caches, NUMA)
+    bool CacheAccess(bool fetching, int physAddr);
+				// Run an access through the L1 cache
+				// model, charging for a miss
+    void FlushMicroTLB();	// Forget the last translations made.
+				// Must be called whenever the kernel
+				// changes the page table or TLB, or
+				// switches address spaces
 
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
@@ -146,6 +253,12 @@ class Machine {
     void Debugger();		// invoke the user program debugger
     void DumpState();		// print the user CPU and memory state 
 
+    void InvalidateDecodeCache(int physAddr, int size);
+				// Forget any decoded instructions in
+				// "size" bytes of physical memory starting
+				// at "physAddr".  Must be called whenever
+				// the kernel changes mainMemory directly.
+
 
 // Data structures -- all of these are accessible to Nachos kernel code.
 // "public" for convenience.
@@ -165,7 +278,11 @@ class Machine {
 //  	a software-loaded translation lookaside buffer (tlb) -- a cache of 
 //	  mappings of virtual page #'s to physical page #'s
 //
-// If "tlb" is NULL, the linear page table is used
+// If "tlb" is NULL, the linear page table is used -- or, if
+//	"pageDirectory" is non-NULL, a two-level page table: virtual page
+//	"vpn" is entry (vpn % PageLeafSize) of the leaf found at
+//	pageDirectory[vpn / PageLeafSize], and a NULL leaf maps none of
+//	its pages.  Either way, "pageTableSize" is the number of pages.
 // If "tlb" is non-NULL, the Nachos kernel is responsible for managing
 //	the contents of the TLB.  But the kernel can use any data structure
 //	it wants (eg, segmented paging) for handling TLB cache misses.
@@ -176,23 +293,115 @@ class Machine {
 // Thus the TLB pointer should be considered as *read-only*, although 
 // the contents of the TLB are free to be modified by the kernel software.
 
+// The TLB is set-associative: "vpn" can only be cached in set
+// (vpn % tlbSets), which is the "tlbWays" entries starting at
+// tlb[(vpn % tlbSets) * tlbWays].  The kernel should use TLBVictim
+// to find where a new translation can go.  A superpage translation
+// (see translate.h) goes in set ((vpn / SuperPageSize) % tlbSets), and
+// the hardware looks in both sets.
+//
+// Each TLB entry is tagged with an address space identifier (ASID),
+// in tlbASID, and only matches while "asid" -- the ASID register,
+// which the kernel sets on a context switch -- holds the same tag.  So
+// translations of several address spaces can be in the TLB at once,
+// and it needn't be flushed on a switch.  The kernel tags an entry
+// when it loads it.
+
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int *tlbASID;			// the ASID of each TLB entry
+    int tlbSize;			// number of entries in the TLB
+    int asid;				// the ASID register: the address
+					// space translations are for
 
     TranslationEntry *pageTable;
+    TranslationEntry **pageDirectory;
     unsigned int pageTableSize;
 
+    CacheCounts *cacheCounts;	// where the current address space counts
+				// its accesses through the L1 cache model
+				// (see memcache.h), or NULL if it doesn't
+
   private:
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
+    int profileTicks;		// user ticks between PC samples, 0 if we
+				// aren't profiling
+    int nextSample;		// user time of the next sample
+    int tlbWays;		// number of TLB entries in each set
+    int tlbSets;		// number of sets in the TLB
+    int *tlbNextVictim;		// per set, the way to replace next
+    bool superPages;		// can the TLB hold superpages?
+    void CountTLBReach();	// Count the pages the TLB maps, for the
+				// current address space, at a miss
+
+// The micro-TLB: for each kind of access, the page last translated,
+// its frame and its translation.  The next access of that kind to the
+// same page -- nearly every instruction fetch -- skips the full walk.
+// It relies on being flushed whenever a translation changes.
+    unsigned int microVPN[NumAccessTypes];	// page, or -1 if none
+    int microFrame[NumAccessTypes];		// where it is, in bytes
+    TranslationEntry *microEntry[NumAccessTypes];
+						// whose use and dirty bits
+						// to set
+    bool batchTicks;		// charge ticks in batches, only checking
+				// for interrupts when one can be due
+    int numTraps;		// number of times we have trapped to the
+				// kernel (see RaiseException)
+    bool afterBranch;		// was the last instruction counted a branch
+				// (so the next is in its delay slot)?
+
+// Decoded-instruction cache, indexed by physical word address, so that
+// OneInstruction does not have to re-fetch and re-decode an instruction
+// every time it is executed.  Both are NULL if the cache is disabled.
+    Instruction *decodeCache;	// decoded form of each word of mainMemory
+    bool *decodeValid;		// is the decodeCache entry up to date?
+
+// Basic-block engine (see mipsblock.cc).  "blockTable" is indexed by
+// the physical word address of the first instruction of a block, and
+// is NULL if the engine is disabled.
+    Block **blockTable;		// translated blocks, by starting address
+    int *blocksInFrame;		// number of blocks starting in each frame
+    int numBlockFlushes;	// bumped every time blocks are thrown away
+
+    Block *TranslateBlock(int physAddr);
+				// Build the block starting at "physAddr"
+
+// L1 cache model (see memcache.cc).  Both caches are NULL if it is off.
+    MemoryCache *icache;	// for instruction fetches
+    MemoryCache *dcache;	// for loads and stores
+    int missPenalty;		// extra ticks charged for a miss
+
+// NUMA model (see ChargeAccess).  Memory is split evenly between the
+// nodes, in order; the CPUs too (see Scheduler::NodeOf).
+    int numNodes;		// nodes memory is split between (1: no NUMA)
+    int remoteTicks;		// extra ticks charged for a remote access
+    bool timedMemory;		// do user accesses cost more than UserTick
+				// (caches or NUMA)?
+
+// JIT (see mipsjit.cc).  "codeCache" is NULL if the JIT is off.
+    CodeCache *codeCache;	// the host code of the compiled blocks
+    int jitActive;		// threads now running compiled code (who
+				// may have trapped out of it, and not yet
+				// returned), so it mustn't be flushed
+
+// Parallel mode (see mipspar.cc).  "helpers" is NULL if it is off.
+    HelperCPU *helpers;		// one for each of the other CPUs
+    int numHelpers;		// how many there are
+    bool runningAhead;		// in RunAhead: an exception stops us,
+    bool stoppedAhead;		// rather than trapping, and sets this
 };
 
 extern void ExceptionHandler(ExceptionType which);
 				// Entry point into Nachos for handling
 				// user system calls and exceptions
 				// Defined in exception.cc
+extern void ProfileSample(int pc);
+				// Entry point into Nachos for counting a
+				// sample of the PC, when profiling
+				// Defined in profile.cc
 
 
 // Routines for converting Words and Short Words to and from the
@@ -205,10 +414,37 @@ extern void ExceptionHandler(ExceptionType which);
 //	   user registers
 //	simulated machine byte ordering:
 //	   contents of main memory
-
-unsigned int WordToHost(unsigned int word);
-unsigned short ShortToHost(unsigned short shortword);
-unsigned int WordToMachine(unsigned int word);
-unsigned short ShortToMachine(unsigned short shortword);
+//
+// Which way round the host is is known when Nachos is compiled (see
+// Makefile.dep), so they are inline, and every simulated memory access
+// compiles down to either nothing or a byte swap.
+
+inline unsigned int
+WordToHost(unsigned int word)
+{
+#ifdef HOST_IS_BIG_ENDIAN
+    return ((word >> 24) & 0x000000ff) | ((word >> 8) & 0x0000ff00)
+	 | ((word << 8) & 0x00ff0000) | ((word << 24) & 0xff000000);
+#else
+    return word;
+#endif // HOST_IS_BIG_ENDIAN
+}
+
+inline unsigned short
+ShortToHost(unsigned short shortword)
+{
+#ifdef HOST_IS_BIG_ENDIAN
+    return (unsigned short) (((shortword << 8) & 0xff00)
+			     | ((shortword >> 8) & 0x00ff));
+#else
+    return shortword;
+#endif // HOST_IS_BIG_ENDIAN
+}
+
+inline unsigned int
+WordToMachine(unsigned int word) { return WordToHost(word); }
+
+inline unsigned short
+ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 
 #endif // MACHINE_H
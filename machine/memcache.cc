@@ -0,0 +1,182 @@
+// memcache.cc
+//	Routines to model the L1 caches of the simulated processor (see
+//	memcache.h).  The machine calls Access on every instruction fetch,
+//	load and store, and charges the miss penalty when it misses (see
+//	Machine::ChargeAccess).
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "memcache.h"
+#include "machine.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// CacheCounts::CacheCounts
+// 	Start counting from zero.
+//----------------------------------------------------------------------
+
+CacheCounts::CacheCounts()
+{
+    fetches = fetchMisses = dataAccesses = dataMisses = 0;
+}
+
+//----------------------------------------------------------------------
+// CacheCounts::Print
+// 	Print the hit rate of each cache.
+//
+//	"name" -- what the accesses were counted for
+//----------------------------------------------------------------------
+
+void
+CacheCounts::Print(const char *name)
+{
+    printf("L1 caches, %s: I-cache %d fetches, %.1f%% hits; "
+	"D-cache %d accesses, %.1f%% hits\n", name,
+	fetches, (fetches > 0) ?
+	    100.0 * (fetches - fetchMisses) / fetches : 0.0,
+	dataAccesses, (dataAccesses > 0) ?
+	    100.0 * (dataAccesses - dataMisses) / dataAccesses : 0.0);
+}
+
+//----------------------------------------------------------------------
+// MemoryCache::MemoryCache
+// 	Initialize an empty cache.  The sizes must all be powers of two,
+//	and the cache at least one set of lines.
+//
+//	"size" -- bytes in the cache
+//	"lineSize" -- bytes in a line
+//	"numWays" -- lines in a set
+//----------------------------------------------------------------------
+
+MemoryCache::MemoryCache(int size, int lineSize, int numWays)
+{
+    ASSERT((size > 0) && (lineSize >= 4) && (numWays > 0));
+    ASSERT((lineSize & (lineSize - 1)) == 0);
+    ASSERT(size % (lineSize * numWays) == 0);
+    for (lineShift = 0; (1 << lineShift) < lineSize; lineShift++)
+	;
+    ways = numWays;
+    numSets = size / (lineSize * numWays);
+    tags = new int[numSets * ways];
+    Flush();
+}
+
+MemoryCache::~MemoryCache()
+{
+    delete [] tags;
+}
+
+//----------------------------------------------------------------------
+// MemoryCache::Flush
+// 	Throw away every line.
+//----------------------------------------------------------------------
+
+void
+MemoryCache::Flush()
+{
+    for (int i = 0; i < numSets * ways; i++)
+	tags[i] = -1;
+}
+
+//----------------------------------------------------------------------
+// MemoryCache::Access
+// 	Look up the line that holds physical address "physAddr".  The
+//	ways of each set are kept in LRU order, so a hit moves its line
+//	to the front, and a miss pushes the last one out, and puts the
+//	new line at the front.
+//
+// Returns:
+//	TRUE on a hit, FALSE on a miss.
+//----------------------------------------------------------------------
+
+bool
+MemoryCache::Access(int physAddr)
+{
+    int line = (unsigned) physAddr >> lineShift;
+    int *set = &tags[(line % numSets) * ways];
+    int i;
+
+    for (i = 0; i < ways; i++)
+	if (set[i] == line)
+	    break;
+    bool hit = (bool)(i < ways);
+    if (!hit)
+	i = ways - 1;			// the LRU line goes
+    for (; i > 0; i--)
+	set[i] = set[i - 1];
+    set[0] = line;
+    return hit;
+}
+
+//----------------------------------------------------------------------
+// Machine::SetCaches
+// 	Turn the L1 cache model on: from now on, every user instruction
+//	fetch goes through an I-cache, and every load and store through
+//	a D-cache, and each miss costs "penalty" ticks more.
+//
+//	"size", "lineSize", "ways" -- the shape of each cache (see
+//		MemoryCache::MemoryCache)
+//	"penalty" -- the ticks charged for a miss
+//----------------------------------------------------------------------
+
+void
+Machine::SetCaches(int size, int lineSize, int ways, int penalty)
+{
+    ASSERT(icache == NULL);
+    icache = new MemoryCache(size, lineSize, ways);
+    dcache = new MemoryCache(size, lineSize, ways);
+    missPenalty = penalty;
+    timedMemory = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CacheAccess
+// 	Run a user access to physical address "physAddr" through the
+//	cache model, and count it, in all and for the current address
+//	space.  A miss is charged to the user program, straight to the
+//	clock, the way a context switch is: any interrupt that it makes
+//	due is taken at the next check.
+//
+// Returns:
+//	TRUE on a hit, FALSE on a miss.
+//
+//	"fetching" -- TRUE for an instruction fetch, FALSE for a load
+//		or store
+//	"physAddr" -- the address accessed
+//----------------------------------------------------------------------
+
+bool
+Machine::CacheAccess(bool fetching, int physAddr)
+{
+    bool hit = (fetching ? icache : dcache)->Access(physAddr);
+
+    if (fetching) {
+	stats->thisCPU->numL1Fetches++;
+	if (cacheCounts != NULL)
+	    cacheCounts->fetches++;
+    } else {
+	stats->thisCPU->numL1DataAccesses++;
+	if (cacheCounts != NULL)
+	    cacheCounts->dataAccesses++;
+    }
+    if (hit)
+	return TRUE;
+    if (fetching) {
+	stats->thisCPU->numL1FetchMisses++;
+	if (cacheCounts != NULL)
+	    cacheCounts->fetchMisses++;
+    } else {
+	stats->thisCPU->numL1DataMisses++;
+	if (cacheCounts != NULL)
+	    cacheCounts->dataMisses++;
+    }
+    stats->totalTicks += missPenalty;
+    stats->userTicks += missPenalty;
+    stats->thisCPU->numL1StallTicks += missPenalty;
+    return FALSE;
+}
@@ -0,0 +1,69 @@
+// memcache.h
+//	Data structures for the model of the L1 caches of the simulated
+//	MIPS processor.
+//
+//	By default, every user instruction costs the same, UserTick,
+//	wherever its code and data are.  With the cache model on, there
+//	are two L1 caches in front of mainMemory, one for instruction
+//	fetches and one for loads and stores, and every access that
+//	misses costs a further miss penalty, in ticks.  So a program
+//	with good locality (a blocked matrix multiply, say) runs in
+//	less simulated time than one without.
+//
+//	The caches are set-associative, with LRU replacement, and are
+//	indexed and tagged by physical address.  Only timing is modeled:
+//	the data always comes from mainMemory.  A store that misses
+//	allocates the line, just as a load does, and there is no charge
+//	for writing dirty lines back.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MEMCACHE_H
+#define MEMCACHE_H
+
+#include "copyright.h"
+
+// How many accesses went to each cache, and how many missed.  The
+// machine keeps one for every address space that asks for it (see
+// Machine::cacheCounts), as well as the totals in Statistics.
+
+class CacheCounts {
+  public:
+    CacheCounts();		// all zero, to begin with
+
+    void Print(const char *name);	// print the hit rates
+
+    int fetches;		// instruction fetches
+    int fetchMisses;		// ... that missed in the I-cache
+    int dataAccesses;		// loads and stores
+    int dataMisses;		// ... that missed in the D-cache
+};
+
+// The following class defines one set-associative cache.
+
+class MemoryCache {
+  public:
+    MemoryCache(int size, int lineSize, int ways);
+				// a cache of "size" bytes, in lines of
+				// "lineSize" bytes, "ways"-way associative
+    ~MemoryCache();
+
+    bool Access(int physAddr);	// look up (and, if it misses, bring in)
+				// the line holding "physAddr"; return
+				// TRUE if it was there
+    void Flush();		// empty the cache
+
+  private:
+    int lineShift;		// log2 of the line size
+    int numSets;		// sets in the cache
+    int ways;			// lines in each set
+    int *tags;			// the line address held in each way of
+				// each set, or -1 if none; most recently
+				// used first
+};
+
+#endif // MEMCACHE_H
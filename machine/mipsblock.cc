@@ -0,0 +1,808 @@
+// mipsblock.cc -- basic-block engine for the MIPS simulator
+//
+//   Runs straight-line user code a basic block at a time, by
+//   dispatching through a pre-linked list of per-instruction
+//   handlers, instead of fetching, decoding and switching on every
+//   instruction as Machine::OneInstruction does.
+//
+//   Each handler has exactly the same effect on the registers and
+//   memory as the corresponding case of OneInstruction, including
+//   the load delay slot: every handler finishes with DelayedLoad,
+//   just as OneInstruction does.  Branches, jumps, system calls,
+//   instructions that can overflow, and the partial-word loads and
+//   stores always end a block, and are run by OneInstruction.
+//
+//   Some common pairs of instructions are fused into one entry of a
+//   block (see mipsblock.h).  A fused handler does just what the
+//   handlers of its two instructions would, one after the other,
+//   with the program counters moved in between, so that an exception
+//   raised by the second leaves the machine exactly as if the pair
+//   had been run one at a time.
+//
+//   Blocks are keyed by the physical address of their first
+//   instruction, and never cross a page boundary, so that all the
+//   blocks that might contain a word can be found (and thrown away)
+//   from the frame the word is in.
+//
+//   DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "machine.h"
+#include "mipssim.h"
+#include "mipsblock.h"
+#include "mipsjit.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Block::Block, Block::~Block
+// 	Allocate and de-allocate room for the instructions of a block.
+//----------------------------------------------------------------------
+
+Block::Block(int len)
+{
+    length = len;
+    numInstrs = 0;
+    timesRun = 0;
+    code = NULL;
+    if (len > 0)
+	entries = new BlockEntry[len];
+    else
+	entries = NULL;
+}
+
+Block::~Block()
+{
+    if (entries != NULL)
+	delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// Instruction handlers
+//	One for each instruction that can appear inside a basic block.
+//	See the corresponding cases in Machine::OneInstruction.
+//----------------------------------------------------------------------
+
+#define R(n)	(m->registers[n])
+
+static bool
+DoAddiu(Machine *m, Instruction *instr)
+{
+    R(instr->rt) = R(instr->rs) + instr->extra;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoAddu(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rs) + R(instr->rt);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoAnd(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rs) & R(instr->rt);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoAndi(Machine *m, Instruction *instr)
+{
+    R(instr->rt) = R(instr->rs) & (instr->extra & 0xffff);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoDiv(Machine *m, Instruction *instr)
+{
+    if (R(instr->rt) == 0) {
+	R(LoReg) = 0;
+	R(HiReg) = 0;
+    } else {
+	R(LoReg) = R(instr->rs) / R(instr->rt);
+	R(HiReg) = R(instr->rs) % R(instr->rt);
+    }
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoDivu(Machine *m, Instruction *instr)
+{
+    unsigned int rs = (unsigned int) R(instr->rs);
+    unsigned int rt = (unsigned int) R(instr->rt);
+    int tmp;
+
+    if (rt == 0) {
+	R(LoReg) = 0;
+	R(HiReg) = 0;
+    } else {
+	tmp = rs / rt;
+	R(LoReg) = (int) tmp;
+	tmp = rs % rt;
+	R(HiReg) = (int) tmp;
+    }
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoLb(Machine *m, Instruction *instr)
+{
+    int value;
+
+    if (!m->ReadMem(R(instr->rs) + instr->extra, 1, &value))
+	return FALSE;
+    if ((value & 0x80) && (instr->opCode == OP_LB))
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    m->DelayedLoad(instr->rt, value);
+    return TRUE;
+}
+
+static bool
+DoLh(Machine *m, Instruction *instr)
+{
+    int tmp = R(instr->rs) + instr->extra;
+    int value;
+
+    if (tmp & 0x1) {
+	m->RaiseException(AddressErrorException, tmp);
+	return FALSE;
+    }
+    if (!m->ReadMem(tmp, 2, &value))
+	return FALSE;
+    if ((value & 0x8000) && (instr->opCode == OP_LH))
+	value |= 0xffff0000;
+    else
+	value &= 0xffff;
+    m->DelayedLoad(instr->rt, value);
+    return TRUE;
+}
+
+static bool
+DoLui(Machine *m, Instruction *instr)
+{
+    R(instr->rt) = instr->extra << 16;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoLw(Machine *m, Instruction *instr)
+{
+    int tmp = R(instr->rs) + instr->extra;
+    int value;
+
+    if (tmp & 0x3) {
+	m->RaiseException(AddressErrorException, tmp);
+	return FALSE;
+    }
+    if (!m->ReadMem(tmp, 4, &value))
+	return FALSE;
+    m->DelayedLoad(instr->rt, value);
+    return TRUE;
+}
+
+static bool
+DoMfhi(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(HiReg);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoMflo(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(LoReg);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoMthi(Machine *m, Instruction *instr)
+{
+    R(HiReg) = R(instr->rs);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoMtlo(Machine *m, Instruction *instr)
+{
+    R(LoReg) = R(instr->rs);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoMult(Machine *m, Instruction *instr)
+{
+    Mult(R(instr->rs), R(instr->rt), TRUE, &R(HiReg), &R(LoReg));
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoMultu(Machine *m, Instruction *instr)
+{
+    Mult(R(instr->rs), R(instr->rt), FALSE, &R(HiReg), &R(LoReg));
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoNor(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = ~(R(instr->rs) | R(instr->rt));
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoOr(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rs) | R(instr->rs);	// as in OneInstruction
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoOri(Machine *m, Instruction *instr)
+{
+    R(instr->rt) = R(instr->rs) | (instr->extra & 0xffff);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSb(Machine *m, Instruction *instr)
+{
+    if (!m->WriteMem((unsigned) (R(instr->rs) + instr->extra), 1,
+							R(instr->rt)))
+	return FALSE;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSh(Machine *m, Instruction *instr)
+{
+    if (!m->WriteMem((unsigned) (R(instr->rs) + instr->extra), 2,
+							R(instr->rt)))
+	return FALSE;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSll(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rt) << instr->extra;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSllv(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rt) << (R(instr->rs) & 0x1f);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSlt(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = (R(instr->rs) < R(instr->rt)) ? 1 : 0;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSlti(Machine *m, Instruction *instr)
+{
+    R(instr->rt) = (R(instr->rs) < instr->extra) ? 1 : 0;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSltiu(Machine *m, Instruction *instr)
+{
+    unsigned int rs = R(instr->rs);
+    unsigned int imm = instr->extra;
+
+    R(instr->rt) = (rs < imm) ? 1 : 0;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSltu(Machine *m, Instruction *instr)
+{
+    unsigned int rs = R(instr->rs);
+    unsigned int rt = R(instr->rt);
+
+    R(instr->rd) = (rs < rt) ? 1 : 0;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSra(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rt) >> instr->extra;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSrav(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rt) >> (R(instr->rs) & 0x1f);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSrl(Machine *m, Instruction *instr)
+{
+    int tmp = R(instr->rt);		// as in OneInstruction
+
+    tmp >>= instr->extra;
+    R(instr->rd) = tmp;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSrlv(Machine *m, Instruction *instr)
+{
+    int tmp = R(instr->rt);		// as in OneInstruction
+
+    tmp >>= (R(instr->rs) & 0x1f);
+    R(instr->rd) = tmp;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSubu(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rs) - R(instr->rt);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoSw(Machine *m, Instruction *instr)
+{
+    if (!m->WriteMem((unsigned) (R(instr->rs) + instr->extra), 4,
+							R(instr->rt)))
+	return FALSE;
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoXor(Machine *m, Instruction *instr)
+{
+    R(instr->rd) = R(instr->rs) ^ R(instr->rt);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+static bool
+DoXori(Machine *m, Instruction *instr)
+{
+    R(instr->rt) = R(instr->rs) ^ (instr->extra & 0xffff);
+    m->DelayedLoad(0, 0);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Fused pair handlers
+//	One for each pair of instructions run as one entry of a block
+//	(see FusedHandlerFor).  "instr" points to the two instructions;
+//	each is finished, load delay slot and all, and the PCs moved past
+//	it, before the next one starts.
+//----------------------------------------------------------------------
+
+static void
+Step(Machine *m)
+{
+    R(PrevPCReg) = R(PCReg);
+    R(PCReg) = R(NextPCReg);
+    R(NextPCReg) += 4;
+}
+
+static void
+Branch(Machine *m, Instruction *instr)
+{
+    int pcAfter = R(NextPCReg) + 4;
+    bool taken = (instr->opCode == OP_BEQ) ?
+	(bool)(R(instr->rs) == R(instr->rt)) :
+	(bool)(R(instr->rs) != R(instr->rt));
+
+    if (taken)
+	pcAfter = R(NextPCReg) + IndexToAddr(instr->extra);
+    m->DelayedLoad(0, 0);
+    R(PrevPCReg) = R(PCReg);
+    R(PCReg) = R(NextPCReg);
+    R(NextPCReg) = pcAfter;
+}
+
+static bool
+DoLuiOri(Machine *m, Instruction *instr)
+{
+    R(instr[0].rt) = instr[0].extra << 16;
+    m->DelayedLoad(0, 0);
+    Step(m);
+    R(instr[1].rt) = R(instr[1].rs) | (instr[1].extra & 0xffff);
+    m->DelayedLoad(0, 0);
+    Step(m);
+    return TRUE;
+}
+
+static bool
+DoAddiuLw(Machine *m, Instruction *instr)
+{
+    R(instr[0].rt) = R(instr[0].rs) + instr[0].extra;
+    m->DelayedLoad(0, 0);
+    Step(m);
+    if (!DoLw(m, &instr[1]))
+	return FALSE;
+    Step(m);
+    return TRUE;
+}
+
+static bool
+DoAddiuSw(Machine *m, Instruction *instr)
+{
+    R(instr[0].rt) = R(instr[0].rs) + instr[0].extra;
+    m->DelayedLoad(0, 0);
+    Step(m);
+    if (!DoSw(m, &instr[1]))
+	return FALSE;
+    Step(m);
+    return TRUE;
+}
+
+static bool
+DoSltBranch(Machine *m, Instruction *instr)
+{
+    R(instr[0].rd) = (R(instr[0].rs) < R(instr[0].rt)) ? 1 : 0;
+    m->DelayedLoad(0, 0);
+    Step(m);
+    Branch(m, &instr[1]);
+    return TRUE;
+}
+
+static bool
+DoSltiBranch(Machine *m, Instruction *instr)
+{
+    R(instr[0].rt) = (R(instr[0].rs) < instr[0].extra) ? 1 : 0;
+    m->DelayedLoad(0, 0);
+    Step(m);
+    Branch(m, &instr[1]);
+    return TRUE;
+}
+
+static bool
+DoSltiuBranch(Machine *m, Instruction *instr)
+{
+    unsigned int rs = R(instr[0].rs);
+    unsigned int imm = instr[0].extra;
+
+    R(instr[0].rt) = (rs < imm) ? 1 : 0;
+    m->DelayedLoad(0, 0);
+    Step(m);
+    Branch(m, &instr[1]);
+    return TRUE;
+}
+
+static bool
+DoSltuBranch(Machine *m, Instruction *instr)
+{
+    unsigned int rs = R(instr[0].rs);
+    unsigned int rt = R(instr[0].rt);
+
+    R(instr[0].rd) = (rs < rt) ? 1 : 0;
+    m->DelayedLoad(0, 0);
+    Step(m);
+    Branch(m, &instr[1]);
+    return TRUE;
+}
+
+#undef R
+
+//----------------------------------------------------------------------
+// FusedHandlerFor
+// 	Return the routine that runs "first" and "second", the next
+//	instruction, as one fused entry of a block, or NULL if they
+//	aren't one of the pairs we fuse:
+//
+//	    lui rt, hi; ori rt, rt, lo		-- a 32-bit constant
+//	    addiu rt, rs, n; lw/sw x, m(rt)	-- say, push or pop a frame
+//	    slt[i][u] rd, ...; beq/bne rd, ...	-- compare and branch
+//----------------------------------------------------------------------
+
+static InstrHandler
+FusedHandlerFor(Instruction *first, Instruction *second)
+{
+    switch (first->opCode) {
+      case OP_LUI:
+	if ((second->opCode == OP_ORI) && (second->rs == first->rt))
+	    return DoLuiOri;
+	break;
+      case OP_ADDIU:
+	if ((second->opCode == OP_LW) && (second->rs == first->rt))
+	    return DoAddiuLw;
+	if ((second->opCode == OP_SW) && (second->rs == first->rt))
+	    return DoAddiuSw;
+	break;
+      case OP_SLT:
+      case OP_SLTU:
+	if (((second->opCode == OP_BEQ) || (second->opCode == OP_BNE))
+		&& ((second->rs == first->rd) || (second->rt == first->rd)))
+	    return (first->opCode == OP_SLT) ? DoSltBranch : DoSltuBranch;
+	break;
+      case OP_SLTI:
+      case OP_SLTIU:
+	if (((second->opCode == OP_BEQ) || (second->opCode == OP_BNE))
+		&& ((second->rs == first->rt) || (second->rt == first->rt)))
+	    return (first->opCode == OP_SLTI) ? DoSltiBranch : DoSltiuBranch;
+	break;
+      default:
+	break;
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// HandlerFor
+// 	Return the routine that runs "opCode" inside a basic block, or
+//	NULL if the instruction must end the block (because it changes
+//	the flow of control, traps to the kernel, or is one of the
+//	rarely used partial-word loads and stores).
+//----------------------------------------------------------------------
+
+static InstrHandler
+HandlerFor(int opCode)
+{
+    switch (opCode) {
+      case OP_ADDIU:	return DoAddiu;
+      case OP_ADDU:	return DoAddu;
+      case OP_AND:	return DoAnd;
+      case OP_ANDI:	return DoAndi;
+      case OP_DIV:	return DoDiv;
+      case OP_DIVU:	return DoDivu;
+      case OP_LB:
+      case OP_LBU:	return DoLb;
+      case OP_LH:
+      case OP_LHU:	return DoLh;
+      case OP_LUI:	return DoLui;
+      case OP_LW:	return DoLw;
+      case OP_MFHI:	return DoMfhi;
+      case OP_MFLO:	return DoMflo;
+      case OP_MTHI:	return DoMthi;
+      case OP_MTLO:	return DoMtlo;
+      case OP_MULT:	return DoMult;
+      case OP_MULTU:	return DoMultu;
+      case OP_NOR:	return DoNor;
+      case OP_OR:	return DoOr;
+      case OP_ORI:	return DoOri;
+      case OP_SB:	return DoSb;
+      case OP_SH:	return DoSh;
+      case OP_SLL:	return DoSll;
+      case OP_SLLV:	return DoSllv;
+      case OP_SLT:	return DoSlt;
+      case OP_SLTI:	return DoSlti;
+      case OP_SLTIU:	return DoSltiu;
+      case OP_SLTU:	return DoSltu;
+      case OP_SRA:	return DoSra;
+      case OP_SRAV:	return DoSrav;
+      case OP_SRL:	return DoSrl;
+      case OP_SRLV:	return DoSrlv;
+      case OP_SUBU:	return DoSubu;
+      case OP_SW:	return DoSw;
+      case OP_XOR:	return DoXor;
+      case OP_XORI:	return DoXori;
+      default:		return NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateBlock
+// 	Build the basic block that starts at physical address "physAddr",
+//	and remember it in the block table.  The block ends just before
+//	the first instruction that has no handler, or at the end of the
+//	page, whichever comes first -- or just after a fused compare and
+//	branch.  Pairs are fused as we go, so long as both instructions
+//	are in the page.
+//
+//	"physAddr" -- the physical address of the first instruction
+//----------------------------------------------------------------------
+
+Block *
+Machine::TranslateBlock(int physAddr)
+{
+    int pageEnd = (physAddr / PageSize + 1) * PageSize;
+    BlockEntry entries[PageSize / 4];
+    Block *block;
+    int len, addr;
+
+    for (len = 0, addr = physAddr; addr < pageEnd; len++, addr += 4) {
+	BlockEntry *entry = &entries[len];
+
+	entry->instr[0].value =
+			WordToHost(*(unsigned int *) &mainMemory[addr]);
+	entry->instr[0].Decode();
+	entry->length = 1;
+	if (addr + 4 < pageEnd) {
+	    entry->instr[1].value =
+			WordToHost(*(unsigned int *) &mainMemory[addr + 4]);
+	    entry->instr[1].Decode();
+	    entry->handler = FusedHandlerFor(&entry->instr[0],
+						&entry->instr[1]);
+	    if (entry->handler != NULL) {
+		entry->length = 2;
+		addr += 4;
+		if ((entry->instr[1].opCode == OP_BEQ)
+			|| (entry->instr[1].opCode == OP_BNE)) {
+		    len++;			// a branch ends the block
+		    break;
+		}
+		continue;
+	    }
+	}
+	entry->handler = HandlerFor(entry->instr[0].opCode);
+	if (entry->handler == NULL)
+	    break;
+    }
+
+    block = new Block(len);
+    for (int i = 0; i < len; i++) {
+	block->entries[i] = entries[i];
+	block->numInstrs += entries[i].length;
+    }
+    DEBUG('m', "Translated block at physical 0x%x, %d entries\n",
+						physAddr, len);
+
+    blockTable[physAddr / 4] = block;
+    blocksInFrame[physAddr / PageSize]++;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Run the basic block starting at the current PC, translating it
+//	first if need be.
+//
+//	We stop early if an instruction raises an exception (the kernel
+//	has already been called, and the PC is left pointing at the
+//	instruction, just as with OneInstruction), or if the block itself
+//	was thrown away because the program stored into its page.
+//
+//	If the PC is in a branch delay slot, or can't be translated, we
+//	do nothing, and leave it to OneInstruction.
+//
+//	With the JIT on, a block is compiled once it has been run
+//	JitThreshold times, and from then on its host code is run
+//	instead, whenever the whole block fits in "maxCount" (see
+//	mipsjit.cc).  Compiled code doesn't count instructions, or charge
+//	for fetching them, so when the simulator is built with
+//	-DINSTR_STATS, or memory accesses are timed (see ChargeAccess),
+//	it is never run.
+//
+//	"maxCount" -- run no more than this many instructions (the rest
+//		of the block is run next time; a fused pair that would go
+//		over is left for next time, too)
+//
+// Returns:
+//	The number of instructions executed, counting one that raised
+//	an exception, so the caller can charge the right number of ticks.
+//	Both instructions of a fused pair count, each for its own tick.
+//----------------------------------------------------------------------
+
+int
+Machine::RunBlock(int maxCount)
+{
+    int physAddr;
+    int flushes = numBlockFlushes;
+    Block *block;
+
+    if (registers[NextPCReg] != registers[PCReg] + 4)	// delay slot
+	return 0;
+    if (Translate(registers[PCReg], &physAddr, 4, FALSE, TRUE) != NoException)
+	return 0;
+    block = blockTable[physAddr / 4];
+    if (block == NULL)
+	block = TranslateBlock(physAddr);
+#ifndef INSTR_STATS
+    if ((codeCache != NULL) && !timedMemory && (block->length > 0)) {
+	if ((block->code == NULL) && (++block->timesRun >= JitThreshold))
+	    CompileBlock(block);
+	if ((block->code != NULL) && (block->numInstrs <= maxCount)) {
+	    int numRun;
+
+	    jitActive++;
+	    numRun = (*block->code)();
+	    jitActive--;
+	    return numRun;
+	}
+    }
+#endif
+
+    int numRun = 0;
+    BlockEntry *entry = block->entries;
+    for (int i = 0; i < block->length; i++, entry++) {
+	int length = entry->length;
+
+	if (numRun + length > maxCount)
+	    break;
+	if (timedMemory)
+	    for (int j = 0; j < length; j++)
+		ChargeAccess(TRUE, physAddr + (numRun + j) * 4);
+#ifdef INSTR_STATS
+	unsigned long long start = HostCycles();
+#endif
+	if (!(*entry->handler)(this, entry->instr))
+	    return numRun + length;		// exception
+	numRun += length;
+#ifdef INSTR_STATS
+	unsigned long long cycles = HostCycles() - start;
+	bool taken = (bool)(registers[NextPCReg] != registers[PCReg] + 4);
+
+	for (int j = 0; j < length; j++)
+	    CountInstruction(entry->instr[j].opCode, taken, cycles / length);
+	stats->numBlockInstrs += length;
+	if (length > 1)
+	    stats->numFusedInstrs += length;
+#endif
+	if (length == 1) {			// a fused pair moves them itself
+	    registers[PrevPCReg] = registers[PCReg];
+	    registers[PCReg] += 4;
+	    registers[NextPCReg] += 4;
+	}
+	if (numBlockFlushes != flushes)		// "block" may be gone
+	    break;
+    }
+    return numRun;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushBlocks
+// 	Throw away every translated block that starts in physical page
+//	"frame".  Since blocks never cross a page boundary, this includes
+//	every block that contains an instruction in the page.
+//
+//	"frame" -- the physical page that has changed
+//----------------------------------------------------------------------
+
+void
+Machine::FlushBlocks(int frame)
+{
+    int first = frame * PageSize / 4;
+
+    for (int i = first; i < first + PageSize / 4; i++) {
+	if (blockTable[i] != NULL) {
+	    delete blockTable[i];
+	    blockTable[i] = NULL;
+	}
+    }
+    blocksInFrame[frame] = 0;
+    numBlockFlushes++;
+}
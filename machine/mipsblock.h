@@ -0,0 +1,82 @@
+// mipsblock.h
+//	Data structures for the basic-block ("threaded code") execution
+//	engine of the MIPS simulator.
+//
+//	A basic block is a run of straight-line user instructions
+//	(no branches, jumps, system calls or other traps) that starts
+//	at a given physical address and does not cross a page boundary.
+//	The first time a block is executed, each of its instructions is
+//	decoded and paired with the routine that simulates it; after
+//	that, running the block is just a walk down the pre-linked list
+//	of handlers, with no fetch, no decode and no switch.
+//
+//	A few pairs of instructions that gcc emits all the time are fused
+//	into one entry, run by one handler: a constant built by lui and
+//	ori, a stack pointer (or other base) adjusted by addiu and then
+//	used by a load or store, and a compare (slt and friends) followed
+//	by the beq or bne that tests it.  A fused compare-and-branch ends
+//	its block; the delay slot is run next, as for any other branch.
+//	The first of a fused pair can never raise an exception, so if one
+//	is raised, it is by the second, once the first has finished.
+//
+//	Anything the block engine does not handle is left to the precise
+//	interpreter in Machine::OneInstruction.
+//
+//	With the JIT on, a block that has been run often enough is also
+//	compiled to host code (see mipsjit.cc), which is run in place of
+//	the walk down its handlers whenever the whole block fits.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MIPSBLOCK_H
+#define MIPSBLOCK_H
+
+#include "copyright.h"
+#include "machine.h"
+
+// The routine that simulates a single instruction of a block.
+// Returns FALSE if the instruction raised an exception, in which case
+// the program counters have not been advanced, so the instruction
+// will be re-started once the kernel has handled the exception.
+//
+// The routine for a fused pair is passed both instructions, and moves
+// the program counters past each one itself, as it finishes it.
+
+typedef bool (*InstrHandler)(Machine *m, Instruction *instr);
+
+// One instruction of a block, or a fused pair: its decoded form, and
+// how to run it.
+
+class BlockEntry {
+  public:
+    InstrHandler handler;	// routine to simulate the instruction(s)
+    int length;			// 1, or 2 for a fused pair
+    Instruction instr[2];	// the decoded instruction(s)
+};
+
+// A block compiled to host code.  Runs the whole block, and returns
+// the number of instructions it ran, just as Machine::RunBlock does.
+
+typedef int (*BlockCode)(void);
+
+// The following class defines a translated basic block.  A block of
+// length 0 records that the instruction at this address has to be
+// run by the interpreter, so we don't try to translate it again.
+
+class Block {
+  public:
+    Block(int len);		// allocate room for "len" instructions
+    ~Block();
+
+    int length;			// number of entries in the block
+    BlockEntry *entries;	// the instructions, in program order
+    int numInstrs;		// instructions in it (a fused pair is two)
+    int timesRun;		// how often it has been run, until compiled
+    BlockCode code;		// its host code, or NULL if not compiled
+};
+
+#endif // MIPSBLOCK_H
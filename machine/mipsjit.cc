@@ -0,0 +1,358 @@
+// mipsjit.cc -- JIT tier of the MIPS simulator
+//
+//   Compiles hot basic blocks (see mipsblock.cc) to host code.  There
+//   is no register allocation and no optimization across instructions:
+//   each entry of a block becomes a copy of a pre-assembled template,
+//   with the addresses of the simulated registers and the decoded
+//   fields of the instruction filled in, so the compiled block is just
+//   the walk down its handlers with the dispatch taken out -- and,
+//   for the simple ALU instructions, the handler call as well.
+//
+//   The compiled code has exactly the same effect as RunBlock running
+//   the whole block: each template finishes with the load delay slot
+//   and moves the program counters just as the handler and RunBlock
+//   would, in the same order.  An instruction that can raise an
+//   exception is always run by calling its handler, and if it does,
+//   the code returns at once, with the PC left on it, and the number
+//   of instructions run counting it -- just as RunBlock returns.
+//   After a store, the code checks whether the store threw away any
+//   blocks, and if so returns, since it may have thrown away this one.
+//
+//   The templates are written out byte by byte as 32-bit x86 machine
+//   code.  Every simulated register is addressed absolutely, since
+//   there is only one Machine; the code is called with no arguments,
+//   and returns in eax.  It keeps the count of instructions run in
+//   edi, and numBlockFlushes as it was on entry in esi; both are
+//   callee-saved, so the handlers leave them alone.
+//
+//   DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "machine.h"
+#include "mipssim.h"
+#include "mipsblock.h"
+#include "mipsjit.h"
+#include "system.h"
+
+#if defined(HOST_i386) && defined(__i386__)
+#define JIT_HOST		// we have templates for this host
+#endif
+
+#define MaxPrologue	16	// bytes of code before the first entry,
+#define MaxEpilogue	16	// after the last,
+#define MaxEntryCode	128	// and for any one entry
+
+//----------------------------------------------------------------------
+// CodeCache::CodeCache, CodeCache::~CodeCache
+// 	Allocate and de-allocate the memory the code goes in.  If the
+//	host won't let us have any, the cache is left unusable.
+//
+//	"cacheSize" -- how many bytes of code it can hold
+//----------------------------------------------------------------------
+
+CodeCache::CodeCache(int cacheSize)
+{
+    base = AllocExecutable(cacheSize);
+    size = cacheSize;
+    used = 0;
+}
+
+CodeCache::~CodeCache()
+{
+    if (base != NULL)
+	FreeExecutable(base, size);
+}
+
+//----------------------------------------------------------------------
+// CodeCache::Allocate
+// 	Hand out room for "bytes" bytes of code, or return NULL if there
+//	isn't that much left.
+//----------------------------------------------------------------------
+
+char *
+CodeCache::Allocate(int bytes)
+{
+    char *room;
+
+    if ((base == NULL) || (used + bytes > size))
+	return NULL;
+    room = base + used;
+    used += bytes;
+    return room;
+}
+
+//----------------------------------------------------------------------
+// CodeCache::Reset
+// 	Take back all the room handed out.  The caller must make sure
+//	none of the code in it is ever run again.
+//----------------------------------------------------------------------
+
+void
+CodeCache::Reset()
+{
+    used = 0;
+}
+
+#ifdef JIT_HOST
+
+//----------------------------------------------------------------------
+// Emitter
+//	Writes out host code, a byte or a word at a time, and remembers
+//	the jumps to the exit of the block, to be patched once we know
+//	where it is.
+//----------------------------------------------------------------------
+
+class Emitter {
+  public:
+    Emitter(char *where) { start = next = where; numExits = 0; }
+
+    void Byte(int b) { *next++ = (char) b; }
+    void Word(unsigned int w) { *(unsigned int *) next = w; next += 4; }
+    void Addr(void *p) { Word((unsigned int) p); }
+    void JumpToExit(int condition)	// jz or jnz to the exit
+	{ Byte(0x0f); Byte(condition); exits[numExits++] = next; Word(0); }
+    void PatchExits();		// point the jumps at the code here
+
+    char *start;		// where the code starts
+    char *next;			// where the next byte goes
+
+  private:
+    char *exits[PageSize / 4];	// the jumps to patch (one per entry)
+    int numExits;
+};
+
+void
+Emitter::PatchExits()
+{
+    for (int i = 0; i < numExits; i++)
+	*(int *) exits[i] = next - (exits[i] + 4);
+}
+
+#define JZ	0x84
+#define JNZ	0x85
+
+// The templates.  "R(n)" is the address of simulated register n.
+
+#define R(n)	((void *) &registers[n])
+
+//----------------------------------------------------------------------
+// InlineALU
+// 	Write out the template that does "instr" in line, if it has one:
+//	computes the result in eax, and stores it into its register.
+//	Returns FALSE if the instruction has no such template.
+//----------------------------------------------------------------------
+
+static bool
+InlineALU(Emitter *e, int *registers, Instruction *instr)
+{
+    switch (instr->opCode) {
+      case OP_ADDIU:		// mov eax, rs; add eax, imm
+	e->Byte(0xa1); e->Addr(R(instr->rs));
+	e->Byte(0x05); e->Word(instr->extra);
+	e->Byte(0xa3); e->Addr(R(instr->rt));
+	return TRUE;
+      case OP_ANDI:		// mov eax, rs; and eax, imm
+      case OP_ORI:		// ... or eax, imm
+      case OP_XORI:		// ... xor eax, imm
+	e->Byte(0xa1); e->Addr(R(instr->rs));
+	e->Byte((instr->opCode == OP_ANDI) ? 0x25 :
+		(instr->opCode == OP_ORI) ? 0x0d : 0x35);
+	e->Word(instr->extra & 0xffff);
+	e->Byte(0xa3); e->Addr(R(instr->rt));
+	return TRUE;
+      case OP_LUI:		// mov eax, imm << 16
+	e->Byte(0xb8); e->Word(instr->extra << 16);
+	e->Byte(0xa3); e->Addr(R(instr->rt));
+	return TRUE;
+      case OP_ADDU:		// mov eax, rs; add eax, rt
+      case OP_SUBU:		// ... sub eax, rt
+      case OP_AND:		// ... and eax, rt
+      case OP_XOR:		// ... xor eax, rt
+	e->Byte(0xa1); e->Addr(R(instr->rs));
+	e->Byte((instr->opCode == OP_ADDU) ? 0x03 :
+		(instr->opCode == OP_SUBU) ? 0x2b :
+		(instr->opCode == OP_AND) ? 0x23 : 0x33);
+	e->Byte(0x05); e->Addr(R(instr->rt));
+	e->Byte(0xa3); e->Addr(R(instr->rd));
+	return TRUE;
+      case OP_NOR:		// mov eax, rs; or eax, rt; not eax
+	e->Byte(0xa1); e->Addr(R(instr->rs));
+	e->Byte(0x0b); e->Byte(0x05); e->Addr(R(instr->rt));
+	e->Byte(0xf7); e->Byte(0xd0);
+	e->Byte(0xa3); e->Addr(R(instr->rd));
+	return TRUE;
+      case OP_OR:		// mov eax, rs (as in OneInstruction)
+	e->Byte(0xa1); e->Addr(R(instr->rs));
+	e->Byte(0xa3); e->Addr(R(instr->rd));
+	return TRUE;
+      case OP_SLL:		// mov eax, rt; shl eax, sa
+      case OP_SRA:		// ... sar eax, sa
+      case OP_SRL:		// ... sar eax, sa (as in OneInstruction)
+	e->Byte(0xa1); e->Addr(R(instr->rt));
+	e->Byte(0xc1); e->Byte((instr->opCode == OP_SLL) ? 0xe0 : 0xf8);
+	e->Byte(instr->extra);
+	e->Byte(0xa3); e->Addr(R(instr->rd));
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// DelayedLoadCode
+// 	Write out Machine::DelayedLoad(0, 0), in line.
+//----------------------------------------------------------------------
+
+static void
+DelayedLoadCode(Emitter *e, int *registers)
+{
+    e->Byte(0xa1); e->Addr(R(LoadValueReg));	// mov eax, [LoadValueReg]
+    e->Byte(0x8b); e->Byte(0x0d); e->Addr(R(LoadReg));
+						// mov ecx, [LoadReg]
+    e->Byte(0x89); e->Byte(0x04); e->Byte(0x8d); e->Addr(R(0));
+						// mov [R(0) + ecx * 4], eax
+    e->Byte(0xc7); e->Byte(0x05); e->Addr(R(LoadReg)); e->Word(0);
+    e->Byte(0xc7); e->Byte(0x05); e->Addr(R(LoadValueReg)); e->Word(0);
+    e->Byte(0xc7); e->Byte(0x05); e->Addr(R(0)); e->Word(0);
+}
+
+//----------------------------------------------------------------------
+// AdvancePCCode
+// 	Write out what RunBlock does after running an unfused entry:
+//	move the program counters on by one instruction.
+//----------------------------------------------------------------------
+
+static void
+AdvancePCCode(Emitter *e, int *registers)
+{
+    e->Byte(0xa1); e->Addr(R(PCReg));		// mov eax, [PCReg]
+    e->Byte(0xa3); e->Addr(R(PrevPCReg));	// mov [PrevPCReg], eax
+    e->Byte(0x83); e->Byte(0x05); e->Addr(R(PCReg)); e->Byte(4);
+    e->Byte(0x83); e->Byte(0x05); e->Addr(R(NextPCReg)); e->Byte(4);
+						// add [PCReg], 4 ...
+}
+
+#undef R
+
+#endif // JIT_HOST
+
+//----------------------------------------------------------------------
+// Machine::EnableJIT
+// 	Turn the JIT on: from now on, hot basic blocks are compiled.
+//	Needs the basic-block engine; does nothing (but say so) if this
+//	host has no templates, or won't give us a code cache.
+//----------------------------------------------------------------------
+
+void
+Machine::EnableJIT()
+{
+    ASSERT(blockTable != NULL);
+#ifdef JIT_HOST
+    codeCache = new CodeCache(CodeCacheSize);
+    if (!codeCache->IsUsable()) {
+	delete codeCache;
+	codeCache = NULL;
+    }
+#endif
+    if (codeCache == NULL)
+	printf("No JIT on this host, running threaded code only\n");
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushCodeCache
+// 	Throw away the host code of every block, and take back the room
+//	in the code cache.  The blocks themselves are kept, and start
+//	counting again towards being compiled.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushCodeCache()
+{
+    ASSERT(jitActive == 0);
+    for (int i = 0; i < MemorySize / 4; i++)
+	if (blockTable[i] != NULL) {
+	    blockTable[i]->code = NULL;
+	    blockTable[i]->timesRun = 0;
+	}
+    codeCache->Reset();
+    stats->numCodeCacheFlushes++;
+}
+
+//----------------------------------------------------------------------
+// Machine::CompileBlock
+// 	Compile "block" to host code, if we can.  If the code cache is
+//	full, we flush it first -- unless some thread is still in the
+//	middle of compiled code (having trapped to the kernel from a
+//	handler, say), in which case the block stays threaded for now.
+//----------------------------------------------------------------------
+
+void
+Machine::CompileBlock(Block *block)
+{
+#ifdef JIT_HOST
+    int bytes = MaxPrologue + block->length * MaxEntryCode + MaxEpilogue;
+    char *where = codeCache->Allocate(bytes);
+    int numRun = 0;
+
+    if (where == NULL) {
+	if (jitActive > 0)
+	    return;
+	FlushCodeCache();
+	where = codeCache->Allocate(bytes);
+	ASSERT(where != NULL);
+    }
+
+    Emitter e(where);
+
+    e.Byte(0x55);				// push ebp
+    e.Byte(0x89); e.Byte(0xe5);			// mov ebp, esp
+    e.Byte(0x56); e.Byte(0x57);			// push esi; push edi
+    e.Byte(0x83); e.Byte(0xec); e.Byte(0x10);	// sub esp, 16 (aligned)
+    e.Byte(0x8b); e.Byte(0x35); e.Addr(&numBlockFlushes);
+						// mov esi, [numBlockFlushes]
+
+    BlockEntry *entry = block->entries;
+    for (int i = 0; i < block->length; i++, entry++) {
+	int last = entry->instr[entry->length - 1].opCode;
+
+	numRun += entry->length;
+	e.Byte(0xbf); e.Word(numRun);		// mov edi, numRun
+	if ((entry->length == 1)
+		&& InlineALU(&e, registers, &entry->instr[0]))
+	    DelayedLoadCode(&e, registers);
+	else {
+	    e.Byte(0xc7); e.Byte(0x04); e.Byte(0x24); e.Addr(this);
+						// mov [esp], this
+	    e.Byte(0xc7); e.Byte(0x44); e.Byte(0x24); e.Byte(0x04);
+	    e.Addr(entry->instr);		// mov [esp + 4], instr
+	    e.Byte(0xb8); e.Addr((void *) entry->handler);
+	    e.Byte(0xff); e.Byte(0xd0);		// call handler
+	    e.Byte(0x84); e.Byte(0xc0);		// test al, al
+	    e.JumpToExit(JZ);			// exception: leave
+	}
+	if (entry->length == 1)
+	    AdvancePCCode(&e, registers);
+	if ((last == OP_SB) || (last == OP_SH) || (last == OP_SW)) {
+	    e.Byte(0x3b); e.Byte(0x35); e.Addr(&numBlockFlushes);
+	    e.JumpToExit(JNZ);			// cmp esi, [numBlockFlushes]
+	}
+	ASSERT(e.next - e.start <= MaxPrologue + (i + 1) * MaxEntryCode);
+    }
+
+    e.PatchExits();
+    e.Byte(0x89); e.Byte(0xf8);			// mov eax, edi
+    e.Byte(0x83); e.Byte(0xc4); e.Byte(0x10);	// add esp, 16
+    e.Byte(0x5f); e.Byte(0x5e); e.Byte(0x5d);	// pop edi; pop esi; pop ebp
+    e.Byte(0xc3);				// ret
+
+    block->code = (BlockCode) where;
+    stats->numBlocksCompiled++;
+    DEBUG('m', "Compiled block of %d instructions, %d bytes of code\n",
+					block->numInstrs, e.next - e.start);
+#endif // JIT_HOST
+}
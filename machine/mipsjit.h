@@ -0,0 +1,56 @@
+// mipsjit.h
+//	Data structures for the JIT of the MIPS simulator: the tier above
+//	the basic-block engine (mipsblock.h).
+//
+//	A basic block that has been run JitThreshold times is compiled to
+//	host code, by stitching together a pre-assembled template for
+//	each of its entries.  The commonest register-to-register
+//	instructions get a template that does the work in line; the rest
+//	get one that calls the entry's handler, and leaves the compiled
+//	code if it raised an exception, so exceptions stay precise.
+//
+//	The code goes in a code cache, a fixed-size area of host memory
+//	that the host lets us run.  The code for a block goes when the
+//	block does -- when the program stores into its page -- but the
+//	room it took is only reclaimed when the cache fills up, and all
+//	of it is thrown away at once.
+//
+//	Only an x86 host running the 32-bit simulator has templates; on
+//	any other, the JIT stays off, and blocks are only ever threaded.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MIPSJIT_H
+#define MIPSJIT_H
+
+#include "copyright.h"
+
+#define JitThreshold	50	// times a block is run before it is compiled
+#define CodeCacheSize	(1024 * 1024)	// bytes of host code we can hold
+
+// The following class defines the code cache: host memory that code
+// is compiled into, handed out a piece at a time, and only ever taken
+// back all at once.
+
+class CodeCache {
+  public:
+    CodeCache(int size);	// allocate "size" bytes of executable memory
+    ~CodeCache();
+
+    bool IsUsable() { return (bool)(base != NULL); }
+				// did the host give us the memory?
+    char *Allocate(int size);	// room for "size" bytes of code, or
+				// NULL if the cache is full
+    void Reset();		// take all the room back
+
+  private:
+    char *base;			// the memory, or NULL if none
+    int size;			// how big it is
+    int used;			// how much of it has been handed out
+};
+
+#endif // MIPSJIT_H
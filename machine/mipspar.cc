@@ -0,0 +1,298 @@
+// mipspar.cc -- parallel mode of the MIPS simulator
+//
+//   With -hp and more than one CPU (-smp), the simulated CPUs other
+//   than the running one get a helper: a Machine of its own, sharing
+//   the main one's memory, run on a host thread of its own.  Whenever
+//   the running thread has a window of user code to run before any
+//   interrupt can be due -- at least MinParallelWindow instructions --
+//   the thread each other CPU would run next is handed to a helper,
+//   and runs for the same window, while the running thread runs its
+//   own on the main host thread.  Then all of them stop, and we go on
+//   as before.
+//
+//   That is a conservative lookahead: since nothing can happen before
+//   the window ends, the running thread's code would have run the same
+//   without the others; and since every helper stops short of an
+//   instruction that would trap (see RunAhead), the kernel -- and with
+//   it simulated time, and everything it keeps -- is only ever run on
+//   the main host thread.  A thread run ahead just has that much less
+//   to do when it is next dispatched.
+//
+//   Nor do the host threads ever race on memory: no two threads in a
+//   gang are in the same address space, and no thread whose space has
+//   frames other spaces can write (a shared memory segment) is run on
+//   a helper -- see Scheduler::Gang.  Frames shared read-only (pure
+//   code, pages copied on write) can't be written without a trap, and
+//   a mapped file's pages have frames of their own in each space.  So
+//   each frame a helper can write is touched by no other host thread.
+//
+//   Some things are relaxed, for a model that is only minimal:
+//
+//	* Each helper's thread runs its window at the time the running
+//	  thread does, but that time isn't put on the clock twice: it is
+//	  charged to the thread, and counted in the statistics, only.
+//	  So a thread can be up to a window ahead of the clock when it
+//	  is next dispatched.
+//
+//	* Only threads the timer preempted between two user instructions
+//	  can be run ahead; so without the timer (-rs, -mlfq, ...), nothing
+//	  is.  The longer the quantum (-quantum), the longer the windows.
+//
+//   It needs the page table, not the TLB (whose refills are the
+//   kernel's), and none of the decoded-instruction cache, the basic-
+//   block engine or the memory timing models, which are all kept in
+//   the main Machine, for the running thread; see SetParallel.
+//
+//   DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include <signal.h>
+
+#include "machine.h"
+#include "mipspar.h"
+#include "system.h"
+
+// The window lock, and what the main host thread and the helpers wait
+// for under it: the start of the next window, and the end of the one
+// they are all running.
+
+static pthread_mutex_t windowLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t windowStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t windowDone = PTHREAD_COND_INITIALIZER;
+static int windowRound = 0;	// windows started so far
+static int numBusy = 0;		// helpers not yet done with this one
+
+//----------------------------------------------------------------------
+// HelperLoop
+// 	What the host thread of a helper CPU runs, forever: wait for the
+//	start of a window, run its thread's user code for it, if it has
+//	one, and say when it is done.
+//
+//	"arg" -- the helper
+//----------------------------------------------------------------------
+
+static void *
+HelperLoop(void *arg)
+{
+    HelperCPU *h = (HelperCPU *) arg;
+    int round = 0;
+
+    for (;;) {
+	pthread_mutex_lock(&windowLock);
+	while (windowRound == round)
+	    pthread_cond_wait(&windowStart, &windowLock);
+	round = windowRound;
+	pthread_mutex_unlock(&windowLock);
+
+	if (h->thread != NULL)
+	    h->numRun = h->cpu->RunAhead(h->maxCount);
+
+	pthread_mutex_lock(&windowLock);
+	if (--numBusy == 0)
+	    pthread_cond_signal(&windowDone);
+	pthread_mutex_unlock(&windowLock);
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Machine::Machine
+// 	Initialize a helper CPU, for parallel mode: no TLB, caches or
+//	decoded instructions of its own, and the memory of "parent".
+//	Its registers and page table are loaded for each window.
+//
+//	A helper lasts as long as Nachos does (its host thread never
+//	stops), and is never deleted: it doesn't own its memory.
+//
+//	"parent" -- the main Machine
+//----------------------------------------------------------------------
+
+Machine::Machine(Machine *parent)
+{
+    for (int i = 0; i < NumTotalRegs; i++)
+	registers[i] = 0;
+    mainMemory = parent->mainMemory;
+    tlbSize = tlbWays = tlbSets = 0;
+    tlb = NULL;
+    tlbASID = NULL;
+    tlbNextVictim = NULL;
+    FlushMicroTLB();
+    asid = 0;
+    pageTable = NULL;
+    pageDirectory = NULL;
+    pageTableSize = 0;
+    decodeCache = NULL;
+    decodeValid = NULL;
+    blockTable = NULL;
+    blocksInFrame = NULL;
+    numBlockFlushes = 0;
+    codeCache = NULL;
+    jitActive = 0;
+    icache = dcache = NULL;
+    missPenalty = 0;
+    numNodes = parent->numNodes;
+    remoteTicks = 0;
+    timedMemory = FALSE;
+    superPages = FALSE;
+    cacheCounts = NULL;
+
+    singleStep = FALSE;
+    runUntilTime = 0;
+    batchTicks = TRUE;
+    profileTicks = nextSample = 0;
+    numTraps = 0;
+    afterBranch = FALSE;
+    helpers = NULL;
+    numHelpers = 0;
+    runningAhead = stoppedAhead = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Machine::SetParallel
+// 	Turn parallel mode on: give each CPU but one a helper, and start
+//	its host thread.  Returns FALSE, with nothing changed, if this
+//	machine can't run in parallel mode (see the top of this file):
+//	there is only one CPU, it doesn't batch ticks (-bt), so never
+//	has a window to run, or it keeps state that is shared between
+//	the CPUs and not locked.
+//
+//	The helpers take no signals: they all go to the main host
+//	thread, as they always did.
+//----------------------------------------------------------------------
+
+bool
+Machine::SetParallel()
+{
+    int n = scheduler->NumCPUs() - 1;
+    bool counting = FALSE;	// instructions are counted in "stats"
+    sigset_t all, old;
+
+#ifdef INSTR_STATS
+    counting = TRUE;
+#endif
+    if ((n < 1) || !batchTicks || (tlb != NULL) || (decodeCache != NULL)
+		|| (blockTable != NULL) || timedMemory || counting)
+	return FALSE;
+
+    helpers = new HelperCPU[n];
+    numHelpers = n;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);	// inherited by each helper
+    for (int i = 0; i < n; i++) {
+	HelperCPU *h = &helpers[i];
+
+	h->cpu = new Machine(this);
+	h->thread = NULL;
+	h->maxCount = h->numRun = 0;
+	if (pthread_create(&h->host, NULL, HelperLoop, h) != 0) {
+	    perror("pthread_create");
+	    ASSERT(FALSE);
+	}
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunAhead
+// 	Run at most "maxCount" user instructions, with no ticks charged
+//	and no interrupts checked for, stopping short of any that would
+//	trap (see RaiseException) -- so none of the kernel is run, and
+//	this is safe on any host thread.  Returns how many were run.
+//
+//	"maxCount" -- the most to run
+//----------------------------------------------------------------------
+
+int
+Machine::RunAhead(int maxCount)
+{
+    Instruction instr;
+    int numRun;
+
+    runningAhead = TRUE;
+    stoppedAhead = FALSE;
+    for (numRun = 0; numRun < maxCount; numRun++) {
+	OneInstruction(&instr);
+	if (stoppedAhead)
+	    break;
+    }
+    runningAhead = FALSE;
+    return numRun;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunParallel
+// 	Run a window of at most "maxCount" instructions of the current
+//	thread's user code, on this host thread, and the same of each of
+//	the threads the other CPUs would run next, on their helpers.
+//	Called from RunFast, when no interrupt can be due for at least
+//	"maxCount" ticks; returns how many of the current thread's were
+//	run, for it to charge.  The others are charged here, to their
+//	threads, which stay on the ready list.
+//
+//	If no other CPU has a thread that can be run ahead, there is no
+//	window, and we return 0.
+//
+//	"maxCount" -- the most to run
+//----------------------------------------------------------------------
+
+int
+Machine::RunParallel(int maxCount)
+{
+    Thread *gang[MaxCPUs];
+    int n = scheduler->Gang(gang);
+    int numRun;
+
+    if (n == 0)
+	return 0;
+    ASSERT(n <= numHelpers);
+    for (int i = 0; i < numHelpers; i++) {
+	HelperCPU *h = &helpers[i];
+
+	h->thread = (i < n) ? gang[i] : NULL;
+	h->maxCount = maxCount;
+	h->numRun = 0;
+	if (h->thread == NULL)
+	    continue;
+	h->thread->RestoreUserState(h->cpu);
+	h->cpu->pageTable = h->thread->userPageTable;
+	h->cpu->pageDirectory = h->thread->userPageDirectory;
+	h->cpu->pageTableSize = h->thread->userPageTableSize;
+	h->cpu->FlushMicroTLB();
+    }
+
+    pthread_mutex_lock(&windowLock);
+    windowRound++;
+    numBusy = numHelpers;
+    pthread_cond_broadcast(&windowStart);
+    pthread_mutex_unlock(&windowLock);
+
+    numRun = RunAhead(maxCount);
+
+    pthread_mutex_lock(&windowLock);
+    while (numBusy > 0)
+	pthread_cond_wait(&windowDone, &windowLock);
+    pthread_mutex_unlock(&windowLock);
+
+    for (int i = 0; i < n; i++) {
+	HelperCPU *h = &helpers[i];
+	Thread *t = h->thread;
+	int ticks = h->numRun * userTick;
+
+	t->SaveUserState(h->cpu);
+	t->account->userTicks += ticks;
+	t->readySince = min(t->readySince + ticks,	// it wasn't waiting
+			    stats->totalTicks + numRun * userTick);
+	stats->numParallelTicks += ticks;
+	h->thread = NULL;
+    }
+    stats->numParallelWindows++;
+    DEBUG('t', "Parallel window of %d ticks, %d threads alongside\n",
+	  numRun * userTick, n);
+    return numRun;
+}
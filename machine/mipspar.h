@@ -0,0 +1,46 @@
+// mipspar.h
+//	Data structures for parallel mode of the MIPS simulator (-hp):
+//	running the user code of the threads the other simulated CPUs
+//	would run next on host threads of their own, alongside the
+//	running thread's.
+//
+//	Only user code runs in parallel, and only in a window in which
+//	no interrupt can be due: the kernel, and simulated time, stay on
+//	the one host thread.  Each helper CPU stops short of any
+//	instruction that would trap, which is run again, on the host
+//	thread the kernel runs on, when its thread is next dispatched.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MIPSPAR_H
+#define MIPSPAR_H
+
+#include "copyright.h"
+#include <pthread.h>
+
+#define MinParallelWindow 1000	// instructions a window must have room
+				// for, to be worth waking the helpers
+
+class Machine;
+class Thread;
+
+// The following class defines a helper CPU: a Machine of its own, with
+// the memory of the main one, and the host thread it runs on.  The
+// other fields are handed over, under the window lock, at the start and
+// end of each window (see Machine::RunParallel).
+
+class HelperCPU {
+  public:
+    Machine *cpu;		// its registers and translations
+    pthread_t host;		// the host thread it runs on
+    Thread *thread;		// whose user code it runs this window,
+				// or NULL if none
+    int maxCount;		// at most how many instructions
+    int numRun;			// ... and how many it ran
+};
+
+#endif // MIPSPAR_H
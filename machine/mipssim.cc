@@ -14,9 +14,109 @@
 
 #include "machine.h"
 #include "mipssim.h"
+#include "mipspar.h"
 #include "system.h"
 
-static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
+// The tables used to decode instructions, and to print them (see
+// mipssim.h).
+
+OpInfo opTable[] = {
+    {SPECIAL, RFMT}, {BCOND, IFMT}, {OP_J, JFMT}, {OP_JAL, JFMT},
+    {OP_BEQ, IFMT}, {OP_BNE, IFMT}, {OP_BLEZ, IFMT}, {OP_BGTZ, IFMT},
+    {OP_ADDI, IFMT}, {OP_ADDIU, IFMT}, {OP_SLTI, IFMT}, {OP_SLTIU, IFMT},
+    {OP_ANDI, IFMT}, {OP_ORI, IFMT}, {OP_XORI, IFMT}, {OP_LUI, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_LB, IFMT}, {OP_LH, IFMT}, {OP_LWL, IFMT}, {OP_LW, IFMT},
+    {OP_LBU, IFMT}, {OP_LHU, IFMT}, {OP_LWR, IFMT}, {OP_RES, IFMT},
+    {OP_SB, IFMT}, {OP_SH, IFMT}, {OP_SWL, IFMT}, {OP_SW, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_SWR, IFMT}, {OP_RES, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}
+};
+
+int specialTable[] = {
+    OP_SLL, OP_RES, OP_SRL, OP_SRA, OP_SLLV, OP_RES, OP_SRLV, OP_SRAV,
+    OP_JR, OP_JALR, OP_RES, OP_RES, OP_SYSCALL, OP_UNIMP, OP_RES, OP_RES,
+    OP_MFHI, OP_MTHI, OP_MFLO, OP_MTLO, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_MULT, OP_MULTU, OP_DIV, OP_DIVU, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_ADD, OP_ADDU, OP_SUB, OP_SUBU, OP_AND, OP_OR, OP_XOR, OP_NOR,
+    OP_RES, OP_RES, OP_SLT, OP_SLTU, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES
+};
+
+struct OpString opStrings[] = {
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"ADD r%d,r%d,r%d", {RD, RS, RT}},
+	{"ADDI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"ADDIU r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"ADDU r%d,r%d,r%d", {RD, RS, RT}},
+	{"AND r%d,r%d,r%d", {RD, RS, RT}},
+	{"ANDI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"BEQ r%d,r%d,%d", {RS, RT, EXTRA}},
+	{"BGEZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BGEZAL r%d,%d", {RS, EXTRA, NONE}},
+	{"BGTZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLEZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLTZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLTZAL r%d,%d", {RS, EXTRA, NONE}},
+	{"BNE r%d,r%d,%d", {RS, RT, EXTRA}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"DIV r%d,r%d", {RS, RT, NONE}},
+	{"DIVU r%d,r%d", {RS, RT, NONE}},
+	{"J %d", {EXTRA, NONE, NONE}},
+	{"JAL %d", {EXTRA, NONE, NONE}},
+	{"JALR r%d,r%d", {RD, RS, NONE}},
+	{"JR r%d,r%d", {RD, RS, NONE}},
+	{"LB r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LBU r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LH r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LHU r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LUI r%d,%d", {RT, EXTRA, NONE}},
+	{"LW r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LWL r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LWR r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"MFHI r%d", {RD, NONE, NONE}},
+	{"MFLO r%d", {RD, NONE, NONE}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"MTHI r%d", {RS, NONE, NONE}},
+	{"MTLO r%d", {RS, NONE, NONE}},
+	{"MULT r%d,r%d", {RS, RT, NONE}},
+	{"MULTU r%d,r%d", {RS, RT, NONE}},
+	{"NOR r%d,r%d,r%d", {RD, RS, RT}},
+	{"OR r%d,r%d,r%d", {RD, RS, RT}},
+	{"ORI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"RFE", {NONE, NONE, NONE}},
+	{"SB r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SH r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SLL r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SLLV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SLT r%d,r%d,r%d", {RD, RS, RT}},
+	{"SLTI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SLTIU r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SLTU r%d,r%d,r%d", {RD, RS, RT}},
+	{"SRA r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SRAV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SRL r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SRLV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SUB r%d,r%d,r%d", {RD, RS, RT}},
+	{"SUBU r%d,r%d,r%d", {RD, RS, RT}},
+	{"SW r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SWL r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SWR r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"XOR r%d,r%d,r%d", {RD, RS, RT}},
+	{"XORI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SYSCALL", {NONE, NONE, NONE}},
+	{"Unimplemented", {NONE, NONE, NONE}},
+	{"Reserved", {NONE, NONE, NONE}}
+      };
+
 
 //----------------------------------------------------------------------
 // Machine::Run
@@ -25,6 +125,43 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	If the basic-block engine is enabled (and we are not single
+//	stepping or tracing instructions), straight-line code is run a
+//	block at a time, and the ticks for the whole block are charged
+//	at once; pending interrupts are only checked between blocks.
+//	The instruction that ends a block (or, if it ends in a fused
+//	compare and branch, the delay slot) is then run by OneInstruction.
+//
+//	If tick batching is enabled, we ask the interrupt simulation how
+//	many ticks can go by before the next interrupt is due, run that
+//	many instructions with only the clock being advanced, and only
+//	then do a full OneTick.  Interrupts thus fire at exactly the same
+//	instruction as before.  Since the kernel may schedule a new
+//	interrupt whenever we trap to it, we stop a batch early after
+//	any exception or system call, and charge the tick for that
+//	instruction with OneTick, so that any interrupt now due is
+//	called there, as it would be without batching.  With blocks and
+//	batching both on, blocks are cut short so they never run past a
+//	pending interrupt.
+//
+//	In parallel mode (-hp), the start of each batch long enough is
+//	run by RunParallel instead, with the other CPUs' next threads
+//	running alongside (see mipspar.cc).
+//
+//	When profiling, we run an instruction at a time (neither blocks
+//	nor batches), so that each sample is of the PC at the very tick
+//	it is due.
+//
+//	If the simulator is compiled with -DINSTR_STATS, every
+//	instruction run, by either engine, is counted in the statistics
+//	(see CountInstruction).
+//
+//	There are two loops: RunFast, for when nothing is watching, and
+//	RunInstrumented, for the debugger, the profiler and instruction
+//	tracing (-d m), which has all the checks they need after each
+//	instruction.  We choose between them here, so the fast loop has
+//	none of those checks in it.
 //----------------------------------------------------------------------
 
 void
@@ -36,14 +173,115 @@ Machine::Run()
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
+    for (;;) {
+	if (singleStep || (profileTicks > 0) || DebugIsEnabled('m'))
+	    RunInstrumented(instr);
+	else
+	    RunFast(instr);
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::RunFast
+// 	Run's loop when no one is watching: with basic blocks and tick
+//	batching, if they are enabled, and no checks for the debugger or
+//	the profiler.  Never returns.
+//
+//	"instr" -- storage for the decoded instruction
+//----------------------------------------------------------------------
+
+void
+Machine::RunFast(Instruction *instr)
+{
+    bool useBlocks = (bool)(blockTable != NULL);
+
+    for (;;) {
+	bool trapped = FALSE;		// the batch ended in a trap
+
+	if (batchTicks) {
+	    int quiet = interrupt->TicksUntilDue() / userTick;
+	    int traps = numTraps;
+
+	    if ((helpers != NULL) && (quiet >= MinParallelWindow)) {
+		int numRun = RunParallel(quiet);
+
+		if (numRun > 0)
+		    interrupt->SkipTicks(numRun);
+		quiet -= numRun;
+	    }
+	    while ((quiet > 0) && (numTraps == traps)) {
+		int numRun = useBlocks ? RunBlock(quiet) : 0;
+
+		if (numRun == 0) {
+		    OneInstruction(instr);
+		    numRun = 1;
+		}
+		if (numTraps != traps) {	// the kernel may have moved
+		    trapped = TRUE;		// the clock on to an interrupt:
+		    numRun--;			// the last tick checks for it,
+		}				// as OneTick always did
+		interrupt->SkipTicks(numRun);
+		quiet -= numRun;
+	    }
+	} else if (useBlocks) {
+	    int numRun = RunBlock(PageSize / 4);
+
+	    if (numRun > 0)
+		interrupt->ManyTicks(numRun);
+	}
+	if (!trapped)
+	    OneInstruction(instr);
+	// If we are preempted at this tick, it is between two of our
+	// instructions, so the rest of our code can be run ahead of us.
+	currentThread->userPreempted = (bool)(helpers != NULL);
+	interrupt->OneTick();
+	currentThread->userPreempted = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::RunInstrumented
+// 	Run's loop when single stepping, profiling or tracing: one
+//	instruction, and one tick, at a time, dropping into the debugger
+//	or taking a sample of the PC when they are due.  Returns when
+//	there is nothing left to watch -- when the debugger is told to
+//	carry on, say -- so that Run can switch to the fast loop.
+//
+//	"instr" -- storage for the decoded instruction
+//----------------------------------------------------------------------
+
+void
+Machine::RunInstrumented(Instruction *instr)
+{
     for (;;) {
         OneInstruction(instr);
 	interrupt->OneTick();
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
+	if ((profileTicks > 0) && (stats->userTicks >= nextSample)) {
+	    nextSample = stats->userTicks + profileTicks;
+	    ProfileSample(registers[PCReg]);
+	}
+	if (!singleStep && (profileTicks == 0) && !DebugIsEnabled('m'))
+	    return;
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::SetProfiling
+// 	Start sampling the PC, for the profiler, every "ticks" ticks of
+//	user time; or, if "ticks" is 0, stop.  Each sample is handed to
+//	the kernel's ProfileSample.
+//----------------------------------------------------------------------
+
+void
+Machine::SetProfiling(int ticks)
+{
+    ASSERT(ticks >= 0);
+    profileTicks = ticks;
+    nextSample = stats->userTicks + ticks;
+}
+
 
 //----------------------------------------------------------------------
 // TypeToReg
@@ -88,21 +326,50 @@ TypeToReg(RegType reg, Instruction *instr)
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
 //	and the register set.
+//
+//	The one exception is the decoded-instruction cache (if enabled):
+//	it is keyed by physical address, and is invalidated whenever
+//	WriteMem stores into a word, or the kernel changes mainMemory
+//	behind our back (see Machine::InvalidateDecodeCache).  Likewise
+//	the micro-TLB, which the kernel flushes whenever it changes a
+//	translation (see Machine::Translate).
+//
+//	"decoded" -- storage for the decoded instruction, if the cache
+//		is disabled
 //----------------------------------------------------------------------
 
 void
-Machine::OneInstruction(Instruction *instr)
+Machine::OneInstruction(Instruction *decoded)
 {
+    Instruction *instr = decoded;
     int raw;
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
 
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    int physAddr;
+    ExceptionType exception = 
+		Translate(registers[PCReg], &physAddr, 4, FALSE, TRUE);
+
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return;
+    }
+    if (timedMemory)
+	ChargeAccess(TRUE, physAddr);
+    if (decodeCache == NULL) {
+	raw = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+	instr->value = raw;
+	instr->Decode();
+    } else {			// use the decoded copy, if we have one
+	instr = &decodeCache[physAddr / 4];
+	if (!decodeValid[physAddr / 4]) {
+	    instr->value = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+	    instr->Decode();
+	    decodeValid[physAddr / 4] = TRUE;
+	}
+    }
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -118,6 +385,9 @@ Machine::OneInstruction(Instruction *instr)
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
     unsigned int rs, rt, imm;
+#ifdef INSTR_STATS
+    unsigned long long start = HostCycles();
+#endif
 
     // Execute the instruction (cf. Kane's book)
     switch (instr->opCode) {
@@ -231,7 +501,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LB:
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
-	if (!machine->ReadMem(tmp, 1, &value))
+	if (!ReadMem(tmp, 1, &value))
 	    return;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
@@ -249,7 +519,7 @@ Machine::OneInstruction(Instruction *instr)
 	    RaiseException(AddressErrorException, tmp);
 	    return;
 	}
-	if (!machine->ReadMem(tmp, 2, &value))
+	if (!ReadMem(tmp, 2, &value))
 	    return;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
@@ -271,7 +541,7 @@ Machine::OneInstruction(Instruction *instr)
 	    RaiseException(AddressErrorException, tmp);
 	    return;
 	}
-	if (!machine->ReadMem(tmp, 4, &value))
+	if (!ReadMem(tmp, 4, &value))
 	    return;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
@@ -285,7 +555,7 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem(tmp, 4, &value))
+	if (!ReadMem(tmp, 4, &value))
 	    return;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
@@ -316,7 +586,7 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem(tmp, 4, &value))
+	if (!ReadMem(tmp, 4, &value))
 	    return;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
@@ -381,13 +651,13 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SB:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
 	    return;
 	break;
 	
       case OP_SH:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
 	    return;
 	break;
@@ -469,7 +739,7 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SW:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
 	    return;
 	break;
@@ -481,7 +751,7 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
+	if (!ReadMem((tmp & ~0x3), 4, &value))
 	    return;
 	switch (tmp & 0x3) {
 	  case 0:
@@ -500,7 +770,7 @@ Machine::OneInstruction(Instruction *instr)
 					    0xff);
 	    break;
 	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
+	if (!WriteMem((tmp & ~0x3), 4, value))
 	    return;
 	break;
     	
@@ -511,7 +781,7 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
+	if (!ReadMem((tmp & ~0x3), 4, &value))
 	    return;
 	switch (tmp & 0x3) {
 	  case 0:
@@ -527,7 +797,7 @@ Machine::OneInstruction(Instruction *instr)
 	    value = registers[instr->rt];
 	    break;
 	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
+	if (!WriteMem((tmp & ~0x3), 4, value))
 	    return;
 	break;
     	
@@ -556,6 +826,11 @@ Machine::OneInstruction(Instruction *instr)
     
     // Do any delayed load operation
     DelayedLoad(nextLoadReg, nextLoadValue);
+
+#ifdef INSTR_STATS
+    CountInstruction(instr->opCode, (bool)(pcAfter != registers[NextPCReg] + 4),
+		     HostCycles() - start);
+#endif
     
     // Advance program counters.
     registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
@@ -564,6 +839,55 @@ Machine::OneInstruction(Instruction *instr)
     registers[NextPCReg] = pcAfter;
 }
 
+//----------------------------------------------------------------------
+// Machine::CountInstruction
+// 	Count an instruction that has just been run successfully in the
+//	instruction mix (see Statistics::PrintInstructionMix): by opcode,
+//	with the host cycles it took to simulate; and whether it was a
+//	load, a store, a branch or jump (and if it went elsewhere), or in
+//	the delay slot of one.
+//
+//	Only called if the simulator is compiled with -DINSTR_STATS, by
+//	OneInstruction and, for the instructions in a block, RunBlock.
+//
+//	"opCode" -- what the instruction was (OP_*)
+//	"taken" -- for a branch, did it change the flow of control?
+//	"cycles" -- host cycles spent simulating it (0 if unknown)
+//----------------------------------------------------------------------
+
+void
+Machine::CountInstruction(int opCode, bool taken, unsigned long long cycles)
+{
+    ASSERT((opCode >= 0) && (opCode < NumOpcodes));
+    if (stats->opcodeName[opCode] == NULL)
+	stats->opcodeName[opCode] = opStrings[opCode].string;
+    stats->opcodeCount[opCode]++;
+    stats->opcodeCycles[opCode] += cycles;
+    if (afterBranch)
+	stats->numDelaySlots++;
+    afterBranch = FALSE;
+
+    switch (opCode) {
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU:
+      case OP_LW: case OP_LWL: case OP_LWR:
+	stats->numLoads++;
+	break;
+      case OP_SB: case OP_SH: case OP_SW: case OP_SWL: case OP_SWR:
+	stats->numStores++;
+	break;
+      case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+      case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+      case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+	stats->numBranches++;
+	if (taken)
+	    stats->numBranchesTaken++;
+	afterBranch = TRUE;
+	break;
+      default:
+	break;
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::DelayedLoad
 // 	Simulate effects of a delayed load.
@@ -630,9 +954,11 @@ Instruction::Decode()
 // 	Simulate R2000 multiplication.
 // 	The words at *hiPtr and *loPtr are overwritten with the
 // 	double-length result of the multiplication.
+//
+//	Also used by the basic-block engine (mipsblock.cc).
 //----------------------------------------------------------------------
 
-static void
+void
 Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr)
 {
     if ((a == 0) || (b == 0)) {
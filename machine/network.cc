@@ -21,6 +21,8 @@
 // Dummy functions because C++ can't call member functions indirectly 
 static void NetworkReadPoll(_int arg)
 { Network *net = (Network *)arg; net->CheckPktAvail(); }
+static void NetworkInputReady(_int arg)
+{ interrupt->Schedule(NetworkReadPoll, arg, NetworkTime, NetworkRecvInt); }
 static void NetworkSendDone(_int arg)
 { Network *net = (Network *)arg; net->SendDone(); }
 
@@ -28,8 +30,10 @@ static void NetworkSendDone(_int arg)
 //   addr is used to generate the socket name
 //   reliability says whether we drop packets to emulate unreliable links
 //   readAvail, writeDone, callArg -- analogous to console
+//   rxRing is how many arrived packets can be held at once
 Network::Network(NetworkAddress addr, double reliability, double orderability,
-	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, _int callArg)
+	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, _int callArg,
+	int rxRing)
 {
     ident = addr;
     if (reliability < 0) chanceToWork = 0;
@@ -45,54 +49,89 @@ Network::Network(NetworkAddress addr, double reliability, double orderability,
     readHandler = readAvail;
     handlerArg = callArg;
     sendBusy = FALSE;
-    inHdr.length = 0;
+    ASSERT(rxRing > 0);
+    rxBuf = new char[rxRing * MaxWireSize];
+    rxSize = rxRing;
+    rxHead = rxCount = 0;
     delayBufFull = FALSE;
     
-    sock = OpenSocket();
-    sprintf(sockName, "SOCKET_%d", (int)addr);
-    AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
+    rxFree = new char *[rxRing];
+
+    overHosts = UsingHostMap();
+    if (overHosts)				 // a host map was given, so
+	sock = OpenHostSocket((int)addr);	 // use UDP (see sysdep.cc)
+    else {
+	sock = OpenSocket();
+	sprintf(sockName, "SOCKET_%d", (int)addr);
+	AssignNameToSocket(sockName, sock);	 // Bind socket to a filename 
 						 // in the current directory.
+    }
 
-    // start polling for incoming packets
-    interrupt->Schedule(NetworkReadPoll, (_int)this, NetworkTime, NetworkRecvInt);
+    // poll for incoming packets once there are some (see sysdep.cc)
+    WatchFile(sock, NetworkInputReady, (_int)this);
 }
 
 Network::~Network()
 {
+    UnwatchFile(sock);
     CloseSocket(sock);
-    DeAssignNameToSocket(sockName);
+    if (!overHosts)
+	DeAssignNameToSocket(sockName);
+    delete [] rxBuf;
+    delete [] rxFree;
 }
 
-// if a packet is already buffered, we simply delay reading 
-// the incoming packet.  In real life, the incoming 
-// packet might be dropped if we can't read it in time.
+// read in every packet that is waiting, as long as there is room
+// for it, and then tell the post office about them all at once.
+// if the buffers are full, we simply delay reading the rest.
+// In real life, the incoming packets might be dropped if we can't
+// read them in time.
+//
+// we are only polled once packets have turned up on the socket.
 void
 Network::CheckPktAvail()
 {
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(NetworkReadPoll, (_int)this, NetworkTime, NetworkRecvInt);
-
-    if (inHdr.length != 0) 	// do nothing if packet is already buffered
-	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
-	return;
-
-    // otherwise, read packet in
-    char *buffer = new char[MaxWireSize];
-    ReadFromSocket(sock, buffer, MaxWireSize);
-
-    // divide packet into header and data
-    inHdr = *(PacketHeader *)buffer;
-    ASSERT((inHdr.to == ident) && (inHdr.length <= MaxPacketSize));
-    bcopy(buffer + sizeof(PacketHeader), inbox, inHdr.length);
-    delete []buffer ;
-
-    DEBUG('n', "Network received packet from %d, length %d...\n",
-	  				(int) inHdr.from, inHdr.length);
-    stats->numPacketsRecvd++;
+    int arrived = 0;
+
+    while (rxCount < rxSize) {
+	// read the packets straight into the free buffers: over UDP, as
+	// many in one go as are waiting, and fit
+	int room = rxSize - rxCount, got = 0, i;
+
+	for (i = 0; i < room; i++)
+	    rxFree[i] = &rxBuf[((rxHead + rxCount + i) % rxSize) * MaxWireSize];
+	if (overHosts)
+	    got = ReadFromHosts(sock, rxFree, room, MaxWireSize);
+	else if (PollSocket(sock)) {
+	    ReadFromSocket(sock, rxFree[0], MaxWireSize);
+	    got = 1;
+	}
+	if (got == 0)
+	    break;
+
+	for (i = 0; i < got; i++) {
+	    PacketHeader *hdr = (PacketHeader *)rxFree[i];
+
+	    ASSERT((hdr->to == ident) && (hdr->length <= MaxPacketSize));
+	    DEBUG('n', "Network received packet from %d, length %d...\n",
+		  			(int) hdr->from, hdr->length);
+	    stats->numPacketsRecvd++;
+	}
+	rxCount += got;
+	arrived += got;
+    }
 
-    // tell post office that the packet has arrived
-    (*readHandler)(handlerArg);	
+    // schedule the next time to poll: soon, if there may be more
+    // packets we had no room for, or else once there are any
+    if (rxCount == rxSize)
+	interrupt->Schedule(NetworkReadPoll, (_int)this, NetworkTime,
+			    NetworkRecvInt);
+    else
+	WatchFile(sock, NetworkInputReady, (_int)this);
+
+    // tell post office that the packets have arrived
+    if (arrived > 0)
+	(*readHandler)(handlerArg);	
 }
 
 // notify user that another packet can be sent
@@ -112,8 +151,6 @@ Network::SendDone()
 void
 Network::Send(PacketHeader hdr, char* data)
 {
-    char toName[32];
-
     ASSERT((sendBusy == FALSE) && (hdr.length > 0) 
 		&& (hdr.length <= MaxPacketSize) && (hdr.from == ident));
     DEBUG('n', "Sending to addr %d, %d bytes... ", hdr.to, hdr.length);
@@ -129,9 +166,9 @@ Network::Send(PacketHeader hdr, char* data)
       // it remains there until another packet is delayed, at which
       //  point we send it out
       if (delayBufFull == TRUE) {
-	SendToSocket(sock, delayBuf, MaxWireSize, delayToName);
+	SendPacket(delayBuf, delayTo);
       }
-      sprintf(delayToName, "SOCKET_%d", (int)hdr.to);
+      delayTo = hdr.to;
       *(PacketHeader *)delayBuf = hdr;
       bcopy(data, delayBuf + sizeof(PacketHeader), hdr.length);
       delayBufFull = TRUE;
@@ -140,23 +177,43 @@ Network::Send(PacketHeader hdr, char* data)
 
     // packet is neither lost nor delayed - send it now
 
-    sprintf(toName, "SOCKET_%d", (int)hdr.to);
     // concatenate hdr and data into a single buffer, and send it out
-    char *buffer = new char[MaxWireSize];
-    *(PacketHeader *)buffer = hdr;
-    bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
-    SendToSocket(sock, buffer, MaxWireSize, toName);
-    delete []buffer;
+    *(PacketHeader *)sendBuf = hdr;
+    bcopy(data, sendBuf + sizeof(PacketHeader), hdr.length);
+    SendPacket(sendBuf, hdr.to);
 }
 
-// read a packet, if one is buffered
+// put a packet on the wire, to the UNIX socket of the destination
+// machine, or to its UDP port if we are using a host map
+void
+Network::SendPacket(char *packet, NetworkAddress to)
+{
+    if (overHosts) {
+	int toAddr = (int)to;
+
+	SendToHosts(sock, &packet, &toAddr, 1, MaxWireSize);
+    } else {
+	char toName[32];
+
+	sprintf(toName, "SOCKET_%d", (int)to);
+	SendToSocket(sock, packet, MaxWireSize, toName);
+    }
+}
+
+// read the oldest packet, if one is buffered
 PacketHeader
 Network::Receive(char* data)
 {
-    PacketHeader hdr = inHdr;
+    PacketHeader hdr;
+    char *buffer = &rxBuf[rxHead * MaxWireSize];
 
-    inHdr.length = 0;
-    if (hdr.length != 0)
-    	bcopy(inbox, data, hdr.length);
+    if (rxCount == 0) {
+	hdr.length = 0;
+	return hdr;
+    }
+    hdr = *(PacketHeader *)buffer;
+    bcopy(buffer + sizeof(PacketHeader), data, hdr.length);
+    rxHead = (rxHead + 1) % rxSize;
+    rxCount--;
     return hdr;
 }
@@ -48,6 +48,7 @@ class PacketHeader {
 #define MaxWireSize 	64	// largest packet that can go out on the wire
 #define MaxPacketSize 	(MaxWireSize - sizeof(struct PacketHeader))	
 				// data "payload" of the largest packet
+#define DefaultRxRing	8	// packets the device can hold, by default
 
 
 // The following class defines a physical network device.  The network
@@ -76,11 +77,17 @@ class PacketHeader {
 // generator, by changing the arguments to RandomInit() in Initialize().
 // The random number generator is used to choose which packets to drop
 // or delay.
+//
+// Arriving packets go into a ring of receive buffers, allocated once,
+// that holds up to "rxRing" of them.  Each poll takes in as many as
+// are waiting and fit, and then interrupts just once for all of them,
+// so the handler should Receive until there are none left.
 
 class Network {
   public:
     Network(NetworkAddress addr, double reliability, double orderability,
-  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, _int callArg);
+  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, _int callArg,
+	  int rxRing = DefaultRxRing);
 				// Allocate and initialize network driver
     ~Network();			// De-allocate the network driver data
 
@@ -98,13 +105,13 @@ class Network {
     PacketHeader Receive(char* data);
     				// Poll the network for incoming messages.  
 				// If there is a packet waiting, copy the 
-				// packet into "data" and return the header.
-				// If no packet is waiting, return a header 
-				// with length 0.
+				// oldest packet into "data" and return the
+				// header.  If no packet is waiting, return
+				// a header with length 0.
 
     void SendDone();		// Interrupt handler, called when message is 
 				// sent
-    void CheckPktAvail();	// Check if there is an incoming packet
+    void CheckPktAvail();	// Check if there are incoming packets
 
   private:
     NetworkAddress ident;	// This machine's network address
@@ -112,6 +119,8 @@ class Network {
     double chanceToNotDelay;       // Likelihood packet will not be delayed
     int sock;			// UNIX socket number for incoming packets
     char sockName[32];		// File name corresponding to UNIX socket
+    bool overHosts;		// Is it a UDP socket instead, reaching
+				//   other host machines (see sysdep.cc)?
     VoidFunctionPtr writeHandler; // Interrupt handler, signalling next packet 
 				//      can be sent.  
     VoidFunctionPtr readHandler;  // Interrupt handler, signalling packet has 
@@ -119,13 +128,19 @@ class Network {
     _int handlerArg;		// Argument to be passed to interrupt handler
 				//   (pointer to post office)
     bool sendBusy;		// Packet is being sent.
-    bool packetAvail;		// Packet has arrived, can be pulled off of
-				//   network
-    PacketHeader inHdr;		// Information about arrived packet
-    char inbox[MaxPacketSize];  // Data for arrived packet
+    char *rxBuf;		// Arrived packets, as they came off the
+				//   wire, MaxWireSize bytes apiece
+    char **rxFree;		// The free buffers, for a batched read
+    int rxSize;			// How many packets rxBuf can hold
+    int rxHead;			// Oldest arrived packet
+    int rxCount;		// How many have arrived, not yet received
+    char sendBuf[MaxWireSize];	// Place to put together a packet
     char delayBuf[MaxWireSize];  // Place to save a delayed packet
-    char delayToName[32];       // Place to send delayed packet, eventually
+    NetworkAddress delayTo;     // Place to send delayed packet, eventually
     bool delayBufFull;          // Is delayBuf in use?
+
+    void SendPacket(char *packet, NetworkAddress to);
+				// Put a packet on the wire
 };
 
 #endif // NETWORK_H
@@ -10,6 +10,13 @@
 #include "copyright.h"
 #include "utility.h"
 #include "stats.h"
+#include "disk.h"
+
+int userTick = UserTick;
+int systemTick = SystemTick;
+int timerTicks = TimerTicks;
+int interruptTicks = InterruptTick;
+int switchTicks = SwitchTick;
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +29,445 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPagesPrefetched = numPrefetchHits = 0;
+    numPagesTrimmed = numCopyOnWrite = 0;
+    numFramesZeroed = numZeroedFramesUsed = 0;
+    numPagesEvicted = numPageWriteBacks = 0;
+    numSwapCacheStores = numSwapCacheRejects = 0;
+    swapCacheBytesIn = swapCacheBytesOut = 0;
+    numSwapCacheHits = numSwapCacheMisses = numSwapCacheWrites = 0;
+    numPagesPagedOut = numPageOutWrites = 0;
+    numPageTableLeaves = numPageTableLeavesFreed = 0;
+    numStackPoolHits = numStackPoolMisses = 0;
+    numThreadPoolHits = numThreadPoolMisses = 0;
+    numListPoolHits = numListPoolMisses = 0;
+    numThreadsStolen = numTicksSkipped = 0;
+    numMigrations = 0;
+    numRealTimeJobs = numDeadlinesMissed = maxLateness = 0;
+    numBudgetOverruns = numRealTimeRefused = 0;
+    numBlocksCompiled = numCodeCacheFlushes = 0;
+    numParallelWindows = numParallelTicks = 0;
+    numRemoteAccesses = numRemoteFrames = 0;
+    numDiskRequests = numDiskSeekTracks = 0;
+    for (int i = 0; i < SeekBuckets; i++)
+	seekDistance[i] = 0;
+    numRotationTicks = numTrackBufferHits = 0;
+    sectorAccesses = NULL;
+    numSectorsCounted = 0;
+    diskMapFile = NULL;
+    numCacheHits = numCacheMisses = numCacheWriteBacks = 0;
+    numReadAheadSectors = numReadAheadHits = 0;
+    numDentryHits = numDentryMisses = 0;
+    numJournalRecords = numJournalSectors = numJournalCheckpoints = 0;
+    numLogSegments = numSegmentsCleaned = numCleanerMoves = 0;
+    for (int i = 0; i < LatencyBuckets; i++)
+	readyLatency[i] = 0;
+    numLoads = numStores = numBranches = numBranchesTaken = 0;
+    numDelaySlots = numBlockInstrs = numFusedInstrs = 0;
+    for (int i = 0; i < NumOpcodes; i++) {
+	opcodeCount[i] = 0;
+	opcodeCycles[i] = 0;
+	opcodeName[i] = NULL;
+    }
+    for (int i = 0; i < NumSyscalls; i++) {
+	syscallCount[i] = syscallTicks[i] = 0;
+	syscallHostTime[i] = 0;
+	syscallName[i] = NULL;
+    }
+    for (int i = 0; i < NumIntTypes; i++) {
+	intCount[i] = intTicks[i] = intLateTicks[i] = intMaxLateTicks[i] = 0;
+	intHostTime[i] = 0;
+	intName[i] = NULL;
+    }
+    perThread = FALSE;
+    firstThread = lastThread = NULL;
+    freeAccounts = NULL;
+
+    // the per-CPU blocks must start on a cache line, which "new" does
+    // not promise, so allocate a line more than we need
+    char *blocks = new char[(StatsCPUs + 1) * sizeof(PaddedCPUStats)];
+
+    cpuStats = (PaddedCPUStats *) (((_int) blocks + CacheLineSize - 1)
+				   & ~((_int) CacheLineSize - 1));
+    bzero((char *) cpuStats, StatsCPUs * sizeof(PaddedCPUStats));
+    numCPUsCounted = 0;
+    RunningOn(0);
+    lockStats = FALSE;
+    firstLock = NULL;
+}
+
+//----------------------------------------------------------------------
+// Statistics::RunningOn
+// 	Called by the scheduler when it switches to a thread on CPU "cpu":
+//	from now on, what happens is counted in that CPU's block.
+//----------------------------------------------------------------------
+
+void
+Statistics::RunningOn(int cpu)
+{
+    ASSERT((cpu >= 0) && (cpu < StatsCPUs));
+    thisCPU = &cpuStats[cpu].counts;
+    numCPUsCounted = max(numCPUsCounted, cpu + 1);
+}
+
+//----------------------------------------------------------------------
+// Statistics::Total, CPUStats::Add
+// 	Add up the counters of every CPU.
+//----------------------------------------------------------------------
+
+CPUStats
+Statistics::Total()
+{
+    CPUStats total;
+
+    bzero((char *) &total, sizeof(CPUStats));
+    for (int i = 0; i < numCPUsCounted; i++)
+	total.Add(&cpuStats[i].counts);
+    return total;
+}
+
+void
+CPUStats::Add(CPUStats *other)
+{
+    numTLBHits += other->numTLBHits;
+    numTLBMisses += other->numTLBMisses;
+    numSuperPageTLBHits += other->numSuperPageTLBHits;
+    tlbReachTotal += other->tlbReachTotal;
+    maxTLBReach = max(maxTLBReach, other->maxTLBReach);
+    numL1Fetches += other->numL1Fetches;
+    numL1FetchMisses += other->numL1FetchMisses;
+    numL1DataAccesses += other->numL1DataAccesses;
+    numL1DataMisses += other->numL1DataMisses;
+    numL1StallTicks += other->numL1StallTicks;
+    numLockAcquires += other->numLockAcquires;
+    numLockContended += other->numLockContended;
+}
+
+//----------------------------------------------------------------------
+// ThreadStats::ThreadStats, ThreadStats::~ThreadStats
+// 	Start the accounts of a thread at zero, or throw them away.
+//
+//	"threadName" -- the thread's name; it is copied, since the thread
+//	may be gone (and its name with it) by the time it is printed.
+//	NULL if it is never to be printed.
+//----------------------------------------------------------------------
+
+ThreadStats::ThreadStats(char *threadName)
+{
+    if (threadName != NULL) {
+	name = new char[strlen(threadName) + 1];
+	strcpy(name, threadName);
+    } else
+	name = NULL;
+    Reset();
+}
+
+ThreadStats::~ThreadStats()
+{
+    delete [] name;
+}
+
+//----------------------------------------------------------------------
+// ThreadStats::Reset
+// 	Start the accounts at zero again, to be used for another thread.
+//----------------------------------------------------------------------
+
+void
+ThreadStats::Reset()
+{
+    userTicks = systemTicks = numSwitches = readyTicks = 0;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// Statistics::NewThread
+// 	Return the (empty) accounts for a new thread.  If we are keeping
+//	them per thread, they are also put at the end of our list, to be
+//	printed.  If not, they are never printed, so those of a deleted
+//	thread can be used again, and need no copy of the name: creating
+//	a thread then allocates nothing here.
+//
+//	"name" -- the name of the thread
+//----------------------------------------------------------------------
+
+ThreadStats *
+Statistics::NewThread(char *name)
+{
+    ThreadStats *account;
+
+    if (!perThread) {
+	if (freeAccounts == NULL)
+	    return new ThreadStats(NULL);
+	account = freeAccounts;
+	freeAccounts = account->next;
+	account->Reset();
+	return account;
+    }
+    account = new ThreadStats(name);
+    if (lastThread == NULL)
+	firstThread = account;
+    else
+	lastThread->next = account;
+    lastThread = account;
+    return account;
+}
+
+//----------------------------------------------------------------------
+// Statistics::EndThread
+// 	The thread with these accounts is being deleted.  Unless they are
+//	on our list, they are kept for the next thread.
+//----------------------------------------------------------------------
+
+void
+Statistics::EndThread(ThreadStats *account)
+{
+    if (!perThread) {
+	account->next = freeAccounts;
+	freeAccounts = account;
+    }
+}
+
+//----------------------------------------------------------------------
+// LockStats::LockStats, LockStats::~LockStats
+// 	Start the profile of a synchronization object at zero, or throw it
+//	away.
+//
+//	"objectKind" -- what it is: "lock", "semaphore" or "condition"
+//	"objectName" -- its debugName; copied, since the object may be
+//	gone by the time it is printed
+//----------------------------------------------------------------------
+
+LockStats::LockStats(const char *objectKind, char *objectName)
+{
+    kind = objectKind;
+    name = new char[strlen(objectName) + 1];
+    strcpy(name, objectName);
+    acquires = contended = waitTicks = maxWaitTicks = 0;
+    holdTicks = maxHoldTicks = 0;
+    for (int i = 0; i < LockTopWaiters; i++) {
+	waiterName[i] = NULL;
+	waiterTicks[i] = 0;
+    }
+    next = NULL;
+}
+
+LockStats::~LockStats()
+{
+    delete [] name;
+    for (int i = 0; i < LockTopWaiters; i++)
+	delete [] waiterName[i];
+}
+
+//----------------------------------------------------------------------
+// LockStats::Waited
+// 	Count a thread having waited "ticks" for the object, and add them
+//	to its own total, if it is one of the LockTopWaiters kept.  A
+//	thread that is not pushes out the one with the least, if it has
+//	waited longer, so the table keeps the threads that waited longest
+//	(as long as no thread's waits are spread too thin to count).
+//
+//	"threadName" -- the name of the thread that waited
+//----------------------------------------------------------------------
+
+void
+LockStats::Waited(char *threadName, int ticks)
+{
+    int i, least = 0;
+
+    contended++;
+    waitTicks += ticks;
+    maxWaitTicks = max(maxWaitTicks, ticks);
+    for (i = 0; i < LockTopWaiters; i++) {
+	if ((waiterName[i] != NULL) && !strcmp(waiterName[i], threadName)) {
+	    waiterTicks[i] += ticks;
+	    return;
+	}
+	if ((waiterName[i] == NULL) || (waiterTicks[i] < waiterTicks[least]))
+	    least = i;
+    }
+    if ((waiterName[least] != NULL) && (waiterTicks[least] >= ticks))
+	return;
+    delete [] waiterName[least];
+    waiterName[least] = new char[strlen(threadName) + 1];
+    strcpy(waiterName[least], threadName);
+    waiterTicks[least] = ticks;
+}
+
+//----------------------------------------------------------------------
+// LockStats::Held
+// 	Count the object having been held for "ticks".
+//----------------------------------------------------------------------
+
+void
+LockStats::Held(int ticks)
+{
+    holdTicks += ticks;
+    maxHoldTicks = max(maxHoldTicks, ticks);
+}
+
+//----------------------------------------------------------------------
+// LockStats::Print
+// 	Print the profile, on a line, and then the threads that waited
+//	longest, longest first.
+//----------------------------------------------------------------------
+
+void
+LockStats::Print()
+{
+    bool done[LockTopWaiters];
+    int i;
+
+    printf("  %-9s %-24s %8d %8d %10d %8d %10d %8d\n", kind, name, acquires,
+	contended, waitTicks, maxWaitTicks, holdTicks, maxHoldTicks);
+    for (i = 0; i < LockTopWaiters; i++)
+	done[i] = (bool)(waiterName[i] == NULL);
+    for (;;) {
+	int best = -1;
+
+	for (i = 0; i < LockTopWaiters; i++)
+	    if (!done[i] && ((best < 0) || (waiterTicks[i] > waiterTicks[best])))
+		best = i;
+	if (best < 0)
+	    break;
+	printf("      waiter %-24s %10d\n", waiterName[best], waiterTicks[best]);
+	done[best] = TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Statistics::NewLock
+// 	Return the (empty) profile for a new lock, semaphore or condition,
+//	and keep it, to be printed -- or NULL, if lockstat is off.
+//
+//	"kind", "name" -- see LockStats::LockStats
+//----------------------------------------------------------------------
+
+LockStats *
+Statistics::NewLock(const char *kind, char *name)
+{
+    if (!lockStats)
+	return NULL;
+
+    LockStats *profile = new LockStats(kind, name);
+
+    profile->next = firstLock;
+    firstLock = profile;
+    return profile;
+}
+
+//----------------------------------------------------------------------
+// HistogramBucket
+// 	Return the bucket of a log2 histogram of "numBuckets" buckets that
+//	"value" goes in: the number of bits in it, up to the last bucket.
+//----------------------------------------------------------------------
+
+int
+HistogramBucket(int value, int numBuckets)
+{
+    int bucket = 0;
+
+    while ((value > 0) && (bucket < numBuckets - 1)) {
+	value >>= 1;
+	bucket++;
+    }
+    return bucket;
+}
+
+//----------------------------------------------------------------------
+// PrintHistogram
+// 	Print the buckets of a log2 histogram that are not empty, on a
+//	line after "title", with the range of values each one counts.
+//----------------------------------------------------------------------
+
+void
+PrintHistogram(const char *title, int *counts, int numBuckets)
+{
+    printf("%s:", title);
+    for (int i = 0; i < numBuckets; i++) {
+	if (counts[i] == 0)
+	    continue;
+	if (i == 0)
+	    printf(" 0: %d", counts[i]);
+	else if (i == numBuckets - 1)
+	    printf(" %d+: %d", 1 << (i - 1), counts[i]);
+	else
+	    printf(" %d-%d: %d", 1 << (i - 1), (1 << i) - 1, counts[i]);
+    }
+    printf("\n");
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordReadyWait
+// 	Count a thread having waited "ticks" on the ready list, in the
+//	right bucket of the latency histogram.
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordReadyWait(int ticks)
+{
+    readyLatency[HistogramBucket(ticks, LatencyBuckets)]++;
+}
+
+//----------------------------------------------------------------------
+// Statistics::CountSectors
+// 	Start counting the accesses to each of the "numSectors" sectors of
+//	the disk, for the heatmap.
+//----------------------------------------------------------------------
+
+void
+Statistics::CountSectors(int numSectors)
+{
+    if (numSectors <= numSectorsCounted)
+	return;
+    delete [] sectorAccesses;
+    sectorAccesses = new int[numSectors];
+    for (int i = 0; i < numSectors; i++)
+	sectorAccesses[i] = 0;
+    numSectorsCounted = numSectors;
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordDiskAccess
+// 	Count a disk request, for "count" sectors starting at
+//	"firstSector", for which the head moved "seekTracks" tracks and
+//	then waited "rotation" ticks for the first sector to come around
+//	-- unless it was read from the track buffer ("bufferHit").
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordDiskAccess(int firstSector, int count, int seekTracks,
+			     int rotation, bool bufferHit)
+{
+    seekDistance[HistogramBucket(seekTracks, SeekBuckets)]++;
+    numRotationTicks += rotation;
+    if (bufferHit)
+	numTrackBufferHits++;
+    for (int i = firstSector; i < firstSector + count; i++)
+	if (i < numSectorsCounted)
+	    sectorAccesses[i]++;
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordInterrupt
+// 	Count an interrupt of type "type" having been taken.
+//
+//	"name" -- what the type is called, for printing
+//	"late" -- how many ticks after it was due it was taken
+//	"ticks" -- the simulated time its handler took
+//	"hostTime" -- ... and the host nanoseconds
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordInterrupt(int type, const char *name, int late, int ticks,
+			    unsigned long long hostTime)
+{
+    ASSERT((type >= 0) && (type < NumIntTypes));
+    intName[type] = name;
+    intCount[type]++;
+    intTicks[type] += ticks;
+    intHostTime[type] += hostTime;
+    intLateTicks[type] += late;
+    intMaxLateTicks[type] = max(intMaxLateTicks[type], late);
 }
 
 //----------------------------------------------------------------------
@@ -33,12 +479,315 @@ Statistics::Statistics()
 void
 Statistics::Print()
 {
+    CPUStats all = Total();
+
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    if (numDiskRequests > 0)
+	printf("Disk scheduling: requests %d, average seek %.2f tracks\n",
+	    numDiskRequests, (double) numDiskSeekTracks / numDiskRequests);
+    PrintDisk();
+    printf("Sector cache: hits %d, misses %d, write-backs %d\n",
+	numCacheHits, numCacheMisses, numCacheWriteBacks);
+    printf("Read-ahead: sectors %d, used %d\n", numReadAheadSectors,
+	numReadAheadHits);
+    printf("Dentry cache: hits %d, misses %d\n", numDentryHits,
+	numDentryMisses);
+    printf("Journal: records %d, sectors %d, checkpoints %d\n",
+	numJournalRecords, numJournalSectors, numJournalCheckpoints);
+    printf("Log: segments %d, cleaned %d, sectors moved %d\n",
+	numLogSegments, numSegmentsCleaned, numCleanerMoves);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    printf("Paging: faults %d, TLB hits %d, TLB misses %d\n", numPageFaults,
+	all.numTLBHits, all.numTLBMisses);
+    if (all.numTLBMisses > 0)
+	printf("TLB reach: %.1f pages on average at a miss, at most %d; "
+	    "superpage hits %d\n", (double) all.tlbReachTotal /
+	    all.numTLBMisses, all.maxTLBReach, all.numSuperPageTLBHits);
+    printf("Prefetch: pages %d, used %d\n", numPagesPrefetched,
+	numPrefetchHits);
+    printf("Working set: pages trimmed %d\n", numPagesTrimmed);
+    printf("Copy-on-write: pages copied %d\n", numCopyOnWrite);
+    printf("Zeroed frames: zeroed while idle %d, used %d\n",
+	numFramesZeroed, numZeroedFramesUsed);
+    printf("Replacement: pages evicted %d, written back %d\n",
+	numPagesEvicted, numPageWriteBacks);
+    printf("Swap cache: pages kept %d, rejected %d, ratio %.2f, hits %d, "
+	"misses %d (%.1f%% hits), written out %d\n", numSwapCacheStores,
+	numSwapCacheRejects, (swapCacheBytesOut > 0) ?
+	    (double) swapCacheBytesIn / swapCacheBytesOut : 0.0,
+	numSwapCacheHits, numSwapCacheMisses,
+	(numSwapCacheHits + numSwapCacheMisses > 0) ? 100.0 *
+	    numSwapCacheHits / (numSwapCacheHits + numSwapCacheMisses) : 0.0,
+	numSwapCacheWrites);
+    printf("Page-out daemon: pages evicted %d, swap writes %d\n",
+	numPagesPagedOut, numPageOutWrites);
+    printf("Page table leaves: allocated %d, freed %d\n", numPageTableLeaves,
+	numPageTableLeavesFreed);
+    printf("Thread stacks: reused %d, allocated %d\n", numStackPoolHits,
+	numStackPoolMisses);
+    printf("Thread objects: reused %d, slabs allocated %d\n",
+	numThreadPoolHits, numThreadPoolMisses);
+    printf("List elements: reused %d, slabs allocated %d\n", numListPoolHits,
+	numListPoolMisses);
+    printf("Multiprocessor: threads stolen %d, migrations %d\n",
+	numThreadsStolen, numMigrations);
+    if ((numRealTimeJobs > 0) || (numRealTimeRefused > 0))
+	printf("Real-time: jobs %d, deadlines missed %d, max lateness %d, "
+	    "budget overruns %d, threads refused %d\n", numRealTimeJobs,
+	    numDeadlinesMissed, maxLateness, numBudgetOverruns,
+	    numRealTimeRefused);
+    printf("Timer: idle interrupts skipped %d\n", numTicksSkipped);
+    printf("Locks: acquired %d, contended %d\n", all.numLockAcquires,
+	all.numLockContended);
+    if (all.numL1Fetches > 0)
+	printf("L1 caches: I-cache fetches %d, misses %d; D-cache accesses "
+	    "%d, misses %d; stall ticks %d\n", all.numL1Fetches,
+	    all.numL1FetchMisses, all.numL1DataAccesses, all.numL1DataMisses,
+	    all.numL1StallTicks);
+    if (numCPUsCounted > 1)
+	for (int i = 0; i < numCPUsCounted; i++) {
+	    CPUStats *c = &cpuStats[i].counts;
+
+	    printf("  CPU %d: TLB hits %d, misses %d; locks acquired %d, "
+		"contended %d; L1 misses %d\n", i, c->numTLBHits,
+		c->numTLBMisses, c->numLockAcquires, c->numLockContended,
+		c->numL1FetchMisses + c->numL1DataMisses);
+	}
+    printf("NUMA: remote accesses %d, remote frames allocated %d\n",
+	numRemoteAccesses, numRemoteFrames);
+    printf("JIT: blocks compiled %d, code cache flushes %d\n",
+	numBlocksCompiled, numCodeCacheFlushes);
+    if (numParallelWindows > 0)
+	printf("Parallel: windows %d, ticks run alongside %d\n",
+	    numParallelWindows, numParallelTicks);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+    PrintHistogram("Ready-queue wait (ticks)", readyLatency, LatencyBuckets);
+    for (ThreadStats *t = firstThread; t != NULL; t = t->next)
+	printf("Thread %s: user %d, system %d, switches %d, ready %d\n",
+	    t->name, t->userTicks, t->systemTicks, t->numSwitches,
+	    t->readyTicks);
+    PrintLocks();
+    PrintInterrupts();
+    PrintSyscalls();
+    PrintInstructionMix();
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintLocks
+// 	If lockstat is on, print the profiles of the LockReportSize
+//	synchronization objects that threads spent longest waiting for,
+//	longest first (and then those taken most), leaving out any never
+//	taken at all.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintLocks()
+{
+    LockStats *report[LockReportSize];
+    int n = 0;
+    int i;
+
+    if (!lockStats)
+	return;
+    for (LockStats *l = firstLock; l != NULL; l = l->next) {
+	if (l->acquires == 0)
+	    continue;
+	for (i = n; i > 0; i--) {		// insertion sort, keeping
+	    LockStats *prev = report[i - 1];	// the top LockReportSize
+
+	    if ((prev->waitTicks > l->waitTicks)
+		    || ((prev->waitTicks == l->waitTicks)
+			&& (prev->acquires >= l->acquires)))
+		break;
+	    if (i < LockReportSize)
+		report[i] = prev;
+	}
+	if (i < LockReportSize) {
+	    report[i] = l;
+	    if (n < LockReportSize)
+		n++;
+	}
+    }
+    printf("Lock contention (ticks):\n");
+    printf("  %-9s %-24s %8s %8s %10s %8s %10s %8s\n", "", "", "acquires",
+	"waited", "wait", "max", "hold", "max");
+    for (i = 0; i < n; i++)
+	report[i]->Print();
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintDisk
+// 	If the disk was used, print how far the head moved for each
+//	request, how long the requests waited for the disk to turn, and
+//	how many the track buffer served; and the heatmap, as the accesses
+//	to each track.  With -diskmap, also write the accesses to every
+//	sector to a host file, a line for each sector used: its number,
+//	track, and count.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintDisk()
+{
+    int requests = 0;
+    int i;
+
+    for (i = 0; i < SeekBuckets; i++)
+	requests += seekDistance[i];
+    if (requests == 0)
+	return;
+    PrintHistogram("Disk seeks (tracks)", seekDistance, SeekBuckets);
+    printf("Disk rotation: average wait %.1f ticks, track buffer hits %d\n",
+	(double) numRotationTicks / requests, numTrackBufferHits);
+    printf("Disk heatmap (accesses by track):");
+    for (i = 0; i < numSectorsCounted; i += SectorsPerTrack) {
+	int accesses = 0;
+
+	for (int j = i; j < i + SectorsPerTrack; j++)
+	    accesses += sectorAccesses[j];
+	printf(" %d", accesses);
+    }
+    printf("\n");
+    if (diskMapFile == NULL)
+	return;
+
+    FILE *map = fopen(diskMapFile, "w");
+
+    if (map == NULL) {
+	printf("Cannot write the disk heatmap to %s\n", diskMapFile);
+	return;
+    }
+    for (i = 0; i < numSectorsCounted; i++)
+	if (sectorAccesses[i] > 0)
+	    fprintf(map, "%d %d %d\n", i, i / SectorsPerTrack,
+		    sectorAccesses[i]);
+    fclose(map);
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintInterrupts
+// 	If any interrupts were taken, print, for each type, most taken
+//	first, how many there were, what their handlers took on average,
+//	in simulated ticks and host nanoseconds, and how late they were
+//	taken, on average and at most.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintInterrupts()
+{
+    bool done[NumIntTypes];
+    int total = 0;
+    int i;
+
+    for (i = 0; i < NumIntTypes; i++) {
+	total += intCount[i];
+	done[i] = FALSE;
+    }
+    if (total == 0)
+	return;
+    printf("Interrupts: %d\n", total);
+    for (;;) {
+	int best = -1;
+
+	for (i = 0; i < NumIntTypes; i++)
+	    if (!done[i] && (intCount[i] > 0)
+		    && ((best < 0) || (intCount[best] < intCount[i])))
+		best = i;
+	if (best < 0)
+	    break;
+	printf("  %-14s %8d %8.1f ticks %8.0f ns, late %.1f (max %d) ticks\n",
+	    intName[best], intCount[best],
+	    (double) intTicks[best] / intCount[best],
+	    (double) intHostTime[best] / intCount[best],
+	    (double) intLateTicks[best] / intCount[best], intMaxLateTicks[best]);
+	done[best] = TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintSyscalls
+// 	If user programs made any system calls, print, for each call made,
+//	most made first, how many times it was, and what each took on
+//	average, in simulated ticks and host nanoseconds -- waiting
+//	included, for the calls that wait (like Join, or Read from the
+//	console).
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintSyscalls()
+{
+    bool done[NumSyscalls];
+    int total = 0;
+    int i;
+
+    for (i = 0; i < NumSyscalls; i++) {
+	total += syscallCount[i];
+	done[i] = FALSE;
+    }
+    if (total == 0)
+	return;
+    printf("System calls: %d\n", total);
+    for (;;) {
+	int best = -1;
+
+	for (i = 0; i < NumSyscalls; i++)
+	    if (!done[i] && (syscallCount[i] > 0)
+		    && ((best < 0) || (syscallCount[best] < syscallCount[i])))
+		best = i;
+	if (best < 0)
+	    break;
+	printf("  %-12s %8d %10.1f ticks %10.0f ns\n",
+	    (syscallName[best] != NULL) ? syscallName[best] : "?",
+	    syscallCount[best], (double) syscallTicks[best] / syscallCount[best],
+	    (double) syscallHostTime[best] / syscallCount[best]);
+	done[best] = TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintInstructionMix
+// 	If the simulator counted the instructions it ran (it only does if
+//	it was compiled with -DINSTR_STATS), print the mix of them: how
+//	many loads, stores, and so on; and for each opcode, most run
+//	first, how many there were, and how many host cycles the
+//	simulator took for each, on average.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintInstructionMix()
+{
+    bool done[NumOpcodes];
+    int total = 0;
+    int i;
+
+    for (i = 0; i < NumOpcodes; i++) {
+	total += opcodeCount[i];
+	done[i] = FALSE;
+    }
+    if (total == 0)
+	return;
+    printf("Instructions: %d, loads %d, stores %d, branches %d (taken %d), "
+	"delay slots %d, in blocks %d (fused %d)\n", total, numLoads,
+	numStores, numBranches, numBranchesTaken, numDelaySlots,
+	numBlockInstrs, numFusedInstrs);
+    for (;;) {
+	int best = -1;
+
+	for (i = 0; i < NumOpcodes; i++)
+	    if (!done[i] && (opcodeCount[i] > 0)
+		    && ((best < 0) || (opcodeCount[i] > opcodeCount[best])))
+		best = i;
+	if (best < 0)
+	    break;
+	// the names are the simulator's disassembly formats: print just
+	// the mnemonic
+	printf("  %-8.*s %10d %5.1f%% %8.1f cycles\n",
+	    (int) strcspn(opcodeName[best], " "), opcodeName[best],
+	    opcodeCount[best], 100.0 * opcodeCount[best] / total,
+	    opcodeCycles[best] / opcodeCount[best]);
+	done[best] = TRUE;
+    }
 }
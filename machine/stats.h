@@ -13,6 +13,123 @@
 
 #include "copyright.h"
 
+#define LatencyBuckets	16	// the ready-queue wait histogram: bucket i
+				// counts waits of 2^(i-1) to 2^i - 1
+				// ticks (bucket 0, waits of none), and
+				// the last, everything longer
+
+#define SeekBuckets	12	// the seek-distance histogram, in tracks,
+				// bucketed the same way
+
+#define NumOpcodes	64	// the simulator's opcodes, OP_* in mipssim.h
+				// (MaxOpcode + 1)
+
+#define LockTopWaiters	3	// the threads that waited longest, kept
+				// for each lock by lockstat
+
+#define LockReportSize	20	// the locks lockstat prints, most waited
+				// for first
+
+#define NumIntTypes	8	// room for the interrupt types, IntType in
+				// interrupt.h
+
+#define NumSyscalls	32	// room for the system call codes, SC_* in
+				// syscall.h
+
+#define StatsCPUs	8	// CPUs whose counters are kept apart (as
+				// MaxCPUs, scheduler.h)
+
+#define CacheLineSize	64	// bytes in a host cache line
+
+// The following class defines the counters that go up on every
+// instruction, or nearly -- TLB lookups, L1 cache accesses, lock
+// acquires -- of which each simulated CPU (see -smp) keeps its own
+// block, counting what happens while it runs.  The blocks are padded
+// out to a cache line each, so that if the CPUs counted on host
+// threads of their own, counting would not bounce one shared line
+// between them (or race).  (With -hp, only user code runs on other
+// host threads, with none of the models these count; see mipspar.cc.)
+// The blocks are added up to be printed (see Statistics::Total).
+
+class CPUStats {
+  public:
+    void Add(CPUStats *other);	// add in another CPU's counters
+
+    int numTLBHits;		// number of translations found in the TLB
+    int numTLBMisses;		// number of TLB misses (refilled by the kernel)
+    int numSuperPageTLBHits;	// ... and hits on superpage entries
+    int tlbReachTotal;		// pages the TLB mapped, summed over the
+				// misses (for the average reach)
+    int maxTLBReach;		// ... and the most it ever mapped
+    int numL1Fetches;		// user instruction fetches, with the L1
+				// cache model on (see memcache.h)
+    int numL1FetchMisses;	// ... that missed in the I-cache
+    int numL1DataAccesses;	// user loads and stores
+    int numL1DataMisses;	// ... that missed in the D-cache
+    int numL1StallTicks;	// ticks charged for all the misses
+    int numLockAcquires;	// calls to Lock::Acquire
+    int numLockContended;	// ... that found the lock busy, and had
+				// to wait
+};
+
+// A CPU's block, padded out to a whole number of cache lines
+
+union PaddedCPUStats {
+    CPUStats counts;
+    char pad[(sizeof(CPUStats) + CacheLineSize - 1) / CacheLineSize
+	     * CacheLineSize];
+};
+
+// The following class defines the CPU time charged to one thread, and
+// how often, and for how long, it waited on the ready list.  The
+// scheduler keeps it up to date (see Scheduler::Run).
+
+class ThreadStats {
+  public:
+    ThreadStats(char *threadName);	// all zero, to begin with
+    ~ThreadStats();
+
+    void Reset();		// back to zero, for another thread
+
+    char *name;			// a copy of the thread's name, or NULL
+				// if it will never be printed
+    int userTicks;		// Time charged to it, running user code
+    int systemTicks;		// ... and system code
+    int numSwitches;		// times it was switched to
+    int readyTicks;		// time it spent on the ready list
+    ThreadStats *next;		// the next one kept by Statistics
+};
+
+// The following class defines the contention profile of one Lock,
+// Semaphore or Condition, kept only with lockstat on (see -lockstat):
+// how often it was taken, how often a thread had to wait for it, and
+// how long, and how long it was held.  For a semaphore, taking it is
+// a P, and it is never "held"; for a condition, it is a Wait, which
+// always waits.
+
+class LockStats {
+  public:
+    LockStats(const char *objectKind, char *objectName);
+    ~LockStats();
+
+    void Waited(char *threadName, int ticks);	// a thread waited that
+						// long for it
+    void Held(int ticks);			// it was held that long
+    void Print();
+
+    const char *kind;		// "lock", "semaphore" or "condition"
+    char *name;			// a copy of its debugName
+    int acquires;		// times it was taken
+    int contended;		// ... and had to be waited for
+    int waitTicks;		// time spent waiting for it, in all,
+    int maxWaitTicks;		// and the longest wait
+    int holdTicks;		// time it was held, in all,
+    int maxHoldTicks;		// and the longest
+    char *waiterName[LockTopWaiters];	// the threads that waited
+    int waiterTicks[LockTopWaiters];	// longest, in all, and how long
+    LockStats *next;		// the next one kept by Statistics
+};
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -33,12 +150,171 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numPagesPrefetched;	// pages brought in early, after a fault
+				// on an earlier page (fault-around)
+    int numPrefetchHits;	// prefetched pages that were then used
+    int numPagesTrimmed;	// pages given up by a program that had
+				// gone a while without a page fault
+    int numCopyOnWrite;		// pages copied on a write, after a Fork
+				// left them shared
+    int numFramesZeroed;	// free frames zeroed while idle
+    int numZeroedFramesUsed;	// ... and then taken for a page that
+				// was to be zeroed (saving the bzero)
+    int numPagesEvicted;	// pages evicted on a page fault, to free
+				// a frame
+    int numPageWriteBacks;	// ... that were dirty, and were written
+				// to swap (or to their mapped file)
+    int numSwapCacheStores;	// evicted pages kept, compressed, in the
+				// swap cache (-zswap)
+    int numSwapCacheRejects;	// ... and not kept: they didn't compress
+    int swapCacheBytesIn;	// bytes of the pages kept, before
+    int swapCacheBytesOut;	// and after compression
+    int numSwapCacheHits;	// faults on swapped pages served from it
+    int numSwapCacheMisses;	// ... and from the swap file
+    int numSwapCacheWrites;	// pages written out of it, to make room
+    int numPagesPagedOut;	// pages evicted by the page-out daemon
+    int numPageOutWrites;	// ... and the swap writes it took
+    int numPageTableLeaves;	// leaves of two-level page tables
+				// allocated, when first touched
+    int numPageTableLeavesFreed; // ... and freed, with a hole left
+    int numStackPoolHits;	// thread stacks reused from the pool
+    int numStackPoolMisses;	// thread stacks allocated from the host
+    int numThreadPoolHits;	// Thread objects reused from the pool
+    int numThreadPoolMisses;	// slabs of them allocated from the host
+    int numListPoolHits;	// list elements reused from the free list
+    int numListPoolMisses;	// slabs of them allocated from the host
+    int numThreadsStolen;	// threads one simulated CPU took from
+				// another's ready queue
+    int numMigrations;		// times a thread moved to another CPU
+				// (stolen, or sent by its affinity)
+    int numRealTimeJobs;	// jobs started by real-time threads
+    int numDeadlinesMissed;	// ... that finished after their deadline
+    int maxLateness;		// the latest any of them finished, in ticks
+    int numBudgetOverruns;	// times one used up its budget, and had
+				// its deadline put off
+    int numRealTimeRefused;	// threads refused by admission control
+    int numTicksSkipped;	// timer interrupts not taken while idle
+    int numCacheHits;		// sector reads found in the sector cache
+    int numCacheMisses;		// ... and not found
+    int numCacheWriteBacks;	// dirty sectors written back from it
+    int numReadAheadSectors;	// sectors read into it ahead of time
+    int numReadAheadHits;	// ... that were then asked for
+    int numDentryHits;		// path components found in the dentry cache
+    int numDentryMisses;	// ... and looked up in a directory
+    int numJournalRecords;	// file system operations journaled
+    int numJournalSectors;	// sectors written to the journal for them
+    int numJournalCheckpoints;	// times the journal was emptied
+    int numLogSegments;		// log segments filled
+    int numSegmentsCleaned;	// ... and cleaned
+    int numCleanerMoves;	// sectors the cleaner moved for that
+    int numDiskRequests;	// disk requests scheduled by SynchDisk
+    int numDiskSeekTracks;	// tracks the head moved for them, in all
+    int seekDistance[SeekBuckets];	// how far the disk head moved for
+				// each request it was sent (log2
+				// histogram, see above)
+    int numRotationTicks;	// time spent waiting for sectors to come
+				// around under the head
+    int numTrackBufferHits;	// reads served from the track buffer
+    int *sectorAccesses;	// how many times each sector was read or
+    int numSectorsCounted;	// written (the disk heatmap), and how
+				// many sectors there are
+    const char *diskMapFile;	// where to write the heatmap at Halt
+				// (see -diskmap), or NULL
+    int numRemoteAccesses;	// user accesses to another node's memory
+    int numRemoteFrames;	// frames allocated on another node, for
+				// want of a free one on the thread's own
+    int numBlocksCompiled;	// basic blocks compiled by the JIT
+    int numCodeCacheFlushes;	// times its code cache filled up
+    int numParallelWindows;	// windows of user code run on host threads
+    int numParallelTicks;	// ... the ticks the gangs ran in them, on
+				// the other CPUs (see Machine::RunParallel)
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int readyLatency[LatencyBuckets];	// how long threads waited on the
+				// ready list, before they ran (log2
+				// histogram, see above)
+    bool lockStats;		// profile every lock, semaphore and
+				// condition (see LockStats)
+    bool perThread;		// keep every thread's ThreadStats (even
+				// after it finishes), and print them
+
+    // The instruction mix, only counted if the simulator is compiled
+    // with -DINSTR_STATS (see Machine::CountInstruction)
+    int numLoads;		// user loads,
+    int numStores;		// stores,
+    int numBranches;		// and branches and jumps,
+    int numBranchesTaken;	// ... of which this many went elsewhere
+    int numDelaySlots;		// instructions run in a branch delay slot
+    int numBlockInstrs;		// instructions run by the basic-block engine
+				// (the rest by OneInstruction)
+    int numFusedInstrs;		// ... of which this many in fused pairs
+    int opcodeCount[NumOpcodes];	// instructions run, by opcode
+    double opcodeCycles[NumOpcodes];	// host cycles spent running them
+    const char *opcodeName[NumOpcodes];	// (and how to print each opcode)
+
+    // The interrupts taken, counted by Interrupt::CheckIfDue, by type
+    int intCount[NumIntTypes];	// interrupts taken
+    int intTicks[NumIntTypes];	// simulated time in their handlers (and
+				// the cost of taking them), in all
+    unsigned long long intHostTime[NumIntTypes];
+				// ... and host nanoseconds
+    int intLateTicks[NumIntTypes];	// how long after they were due they
+    int intMaxLateTicks[NumIntTypes];	// were taken, in all, and at most
+				// (while interrupts were off, say)
+    const char *intName[NumIntTypes];	// (and what each type is called)
+
+    // The system calls, counted by the kernel's dispatcher (see
+    // ExceptionHandler), by code
+    int syscallCount[NumSyscalls];	// calls made
+    int syscallTicks[NumSyscalls];	// simulated time from the trap to
+				// the return, in all (none for calls
+				// that never return, Exit and Halt)
+    unsigned long long syscallHostTime[NumSyscalls];
+				// ... and host nanoseconds
+    const char *syscallName[NumSyscalls];	// (and what each is called)
+
+    CPUStats *thisCPU;		// the counters of the CPU running now
 
     Statistics(); 		// initialize everything to zero
 
+    void RunningOn(int cpu);	// CPU "cpu" is running now: count on it
+    CPUStats Total();		// the counters of all the CPUs, added up
+
+    ThreadStats *NewThread(char *name);	// the accounts of a new thread
+    void EndThread(ThreadStats *account);	// ... which has finished
+    void RecordReadyWait(int ticks);	// a thread waited that long to run
+    void CountSectors(int numSectors);	// start the disk heatmap
+    void RecordDiskAccess(int firstSector, int count, int seekTracks,
+			  int rotation, bool bufferHit);
+				// the disk did a request (see
+				// Disk::Transfer)
+    void RecordInterrupt(int type, const char *name, int late, int ticks,
+			 unsigned long long hostTime);
+				// an interrupt was taken (see above)
+    LockStats *NewLock(const char *kind, char *name);
+				// the profile of a new synchronization
+				// object, or NULL if lockstat is off
+
     void Print();		// print collected statistics
+
+  private:
+    void PrintInstructionMix();	// print the opcode counts, if any
+    void PrintSyscalls();	// print the system call counts, if any
+    void PrintInterrupts();	// print the interrupt counts, if any
+    void PrintDisk();		// print the disk histograms, and write
+				// the heatmap, if the disk was used
+    void PrintLocks();		// print the locks waited for most
+
+    PaddedCPUStats *cpuStats;	// each CPU's counters, StatsCPUs of them,
+				// starting on a cache line
+    int numCPUsCounted;		// how many CPUs have run
+
+    ThreadStats *firstThread;	// the accounts kept, if perThread, in
+    ThreadStats *lastThread;	// the order the threads were created
+    ThreadStats *freeAccounts;	// accounts of deleted threads, for reuse
+				// (if not perThread)
+    LockStats *firstLock;	// the lock profiles, if lockStats, newest
+				// first
 };
 
 // Constants used to reflect the relative time an operation would
@@ -48,6 +324,10 @@ class Statistics {
 // Since Nachos kernel code is directly executed, and the time spent
 // in the kernel measured by the number of calls to enable interrupts,
 // these time constants are none too exact.
+//
+// The costs the CPU pays -- per instruction, per interrupt, per context
+// switch -- and the time slice are only the defaults for the variables
+// below, which can be set at boot (see system.cc).
 
 #define UserTick 	1	// advance for each user-level instruction 
 #define SystemTick 	10 	// advance each time interrupts are enabled
@@ -55,6 +335,24 @@ class Statistics {
 #define SeekTime 	500    	// time disk takes to seek past one track
 #define ConsoleTime 	100	// time to read or write one character
 #define NetworkTime 	100   	// time to send or receive one packet
+#define InputCheckTime	100	// time between checks for host input,
+				// while the CPU is busy (see sysdep.cc)
 #define TimerTicks 	100    	// (average) time between timer interrupts
+#define InterruptTick	0	// overhead of taking an interrupt
+#define SwitchTick	0	// cost of a context switch (SWITCH)
+
+extern int userTick;		// the above, as set at boot: UserTick,
+extern int systemTick;		// SystemTick, TimerTicks, InterruptTick
+extern int timerTicks;		// and SwitchTick
+extern int interruptTicks;
+extern int switchTicks;
+
+// Log2 histograms, as Statistics keeps them: bucket i counts values of
+// 2^(i-1) to 2^i - 1 (bucket 0, zero), and the last, everything bigger.
+
+int HistogramBucket(int value, int numBuckets);
+				// the bucket "value" goes in
+void PrintHistogram(const char *title, int *counts, int numBuckets);
+				// print the buckets that aren't empty
 
 #endif // STATS_H
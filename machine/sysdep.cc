@@ -34,7 +34,10 @@ extern "C" {
 #include <sys/socket.h>
 #include <sys/file.h>
 #include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <sys/errno.h>
 #ifdef HOST_i386
 #include <sys/time.h>
@@ -45,9 +48,15 @@ extern "C" {
 #ifdef HOST_ALPHA
 #include <sys/time.h>
 #endif
+#ifdef HOST_x86_64
+#include <unistd.h>
+#include <stdlib.h>
+#endif
 
-// UNIX routines called by procedures in this file 
+// UNIX routines called by procedures in this file (on x86-64, the
+// system headers declare them, with 64-bit sizes)
 
+#ifndef HOST_x86_64
 #ifdef HOST_SNAKE
 // int creat(char *name, unsigned short mode);
 // int open(const char *name, int flags, ...);
@@ -99,11 +108,154 @@ int recvfrom (int, void*, int, int, void*, int *);
 int sendto (int, const void*, int, int, void*, int);
 #endif
 #endif
+#endif // HOST_x86_64
 }
 
 #include "interrupt.h"
 #include "system.h"
 
+//----------------------------------------------------------------------
+// Record and replay
+//	All that can make one run of Nachos differ from another, given the
+//	same flags, is what it learns from the host: when input arrives
+//	on the console or the network, how many packets are waiting, and
+//	the pseudo-random numbers (which decide the timer's interrupts
+//	with -rs, and the packets the network loses or delays).  Given
+//	those, every interrupt arrives on the same tick, every time.
+//
+//	So, with -record, each such answer is written to a log, one line
+//	per answer:
+//
+//		<kind> <question number> <tick> <value>
+//
+//	where the question number counts the questions asked so far,
+//	and the kind is one of:
+//
+//		r -- Random() returned the value
+//		p -- PollFile said whether there was input (1) or not (0)
+//		w -- a watched file had input: the value is its descriptor
+//		     (a check of the watched files that found none is not
+//		     logged)
+//		h -- ReadFromHosts read that many packets
+//
+//	With -replay, the same questions get the same answers from the
+//	log, waiting for the input if it has not arrived yet, so that the
+//	run repeats the recorded one tick for tick.  Machines talking over
+//	the network must all replay, each its own log.  If the run asks
+//	something else than the log says was asked, it has diverged -- the
+//	code or the flags changed in a way that matters -- and we stop.
+//	At the end of the log, the run goes on live.
+//----------------------------------------------------------------------
+
+static FILE *recordLog = NULL;		// where answers are written, or
+static FILE *replayLog = NULL;		// read from
+static int questionCount = 0;		// questions asked of the host
+
+static bool haveLogged = FALSE;		// the next answer in the replay log
+static char loggedKind;
+static int loggedQuestion, loggedTick, loggedValue;
+
+//----------------------------------------------------------------------
+// RecordHostEvents, ReplayHostEvents
+// 	Start writing the answers the host gives to the log "name", or
+//	start answering from it.
+//----------------------------------------------------------------------
+
+void
+RecordHostEvents(char *name)
+{
+    recordLog = fopen(name, "w");
+    ASSERT(recordLog != NULL);
+}
+
+void
+ReplayHostEvents(char *name)
+{
+    replayLog = fopen(name, "r");
+    ASSERT(replayLog != NULL);
+}
+
+//----------------------------------------------------------------------
+// CurrentTick
+// 	The simulated time, for the log.
+//----------------------------------------------------------------------
+
+static int
+CurrentTick()
+{
+    return (stats != NULL) ? stats->totalTicks : 0;
+}
+
+//----------------------------------------------------------------------
+// RecordAnswer
+// 	Write the answer to the current question to the log, if we are
+//	recording.
+//----------------------------------------------------------------------
+
+static void
+RecordAnswer(char kind, int value)
+{
+    if (recordLog != NULL)
+	fprintf(recordLog, "%c %d %d %d\n", kind, questionCount,
+		CurrentTick(), value);
+}
+
+//----------------------------------------------------------------------
+// ReplayAnswer
+// 	If we are replaying, find the logged answer to the current
+//	question, of kind "kind": return TRUE, and the answer in "value".
+//	Return FALSE if we are not replaying, or if the log has no answer
+//	to this question -- which can only be a check of the watched
+//	files that found nothing.  Each call takes one answer; call again
+//	for the next, for a question with several.
+//----------------------------------------------------------------------
+
+static bool
+ReplayAnswer(char kind, int *value)
+{
+    if (replayLog == NULL)
+	return FALSE;
+    if (!haveLogged) {
+	if (fscanf(replayLog, " %c %d %d %d", &loggedKind, &loggedQuestion,
+		   &loggedTick, &loggedValue) != 4) {
+	    printf("Replay: end of log at tick %d, running live\n",
+		   CurrentTick());
+	    fclose(replayLog);
+	    replayLog = NULL;
+	    return FALSE;
+	}
+	haveLogged = TRUE;
+    }
+    if ((loggedQuestion > questionCount) && (kind == 'w'))
+	return FALSE;			// no input found by this check
+    if ((loggedQuestion != questionCount) || (loggedKind != kind)
+	    || (loggedTick != CurrentTick())) {
+	fprintf(stderr, "Replay diverged at tick %d: asked '%c' #%d, "
+		"log has '%c' #%d at tick %d\n", CurrentTick(), kind,
+		questionCount, loggedKind, loggedQuestion, loggedTick);
+	Abort();
+    }
+    haveLogged = FALSE;
+    *value = loggedValue;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// WaitForInput
+// 	Wait for as long as it takes for "fd" to have input: when
+//	replaying, the log says it has, but it may not have arrived yet.
+//----------------------------------------------------------------------
+
+static void
+WaitForInput(int fd)
+{
+    fd_set rfd;
+
+    FD_ZERO(&rfd);
+    FD_SET(fd, &rfd);
+    (void) select(fd + 1, &rfd, NULL, NULL, NULL);
+}
+
 //----------------------------------------------------------------------
 // PollFile
 // 	Check open file or open socket to see if there are any 
@@ -126,6 +278,14 @@ PollFile(int fd)
 {
     int rfd = (1 << fd), wfd = 0, xfd = 0, retVal;
     struct timeval pollTime;
+    int logged;
+
+    questionCount++;
+    if (ReplayAnswer('p', &logged)) {
+	if (logged)
+	    WaitForInput(fd);
+	return logged;
+    }
 
 // decide how long to wait if there are no characters on the file
     pollTime.tv_sec = 0;
@@ -135,18 +295,175 @@ PollFile(int fd)
         pollTime.tv_usec = 0;                 	// no delay
 
 // poll file or socket
-#if defined(HOST_i386) || defined(HOST_ALPHA)
+#if defined(HOST_i386) || defined(HOST_x86_64) || defined(HOST_ALPHA)
     retVal = select(32, (fd_set*)&rfd, (fd_set*)&wfd, (fd_set*)&xfd, &pollTime);
 #else
     retVal = select(32, &rfd, &wfd, &xfd, &pollTime);
 #endif
 
     ASSERT((retVal == 0) || (retVal == 1));
+    RecordAnswer('p', retVal);
     if (retVal == 0)
 	return FALSE;                 		// no char waiting to be read
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// WatchFile, UnwatchFile
+// 	Start, or stop, watching an open file or socket for input.  Once
+//	there is some, "handler" is called, and the file is no longer
+//	watched: the device calls WatchFile again once it has read the
+//	input in.
+//
+//	The handler is called as an interrupt handler would be, with
+//	interrupts off, so all it should do is schedule the device's
+//	interrupt.
+//
+//	"fd" -- the file descriptor of the file to be watched
+//	"handler", "arg" -- what to call when there is input on it
+//----------------------------------------------------------------------
+
+#define MaxWatchedFiles	16
+
+static struct {
+    int fd;
+    VoidFunctionPtr handler;
+    _int arg;
+} watched[MaxWatchedFiles];
+static int numWatched = 0;		// entries in use in "watched"
+static int nextInputCheck = 0;		// when CheckWatchedFiles is next
+					// to look
+
+void
+WatchFile(int fd, VoidFunctionPtr handler, _int arg)
+{
+    ASSERT((fd >= 0) && (fd < FD_SETSIZE));
+    UnwatchFile(fd);
+    ASSERT(numWatched < MaxWatchedFiles);
+    watched[numWatched].fd = fd;
+    watched[numWatched].handler = handler;
+    watched[numWatched].arg = arg;
+    numWatched++;
+}
+
+void
+UnwatchFile(int fd)
+{
+    for (int i = 0; i < numWatched; i++)
+	if (watched[i].fd == fd) {
+	    watched[i] = watched[--numWatched];
+	    return;
+	}
+}
+
+//----------------------------------------------------------------------
+// SelectWatchedFiles
+// 	Check all the watched files for input with a single select, and
+//	call the handler of each that has some.  Returns TRUE if any did.
+//
+//	"pollTime" -- how long to wait for input (NULL -> until there is)
+//----------------------------------------------------------------------
+
+static bool
+SelectWatchedFiles(struct timeval *pollTime)
+{
+    fd_set rfd;
+    int maxFd = -1, retVal, i, logged;
+
+    questionCount++;
+    if (replayLog != NULL) {		// the log says which had input
+	bool any = FALSE;
+
+	while (ReplayAnswer('w', &logged)) {
+	    for (i = 0; (i < numWatched) && (watched[i].fd != logged); i++)
+		;
+	    ASSERT(i < numWatched);	// it must be watched still
+	    VoidFunctionPtr handler = watched[i].handler;
+	    _int arg = watched[i].arg;
+
+	    watched[i] = watched[--numWatched];
+	    (*handler)(arg);
+	    any = TRUE;
+	}
+	if (any || (replayLog != NULL))
+	    return any;
+    }					// (else the log ran out: go live)
+
+    FD_ZERO(&rfd);
+    for (i = 0; i < numWatched; i++) {
+	FD_SET(watched[i].fd, &rfd);
+	if (watched[i].fd > maxFd)
+	    maxFd = watched[i].fd;
+    }
+    retVal = select(maxFd + 1, &rfd, NULL, NULL, pollTime);
+    if (retVal <= 0)
+	return FALSE;			// nothing to read (or interrupted)
+
+    i = 0;
+    while (i < numWatched) {		// a handler may watch again, so
+	if (FD_ISSET(watched[i].fd, &rfd)) {	// take the entry out first
+	    VoidFunctionPtr handler = watched[i].handler;
+	    _int arg = watched[i].arg;
+
+	    FD_CLR(watched[i].fd, &rfd);
+	    RecordAnswer('w', watched[i].fd);
+	    watched[i] = watched[--numWatched];
+	    (*handler)(arg);
+	} else
+	    i++;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CheckWatchedFiles
+// 	Called on every tick of simulated time; once every InputCheckTime
+//	ticks, see if any of the watched files has input, without waiting.
+//	This one check stands in for the console and the network each
+//	polling for input on its own.
+//----------------------------------------------------------------------
+
+void
+CheckWatchedFiles()
+{
+    struct timeval pollTime;
+
+    if ((numWatched == 0) || (stats->totalTicks < nextInputCheck))
+	return;
+    nextInputCheck = stats->totalTicks + InputCheckTime;
+    pollTime.tv_sec = 0;
+    pollTime.tv_usec = 0;
+    (void) SelectWatchedFiles(&pollTime);
+}
+
+//----------------------------------------------------------------------
+// WaitForWatchedFiles
+// 	Called when there are no threads for us to run: wait for input
+//	on any of the watched files.  Returns TRUE if there was some.
+//
+//	If there is something else to do (some interrupt is pending), we
+//	only wait a short fixed time, as PollFile does, to give other
+//	Nachos a chance to get our host's CPU.  Otherwise, the input is
+//	all we can be waiting for, so we wait as long as it takes -- with
+//	nothing else running.  If no files are being watched, of course,
+//	there's nothing to wait for.
+//
+//	"forever" -- if TRUE, nothing else is pending
+//----------------------------------------------------------------------
+
+bool
+WaitForWatchedFiles(bool forever)
+{
+    struct timeval pollTime;
+
+    if (numWatched == 0)
+	return FALSE;
+    nextInputCheck = stats->totalTicks + InputCheckTime;
+    pollTime.tv_sec = 0;
+    pollTime.tv_usec = 20000;		// delay to let other nachos run
+    return SelectWatchedFiles(forever ? NULL : &pollTime);
+}
+
 //----------------------------------------------------------------------
 // OpenForWrite
 // 	Open a file for writing.  Create it if it doesn't exist; truncate it 
@@ -218,6 +535,119 @@ WriteFile(int fd, char *buffer, int nBytes)
     ASSERT(retVal == nBytes);
 }
 
+//----------------------------------------------------------------------
+// ReadVector
+// 	Read "count" pieces of "size" bytes each, starting at "offset" in
+//	an open file, into the buffers "buffers" (which need not be next
+//	to each other), all in one system call.  Abort if the read fails.
+//----------------------------------------------------------------------
+
+void
+ReadVector(int fd, char **buffers, int count, int size, int offset)
+{
+    struct iovec *pieces = new struct iovec[count];
+
+    for (int i = 0; i < count; i++) {
+	pieces[i].iov_base = buffers[i];
+	pieces[i].iov_len = size;
+    }
+    int retVal = preadv(fd, pieces, count, offset);
+    ASSERT(retVal == count * size);
+    delete [] pieces;
+}
+
+//----------------------------------------------------------------------
+// WriteVector
+// 	Write "count" pieces of "size" bytes each, from the buffers
+//	"buffers", starting at "offset" in an open file, all in one
+//	system call.  Abort if the write fails.
+//----------------------------------------------------------------------
+
+void
+WriteVector(int fd, char **buffers, int count, int size, int offset)
+{
+    struct iovec *pieces = new struct iovec[count];
+
+    for (int i = 0; i < count; i++) {
+	pieces[i].iov_base = buffers[i];
+	pieces[i].iov_len = size;
+    }
+    int retVal = pwritev(fd, pieces, count, offset);
+    ASSERT(retVal == count * size);
+    delete [] pieces;
+}
+
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "size" bytes of an open file into memory, shared,
+//	so that changes to the memory are changes to the file.  Abort if
+//	the file can't be mapped.
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int size)
+{
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    ASSERT(addr != MAP_FAILED);
+    return (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// AllocExecutable
+// 	Allocate "size" bytes of memory that the host will let us both
+//	write and run as code, for the simulator's JIT (see mipsjit.cc).
+//	Returns NULL if the host won't give us any.
+//----------------------------------------------------------------------
+
+char *
+AllocExecutable(int size)
+{
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (addr == MAP_FAILED)
+	return NULL;
+    return (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// FreeExecutable
+// 	Give back memory got from AllocExecutable.
+//----------------------------------------------------------------------
+
+void
+FreeExecutable(char *addr, int size)
+{
+    int retVal = munmap(addr, size);
+    ASSERT(retVal >= 0);
+}
+
+//----------------------------------------------------------------------
+// SyncMappedFile
+// 	Write the changes made to a file mapped by MapFile back to it.
+//----------------------------------------------------------------------
+
+void
+SyncMappedFile(char *addr, int size)
+{
+    int retVal = msync(addr, size, MS_SYNC);
+    ASSERT(retVal >= 0);
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Undo MapFile (after writing any changes back).
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int size)
+{
+    SyncMappedFile(addr, size);
+    int retVal = munmap(addr, size);
+    ASSERT(retVal >= 0);
+}
+
 //----------------------------------------------------------------------
 // Lseek
 // 	Change the location within an open file.  Abort on error.
@@ -238,7 +668,7 @@ Lseek(int fd, int offset, int whence)
 int 
 Tell(int fd)
 {
-#ifdef HOST_i386
+#if defined(HOST_i386) || defined(HOST_x86_64)
     return lseek(fd,0,SEEK_CUR); // 386BSD doesn't have the tell() system call
 #else
     return tell(fd);
@@ -369,7 +799,7 @@ ReadFromSocket(int sockID, char *buffer, int packetSize)
 
     if (retVal != packetSize) {
         perror("in recvfrom");
-#ifdef HOST_ALPHA
+#ifdef HOST_64BIT
         printf("called: %lx, got back %d, %d\n", (long) buffer, retVal, errno);
 #else
         printf("called: %x, got back %d, %d\n", (int) buffer, retVal, errno);
@@ -420,6 +850,195 @@ SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
     return;
 }
 
+//----------------------------------------------------------------------
+// ReadHostMap
+// 	Read the file saying where each Nachos machine is, for the network
+//	to use UDP between host machines instead of UNIX sockets, which
+//	only reach other Nachos on this one.  Each line of the file gives
+//	a machine's network address, then the IP address and UDP port of
+//	the Nachos playing it:
+//
+//		0 10.0.0.1 9000
+//		1 10.0.0.2 9000
+//
+//	Blank lines, and lines starting with '#', are ignored.
+//
+//	"fileName" -- the host map file
+//----------------------------------------------------------------------
+
+
+#define MaxHosts	64		// largest network address + 1
+
+static struct sockaddr_in hostAddr[MaxHosts];	// where each machine is
+static bool hostKnown[MaxHosts];
+static bool haveHostMap = FALSE;
+
+void
+ReadHostMap(char *fileName)
+{
+    FILE *file = fopen(fileName, "r");
+    char line[128], ip[64];
+    int addr, port;
+
+    if (file == NULL) {
+	perror(fileName);
+	ASSERT(FALSE);
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+	if (sscanf(line, " %c", ip) != 1 || ip[0] == '#')
+	    continue;			// blank, or a comment
+	if (sscanf(line, "%d %63s %d", &addr, ip, &port) != 3) {
+	    fprintf(stderr, "%s: bad line: %s", fileName, line);
+	    ASSERT(FALSE);
+	}
+	ASSERT((addr >= 0) && (addr < MaxHosts) && (port > 0) 
+		&& (port < 65536));
+	bzero((char *) &hostAddr[addr], sizeof(struct sockaddr_in));
+	hostAddr[addr].sin_family = AF_INET;
+	hostAddr[addr].sin_port = htons(port);
+	if (inet_aton(ip, &hostAddr[addr].sin_addr) == 0) {
+	    fprintf(stderr, "%s: bad IP address %s\n", fileName, ip);
+	    ASSERT(FALSE);
+	}
+	hostKnown[addr] = TRUE;
+    }
+    fclose(file);
+    haveHostMap = TRUE;
+}
+
+//----------------------------------------------------------------------
+// UsingHostMap
+// 	Return TRUE if a host map has been read, so that the network
+//	should use UDP.
+//----------------------------------------------------------------------
+
+
+bool
+UsingHostMap()
+{
+    return haveHostMap;
+}
+
+//----------------------------------------------------------------------
+// OpenHostSocket
+// 	Open a UDP port where other Nachos can send messages to this one,
+//	on the port the host map gives for our network address.
+//
+//	"addr" -- this machine's network address
+//----------------------------------------------------------------------
+
+
+int
+OpenHostSocket(int addr)
+{
+    struct sockaddr_in us;
+    int sockID, retVal;
+
+    ASSERT(haveHostMap && (addr >= 0) && (addr < MaxHosts) 
+		&& hostKnown[addr]);
+    sockID = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT(sockID >= 0);
+
+    bzero((char *) &us, sizeof(us));
+    us.sin_family = AF_INET;
+    us.sin_addr.s_addr = htonl(INADDR_ANY);	// whichever interface the
+    us.sin_port = hostAddr[addr].sin_port;	// map's address is on
+    retVal = bind(sockID, (struct sockaddr *) &us, sizeof(us));
+    if (retVal < 0) {
+	perror("bind");
+	ASSERT(FALSE);
+    }
+    DEBUG('n', "Listening on UDP port %d\n", ntohs(us.sin_port));
+    return sockID;
+}
+
+//----------------------------------------------------------------------
+// SendToHosts
+// 	Transmit "count" fixed size packets, "buffers[i]" going to the
+//	Nachos playing machine "addrs[i]", in as few system calls as
+//	possible.  As with SendToSocket, if the host is out of buffers
+//	for them we wait a little, and try again.
+//----------------------------------------------------------------------
+
+
+void
+SendToHosts(int sockID, char **buffers, int *addrs, int count, int packetSize)
+{
+    struct mmsghdr *msgs = new struct mmsghdr[count];
+    struct iovec *pieces = new struct iovec[count];
+    int sent = 0, retVal;
+
+    bzero((char *) msgs, count * sizeof(struct mmsghdr));
+    for (int i = 0; i < count; i++) {
+	ASSERT((addrs[i] >= 0) && (addrs[i] < MaxHosts) && hostKnown[addrs[i]]);
+	pieces[i].iov_base = buffers[i];
+	pieces[i].iov_len = packetSize;
+	msgs[i].msg_hdr.msg_name = &hostAddr[addrs[i]];
+	msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	msgs[i].msg_hdr.msg_iov = &pieces[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (sent < count) {
+	retVal = sendmmsg(sockID, &msgs[sent], count - sent, 0);
+	if (retVal > 0)
+	    sent += retVal;
+	else if (errno == ENOBUFS || errno == EAGAIN)
+	    sleep(1);		// this gives the receiver a chance to read
+	else {
+	    perror("socket write failed:");
+	    ASSERT(FALSE);
+	}
+    }
+    delete [] pieces;
+    delete [] msgs;
+}
+
+//----------------------------------------------------------------------
+// ReadFromHosts
+// 	Read as many fixed size packets as are waiting on the UDP port,
+//	up to "count" of them, into "buffers", in one system call; return
+//	how many were read (0 if none were waiting).  Abort on error.
+//----------------------------------------------------------------------
+
+
+int
+ReadFromHosts(int sockID, char **buffers, int count, int packetSize)
+{
+    struct mmsghdr *msgs = new struct mmsghdr[count];
+    struct iovec *pieces = new struct iovec[count];
+    int retVal, flags = MSG_DONTWAIT, logged;
+
+    questionCount++;
+    if (ReplayAnswer('h', &logged)) {	// wait for just as many as were
+	ASSERT(logged <= count);	// read when recording
+	count = logged;
+	flags = 0;
+    }
+    bzero((char *) msgs, count * sizeof(struct mmsghdr));
+    for (int i = 0; i < count; i++) {
+	pieces[i].iov_base = buffers[i];
+	pieces[i].iov_len = packetSize;
+	msgs[i].msg_hdr.msg_iov = &pieces[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    if (count == 0)
+	retVal = 0;
+    else
+	retVal = recvmmsg(sockID, msgs, count, flags, NULL);
+    if (retVal < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	retVal = 0;			// nothing waiting
+    else if (retVal < 0) {
+	perror("in recvmmsg");
+	ASSERT(FALSE);
+    }
+    for (int i = 0; i < retVal; i++)
+	ASSERT((int) msgs[i].msg_len == packetSize);
+    RecordAnswer('h', retVal);
+    delete [] pieces;
+    delete [] msgs;
+    return retVal;
+}
+
 
 //----------------------------------------------------------------------
 // CallOnUserAbort
@@ -430,7 +1049,7 @@ SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
 void 
 CallOnUserAbort(VoidNoArgFunctionPtr func)
 {
-#ifdef HOST_ALPHA
+#ifdef HOST_64BIT
     (void)signal(SIGINT, (void (*)(int)) func);
 #else
     (void)signal(SIGINT, (VoidFunctionPtr) func);
@@ -472,6 +1091,42 @@ Exit(int exitCode)
     exit(exitCode);
 }
 
+//----------------------------------------------------------------------
+// HostCycles
+// 	Return the host CPU's cycle counter (on an x86, the time stamp
+//	counter), for measuring how long the simulator takes to do
+//	things.  On other hosts we don't know how, and just return 0.
+//----------------------------------------------------------------------
+
+unsigned long long
+HostCycles()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int low, high;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (low), "=d" (high));
+    return ((unsigned long long) high << 32) | low;
+#else
+    return 0;
+#endif
+}
+
+//----------------------------------------------------------------------
+// HostNanoseconds
+// 	Return the host's wall-clock time, in nanoseconds, for timing
+//	benchmarks.  It is only as precise as gettimeofday: to the
+//	microsecond.
+//----------------------------------------------------------------------
+
+unsigned long long
+HostNanoseconds()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((unsigned long long) tv.tv_sec * 1000000 + tv.tv_usec) * 1000;
+}
+
 //----------------------------------------------------------------------
 // RandomInit
 // 	Initialize the pseudo-random number generator.  We use the
@@ -486,13 +1141,21 @@ RandomInit(unsigned seed)
 
 //----------------------------------------------------------------------
 // Random
-// 	Return a pseudo-random number.
+// 	Return a pseudo-random number (or, when replaying, the one the
+//	recorded run got).
 //----------------------------------------------------------------------
 
 int 
 Random()
 {
-    return rand();
+    int value;
+
+    questionCount++;
+    if (ReplayAnswer('r', &value))
+	return value;
+    value = rand();
+    RecordAnswer('r', value);
+    return value;
 }
 
 //----------------------------------------------------------------------
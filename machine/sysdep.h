@@ -17,6 +17,15 @@
 // If no characters in the file, return without waiting.
 extern bool PollFile(int fd);
 
+// Host I/O multiplexing, so that the console and the network needn't
+// each poll for input: call "handler" (once) when "fd" has input.
+// The watched files are checked all at once, now and then while the
+// CPU is busy, and whenever it is idle.
+extern void WatchFile(int fd, VoidFunctionPtr handler, _int arg);
+extern void UnwatchFile(int fd);
+extern void CheckWatchedFiles();
+extern bool WaitForWatchedFiles(bool forever);
+
 // File operations: open/read/write/lseek/close, and check for error
 // For simulating the disk and the console devices.
 extern int OpenForWrite(char *name);
@@ -24,7 +33,16 @@ extern int OpenForReadWrite(char *name, bool crashOnError);
 extern void Read(int fd, char *buffer, int nBytes);
 extern int ReadPartial(int fd, char *buffer, int nBytes);
 extern void WriteFile(int fd, char *buffer, int nBytes);
+extern void ReadVector(int fd, char **buffers, int count, int size,
+		       int offset);
+extern void WriteVector(int fd, char **buffers, int count, int size,
+			int offset);
 extern void Lseek(int fd, int offset, int whence);
+extern char *MapFile(int fd, int size);
+extern void SyncMappedFile(char *addr, int size);
+extern void UnmapFile(char *addr, int size);
+extern char *AllocExecutable(int size);
+extern void FreeExecutable(char *addr, int size);
 extern int Tell(int fd);
 extern void Close(int fd);
 //extern bool Unlink(char *name);
@@ -39,6 +57,16 @@ extern bool PollSocket(int sockID);
 extern void ReadFromSocket(int sockID, char *buffer, int packetSize);
 extern void SendToSocket(int sockID, char *buffer, int packetSize,char *toName);
 
+// The same over UDP, between Nachos on different host machines, each
+// at the IP address and port given for it in a host map file
+extern void ReadHostMap(char *fileName);
+extern bool UsingHostMap();
+extern int OpenHostSocket(int addr);
+extern void SendToHosts(int sockID, char **buffers, int *addrs, int count,
+			int packetSize);
+extern int ReadFromHosts(int sockID, char **buffers, int count,
+			 int packetSize);
+
 // Process control: abort, exit, and sleep
 extern void Abort();
 extern void Exit(int exitCode);
@@ -47,10 +75,23 @@ extern void Delay(int seconds);
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
+// The host's cycle counter, for timing the simulator (0 if there is
+// none we know how to read)
+extern unsigned long long HostCycles();
+
+// The host's wall-clock time, in nanoseconds (from some arbitrary start;
+// only differences are meaningful)
+extern unsigned long long HostNanoseconds();
+
 // Initialize the pseudo random number generator
 extern void RandomInit(unsigned seed);
 extern int Random();
 
+// Log what the host tells us -- input arriving, random numbers -- so
+// that a run can be repeated exactly; or repeat one, from its log
+extern void RecordHostEvents(char *name);
+extern void ReplayHostEvents(char *name);
+
 // Allocate, de-allocate an array, such that de-referencing
 // just beyond either end of the array will cause an error
 extern char *AllocBoundedArray(int size);
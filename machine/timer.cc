@@ -5,7 +5,8 @@
 //      This means it can be used for implementing time-slicing.
 //
 //      We emulate a hardware timer by scheduling an interrupt to occur
-//      every time stats->totalTicks has increased by TimerTicks.
+//      every time stats->totalTicks has increased by timerTicks (by
+//	default, TimerTicks).
 //
 //      In order to introduce some randomness into time-slicing, if "doRandom"
 //      is set, then the interrupt is comes after a random number of ticks.
@@ -79,7 +80,7 @@ int
 Timer::TimeOfNextInterrupt() 
 {
     if (randomize)
-	return 1 + (Random() % (TimerTicks * 2));
+	return 1 + (Random() % (timerTicks * 2));
     else
-	return TimerTicks; 
+	return timerTicks; 
 }
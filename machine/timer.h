@@ -6,7 +6,7 @@
 //	having a thread go to sleep for a specific period of time. 
 //
 //	We emulate a hardware timer by scheduling an interrupt to occur
-//	every time stats->totalTicks has increased by TimerTicks.
+//	every time stats->totalTicks has increased by timerTicks.
 //
 //	In order to introduce some randomness into time-slicing, if "doRandom"
 //	is set, then the interrupt comes after a random number of ticks.
@@ -0,0 +1,185 @@
+// trace.cc
+//	Routines to record a timeline of machine and kernel events in a
+//	ring in memory, and to write it out as a Chrome trace.  See
+//	trace.h.
+//
+//	Recording an event is just filling in the next slot of the ring;
+//	all the formatting is put off until TraceDump.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "trace.h"
+#include "system.h"
+
+#define InterruptTrack	1000	// the tracks (Chrome "threads") of the
+#define DiskTrack	1001	// events besides context switches, which
+#define ExceptionTrack	1002	// go on the track of their CPU
+#define MaxTracedCPUs	64
+
+bool tracing = FALSE;
+
+static char *traceFile = NULL;		// where TraceDump writes the events
+static TraceEvent *traceRing = NULL;	// the events
+static int traceNext = 0;		// the slot for the next one
+static int traceCount = 0;		// how many slots are filled
+
+//----------------------------------------------------------------------
+// TraceInit
+// 	Start recording events, to be written to "fileName" by TraceDump.
+//----------------------------------------------------------------------
+
+void
+TraceInit(char *fileName)
+{
+    traceFile = fileName;
+    traceRing = new TraceEvent[TraceRingSize];
+    traceNext = traceCount = 0;
+    tracing = TRUE;
+}
+
+//----------------------------------------------------------------------
+// TraceRecord
+// 	If we are tracing, put an event in the ring, stamped with the
+//	current simulated time, in place of the oldest one if the ring
+//	is full.
+//
+//	"kind" -- what sort of event it is
+//	"name" -- the thread, interrupt type, etc.
+//	"arg" -- a number to go with it (see TraceEvent)
+//	"duration" -- how many ticks it takes, from now
+//----------------------------------------------------------------------
+
+void
+TraceRecord(TraceKind kind, const char *name, int arg, int duration)
+{
+    TraceEvent *e;
+
+    if (!tracing)
+	return;
+    e = &traceRing[traceNext];
+    traceNext = (traceNext + 1) % TraceRingSize;
+    if (traceCount < TraceRingSize)
+	traceCount++;
+
+    e->when = stats->totalTicks;
+    e->duration = duration;
+    e->arg = arg;
+    e->kind = kind;
+    strncpy(e->name, name, TraceNameSize - 1);
+    e->name[TraceNameSize - 1] = '\0';
+}
+
+//----------------------------------------------------------------------
+// TraceWriteEvent
+// 	Write out the start of a Chrome trace event, up to its arguments:
+//	its name (escaped as a JSON string), category, phase, time stamp,
+//	and track.  A "complete" event ("X") also has a duration.
+//----------------------------------------------------------------------
+
+static void
+TraceWriteEvent(FILE *f, TraceEvent *e, const char *cat, const char *ph,
+		int track)
+{
+    fprintf(f, "{\"name\":\"");
+    for (char *s = e->name; *s != '\0'; s++) {
+	if ((*s == '"') || (*s == '\\'))
+	    fputc('\\', f);
+	if ((unsigned char) *s >= ' ')
+	    fputc(*s, f);
+    }
+    fprintf(f, "\",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%d,", cat, ph,
+	    e->when);
+    if (!strcmp(ph, "X"))
+	fprintf(f, "\"dur\":%d,", e->duration);
+    fprintf(f, "\"pid\":0,\"tid\":%d", track);
+}
+
+//----------------------------------------------------------------------
+// TraceDump
+// 	If we have been tracing, write the events in the ring, oldest
+//	first, to the trace file, in the Chrome trace event format: a
+//	JSON object, whose "traceEvents" are the events, with records
+//	naming the tracks they go on.
+//
+//	The thread switched to runs until the next context switch (or
+//	until now, for the last), so we work out how long that is before
+//	writing anything.
+//----------------------------------------------------------------------
+
+void
+TraceDump()
+{
+    bool cpuNamed[MaxTracedCPUs];
+    int oldest = (traceNext - traceCount + TraceRingSize) % TraceRingSize;
+    int switchEnd = stats->totalTicks;
+    FILE *f;
+    int i;
+
+    if (!tracing)
+	return;
+    for (i = traceCount - 1; i >= 0; i--) {
+	TraceEvent *e = &traceRing[(oldest + i) % TraceRingSize];
+
+	if (e->kind == TraceSwitch) {
+	    e->duration = switchEnd - e->when;
+	    switchEnd = e->when;
+	}
+    }
+
+    f = fopen(traceFile, "w");
+    if (f == NULL) {
+	printf("Unable to write trace file %s\n", traceFile);
+	return;
+    }
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+	    "\"args\":{\"name\":\"interrupts\"}},\n", InterruptTrack);
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+	    "\"args\":{\"name\":\"disk\"}},\n", DiskTrack);
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+	    "\"args\":{\"name\":\"exceptions\"}}", ExceptionTrack);
+    for (i = 0; i < MaxTracedCPUs; i++)
+	cpuNamed[i] = FALSE;
+
+    for (i = 0; i < traceCount; i++) {
+	TraceEvent *e = &traceRing[(oldest + i) % TraceRingSize];
+
+	fprintf(f, ",\n");
+	switch (e->kind) {
+	  case TraceSwitch:
+	    if ((e->arg >= 0) && (e->arg < MaxTracedCPUs) && !cpuNamed[e->arg]) {
+		fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+			"\"tid\":%d,\"args\":{\"name\":\"CPU %d\"}},\n",
+			e->arg, e->arg);
+		cpuNamed[e->arg] = TRUE;
+	    }
+	    TraceWriteEvent(f, e, "switch", "X", e->arg);
+	    fprintf(f, "}");
+	    break;
+	  case TraceInterrupt:
+	    TraceWriteEvent(f, e, "interrupt", "X", InterruptTrack);
+	    fprintf(f, ",\"args\":{\"late\":%d}}", e->arg);
+	    break;
+	  case TraceDisk:
+	    TraceWriteEvent(f, e, "disk", "X", DiskTrack);
+	    fprintf(f, ",\"args\":{\"sector\":%d}}", e->arg);
+	    break;
+	  case TraceSyscall:
+	    TraceWriteEvent(f, e, "syscall", "i", ExceptionTrack);
+	    fprintf(f, ",\"s\":\"t\",\"args\":{\"code\":%d}}", e->arg);
+	    break;
+	  case TraceFault:
+	    TraceWriteEvent(f, e, "fault", "i", ExceptionTrack);
+	    fprintf(f, ",\"s\":\"t\",\"args\":{\"vaddr\":%d}}", e->arg);
+	    break;
+	}
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    printf("Trace: %d events written to %s\n", traceCount, traceFile);
+}
@@ -0,0 +1,60 @@
+// trace.h
+//	Data structures for recording a timeline of what the machine and
+//	the kernel do -- context switches, interrupts, disk requests,
+//	system calls and other exceptions (page faults) -- cheaply enough
+//	to leave on for a whole run, unlike DEBUG messages.
+//
+//	Events are kept in memory, in a fixed-size ring of binary records
+//	stamped with the simulated time; once the ring is full, each new
+//	event takes the place of the oldest.  At Halt, the ring is written
+//	out in the Chrome trace event format (JSON), which chrome://tracing
+//	and Perfetto can show as a timeline.  A tick is shown as a
+//	microsecond.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define TraceRingSize	32768	// events kept (the most recent ones)
+#define TraceNameSize	16	// characters of each event's name kept
+
+// The kinds of events recorded.  Interrupts, disk requests, and
+// exceptions (system calls and faults together) each have a track of
+// their own; a context switch starts a slice, named for the thread
+// switched to, on the track of its CPU.
+
+enum TraceKind { TraceSwitch, TraceInterrupt, TraceDisk, TraceSyscall,
+		 TraceFault };
+
+// The following class defines one event in the ring.
+
+class TraceEvent {
+  public:
+    int when;			// the simulated time it happened
+    int duration;		// how long it took, in ticks (a switch
+				// lasts until the next one)
+    int arg;			// TraceSwitch: the CPU;
+				// TraceInterrupt: ticks late;
+				// TraceDisk: the first sector;
+				// TraceSyscall: the system call code;
+				// TraceFault: the bad virtual address
+    TraceKind kind;
+    char name[TraceNameSize];	// the thread, interrupt, ... (truncated)
+};
+
+extern bool tracing;		// are events being recorded?
+
+extern void TraceInit(char *fileName);	// Start recording, for "fileName"
+extern void TraceRecord(TraceKind kind, const char *name, int arg,
+			int duration);	// Record an event, now (if tracing)
+extern void TraceDump();		// Write out the events recorded
+
+#endif // TRACE_H
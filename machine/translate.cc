@@ -7,7 +7,10 @@
 // Two types of translation are supported here.
 //
 //	Linear page table -- the virtual page # is used as an index
-//	into the table, to find the physical page #.
+//	into the table, to find the physical page #.  Or, for a large
+//	sparse address space, a two-level page table: the high bits of
+//	the virtual page # pick a leaf from a directory, and the low bits
+//	the entry in the leaf.  Leaves that map nothing needn't exist.
 //
 //	Translation lookaside buffer -- associative lookup in the table
 //	to find an entry with the same virtual page #.  If found,
@@ -34,42 +37,8 @@
 #include "addrspace.h"
 #include "system.h"
 
-// Routines for converting Words and Short Words to and from the
-// simulated machine's format of little endian.  These end up
-// being NOPs when the host machine is also little endian (DEC and Intel).
-
-unsigned int
-WordToHost(unsigned int word) {
-#ifdef HOST_IS_BIG_ENDIAN
-	 register unsigned long result;
-	 result = (word >> 24) & 0x000000ff;
-	 result |= (word >> 8) & 0x0000ff00;
-	 result |= (word << 8) & 0x00ff0000;
-	 result |= (word << 24) & 0xff000000;
-	 return result;
-#else 
-	 return word;
-#endif /* HOST_IS_BIG_ENDIAN */
-}
-
-unsigned short
-ShortToHost(unsigned short shortword) {
-#ifdef HOST_IS_BIG_ENDIAN
-	 register unsigned short result;
-	 result = (shortword << 8) & 0xff00;
-	 result |= (shortword >> 8) & 0x00ff;
-	 return result;
-#else 
-	 return shortword;
-#endif /* HOST_IS_BIG_ENDIAN */
-}
-
-unsigned int
-WordToMachine(unsigned int word) { return WordToHost(word); }
-
-unsigned short
-ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
-
+// The routines for converting Words and Short Words to and from the
+// simulated machine's format of little endian are inline, in machine.h.
 
 //----------------------------------------------------------------------
 // Machine::ReadMem
@@ -95,22 +64,24 @@ Machine::ReadMem(int addr, int size, int *value)
     
     exception = Translate(addr, &physicalAddress, size, FALSE);
     if (exception != NoException) {
-	machine->RaiseException(exception, addr);
+	RaiseException(exception, addr);
 	return FALSE;
     }
+    if (timedMemory)
+	ChargeAccess(FALSE, physicalAddress);
     switch (size) {
       case 1:
-	data = machine->mainMemory[physicalAddress];
+	data = mainMemory[physicalAddress];
 	*value = data;
 	break;
 	
       case 2:
-	data = *(unsigned short *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned short *) &mainMemory[physicalAddress];
 	*value = ShortToHost(data);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned int *) &mainMemory[physicalAddress];
 	*value = WordToHost(data);
 	break;
 
@@ -144,30 +115,273 @@ Machine::WriteMem(int addr, int size, int value)
 
     exception = Translate(addr, &physicalAddress, size, TRUE);
     if (exception != NoException) {
-	machine->RaiseException(exception, addr);
+	RaiseException(exception, addr);
 	return FALSE;
     }
+    if (timedMemory)
+	ChargeAccess(FALSE, physicalAddress);
     switch (size) {
       case 1:
-	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
 	break;
 
       case 2:
-	*(unsigned short *) &machine->mainMemory[physicalAddress]
+	*(unsigned short *) &mainMemory[physicalAddress]
 		= ShortToMachine((unsigned short) (value & 0xffff));
 	break;
       
       case 4:
-	*(unsigned int *) &machine->mainMemory[physicalAddress]
+	*(unsigned int *) &mainMemory[physicalAddress]
 		= WordToMachine((unsigned int) value);
 	break;
 	
       default: ASSERT(FALSE);
     }
+    if (decodeValid != NULL)		// in case this word was code that
+	decodeValid[physicalAddress / 4] = FALSE;   // has been decoded
+    if ((blockTable != NULL) && (blocksInFrame[physicalAddress / PageSize] > 0))
+	FlushBlocks(physicalAddress / PageSize);
     
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::TranslateForCopy
+//      Translate the user address "virtAddr" for one of the bulk copy
+//	routines below.  If the translation fails, we trap to the kernel
+//	just as a user load or store would -- so that a TLB refill or
+//	demand-paging handler can bring the page in, or a copy-on-write
+//	handler can give us a private copy of a read-only page -- and then
+//	try again; a write may need both.  We are already in the kernel
+//	here, so we put the machine status back the way it was afterwards.
+//
+// Returns:
+//	The physical address, or -1 if "virtAddr" is not a valid address.
+//
+//	"virtAddr" -- the user address to translate
+// 	"writing" -- if TRUE, the page is about to be written
+//----------------------------------------------------------------------
+
+int
+Machine::TranslateForCopy(int virtAddr, bool writing)
+{
+    int physAddr, traps;
+    ExceptionType exception;
+
+    exception = Translate(virtAddr, &physAddr, 1, writing);
+    for (traps = 0; (traps < 2) && ((exception == PageFaultException)
+		|| (exception == ReadOnlyException)); traps++) {
+	MachineStatus oldStatus = interrupt->getStatus();
+
+	RaiseException(exception, virtAddr);
+	interrupt->setStatus(oldStatus);
+	exception = Translate(virtAddr, &physAddr, 1, writing);
+    }
+    if (exception != NoException) {
+	DEBUG('a', "Bad user address 0x%x in copy, exception %d\n",
+	      virtAddr, exception);
+	return -1;
+    }
+    return physAddr;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyIn
+//      Copy "size" bytes of user virtual memory, starting at "virtAddr",
+//	into the kernel buffer "buffer".  Rather than going through
+//	ReadMem a byte at a time, we translate once per page and copy
+//	the whole piece of the request that lies within it.
+//
+//   	Returns FALSE if part of the range could not be translated, in
+//	which case the buffer holds whatever was copied before that.
+//
+//	"virtAddr" -- the user address to copy from
+//	"buffer" -- the kernel buffer to copy to
+//	"size" -- the number of bytes to copy
+//----------------------------------------------------------------------
+
+bool
+Machine::CopyIn(int virtAddr, char *buffer, int size)
+{
+    DEBUG('a', "Copying in %d bytes from VA 0x%x\n", size, virtAddr);
+    while (size > 0) {
+	int physAddr = TranslateForCopy(virtAddr, FALSE);
+	int chunk = min(size, PageSize - (int)((unsigned) virtAddr % PageSize));
+
+	if (physAddr < 0)
+	    return FALSE;
+	bcopy(&mainMemory[physAddr], buffer, chunk);
+	virtAddr += chunk;
+	buffer += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyOut
+//      Copy "size" bytes from the kernel buffer "buffer" out to user
+//	virtual memory, starting at "virtAddr", a page at a time.  Any
+//	cached decodings of the words written are thrown away, just as
+//	for WriteMem.
+//
+//   	Returns FALSE if part of the range could not be translated (or
+//	was read-only), in which case only the part before it was written.
+//
+//	"virtAddr" -- the user address to copy to
+//	"buffer" -- the kernel buffer to copy from
+//	"size" -- the number of bytes to copy
+//----------------------------------------------------------------------
+
+bool
+Machine::CopyOut(int virtAddr, char *buffer, int size)
+{
+    DEBUG('a', "Copying out %d bytes to VA 0x%x\n", size, virtAddr);
+    while (size > 0) {
+	int physAddr = TranslateForCopy(virtAddr, TRUE);
+	int chunk = min(size, PageSize - (int)((unsigned) virtAddr % PageSize));
+
+	if (physAddr < 0)
+	    return FALSE;
+	bcopy(buffer, &mainMemory[physAddr], chunk);
+	InvalidateDecodeCache(physAddr, chunk);
+	virtAddr += chunk;
+	buffer += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyInString
+//      Copy a null-terminated string from user virtual memory, starting
+//	at "virtAddr", into the kernel buffer "buffer", a page at a time.
+//	The buffer is always null-terminated; a string that does not fit
+//	in "maxSize" bytes (including the null) is an error.
+//
+// Returns:
+//	The length of the string, or -1 if it was too long or part of it
+//	could not be translated.
+//
+//	"virtAddr" -- the user address of the string
+//	"buffer" -- the kernel buffer to copy to
+//	"maxSize" -- the size of the buffer
+//----------------------------------------------------------------------
+
+int
+Machine::CopyInString(int virtAddr, char *buffer, int maxSize)
+{
+    int start = virtAddr;
+    int length = 0;
+
+    ASSERT(maxSize > 0);
+    while (length < maxSize) {
+	int physAddr = TranslateForCopy(virtAddr, FALSE);
+	int chunk = min(maxSize - length,
+			PageSize - (int)((unsigned) virtAddr % PageSize));
+
+	if (physAddr < 0)
+	    break;
+	for (int i = 0; i < chunk; i++) {
+	    buffer[length] = mainMemory[physAddr + i];
+	    if (buffer[length] == '\0') {
+		DEBUG('a', "Copied in string \"%s\" from VA 0x%x\n", buffer,
+		      start);
+		return length;
+	    }
+	    length++;
+	}
+	virtAddr += chunk;
+    }
+    buffer[min(length, maxSize - 1)] = '\0';
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyUser
+//      Copy "size" bytes of user virtual memory, from "fromAddr" to
+//	"toAddr", straight from one page frame to the other: each time
+//	round, we copy the piece that lies within one page of both.
+//
+//	Bringing the destination page in (or giving us a private copy of
+//	it) may push the source page out, so once both are translated we
+//	check the source again; if it is gone, that piece goes through a
+//	kernel buffer instead, by CopyIn and CopyOut, which only need one
+//	page at a time.
+//
+//   	Returns FALSE if part of either range could not be translated (or
+//	the destination was read-only), in which case only the part
+//	before it was copied.  The ranges must not overlap.
+//
+//	"toAddr" -- the user address to copy to
+//	"fromAddr" -- the user address to copy from
+//	"size" -- the number of bytes to copy
+//----------------------------------------------------------------------
+
+bool
+Machine::CopyUser(int toAddr, int fromAddr, int size)
+{
+    DEBUG('a', "Copying %d bytes from VA 0x%x to VA 0x%x\n", size, fromAddr,
+	  toAddr);
+    while (size > 0) {
+	int fromPhys = TranslateForCopy(fromAddr, FALSE);
+	int toPhys = TranslateForCopy(toAddr, TRUE);
+	int chunk = min(size,
+		min(PageSize - (int)((unsigned) fromAddr % PageSize),
+		    PageSize - (int)((unsigned) toAddr % PageSize)));
+	int checkPhys;
+
+	if (fromPhys < 0 || toPhys < 0)
+	    return FALSE;
+	if (Translate(fromAddr, &checkPhys, 1, FALSE) == NoException
+		&& checkPhys == fromPhys) {
+	    memcpy(&mainMemory[toPhys], &mainMemory[fromPhys], chunk);
+	    InvalidateDecodeCache(toPhys, chunk);
+	} else {
+	    char buffer[PageSize];
+
+	    if (!CopyIn(fromAddr, buffer, chunk)
+		    || !CopyOut(toAddr, buffer, chunk))
+		return FALSE;
+	}
+	fromAddr += chunk;
+	toAddr += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::FillUser
+//      Set "size" bytes of user virtual memory, starting at "virtAddr",
+//	to "value", a page at a time, as CopyOut would write them.
+//
+//   	Returns FALSE if part of the range could not be translated (or
+//	was read-only), in which case only the part before it was set.
+//
+//	"virtAddr" -- the user address to start at
+//	"value" -- the byte to set them to
+//	"size" -- the number of bytes to set
+//----------------------------------------------------------------------
+
+bool
+Machine::FillUser(int virtAddr, int value, int size)
+{
+    DEBUG('a', "Filling %d bytes at VA 0x%x\n", size, virtAddr);
+    while (size > 0) {
+	int physAddr = TranslateForCopy(virtAddr, TRUE);
+	int chunk = min(size, PageSize - (int)((unsigned) virtAddr % PageSize));
+
+	if (physAddr < 0)
+	    return FALSE;
+	memset(&mainMemory[physAddr], value, chunk);
+	InvalidateDecodeCache(physAddr, chunk);
+	virtAddr += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -177,19 +391,29 @@ Machine::WriteMem(int addr, int size, int value)
 //	address in "physAddr".  If there was an error, returns the type
 //	of the exception.
 //
+//	A translation that succeeds is kept in the micro-TLB, for the
+//	kind of access it was; if the next access of that kind is to the
+//	same page, it needs no walk of the page table or search of the
+//	TLB.  Only translations that passed every check get in, and the
+//	kernel flushes them when it changes any (see FlushMicroTLB).
+//
 //	"virtAddr" -- the virtual address to translate
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
 // 	"writing" -- if TRUE, check the "read-only" bit in the TLB
+//	"fetching" -- if TRUE, this is an instruction fetch
 //----------------------------------------------------------------------
 
 ExceptionType
-Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
+Machine::Translate(int virtAddr, int* physAddr, int size, bool writing,
+		   bool fetching)
 {
     int i;
     unsigned int vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
+    AccessType type = writing ? StoreAccess
+			      : (fetching ? FetchAccess : LoadAccess);
 
     DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
@@ -200,37 +424,78 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     }
     
     // we must have either a TLB or a page table, but not both!
-    ASSERT(tlb == NULL || pageTable == NULL);	
-    ASSERT(tlb != NULL || pageTable != NULL);	
+    ASSERT(tlb == NULL || (pageTable == NULL && pageDirectory == NULL));
+    ASSERT(tlb != NULL || pageTable != NULL || pageDirectory != NULL);
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
+
+    if (microVPN[type] == vpn) {	// fast path: same page as last time
+	entry = microEntry[type];
+	if (tlb != NULL)
+	    stats->thisCPU->numTLBHits++;
+	entry->use = TRUE;
+	if (writing)
+	    entry->dirty = TRUE;
+	*physAddr = microFrame[type] + offset;
+	DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+	return NoException;
+    }
     
     if (tlb == NULL) {		// => page table => vpn is index into table
 	if (vpn >= pageTableSize) {
 	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 			virtAddr, pageTableSize);
 	    return AddressErrorException;
-	} else if (!pageTable[vpn].valid) {
-	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
-			virtAddr, pageTableSize);
+	}
+	if (pageDirectory != NULL) {	// two-level: walk the directory
+	    TranslationEntry *leaf = pageDirectory[vpn / PageLeafSize];
+
+	    entry = (leaf == NULL) ? NULL : &leaf[vpn % PageLeafSize];
+	} else
+	    entry = &pageTable[vpn];
+	if ((entry == NULL) || !entry->valid) {
+	    DEBUG('a', "virtual page # %d not valid in the page table!\n", 
+			vpn);
 	    return PageFaultException;
 	}
-	entry = &pageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && ((unsigned int)tlb[i].virtualPage == vpn)) {
-		entry = &tlb[i];			// FOUND!
+	int first = (vpn % tlbSets) * tlbWays;
+	TranslationEntry *set = &tlb[first];
+
+	for (entry = NULL, i = 0; i < tlbWays; i++)
+	    if (set[i].valid && !set[i].superPage
+		    && ((unsigned int)set[i].virtualPage == vpn)
+		    && (tlbASID[first + i] == asid)) {
+		entry = &set[i];			// FOUND!
 		break;
 	    }
+	if ((entry == NULL) && superPages) {	// then its superpage's set
+	    unsigned int base = vpn & ~(SuperPageSize - 1);
+
+	    first = (vpn / SuperPageSize % tlbSets) * tlbWays;
+	    set = &tlb[first];
+	    for (i = 0; i < tlbWays; i++)
+		if (set[i].valid && set[i].superPage
+			&& ((unsigned int)set[i].virtualPage == base)
+			&& (tlbASID[first + i] == asid)) {
+		    entry = &set[i];
+		    stats->thisCPU->numSuperPageTLBHits++;
+		    break;
+		}
+	}
 	if (entry == NULL) {				// not found
+	    stats->thisCPU->numTLBMisses++;
+	    CountTLBReach();
     	    DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
 	}
+	stats->thisCPU->numTLBHits++;
+	i = entry - tlb;
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -238,11 +503,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	return ReadOnlyException;
     }
     pageFrame = entry->physicalPage;
+    if (entry->superPage && (tlb != NULL))	// the page within it
+	pageFrame += vpn - entry->virtualPage;
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
-	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
+    if (pageFrame >= (unsigned int) numPhysPages) { 
+	DEBUG('a', "*** frame %d > %d!\n", pageFrame, numPhysPages);
 	return BusErrorException;
     }
     entry->use = TRUE;		// set the use, dirty bits
@@ -251,5 +518,123 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+    microVPN[type] = vpn;
+    microFrame[type] = pageFrame * PageSize;
+    microEntry[type] = entry;
     return NoException;
 }
+
+//----------------------------------------------------------------------
+// Machine::FlushMicroTLB
+// 	Empty the micro-TLB (see Translate).  This happens on every trap
+//	to the kernel, as the trap returns (see RaiseException); the
+//	kernel must call it itself if it changes a translation, or
+//	switches address spaces, at any other time.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushMicroTLB()
+{
+    for (int type = 0; type < NumAccessTypes; type++)
+	microVPN[type] = (unsigned int) -1;
+}
+
+//----------------------------------------------------------------------
+// Machine::TLBVictim
+// 	Return the TLB slot into which the kernel should load a translation
+//	for virtual page "vpn", after a TLB miss.  This is the hardware's
+//	half of a TLB refill: "vpn" can only live in one set, so we hand
+//	back an invalid entry of that set if there is one, and otherwise
+//	replace the ways of the set round-robin.
+//
+//	The kernel is responsible for saving the use and dirty bits of
+//	the entry being replaced, if it is valid, before overwriting it.
+//
+//	"vpn" -- the virtual page that missed in the TLB
+//	"superPage" -- if TRUE, the slot is for the superpage holding it
+//----------------------------------------------------------------------
+
+TranslationEntry *
+Machine::TLBVictim(int vpn, bool superPage)
+{
+    int set = ((unsigned) vpn / (superPage ? SuperPageSize : 1)) % tlbSets;
+    TranslationEntry *entries = &tlb[set * tlbWays];
+    int i;
+
+    ASSERT(tlb != NULL);
+    for (i = 0; i < tlbWays; i++)
+	if (!entries[i].valid)
+	    return &entries[i];
+    i = tlbNextVictim[set];
+    tlbNextVictim[set] = (i + 1) % tlbWays;
+    return &entries[i];
+}
+
+//----------------------------------------------------------------------
+// Machine::CountTLBReach
+// 	At a TLB miss, count how much of the current address space the
+//	TLB maps -- its reach, in pages, which superpages stretch.
+//----------------------------------------------------------------------
+
+void
+Machine::CountTLBReach()
+{
+    int reach = 0;
+
+    for (int i = 0; i < tlbSize; i++)
+	if (tlb[i].valid && (tlbASID[i] == asid))
+	    reach += tlb[i].superPage ? SuperPageSize : 1;
+    stats->thisCPU->tlbReachTotal += reach;
+    stats->thisCPU->maxTLBReach = max(stats->thisCPU->maxTLBReach, reach);
+}
+
+//----------------------------------------------------------------------
+// Machine::SetNUMA
+// 	Turn the NUMA model on: physical memory is split evenly between
+//	"nodes" nodes, in order of frame number, and a user access to a
+//	frame on a node other than the one the running CPU is on costs
+//	"ticks" more.
+//
+//	"nodes" -- how many nodes
+//	"ticks" -- the extra charge for a remote access
+//----------------------------------------------------------------------
+
+void
+Machine::SetNUMA(int nodes, int ticks)
+{
+    ASSERT((nodes >= 1) && (nodes <= numPhysPages));
+    numNodes = nodes;
+    remoteTicks = ticks;
+    if (nodes > 1)
+	timedMemory = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::ChargeAccess
+// 	Charge for a user instruction fetch, load or store, beyond the
+//	UserTick of the instruction itself.  Only called when accesses
+//	are timed.
+//
+//	With the L1 cache model on, a hit costs nothing more, and a miss
+//	the miss penalty (see CacheAccess).  With the NUMA model on, an
+//	access that goes to memory -- every one, or with the caches, each
+//	miss -- costs remoteTicks more if the frame is on another node
+//	from the CPU the current thread is running on.  Like a miss, the
+//	charge goes straight on the clock.
+//
+//	"fetching" -- TRUE for an instruction fetch
+//	"physAddr" -- the address accessed
+//----------------------------------------------------------------------
+
+void
+Machine::ChargeAccess(bool fetching, int physAddr)
+{
+    if ((icache != NULL) && CacheAccess(fetching, physAddr))
+	return;
+    if ((numNodes > 1) && (FrameNode(physAddr / PageSize)
+		!= scheduler->NodeOf(currentThread->getCPU()))) {
+	stats->numRemoteAccesses++;
+	stats->totalTicks += remoteTicks;
+	stats->userTicks += remoteTicks;
+    }
+}
@@ -40,6 +40,22 @@ class TranslationEntry {
 			// page is referenced or modified.
     bool dirty;         // This bit is set by the hardware every time the
 			// page is modified.
+    bool superPage;	// If this bit is set in a TLB entry, it maps the
+			// SuperPageSize pages from "virtualPage" to those
+			// from "physicalPage" (both multiples of it).  In
+			// a page table, the kernel uses it to mark the
+			// pages of a superpage.
 };
 
+// A superpage: an aligned run of pages, mapped to an aligned run of
+// frames, that a single TLB entry can translate.
+
+#define SuperPageSize	8	// pages in a superpage (a power of two)
+
+// A two-level page table (see Machine::pageDirectory) is a directory
+// of pointers to leaves, each an array of the translations of
+// PageLeafSize consecutive virtual pages.
+
+#define PageLeafSize	32	// translations in each leaf
+
 #endif
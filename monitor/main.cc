@@ -8,7 +8,8 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
+// Usage: nachos -d <debugflags> -rs <random seed #> -mesa -batch <n>
+//		-bench <count>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
@@ -18,6 +19,13 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -mesa makes the producer/consumer ring a Mesa monitor, rather
+//	than a Hoare one
+//    -batch makes producers and consumers move up to n messages per
+//	monitor entry
+//    -bench runs the thread system microbenchmarks (cf. synchbench.h),
+//	each thread doing <count> operations, and times <count> messages
+//	through the ring, instead of the producers and consumers
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
@@ -52,10 +60,13 @@
 
 #include "utility.h"
 #include "system.h"
+#include "synchbench.h"
 
 // External functions used by this file
 
-extern void ProdCons(void), Copy(char *unixFile, char *nachosFile);
+extern void ProdCons(bool mesa, int batch);
+extern void RingBench(bool mesa, int batch, int count);
+extern void Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
@@ -85,7 +96,22 @@ main(int argc, char **argv)
     (void) Initialize(argc, argv);
     
 #ifdef THREADS
-    ProdCons();
+    bool mesa = FALSE;
+    int batch = 1;
+    int benchCount = 0;
+
+    for (int i = 1; i < argc; i++)
+	if (!strcmp(argv[i], "-mesa"))
+	    mesa = TRUE;
+	else if (!strcmp(argv[i], "-batch") && (i + 1 < argc))
+	    batch = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-bench") && (i + 1 < argc))
+	    benchCount = atoi(argv[++i]);
+    if (benchCount > 0) {
+	SynchBench(benchCount);
+	RingBench(mesa, batch, benchCount);
+    } else
+	ProdCons(mesa, batch);
 #endif
 
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
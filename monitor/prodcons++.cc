@@ -25,6 +25,7 @@
 
 #include "synch.h"
 #include "ring.h"
+#include "synchbench.h"
 
 #define BUFF_SIZE 2  // the size of the round buffer
 #define N_PROD    2  // the number of producers 
@@ -46,6 +47,7 @@ Semaphore *nempty, *nfull; //two semaphores for empty and full slots
 Semaphore *mutex;          //semaphore for the mutual exclusion
     
 Ring *ring;
+int batchSize;		// messages moved per Put/Get (see ProdCons)
 
 
 
@@ -73,6 +75,27 @@ Producer(_int which)
 //   before and after the call ring->Put(message). See the algorithms in
 //   page 182 of the textbook.
 
+    if (batchSize > 1) {
+      slot *messages = new slot[batchSize];
+
+      for (num = 0; num < N_MESSG; ) {	// a batch at a time
+	int n = min(batchSize, N_MESSG - num);
+	int sent;
+
+	for (int i = 0; i < n; i++) {
+	  messages[i].thread_id = which;
+	  messages[i].value = num + i;
+	}
+	for (sent = 0; sent < n; )
+	  sent += ring->PutBatch(&messages[sent], n - sent);
+	num += n;
+
+	currentThread->Yield();
+      }
+      delete [] messages;
+      return;
+    }
+
     for (num = 0; num < N_MESSG ; num++) {
       // Put the code to prepare the message here.
       // ...
@@ -100,11 +123,13 @@ Consumer(_int which)
     int fd;
     
     slot *message = new slot(0,0);
+    slot *messages = new slot[batchSize];
+    int got;
 
     // to form a output file name for this consumer thread.
     // all the messages received by this consumer will be recorded in 
     // this file.
-    sprintf(fname, "tmp_%d", which);
+    sprintf(fname, "tmp_%ld", (long) which);	// _int may be long
 
     // create a file. Note that this is a UNIX system call.
     if ( (fd = creat(fname, 0600) ) == -1) 
@@ -115,18 +140,26 @@ Consumer(_int which)
     
     for (; ; ) {
 
-      ring->Get(message);
-
-      // form a string to record the message
-      sprintf(str,"producer id --> %d; Message number --> %d;\n", 
-		message->thread_id,
-		message->value);
-      // write this string into the output file of this consumer. 
-      // note that this is another UNIX system call.
-      if ( write(fd, str, strlen(str)) == -1 ) {
+      if (batchSize > 1)
+	got = ring->GetBatch(messages, batchSize);
+      else {
+	ring->Get(message);
+	messages[0] = *message;
+	got = 1;
+      }
+
+      for (int i = 0; i < got; i++) {
+	// form a string to record the message
+	sprintf(str,"producer id --> %d; Message number --> %d;\n", 
+		messages[i].thread_id,
+		messages[i].value);
+	// write this string into the output file of this consumer. 
+	// note that this is another UNIX system call.
+	if ( write(fd, str, strlen(str)) == -1 ) {
 	    perror("write: write failed");
 	    exit(1);
 	  }
+      }
       currentThread->Yield();
     }
 }
@@ -137,12 +170,20 @@ Consumer(_int which)
 // ProdCons
 // 	Set up semaphores for shared round buffer and 
 //	create and fork producers and consumer threads
+//
+//	"mesa" -- if TRUE, the ring is a Mesa monitor rather than a Hoare
+//		one (see ring.h)
+//	"batch" -- how many messages each producer and consumer moves
+//		per call (with more than 1, PutBatch and GetBatch)
 //----------------------------------------------------------------------
 
 void
-ProdCons()
+ProdCons(bool mesa, int batch)
 {
     int i;
+
+    ASSERT(batch >= 1);
+    batchSize = batch;
     DEBUG('t', "Entering ProdCons");
 
     // Put the code to construct all the semaphores here.
@@ -154,7 +195,7 @@ ProdCons()
     // Put the code to construct a ring buffer object with size 
     //BUFF_SIZE here.
     // ...    
-    ring = new Ring(BUFF_SIZE);
+    ring = new Ring(BUFF_SIZE, mesa ? MesaSemantics : HoareSemantics);
 
     // create and fork N_PROD of producer threads 
     for (i=0; i < N_PROD; i++) 
@@ -187,3 +228,79 @@ ProdCons()
     };
 }
 
+//----------------------------------------------------------------------
+// RingBench
+// 	Measure the throughput of the monitor ring: one producer sends
+//	"count" messages and one consumer takes them, with nothing else
+//	running, and print the cost per message (see synchbench.h).
+//
+//	"mesa", "batch" -- the monitor, and messages moved per call, as
+//		for ProdCons
+//	"count" -- how many messages to send
+//----------------------------------------------------------------------
+
+static int benchMessages;		// messages to send, in RingBench
+static Semaphore *ringDone;		// V'ed by each of its threads
+
+static void
+BenchProducer(_int which)
+{
+    slot *messages = new slot[batchSize];
+
+    for (int num = 0; num < benchMessages; ) {
+	int n = min(batchSize, benchMessages - num);
+
+	for (int i = 0; i < n; i++) {
+	    messages[i].thread_id = which;
+	    messages[i].value = num + i;
+	}
+	if (batchSize > 1)
+	    for (int sent = 0; sent < n; )
+		sent += ring->PutBatch(&messages[sent], n - sent);
+	else
+	    ring->Put(&messages[0]);
+	num += n;
+    }
+    delete [] messages;
+    ringDone->V();
+}
+
+static void
+BenchConsumer(_int which)
+{
+    slot *messages = new slot[batchSize];
+
+    for (int num = 0; num < benchMessages; ) {
+	int got;
+
+	if (batchSize > 1)
+	    got = ring->GetBatch(messages, min(batchSize, benchMessages - num));
+	else {
+	    ring->Get(&messages[0]);
+	    got = 1;
+	}
+	for (int i = 0; i < got; i++)
+	    ASSERT(messages[i].value == num + i);	// in order, none lost
+	num += got;
+    }
+    delete [] messages;
+    ringDone->V();
+}
+
+void
+RingBench(bool mesa, int batch, int count)
+{
+    ASSERT(batch >= 1);
+    batchSize = batch;
+    ring = new Ring(BUFF_SIZE, mesa ? MesaSemantics : HoareSemantics);
+    benchMessages = count;
+    ringDone = new Semaphore("ring done", 0);
+
+    BenchStart(mesa ? "ring-mesa" : "ring-hoare");
+    (new Thread("bench producer"))->Fork(BenchProducer, 0);
+    (new Thread("bench consumer"))->Fork(BenchConsumer, 0);
+    ringDone->P();
+    ringDone->P();
+    BenchEnd(count);
+    delete ringDone;
+}
@@ -33,9 +33,10 @@ slot::slot(int id, int number)
 // 	return type.
 //
 // 	"sz" -- maximum number of elements in the ring buffer at any time
+//	"sem" -- Hoare or Mesa monitor semantics (see ring.h)
 //----------------------------------------------------------------------
 
-Ring::Ring(int sz)
+Ring::Ring(int sz, RingSemantics sem)
 {
     if (sz < 1) {
 	fprintf(stderr, "Error: Ring: size %d too small\n", sz);
@@ -57,6 +58,12 @@ Ring::Ring(int sz)
     mutex = new Semaphore("mutex", 1);
     next = new Semaphore("next", 0);
     next_count = 0;
+
+    // and the lock and condition variables of the Mesa monitor
+    semantics = sem;
+    lock = new Lock("ring");
+    notfullMesa = new Condition("notfull");
+    notemptyMesa = new Condition("notempty");
 }
 
 //----------------------------------------------------------------------
@@ -78,6 +85,10 @@ Ring::~Ring()
 
     delete mutex;
     delete next;
+
+    delete notfullMesa;
+    delete notemptyMesa;
+    delete lock;
 }
 
 //----------------------------------------------------------------------
@@ -91,6 +102,10 @@ Ring::~Ring()
 void
 Ring::Put(slot *message)
 {
+    if (semantics == MesaSemantics) {
+	PutMesa(message);
+	return;
+    }
 
     mutex->P();
     
@@ -125,6 +140,10 @@ Ring::Put(slot *message)
 void
 Ring::Get(slot *message)
 {
+    if (semantics == MesaSemantics) {
+	GetMesa(message);
+	return;
+    }
 
     mutex->P();
 	
@@ -148,6 +167,187 @@ Ring::Get(slot *message)
 	mutex->V();
 }
 
+//----------------------------------------------------------------------
+// Ring::PutMesa
+// 	Put, with a Mesa monitor: whoever wakes us may not be the last to
+//	touch the buffer before we run, so we check again that there is
+//	room; and our signal just makes a consumer ready, while we go on.
+//----------------------------------------------------------------------
+
+void
+Ring::PutMesa(slot *message)
+{
+    lock->Acquire();
+    while (current == size)
+	notfullMesa->Wait(lock);
+
+    buffer[in].thread_id = message->thread_id;
+    buffer[in].value = message->value;
+    current++;
+    in = (in + 1) % size;
+
+    notemptyMesa->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Ring::GetMesa
+// 	Get, with a Mesa monitor (see PutMesa).
+//----------------------------------------------------------------------
+
+void
+Ring::GetMesa(slot *message)
+{
+    lock->Acquire();
+    while (current == 0)
+	notemptyMesa->Wait(lock);
+
+    message->thread_id = buffer[out].thread_id;
+    message->value = buffer[out].value;
+    current--;
+    out = (out + 1) % size;
+
+    notfullMesa->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Ring::PutBatch
+// 	Put up to "n" messages into the buffer, under a single entry to
+//	the monitor: we wait until there is room for at least one, then
+//	put in as many as there is room for.
+//
+//	Consumers are only signalled if the buffer was empty -- otherwise
+//	none of them can be waiting.  And since one signal wakes only one
+//	thread, if there is still room we pass a signal on to any other
+//	producer that was waiting for it.
+//
+//	"messages" -- the messages to be put in the buffer
+//	"n" -- how many there are
+//----------------------------------------------------------------------
+
+int
+Ring::PutBatch(slot *messages, int n)
+{
+    bool wasEmpty;
+    int moved;
+
+    if (semantics == MesaSemantics) {
+	lock->Acquire();
+	while (current == size)
+	    notfullMesa->Wait(lock);
+	wasEmpty = (current == 0);
+	moved = MoveIn(messages, n);
+	if (wasEmpty)
+	    notemptyMesa->Signal(lock);
+	if (current < size)
+	    notfullMesa->Signal(lock);
+	lock->Release();
+	return moved;
+    }
+
+    mutex->P();
+    if (current == size)
+	notfull->Wait(mutex, next, &next_count);
+    wasEmpty = (current == 0);
+    moved = MoveIn(messages, n);
+    if (wasEmpty)
+	notempty->Signal(next, &next_count);
+    if (current < size)
+	notfull->Signal(next, &next_count);
+    if (next_count > 0) 
+	next->V();
+    else 
+	mutex->V();
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// Ring::GetBatch
+// 	Get up to "n" messages from the buffer, under a single entry to
+//	the monitor (see PutBatch); producers are only signalled if the
+//	buffer was full.
+//
+//	"messages" -- where to put the messages from the buffer
+//	"n" -- the most to get
+//----------------------------------------------------------------------
+
+int
+Ring::GetBatch(slot *messages, int n)
+{
+    bool wasFull;
+    int moved;
+
+    if (semantics == MesaSemantics) {
+	lock->Acquire();
+	while (current == 0)
+	    notemptyMesa->Wait(lock);
+	wasFull = (current == size);
+	moved = MoveOut(messages, n);
+	if (wasFull)
+	    notfullMesa->Signal(lock);
+	if (current > 0)
+	    notemptyMesa->Signal(lock);
+	lock->Release();
+	return moved;
+    }
+
+    mutex->P();
+    if (current == 0)
+	notempty->Wait(mutex, next, &next_count);
+    wasFull = (current == size);
+    moved = MoveOut(messages, n);
+    if (wasFull)
+	notfull->Signal(next, &next_count);
+    if (current > 0)
+	notempty->Signal(next, &next_count);
+    if (next_count > 0) 
+	next->V();
+    else 
+	mutex->V();
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// Ring::MoveIn
+// 	Copy as many of the "n" messages as there is room for into the
+//	buffer, and return how many.  The caller is inside the monitor.
+//----------------------------------------------------------------------
+
+int
+Ring::MoveIn(slot *messages, int n)
+{
+    int i;
+
+    for (i = 0; (i < n) && (current < size); i++) {
+	buffer[in].thread_id = messages[i].thread_id;
+	buffer[in].value = messages[i].value;
+	current++;
+	in = (in + 1) % size;
+    }
+    return i;
+}
+
+//----------------------------------------------------------------------
+// Ring::MoveOut
+// 	Copy up to "n" messages out of the buffer, and return how many.
+//	The caller is inside the monitor.
+//----------------------------------------------------------------------
+
+int
+Ring::MoveOut(slot *messages, int n)
+{
+    int i;
+
+    for (i = 0; (i < n) && (current > 0); i++) {
+	messages[i].thread_id = buffer[out].thread_id;
+	messages[i].value = buffer[out].value;
+	current--;
+	out = (out + 1) % size;
+    }
+    return i;
+}
+
 int
 Ring::Empty()
 {
@@ -11,7 +11,17 @@
 // implemented in the file ring.cc.
 //
 // The constructor (initializer) for the ring burrer is passed with an
-// integer for the size of the buffer (the number of slots). 
+// integer for the size of the buffer (the number of slots), and the
+// kind of monitor to use:
+//
+//	HoareSemantics -- a signalled thread runs at once, and the
+//		signaller waits on the "next" semaphore until it leaves
+//		(Condition_H); two extra context switches per signal
+//	MesaSemantics -- the signaller carries on, and the signalled
+//		thread re-checks its condition once it gets the lock back
+//		(Lock and Condition)
+
+enum RingSemantics { HoareSemantics, MesaSemantics };
 
 // class of the slot in the ring-buffer
 
@@ -29,12 +39,19 @@ class slot {
 
 class Ring {
   public:
-    Ring(int sz);    // Constructor:  initialize variables, allocate space.
+    Ring(int sz, RingSemantics sem);	// Constructor:  initialize
+				// variables, allocate space.
     ~Ring();         // Destructor:   deallocate space allocated above.
     
     void Put(slot *message); // Put a message the next empty slot.
     
     void Get(slot *message); // Get a message from the next  full slot.
+
+    int PutBatch(slot *messages, int n);	// Put as many of the "n"
+				// messages as there is room for (at least
+				// one); return how many
+    int GetBatch(slot *messages, int n);	// Get up to "n" messages
+				// (at least one); return how many
                                             
     int Full();       // Returns non-0 if the ring is full, 0 otherwise.
     int Empty();      // Returns non-0 if the ring is empty, 0 otherwise.
@@ -52,6 +69,16 @@ class Ring {
     Semaphore *mutex;          //semaphore for the mutual exclusion
     Semaphore *next;          //semaphore for "next" queue
     int next_count;           // the number of threads in "next" queue
+
+    RingSemantics semantics;  // Hoare, or Mesa (which uses the below)
+    Lock *lock;               // for the mutual exclusion
+    Condition *notfullMesa;   // to wait until not full
+    Condition *notemptyMesa;  // to wait until not empty
+
+    void PutMesa(slot *message);
+    void GetMesa(slot *message);
+    int MoveIn(slot *messages, int n);	// copy messages in/out of the
+    int MoveOut(slot *messages, int n);	// buffer, as many as fit
 };
 
 
@@ -0,0 +1,168 @@
+// netring.cc
+//	Routines for a mailbox's rings in user memory.  See netring.h.
+//
+//	The words of the rings are in the simulated machine's byte order,
+//	as the program sees them.  Each message's data goes in before its
+//	ring's tail is moved past it, so the program never sees a slot
+//	half written.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "netring.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// UserRings::UserRings
+// 	Set up the rings of a mailbox, in pages of a user program that the
+//	caller has zeroed, so both rings start out empty.
+//
+//	"po", "boxNum" -- the post office, and the box's number in it
+//	"frame" -- the first physical page of the rings
+//----------------------------------------------------------------------
+
+UserRings::UserRings(PostOffice *po, MailBoxAddress boxNum, int frame)
+{
+    ASSERT(MaxMailSize <= NetSlotData);
+    ASSERT((frame + (int) NetRingPages) <= numPhysPages);
+    postOffice = po;
+    box = boxNum;
+    rings = (NetRings *) &machine->mainMemory[frame * PageSize];
+    rxTail = rxCredited = 0;
+    txHead = 0;
+}
+
+//----------------------------------------------------------------------
+// UserRings::RxHead
+// 	Return the program's head of the receive ring: how many messages
+//	it has taken out.  It can have taken out no fewer than it had the
+//	last time we looked, nor more than we have put in; if it says so,
+//	return -1.
+//----------------------------------------------------------------------
+
+int
+UserRings::RxHead()
+{
+    int head = (int) WordToHost(rings->rx.head);
+
+    if ((head < rxCredited) || (head > rxTail))
+	return -1;
+    return head;
+}
+
+//----------------------------------------------------------------------
+// UserRings::Credit
+// 	Give back the credit (see PostOffice::Consumed) of each message
+//	the program has taken out of the receive ring since we last
+//	looked, as MailBox::Take does for one taken out of the box.
+//----------------------------------------------------------------------
+
+void
+UserRings::Credit()
+{
+    int head = RxHead();
+
+    for (; rxCredited < head; rxCredited++)
+	postOffice->Consumed(box, rxFrom[rxCredited % NetRingSlots]);
+}
+
+//----------------------------------------------------------------------
+// UserRings::Put
+// 	Copy a message that has arrived for the box into the next slot of
+//	the receive ring, and move the ring's tail past it.  Returns FALSE
+//	if the ring is full -- or if the program's head makes no sense,
+//	in which case it stays "full" until the program puts it right.
+//
+//	"mail" -- the message, as received from the network; the caller
+//		still owns it
+//----------------------------------------------------------------------
+
+bool
+UserRings::Put(Mail *mail)
+{
+    NetSlot *slot;
+
+    Credit();
+    if ((RxHead() < 0) || (rxTail - rxCredited >= NetRingSlots))
+	return FALSE;
+    slot = &rings->rx.slot[rxTail % NetRingSlots];
+    slot->machine = WordToMachine(mail->pktHdr.from);
+    slot->box = WordToMachine(mail->mailHdr.from);
+    slot->length = WordToMachine(mail->mailHdr.length);
+    bcopy(mail->data, slot->data, mail->mailHdr.length);
+    rxFrom[rxTail % NetRingSlots] = mail->pktHdr.from;
+    rings->rx.tail = WordToMachine(++rxTail);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// UserRings::Unread
+// 	Return how many messages are in the receive ring that the program
+//	has not taken out yet -- a whole ring's worth, if its head makes
+//	no sense, so that it is told to look.
+//----------------------------------------------------------------------
+
+int
+UserRings::Unread()
+{
+    int head = RxHead();
+
+    if (head < 0)
+	return NetRingSlots;
+    return rxTail - head;
+}
+
+//----------------------------------------------------------------------
+// UserRings::NextToSend
+// 	Find the next message the program has put in the transmit ring,
+//	and fill in its headers as PostOffice::Send wants them, with the
+//	box as the one to reply to; "data" is set to point at its data,
+//	in the ring.  A message that cannot be sent -- too long, or for a
+//	box there is none of -- is skipped.  Returns FALSE if there are
+//	none (or the program's tail makes no sense).
+//
+//	The slot is still the program's to write once Sent says so.
+//----------------------------------------------------------------------
+
+bool
+UserRings::NextToSend(PacketHeader *pktHdr, MailHeader *mailHdr, char **data)
+{
+    for (;;) {
+	int tail = (int) WordToHost(rings->tx.tail);
+	NetSlot *slot = &rings->tx.slot[txHead % NetRingSlots];
+	int length, to;
+
+	if ((tail - txHead <= 0) || (tail - txHead > NetRingSlots))
+	    return FALSE;
+	length = (int) WordToHost(slot->length);
+	to = (int) WordToHost(slot->box);
+	if ((length >= 0) && (length <= (int) MaxMailSize)
+		&& (to >= 0) && (to < postOffice->NumBoxes())) {
+	    pktHdr->to = (NetworkAddress) WordToHost(slot->machine);
+	    pktHdr->from = postOffice->Address();
+	    mailHdr->to = to;
+	    mailHdr->from = box;
+	    mailHdr->length = length;
+	    *data = slot->data;
+	    return TRUE;
+	}
+	DEBUG('n', "Dropping bad message %d from the ring of box %d\n",
+	      txHead, box);
+	Sent();
+    }
+}
+
+//----------------------------------------------------------------------
+// UserRings::Sent
+// 	Move the head of the transmit ring past the message NextToSend
+//	found, once it has been sent, so the program can use its slot
+//	again.
+//----------------------------------------------------------------------
+
+void
+UserRings::Sent()
+{
+    rings->tx.head = WordToMachine(++txHead);
+}
@@ -0,0 +1,71 @@
+// netring.h
+//	Data structures for a mailbox's rings, mapped into the memory of
+//	the user program using the box (see NetDoorbell, in syscall.h).
+//
+//	While a box has rings, the postal worker copies each message
+//	that arrives for it straight from the network into the next slot
+//	of the receive ring, and the program takes it from there, with no
+//	system call and no further copy; the program puts the messages it
+//	sends in the transmit ring, and rings the doorbell once for all of
+//	them.  Only when the program rings the doorbell to wait, or its
+//	receive ring is full, does the kernel get involved again.
+//
+//	The rings are in the program's memory, so it can write anything
+//	there.  The kernel keeps its own count of the messages it has put
+//	in the receive ring and taken out of the transmit ring, and only
+//	reads the program's counts, checking them: a program can lose its
+//	own messages, but cannot make the kernel write outside the rings,
+//	or send more than it put in.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef NETRING_H
+#define NETRING_H
+
+#include "post.h"
+#include "syscall.h"
+
+#define NetRingPages	divRoundUp(sizeof(NetRings), PageSize)
+				// pages the rings of a box take up
+
+// The following class defines a box's rings, as the kernel sees them.
+// The box's lock protects them.
+
+class UserRings {
+  public:
+    UserRings(PostOffice *po, MailBoxAddress box, int frame);
+				// The rings of "box", in physical memory
+				// from "frame" on
+
+    bool Put(Mail *mail);	// Copy an arrived message into the receive
+				// ring; FALSE if it is full
+    int Unread();		// Messages in the receive ring, not yet
+				// taken out by the program
+    void Credit();		// Give back the credits of those it has
+				// taken out since the last time
+
+    bool NextToSend(PacketHeader *pktHdr, MailHeader *mailHdr,
+		    char **data);	// The next message in the transmit
+					// ring, in place; FALSE if none
+    void Sent();		// Move the transmit ring's head past it
+
+  private:
+    PostOffice *postOffice;	// Whose box it is,
+    MailBoxAddress box;		// and which
+    NetRings *rings;		// Where they are in mainMemory
+    int rxTail;			// Messages put in the receive ring
+    int rxCredited;		// ... and taken out, as far as we know
+    NetworkAddress rxFrom[NetRingSlots];
+				// Who sent each, to give back its credit
+    int txHead;			// Messages taken out of the transmit ring
+
+    int RxHead();		// The program's head of the receive ring,
+				// if it is one it could have written; else
+				// -1
+};
+
+#endif // NETRING_H
@@ -6,6 +6,14 @@
 //	  1. Two copies of Nachos must be running, with machine ID's 0 and 1:
 //		./nachos -m 0 -o 1 &
 //		./nachos -m 1 -o 0 &
+//	(or with -ot, for StreamTest, -nb, for NetBench, -orpc, for
+//	RpcTest, or -osel, for SelectTest, in place of -o).  To read a
+//	file of machine 0's from machine 1:
+//		./nachos -m 0 -rfs 1 &
+//		./nachos -m 1 -rcat 0 <file> &
+//	For the fan-in benchmark, start one sink and N sources:
+//		./nachos -m 0 -nbfan N &
+//		./nachos -m 1 -nbfan N &   ...   ./nachos -m N -nbfan N &
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +24,9 @@
 #include "system.h"
 #include "network.h"
 #include "post.h"
+#include "transport.h"
+#include "rpc.h"
+#include "remotefs.h"
 #include "interrupt.h"
 
 // Test out message delivery, by doing the following:
@@ -65,3 +76,411 @@ MailTest(int farAddr)
     // Then we're done!
     interrupt->Halt();
 }
+
+//----------------------------------------------------------------------
+// StreamTest
+// 	Send StreamTestSize bytes to the machine with ID "farAddr" over a
+//	reliable connection (mailbox 2 at both ends), while receiving as
+//	many from it, and check that they all arrive, in order.  With a
+//	window of 1 this is stop-and-wait; a wider window keeps the
+//	network busy, however lossy it is (-n) or out of order (-e).
+//
+//	"window" -- how many segments can be in flight at once
+//----------------------------------------------------------------------
+
+#define StreamTestSize	4096
+#define StreamLinger	(100 * NetworkTime)
+
+static void
+LingerDone(_int arg)
+{
+    ((Semaphore *) arg)->V();
+}
+
+static void
+StreamSender(_int arg)
+{
+    Connection *conn = (Connection *) arg;
+    char buffer[StreamTestSize];
+
+    for (int i = 0; i < StreamTestSize; i++)
+	buffer[i] = (char) i;
+    conn->Send(buffer, StreamTestSize);
+}
+
+void
+StreamTest(int farAddr, int window)
+{
+    Connection *conn = new Connection(farAddr, 2, 2, window);
+    Semaphore *linger = new Semaphore("stream linger", 0);
+    char buffer[StreamTestSize];
+    int start = stats->totalTicks;
+    int done = 0;
+
+    (new Thread("stream sender"))->Fork(StreamSender, (_int) conn);
+    while (done < StreamTestSize)
+	done += conn->Receive(buffer + done, StreamTestSize - done);
+    for (int i = 0; i < StreamTestSize; i++)
+	ASSERT(buffer[i] == (char) i);
+    conn->Flush();
+    printf("Streamed %d bytes each way in %d ticks, window %d\n",
+	   StreamTestSize, stats->totalTicks - start, window);
+    fflush(stdout);
+
+    // our acks for its last segments may have been lost: stay around a
+    // while, to answer its retransmissions, before halting
+    interrupt->Schedule(LingerDone, (_int) linger, StreamLinger,
+			NetworkRecvInt);
+    linger->P();
+    interrupt->Halt();
+}
+
+//----------------------------------------------------------------------
+// NetBench
+// 	Measure the network between this machine and "farAddr", over a
+//	reliable connection, so that a lossy network (-n) shows up as
+//	retransmissions, rather than as lost messages.  For each message
+//	size, the machine with the lower address streams BenchStreamBytes
+//	to the other, and then sends BenchRoundTrips messages, one at a
+//	time, that the other sends straight back.
+//
+//	The stream is reported in messages and bytes per second (taking
+//	a tick to be a microsecond), and the round trips as the median
+//	and 99th percentile, in ticks.
+//----------------------------------------------------------------------
+
+#define BenchSizes	4
+static int benchSize[BenchSizes] = { 16, 256, 1024, 4096 };
+#define BenchMaxSize	4096
+#define BenchStreamBytes (64 * 1024)	// streamed, at each size
+#define BenchRoundTrips	200		// timed, at each size
+#define BenchBox	3		// where the two ends meet
+#define FanInBox	4		// the sink's first box, one per source
+#define FanInMaxSources	6		// ... up to the last box, 9
+#define TicksPerSecond	1000000
+
+static char benchBuffer[BenchMaxSize];
+
+static void
+ReceiveAll(Connection *conn, char *into, int size)
+{
+    int done = 0;
+
+    while (done < size)
+	done += conn->Receive(into + done, size - done);
+}
+
+static void
+PrintRate(const char *test, int size, int messages, int ticks)
+{
+    double seconds = (double) ticks / TicksPerSecond;
+
+    if (seconds == 0.0)
+	seconds = 1.0 / TicksPerSecond;
+    printf("netbench %s size %d messages %d ticks %d msgs/s %.0f "
+	   "bytes/s %.0f reliability %.2f\n", test, size, messages, ticks,
+	   messages / seconds, (double) messages * size / seconds,
+	   postOffice->Reliability());
+    fflush(stdout);
+}
+
+static void
+BenchHalt()
+{
+    Semaphore *linger = new Semaphore("bench linger", 0);
+
+    // as in StreamTest: answer retransmissions for a while, in case
+    // our last acks were lost
+    interrupt->Schedule(LingerDone, (_int) linger, StreamLinger,
+			NetworkRecvInt);
+    linger->P();
+    interrupt->Halt();
+}
+
+void
+NetBench(int farAddr)
+{
+    Connection *conn = new Connection(farAddr, BenchBox, BenchBox);
+    bool leader = (bool)(postOffice->Address() < farAddr);
+    int *rtt = new int[BenchRoundTrips];
+
+    for (int s = 0; s < BenchSizes; s++) {
+	int size = benchSize[s];
+	int messages = BenchStreamBytes / size;
+	int start = stats->totalTicks;
+
+	// sustained stream
+	for (int i = 0; i < messages; i++) {
+	    if (leader)
+		conn->Send(benchBuffer, size);
+	    else
+		ReceiveAll(conn, benchBuffer, size);
+	}
+	if (leader)
+	    conn->Flush();
+	PrintRate(leader ? "stream-send" : "stream-recv", size, messages,
+		  stats->totalTicks - start);
+
+	// ping-pong
+	for (int i = 0; i < BenchRoundTrips; i++) {
+	    if (leader) {
+		start = stats->totalTicks;
+		conn->Send(benchBuffer, size);
+		ReceiveAll(conn, benchBuffer, size);
+		rtt[i] = stats->totalTicks - start;
+	    } else {
+		ReceiveAll(conn, benchBuffer, size);
+		conn->Send(benchBuffer, size);
+	    }
+	}
+	if (leader) {
+	    for (int i = 1; i < BenchRoundTrips; i++) {	// insertion sort
+		int t = rtt[i], j;
+		for (j = i; j > 0 && rtt[j - 1] > t; j--)
+		    rtt[j] = rtt[j - 1];
+		rtt[j] = t;
+	    }
+	    printf("netbench ping-pong size %d round trips %d "
+		   "p50 %d p99 %d max %d ticks\n", size, BenchRoundTrips,
+		   rtt[BenchRoundTrips / 2], rtt[BenchRoundTrips * 99 / 100],
+		   rtt[BenchRoundTrips - 1]);
+	    fflush(stdout);
+	}
+    }
+    conn->Flush();
+    delete [] rtt;
+    BenchHalt();
+}
+
+//----------------------------------------------------------------------
+// NetBenchFanIn
+// 	Measure "numSources" machines, 1 to numSources, streaming to one
+//	sink, machine 0, at once.  The sink has a connection, and a
+//	thread to drain it, for each source, and reports the rate of
+//	all of them together, at each message size.
+//----------------------------------------------------------------------
+
+static Semaphore *fanInDone;	// V'd by a drain thread at each size
+
+static void
+FanInDrain(_int arg)
+{
+    Connection *conn = (Connection *) arg;
+    char *buffer = new char[BenchMaxSize];
+
+    for (int s = 0; s < BenchSizes; s++) {
+	for (int i = 0; i < BenchStreamBytes / benchSize[s]; i++)
+	    ReceiveAll(conn, buffer, benchSize[s]);
+	fanInDone->V();
+    }
+    delete [] buffer;
+}
+
+void
+NetBenchFanIn(int numSources)
+{
+    NetworkAddress me = postOffice->Address();
+
+    ASSERT((numSources > 0) && (numSources <= FanInMaxSources));
+    if (me != 0) {				// a source
+	ASSERT(me <= numSources);
+	Connection *conn = new Connection(0, FanInBox + me - 1, BenchBox);
+	for (int s = 0; s < BenchSizes; s++) {
+	    int start = stats->totalTicks;
+	    for (int i = 0; i < BenchStreamBytes / benchSize[s]; i++)
+		conn->Send(benchBuffer, benchSize[s]);
+	    conn->Flush();
+	    PrintRate("fan-in-send", benchSize[s],
+		      BenchStreamBytes / benchSize[s],
+		      stats->totalTicks - start);
+	}
+	BenchHalt();
+    }
+
+    fanInDone = new Semaphore("fan-in done", 0);
+    for (int i = 1; i <= numSources; i++)
+	(new Thread("fan-in drain"))->Fork(FanInDrain,
+	    (_int) new Connection(i, BenchBox, FanInBox + i - 1));
+    for (int s = 0; s < BenchSizes; s++) {
+	int start = stats->totalTicks;
+	for (int i = 0; i < numSources; i++)
+	    fanInDone->P();
+	PrintRate("fan-in-recv", benchSize[s],
+		  numSources * (BenchStreamBytes / benchSize[s]),
+		  stats->totalTicks - start);
+    }
+    BenchHalt();
+}
+
+//----------------------------------------------------------------------
+// RpcTest
+// 	Measure remote procedure calls between this machine and "farAddr":
+//	the machine with the lower address makes RpcTestCalls calls to the
+//	other, first one at a time, waiting for each reply before making
+//	the next, and then pipelined, making them all before waiting for
+//	any, so that they go in batches.  Each call adds up its arguments,
+//	so the results can be checked.
+//----------------------------------------------------------------------
+
+#define RpcTestCalls	200
+#define RpcAdd		0		// the procedures
+#define RpcDone		1
+
+static Semaphore *rpcDone;		// V'd when the client is done
+
+static int
+RpcTestHandler(int proc, char *args, int length, char *result)
+{
+    int *arg = (int *) args;
+
+    switch (proc) {
+      case RpcAdd:
+	ASSERT(length == 2 * sizeof(int));
+	*(int *) result = arg[0] + arg[1];
+	return sizeof(int);
+      case RpcDone:
+	rpcDone->V();
+	return 0;
+      default:
+	ASSERT(FALSE);
+	return 0;
+    }
+}
+
+void
+RpcTest(int farAddr)
+{
+    int args[2], sum, start;
+    int *calls;
+
+    if (postOffice->Address() > farAddr) {	// the server
+	rpcDone = new Semaphore("rpc done", 0);
+	new RpcServer(farAddr, BenchBox, BenchBox, RpcTestHandler);
+	rpcDone->P();
+	BenchHalt();
+    }
+
+    RpcClient *client = new RpcClient(farAddr, BenchBox, BenchBox);
+
+    start = stats->totalTicks;
+    for (int i = 0; i < RpcTestCalls; i++) {
+	args[0] = i;
+	args[1] = 1;
+	client->Call(RpcAdd, (char *) args, sizeof(args), (char *) &sum,
+		     sizeof(int));
+	ASSERT(sum == i + 1);
+    }
+    printf("rpc one at a time: %d calls in %d ticks\n", RpcTestCalls,
+	   stats->totalTicks - start);
+
+    calls = new int[RpcTestCalls];
+    start = stats->totalTicks;
+    for (int i = 0; i < RpcTestCalls; i++) {
+	args[0] = i;
+	args[1] = 2;
+	calls[i] = client->Start(RpcAdd, (char *) args, sizeof(args));
+    }
+    for (int i = 0; i < RpcTestCalls; i++) {
+	client->Finish(calls[i], (char *) &sum, sizeof(int));
+	ASSERT(sum == i + 2);
+    }
+    printf("rpc pipelined: %d calls in %d ticks\n", RpcTestCalls,
+	   stats->totalTicks - start);
+    fflush(stdout);
+    delete [] calls;
+
+    client->Call(RpcDone, NULL, 0, NULL, 0);
+    BenchHalt();
+}
+
+//----------------------------------------------------------------------
+// SelectTest
+// 	Take messages from several mailboxes with one thread, using a
+//	MailSet.  The machine with the higher address sends SelectMessages
+//	messages to each of SelectBoxes boxes of the other, in turn; the
+//	other waits on all the boxes at once, and counts what arrives in
+//	each.  (The network must be reliable for them all to arrive.)
+//----------------------------------------------------------------------
+
+#define SelectBoxes	4		// boxes 4 to 7
+#define SelectMessages	20		// sent to each
+
+void
+SelectTest(int farAddr)
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    char buffer[MaxMailSize];
+    int count[SelectBoxes];
+    int box;
+
+    if (postOffice->Address() > farAddr) {	// the sender
+	pktHdr.to = farAddr;
+	mailHdr.from = 0;
+	for (int i = 0; i < SelectMessages * SelectBoxes; i++) {
+	    mailHdr.to = FanInBox + i % SelectBoxes;
+	    sprintf(buffer, "message %d", i);
+	    mailHdr.length = strlen(buffer) + 1;
+	    postOffice->Send(pktHdr, mailHdr, buffer);
+	}
+	BenchHalt();
+    }
+
+    MailSet *set = new MailSet(postOffice);
+
+    for (int b = 0; b < SelectBoxes; b++) {
+	set->Add(FanInBox + b);
+	count[b] = 0;
+    }
+    for (int i = 0; i < SelectMessages * SelectBoxes; i++) {
+	set->Get(&box, &pktHdr, &mailHdr, buffer);
+	count[box - FanInBox]++;
+    }
+    for (int b = 0; b < SelectBoxes; b++)
+	printf("Got %d messages in box %d\n", count[b], FanInBox + b);
+    fflush(stdout);
+    delete set;
+    interrupt->Halt();
+}
+
+//----------------------------------------------------------------------
+// RemoteFsServe, RemoteFsTest
+// 	Serve this machine's files to "client", and, on the client, read
+//	file "name" of the server's from start to end, twice: the first
+//	time it streams from the server, with read-ahead; the second, it
+//	is read from the client's cache (if it fits).
+//----------------------------------------------------------------------
+
+#define RemoteTestChunk	512		// bytes read at a time
+
+void
+RemoteFsServe(int client)
+{
+    new RemoteFileServer(client);	// serves until we are killed
+}
+
+void
+RemoteFsTest(int server, char *name)
+{
+    RemoteFileSystem *fs = new RemoteFileSystem(server);
+    char buffer[RemoteTestChunk];
+    int start = stats->totalTicks, bytes, n;
+    RemoteFile *file;
+
+    if ((file = fs->Open(name)) == NULL) {
+	printf("Remote file %s not found on machine %d\n", name, server);
+	BenchHalt();
+    }
+    for (int pass = 1; pass <= 2; pass++) {
+	file->Seek(0);
+	bytes = 0;
+	while ((n = file->Read(buffer, RemoteTestChunk)) > 0)
+	    bytes += n;
+	printf("remote read pass %d: %d bytes in %d ticks\n", pass, bytes,
+	       stats->totalTicks - start);
+	fflush(stdout);
+	start = stats->totalTicks;
+    }
+    delete file;
+    BenchHalt();
+}
@@ -12,12 +12,79 @@
 // 	The implementation synchronizes incoming messages with threads
 //	waiting for those messages.
 //
+//	Messages too big for one packet are sent in fragments.  While a
+//	thread is waiting in ReceiveLarge, the postal worker copies each
+//	fragment that arrives straight from the network's buffer to its
+//	place in the waiting thread's buffer, without making a Mail of it.
+//
+//	With flow control, a sender's credits for a box are kept as the
+//	number of the next message it will send there, and a grant: it
+//	may send messages numbered below the grant.  The receiver's grant
+//	is one past the highest number that has arrived, plus the window,
+//	less the messages still in the box.  Since both only go up, a
+//	grant that is lost is made up for by the next, and a message that
+//	is lost costs no credit once a later one arrives.  A sender that
+//	has held messages too long for credits asks for them again
+//	(FlowProbe), in case the grant it is waiting for was lost.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
 #include "post.h"
+#include "netring.h"
+#include "system.h"
+
+#define MailSlabSize	16		// Mail allocated from the host at
+					// a time
+
+static Mail *freeMail = NULL;		// Mail not in use
+
+//----------------------------------------------------------------------
+// Mail::operator new
+// 	Allocate the storage for a mail message: the most recently freed
+//	one, if there is any, or else one of a new slab from the host (the
+//	rest go in the pool).  Every incoming message needs one, and it
+//	is given back once the message has been received, so a handful
+//	of them get used over and over.
+//
+//	No locking is needed, as nothing in here can cause a context
+//	switch.
+//----------------------------------------------------------------------
+
+void *
+Mail::operator new(size_t size)
+{
+    Mail *mail;
+
+    ASSERT(size == sizeof(Mail));
+    if (freeMail == NULL) {
+	Mail *slab = (Mail *) new char[MailSlabSize * size];
+
+	for (int i = 0; i < MailSlabSize; i++) {
+	    slab[i].next = freeMail;
+	    freeMail = &slab[i];
+	}
+    }
+    mail = freeMail;
+    freeMail = mail->next;
+    return (void *) mail;
+}
+
+//----------------------------------------------------------------------
+// Mail::operator delete
+// 	Put the storage for a mail message back in the pool.
+//----------------------------------------------------------------------
+
+void
+Mail::operator delete(void *ptr)
+{
+    Mail *mail = (Mail *) ptr;
+
+    mail->next = freeMail;
+    freeMail = mail;
+}
 
 //----------------------------------------------------------------------
 // Mail::Mail
@@ -49,7 +116,13 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
 
 MailBox::MailBox()
 { 
-    messages = new SynchList(); 
+    messages = new List(); 
+    lock = new Lock("mailbox lock");
+    arrived = new Condition("mail arrived");
+    posted = NULL;
+    watcher = NULL;
+    owner = NULL;
+    rings = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -62,7 +135,14 @@ MailBox::MailBox()
 
 MailBox::~MailBox()
 { 
+    Mail *mail;
+
+    while ((mail = (Mail *) messages->Remove()) != NULL)
+	delete mail;
     delete messages; 
+    delete lock;
+    delete arrived;
+    delete rings;
 }
 
 //----------------------------------------------------------------------
@@ -84,24 +164,195 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 //----------------------------------------------------------------------
 // MailBox::Put
 // 	Add a message to the mailbox.  If anyone is waiting for message
-//	arrival, wake them up!
+//	arrival, wake them up!  The mailbox now owns "mail".
 //
-//	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
+//	If a thread is waiting in GetLarge, though, the message is taken
+//	to be a fragment, and its data goes straight to its place in the
+//	thread's buffer.
 //
-//	"pktHdr" -- source, destination machine ID's
-//	"mailHdr" -- source, destination mailbox ID's
-//	"data" -- payload message data
+//	If the box is in a MailSet, the set is told of the message too,
+//	once our lock is released -- the set takes the box's lock while
+//	holding its own.
+//
+//	If the box's rings are mapped, the message goes straight into the
+//	receive ring, unless it is full, or messages that came before are
+//	still waiting for room there even once the program has taken out
+//	what it can.
+//
+//	"mail" -- the message, as received from the network
 //----------------------------------------------------------------------
 
 void 
-MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+MailBox::Put(Mail *mail)
 { 
-    Mail *mail = new Mail(pktHdr, mailHdr, data); 
+    MailSet *set = NULL;
 
-    messages->Append((void *)mail);	// put on the end of the list of 
+    lock->Acquire();
+    if ((posted != NULL) && !complete) {
+	Reassemble(mail->pktHdr, mail->mailHdr, mail->data);
+	delete mail;
+    } else if ((rings != NULL) && Refill() && rings->Put(mail)) {
+	delete mail;
+	arrived->Signal(lock);		// wake up the doorbell, if waiting
+    } else {
+	messages->Append((void *)mail);	// put on the end of the list of 
 					// arrived messages, and wake up 
-					// any waiters
+	arrived->Signal(lock);		// any waiters
+	set = watcher;
+    }
+    lock->Release();
+    if (set != NULL)
+	set->Notify();
+}
+
+//----------------------------------------------------------------------
+// MailBox::Take
+// 	Take the next message out of the mailbox, waiting if there is none
+//	yet, and return it.  The caller now owns it, and must delete it
+//	(which puts it back in the pool) when done with it.
+//----------------------------------------------------------------------
+
+Mail *
+MailBox::Take()
+{
+    Mail *mail;
+
+    DEBUG('n', "Waiting for mail in mailbox\n");
+    lock->Acquire();
+    while ((mail = (Mail *) messages->Remove()) == NULL)
+	arrived->Wait(lock);		// wait if list is empty
+    owner->Consumed(number, mail->pktHdr.from);
+    lock->Release();
+    if (DebugIsEnabled('n')) {
+	printf("Got mail from mailbox: ");
+	PrintHeader(mail->pktHdr, mail->mailHdr);
+    }
+    return mail;
+}
+
+//----------------------------------------------------------------------
+// MailBox::Poll
+// 	Take the next message out of the mailbox, as Take does, but
+//	return NULL at once if there is none, rather than waiting.
+//----------------------------------------------------------------------
+
+Mail *
+MailBox::Poll()
+{
+    Mail *mail;
+
+    lock->Acquire();
+    mail = (Mail *) messages->Remove();
+    if (mail != NULL)
+	owner->Consumed(number, mail->pktHdr.from);
+    lock->Release();
+    return mail;
+}
+
+//----------------------------------------------------------------------
+// MailBox::Watch
+// 	Tell "set" of every message put in the mailbox from now on, or,
+//	if "set" is NULL, stop.  A box is in at most one set at a time.
+//----------------------------------------------------------------------
+
+void
+MailBox::Watch(MailSet *set)
+{
+    lock->Acquire();
+    ASSERT((set == NULL) || (watcher == NULL));
+    watcher = set;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// MailBox::MapRings
+// 	From now on, put the messages that arrive for the box straight
+//	into the receive ring in a user program's memory (see netring.h),
+//	starting with any waiting in the box now.  Returns FALSE if the
+//	box's rings are mapped already, or the box is in a MailSet.
+//
+//	Once the rings are mapped, only the program takes messages out of
+//	the box, through them.
+//
+//	"frame" -- the first of the NetRingPages physical pages, zeroed,
+//		the rings are to be in
+//----------------------------------------------------------------------
+
+bool
+MailBox::MapRings(int frame)
+{
+    bool mapped = FALSE;
+
+    lock->Acquire();
+    if ((rings == NULL) && (watcher == NULL)) {
+	rings = new UserRings(owner, number, frame);
+	Refill();
+	mapped = TRUE;
+    }
+    lock->Release();
+    return mapped;
+}
+
+//----------------------------------------------------------------------
+// MailBox::Refill
+// 	Move the messages waiting in the box into the receive ring, for as
+//	long as it has room, keeping them in order.  Returns TRUE if none
+//	are left waiting.  Called with our lock held.
+//----------------------------------------------------------------------
+
+bool
+MailBox::Refill()
+{
+    Mail *mail;
+
+    while ((mail = (Mail *) messages->Remove()) != NULL) {
+	if (!rings->Put(mail)) {
+	    messages->Prepend((void *)mail);
+	    return FALSE;
+	}
+	delete mail;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// MailBox::Doorbell
+// 	Send each message the program has put in the transmit ring, and
+//	move any that are waiting for room into the receive ring.  If
+//	"wait", and the receive ring is still empty, wait until something
+//	arrives.  Returns how many messages are in the receive ring.
+//
+//	The messages are sent without our lock held, as sending may wait
+//	(see PostOffice::Send); only the program's own threads ring the
+//	doorbell, and they must take turns at it.
+//----------------------------------------------------------------------
+
+int
+MailBox::Doorbell(bool wait)
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    char *data;
+    int unread;
+
+    ASSERT(rings != NULL);
+    while (rings->NextToSend(&pktHdr, &mailHdr, &data)) {
+	owner->Send(pktHdr, mailHdr, data);	// copies it out of the ring
+	rings->Sent();
+    }
+
+    lock->Acquire();
+    for (;;) {
+	rings->Credit();
+	Refill();
+	unread = rings->Unread();
+	if ((unread > 0) || !wait)
+	    break;
+	DEBUG('n', "Waiting for mail in the rings of mailbox %d\n", number);
+	arrived->Wait(lock);
+    }
+    lock->Release();
+    return unread;
 }
 
 //----------------------------------------------------------------------
@@ -119,16 +370,10 @@ MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
 void 
 MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
 { 
-    DEBUG('n', "Waiting for mail in mailbox\n");
-    Mail *mail = (Mail *) messages->Remove();	// remove message from list;
-						// will wait if list is empty
+    Mail *mail = Take();
 
     *pktHdr = mail->pktHdr;
     *mailHdr = mail->mailHdr;
-    if (DebugIsEnabled('n')) {
-	printf("Got mail from mailbox: ");
-	PrintHeader(*pktHdr, *mailHdr);
-    }
     bcopy(mail->data, data, mail->mailHdr.length);
 					// copy the message data into
 					// the caller's buffer
@@ -137,31 +382,333 @@ MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data)
 }
 
 //----------------------------------------------------------------------
-// PostalHelper, ReadAvail, WriteDone
+// MailBox::GetLarge
+// 	Get a message sent by SendLarge (in fragments) from a mailbox,
+//	putting it together in "data", and return its size.  Fragments
+//	that arrived before we did are queued as mail, and are taken from
+//	there; the rest are put in place by Put as they arrive.
+//
+//	If a fragment of another message arrives before the one we are
+//	putting together is complete (the network may have dropped one of
+//	its fragments), we give up on it, and start on the new one.  So
+//	only one thread at a time should send large messages to a mailbox.
+//
+//	"pktHdr" -- address to put: source, destination machine ID's
+//	"mailHdr" -- address to put: source, destination mailbox ID's
+//		(its length is that of the whole message)
+//	"data" -- address to put: the message
+//	"maxSize" -- the largest message that fits there
+//----------------------------------------------------------------------
+
+int
+MailBox::GetLarge(PacketHeader *pktHdr, MailHeader *mailHdr, char *data,
+		  int maxSize)
+{
+    Mail *mail;
+
+    lock->Acquire();
+    ASSERT(posted == NULL);		// one GetLarge at a time
+    posted = data;
+    postedSize = maxSize;
+    complete = FALSE;
+    message = -1;
+    while (!complete && (mail = (Mail *) messages->Remove()) != NULL) {
+	Reassemble(mail->pktHdr, mail->mailHdr, mail->data);
+	delete mail;
+    }
+    while (!complete)
+	arrived->Wait(lock);
+    *pktHdr = fragPktHdr;
+    *mailHdr = fragMailHdr;
+    mailHdr->length = received;
+    posted = NULL;
+    lock->Release();
+    return received;
+}
+
+//----------------------------------------------------------------------
+// MailBox::Reassemble
+// 	Copy a fragment's data to its place in the buffer GetLarge is
+//	waiting to fill, and wake it up once the message is complete.
+//	A fragment of a different message than the one being put together
+//	starts over with that one.  The lock must be held.
+//
+//	"pktHdr", "mailHdr" -- the headers of the fragment
+//	"data" -- its FragmentHeader, followed by its part of the message
+//----------------------------------------------------------------------
+
+void
+MailBox::Reassemble(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+{
+    FragmentHeader fragHdr;
+    unsigned size = mailHdr.length - sizeof(FragmentHeader);
+
+    ASSERT(mailHdr.length >= sizeof(FragmentHeader));
+    bcopy(data, (char *) &fragHdr, sizeof(FragmentHeader));
+    if ((fragHdr.message != message) || (pktHdr.from != fragPktHdr.from)
+		|| (mailHdr.from != fragMailHdr.from)) {
+	if (message >= 0)
+	    DEBUG('n', "Dropping incomplete message %d\n", message);
+	ASSERT(fragHdr.total <= (unsigned) postedSize);
+	message = fragHdr.message;
+	fragPktHdr = pktHdr;
+	fragMailHdr = mailHdr;
+	received = 0;
+    }
+    ASSERT(fragHdr.offset + size <= fragHdr.total);
+    bcopy(data + sizeof(FragmentHeader), posted + fragHdr.offset, size);
+    owner->Consumed(number, pktHdr.from);
+    received += size;
+    if (received == fragHdr.total) {
+	complete = TRUE;
+	arrived->Broadcast(lock);
+    }
+}
+
+//----------------------------------------------------------------------
+// PostalHelper, ReadAvail, WriteDone, FlowProber, FlowProbeDue
 // 	Dummy functions because C++ can't indirectly invoke member functions
-//	The first is forked as part of the "postal worker thread; the
-//	later two are called by the network interrupt handler.
+//	The first is forked as part of an interface's "postal worker"
+//	thread; the next two are called by its network interrupt handler.
+//	The last two are the post office's thread asking for overdue
+//	credits, and the alarm that wakes it.
 //
-//	"arg" -- pointer to the Post Office managing the Network
+//	"arg" -- pointer to the interface managing the Network, or to the
+//		post office
 //----------------------------------------------------------------------
 
 static void PostalHelper(_int arg)
-{ PostOffice* po = (PostOffice *) arg; po->PostalDelivery(); }
+{ NetworkInterface* ni = (NetworkInterface *) arg; ni->PostalDelivery(); }
 static void ReadAvail(_int arg)
-{ PostOffice* po = (PostOffice *) arg; po->IncomingPacket(); }
+{ NetworkInterface* ni = (NetworkInterface *) arg; ni->IncomingPacket(); }
 static void WriteDone(_int arg)
-{ PostOffice* po = (PostOffice *) arg; po->PacketSent(); }
+{ NetworkInterface* ni = (NetworkInterface *) arg; ni->PacketSent(); }
+static void FlowProber(_int arg)
+{ PostOffice* po = (PostOffice *) arg; po->Probe(); }
+static void FlowProbeDue(_int arg)
+{ PostOffice* po = (PostOffice *) arg; po->ProbeDue(); }
 
 //----------------------------------------------------------------------
-// PostOffice::PostOffice
-// 	Initialize a post office as a collection of mailboxes.
-//	Also initialize the network device, to allow post offices
-//	on different machines to deliver messages to one another.
+// NetworkInterface::NetworkInterface
+// 	Initialize one of a post office's network interfaces: the network
+//	device, and the queue of messages waiting to be sent on it.
 //
 //      We use a separate thread "the postal worker" to wait for messages 
 //	to arrive, and deliver them to the correct mailbox.  Note that
 //	delivering messages to the mailboxes can't be done directly
-//	by the interrupt handlers, because it requires a Lock.
+//	by the interrupt handlers, because it requires a Lock.  Each
+//	interface has a postal worker of its own, so that one machine can
+//	take in messages from several networks at once.
+//
+//	"po" is the post office the interface belongs to
+//	"address" is its network ID
+//	"reliability", "orderability", "rxRing" are for the network, as
+//	  for the PostOffice
+//----------------------------------------------------------------------
+
+NetworkInterface::NetworkInterface(PostOffice *po, NetworkAddress address,
+				   double reliability, double orderability,
+				   int rxRing)
+{
+    postOffice = po;
+    addr = address;
+
+// First, initialize the synchronization with the interrupt handlers
+    messageAvailable = new Semaphore("message available", 0);
+    outgoing = new List;
+    sendSlots = new Semaphore("message send slots", TxQueueSize);
+    sending = FALSE;
+
+// Then, initialize the network; tell it which interrupt handlers to call
+    network = new Network(addr, reliability, orderability,
+			  ReadAvail, WriteDone, (_int) this, rxRing);
+
+// Finally, create a thread whose sole job is to wait for incoming messages,
+//   and put them in the right mailbox. 
+    worker = new Thread("postal worker");
+    worker->Fork(PostalHelper, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// NetworkInterface::~NetworkInterface
+// 	De-allocate the interface's data structures.
+//----------------------------------------------------------------------
+
+NetworkInterface::~NetworkInterface()
+{
+    delete network;
+    delete messageAvailable;
+    delete outgoing;
+    delete sendSlots;
+}
+
+//----------------------------------------------------------------------
+// NetworkInterface::PostalDelivery
+// 	Wait for incoming messages, and hand them to the post office.
+//
+//      Incoming messages have had the PacketHeader stripped off,
+//	but the MailHeader is still tacked on the front of the data --
+//	which is just how a Mail is laid out, so each message is received
+//	straight into one, and handed on as it is.
+//
+//	The network interrupts once for however many messages have come
+//	in since the last time, so we take in all of them each time.
+//
+//	A packet may hold several messages, one after another (see
+//	StartSending); any after the first are copied out into Mail of
+//	their own, before the first is handed on.
+//----------------------------------------------------------------------
+
+void
+NetworkInterface::PostalDelivery()
+{
+    Mail *batch[MaxPacketSize / sizeof(MailHeader)];
+    Mail *mail;
+
+    for (;;) {
+        // first, wait for messages
+        messageAvailable->P();	
+
+	for (;;) {
+	    mail = new Mail;
+	    ASSERT(mail->data == (char *) &mail->mailHdr + sizeof(MailHeader));
+	    mail->pktHdr = network->Receive((char *) &mail->mailHdr);
+	    if (mail->pktHdr.length == 0) {	// no more for now
+		delete mail;
+		break;
+	    }
+
+	    char *packet = (char *) &mail->mailHdr;
+	    unsigned total = mail->pktHdr.length;
+	    unsigned offset = sizeof(MailHeader) + mail->mailHdr.length;
+	    int count = 1;
+
+	    ASSERT(offset <= total);
+	    batch[0] = mail;
+	    mail->pktHdr.length = offset;
+	    while (offset < total) {
+		Mail *more = new Mail;
+
+		ASSERT(offset + sizeof(MailHeader) <= total);
+		more->pktHdr = mail->pktHdr;
+		more->mailHdr = *(MailHeader *) (packet + offset);
+		offset += sizeof(MailHeader);
+		ASSERT(offset + more->mailHdr.length <= total);
+		bcopy(packet + offset, more->data, more->mailHdr.length);
+		offset += more->mailHdr.length;
+		more->pktHdr.length = sizeof(MailHeader) + more->mailHdr.length;
+		batch[count++] = more;
+	    }
+	    for (int i = 0; i < count; i++)
+		postOffice->Arrived(batch[i]);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// NetworkInterface::Queue
+// 	Queue a message (whose PacketHeader is filled in) to be sent on
+//	this interface.  Returns at once, unless the queue is full.  The
+//	interface now owns "mail".
+//----------------------------------------------------------------------
+
+void
+NetworkInterface::Queue(Mail *mail)
+{
+    IntStatus oldLevel;
+
+    sendSlots->P();			// wait for room in the queue
+    oldLevel = interrupt->SetLevel(IntOff);	// the queue is shared with
+						// the interrupt handler
+    outgoing->Append((void *)mail);
+    if (!sending)			// nothing on its way out, so
+	StartSending();			// the handler won't send this
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// NetworkInterface::StartSending
+// 	Put the next packet on the network, if any messages are waiting:
+//	the oldest message, and, with coalescing on, as many of those
+//	queued behind it as are for the same machine and fit in the
+//	packet.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+NetworkInterface::StartSending()
+{
+    char buffer[MaxPacketSize];		// for several messages at once
+    Mail *mail = (Mail *) outgoing->Remove();
+    PacketHeader pktHdr;
+    char *packet;
+
+    ASSERT(interrupt->getLevel() == IntOff);
+    if (mail == NULL) {			// nothing more to send, for now
+	sending = FALSE;
+	return;
+    }
+    sending = TRUE;
+    pktHdr = mail->pktHdr;
+    packet = (char *) &mail->mailHdr;	// MailHeader + data as they are
+    if (postOffice->Coalescing()) {
+	Mail *next;
+
+	bcopy(packet, buffer, pktHdr.length);
+	packet = buffer;
+	while ((next = (Mail *) outgoing->Remove()) != NULL) {
+	    if ((next->pktHdr.to != pktHdr.to)
+		|| (pktHdr.length + next->pktHdr.length > MaxPacketSize)) {
+		outgoing->Prepend((void *)next);	// not this time
+		break;
+	    }
+	    DEBUG('n', "Coalescing %d bytes for mailbox %d\n",
+		  next->mailHdr.length, next->mailHdr.to);
+	    bcopy((char *) &next->mailHdr, buffer + pktHdr.length,
+		  next->pktHdr.length);
+	    pktHdr.length += next->pktHdr.length;
+	    delete next;
+	    sendSlots->V();
+	}
+    }
+    network->Send(pktHdr, packet);	// copies the packet out
+    delete mail;
+    sendSlots->V();
+}
+
+//----------------------------------------------------------------------
+// NetworkInterface::IncomingPacket
+// 	Interrupt handler, called when packets arrive from the network.
+//
+//	Signal the PostalDelivery routine that it is time to get to work!
+//----------------------------------------------------------------------
+
+void
+NetworkInterface::IncomingPacket()
+{ 
+    messageAvailable->V(); 
+}
+
+//----------------------------------------------------------------------
+// NetworkInterface::PacketSent
+// 	Interrupt handler, called when the next packet can be put onto the 
+//	network: send it, if there is one waiting.
+//
+//	The name of this routine is a misnomer; if "reliability < 1",
+//	the packet could have been dropped by the network, so it won't get
+//	through.
+//----------------------------------------------------------------------
+
+void 
+NetworkInterface::PacketSent()
+{ 
+    StartSending();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::PostOffice
+// 	Initialize a post office as a collection of mailboxes.
+//	Also initialize its first network interface, to allow post
+//	offices on different machines to deliver messages to one another.
 //
 //	"addr" is this machine's network ID 
 //	"reliability" is the probability that a network packet will
@@ -172,31 +719,35 @@ static void WriteDone(_int arg)
 //        is delivered is delivered without delay (e.g., orderability = 1
 //        means that delivered packets are never delayed)
 //	"nBoxes" is the number of mail boxes in this Post Office
+//	"rxRing" is how many arrived packets each network device can hold
 //----------------------------------------------------------------------
 
 PostOffice::PostOffice(NetworkAddress addr, double reliability,
-		       double orderability, int nBoxes)
+		       double orderability, int nBoxes, int rxRing)
 {
-// First, initialize the synchronization with the interrupt handlers
-    messageAvailable = new Semaphore("message available", 0);
-    messageSent = new Semaphore("message sent", 0);
-    sendLock = new Lock("message send lock");
+    coalesce = FALSE;
+    nextMessage = 0;
+    rtPeriod = rtDeadline = rtBudget = 0;
+    window = 0;
+    flowLock = new Lock("flow control lock");
+    credited = new Condition("credits arrived");
+    numSending = numReceiving = 0;
+    probeDue = new Semaphore("credits overdue", 0);
+    probing = FALSE;
 
-// Second, initialize the mailboxes
+// First, initialize the mailboxes
     netAddr = addr; 
     numBoxes = nBoxes;
     boxes = new MailBox[nBoxes];
+    for (int i = 0; i < nBoxes; i++)
+	boxes[i].SetOwner(this, i);
 
-// Third, initialize the network; tell it which interrupt handlers to call
-    network = new Network(addr, reliability, orderability,
-			  ReadAvail, WriteDone, (_int) this);
-
-
-// Finally, create a thread whose sole job is to wait for incoming messages,
-//   and put them in the right mailbox. 
-    Thread *t = new Thread("postal worker");
-
-    t->Fork(PostalHelper, (_int) this);
+// Then, the network, with no routes as yet
+    netReliability = reliability;
+    netOrderability = orderability;
+    netRxRing = rxRing;
+    numInterfaces = numRoutes = 0;
+    (void) AddInterface(addr);
 }
 
 //----------------------------------------------------------------------
@@ -206,52 +757,447 @@ PostOffice::PostOffice(NetworkAddress addr, double reliability,
 
 PostOffice::~PostOffice()
 {
-    delete network;
+    for (int i = 0; i < numInterfaces; i++)
+	delete interfaces[i];
     delete [] boxes;
-    delete messageAvailable;
-    delete messageSent;
-    delete sendLock;
+    delete flowLock;
+    delete credited;
+    delete probeDue;
 }
 
 //----------------------------------------------------------------------
-// PostOffice::PostalDelivery
-// 	Wait for incoming messages, and put them in the right mailbox.
+// PostOffice::AddInterface
+// 	Connect this machine to another network, with a network device of
+//	its own, and return the new interface's number (for AddRoute).
 //
-//      Incoming messages have had the PacketHeader stripped off,
-//	but the MailHeader is still tacked on the front of the data.
+//	"addr" is the machine's network ID on that network
+//----------------------------------------------------------------------
+
+int
+PostOffice::AddInterface(NetworkAddress addr)
+{
+    ASSERT(numInterfaces < MaxInterfaces);
+    interfaces[numInterfaces] = new NetworkInterface(this, addr,
+				netReliability, netOrderability, netRxRing);
+    if (rtPeriod > 0) {
+	IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+	(void) scheduler->SetRealTime(interfaces[numInterfaces]->Worker(),
+				      rtPeriod, rtDeadline, rtBudget);
+	(void) interrupt->SetLevel(oldLevel);
+    }
+    return numInterfaces++;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SetRealTime
+// 	Run the thread delivering the incoming messages of each interface
+//	-- those there are now, and any added later -- as a real-time
+//	thread, so that messages are handed to their mailboxes within
+//	"deadline" ticks of arriving.  Return FALSE if admission control
+//	turned any of them away.
+//
+//	"period", "deadline", "budget" -- see Scheduler::SetRealTime
+//----------------------------------------------------------------------
+
+bool
+PostOffice::SetRealTime(int period, int deadline, int budget)
+{
+    bool admitted = TRUE;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    rtPeriod = period;
+    rtDeadline = deadline;
+    rtBudget = budget;
+    for (int i = 0; i < numInterfaces; i++)
+	if (!scheduler->SetRealTime(interfaces[i]->Worker(), period,
+				    deadline, budget))
+	    admitted = FALSE;
+    (void) interrupt->SetLevel(oldLevel);
+    return admitted;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SetFlowControl
+// 	Turn on flow control: each machine may have at most "credits"
+//	messages waiting in each of the boxes of another (more, only if
+//	the network delays some of them).  Messages sent beyond that are
+//	held by the sender until the receiver takes some out, and once
+//	"credits" of them are held, Send waits.  Every machine must turn
+//	it on, with the same number of credits, before any messages are
+//	sent.
+//
+//	A thread waiting in Send holds up any other messages it has to
+//	send, so the credits should cover whatever a thread taking
+//	messages out of a box also sends back the other way -- for a
+//	Connection, its window of segments, and an ack for each.
 //----------------------------------------------------------------------
 
 void
-PostOffice::PostalDelivery()
+PostOffice::SetFlowControl(int credits)
+{
+    ASSERT((window == 0) && (credits > 0) && (credits <= MaxFlowWindow));
+    window = credits;
+    (new Thread("flow prober"))->Fork(FlowProber, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::FindFlow
+// 	Return the entry in "table" for the flow to mailbox "box", from
+//	or to "host", making one if there is none: the flow starts
+//	with a full window of credits.  The flow lock must be held.
+//
+//	"table", "count" -- the sending or receiving flows, and how many
+//		of them there are
+//----------------------------------------------------------------------
+
+Flow *
+PostOffice::FindFlow(Flow *table, int *count, NetworkAddress host,
+		     MailBoxAddress box)
+{
+    Flow *f;
+
+    for (int i = 0; i < *count; i++)
+	if ((table[i].machine == host) && (table[i].box == box))
+	    return &table[i];
+    ASSERT(*count < MaxFlows);
+    f = &table[(*count)++];
+    f->machine = host;
+    f->box = box;
+    f->seq = 0;
+    f->grant = window;
+    f->held = new List;
+    f->numHeld = 0;
+    f->waiting = 0;
+    f->queued = 0;
+    return f;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Grant
+// 	Return how far the sender of a receiving flow can go now, or
+//	the last grant we sent it, if that was further (a message the
+//	network delayed may arrive after it).  The flow lock must be
+//	held.
+//----------------------------------------------------------------------
+
+unsigned char
+PostOffice::Grant(Flow *f)
+{
+    unsigned char grant = f->seq + window - f->queued;
+
+    if ((signed char) (grant - f->grant) < 0)
+	return f->grant;
+    return grant;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Consumed
+// 	Called by a mailbox, holding its lock, whenever a message is taken
+//	out of it: the machine that sent it has a credit back.  The credits
+//	are sent back once half a window of them is owed; before that,
+//	they go back only with messages we send it anyway.
+//
+//	"box" -- the mailbox
+//	"from" -- the machine the message came from
+//----------------------------------------------------------------------
+
+void
+PostOffice::Consumed(MailBoxAddress box, NetworkAddress from)
+{
+    Flow *f;
+    unsigned char grant;
+    bool owed;
+
+    if (window == 0)
+	return;
+    flowLock->Acquire();
+    f = FindFlow(receiving, &numReceiving, from, box);
+    if (f->queued > 0)
+	f->queued--;
+    grant = Grant(f);
+    owed = ((signed char) (grant - f->grant) >= max(window / 2, 1));
+    if (owed)
+	f->grant = grant;
+    flowLock->Release();
+    if (owed)
+	SendControl(from, FlowCredit, box, grant);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::TakeCredits
+// 	Called for each message that arrives for us, with flow control
+//	on: take in the grant it carries, for the flow from us to the box
+//	it was sent from, and count it against its own flow.  Return
+//	FALSE if it was only sent to give back credits, or to ask for
+//	them -- in which case we answer -- and has nothing to deliver.
+//----------------------------------------------------------------------
+
+bool
+PostOffice::TakeCredits(Mail *mail)
+{
+    MailHeader *hdr = &mail->mailHdr;
+    bool mine = (hdr->from >= 0) && (hdr->from < numBoxes);
+    unsigned char grant = 0;
+    Mail *ready[MaxFlowWindow];
+    int numReady = 0;
+    Flow *f;
+
+    flowLock->Acquire();
+    if (hdr->to == FlowProbe) {
+	if (mine) {
+	    f = FindFlow(receiving, &numReceiving, hdr->origin, hdr->from);
+	    grant = f->grant = Grant(f);
+	}
+    } else if (mine) {
+	f = FindFlow(sending, &numSending, hdr->origin, hdr->from);
+	if ((signed char) (hdr->grant - f->grant) > 0) {
+	    Mail *next;
+
+	    f->grant = hdr->grant;
+	    while ((next = (Mail *) f->held->Remove()) != NULL) {
+		if ((signed char) (f->grant - next->mailHdr.seq) <= 0) {
+		    f->held->Prepend((void *)next);	// not yet
+		    break;
+		}
+		ready[numReady++] = next;
+		f->numHeld--;
+	    }
+	    if (f->waiting > 0)
+		credited->Broadcast(flowLock);
+	}
+    }
+    if (hdr->to >= 0) {
+	f = FindFlow(receiving, &numReceiving, hdr->origin, hdr->to);
+	if ((signed char) (hdr->seq - f->seq) >= 0)
+	    f->seq = hdr->seq + 1;
+	f->queued++;
+    }
+    flowLock->Release();
+
+    for (int i = 0; i < numReady; i++)
+	Dispatch(ready[i]);
+    if ((hdr->to == FlowProbe) && mine) {
+	DEBUG('n', "Asked for credits for mailbox %d by %d\n", hdr->from,
+	      hdr->origin);
+	SendControl(hdr->origin, FlowCredit, hdr->from, grant);
+    }
+    return (hdr->to >= 0);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SendControl
+// 	Send a message with no data to machine "to": a FlowCredit, giving
+//	it "grant" for our mailbox "box", or a FlowProbe, asking it for
+//	the credits of its mailbox "box".  Neither needs credits itself.
+//----------------------------------------------------------------------
+
+void
+PostOffice::SendControl(NetworkAddress to, MailBoxAddress kind,
+			MailBoxAddress box, unsigned char grant)
 {
     PacketHeader pktHdr;
     MailHeader mailHdr;
-    char *buffer = new char[MaxPacketSize];
+
+    pktHdr.to = to;
+    pktHdr.length = sizeof(MailHeader);
+    mailHdr.to = kind;
+    mailHdr.from = box;
+    mailHdr.length = 0;
+    mailHdr.seq = 0;
+    mailHdr.grant = grant;
+    mailHdr.dest = to;
+    mailHdr.origin = netAddr;
+    Dispatch(new Mail(pktHdr, mailHdr, NULL));
+}
+
+//----------------------------------------------------------------------
+// PostOffice::StartProbing
+// 	A message is being held for credits: make sure the alarm is set,
+//	so that if they don't come, we ask for them again.
+//----------------------------------------------------------------------
+
+void
+PostOffice::StartProbing()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);	// the alarm
+							// shares "probing"
+    if (!probing) {
+	probing = TRUE;
+	alarmClock->Set(&probeAlarm, stats->totalTicks + FlowProbeTicks,
+			FlowProbeDue, (_int) this);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::ProbeDue
+// 	Called by the alarm, FlowProbeTicks after a message was held for
+//	credits: wake up the thread that asks for them.
+//----------------------------------------------------------------------
+
+void
+PostOffice::ProbeDue()
+{
+    probing = FALSE;
+    probeDue->V();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Probe
+// 	The thread asking for overdue credits: each time the alarm goes
+//	off, send a FlowProbe for every flow with messages still held
+//	for credits, and set the alarm again if there are any.
+//----------------------------------------------------------------------
+
+void
+PostOffice::Probe()
+{
+    Flow stalled[MaxFlows];
+    int numStalled;
 
     for (;;) {
-        // first, wait for a message
-        messageAvailable->P();	
-        pktHdr = network->Receive(buffer);
+	probeDue->P();
+	numStalled = 0;
+	flowLock->Acquire();
+	for (int i = 0; i < numSending; i++)
+	    if (sending[i].numHeld > 0)
+		stalled[numStalled++] = sending[i];
+	if (numStalled > 0)
+	    StartProbing();
+	flowLock->Release();
+
+	for (int i = 0; i < numStalled; i++) {
+	    DEBUG('n', "Asking %d for credits for mailbox %d\n",
+		  stalled[i].machine, stalled[i].box);
+	    SendControl(stalled[i].machine, FlowProbe, stalled[i].box, 0);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// PostOffice::AddRoute
+// 	Add an entry to the routing table, or change the one for "dest".
+//
+//	"dest" -- the machine the route is to
+//	"iface" -- the interface to send messages for it on
+//	"gateway" -- the machine on that interface's network to send them
+//		to ("dest" itself, if it is on that network)
+//----------------------------------------------------------------------
+
+void
+PostOffice::AddRoute(NetworkAddress dest, int iface, NetworkAddress gateway)
+{
+    int i;
+
+    ASSERT((iface >= 0) && (iface < numInterfaces));
+    for (i = 0; i < numRoutes; i++)
+	if (routes[i].dest == dest)
+	    break;
+    if (i == numRoutes) {
+	ASSERT(numRoutes < MaxRoutes);
+	numRoutes++;
+    }
+    routes[i].dest = dest;
+    routes[i].iface = iface;
+    routes[i].gateway = gateway;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::IsLocal
+// 	Return TRUE if "addr" is the address of one of our interfaces.
+//----------------------------------------------------------------------
+
+bool
+PostOffice::IsLocal(NetworkAddress addr)
+{
+    for (int i = 0; i < numInterfaces; i++)
+	if (interfaces[i]->Address() == addr)
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Dispatch
+// 	Queue a message on the interface the routing table gives for its
+//	destination, addressing the packet to the next machine on the way
+//	there.  The interface now owns "mail".
+//----------------------------------------------------------------------
+
+void
+PostOffice::Dispatch(Mail *mail)
+{
+    NetworkInterface *iface = interfaces[0];	// if there's no route
+    NetworkAddress gateway = mail->mailHdr.dest;
 
-        mailHdr = *(MailHeader *)buffer;
-        if (DebugIsEnabled('n')) {
-	    printf("Putting mail into mailbox: ");
-	    PrintHeader(pktHdr, mailHdr);
-        }
+    for (int i = 0; i < numRoutes; i++)
+	if (routes[i].dest == mail->mailHdr.dest) {
+	    iface = interfaces[routes[i].iface];
+	    gateway = routes[i].gateway;
+	    break;
+	}
+    mail->pktHdr.to = gateway;
+    mail->pktHdr.from = iface->Address();
+    iface->Queue(mail);
+}
 
-	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
+//----------------------------------------------------------------------
+// PostOffice::Arrived
+// 	Called by an interface's postal worker for each message that
+//	arrives on it.  If it is for us, put it in its mailbox, with the
+//	PacketHeader saying where it really came from (not just the last
+//	gateway).  Otherwise, we are a gateway: send it on.
+//----------------------------------------------------------------------
 
-	// put into mailbox
-        boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+void
+PostOffice::Arrived(Mail *mail)
+{
+    if (IsLocal(mail->mailHdr.dest)) {
+	mail->pktHdr.from = mail->mailHdr.origin;
+	mail->pktHdr.to = mail->mailHdr.dest;
+	if ((window > 0) && !TakeCredits(mail)) {
+	    delete mail;
+	    return;
+	}
+	Deliver(mail);
+    } else {
+	DEBUG('n', "Forwarding mail from %d for %d\n",
+	      mail->mailHdr.origin, mail->mailHdr.dest);
+	Dispatch(mail);
     }
 }
 
+//----------------------------------------------------------------------
+// PostOffice::Deliver
+// 	Check that a message that has arrived is legal, and put it into
+//	its mailbox, which then owns it.
+//----------------------------------------------------------------------
+
+void
+PostOffice::Deliver(Mail *mail)
+{
+    if (DebugIsEnabled('n')) {
+	printf("Putting mail into mailbox: ");
+	PrintHeader(mail->pktHdr, mail->mailHdr);
+    }
+
+    // check that arriving message is legal!
+    ASSERT(0 <= mail->mailHdr.to && mail->mailHdr.to < numBoxes);
+    ASSERT(mail->mailHdr.length <= MaxMailSize);
+
+    // put into mailbox
+    boxes[mail->mailHdr.to].Put(mail);
+}
+
 //----------------------------------------------------------------------
 // PostOffice::Send
-// 	Concatenate the MailHeader to the front of the data, and pass 
-//	the result to the Network for delivery to the destination machine.
+// 	Concatenate the MailHeader to the front of the data, and queue
+//	the result for the Network to deliver to the destination machine
+//	-- directly, or through gateways, as the routing table says.
+//	Returns at once, unless the queue is full, or, with flow control,
+//	a window of messages for the box it is going to is already held
+//	for credits.  It carries back the credits of the box it is from,
+//	for the machine it is going to.
 //
 //	Note that the MailHeader + data looks just like normal payload
 //	data to the Network.
@@ -264,9 +1210,6 @@ PostOffice::PostalDelivery()
 void
 PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
 {
-    char* buffer = new char[MaxPacketSize];	// space to hold concatenated
-						// mailHdr + data
-
     if (DebugIsEnabled('n')) {
 	printf("Post send: ");
 	PrintHeader(pktHdr, mailHdr);
@@ -274,27 +1217,52 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
     ASSERT(mailHdr.length <= MaxMailSize);
     ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
     
-    // fill in pktHdr, for the Network layer
-    pktHdr.from = netAddr;
+    // fill in the end-to-end addresses, and the length for the
+    // Network layer (Dispatch does the rest of pktHdr)
+    mailHdr.dest = pktHdr.to;
+    mailHdr.origin = netAddr;
     pktHdr.length = mailHdr.length + sizeof(MailHeader);
 
-    // concatenate MailHeader and data
-#ifdef HOST_ALPHA
-    bcopy((const char *)&mailHdr, buffer, sizeof(MailHeader));
-#else
-    bcopy(&mailHdr, buffer, sizeof(MailHeader));
-#endif
-    bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
+    if (window == 0) {
+	// concatenate MailHeader and data
+	Dispatch(new Mail(pktHdr, mailHdr, data));
+	return;
+    }
 
-    sendLock->Acquire();   		// only one message can be sent
-					// to the network at any one time
-    network->Send(pktHdr, buffer);
-    messageSent->P();			// wait for interrupt to tell us
-					// ok to send the next message
-    sendLock->Release();
+    // give back the credits of the box it is from, and take one for
+    // the box it is going to -- or, if there are none, hold it until
+    // there are, waiting if a window of messages is held already
+    Flow *f, *back;
+    Mail *mail;
+    bool held;
 
-    delete [] buffer;			// we've sent the message, so
-					// we can delete our buffer
+    flowLock->Acquire();
+    f = FindFlow(sending, &numSending, pktHdr.to, mailHdr.to);
+    while (f->numHeld >= window) {
+	DEBUG('n', "Waiting for credits for mailbox %d of %d\n",
+	      mailHdr.to, pktHdr.to);
+	f->waiting++;
+	credited->Wait(flowLock);
+	f->waiting--;
+    }
+    mailHdr.seq = f->seq++;
+    mailHdr.grant = 0;
+    if ((mailHdr.from >= 0) && (mailHdr.from < numBoxes)) {
+	back = FindFlow(receiving, &numReceiving, pktHdr.to, mailHdr.from);
+	mailHdr.grant = back->grant = Grant(back);
+    }
+    mail = new Mail(pktHdr, mailHdr, data);
+    held = (f->numHeld > 0) || ((signed char) (f->grant - mailHdr.seq) <= 0);
+    if (held) {
+	DEBUG('n', "Holding mail for mailbox %d of %d for credits\n",
+	      mailHdr.to, pktHdr.to);
+	f->held->Append((void *)mail);
+	f->numHeld++;
+	StartProbing();
+    }
+    flowLock->Release();
+    if (!held)
+	Dispatch(mail);
 }
 
 //----------------------------------------------------------------------
@@ -323,31 +1291,277 @@ PostOffice::Receive(int box, PacketHeader *pktHdr,
 }
 
 //----------------------------------------------------------------------
-// PostOffice::IncomingPacket
-// 	Interrupt handler, called when a packet arrives from the network.
+// PostOffice::ReceiveMail
+// 	Retrieve a message from a specific box, as Receive does, but
+//	without copying it out: the caller gets the message itself, just
+//	as it came off the network, and must give it back with ReleaseMail
+//	once done with it.
 //
-//	Signal the PostalDelivery routine that it is time to get to work!
+//	"box" -- mailbox ID in which to look for message
+//----------------------------------------------------------------------
+
+Mail *
+PostOffice::ReceiveMail(int box)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+
+    return boxes[box].Take();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::PollMail
+// 	Retrieve a message from a specific box, as ReceiveMail does, if
+//	there is one; return NULL, without waiting, if there is not.
+//
+//	"box" -- mailbox ID in which to look for message
+//----------------------------------------------------------------------
+
+Mail *
+PostOffice::PollMail(int box)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+
+    return boxes[box].Poll();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Watch
+// 	Tell "set" of every message put in "box" (see MailSet), or, if
+//	"set" is NULL, stop.
 //----------------------------------------------------------------------
 
 void
-PostOffice::IncomingPacket()
-{ 
-    messageAvailable->V(); 
+PostOffice::Watch(int box, MailSet *set)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+
+    boxes[box].Watch(set);
 }
 
 //----------------------------------------------------------------------
-// PostOffice::PacketSent
-// 	Interrupt handler, called when the next packet can be put onto the 
-//	network.
+// PostOffice::MapRings
+// 	Put the messages for "box" straight into rings in a user program's
+//	memory, from physical page "frame" on (see MailBox::MapRings).
+//	Returns FALSE if the box is not one of ours, or cannot be mapped.
+//----------------------------------------------------------------------
+
+bool
+PostOffice::MapRings(int box, int frame)
+{
+    if ((box < 0) || (box >= numBoxes))
+	return FALSE;
+    return boxes[box].MapRings(frame);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Doorbell
+// 	Ring the doorbell of "box", whose rings are mapped: send what the
+//	program has put in its transmit ring, and return how many messages
+//	are in its receive ring -- if "wait", waiting until there is one.
+//----------------------------------------------------------------------
+
+int
+PostOffice::Doorbell(int box, bool wait)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+
+    return boxes[box].Doorbell(wait);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SendLarge
+// 	Send a message of any size, as a series of fragments of at most
+//	MaxFragmentData bytes, each with a FragmentHeader saying where it
+//	goes.  The receiver must use ReceiveLarge.  Even an empty message
+//	is sent as one fragment.
 //
-//	The name of this routine is a misnomer; if "reliability < 1",
-//	the packet could have been dropped by the network, so it won't get
-//	through.
+//	"pktHdr" -- source, destination machine ID's
+//	"mailHdr" -- source, destination mailbox ID's (the length is
+//		filled in for each fragment)
+//	"data" -- the message
+//	"size" -- how long it is
 //----------------------------------------------------------------------
 
-void 
-PostOffice::PacketSent()
-{ 
-    messageSent->V();
+void
+PostOffice::SendLarge(PacketHeader pktHdr, MailHeader mailHdr, char *data,
+		      int size)
+{
+    char buffer[MaxMailSize];
+    FragmentHeader fragHdr;
+    int offset = 0;
+
+    fragHdr.message = nextMessage++;
+    fragHdr.total = size;
+    do {
+	int chunk = min(size - offset, (int) MaxFragmentData);
+
+	fragHdr.offset = offset;
+	bcopy((char *) &fragHdr, buffer, sizeof(FragmentHeader));
+	bcopy(data + offset, buffer + sizeof(FragmentHeader), chunk);
+	mailHdr.length = sizeof(FragmentHeader) + chunk;
+	Send(pktHdr, mailHdr, buffer);
+	offset += chunk;
+    } while (offset < size);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::ReceiveLarge
+// 	Retrieve a message sent by SendLarge from a specific box, waiting
+//	for all of its fragments, and return its size.  The fragments are
+//	copied straight into "data" (see MailBox::GetLarge).
+//
+//	"box" -- mailbox ID in which to look for message
+//	"pktHdr" -- address to put: source, destination machine ID's
+//	"mailHdr" -- address to put: source, destination mailbox ID's
+//	"data" -- address to put: the message
+//	"maxSize" -- the largest message that fits there
+//----------------------------------------------------------------------
+
+int
+PostOffice::ReceiveLarge(int box, PacketHeader *pktHdr, MailHeader *mailHdr,
+			 char *data, int maxSize)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+
+    return boxes[box].GetLarge(pktHdr, mailHdr, data, maxSize);
+}
+
+//----------------------------------------------------------------------
+// MailSet::MailSet
+// 	Initialize an empty set of mailboxes, to wait on all at once.
+//
+//	"office" -- the post office whose boxes they are
+//----------------------------------------------------------------------
+
+MailSet::MailSet(PostOffice *office)
+{
+    po = office;
+    numBoxes = 0;
+    next = 0;
+    lock = new Lock("mail set lock");
+    arrived = new Condition("mail set arrived");
+    pending = FALSE;
+}
+
+//----------------------------------------------------------------------
+// MailSet::~MailSet
+// 	Stop watching the boxes in the set, and de-allocate it.
+//----------------------------------------------------------------------
+
+MailSet::~MailSet()
+{
+    while (numBoxes > 0)
+	Remove(boxes[0]);
+    delete lock;
+    delete arrived;
+}
+
+//----------------------------------------------------------------------
+// MailSet::Add
+// 	Add "box" to the set.  Messages already in it count, as well as
+//	those that come later.
+//----------------------------------------------------------------------
+
+void
+MailSet::Add(int box)
+{
+    ASSERT(numBoxes < MaxSetBoxes);
+    boxes[numBoxes++] = box;
+    po->Watch(box, this);
+    Notify();				// it may have mail already
+}
+
+//----------------------------------------------------------------------
+// MailSet::Remove
+// 	Take "box" out of the set.  Its messages are left in it.
+//----------------------------------------------------------------------
+
+void
+MailSet::Remove(int box)
+{
+    int i;
+
+    for (i = 0; boxes[i] != box; i++)
+	ASSERT(i + 1 < numBoxes);	// it must be in the set
+    po->Watch(box, NULL);
+    boxes[i] = boxes[--numBoxes];
+    next = 0;
+}
+
+//----------------------------------------------------------------------
+// MailSet::Notify
+// 	Called by MailBox::Put when a message arrives in one of the boxes
+//	of the set: wake up whoever is waiting in Take.
+//----------------------------------------------------------------------
+
+void
+MailSet::Notify()
+{
+    lock->Acquire();
+    pending = TRUE;
+    arrived->Broadcast(lock);
+    lock->Release();
 }
 
+//----------------------------------------------------------------------
+// MailSet::Take
+// 	Wait for a message in any box of the set, and return it; the
+//	caller gives it back with ReleaseMail.  The boxes are looked at in
+//	turn, starting after the one the last message came from, so that
+//	a busy box cannot starve the others.
+//
+//	"pending" is cleared before looking, so that a message put in a
+//	box we have already looked at is never slept through.
+//
+//	"box" -- address to put: which box the message was in
+//----------------------------------------------------------------------
+
+Mail *
+MailSet::Take(int *box)
+{
+    Mail *mail;
+
+    ASSERT(numBoxes > 0);
+    for (;;) {
+	lock->Acquire();
+	pending = FALSE;
+	lock->Release();
+
+	for (int i = 0; i < numBoxes; i++) {
+	    int b = boxes[(next + i) % numBoxes];
+
+	    if ((mail = po->PollMail(b)) != NULL) {
+		next = (next + i + 1) % numBoxes;
+		*box = b;
+		return mail;
+	    }
+	}
+
+	lock->Acquire();
+	while (!pending)
+	    arrived->Wait(lock);
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// MailSet::Get
+// 	Wait for a message in any box of the set, as Take does, and copy
+//	it out, as PostOffice::Receive does.
+//
+//	"box" -- address to put: which box the message was in
+//	"pktHdr", "mailHdr", "data" -- as for PostOffice::Receive
+//----------------------------------------------------------------------
+
+void
+MailSet::Get(int *box, PacketHeader *pktHdr, MailHeader *mailHdr,
+	     char *data)
+{
+    Mail *mail = Take(box);
+
+    *pktHdr = mail->pktHdr;
+    *mailHdr = mail->mailHdr;
+    ASSERT(mailHdr->length <= MaxMailSize);
+    bcopy(mail->data, data, mail->mailHdr.length);
+    po->ReleaseMail(mail);
+}
@@ -19,6 +19,37 @@
 //	to which you can send an acknowledgement, if your protocol requires 
 //	this.
 //
+//	Messages bigger than a packet can be sent with SendLarge, which
+//	splits them into fragments, and received with ReceiveLarge, which
+//	puts them back together in the caller's buffer.
+//
+//	A thread can wait on several mailboxes at once, with a MailSet:
+//	a message put in any box of the set wakes it up, so one server
+//	thread can take messages from many boxes, rather than needing a
+//	thread for each.
+//
+//	A user program can have a box's messages put straight into its
+//	own memory, in rings, rather than asking for each one with a
+//	system call (see netring.h).
+//
+//	A machine can have several network interfaces, each with its own
+//	address.  Messages go out on the interface given for their
+//	destination by the routing table, perhaps by way of a gateway;
+//	a machine that gets messages for some other machine sends them
+//	on, the same way.  The return address is always the machine the
+//	message came from in the first place.
+//
+//	With flow control on, each machine may have only a window of
+//	messages waiting in each mailbox of another's: it has that many
+//	credits for the box, and spends one on each message it sends
+//	there.  The receiver gives them back as the messages are taken
+//	out of the box, in the header of any message it sends the other
+//	way, or in a message of its own once half a window is owed; a
+//	sender with none left holds on to its messages until they come,
+//	and, with a window of them held, waits.  So a fast sender cannot
+//	fill up a slow receiver's memory.  Both ends must use the same
+//	window.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -29,7 +60,9 @@
 #define POST_H
 
 #include "network.h"
-#include "synchlist.h"
+#include "list.h"
+#include "synch.h"
+#include "alarm.h"
 
 // Mailbox address -- uniquely identifies a mailbox on a given machine.
 // A mailbox is just a place for temporary storage for messages.
@@ -43,8 +76,16 @@ class MailHeader {
   public:
     MailBoxAddress to;		// Destination mail box
     MailBoxAddress from;	// Mail box to reply to
-    unsigned length;		// Bytes of message data (excluding the 
+    unsigned short length;	// Bytes of message data (excluding the 
 				// mail header)
+    unsigned char seq;		// With flow control, the number of the
+				// message, among those sent to its box
+    unsigned char grant;	// ... and how far the receiver may go in
+				// numbering those it sends to "from"
+    NetworkAddress dest;	// Machine the message is for, which may
+				// be beyond the packet's destination
+    NetworkAddress origin;	// Machine that sent it in the first place
+				// (both filled in by PostOffice::Send)
 };
 
 // Maximum "payload" -- real data -- that can included in a single message
@@ -52,24 +93,50 @@ class MailHeader {
 
 #define MaxMailSize 	(MaxPacketSize - sizeof(MailHeader))
 
+// A message bigger than that is sent by SendLarge as a series of
+// fragments, each a message of its own, with this header in front of
+// its part of the data.  ReceiveLarge puts them back together.
+
+class FragmentHeader {
+  public:
+    int message;		// Which message of the sender's it is from
+    unsigned offset;		// Where its data goes in the message
+    unsigned total;		// How long the whole message is
+};
+
+#define MaxFragmentData	(MaxMailSize - sizeof(FragmentHeader))
+
 
 // The following class defines the format of an incoming/outgoing 
 // "Mail" message.  The message format is layered: 
 //	network header (PacketHeader) 
 //	post office header (MailHeader) 
 //	data
+//
+// The MailHeader and the data are laid out just as they are in a packet,
+// so that an incoming packet can be received straight into a Mail.
+// Mail comes from a pool of its own rather than from the host's heap
+// (see post.cc).
 
 class Mail {
   public:
+     Mail() {}			// Empty, for a packet to be received into
      Mail(PacketHeader pktH, MailHeader mailH, char *msgData);
 				// Initialize a mail message by
 				// concatenating the headers to the data
+     static void *operator new(size_t size);	// take one from the pool
+     static void operator delete(void *ptr);	// put it back
 
      PacketHeader pktHdr;	// Header appended by Network
      MailHeader mailHdr;	// Header appended by PostOffice
      char data[MaxMailSize];	// Payload -- message data
+     Mail *next;		// Next in the pool, while not in use
 };
 
+class MailSet;
+class PostOffice;
+class UserRings;
+
 // The following class defines a single mailbox, or temporary storage
 // for messages.   Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, and these messages can then be retrieved by
@@ -80,14 +147,136 @@ class MailBox {
     MailBox();			// Allocate and initialize mail box
     ~MailBox();			// De-allocate mail box
 
-    void Put(PacketHeader pktHdr, MailHeader mailHdr, char *data);
-   				// Atomically put a message into the mailbox
+    void Put(Mail *mail);	// Atomically put a message into the mailbox
+    Mail *Take();		// Atomically take the next message out of
+				// the mailbox, waiting if there is none;
+				// the caller must delete it
     void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data); 
    				// Atomically get a message out of the 
 				// mailbox (and wait if there is no message 
 				// to get!)
+    int GetLarge(PacketHeader *pktHdr, MailHeader *mailHdr, char *data,
+		 int maxSize);	// Wait for all the fragments of a message
+				// sent by SendLarge, and return its size
+    Mail *Poll();		// Take the next message, if there is one;
+				// NULL if not (never waits)
+    void Watch(MailSet *set);	// Tell "set" of each message put in the
+				// box, from now on (NULL to stop)
+    void SetOwner(PostOffice *po, MailBoxAddress box)
+	{ owner = po; number = box; }	// Whose box it is, and which
+    bool MapRings(int frame);	// Put messages straight into rings in a
+				// user program's memory from now on
+    int Doorbell(bool wait);	// Send what is in the transmit ring; wait
+				// for something in the receive ring
+  private:
+    PostOffice *owner;		// Told of each message taken out, to
+    MailBoxAddress number;	// give back its credit
+    List *messages;		// A mailbox is just a list of arrived messages
+    Lock *lock;			// Protects it, and what follows
+    Condition *arrived;		// Signalled when a message arrives, or a
+				// large one is complete
+
+    char *posted;		// Where GetLarge wants a message put,
+    int postedSize;		// NULL if it isn't waiting for one
+    bool complete;		// Is it all there?
+    int message;		// Which message it is; -1 if no fragment
+				// of one has arrived yet
+    PacketHeader fragPktHdr;	// Who it is from
+    MailHeader fragMailHdr;
+    unsigned received;		// Bytes of it we have
+    MailSet *watcher;		// The set the box is in, if any
+    UserRings *rings;		// Its rings in user memory, if mapped
+
+    void Reassemble(PacketHeader pktHdr, MailHeader mailHdr, char *data);
+				// Put a fragment where it goes
+    bool Refill();		// Move waiting messages into the rings;
+				// TRUE if there are none left
+};
+
+#define TxQueueSize	16	// messages that can wait to be sent
+#define MaxInterfaces	4	// network interfaces on one machine
+#define MaxRoutes	16	// entries in a routing table
+#define MaxFlows	32	// flows a post office keeps credits for,
+				// each way
+#define MaxFlowWindow	127	// the largest window (seq and grant are
+				// compared modulo 256)
+#define FlowProbeTicks	(20 * NetworkTime)
+				// how long a sender waits for credits
+				// before asking for them again
+#define FlowCredit	-1	// the "to" box of a message that only
+				// gives back credits, for its "from" box
+#define FlowProbe	-2	// ... and of one asking for them
+
+// The following class defines the credits of a flow: the messages one
+// machine sends to one mailbox of another.  The sender keeps one for
+// each box it sends to, and the receiver one for each machine sending
+// to each of its boxes.
+
+class Flow {
+  public:
+    NetworkAddress machine;	// The other end
+    MailBoxAddress box;		// The mailbox the messages go to
+    unsigned char seq;		// Sender: the number of the next one;
+				// receiver: one past the highest arrived
+    unsigned char grant;	// Sender: it may send those numbered
+				// below this; receiver: the last it sent
+    List *held;			// Sender: messages waiting for credits,
+    int numHeld;		// in order, and how many
+    int waiting;		// Sender: threads waiting for room there
+    int queued;			// Receiver: its messages in the box
+};
+
+// The following class defines one of a post office's network interfaces:
+// a network device, the queue of messages waiting to go out on it, and
+// a thread of its own to take in the messages that arrive on it.
+
+class NetworkInterface {
+  public:
+    NetworkInterface(PostOffice *po, NetworkAddress addr, double reliability,
+		     double orderability, int rxRing);
+				// Initialize the device, and start the
+				// thread
+    ~NetworkInterface();
+
+    NetworkAddress Address() { return addr; }
+    Thread *Worker() { return worker; }
+				// The thread that delivers its messages
+    void Queue(Mail *mail);	// Queue a message to go out, waiting if
+				// the queue is full
+
+    void PostalDelivery();	// Wait for incoming messages, and hand
+				// them to the post office
+
+    void PacketSent();		// Interrupt handler, called when outgoing 
+				// packet has been put on network; next 
+				// packet can now be sent
+    void IncomingPacket();	// Interrupt handler, called when incoming
+   				// packets have arrived and can be pulled
+				// off of network (i.e., time to call 
+				// PostalDelivery)
+
   private:
-    SynchList *messages;	// A mailbox is just a list of arrived messages
+    PostOffice *postOffice;	// The post office it belongs to
+    NetworkAddress addr;	// Its address on its network
+    Network *network;		// Physical network connection
+    Semaphore *messageAvailable;// V'ed when message has arrived from network
+    List *outgoing;		// Messages waiting to be sent
+    Semaphore *sendSlots;	// Room left in the outgoing queue
+    bool sending;		// Is a packet on its way out?
+    Thread *worker;		// Runs PostalDelivery
+
+    void StartSending();	// Put the next packet on the network
+};
+
+// The following class defines an entry in a routing table: messages for
+// "dest" go out on interface "iface", to machine "gateway" (which is
+// "dest" itself, if it is on that interface's network).
+
+class Route {
+  public:
+    NetworkAddress dest;
+    int iface;
+    NetworkAddress gateway;
 };
 
 // The following class defines a "Post Office", or a collection of 
@@ -98,45 +287,170 @@ class MailBox {
 //
 // Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, waking up any threads waiting on Receive.
+//
+// Outgoing messages wait in a queue of up to TxQueueSize of them (one
+// per interface), and are put on the network one after another by the
+// interrupt handler for the last one having been sent; Send only waits
+// if the queue is full.  With coalescing on, several small messages for
+// the same machine share one packet.
+//
+// The post office starts with one interface, with the machine's own
+// address; AddInterface adds more.  Messages for a machine with no
+// route go straight to it, on the first interface.
 
 class PostOffice {
   public:
     PostOffice(NetworkAddress addr, double reliability,
-	       double orderability, int nBoxes);
+	       double orderability, int nBoxes, int rxRing = DefaultRxRing);
 				// Allocate and initialize Post Office
 				//   "reliability" is how many packets
 				//   get dropped by the underlying network
+				//   "rxRing" is how many arrived packets
+				//   it can hold
     ~PostOffice();		// De-allocate Post Office data
     
     void Send(PacketHeader pktHdr, MailHeader mailHdr, char *data);
     				// Send a message to a mailbox on a remote 
 				// machine.  The fromBox in the MailHeader is 
 				// the return box for ack's.
+    void SetCoalescing(bool on) { coalesce = on; }
+				// Should small messages share packets?
+    bool Coalescing() { return coalesce; }
+    NetworkAddress Address() { return netAddr; }
+				// This machine's address
+    int NumBoxes() { return numBoxes; }
+    double Reliability() { return netReliability; }
+				// Chance that a packet gets through
+    bool SetRealTime(int period, int deadline, int budget);
+				// Make the threads that deliver incoming
+				// messages real-time (see scheduler.h)
+    void SetFlowControl(int credits);
+				// Let each machine have at most "credits"
+				// messages waiting in each of the boxes
+				// of another
+
+    int AddInterface(NetworkAddress addr);
+				// Add a network interface, with its own
+				// address; return its number
+    void AddRoute(NetworkAddress dest, int iface, NetworkAddress gateway);
+				// Send messages for "dest" via "gateway"
+				// on interface "iface"
     
     void Receive(int box, PacketHeader *pktHdr, 
 		MailHeader *mailHdr, char *data);
     				// Retrieve a message from "box".  Wait if
 				// there is no message in the box.
 
-    void PostalDelivery();	// Wait for incoming messages, 
-				// and then put them in the correct mailbox
+    void SendLarge(PacketHeader pktHdr, MailHeader mailHdr, char *data,
+		   int size);	// Send "size" bytes, which may be more
+				// than MaxMailSize, in fragments
+    int ReceiveLarge(int box, PacketHeader *pktHdr, MailHeader *mailHdr,
+		     char *data, int maxSize);
+				// Retrieve a message sent by SendLarge,
+				// of up to "maxSize" bytes, from "box";
+				// return its size
+    Mail *ReceiveMail(int box);	// Retrieve a message from "box" without
+				// copying it: the caller reads it in
+				// place, and then gives it back
+    Mail *PollMail(int box);	// ReceiveMail, but NULL at once if "box"
+				// is empty
+    void Watch(int box, MailSet *set);
+				// Tell "set" of messages put in "box"
+    void ReleaseMail(Mail *mail) { delete mail; }
+				// Give back a message from ReceiveMail
+    bool MapRings(int box, int frame);
+				// Deliver the messages for "box" into
+				// rings in user memory, at "frame"
+    int Doorbell(int box, bool wait);
+				// Send the messages in the transmit ring
+				// of "box"; return the number in its
+				// receive ring, if "wait" waiting for one
 
-    void PacketSent();		// Interrupt handler, called when outgoing 
-				// packet has been put on network; next 
-				// packet can now be sent
-    void IncomingPacket();	// Interrupt handler, called when incoming
-   				// packet has arrived and can be pulled
-				// off of network (i.e., time to call 
-				// PostalDelivery)
+    void Arrived(Mail *mail);	// Called by an interface's thread for
+				// each incoming message: put it in the
+				// correct mailbox, or send it on
+    void Consumed(MailBoxAddress box, NetworkAddress from);
+				// Called by a MailBox for each message
+				// taken out of it: give its credit back
+    void Probe();		// The thread asking for credits that are
+				// overdue
+    void ProbeDue();		// Interrupt handler for its alarm
 
   private:
-    Network *network;		// Physical network connection
     NetworkAddress netAddr;	// Network address of this machine
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
     int numBoxes;		// Number of mail boxes
-    Semaphore *messageAvailable;// V'ed when message has arrived from network
-    Semaphore *messageSent;	// V'ed when next message can be sent to network
-    Lock *sendLock;		// Only one outgoing message at a time
+    NetworkInterface *interfaces[MaxInterfaces];
+    int numInterfaces;		// Network connections
+    double netReliability;	// How to set up each one's network
+    double netOrderability;
+    int netRxRing;
+    Route routes[MaxRoutes];	// Routing table
+    int numRoutes;
+    bool coalesce;		// Put several messages in a packet?
+    int nextMessage;		// Number for the next SendLarge
+    int rtPeriod, rtDeadline, rtBudget;
+				// The delivery threads' real-time
+				// parameters (period 0 if they are not)
+    int window;			// Credits per flow; 0 for no flow control
+    Lock *flowLock;		// Protects what follows
+    Condition *credited;	// Signalled when held messages are sent
+    Flow sending[MaxFlows];	// Flows to other machines' boxes
+    int numSending;
+    Flow receiving[MaxFlows];	// Flows to our boxes
+    int numReceiving;
+    Semaphore *probeDue;	// V'ed when senders have waited too long
+    AlarmEntry probeAlarm;	// Set while any are waiting
+    bool probing;		// Is it?
+
+    bool IsLocal(NetworkAddress addr);	// One of our interfaces?
+    void Dispatch(Mail *mail);	// Queue a message on the interface its
+				// route says
+    void Deliver(Mail *mail);	// Put an arrived message in its mailbox
+
+    Flow *FindFlow(Flow *table, int *count, NetworkAddress host,
+		   MailBoxAddress box);	// The flow's entry in "table"
+    unsigned char Grant(Flow *f);	// How far a receiving flow can go
+    bool TakeCredits(Mail *mail);	// Take in an arrived message's
+					// credits; FALSE if that is all
+    void SendControl(NetworkAddress to, MailBoxAddress kind,
+		     MailBoxAddress box, unsigned char grant);
+					// Send a FlowCredit or FlowProbe
+    void StartProbing();		// Set the alarm, if it isn't
+};
+
+// The following class defines a set of mailboxes that a thread can wait
+// on all at once, for a message in any of them.  Each box can be in one
+// set at a time; its messages should all be taken through the set.
+
+#define MaxSetBoxes	16	// mailboxes in one set
+
+class MailSet {
+  public:
+    MailSet(PostOffice *office);	// An empty set, of "office"'s
+					// mailboxes
+    ~MailSet();			// Stop watching its boxes
+
+    void Add(int box);		// Wait on "box" as well
+    void Remove(int box);	// Stop waiting on "box"
+
+    Mail *Take(int *box);	// Wait for a message in any of the boxes,
+				// and return it, and which box it was in;
+				// the caller gives it back with ReleaseMail
+    void Get(int *box, PacketHeader *pktHdr, MailHeader *mailHdr,
+	     char *data);	// Take, copying the message out
+
+    void Notify();		// Called by MailBox::Put for a box in
+				// the set
+
+  private:
+    PostOffice *po;		// Whose boxes they are
+    int boxes[MaxSetBoxes];	// The boxes in the set
+    int numBoxes;
+    int next;			// Where the next look through them starts
+    Lock *lock;			// Protects what follows
+    Condition *arrived;		// Signalled when pending is set
+    bool pending;		// Has a message come since the last look?
 };
 
 #endif
@@ -0,0 +1,554 @@
+// remotefs.cc
+//	Routines for the client and the server ends of remote file access:
+//	the client's cache of blocks, with read-ahead and leases, and the
+//	server's procedures.  See remotefs.h.
+//
+//	The client's lock is held across calls to the server, so a thread
+//	waiting for a block holds up the others; but then they would most
+//	likely be waiting for the same server.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "remotefs.h"
+#include "filesys.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// RemoteFile::RemoteFile
+// 	Initialize a file of the server's, as it was opened by client
+//	"client", with a lease starting now.
+//
+//	"status" -- what the server said about it
+//----------------------------------------------------------------------
+
+RemoteFile::RemoteFile(RemoteFileSystem *client, RemoteStatus *status)
+{
+    fs = client;
+    handle = status->handle;
+    length = status->length;
+    version = status->version;
+    leaseEnd = stats->totalTicks + RemoteLease;
+    seekPosition = 0;
+}
+
+//----------------------------------------------------------------------
+// RemoteFile::~RemoteFile
+// 	Close the file, throwing away its cached blocks.
+//----------------------------------------------------------------------
+
+RemoteFile::~RemoteFile()
+{
+    fs->Close(this);
+}
+
+//----------------------------------------------------------------------
+// RemoteFile::ReadAt, WriteAt, Read, Write, Length
+// 	As for an OpenFile: the client does the work.
+//----------------------------------------------------------------------
+
+int
+RemoteFile::ReadAt(char *into, int numBytes, int position)
+{
+    return fs->ReadAt(this, into, numBytes, position);
+}
+
+int
+RemoteFile::WriteAt(char *from, int numBytes, int position)
+{
+    return fs->WriteAt(this, from, numBytes, position);
+}
+
+int
+RemoteFile::Read(char *into, int numBytes)
+{
+    int result = ReadAt(into, numBytes, seekPosition);
+
+    seekPosition += result;
+    return result;
+}
+
+int
+RemoteFile::Write(char *from, int numBytes)
+{
+    int result = WriteAt(from, numBytes, seekPosition);
+
+    seekPosition += result;
+    return result;
+}
+
+int
+RemoteFile::Length()
+{
+    return fs->Length(this);
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::RemoteFileSystem
+// 	Connect to the file server on machine "server", which must serve
+//	us (with a RemoteFileServer) on the same mailbox, "box".  The
+//	cache starts out empty.
+//----------------------------------------------------------------------
+
+RemoteFileSystem::RemoteFileSystem(NetworkAddress server, MailBoxAddress box)
+{
+    rpc = new RpcClient(server, box, box);
+    lock = new Lock("remote fs lock");
+    for (int i = 0; i < RemoteCacheBlocks; i++) {
+	cache[i].handle = -1;
+	cache[i].call = -1;
+	cache[i].lastUsed = 0;
+    }
+    clock = 1;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Open
+// 	Open file "name" on the server, and start reading it: as many of
+//	its blocks as read-ahead allows -- all of it, if it is small.
+//
+// Returns:
+//	The file, or NULL if the server has no file "name".
+//----------------------------------------------------------------------
+
+RemoteFile *
+RemoteFileSystem::Open(char *name)
+{
+    RemoteStatus status;
+    RemoteFile *file;
+
+    ASSERT(strlen(name) < RemoteMaxName);
+    lock->Acquire();
+    rpc->Call(RemoteOpen, name, strlen(name) + 1, (char *) &status,
+	      sizeof(RemoteStatus));
+    if (status.handle < 0) {
+	lock->Release();
+	return NULL;
+    }
+    file = new RemoteFile(this, &status);
+    ReadAhead(file, 0);
+    lock->Release();
+    return file;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::ReadAt
+// 	Read "numBytes" bytes of "file", starting at "position", into
+//	"into", from the cache.  Blocks not there yet are read from the
+//	server, along with the ones after them (see ReadAhead), so that
+//	by the time a sequential reader gets to them, they are there, or
+//	on their way.
+//
+// Returns:
+//	The bytes read -- fewer than asked for at the end of the file.
+//----------------------------------------------------------------------
+
+int
+RemoteFileSystem::ReadAt(RemoteFile *file, char *into, int numBytes,
+			 int position)
+{
+    int first, last, start, end;
+    RemoteBlock *b;
+
+    lock->Acquire();
+    CheckLease(file);
+    if ((numBytes <= 0) || (position >= file->length)) {
+	lock->Release();
+	return 0;
+    }
+    numBytes = min(numBytes, file->length - position);
+    first = position / RemoteBlockSize;
+    last = (position + numBytes - 1) / RemoteBlockSize;
+
+    ReadAhead(file, first);
+    for (int i = first; i <= last; i++) {
+	if ((b = Lookup(file->handle, i)) == NULL)
+	    b = Fetch(file, i);
+	if (b->call >= 0)
+	    Complete(b);
+	b->lastUsed = clock++;
+	start = max(position, i * RemoteBlockSize);
+	end = min(position + numBytes, i * RemoteBlockSize + b->length);
+	if (end <= start) {		// the file is shorter than we thought
+	    numBytes = start - position;
+	    break;
+	}
+	bcopy(&b->data[start - i * RemoteBlockSize], &into[start - position],
+	      end - start);
+    }
+    lock->Release();
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::WriteAt
+// 	Write "numBytes" bytes from "from" to "file", starting at
+//	"position".  The writes go straight to the server, a block at a
+//	time, and are copied into the blocks of it we have cached as well.
+//	As with an OpenFile, the file does not grow.
+//
+//	A block still being read must come back first, or it would come
+//	back with what was there before.  If the file's version has gone
+//	up by more than our own write, someone else has written to it, so
+//	the cache is thrown away.
+//
+// Returns:
+//	The bytes written.
+//----------------------------------------------------------------------
+
+int
+RemoteFileSystem::WriteAt(RemoteFile *file, char *from, int numBytes,
+			  int position)
+{
+    char *args = new char[sizeof(RemoteRequest) + RemoteBlockSize];
+    RemoteRequest *req = (RemoteRequest *) args;
+    RemoteStatus status;
+    RemoteBlock *b;
+    int done = 0, pos, i, count, offset;
+
+    lock->Acquire();
+    CheckLease(file);
+    if ((numBytes > 0) && (position < file->length))
+	numBytes = min(numBytes, file->length - position);
+    else
+	numBytes = 0;
+
+    while (done < numBytes) {
+	pos = position + done;
+	i = pos / RemoteBlockSize;
+	count = min(numBytes - done, (i + 1) * RemoteBlockSize - pos);
+	if (((b = Lookup(file->handle, i)) != NULL) && (b->call >= 0))
+	    Complete(b);
+
+	req->handle = file->handle;
+	req->position = pos;
+	req->count = count;
+	bcopy(&from[done], &args[sizeof(RemoteRequest)], count);
+	rpc->Call(RemoteWrite, args, sizeof(RemoteRequest) + count,
+		  (char *) &status, sizeof(RemoteStatus));
+
+	if (status.version == file->version + 1) {	// only ours
+	    file->version = status.version;
+	    offset = pos - i * RemoteBlockSize;
+	    if ((b != NULL) && (offset <= b->length)) {
+		bcopy(&from[done], &b->data[offset], status.count);
+		b->length = max(b->length, offset + status.count);
+	    } else if (b != NULL)
+		b->handle = -1;		// it would have a hole in it
+	}
+	Update(file, &status);
+	done += status.count;
+	if (status.count < count)
+	    break;
+    }
+    lock->Release();
+    delete [] args;
+    return done;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Length
+// 	Return how long "file" is, as of the last we heard from the
+//	server -- within a lease.
+//----------------------------------------------------------------------
+
+int
+RemoteFileSystem::Length(RemoteFile *file)
+{
+    int length;
+
+    lock->Acquire();
+    CheckLease(file);
+    length = file->length;
+    lock->Release();
+    return length;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Close
+// 	Throw away the blocks of "file", and close it at the server.
+//----------------------------------------------------------------------
+
+void
+RemoteFileSystem::Close(RemoteFile *file)
+{
+    RemoteRequest req;
+    RemoteStatus status;
+
+    lock->Acquire();
+    Invalidate(file->handle);
+    req.handle = file->handle;
+    req.position = req.count = 0;
+    rpc->Call(RemoteClose, (char *) &req, sizeof(RemoteRequest),
+	      (char *) &status, sizeof(RemoteStatus));
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Lookup
+// 	Return the cached block "block" of the file the server numbers
+//	"handle", whether it has come back from the server yet or not;
+//	NULL if it is not in the cache.
+//----------------------------------------------------------------------
+
+RemoteBlock *
+RemoteFileSystem::Lookup(int handle, int block)
+{
+    for (int i = 0; i < RemoteCacheBlocks; i++)
+	if ((cache[i].handle == handle) && (cache[i].block == block))
+	    return &cache[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Fetch
+// 	Start reading block "block" of "file" into the cache, in place of
+//	the least recently used block, and return where it goes.  The call
+//	is only added to the batch: it is sent when some reader waits, or
+//	on the next Flush.
+//----------------------------------------------------------------------
+
+RemoteBlock *
+RemoteFileSystem::Fetch(RemoteFile *file, int block)
+{
+    RemoteBlock *b = &cache[0];
+    RemoteRequest req;
+
+    for (int i = 1; i < RemoteCacheBlocks; i++)
+	if (cache[i].lastUsed < b->lastUsed)
+	    b = &cache[i];
+    if (b->call >= 0)
+	Complete(b);			// its reply has nowhere else to go
+
+    b->handle = file->handle;
+    b->block = block;
+    b->length = 0;
+    b->lastUsed = clock++;
+    req.handle = file->handle;
+    req.position = block * RemoteBlockSize;
+    req.count = RemoteBlockSize;
+    b->call = rpc->Start(RemoteRead, (char *) &req, sizeof(RemoteRequest));
+    return b;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Complete
+// 	Wait for the block "b" to come back from the server.
+//----------------------------------------------------------------------
+
+void
+RemoteFileSystem::Complete(RemoteBlock *b)
+{
+    ASSERT(b->call >= 0);
+    b->length = rpc->Finish(b->call, b->data, RemoteBlockSize);
+    b->call = -1;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::ReadAhead
+// 	Start reading the RemoteReadAhead blocks of "file" from "block"
+//	on (or as many as there are), those not already in the cache, and
+//	send the calls to the server all at once.
+//----------------------------------------------------------------------
+
+void
+RemoteFileSystem::ReadAhead(RemoteFile *file, int block)
+{
+    int last = min(block + RemoteReadAhead,
+		   divRoundUp(file->length, RemoteBlockSize));
+
+    for (int i = block; i < last; i++)
+	if (Lookup(file->handle, i) == NULL)
+	    (void) Fetch(file, i);
+    rpc->Flush();
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::CheckLease
+// 	If our lease on "file" has run out, ask the server for a new one,
+//	and for the file's version: if it has changed, the cache is out
+//	of date.
+//----------------------------------------------------------------------
+
+void
+RemoteFileSystem::CheckLease(RemoteFile *file)
+{
+    RemoteRequest req;
+    RemoteStatus status;
+
+    if (stats->totalTicks < file->leaseEnd)
+	return;
+    DEBUG('n', "Renewing the lease on remote file %d\n", file->handle);
+    req.handle = file->handle;
+    req.position = req.count = 0;
+    rpc->Call(RemoteRenew, (char *) &req, sizeof(RemoteRequest),
+	      (char *) &status, sizeof(RemoteStatus));
+    Update(file, &status);
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Update
+// 	Take in what the server has just said about "file": a new lease,
+//	and, if its version has changed, a new length, and none of its
+//	blocks cached.
+//----------------------------------------------------------------------
+
+void
+RemoteFileSystem::Update(RemoteFile *file, RemoteStatus *status)
+{
+    if (status->version != file->version) {
+	DEBUG('n', "Remote file %d has changed\n", file->handle);
+	Invalidate(file->handle);
+	file->version = status->version;
+    }
+    file->length = status->length;
+    file->leaseEnd = stats->totalTicks + RemoteLease;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Invalidate
+// 	Throw away the cached blocks of the file the server numbers
+//	"handle", waiting for those still being read.
+//----------------------------------------------------------------------
+
+void
+RemoteFileSystem::Invalidate(int handle)
+{
+    for (int i = 0; i < RemoteCacheBlocks; i++)
+	if (cache[i].handle == handle) {
+	    if (cache[i].call >= 0)
+		Complete(&cache[i]);
+	    cache[i].handle = -1;
+	    cache[i].lastUsed = 0;
+	}
+}
+
+// The server's files, shared by all its clients
+
+class RemoteServerFile {
+  public:
+    char name[RemoteMaxName];
+    OpenFile *file;		// NULL if the entry is free
+    int version;		// Writes to it, so far
+    int users;			// Clients that have it open
+};
+
+static RemoteServerFile serverFiles[RemoteMaxFiles];
+static Lock *serverLock = NULL;	// Protects them
+
+//----------------------------------------------------------------------
+// ServerStatus
+// 	Fill in "status" for the server's file "handle".
+//----------------------------------------------------------------------
+
+static void
+ServerStatus(int handle, RemoteStatus *status)
+{
+    status->handle = handle;
+    status->length = serverFiles[handle].file->Length();
+    status->version = serverFiles[handle].version;
+    status->count = 0;
+}
+
+//----------------------------------------------------------------------
+// RemoteServe
+// 	The file server's procedures (see RpcHandler).  A file open by
+//	several clients at once is opened once, and shared, so that they
+//	all see the same version of it.
+//----------------------------------------------------------------------
+
+static int
+RemoteServe(int proc, char *args, int length, char *result)
+{
+    RemoteRequest *req = (RemoteRequest *) args;
+    RemoteStatus *status = (RemoteStatus *) result;
+    RemoteServerFile *f;
+    int handle, size = sizeof(RemoteStatus);
+
+    serverLock->Acquire();
+    if (proc == RemoteOpen) {
+	args[length] = '\0';		// RpcServer leaves room for it
+	for (handle = 0; handle < RemoteMaxFiles; handle++)
+	    if ((serverFiles[handle].file != NULL)
+		    && !strcmp(serverFiles[handle].name, args))
+		break;
+	if (handle == RemoteMaxFiles) {
+	    OpenFile *file;
+
+	    for (handle = 0; handle < RemoteMaxFiles; handle++)
+		if (serverFiles[handle].file == NULL)
+		    break;
+	    if ((handle == RemoteMaxFiles) || (strlen(args) >= RemoteMaxName)
+		    || ((file = fileSystem->Open(args)) == NULL)) {
+		status->handle = -1;
+		serverLock->Release();
+		return size;
+	    }
+	    f = &serverFiles[handle];
+	    strcpy(f->name, args);
+	    f->file = file;
+	    f->version = 0;
+	    f->users = 0;
+	}
+	serverFiles[handle].users++;
+	ServerStatus(handle, status);
+	serverLock->Release();
+	return size;
+    }
+
+    ASSERT(length >= (int) sizeof(RemoteRequest));
+    handle = req->handle;
+    ASSERT((handle >= 0) && (handle < RemoteMaxFiles));
+    f = &serverFiles[handle];
+    ASSERT(f->file != NULL);
+    switch (proc) {
+      case RemoteRead:
+	ASSERT(req->count <= MaxRpcResult);
+	size = f->file->ReadAt(result, req->count, req->position);
+	break;
+      case RemoteWrite:
+	ASSERT(length == (int) sizeof(RemoteRequest) + req->count);
+	size = f->file->WriteAt(args + sizeof(RemoteRequest), req->count,
+				req->position);
+	if (size > 0)
+	    f->version++;
+	ServerStatus(handle, status);
+	status->count = size;
+	size = sizeof(RemoteStatus);
+	break;
+      case RemoteRenew:
+	ServerStatus(handle, status);
+	break;
+      case RemoteClose:
+	ServerStatus(handle, status);
+	if (--f->users == 0) {
+	    delete f->file;
+	    f->file = NULL;
+	}
+	break;
+      default:
+	ASSERT(FALSE);
+    }
+    serverLock->Release();
+    return size;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileServer::RemoteFileServer
+// 	Serve the files of this machine's file system to "client", which
+//	must connect to us (with a RemoteFileSystem) on mailbox "box".
+//	A server serves one client; a machine can run one for each of
+//	several clients, on different mailboxes.
+//----------------------------------------------------------------------
+
+RemoteFileServer::RemoteFileServer(NetworkAddress client, MailBoxAddress box)
+{
+    if (serverLock == NULL) {
+	serverLock = new Lock("remote fs server lock");
+	for (int i = 0; i < RemoteMaxFiles; i++)
+	    serverFiles[i].file = NULL;
+    }
+    rpc = new RpcServer(client, box, box, RemoteServe);
+}
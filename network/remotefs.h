@@ -0,0 +1,163 @@
+// remotefs.h
+//	Data structures for reading and writing the files of another
+//	machine -- a file server -- so that a machine needs no disk of its
+//	own, using remote procedure calls (see rpc.h).
+//
+//	Fetching each sector with a call of its own would cost a round
+//	trip per sector.  Instead, the client keeps a cache of blocks of
+//	the files it has open, and, when a file is opened or read, asks
+//	for the blocks after the ones it wants, all at once, without
+//	waiting for them (read-ahead): a file read from start to end
+//	streams from the server, in batches of calls, rather than in round
+//	trips.
+//
+//	Cached blocks stay good for as long as the client holds a lease on
+//	the file, RemoteLease ticks from when it last heard from the
+//	server about it.  After that, it asks the server for the file's
+//	version, which goes up with each write; if it has changed, the
+//	cached blocks are thrown away.  So a write by anyone else is seen
+//	within a lease; a client's own writes go straight through to the
+//	server, and into its cache.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef REMOTEFS_H
+#define REMOTEFS_H
+
+#include "rpc.h"
+
+#define RemoteFsBox	2	// the mailbox of each end, by default
+#define RemoteBlockSize	MaxRpcResult	// bytes in a block of the cache
+#define RemoteCacheBlocks 64	// blocks in the client's cache
+#define RemoteReadAhead	(RemoteCacheBlocks / 2)
+				// blocks asked for ahead of a read
+#define RemoteLease	100000	// ticks a lease on a file lasts
+#define RemoteMaxFiles	16	// files open at the server at once
+#define RemoteMaxName	64	// longest file name, with its null
+
+// The procedures of the file server
+
+enum RemoteProc { RemoteOpen, RemoteRead, RemoteWrite, RemoteRenew,
+		  RemoteClose };
+
+// The following class defines the arguments of a call to read, write,
+// renew the lease on, or close a file.  A write's data follows them.
+// (A call to open a file just has its name.)
+
+class RemoteRequest {
+  public:
+    int handle;			// Which file, as the server numbers it
+    int position;		// Where to read or write
+    int count;			// How many bytes
+};
+
+// The following class defines what the server says about a file, in
+// reply to a call to open, write, or renew the lease on it.
+
+class RemoteStatus {
+  public:
+    int handle;			// Its number; -1 if it could not be opened
+    int length;			// How long it is
+    int version;		// Writes to it since the server opened it
+    int count;			// For a write, the bytes written
+};
+
+// The following class defines a block of a file in the client's cache.
+
+class RemoteBlock {
+  public:
+    int handle;			// Whose block it is; -1 if none
+    int block;			// Which one
+    int call;			// The call reading it, if it has not come
+				// back yet; -1 if it has
+    int length;			// Bytes of it there are in the file
+    int lastUsed;		// When it was last used, to find the least
+				// recently used
+    char data[RemoteBlockSize];
+};
+
+class RemoteFileSystem;
+
+// The following class defines a file of the server's, opened by the
+// client.  The client reads and writes it as it would an OpenFile.
+
+class RemoteFile {
+  public:
+    RemoteFile(RemoteFileSystem *fs, RemoteStatus *status);
+				// A file, as opened by the server
+    ~RemoteFile();		// Close it, at the server as well
+
+    int ReadAt(char *into, int numBytes, int position);
+    int WriteAt(char *from, int numBytes, int position);
+    int Read(char *into, int numBytes);
+    int Write(char *from, int numBytes);
+    void Seek(int position) { seekPosition = position; }
+    int Length();
+
+    // Kept up to date by the client, under its lock:
+    int handle;			// The server's number for it
+    int length;			// How long it is
+    int version;		// Its version, when the lease was granted
+    int leaseEnd;		// When the lease runs out, in ticks
+
+  private:
+    RemoteFileSystem *fs;	// The client it was opened by
+    int seekPosition;		// Where Read and Write go from
+};
+
+// The following class defines the client end: the files it opens are
+// on the server, and it keeps the cache of their blocks.
+
+class RemoteFileSystem {
+  public:
+    RemoteFileSystem(NetworkAddress server, MailBoxAddress box = RemoteFsBox);
+				// Connect to the file server on "server",
+				// using "box" at both ends
+
+    RemoteFile *Open(char *name);	// Open a file of the server's;
+					// NULL if there is none
+
+    // Called by RemoteFile:
+    int ReadAt(RemoteFile *file, char *into, int numBytes, int position);
+    int WriteAt(RemoteFile *file, char *from, int numBytes, int position);
+    int Length(RemoteFile *file);
+    void Close(RemoteFile *file);
+
+  private:
+    RpcClient *rpc;		// The calls to the server
+    Lock *lock;			// Protects what follows, and the files
+    RemoteBlock cache[RemoteCacheBlocks];
+    int clock;			// Ticks up at each use of a block
+
+    RemoteBlock *Lookup(int handle, int block);
+				// The cached block, or NULL
+    RemoteBlock *Fetch(RemoteFile *file, int block);
+				// Start reading a block into the cache
+    void Complete(RemoteBlock *b);	// Wait for a block being read
+    void ReadAhead(RemoteFile *file, int block);
+				// Start reading the blocks from "block" on
+    void CheckLease(RemoteFile *file);	// Renew the lease, if it has run
+					// out
+    void Update(RemoteFile *file, RemoteStatus *status);
+				// Take in what the server says about it
+    void Invalidate(int handle);	// Throw away the file's blocks
+};
+
+// The following class defines the server end, for one client.  Its
+// clients all share the files it has open.
+
+class RemoteFileServer {
+  public:
+    RemoteFileServer(NetworkAddress client, MailBoxAddress box = RemoteFsBox);
+				// Serve the files of this machine to
+				// "client", using "box" at both ends
+
+  private:
+    RpcServer *rpc;
+};
+
+#endif // REMOTEFS_H
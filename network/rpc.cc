@@ -0,0 +1,316 @@
+// rpc.cc
+//	Routines for remote procedure calls over a reliable connection,
+//	with many calls outstanding at once, and requests and replies
+//	batched into messages.  See rpc.h.
+//
+//	The client has a thread of its own taking in the replies, and
+//	handing each to the caller waiting for it; the server, one taking
+//	in the requests, and calling the procedures.  The connection keeps
+//	them in order, and sends them again if they are lost, so all we
+//	need on top of it is to say where each one starts, and which call
+//	it is for.
+//
+//	A client thread sending a batch may wait for the connection's
+//	window to open, so the batch has a lock of its own: the thread
+//	taking in replies, which the window opening may depend on, must
+//	never wait for it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "rpc.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// RpcClientDispatch, RpcServerServe
+// 	The bodies of the client's and the server's threads.  Need these
+//	to be C routines, because C++ can't handle pointers to member
+//	functions.
+//----------------------------------------------------------------------
+
+static void
+RpcClientDispatch(_int arg)
+{
+    ((RpcClient *)arg)->Dispatch();
+}
+
+static void
+RpcServerServe(_int arg)
+{
+    ((RpcServer *)arg)->Serve();
+}
+
+//----------------------------------------------------------------------
+// ReceiveFully
+// 	Wait for exactly "size" bytes from "conn", however many pieces
+//	they come in.
+//----------------------------------------------------------------------
+
+static void
+ReceiveFully(Connection *conn, char *into, int size)
+{
+    int done = 0;
+
+    while (done < size)
+	done += conn->Receive(into + done, size - done);
+}
+
+//----------------------------------------------------------------------
+// RpcBatch::RpcBatch
+// 	Initialize an empty batch of requests or replies, to be sent on
+//	"connection".
+//----------------------------------------------------------------------
+
+RpcBatch::RpcBatch(Connection *connection)
+{
+    conn = connection;
+    used = 0;
+}
+
+//----------------------------------------------------------------------
+// RpcBatch::Add
+// 	Add a request or a reply, with its header, to the batch.  If the
+//	batch has no room for it, what is in it is sent first; if it is
+//	too big for any batch, it is sent straight away, on its own.
+//
+//	"call" -- the number of the call
+//	"proc" -- the procedure called, for a request
+//	"data", "length" -- the arguments, or the result
+//----------------------------------------------------------------------
+
+void
+RpcBatch::Add(int call, int proc, char *data, int length)
+{
+    int size = sizeof(RpcHeader) + length;
+    RpcHeader *hdr;
+
+    if (used + size > (int) RpcBatchSize)
+	Flush();
+    if (size > (int) RpcBatchSize) {
+	char *message = new char[size];
+
+	hdr = (RpcHeader *) message;
+	hdr->call = call;
+	hdr->proc = proc;
+	hdr->length = length;
+	bcopy(data, message + sizeof(RpcHeader), length);
+	conn->Send(message, size);
+	delete [] message;
+	return;
+    }
+    hdr = (RpcHeader *) &buffer[used];
+    hdr->call = call;
+    hdr->proc = proc;
+    hdr->length = length;
+    bcopy(data, &buffer[used + sizeof(RpcHeader)], length);
+    used += size;
+}
+
+//----------------------------------------------------------------------
+// RpcBatch::Flush
+// 	Send the requests or replies in the batch, all in one message.
+//----------------------------------------------------------------------
+
+void
+RpcBatch::Flush()
+{
+    if (used == 0)
+	return;
+    DEBUG('n', "RPC: sending a batch of %d bytes\n", used);
+    conn->Send(buffer, used);
+    used = 0;
+}
+
+//----------------------------------------------------------------------
+// RpcClient::RpcClient
+// 	Set up the client end of a connection to a server, and start the
+//	thread that takes in its replies.  The server must be set up the
+//	same way, with the mailboxes swapped.
+//
+//	"server", "serverBox" -- the machine and mailbox of the server
+//	"localBox" -- our mailbox, for its replies
+//	"window" -- how many messages can be in flight at once
+//----------------------------------------------------------------------
+
+RpcClient::RpcClient(NetworkAddress server, MailBoxAddress serverBox,
+		     MailBoxAddress localBox, int window)
+{
+    conn = new Connection(server, serverBox, localBox, window);
+    sendLock = new Lock("rpc send lock");
+    batch = new RpcBatch(conn);
+    lock = new Lock("rpc client lock");
+    replied = new Condition("rpc replied");
+    calls = NULL;
+    nextCall = 0;
+    (new Thread("rpc dispatcher"))->Fork(RpcClientDispatch, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// RpcClient::Call
+// 	Call procedure "proc" of the server, with the arguments "args",
+//	and wait for the result.  Return its length; at most "maxResult"
+//	bytes of it are put in "result".
+//----------------------------------------------------------------------
+
+int
+RpcClient::Call(int proc, char *args, int length, char *result, int maxResult)
+{
+    return Finish(Start(proc, args, length), result, maxResult);
+}
+
+//----------------------------------------------------------------------
+// RpcClient::Start
+// 	Make a call to procedure "proc" of the server, with the arguments
+//	"args", and return without waiting for the result: the request
+//	goes in the batch, to be sent along with others.  Return the
+//	call's number, for Finish.
+//
+//	The call is outstanding before its request can be sent, so its
+//	reply always finds it.
+//----------------------------------------------------------------------
+
+int
+RpcClient::Start(int proc, char *args, int length)
+{
+    RpcCall *c = new RpcCall;
+
+    lock->Acquire();
+    c->call = nextCall++;
+    c->done = FALSE;
+    c->next = calls;
+    calls = c;
+    lock->Release();
+
+    sendLock->Acquire();
+    batch->Add(c->call, proc, args, length);
+    sendLock->Release();
+    return c->call;
+}
+
+//----------------------------------------------------------------------
+// RpcClient::Finish
+// 	Wait for the result of call "call", made by Start, and return its
+//	length; at most "maxResult" bytes of it are put in "result".
+//	Whatever requests are still in the batch are sent first -- the
+//	call's own may be one of them.
+//----------------------------------------------------------------------
+
+int
+RpcClient::Finish(int call, char *result, int maxResult)
+{
+    RpcCall *c, **ptr;
+    int length;
+
+    Flush();
+    lock->Acquire();
+    for (ptr = &calls; (*ptr)->call != call; ptr = &(*ptr)->next)
+	ASSERT((*ptr)->next != NULL);	// it must be outstanding
+    c = *ptr;
+    while (!c->done)
+	replied->Wait(lock);
+    *ptr = c->next;
+    lock->Release();
+
+    length = c->length;
+    bcopy(c->result, result, min(length, maxResult));
+    delete c;
+    return length;
+}
+
+//----------------------------------------------------------------------
+// RpcClient::Flush
+// 	Send the requests in the batch now, rather than waiting for it to
+//	fill up, or for a caller to wait for a reply.
+//----------------------------------------------------------------------
+
+void
+RpcClient::Flush()
+{
+    sendLock->Acquire();
+    batch->Flush();
+    sendLock->Release();
+}
+
+//----------------------------------------------------------------------
+// RpcClient::Dispatch
+// 	The client's thread: take in each reply, and hand it to the call
+//	it is for, waking up whoever is waiting for it.  Replies may come
+//	back in any order.
+//----------------------------------------------------------------------
+
+void
+RpcClient::Dispatch()
+{
+    RpcHeader hdr;
+    char result[MaxRpcResult];
+    RpcCall *c;
+
+    for (;;) {
+	ReceiveFully(conn, (char *) &hdr, sizeof(RpcHeader));
+	ASSERT(hdr.length <= MaxRpcResult);
+	ReceiveFully(conn, result, hdr.length);
+
+	lock->Acquire();
+	for (c = calls; (c != NULL) && (c->call != hdr.call); c = c->next)
+	    ;
+	if (c != NULL) {
+	    bcopy(result, c->result, hdr.length);
+	    c->length = hdr.length;
+	    c->done = TRUE;
+	    replied->Broadcast(lock);
+	}
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// RpcServer::RpcServer
+// 	Set up the server end of a connection to a client, and start the
+//	thread that serves its calls.
+//
+//	"client", "clientBox" -- the machine and mailbox of the client
+//	"localBox" -- our mailbox, for its requests
+//	"procedures" -- the procedures (see RpcHandler)
+//	"window" -- how many messages can be in flight at once
+//----------------------------------------------------------------------
+
+RpcServer::RpcServer(NetworkAddress client, MailBoxAddress clientBox,
+		     MailBoxAddress localBox, RpcHandler procedures, int window)
+{
+    conn = new Connection(client, clientBox, localBox, window);
+    handler = procedures;
+    batch = new RpcBatch(conn);
+    (new Thread("rpc server"))->Fork(RpcServerServe, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// RpcServer::Serve
+// 	The server's thread: take in each request, in order, call the
+//	procedure, and put its result in the batch of replies.  The batch
+//	is sent when there are no more requests to hand -- so a batch of
+//	requests gets a batch of replies -- or when it fills up.
+//----------------------------------------------------------------------
+
+void
+RpcServer::Serve()
+{
+    RpcHeader hdr;
+    char result[MaxRpcResult];
+    char *args;
+    int length;
+
+    for (;;) {
+	ReceiveFully(conn, (char *) &hdr, sizeof(RpcHeader));
+	args = new char[hdr.length + 1];
+	ReceiveFully(conn, args, hdr.length);
+	length = (*handler)(hdr.proc, args, hdr.length, result);
+	ASSERT((length >= 0) && (length <= MaxRpcResult));
+	delete [] args;
+
+	batch->Add(hdr.call, hdr.proc, result, length);
+	if (!conn->HasData())
+	    batch->Flush();		// nothing more to answer yet
+    }
+}
@@ -0,0 +1,138 @@
+// rpc.h
+//	Data structures for remote procedure calls between two machines,
+//	on top of a reliable connection (see transport.h).
+//
+//	A call is a request -- a procedure number and its arguments --
+//	and a reply, its result, each tagged with the number of the call,
+//	so that a client need not wait for the reply to one call before
+//	making the next: many calls can be outstanding at once, from one
+//	thread or several, and each reply goes to the thread waiting for
+//	it, whatever order they come back in.  A round trip per call then
+//	becomes a round trip for a whole batch of them.
+//
+//	Small requests are not sent one at a time either, but gathered
+//	into a batch, sent as one message (one packet) when it is full,
+//	or when some caller waits for a reply to a request in it.  The
+//	server batches its replies the same way, until it has no more
+//	requests to hand.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef RPC_H
+#define RPC_H
+
+#include "transport.h"
+#include "synch.h"
+
+// The following class defines the header in front of each request and
+// each reply, in the byte stream of the connection.
+
+class RpcHeader {
+  public:
+    int call;			// Which call it is (the client's number)
+    int proc;			// The procedure called (for a request)
+    unsigned length;		// Bytes of arguments, or of result, after
+				// the header
+};
+
+#define RpcBatchSize	MaxSegmentData	// bytes of requests or replies
+					// sent as one message
+#define MaxRpcResult	1024	// the biggest result a procedure returns
+
+// A procedure, as the server calls it: given the arguments of a call to
+// procedure "proc", it puts the result in "result" (which has room for
+// MaxRpcResult bytes), and returns its length.
+
+typedef int (*RpcHandler)(int proc, char *args, int length, char *result);
+
+// The following class defines a call that has been made, and whose
+// reply the client is waiting for.
+
+class RpcCall {
+  public:
+    int call;			// Its number
+    bool done;			// Has the reply arrived?
+    int length;			// How long the result is
+    char result[MaxRpcResult];	// The result, once it has
+    RpcCall *next;		// The next outstanding call
+};
+
+// The following class defines the batch of requests or replies waiting
+// to be sent, and sends it.
+
+class RpcBatch {
+  public:
+    RpcBatch(Connection *connection);	// An empty batch, for
+						// "connection"
+
+    void Add(int call, int proc, char *data, int length);
+				// Add a request or reply to it, sending
+				// the batch first if it has no room
+    void Flush();		// Send what is in it, if anything
+
+  private:
+    Connection *conn;
+    char buffer[RpcBatchSize];
+    int used;			// Bytes of it in use
+};
+
+// The following class defines the client end of a connection: calls to
+// the procedures of the server at the other end.  Each machine can be a
+// client of several servers, with a mailbox for each.
+
+class RpcClient {
+  public:
+    RpcClient(NetworkAddress server, MailBoxAddress serverBox,
+	      MailBoxAddress localBox, int window = DefaultWindow);
+				// Connect to the server at mailbox
+				// "serverBox" on machine "server"
+
+    int Call(int proc, char *args, int length, char *result, int maxResult);
+				// Call procedure "proc" and wait for its
+				// result; return its length
+    int Start(int proc, char *args, int length);
+				// Make a call, without waiting; return its
+				// number, to wait for it with Finish
+    int Finish(int call, char *result, int maxResult);
+				// Wait for call "call", and return the
+				// length of its result
+    void Flush();		// Send the batch of requests now
+
+    void Dispatch();		// The thread taking in replies
+
+  private:
+    Connection *conn;
+    Lock *sendLock;		// Protects the batch (and is held while
+    RpcBatch *batch;		// it is sent): requests not sent yet
+    Lock *lock;			// Protects what follows, which the
+				// replies change
+    Condition *replied;		// Signalled when replies arrive
+    RpcCall *calls;		// The calls not finished yet
+    int nextCall;		// The number for the next one
+};
+
+// The following class defines the server end of a connection: it takes
+// in requests, calls the procedures, and sends back their results, in
+// a thread of its own.
+
+class RpcServer {
+  public:
+    RpcServer(NetworkAddress client, MailBoxAddress clientBox,
+	      MailBoxAddress localBox, RpcHandler procedures,
+	      int window = DefaultWindow);
+				// Serve calls from mailbox "clientBox"
+				// on machine "client"
+
+    void Serve();		// The thread serving requests
+
+  private:
+    Connection *conn;
+    RpcHandler handler;		// What to call, for each request
+    RpcBatch *batch;		// Replies not sent yet
+};
+
+#endif // RPC_H
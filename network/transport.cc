@@ -0,0 +1,347 @@
+// transport.cc
+//	Routines for a reliable, in-order byte stream on top of the post
+//	office, with a sliding window, cumulative acks, a retransmit timer
+//	and fast retransmit.  See transport.h.
+//
+//	Incoming messages are handled by a thread of the connection's own,
+//	which waits on its mailbox.  The retransmit timer is an interrupt
+//	scheduled with Interrupt::Schedule; since a segment can't be sent
+//	from an interrupt handler (PostOffice::Send takes a lock), the
+//	handler just wakes up the connection's retransmit thread.
+//
+//	Scheduled interrupts can't be called off, so restarting the timer
+//	simply moves timerDue on, and an interrupt that finds the timer
+//	stopped, or not yet due, does nothing.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "transport.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// ConnectionDeliver, ConnectionRetransmit, ConnectionTimer
+// 	The bodies of a connection's threads, and the timer interrupt
+//	handler.  Need these to be C routines, because C++ can't handle
+//	pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+ConnectionDeliver(_int arg)
+{
+    ((Connection *)arg)->Deliver();
+}
+
+static void
+ConnectionRetransmit(_int arg)
+{
+    ((Connection *)arg)->Retransmit();
+}
+
+static void
+ConnectionTimer(_int arg)
+{
+    ((Connection *)arg)->TimerExpired();
+}
+
+//----------------------------------------------------------------------
+// Connection::Connection
+// 	Set up our end of a connection, and start its threads.  The other
+//	end must be set up the same way, with the mailboxes swapped.
+//
+//	The retransmit timer allows for a whole window of segments to go
+//	out ahead of an ack, and for the ack to come back.
+//
+//	"toAddr", "toBox" -- the machine and mailbox of the other end
+//	"fromBox" -- our mailbox, for its messages to us
+//	"windowSize" -- how many segments can be in flight at once
+//----------------------------------------------------------------------
+
+Connection::Connection(NetworkAddress toAddr, MailBoxAddress toBox,
+		       MailBoxAddress fromBox, int windowSize)
+{
+    farAddr = toAddr;
+    farBox = toBox;
+    localBox = fromBox;
+    window = windowSize;
+    ASSERT(window > 0);
+    retransmitTime = 2 * (window + 2) * NetworkTime;
+
+    lock = new Lock("connection lock");
+    windowOpen = new Condition("connection window open");
+    dataArrived = new Condition("connection data arrived");
+    allAcked = new Condition("connection all acked");
+
+    sendBase = nextSeq = 0;
+    sendData = new char[window * MaxSegmentData];
+    sendLength = new int[window];
+    dupAcks = 0;
+    timerOn = FALSE;
+    timerDue = 0;
+    timeout = new Semaphore("connection timeout", 0);
+
+    readSeq = readOffset = recvNext = 0;
+    recvData = new char[window * MaxSegmentData];
+    recvLength = new int[window];
+    recvValid = new bool[window];
+    for (int i = 0; i < window; i++)
+	recvValid[i] = FALSE;
+
+    (new Thread("connection receiver"))->Fork(ConnectionDeliver, (_int) this);
+    (new Thread("connection retransmitter"))->Fork(ConnectionRetransmit,
+						    (_int) this);
+}
+
+//----------------------------------------------------------------------
+// Connection::Send
+// 	Send "size" bytes to the other end, a segment at a time.  Each
+//	segment is sent at once if the window has room for it; otherwise
+//	we wait for an ack to make room.  Returns once all the data has
+//	been sent (at least once), but not necessarily acknowledged --
+//	Flush waits for that.
+//
+//	"data" -- the bytes to send
+//	"size" -- how many of them
+//----------------------------------------------------------------------
+
+void
+Connection::Send(char *data, int size)
+{
+    lock->Acquire();
+    while (size > 0) {
+	int chunk = min(size, (int) MaxSegmentData);
+	int seq;
+
+	while (nextSeq - sendBase >= window)
+	    windowOpen->Wait(lock);
+	seq = nextSeq++;
+	bcopy(data, &sendData[(seq % window) * MaxSegmentData], chunk);
+	sendLength[seq % window] = chunk;
+	Transmit(seq);
+	if (!timerOn)
+	    StartTimer();
+	data += chunk;
+	size -= chunk;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Connection::Receive
+// 	Wait until there is data from the other end we haven't returned
+//	yet, and return as much of it, in order, as fits in "size" bytes.
+//	Returns how many bytes were returned.
+//
+//	"into" -- where to put the data
+//	"size" -- the most to return
+//----------------------------------------------------------------------
+
+int
+Connection::Receive(char *into, int size)
+{
+    int done = 0;
+
+    lock->Acquire();
+    while (readSeq == recvNext)
+	dataArrived->Wait(lock);
+    while ((done < size) && (readSeq < recvNext)) {
+	int slot = readSeq % window;
+	int chunk = min(size - done, recvLength[slot] - readOffset);
+
+	bcopy(&recvData[slot * MaxSegmentData + readOffset], into + done,
+	      chunk);
+	done += chunk;
+	readOffset += chunk;
+	if (readOffset == recvLength[slot]) {	// on to the next segment
+	    recvValid[slot] = FALSE;
+	    readSeq++;
+	    readOffset = 0;
+	}
+    }
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// Connection::HasData
+// 	Return TRUE if there is data from the other end that Receive
+//	hasn't returned yet, so it wouldn't wait.
+//----------------------------------------------------------------------
+
+bool
+Connection::HasData()
+{
+    bool ready;
+
+    lock->Acquire();
+    ready = (bool)(readSeq < recvNext);
+    lock->Release();
+    return ready;
+}
+
+//----------------------------------------------------------------------
+// Connection::Flush
+// 	Wait until the other end has acknowledged everything we sent.
+//----------------------------------------------------------------------
+
+void
+Connection::Flush()
+{
+    lock->Acquire();
+    while (sendBase < nextSeq)
+	allAcked->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Connection::Deliver
+// 	The connection's receiving thread: wait for each message from the
+//	other end, and handle both halves of it.
+//
+//	The ack: if it acknowledges new segments, they leave the window,
+//	and the timer restarts (if any are still in flight).  A bare ack
+//	for the oldest segment again means later segments are getting
+//	through without it; the DupAckThreshold'th time, it is sent again
+//	without waiting for the timer.
+//
+//	The data: a segment that fits in the window is kept, and the
+//	segments now in order are made available to Receive.  Every
+//	segment with data is acked, even one we already have (the ack for
+//	it may have been lost), or one that doesn't fit, which happens if
+//	the window is full of data Receive hasn't returned yet.
+//----------------------------------------------------------------------
+
+void
+Connection::Deliver()
+{
+    for (;;) {
+	Mail *mail = postOffice->ReceiveMail(localBox);
+	SegmentHeader *segHdr = (SegmentHeader *) mail->data;
+	char *data = mail->data + sizeof(SegmentHeader);
+
+	lock->Acquire();
+
+	if (segHdr->ack > sendBase) {
+	    sendBase = min(segHdr->ack, nextSeq);
+	    dupAcks = 0;
+	    if (sendBase == nextSeq) {
+		timerOn = FALSE;
+		allAcked->Broadcast(lock);
+	    } else
+		StartTimer();
+	    windowOpen->Broadcast(lock);
+	} else if ((segHdr->length == 0) && (segHdr->ack == sendBase)
+		   && (sendBase < nextSeq)) {
+	    if (++dupAcks == DupAckThreshold) {
+		DEBUG('n', "Fast retransmit of segment %d\n", sendBase);
+		Transmit(sendBase);
+		StartTimer();
+	    }
+	}
+
+	if (segHdr->length > 0) {
+	    int slot = segHdr->seq % window;
+
+	    if ((segHdr->seq >= recvNext) && (segHdr->seq < readSeq + window)
+		&& !recvValid[slot]) {
+		bcopy(data, &recvData[slot * MaxSegmentData], segHdr->length);
+		recvLength[slot] = segHdr->length;
+		recvValid[slot] = TRUE;
+		while ((recvNext < readSeq + window)
+		       && recvValid[recvNext % window])
+		    recvNext++;
+		dataArrived->Broadcast(lock);
+	    }
+	    Transmit(-1);
+	}
+	lock->Release();
+	postOffice->ReleaseMail(mail);
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::Retransmit
+// 	The connection's retransmit thread: each time the timer goes off
+//	with segments still in flight, send the oldest of them again (the
+//	receiver keeps any later ones that got through), and restart the
+//	timer.
+//----------------------------------------------------------------------
+
+void
+Connection::Retransmit()
+{
+    for (;;) {
+	timeout->P();
+	lock->Acquire();
+	if (timerOn && (stats->totalTicks >= timerDue)
+	    && (sendBase < nextSeq)) {
+	    DEBUG('n', "Timeout, retransmitting segment %d\n", sendBase);
+	    Transmit(sendBase);
+	    StartTimer();
+	}
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::TimerExpired
+// 	Interrupt handler for the retransmit timer: if the timer has
+//	really gone off (it may have been restarted, or stopped, since
+//	this interrupt was scheduled), wake up the retransmit thread.
+//----------------------------------------------------------------------
+
+void
+Connection::TimerExpired()
+{
+    if (timerOn && (stats->totalTicks >= timerDue))
+	timeout->V();
+}
+
+//----------------------------------------------------------------------
+// Connection::StartTimer
+// 	Start the retransmit timer, or restart it if it is running.
+//----------------------------------------------------------------------
+
+void
+Connection::StartTimer()
+{
+    timerOn = TRUE;
+    timerDue = stats->totalTicks + retransmitTime;
+    interrupt->Schedule(ConnectionTimer, (_int) this, retransmitTime,
+			NetworkSendInt);
+}
+
+//----------------------------------------------------------------------
+// Connection::Transmit
+// 	Send segment "seq" (which must be in flight) to the other end,
+//	or just an ack if "seq" is -1.  Either way, the message says which
+//	segment we expect next.
+//----------------------------------------------------------------------
+
+void
+Connection::Transmit(int seq)
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    char buffer[MaxMailSize];
+    SegmentHeader *segHdr = (SegmentHeader *) buffer;
+
+    segHdr->seq = seq;
+    segHdr->ack = recvNext;
+    segHdr->length = 0;
+    if (seq >= 0) {
+	int slot = seq % window;
+
+	ASSERT((seq >= sendBase) && (seq < nextSeq));
+	segHdr->length = sendLength[slot];
+	bcopy(&sendData[slot * MaxSegmentData], buffer + sizeof(SegmentHeader),
+	      segHdr->length);
+    }
+    pktHdr.to = farAddr;
+    mailHdr.to = farBox;
+    mailHdr.from = localBox;
+    mailHdr.length = sizeof(SegmentHeader) + segHdr->length;
+    postOffice->Send(pktHdr, mailHdr, buffer);
+}
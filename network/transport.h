@@ -0,0 +1,115 @@
+// transport.h
+//	Data structures for a reliable, in-order byte stream between
+//	mailboxes on two machines, on top of the unreliable, unordered
+//	mail of the post office.
+//
+//	The data is cut into segments, one per message, numbered in
+//	order.  The receiver acknowledges them cumulatively: every
+//	message it sends says which segment it expects next, so all the
+//	ones before have arrived.  Segments that arrive out of order are
+//	kept until the gap before them is filled.
+//
+//	Rather than waiting for each segment to be acknowledged before
+//	sending the next (stop-and-wait, one segment per round trip), the
+//	sender keeps up to a window's worth of segments in flight, so a
+//	transfer goes as fast as the window allows, not as slowly as the
+//	latency of the network.  Lost segments are sent again when the
+//	retransmit timer goes off, or as soon as the receiver has
+//	acknowledged the same segment DupAckThreshold times over (fast
+//	retransmit), which means later segments are arriving without it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "post.h"
+#include "synch.h"
+
+// The following class defines the segment header, which goes in front
+// of the data in each message of a connection.
+
+class SegmentHeader {
+  public:
+    int seq;			// Number of this segment (meaningless
+				// if it carries no data)
+    int ack;			// Number of the next segment we expect:
+				// we have all the ones before it
+    unsigned length;		// Bytes of data, 0 for a bare ack
+};
+
+#define MaxSegmentData	(MaxMailSize - sizeof(SegmentHeader))
+#define DefaultWindow	8	// segments in flight, by default
+#define DupAckThreshold	3	// duplicate acks that mean a segment
+				// was lost
+
+// The following class defines one end of a connection.  Each end
+// sends to the other's mailbox, and receives in its own; nothing else
+// may use that mailbox.  Both ends must use the same window.
+//
+// A connection lasts as long as Nachos does: it has a thread taking
+// messages out of its mailbox, and another for the retransmit timer.
+
+class Connection {
+  public:
+    Connection(NetworkAddress farAddr, MailBoxAddress farBox,
+	       MailBoxAddress localBox, int window = DefaultWindow);
+				// Set up our end of a connection to
+				// mailbox "farBox" on machine "farAddr"
+
+    void Send(char *data, int size);
+				// Queue "size" bytes to be sent, waiting
+				// while the window is full
+    int Receive(char *into, int size);
+				// Wait for data, and return up to "size"
+				// bytes of it, in order; return how many
+    void Flush();		// Wait until everything sent has been
+				// acknowledged
+    bool HasData();		// Would Receive return without waiting?
+
+    void Deliver();		// The receiving thread: handle incoming
+				// messages
+    void Retransmit();		// The retransmit thread
+    void TimerExpired();	// Interrupt handler for the retransmit
+				// timer
+
+  private:
+    NetworkAddress farAddr;	// Where the other end is
+    MailBoxAddress farBox;
+    MailBoxAddress localBox;	// Where we receive
+    int window;			// Most segments in flight
+    int retransmitTime;		// Ticks to wait for an ack
+
+    Lock *lock;			// Protects all of what follows
+    Condition *windowOpen;	// Signalled when segments are acked,
+    Condition *dataArrived;	// when data can be received,
+    Condition *allAcked;	// and when nothing is in flight
+
+    int sendBase;		// Oldest segment not acked yet
+    int nextSeq;		// Next segment to send
+    char *sendData;		// The segments in flight, kept to be sent
+    int *sendLength;		// again, by number mod window
+    int dupAcks;		// Times sendBase has been acked again
+
+    bool timerOn;		// Is the retransmit timer running?
+    int timerDue;		// If so, when it goes off
+    Semaphore *timeout;		// V'ed when it does
+
+    int readSeq;		// Next segment for Receive to return
+    int readOffset;		// (and how much of it it has returned)
+    int recvNext;		// Next segment expected: we have all
+				// those from readSeq to here
+    char *recvData;		// Segments received and not yet read,
+    int *recvLength;		// by number mod window
+    bool *recvValid;
+
+    void Transmit(int seq);	// Send segment "seq", or a bare ack if
+				// it is -1
+    void StartTimer();		// (Re)start the retransmit timer
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,29 @@
+/* affinity.c
+ *	Test program for SetAffinity: pin the program to CPU 0, yield a
+ *	few times (so the scheduler has to keep it there), and let it
+ *	run anywhere again.  Run it with -smp, and two or more copies,
+ *	to see the migrations counted in the statistics.
+ *
+ *	Exits with 0 if all went well; -1 if SetAffinity did not return
+ *	what it should have.
+ */
+
+#include "syscall.h"
+
+#define NumYields	10
+
+int
+main()
+{
+    int i;
+
+    if (SetAffinity(1 << 30) != -1)	/* no such CPU */
+	Exit(-1);
+    if (SetAffinity(1) != -1)		/* it could run anywhere */
+	Exit(-1);
+    for (i = 0; i < NumYields; i++)
+	Yield();
+    if (SetAffinity(0) != 1)		/* back to anywhere */
+	Exit(-1);
+    Exit(0);
+}
@@ -0,0 +1,26 @@
+/* consumer.c
+ *	Test program for shared memory: add up the data producer puts in
+ *	the shared segment 0, a buffer at a time, and exit with the sum.
+ */
+
+#include "syscall.h"
+#include "shmbuf.h"
+
+int
+main()
+{
+    ShmBuffer *buf = (ShmBuffer *) ShmAttach(0);
+    int i, sum = 0;
+
+    for (;;) {
+	while (!buf->full && !buf->done)
+	    Yield();
+	if (!buf->full)
+	    break;
+	for (i = 0; i < BufferWords; i++)
+	    sum += buf->data[i];
+	buf->full = 0;
+    }
+    ShmDetach((char *) buf);
+    Exit(sum);
+}
@@ -0,0 +1,21 @@
+/* echo.c
+ *	Test program for Exec's arguments: write them out, one line of
+ *	them, separated by spaces, as echo does.  Start it from the shell,
+ *	say as "../test/echo.noff hello world".
+ */
+
+#include "syscall.h"
+
+int
+main(int argc, char **argv)
+{
+    int i, length;
+
+    for (i = 1; i < argc; i++) {
+	for (length = 0; argv[i][length] != '\0'; length++)
+	    ;
+	Write(argv[i], length, ConsoleOutput);
+	Write((i < argc - 1) ? " " : "\n", 1, ConsoleOutput);
+    }
+    Exit(argc - 1);
+}
@@ -4,7 +4,7 @@ int
 main()
 {
     int pid;
-    pid = Exec("../test/halt.noff");
+    pid = Exec("../test/halt.noff", (char **) 0);
 
     Halt();
 }
@@ -0,0 +1,33 @@
+/* heap.c
+ *	Test program for Sbrk: grow the heap far more than the program
+ *	uses, touch one word in every few pages of it, and give it back.
+ *	Only the pages touched are ever allocated.
+ *
+ *	Exits with the sum of the words written, read back, if all went
+ *	well; -1 if Sbrk failed.
+ */
+
+#include "syscall.h"
+
+#define HeapSize	(32 * 1024)	/* bytes asked for */
+#define Stride		(4 * 128)	/* touch one word every 4 pages */
+
+int
+main()
+{
+    char *heap = Sbrk(HeapSize);
+    int i, sum = 0;
+
+    if (heap == (char *) -1)
+	Exit(-1);
+    for (i = 0; i < HeapSize; i += Stride) {
+	if (*(int *) (heap + i) != 0)	/* it starts out zero */
+	    Exit(-1);
+	*(int *) (heap + i) = i;
+    }
+    for (i = 0; i < HeapSize; i += Stride)
+	sum += *(int *) (heap + i);
+    if (Sbrk(-HeapSize) != heap + HeapSize)
+	Exit(-1);
+    Exit(sum);
+}
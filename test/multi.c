@@ -0,0 +1,35 @@
+/* multi.c
+ *	Test program to run several programs at once, to see how the
+ *	machine does with a mix of them: Exec each, and wait for them all.
+ *
+ *	At Halt, Nachos prints the turnaround and page faults of every
+ *	program, and the makespan of them all (see -frames and -rp, to
+ *	vary the memory they share and how it is replaced).
+ *
+ *	sort and halt end by calling Halt, which stops the whole machine,
+ *	so they go last: whatever is still running then is reported so.
+ */
+
+#include "syscall.h"
+
+#define NumPrograms	4
+
+char *programs[NumPrograms] = {
+    "../test/matmult.noff",
+    "../test/matmult.noff",
+    "../test/matmult.noff",
+    "../test/sort.noff"
+};
+
+int
+main()
+{
+    SpaceId ids[NumPrograms];
+    int i;
+
+    for (i = 0; i < NumPrograms; i++)
+	ids[i] = Exec(programs[i], (char **) 0);
+    for (i = 0; i < NumPrograms; i++)
+	Join(ids[i]);
+    Halt();
+}
@@ -0,0 +1,53 @@
+/* pipe.c
+ *	Test program for pipes: a forked child writes a stream of words
+ *	into a pipe, a page at a time, and the parent reads them back
+ *	until the end of the stream, and exits with their sum.
+ *
+ *	The pipe holds less than the stream, so the child has to wait for
+ *	the parent to read, and the parent for the child to write.
+ */
+
+#include "syscall.h"
+
+#define PageWords	32		/* a page, in words */
+#define NumPages	16		/* how much the child writes */
+
+OpenFileId ends[2];
+
+void
+child()
+{
+    int page[PageWords];
+    int i, n;
+
+    Close(ends[0]);
+    for (n = 0; n < NumPages; n++) {
+	for (i = 0; i < PageWords; i++)
+	    page[i] = n * PageWords + i;
+	Write((char *) page, sizeof(page), ends[1]);
+    }
+    Close(ends[1]);		/* the end of the stream */
+    Exit(0);
+}
+
+int
+main()
+{
+    int page[PageWords];
+    int i, numRead, sum = 0, left = 0;
+
+    if (Pipe(ends) < 0)
+	Exit(-1);
+    Fork(child);
+    Close(ends[1]);		/* else we'd never see the end */
+    while ((numRead = Read((char *) page + left, sizeof(page) - left,
+			   ends[0])) > 0) {
+	left += numRead;
+	for (i = 0; i < left / sizeof(int); i++)
+	    sum += page[i];
+	if (left % sizeof(int) != 0)	/* part of a word: keep it */
+	    page[0] = page[left / sizeof(int)];
+	left %= sizeof(int);
+    }
+    Exit(sum);			/* 0 + 1 + ... + 511 = 130816 */
+}
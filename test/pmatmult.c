@@ -0,0 +1,54 @@
+/* pmatmult.c 
+ *    Test program to do matrix multiplication, split between several
+ *    threads in the one address space (see ThreadCreate): each thread
+ *    computes every NumThreads'th row of the result.
+ *
+ *    Compare its run with matmult's: the threads share the matrices,
+ *    and the page table, so only their stacks cost anything extra.
+ */
+
+#include "syscall.h"
+
+#define Dim 	20	/* sum total of the arrays doesn't fit in 
+			 * physical memory 
+			 */
+#define NumThreads	4
+
+int A[Dim][Dim];
+int B[Dim][Dim];
+int C[Dim][Dim];
+
+int numDone;		/* threads that have finished their rows */
+
+void
+Rows(int which)
+{
+    int i, j, k;
+
+    for (i = which; i < Dim; i += NumThreads)
+	for (j = 0; j < Dim; j++)
+            for (k = 0; k < Dim; k++)
+		 C[i][j] += A[i][k] * B[k][j];
+    numDone++;
+}
+
+int
+main()
+{
+    int i, j;
+
+    for (i = 0; i < Dim; i++)		/* first initialize the matrices */
+	for (j = 0; j < Dim; j++) {
+	     A[i][j] = i;
+	     B[i][j] = j;
+	     C[i][j] = 0;
+	}
+
+    for (i = 1; i < NumThreads; i++)	/* then multiply them together */
+	ThreadCreate(Rows, i);
+    Rows(0);
+    while (numDone < NumThreads)
+	Yield();
+
+    Exit(C[Dim-1][Dim-1]);		/* and then we're done */
+}
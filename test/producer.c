@@ -0,0 +1,37 @@
+/* producer.c
+ *	Test program for shared memory: fill a segment with data, for
+ *	consumer (which it Execs) to add up, handing it over a buffer at
+ *	a time, with no Read or Write and no copies in the kernel.
+ *
+ *	The two agree on the segment by its identifier: the producer's is
+ *	the first made, 0.
+ */
+
+#include "syscall.h"
+#include "shmbuf.h"
+
+int
+main()
+{
+    ShmBuffer *buf;
+    SpaceId consumer;
+    int i, n;
+
+    if (ShmCreate(sizeof(ShmBuffer)) != 0)
+	Exit(-1);
+    buf = (ShmBuffer *) ShmAttach(0);
+    consumer = Exec("../test/consumer.noff", (char **) 0);
+
+    for (n = 0; n < NumRounds; n++) {
+	while (buf->full)
+	    Yield();
+	for (i = 0; i < BufferWords; i++)
+	    buf->data[i] = n * BufferWords + i;
+	buf->full = 1;
+    }
+    while (buf->full)
+	Yield();
+    buf->done = 1;
+
+    Exit(Join(consumer));	/* the sum the consumer found */
+}
@@ -0,0 +1,46 @@
+/* ring.c
+ *	Test program for the system call ring: queue a Write of each line
+ *	of a message to the console, do them all with one RingEnter, and
+ *	exit with how many of them wrote the whole line.
+ */
+
+#include "syscall.h"
+
+char *lines[] = {
+    "one trap,\n",
+    "many writes,\n",
+    "one completion each.\n"
+};
+
+#define NumLines	(sizeof(lines) / sizeof(lines[0]))
+
+SyscallRing ring;
+
+int
+main()
+{
+    int i, len, numWritten = 0;
+    RingRequest *req;
+    RingCompletion *done;
+
+    for (i = 0; i < NumLines; i++) {
+	for (len = 0; lines[i][len] != '\0'; len++)
+	    ;
+	req = &ring.req[ring.reqTail % RingEntries];
+	req->op = SC_Write;
+	req->arg1 = (int) lines[i];
+	req->arg2 = len;
+	req->arg3 = ConsoleOutput;
+	req->tag = len;			/* what it should return */
+	ring.reqTail++;
+    }
+    if (RingEnter(&ring) != NumLines)
+	Exit(-1);
+    while (ring.doneHead != ring.doneTail) {
+	done = &ring.done[ring.doneHead % RingEntries];
+	if (done->result == done->tag)
+	    numWritten++;
+	ring.doneHead++;
+    }
+    Exit(numWritten);
+}
@@ -7,7 +7,8 @@ main()
     OpenFileId input = ConsoleInput;
     OpenFileId output = ConsoleOutput;
     char prompt[2], ch, buffer[60];
-    int i;
+    char *argv[10];
+    int i, argc;
 
     prompt[0] = '-';
     prompt[1] = '-';
@@ -16,18 +17,22 @@ main()
     {
 	Write(prompt, 2, output);
 
-	i = 0;
-	
-	do {
-	
-	    Read(&buffer[i], 1, input); 
-
-	} while( buffer[i++] != '\n' );
-
-	buffer[--i] = '\0';
-
-	if( i > 0 ) {
-		newProc = Exec(buffer);
+	i = Read(buffer, sizeof(buffer) - 1, input);	/* a whole line */
+	if( i > 0 && buffer[i - 1] == '\n' )
+	    i--;
+	buffer[i] = '\0';
+
+	/* split the line into words, for the program's argv */
+	argc = 0;
+	for (i = 0; buffer[i] != '\0'; i++)
+	    if (buffer[i] == ' ')
+		buffer[i] = '\0';
+	    else if ((i == 0 || buffer[i - 1] == '\0') && argc < 9)
+		argv[argc++] = &buffer[i];
+	argv[argc] = 0;
+
+	if( argc > 0 ) {
+		newProc = Exec(argv[0], argv);
 		Join(newProc);
 	}
     }
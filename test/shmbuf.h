@@ -0,0 +1,13 @@
+/* shmbuf.h
+ *	The buffer producer and consumer share, in shared memory segment 0.
+ */
+
+#define BufferWords	60	/* words of data in the buffer */
+#define NumRounds	10	/* buffers the producer fills */
+
+typedef struct {
+    int full;			/* set by the producer, cleared by the
+				 * consumer once it has the data */
+    int done;			/* set by the producer after the last */
+    int data[BufferWords];
+} ShmBuffer;
@@ -130,6 +130,138 @@ Yield:
 	j	$31
 	.end Yield
 
+	.globl ReadV
+	.ent	ReadV
+ReadV:
+	addiu $2,$0,SC_ReadV
+	syscall
+	j	$31
+	.end ReadV
+
+	.globl WriteV
+	.ent	WriteV
+WriteV:
+	addiu $2,$0,SC_WriteV
+	syscall
+	j	$31
+	.end WriteV
+
+	.globl Mmap
+	.ent	Mmap
+Mmap:
+	addiu $2,$0,SC_Mmap
+	syscall
+	j	$31
+	.end Mmap
+
+	.globl Munmap
+	.ent	Munmap
+Munmap:
+	addiu $2,$0,SC_Munmap
+	syscall
+	j	$31
+	.end Munmap
+
+	.globl ShmCreate
+	.ent	ShmCreate
+ShmCreate:
+	addiu $2,$0,SC_ShmCreate
+	syscall
+	j	$31
+	.end ShmCreate
+
+	.globl ShmAttach
+	.ent	ShmAttach
+ShmAttach:
+	addiu $2,$0,SC_ShmAttach
+	syscall
+	j	$31
+	.end ShmAttach
+
+	.globl ShmDetach
+	.ent	ShmDetach
+ShmDetach:
+	addiu $2,$0,SC_ShmDetach
+	syscall
+	j	$31
+	.end ShmDetach
+
+	.globl Pipe
+	.ent	Pipe
+Pipe:
+	addiu $2,$0,SC_Pipe
+	syscall
+	j	$31
+	.end Pipe
+
+	.globl RingEnter
+	.ent	RingEnter
+RingEnter:
+	addiu $2,$0,SC_RingEnter
+	syscall
+	j	$31
+	.end RingEnter
+
+	.globl Sbrk
+	.ent	Sbrk
+Sbrk:
+	addiu $2,$0,SC_Sbrk
+	syscall
+	j	$31
+	.end Sbrk
+
+	.globl SetAffinity
+	.ent	SetAffinity
+SetAffinity:
+	addiu $2,$0,SC_SetAffinity
+	syscall
+	j	$31
+	.end SetAffinity
+
+	.globl Memcpy
+	.ent	Memcpy
+Memcpy:
+	addiu $2,$0,SC_Memcpy
+	syscall
+	j	$31
+	.end Memcpy
+
+	.globl Memset
+	.ent	Memset
+Memset:
+	addiu $2,$0,SC_Memset
+	syscall
+	j	$31
+	.end Memset
+
+	.globl NetDoorbell
+	.ent	NetDoorbell
+NetDoorbell:
+	addiu $2,$0,SC_NetDoorbell
+	syscall
+	j	$31
+	.end NetDoorbell
+
+/* ThreadCreate passes the kernel, in r6, where the new thread is to
+ * start: ThreadRoot, which calls func(arg) -- the kernel puts "arg" in
+ * r4 and "func" in r5 -- and then Exit(0).
+ */
+	.globl ThreadCreate
+	.ent	ThreadCreate
+ThreadCreate:
+	la	$6,ThreadRoot
+	addiu $2,$0,SC_ThreadCreate
+	syscall
+	j	$31
+	.end ThreadCreate
+
+	.ent	ThreadRoot
+ThreadRoot:
+	jalr	$5
+	move	$4,$0
+	jal	Exit	 /* if we return from func, exit(0) */
+	.end ThreadRoot
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -0,0 +1,39 @@
+/* vmdrive.c
+ *	Run vmstress with each of its access patterns, one after another
+ *	(so that each has the machine to itself), passing the sizes in
+ *	Exec's argv.  At Halt, the kernel prints each run's turnaround,
+ *	page faults, evictions and writebacks; ../lab7/vmbench.sh runs
+ *	this under each replacement policy, and tabulates them.
+ *
+ *	The array is 64 pages, so run it with fewer frames than that
+ *	(say, -frames 24) for there to be any replacement.
+ *
+ *	Exits with the number of runs that failed.
+ */
+
+#include "syscall.h"
+
+#define NumRuns		5
+
+static char *runs[NumRuns][7] = {
+    { "vmstress", "seq", "64", "4", (char *) 0 },
+    { "vmstress", "stride", "64", "5", "256", (char *) 0 },
+    { "vmstress", "random", "64", "256", (char *) 0 },
+    { "vmstress", "phase", "64", "16", "4", "128", (char *) 0 },
+    { "vmstress", "seq", "64", "4", "0", (char *) 0 },	/* read-only */
+};
+
+int
+main()
+{
+    int i, failed = 0;
+    SpaceId id;
+
+    for (i = 0; i < NumRuns; i++) {
+	id = Exec("../test/vmstress.noff", runs[i]);
+	if (id < 0 || Join(id) != 0)
+	    failed++;
+    }
+    Halt();
+    Exit(failed);			/* not reached */
+}
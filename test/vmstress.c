@@ -0,0 +1,131 @@
+/* vmstress.c
+ *	Stress the pager with a chosen pattern of accesses to an array of
+ *	pages, allocated with Sbrk.  The pattern and its sizes come in
+ *	argv (see vmdrive.c, which Execs it with each in turn):
+ *
+ *	    vmstress seq <pages> <passes> [<write%>]
+ *		scan the array from end to end, "passes" times
+ *	    vmstress stride <pages> <stride> <accesses> [<write%>]
+ *		touch every "stride"-th page, wrapping round
+ *	    vmstress random <pages> <accesses> [<write%>]
+ *		touch pages chosen at random, all equally likely
+ *	    vmstress phase <pages> <set> <phases> <accesses> [<write%>]
+ *		"phases" times over, touch "accesses" random pages of a
+ *		working set of "set" pages; each phase's set follows on
+ *		from the last one's, wrapping round the array
+ *
+ *	Each access is to one word of a page; "write%" of them (by
+ *	default, half) are stores, so that evicted pages are dirty.  The
+ *	random numbers are always the same ones, so a pattern makes the
+ *	same accesses under every replacement policy.
+ *
+ *	Exits with 0 if all went well; -1 if the arguments were bad, or
+ *	Sbrk failed.
+ */
+
+#include "syscall.h"
+
+#define PageSize	128	/* as in ../machine/machine.h */
+
+static unsigned int seed = 1;
+
+/* the next pseudo-random number, from 0 to 32767 */
+static int
+Random()
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+/* the number in "s", or -1 if it isn't one */
+static int
+Number(char *s)
+{
+    int n = 0;
+
+    if (*s == '\0')
+	return -1;
+    for (; *s != '\0'; s++) {
+	if (*s < '0' || *s > '9')
+	    return -1;
+	n = n * 10 + *s - '0';
+    }
+    return n;
+}
+
+static int
+Same(char *a, char *b)
+{
+    while (*a != '\0' && *a == *b) {
+	a++;
+	b++;
+    }
+    return *a == *b;
+}
+
+static char *array;
+static int writePercent = 50;
+
+/* make one access, to a word of page "page" */
+static void
+Touch(int page)
+{
+    int *word = (int *) (array + page * PageSize);
+
+    if (Random() % 100 < writePercent)
+	(*word)++;
+    else if (*word < 0)			/* never: it only counts up */
+	Exit(-1);
+}
+
+int
+main(int argc, char **argv)
+{
+    int pages, n[3], numArgs, i, j, page;
+
+    if (argc < 3)
+	Exit(-1);
+    if (Same(argv[1], "seq") || Same(argv[1], "random"))
+	numArgs = 1;
+    else if (Same(argv[1], "stride"))
+	numArgs = 2;
+    else if (Same(argv[1], "phase"))
+	numArgs = 3;
+    else
+	Exit(-1);
+    if (argc != numArgs + 3 && argc != numArgs + 4)
+	Exit(-1);
+    pages = Number(argv[2]);
+    for (i = 0; i < numArgs; i++)
+	if ((n[i] = Number(argv[3 + i])) < 0)
+	    Exit(-1);
+    if (argc == numArgs + 4)
+	writePercent = Number(argv[numArgs + 3]);
+    if (pages <= 0 || writePercent < 0 || writePercent > 100)
+	Exit(-1);
+
+    array = Sbrk(pages * PageSize);
+    if (array == (char *) -1)
+	Exit(-1);
+
+    if (Same(argv[1], "seq")) {
+	for (i = 0; i < n[0]; i++)
+	    for (page = 0; page < pages; page++)
+		Touch(page);
+    } else if (Same(argv[1], "stride")) {
+	for (i = 0, page = 0; i < n[1]; i++) {
+	    Touch(page);
+	    page = (page + n[0]) % pages;
+	}
+    } else if (Same(argv[1], "random")) {
+	for (i = 0; i < n[0]; i++)
+	    Touch(Random() % pages);
+    } else {
+	if (n[0] <= 0 || n[0] > pages)
+	    Exit(-1);
+	for (i = 0; i < n[1]; i++)
+	    for (j = 0; j < n[2]; j++)
+		Touch((i * n[0] + Random() % n[0]) % pages);
+    }
+    Exit(0);
+}
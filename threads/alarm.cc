@@ -0,0 +1,206 @@
+// alarm.cc
+//	Routines for the alarm clock.  See alarm.h.
+//
+//	Everything here is done with interrupts off: alarms are set and
+//	cancelled by threads, and go off in interrupt handlers.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "alarm.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// AlarmHandler, WakeThread
+// 	Dummy functions because C++ does not allow a pointer to a member
+//	function: the handler of our own interrupt, and the alarm set by
+//	SleepUntil, which puts the sleeping thread back on the ready list.
+//----------------------------------------------------------------------
+
+static void
+AlarmHandler(_int arg)
+{
+    ((Alarm *) arg)->Expired();
+}
+
+static void
+WakeThread(_int arg)
+{
+    scheduler->ReadyToRun((Thread *) arg);
+}
+
+//----------------------------------------------------------------------
+// Alarm::Alarm
+// 	Start with an empty wheel.
+//----------------------------------------------------------------------
+
+Alarm::Alarm()
+{
+    for (int i = 0; i < AlarmSlots; i++)
+	slots[i] = NULL;
+    lastPeriod = stats->totalTicks / AlarmSlotTicks;
+    numSet = 0;
+    wakeupPending = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Alarm::Set
+// 	Arrange for func(arg) to be called, with interrupts off, once the
+//	time is "when": put "entry" on the wheel.  A time that has already
+//	come goes off at the next interrupt.
+//----------------------------------------------------------------------
+
+void
+Alarm::Set(AlarmEntry *entry, int when, VoidFunctionPtr func, _int arg)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int slot;
+
+    when = max(when, stats->totalTicks);
+    slot = (when / AlarmSlotTicks) % AlarmSlots;
+    entry->when = when;
+    entry->func = func;
+    entry->arg = arg;
+    entry->armed = TRUE;
+    entry->next = slots[slot];
+    slots[slot] = entry;
+    numSet++;
+    DEBUG('t', "Alarm set for time %d, slot %d\n", when, slot);
+    Wakeup(when);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Alarm::Cancel
+// 	Take "entry" off the wheel, if it hasn't gone off yet.  Only the
+//	list for its time is looked at.
+//----------------------------------------------------------------------
+
+void
+Alarm::Cancel(AlarmEntry *entry)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (entry->armed) {
+	AlarmEntry **prev = &slots[(entry->when / AlarmSlotTicks) % AlarmSlots];
+
+	while (*prev != entry)
+	    prev = &(*prev)->next;
+	*prev = entry->next;
+	entry->armed = FALSE;
+	numSet--;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Alarm::SleepUntil
+// 	Put the current thread to sleep until the time is "when", on the
+//	wheel instead of the ready list.  Returns at once if it has come.
+//	The alarm is on our stack, which lasts until we are woken.
+//----------------------------------------------------------------------
+
+void
+Alarm::SleepUntil(int when)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    AlarmEntry entry;
+
+    if (when > stats->totalTicks) {
+	Set(&entry, when, WakeThread, (_int) currentThread);
+	currentThread->Sleep();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Alarm::Tick
+// 	Set off every alarm that is due: look at the list of each period
+//	of AlarmSlotTicks since the last Tick, and the current one again
+//	(alarms later in it may have been set since), but not more than
+//	once round the wheel.  Called from the timer interrupt handler.
+//----------------------------------------------------------------------
+
+void
+Alarm::Tick()
+{
+    int now = stats->totalTicks;
+    int period = now / AlarmSlotTicks;
+    int first = max(lastPeriod, period - AlarmSlots + 1);
+
+    if (numSet > 0)
+	for (int p = first; p <= period; p++)
+	    Expire(p % AlarmSlots, now);
+    lastPeriod = period;
+}
+
+//----------------------------------------------------------------------
+// Alarm::Expire
+// 	Set off the alarms on list "slot" that are due by "now", taking
+//	each off the list before calling it, so that it may set another.
+//----------------------------------------------------------------------
+
+void
+Alarm::Expire(int slot, int now)
+{
+    AlarmEntry **prev = &slots[slot];
+
+    while (*prev != NULL) {
+	AlarmEntry *entry = *prev;
+
+	if (entry->when > now) {		// another time round
+	    prev = &entry->next;
+	    continue;
+	}
+	*prev = entry->next;
+	entry->armed = FALSE;
+	numSet--;
+	DEBUG('t', "Alarm for time %d going off at %d\n", entry->when, now);
+	(*entry->func)(entry->arg);
+    }
+}
+
+//----------------------------------------------------------------------
+// Alarm::Wakeup
+// 	Make sure our own interrupt goes off by time "when", scheduling
+//	another if the one pending is for later.  The one for later still
+//	goes off, but finding nothing due, does no harm.
+//----------------------------------------------------------------------
+
+void
+Alarm::Wakeup(int when)
+{
+    if (wakeupPending && (wakeupAt <= when))
+	return;
+    wakeupPending = TRUE;
+    wakeupAt = when;
+    interrupt->Schedule(AlarmHandler, (_int) this,
+			max(when - stats->totalTicks, 1), AlarmInt);
+}
+
+//----------------------------------------------------------------------
+// Alarm::Expired
+// 	Our own interrupt went off: advance the wheel, and if alarms are
+//	still set, schedule the interrupt again, for the first of them.
+//	(That means looking at them all, but only once per interrupt; it
+//	is setting and cancelling alarms that has to be cheap.)
+//----------------------------------------------------------------------
+
+void
+Alarm::Expired()
+{
+    int first = -1;
+
+    if (wakeupPending && (wakeupAt <= stats->totalTicks))
+	wakeupPending = FALSE;
+    Tick();
+    if ((numSet == 0) || wakeupPending)
+	return;
+    for (int i = 0; i < AlarmSlots; i++)
+	for (AlarmEntry *entry = slots[i]; entry != NULL; entry = entry->next)
+	    if ((first < 0) || (entry->when < first))
+		first = entry->when;
+    Wakeup(first);
+}
@@ -0,0 +1,77 @@
+// alarm.h
+//	Data structures for the alarm clock: waking threads up, or doing
+//	anything else, at a given simulated time, rather than having them
+//	spin with Yield until it comes.
+//
+//	Alarms are kept on a hashed timing wheel: a ring of AlarmSlots
+//	lists, each for AlarmSlotTicks of time, an alarm going on the list
+//	for its time, modulo the length of the ring.  Setting an alarm, or
+//	cancelling one, is cheap, however many there are; the timer
+//	interrupt handler advances the wheel (see Tick), only looking at
+//	the lists for the time that has gone by since the last tick.  An
+//	alarm further away than once round the ring just waits on its list
+//	for the wheel to come round again.
+//
+//	The timer alone can't be relied on, though: it is only there with
+//	-rs (or a scheduling policy that needs it), the machine stops when
+//	it is the only interrupt left, and with -tickless it is skipped
+//	while idle.  So an interrupt of our own is also kept scheduled,
+//	for the first alarm due (see Wakeup).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef ALARM_H
+#define ALARM_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define AlarmSlots	64		// lists on the timing wheel
+#define AlarmSlotTicks	TimerTicks	// the time each is for
+
+// An alarm that has been set.  It belongs to whoever set it (it is
+// typically on their stack, while they sleep), and is linked on the
+// wheel until it goes off or is cancelled.
+
+class AlarmEntry {
+  public:
+    int when;				// when it goes off
+    VoidFunctionPtr func;		// what to call then,
+    _int arg;				// and with what
+    bool armed;				// on the wheel?
+    AlarmEntry *next;			// the next alarm on its list
+};
+
+// The following class defines the alarm clock.
+
+class Alarm {
+  public:
+    Alarm();				// no alarms set
+
+    void Set(AlarmEntry *entry, int when, VoidFunctionPtr func, _int arg);
+					// Call func(arg), with interrupts
+					// off, at time "when"
+    void Cancel(AlarmEntry *entry);	// Don't, if it hasn't gone off yet
+    void SleepUntil(int when);		// Put the current thread to sleep
+					// until time "when"
+
+    void Tick();			// Set off the alarms that are due;
+					// called from the timer interrupt
+    void Expired();			// Our own interrupt went off
+
+  private:
+    AlarmEntry *slots[AlarmSlots];	// the wheel
+    int lastPeriod;			// the AlarmSlotTicks period of the
+					// last Tick
+    int numSet;				// alarms on the wheel
+    bool wakeupPending;			// our own interrupt is scheduled,
+    int wakeupAt;			// for this time
+
+    void Expire(int slot, int now);	// set off what is due on a list
+    void Wakeup(int when);		// make sure we are interrupted by
+					// time "when"
+};
+
+#endif // ALARM_H
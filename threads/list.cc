@@ -6,6 +6,11 @@
 //	list; it is de-allocated when the item is removed. This means
 //      we don't need to keep a "next" pointer in every object we
 //      want to put on a list.
+//
+//	To keep that cheap, ListElements are not given back to the host:
+//	a freed one goes on a free list shared by all lists, and new ones
+//	are taken from there, or else carved, ListSlabSize at a time, out
+//	of a bigger allocation.
 // 
 //     	NOTE: Mutual exclusion must be provided by the caller.
 //  	If you want a synchronized list, you must use the routines 
@@ -17,6 +22,62 @@
 
 #include "copyright.h"
 #include "list.h"
+#include "system.h"
+
+#define ListSlabSize	64		// elements allocated from the host
+					// at a time
+
+static ListElement *freeElements = NULL;	// elements not on any list
+
+//----------------------------------------------------------------------
+// ListElement::operator new
+// 	Allocate the storage for a list element: the most recently freed
+//	one, if there is any, so that a list that is only growing and
+//	shrinking keeps reusing the same few elements.  Otherwise we get
+//	a new slab from the host, and put all but one of its elements on
+//	the free list.
+//
+//	No locking is needed, as nothing in here can cause a context
+//	switch.
+//----------------------------------------------------------------------
+
+void *
+ListElement::operator new(size_t size)
+{
+    ListElement *element;
+
+    ASSERT(size == sizeof(ListElement));
+    if (freeElements != NULL) {
+	if (stats != NULL)
+	    stats->numListPoolHits++;
+    } else {
+	ListElement *slab = (ListElement *) new char[ListSlabSize * size];
+
+	for (int i = 0; i < ListSlabSize; i++) {
+	    slab[i].next = freeElements;
+	    freeElements = &slab[i];
+	}
+	if (stats != NULL)
+	    stats->numListPoolMisses++;
+    }
+    element = freeElements;
+    freeElements = element->next;
+    return (void *) element;
+}
+
+//----------------------------------------------------------------------
+// ListElement::operator delete
+// 	Put the storage for a list element on the free list.
+//----------------------------------------------------------------------
+
+void
+ListElement::operator delete(void *ptr)
+{
+    ListElement *element = (ListElement *) ptr;
+
+    element->next = freeElements;
+    freeElements = element;
+}
 
 //----------------------------------------------------------------------
 // ListElement::ListElement
@@ -23,10 +23,16 @@
 //
 // Internal data structures kept public so that List operations can
 // access them directly.
+//
+// ListElements are allocated and freed on every Append and Remove, so
+// they come from a free list of their own rather than straight from
+// the host's heap (see list.cc).
 
 class ListElement {
    public:
      ListElement(void *itemPtr, int sortKey);	// initialize a list element
+     static void *operator new(size_t size);	// take one off the free list
+     static void operator delete(void *ptr);	// put it back
 
      ListElement *next;		// next element on list, 
 				// NULL if this is the last
@@ -8,30 +8,119 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+// Usage: nachos -d <debugflags> -rs <random seed #> -mlfq -stride
+//		-record <file> -replay <file>
+//		-smp <# of CPUs> -numa <nodes> <ticks> -tickless -lockstat -S -trace <file>
+//		-bench <count>
+//		-quantum <ticks> -usertick <ticks> -systick <ticks>
+//		-intcost <ticks> -switchcost <ticks>
+//		-s -dc -bb -jit -bt -hp -tlb <entries> -tlbways <ways> -super
+//		-prof <ticks>
+//		-l1 <size> <line> <ways> <penalty>
+//		-ckpt <ticks> <file> -restore <file> -mem <pages>
+//		-x <nachos file> -c <consoleIn> <consoleOut>
+//		-f -ds <policy> -cache <sectors> -raid <disks> -tracks <n>
+//		-mmap -ssd -lfs
+//		-diskmap <file>
+//		-cp <unix file> <nachos file> -mkdir <nachos directory>
+//		-cpn <nachos file> <nachos file> -clone <nachos file> <nachos file>
+//		-image <manifest>
+//		-p <nachos file> -r <nachos file> -l -ls <nachos directory> -D -t
 //              -n <network reliability> -e <network orderability>
-//              -m <machine id>
+//              -m <machine id> -rx <packets> -coalesce -fc <credits>
+//              -hosts <file>
+//              -edf <period> <deadline> <budget>
+//              -if <machine id> -route <machine id> <interface> <gateway>
 //              -o <other machine id>
 //              -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -record logs the input from the host and the random numbers used
+//	to <file>, and -replay feeds them back from it, so that a run
+//	repeats a recorded one tick for tick (cf. sysdep.cc)
+//    -mlfq schedules threads with a multilevel feedback queue, instead
+//	of round robin
+//    -stride shares the CPU between threads in proportion to their
+//	tickets (with the lab3 scheduler)
+//    -smp simulates that many CPUs, each with its own ready queue
+//    -numa splits the CPUs and memory between <nodes> NUMA nodes, charging
+//	<ticks> more for each user access to another node's memory; idle
+//	CPUs steal from their own node first
+//    -tickless skips timer interrupts while there is nothing to run
+//    -lockstat profiles every lock, semaphore and condition, and prints
+//	those waited for longest at Halt
+//    -S prints the CPU time, context switches and ready-queue wait of
+//	every thread, with the other statistics
+//    -trace records context switches, interrupts, disk requests and
+//	exceptions, and writes them to <file> at Halt, as a Chrome trace
+//    -bench runs the thread system microbenchmarks (cf. synchbench.h),
+//	each thread doing <count> operations, instead of the thread test
+//    -quantum sets the time slice (the ticks between timer interrupts)
+//    -usertick, -systick set the ticks charged per user instruction,
+//	and per re-enabling of interrupts in the kernel
+//    -intcost, -switchcost set the ticks charged for taking an
+//	interrupt, and for a context switch
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -dc caches decoded user instructions instead of decoding every fetch
+//    -bb runs straight-line user code a basic block at a time
+//    -jit also compiles the blocks run most often to host code (implies -bb)
+//    -bt batches tick accounting between pending interrupts
+//    -hp runs the user code of the threads the other CPUs (-smp) would
+//	run next on host threads, alongside the running thread's, up to
+//	the next pending interrupt (needs -bt, and no -tlb, -dc, -bb,
+//	-l1 or -numa; see mipspar.cc)
+//    -tlb runs user programs with a TLB of the given size (0 => page table;
+//	otherwise at least 2, as an instruction can touch two pages)
+//    -tlbways sets the associativity of the TLB (at least 2)
+//    -super lets the TLB map each aligned run of SuperPageSize pages
+//	of a program with one entry (see translate.h)
+//    -prof samples the PC every <ticks> of user time, and prints where
+//	each program spent its time (by procedure, if its NOFF file has
+//	symbols) at Halt
+//    -l1 models L1 instruction and data caches of <size> bytes each, with
+//	<line>-byte lines, <ways>-way associative, charging <penalty>
+//	ticks for each miss, and reports hit rates per address space
+//    -ckpt saves the user program, and the machine, to a host file when
+//	the clock reaches <ticks> (see checkpoint.h)
+//    -restore carries on with the user program saved in a checkpoint
+//    -mem sets the size of physical memory, in pages (default
+//	DefaultPhysPages, see machine.h)
 //    -x runs a user program
 //    -c tests the console
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -ds selects the disk scheduling policy: fifo, sstf, scan or
+//	clook (the default)
+//    -cache sets the number of sectors cached (0 turns the cache off)
+//    -raid stripes the disk across <disks> UNIX files, DISK, DISK.1,
+//	and so on, which work in parallel; use the same number every
+//	time, as it decides which sectors are where
+//    -tracks sets the size of the disk, when formatting it (with -f)
+//    -mmap maps the file holding the disk into memory, rather than
+//	reading and writing it sector by sector
+//    -ssd times the disk as flash (see disk.h), with no seek or
+//	rotation, rather than as a spinning disk
+//    -lfs gives the disk a log-structured layout, when formatting it
+//	(with -f)
+//    -diskmap writes how many times each disk sector was read or
+//	written to <file> at Halt
 //    -cp copies a file from UNIX to Nachos
+//    -image copies every file listed in a UNIX file to Nachos (see
+//	BuildImage in fstest.cc); with -f, to build a disk from scratch
+//    -cpn copies a Nachos file to a new one
+//    -clone makes a new Nachos file sharing the sectors of another, each
+//	copied only when one of the two first writes it
+//    -mkdir makes a Nachos directory
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
+//    -ls lists the contents of a Nachos directory, reading it a sector
+//	at a time
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
 //
@@ -39,7 +128,38 @@
 //    -n sets the network reliability
 //    -e sets the network orderability
 //    -m sets this machine's host id (needed for the network)
+//    -rx sets how many arrived packets the network device can hold
+//    -coalesce lets several small messages to the same machine share
+//	a packet
+//    -fc turns on flow control: a machine may have at most this many
+//	messages waiting in each mailbox of another, and waits to send
+//	more until they are taken out (every machine must use the same)
+//    -hosts reads a host map, giving the IP address and UDP port of
+//	each machine, so that they can be on different host machines
+//    -edf runs the threads delivering incoming messages as real-time
+//	threads, scheduled earliest deadline first: each message must be
+//	delivered within <deadline> ticks, using at most <budget> ticks
+//	of CPU in each <period>
+//    -if adds a network interface, with another machine id, to this
+//	machine (the first, interface 0, has the id given by -m)
+//    -route sends messages for a machine out on an interface, to a
+//	gateway machine (which sends them on)
 //    -o runs a simple test of the Nachos network software
+//    -ot streams data both ways over a reliable connection (the
+//	optional second argument is the window, in segments)
+//    -nb benchmarks the network to another machine: a stream, and
+//	round trips, at several message sizes (run it with -n to see
+//	the cost of losses)
+//    -nbfan benchmarks <n> machines, 1 to n, streaming to machine 0
+//	at once; every machine runs it with the same <n>
+//    -orpc times remote procedure calls to another machine, one at a
+//	time and pipelined (the machine with the lower id makes them)
+//    -osel sends messages to several mailboxes of another machine,
+//	which takes them all with one thread (the one with the higher
+//	id sends)
+//    -rfs serves this machine's files to another machine
+//    -rcat reads a file of another machine's, which is running -rfs
+//	for this one, through its cache, twice
 //
 //  NOTE -- flags are ignored until the relevant assignment.
 //  Some of the flags are interpreted here; some in system.cc.
@@ -54,14 +174,23 @@
 
 #include "utility.h"
 #include "system.h"
+#include "synchbench.h"
+#ifdef NETWORK
+#include "transport.h"
+#endif
 
 
 // External functions used by this file
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
+extern void BuildImage(char *manifest);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
-extern void MailTest(int networkID);
+extern void RestoreProcess(char *file);
+extern void MailTest(int networkID), StreamTest(int networkID, int window);
+extern void NetBench(int networkID), NetBenchFanIn(int numSources);
+extern void RpcTest(int networkID), SelectTest(int networkID);
+extern void RemoteFsServe(int client), RemoteFsTest(int server, char *name);
 extern void SynchTest(void);
 
 //----------------------------------------------------------------------
@@ -88,7 +217,15 @@ main(int argc, char **argv)
     (void) Initialize(argc, argv);
     
 #ifdef THREADS
-    ThreadTest();
+    int benchCount = 0;
+
+    for (int i = 1; i < argc - 1; i++)
+	if (!strcmp(argv[i], "-bench"))
+	    benchCount = atoi(argv[i + 1]);
+    if (benchCount > 0)
+	SynchBench(benchCount);
+    else
+	ThreadTest();
 #if 0
     SynchTest();
 #endif 
@@ -103,6 +240,10 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-restore")) {	// carry on with one
+	    ASSERT(argc > 1);
+            RestoreProcess(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-c")) {      // test the console
 	    if (argc == 1)
 	        ConsoleTest(NULL, NULL);
@@ -121,16 +262,40 @@ main(int argc, char **argv)
 	    ASSERT(argc > 2);
 	    Copy(*(argv + 1), *(argv + 2));
 	    argCount = 3;
+	} else if (!strcmp(*argv, "-image")) {	// copy a list of files
+	    ASSERT(argc > 1);
+	    BuildImage(*(argv + 1));
+	    argCount = 2;
 	} else if (!strcmp(*argv, "-p")) {	// print a Nachos file
 	    ASSERT(argc > 1);
 	    Print(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-cpn")) {	// copy Nachos to Nachos
+	    ASSERT(argc > 2);
+	    if (!fileSystem->CopyFile(*(argv + 1), *(argv + 2)))
+		printf("Could not copy %s to %s\n", *(argv + 1), *(argv + 2));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-clone")) {	// clone a Nachos file
+	    ASSERT(argc > 2);
+	    if (!fileSystem->Clone(*(argv + 1), *(argv + 2)))
+		printf("Could not clone %s as %s\n", *(argv + 1), *(argv + 2));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-mkdir")) {	// make Nachos directory
+	    ASSERT(argc > 1);
+	    if (!fileSystem->MakeDirectory(*(argv + 1)))
+		printf("Could not make directory %s\n", *(argv + 1));
+	    argCount = 2;
 	} else if (!strcmp(*argv, "-r")) {	// remove Nachos file
 	    ASSERT(argc > 1);
 	    fileSystem->Remove(*(argv + 1));
 	    argCount = 2;
 	} else if (!strcmp(*argv, "-l")) {	// list Nachos directory
             fileSystem->List();
+	} else if (!strcmp(*argv, "-ls")) {	// list a Nachos directory
+	    ASSERT(argc > 1);
+	    if (!fileSystem->List(*(argv + 1)))
+		printf("No directory %s\n", *(argv + 1));
+	    argCount = 2;
 	} else if (!strcmp(*argv, "-D")) {	// print entire filesystem
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
@@ -145,6 +310,54 @@ main(int argc, char **argv)
 						// start up another nachos
             MailTest(atoi(*(argv + 1)));
             argCount = 2;
+        } else if (!strcmp(*argv, "-ot")) {
+	    ASSERT(argc > 1);
+            Delay(2); 				// as for -o
+	    if (argc > 2 && **(argv + 2) != '-') {
+		StreamTest(atoi(*(argv + 1)), atoi(*(argv + 2)));
+		argCount = 3;
+	    } else {
+		StreamTest(atoi(*(argv + 1)), DefaultWindow);
+		argCount = 2;
+	    }
+        } else if (!strcmp(*argv, "-nb")) {
+	    ASSERT(argc > 1);
+            Delay(2); 				// as for -o
+	    NetBench(atoi(*(argv + 1)));
+	    argCount = 2;
+        } else if (!strcmp(*argv, "-nbfan")) {
+	    ASSERT(argc > 1);
+            Delay(2); 				// as for -o
+	    NetBenchFanIn(atoi(*(argv + 1)));
+	    argCount = 2;
+        } else if (!strcmp(*argv, "-orpc")) {
+	    ASSERT(argc > 1);
+            Delay(2); 				// as for -o
+	    RpcTest(atoi(*(argv + 1)));
+	    argCount = 2;
+        } else if (!strcmp(*argv, "-osel")) {
+	    ASSERT(argc > 1);
+            Delay(2); 				// as for -o
+	    SelectTest(atoi(*(argv + 1)));
+	    argCount = 2;
+        } else if (!strcmp(*argv, "-rfs")) {
+	    ASSERT(argc > 1);
+	    RemoteFsServe(atoi(*(argv + 1)));
+	    argCount = 2;
+        } else if (!strcmp(*argv, "-rcat")) {
+	    ASSERT(argc > 2);
+            Delay(2); 				// as for -o
+	    RemoteFsTest(atoi(*(argv + 1)), *(argv + 2));
+	    argCount = 3;
+        } else if (!strcmp(*argv, "-if")) {
+	    ASSERT(argc > 1);
+	    (void) postOffice->AddInterface(atoi(*(argv + 1)));
+	    argCount = 2;
+        } else if (!strcmp(*argv, "-route")) {
+	    ASSERT(argc > 3);
+	    postOffice->AddRoute(atoi(*(argv + 1)), atoi(*(argv + 2)),
+				 atoi(*(argv + 3)));
+	    argCount = 4;
         }
 #endif // NETWORK
     }
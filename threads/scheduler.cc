@@ -11,8 +11,11 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	Very simple implementation -- no priorities, straight FIFO --
+//	unless the multilevel feedback queue is asked for (see
+//	scheduler.h), or threads are made real-time, in which case they
+//	are run earliest deadline first, ahead of the rest.  With more than one simulated CPU, each has its own
+//	queues, and idle CPUs steal work from busy ones.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -21,6 +24,7 @@
 #include "copyright.h"
 #include "scheduler.h"
 #include "system.h"
+#include "trace.h"
 
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
@@ -29,7 +33,22 @@
 
 Scheduler::Scheduler()
 { 
-    readyList = new List; 
+    for (int c = 0; c < MaxCPUs; c++) {
+	for (int level = 0; level < NumLevels; level++)
+	    readyList[c][level] = new ThreadQueue; 
+	numReady[c] = 0;
+    }
+    realTimeList = new ThreadQueue;
+    realTimeLoad = 0;
+    numCPUs = 1;
+    numNodes = 1;
+    cpu = 0;
+    policy = FIFOScheduling;
+    sliceStart = lastBoost = 0;
+    runUserTicks = runSystemTicks = 0;
+#ifdef USER_PROGRAM
+    switchedFrom = NULL;
+#endif
 } 
 
 //----------------------------------------------------------------------
@@ -39,13 +58,24 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    for (int c = 0; c < MaxCPUs; c++)
+	for (int level = 0; level < NumLevels; level++)
+	    delete readyList[c][level]; 
+    delete realTimeList;
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
-//	Put it on the ready list, for later scheduling onto the CPU.
+//	Put it on the ready list for its level, for later scheduling onto
+//	the CPU -- the one it last ran on, or the least loaded one if it
+//	has not run yet, or its affinity no longer lets it run there (in
+//	which case it migrates).
+//
+//	A real-time thread goes on the real-time list instead, in order
+//	of deadline; if it is waking up, it starts a new job, due its
+//	deadline after it starts -- which is now, or, if it wakes up
+//	early, when its period is up.
 //
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
@@ -55,13 +85,48 @@ Scheduler::ReadyToRun (Thread *thread)
 {
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
+    RealTime *rt = thread->realTime;
+
+    if (rt != NULL) {
+	if (rt->jobDone) {
+	    int start = max(stats->totalTicks, rt->nextRelease);
+
+	    rt->jobDeadline = start + rt->deadline;
+	    rt->nextRelease = start + rt->period;
+	    rt->budgetLeft = rt->budget;
+	    rt->jobDone = FALSE;
+	    stats->numRealTimeJobs++;
+	}
+	thread->setStatus(READY);
+	thread->readySince = stats->totalTicks;
+	realTimeList->SortedInsert(thread, rt->jobDeadline);
+	return;
+    }
+
+    int c = thread->getCPU();
+
+    if ((c < 0) || (c >= numCPUs) || !MayRunOn(thread, c)) {
+	if ((c >= 0) && (c < numCPUs))
+	    stats->numMigrations++;
+	c = LeastLoaded(thread);
+	thread->setCPU(c);
+    }
     thread->setStatus(READY);
-    readyList->Append((void *)thread);
+    thread->readySince = stats->totalTicks;
+    readyList[c][thread->getLevel()]->Append(thread);
+    numReady[c]++;
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
-// 	Return the next thread to be scheduled onto the CPU.
+// 	Return the next thread to be scheduled onto the CPU: the
+//	real-time thread with the earliest deadline, if any may run
+//	there, and otherwise the first one at the highest level that has
+//	any.  With several CPUs, it is
+//	the next CPU's turn; if its queues are empty, it steals from the
+//	busiest CPU (preferring its own NUMA node's) -- if that has more
+//	than MigrateThreshold threads ready, and one of them may run here.
+//	If not, the busiest CPU runs its own next thread instead.
 //	If there are no ready threads, return NULL.
 // Side effect:
 //	Thread is removed from the ready list.
@@ -70,7 +135,133 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->Remove();
+    Thread *thread;
+    int victim;
+
+    cpu = (cpu + 1) % numCPUs;
+    if ((thread = NextRealTime()) != NULL)
+	return thread;
+    if (numReady[cpu] > 0)
+	return Dequeue(cpu);
+    victim = Busiest();
+    if (numReady[victim] == 0)
+	return NULL;			// no one is ready, anywhere
+    if ((numReady[victim] > MigrateThreshold)
+	    && ((thread = Steal(victim)) != NULL)) {
+	DEBUG('t', "CPU %d steals thread \"%s\" from CPU %d\n", cpu,
+	      thread->getName(), victim);
+	thread->setCPU(cpu);
+	stats->numThreadsStolen++;
+	stats->numMigrations++;
+	return thread;
+    }
+    cpu = victim;			// not worth a migration
+    return Dequeue(victim);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Dequeue
+// 	Take the first thread at the highest level off the queues of
+//	CPU "c", which has at least one ready.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::Dequeue (int c)
+{
+    for (int level = 0; level < NumLevels; level++)
+	if (!readyList[c][level]->IsEmpty()) {
+	    numReady[c]--;
+	    return readyList[c][level]->Remove();
+	}
+    ASSERT(FALSE);
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextRealTime
+// 	Take the real-time thread with the earliest deadline, of those
+//	that may run on "cpu", off the real-time list, and move it to
+//	"cpu".  Return NULL if there is none.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::NextRealTime ()
+{
+    for (Thread *t = realTimeList->First(); t != NULL; t = t->queueNext)
+	if (MayRunOn(t, cpu)) {
+	    realTimeList->Remove(t);
+	    if ((t->getCPU() >= 0) && (t->getCPU() != cpu))
+		stats->numMigrations++;
+	    t->setCPU(cpu);
+	    return t;
+	}
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Steal
+// 	Take the first thread at the highest level off the queues of
+//	CPU "c" that may run on "cpu", the CPU whose turn it is.  Return
+//	NULL if none of them may.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::Steal (int c)
+{
+    for (int level = 0; level < NumLevels; level++)
+	for (Thread *t = readyList[c][level]->First(); t != NULL;
+							t = t->queueNext)
+	    if (MayRunOn(t, cpu)) {
+		readyList[c][level]->Remove(t);
+		numReady[c]--;
+		return t;
+	    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LeastLoaded
+// 	Return the CPU with the fewest threads ready, of those "thread"
+//	may run on.  Its affinity must allow at least one.
+//----------------------------------------------------------------------
+
+int
+Scheduler::LeastLoaded (Thread *thread)
+{
+    int best = -1;
+
+    for (int c = 0; c < numCPUs; c++)
+	if (MayRunOn(thread, c)
+		&& ((best < 0) || (numReady[c] < numReady[best])))
+	    best = c;
+    ASSERT(best >= 0);
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Busiest
+// 	Return the CPU with the most ready threads, for the CPU whose turn
+//	it is to steal from.  With NUMA nodes, a CPU on the same node as
+//	it wins over any other that has threads ready, so that threads
+//	stay near the memory they have been using.
+//----------------------------------------------------------------------
+
+int
+Scheduler::Busiest ()
+{
+    int busiest = 0;
+    int node = NodeOf(cpu);
+
+    for (int c = 1; c < numCPUs; c++) {
+	bool local = (bool)(NodeOf(c) == node);
+	bool busiestLocal = (bool)(NodeOf(busiest) == node);
+
+	if ((numReady[busiest] == 0) || ((local == busiestLocal)
+		? (numReady[c] > numReady[busiest])
+		: (local && (numReady[c] > 0))))
+	    busiest = c;
+    }
+    return busiest;
 }
 
 //----------------------------------------------------------------------
@@ -85,6 +276,12 @@ Scheduler::FindNextToRun ()
 //	The global variable currentThread becomes nextThread.
 //
 //	"nextThread" is the thread to be put into the CPU.
+//
+//	When both threads run in the same address space (see
+//	ThreadCreate), only the user registers are switched: the address
+//	space's state -- the page table, and the TLB -- stays loaded.  The
+//	thread switched to finds out where it was switched from in
+//	"switchedFrom", since its own "oldThread" is long out of date.
 //----------------------------------------------------------------------
 
 void
@@ -94,16 +291,36 @@ Scheduler::Run (Thread *nextThread)
     
 #ifdef USER_PROGRAM			// ignore until running user programs 
     if (currentThread->space != NULL) {	// if this thread is a user program,
+	TranslationEntry *table = currentThread->userPageTable;
+	TranslationEntry **directory = currentThread->userPageDirectory;
+
         currentThread->SaveUserState(); // save the user's CPU registers
-	currentThread->space->SaveState();
+	if ((currentThread->userPageTable != table)
+		|| (currentThread->userPageDirectory != directory))
+	    ShareTranslations(currentThread);
+	if (nextThread->space != currentThread->space)
+	    currentThread->space->SaveState();
     }
+    switchedFrom = currentThread->space;
 #endif
     
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
+    Account(oldThread, nextThread);
+    if (oldThread->realTime != NULL) {
+	oldThread->realTime->budgetLeft -= stats->totalTicks - sliceStart;
+	if (oldThread->getStatus() == BLOCKED)
+	    JobDone(oldThread);
+    }
+    TraceRecord(TraceSwitch, nextThread->getName(), cpu, 0);
+    stats->RunningOn(max(nextThread->getCPU(), 0));	// count on its CPU
+
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
+    sliceStart = stats->totalTicks;	    // with a fresh time slice
+    stats->totalTicks += switchTicks;	    // which costs something
+    stats->systemTicks += switchTicks;
     
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
@@ -129,9 +346,190 @@ Scheduler::Run (Thread *nextThread)
 #ifdef USER_PROGRAM
     if (currentThread->space != NULL) {		// if there is an address space
         currentThread->RestoreUserState();     // to restore, do it.
-	currentThread->space->RestoreState();
+	if (currentThread->space != switchedFrom)
+	    currentThread->space->RestoreState();
+    }
+#endif
+}
+
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// Scheduler::ShareTranslations
+// 	"thread", switching out, was running with a page table other than
+//	the one it last saved: its address space's table has grown (and
+//	moved), or it is new.  Give the new table to the ready threads
+//	of the same space, whose own saved copy may be of a table since
+//	deleted, in case one of them is run in a gang (see Gang).  Those
+//	that are blocked save theirs again before they can be.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ShareTranslations (Thread *thread)
+{
+    for (int c = 0; c < numCPUs; c++)
+	for (int level = 0; level < NumLevels; level++)
+	    for (Thread *t = readyList[c][level]->First(); t != NULL;
+							t = t->queueNext)
+		if (t->space == thread->space) {
+		    t->userPageTable = thread->userPageTable;
+		    t->userPageDirectory = thread->userPageDirectory;
+		    t->userPageTableSize = thread->userPageTableSize;
+		}
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Gang
+// 	Find, for each CPU but the one whose turn it is, the thread it
+//	would run next (leaving it on the ready list), if its user code
+//	can be run now, alongside the running thread's, on a host thread
+//	of its own (see Machine::RunParallel).  That is so if it was
+//	preempted between two user instructions, rather than in the
+//	kernel, and no other thread in the gang -- the running one
+//	included -- is in the same address space, since only the
+//	running thread's may be written to meanwhile.  Nor may it have
+//	frames that other spaces can write too (a shared memory segment,
+//	say): the host threads would race on them.
+//
+//	"gang" -- where to put them; room for MaxCPUs - 1
+//----------------------------------------------------------------------
+
+int
+Scheduler::Gang (Thread **gang)
+{
+    int n = 0;
+
+    for (int c = 0; c < numCPUs; c++) {
+	Thread *t = NULL;
+
+	if ((c == cpu) || (numReady[c] == 0))
+	    continue;
+	for (int level = 0; (level < NumLevels) && (t == NULL); level++)
+	    t = readyList[c][level]->First();
+	if ((t == NULL) || !t->userPreempted
+			|| (t->space == currentThread->space)
+			|| t->space->SharesFrames())
+	    continue;
+	for (int i = 0; (i < n) && (t != NULL); i++)
+	    if (gang[i]->space == t->space)
+		t = NULL;
+	if (t != NULL)
+	    gang[n++] = t;
     }
+    return n;
+}
 #endif
+
+//----------------------------------------------------------------------
+// Scheduler::Account
+// 	Charge the thread giving up the CPU for the user and system time
+//	since it got it, and count the switch to the next thread, and
+//	how long it waited on the ready list for it.  The cost of the
+//	switch itself is charged to the next thread.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Account (Thread *oldThread, Thread *nextThread)
+{
+    int wait = stats->totalTicks - nextThread->readySince;
+
+    oldThread->account->userTicks += stats->userTicks - runUserTicks;
+    oldThread->account->systemTicks += stats->systemTicks - runSystemTicks;
+    runUserTicks = stats->userTicks;
+    runSystemTicks = stats->systemTicks;
+
+    nextThread->account->numSwitches++;
+    nextThread->account->readyTicks += wait;
+    stats->RecordReadyWait(wait);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::JobDone
+// 	Called when real-time thread "thread" blocks, which ends its job:
+//	count it if it was late.
+//----------------------------------------------------------------------
+
+void
+Scheduler::JobDone (Thread *thread)
+{
+    RealTime *rt = thread->realTime;
+    int late = stats->totalTicks - rt->jobDeadline;
+
+    rt->jobDone = TRUE;
+    if (late > 0) {
+	DEBUG('t', "Real-time thread \"%s\" missed its deadline by %d ticks\n",
+	      thread->getName(), late);
+	stats->numDeadlinesMissed++;
+	stats->maxLateness = max(stats->maxLateness, late);
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetRealTime
+// 	Make "thread" a real-time thread (or change its parameters), if
+//	admission control lets it in: the load of all the real-time
+//	threads must stay within MaxRealTimeLoad.  If the thread is
+//	running, it starts a job now; if it is ready, it is queued again
+//	in its new class.  Return FALSE, and leave it as it was, if there
+//	is no room.
+//
+//	"period", "deadline", "budget" -- see RealTime, in thread.h; a
+//		period of 0 makes the thread an ordinary one again
+//----------------------------------------------------------------------
+
+bool
+Scheduler::SetRealTime(Thread *thread, int period, int deadline, int budget)
+{
+    RealTime *rt = thread->realTime;
+    bool ready = (bool)(thread->getStatus() == READY);
+    int load = 0;
+
+    if (period > 0) {
+	ASSERT((deadline > 0) && (budget > 0));
+	load = budget * 1000 / min(deadline, period);
+    }
+    if (realTimeLoad - ((rt != NULL) ? rt->load : 0) + load
+							> MaxRealTimeLoad) {
+	DEBUG('t', "No room for real-time thread \"%s\"\n",
+	      thread->getName());
+	stats->numRealTimeRefused++;
+	return FALSE;
+    }
+    if (ready) {
+	if (rt != NULL)
+	    realTimeList->Remove(thread);
+	else {
+	    readyList[thread->getCPU()][thread->getLevel()]->Remove(thread);
+	    numReady[thread->getCPU()]--;
+	}
+    }
+    if (rt != NULL)
+	realTimeLoad -= rt->load;
+    if (period == 0) {
+	delete rt;
+	thread->realTime = NULL;
+    } else {
+	if (rt == NULL) {
+	    rt = thread->realTime = new RealTime;
+	    rt->nextRelease = 0;
+	    rt->jobDone = TRUE;
+	}
+	rt->period = period;
+	rt->deadline = deadline;
+	rt->budget = budget;
+	rt->load = load;
+	realTimeLoad += load;
+	if ((thread == currentThread) && rt->jobDone) {
+	    sliceStart = stats->totalTicks;
+	    rt->jobDeadline = stats->totalTicks + deadline;
+	    rt->nextRelease = stats->totalTicks + period;
+	    rt->budgetLeft = budget;
+	    rt->jobDone = FALSE;
+	    stats->numRealTimeJobs++;
+	}
+    }
+    if (ready)
+	ReadyToRun(thread);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -142,6 +540,91 @@ Scheduler::Run (Thread *nextThread)
 void
 Scheduler::Print()
 {
-    printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int c = 0; c < numCPUs; c++) {
+	if (numCPUs > 1)
+	    printf("CPU %d: ", c);
+	printf("Ready list contents:\n");
+	for (int level = 0; level < NumLevels; level++)
+	    readyList[c][level]->Mapcar((VoidFunctionPtr) ThreadPrint);
+    }
+    if (!realTimeList->IsEmpty()) {
+	printf("Real-time list contents:\n");
+	realTimeList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TimerTick
+// 	Called at each timer interrupt, to decide whether the running
+//	thread has had its time slice.  Round robin preempts it at every
+//	tick.  The feedback queue lets it run until it has used the whole
+//	slice for its level, and then moves it down a level; it also
+//	boosts every thread back to level 0, every BoostInterval.
+//
+//	Any real-time thread that is ready preempts a thread of another
+//	class.  A real-time thread is charged for the time since the last
+//	tick, and if that uses up its budget, has its deadline put off
+//	by a period, and its budget refilled; it is only preempted by one
+//	with an earlier deadline.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::TimerTick()
+{
+    RealTime *rt = currentThread->realTime;
+    Thread *first = realTimeList->First();
+
+    if (rt != NULL) {
+	rt->budgetLeft -= stats->totalTicks - sliceStart;
+	sliceStart = stats->totalTicks;
+	if (rt->budgetLeft <= 0) {
+	    DEBUG('t', "Real-time thread \"%s\" used up its budget\n",
+		  currentThread->getName());
+	    stats->numBudgetOverruns++;
+	    rt->jobDeadline += rt->period;
+	    rt->budgetLeft = rt->budget;
+	}
+	return (bool)((first != NULL)
+		      && (first->realTime->jobDeadline < rt->jobDeadline));
+    }
+    if (first != NULL)
+	return TRUE;
+    if (policy != FeedbackScheduling)
+	return TRUE;
+    if (stats->totalTicks - lastBoost >= BoostInterval)
+	Boost();
+
+    int level = currentThread->getLevel();
+
+    if (stats->totalTicks - sliceStart < (timerTicks << level))
+	return FALSE;			// some of its slice is left
+    if (level < NumLevels - 1) {
+	DEBUG('t', "Thread \"%s\" used its slice, down to level %d\n",
+	      currentThread->getName(), level + 1);
+	currentThread->setLevel(level + 1);
+    }
+    sliceStart = stats->totalTicks;	// in case no one else is ready
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Boost
+// 	Move every thread -- running or ready -- back to level 0, keeping
+//	the ready threads in order, highest level first.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Boost()
+{
+    Thread *thread;
+
+    DEBUG('t', "Boosting every thread to level 0\n");
+    for (int c = 0; c < numCPUs; c++)
+	for (int level = 1; level < NumLevels; level++)
+	    while ((thread = readyList[c][level]->Remove()) != NULL) {
+		thread->setLevel(0);
+		readyList[c][0]->Append(thread);
+	    }
+    currentThread->setLevel(0);
+    lastBoost = stats->totalTicks;
 }
@@ -10,9 +10,86 @@
 #define SCHEDULER_H
 
 #include "copyright.h"
-#include "list.h"
+#include "threadqueue.h"
 #include "thread.h"
 
+// Scheduling policies, chosen at boot (see system.cc).
+
+enum SchedulingPolicy { FIFOScheduling,		// one queue, round robin
+			FeedbackScheduling,	// multilevel feedback queue
+			StrideScheduling };	// proportional share, by
+						// tickets (lab3 only; here
+						// it is just round robin)
+
+// With the multilevel feedback queue, a thread starts at level 0, and
+// moves down a level each time it uses up its whole time slice; one
+// that blocks (in Semaphore::P, say) before then keeps its level.
+// Lower levels run only if the levels above them are empty, but get
+// longer slices: timerTicks << level.  Every BoostInterval ticks, all
+// threads move back up to level 0, so that none of them starves.
+
+#define NumLevels	3			// levels of feedback queue
+#define BoostInterval	(50 * timerTicks)	// how often to move every
+						// thread back to level 0
+
+// The scheduler can also model a multiprocessor, with -smp (see
+// system.cc): each of up to MaxCPUs simulated CPUs has its own ready
+// queues, and a thread that becomes ready goes back on the queues of
+// the CPU it last ran on.  There is still only one host thread for
+// the kernel, and one set of registers, so the CPUs take turns (but
+// see -hp, below): at each context switch, the next CPU in turn
+// dispatches the first thread on its own queues.
+// A CPU with nothing to run steals a thread from the CPU with the
+// most ready threads, and new threads go to the least loaded CPU.
+//
+// That affinity is soft: a thread stays with its CPU, and the TLB and
+// cache state it has built up there, unless the imbalance is worth
+// moving it for.  A CPU with nothing to run only steals from one with
+// more than MigrateThreshold threads ready; otherwise, rather than
+// move a thread, it lets that CPU have its turn.  A thread may also
+// have hard affinity (see Thread::setAffinity, and the SetAffinity
+// system call): a mask of the CPUs it may run on at all.  It is never
+// queued on, or stolen by, any other.
+//
+// The CPUs cannot all simply be run on host threads of their own:
+// every Nachos thread is a coroutine switched by SWITCH on the one
+// host stack, and simulated time is the one event queue in
+// "interrupt", whose handlers assume they run with everything else
+// stopped.  But user code needs neither, until it traps.  So with -hp
+// (see Machine::SetParallel), when the running thread has a stretch
+// of user code to run with no interrupt due, the thread each other CPU
+// would run next (see Gang) runs its user code alongside, on a host
+// thread of its own, for as many ticks -- a lookahead of one window,
+// stopping short of any trap, for the kernel to take later as usual.
+//
+// With -numa, the CPUs, like memory (see Machine::SetNUMA), are split
+// evenly between nodes, in order.  A CPU with nothing to run then
+// steals from the busiest CPU on its own node, and only goes to
+// another node if no CPU on its own has anything ready.
+
+// Above all of those is the real-time class: threads given a period,
+// a deadline and a budget (see SetRealTime), which are run earliest
+// deadline first, ahead of any other thread, on whichever CPU has its
+// turn next.  A thread is only admitted if the load of all real-time
+// threads -- the sum of budget / min(deadline, period) -- stays within
+// MaxRealTimeLoad, so that their deadlines can all be met, and the
+// rest of the threads still get some of the CPU.
+//
+// The budget is enforced at each timer interrupt: a thread that has
+// used up its budget for a job has its deadline put off by a period,
+// and its budget refilled (as in a constant bandwidth server), so
+// that an overrunning thread cannot take more than its share from the
+// other real-time threads.  A real-time thread made ready also only
+// preempts a thread of another class at the next timer interrupt, so
+// -quantum bounds how long it can wait.
+
+#define MaxRealTimeLoad	900	// per mille of the CPU real-time threads
+				// may reserve between them
+
+#define MaxCPUs		8
+#define MigrateThreshold 1	// a CPU only steals from one that has
+				// more threads than this ready
+
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
@@ -27,10 +104,73 @@ class Scheduler {
 					// list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
+
+    void SetPolicy(SchedulingPolicy p) { policy = p; }
+    void SetCPUs(int n) { ASSERT((n >= 1) && (n <= MaxCPUs)); numCPUs = n; }
+					// simulate "n" CPUs
+    int NumCPUs() { return numCPUs; }
+    void SetNodes(int n) { ASSERT(n >= 1); numNodes = n; }
+					// ... on "n" NUMA nodes
+    int NodeOf(int c) { return max(c, 0) * numNodes / numCPUs; }
+					// the node CPU "c" is on (a thread
+					// that has not run yet is on CPU 0's)
+    bool TimerTick();			// Called on each timer interrupt;
+					// TRUE if the running thread should
+					// give up the CPU
+    bool SetRealTime(Thread *thread, int period, int deadline, int budget);
+					// make "thread" real-time, if there
+					// is room for it (a period of 0
+					// makes it an ordinary thread again)
+#ifdef USER_PROGRAM
+    int Gang(Thread **gang);		// the threads the other CPUs would
+					// run next, whose user code can run
+					// alongside the running thread's;
+					// returns how many
+#endif
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
+    ThreadQueue *readyList[MaxCPUs][NumLevels];	// queues of threads that
+				// are ready to run, but not running, by
+				// CPU and level (with FIFOScheduling, all
+				// are at level 0)
+    int numReady[MaxCPUs];	// how many threads each CPU has ready
+    ThreadQueue *realTimeList;	// real-time threads that are ready to
+				// run, by deadline, on any CPU
+    int realTimeLoad;		// the load of all real-time threads,
+				// per mille
+    int numCPUs;		// how many CPUs we simulate
+    int numNodes;		// how many NUMA nodes they are on
+    int cpu;			// the CPU whose turn it is
+    SchedulingPolicy policy;	// how to choose the next thread
+    int sliceStart;		// when the running thread's slice began
+    int lastBoost;		// when every thread was last moved up
+    int runUserTicks;		// the user and system time when the
+    int runSystemTicks;		// running thread got the CPU
+#ifdef USER_PROGRAM
+    AddrSpace *switchedFrom;	// the address space of the thread that
+				// last gave up the CPU (see Run)
+
+    void ShareTranslations(Thread *thread);
+				// the page table of "thread"'s address
+				// space has moved; tell its ready threads
+#endif
+
+    void Boost();		// move every thread back to level 0
+    Thread *Dequeue(int c);	// take the next thread off CPU c's queues
+    Thread *NextRealTime();	// ... the next real-time thread that may
+				// run on "cpu", if any
+    void JobDone(Thread *thread);	// "thread" has finished its job;
+				// did it meet its deadline?
+    Thread *Steal(int c);	// ... the next that may run on "cpu"
+    int LeastLoaded(Thread *thread);
+				// the CPU with the fewest ready threads,
+				// of those "thread" may run on
+    bool MayRunOn(Thread *thread, int c)
+	{ return (bool)((thread->getAffinity() >> c) & 1); }
+    int Busiest();		// the CPU with the most ready threads,
+				// on our node if any there has some
+    void Account(Thread *oldThread, Thread *nextThread);
+				// charge for the CPU, and count the switch
 };
 
 #endif // SCHEDULER_H
@@ -6,7 +6,7 @@
  *	call frame, etc, are all specific to a processor architecture.
  *
  * 	This file currently supports the DEC MIPS, SUN SPARC, HP PA-RISC,
- *  Intel 386 and DEC ALPHA architectures.
+ *  Intel 386, x86-64 and DEC ALPHA architectures.
  */
 
 /*
@@ -153,6 +153,36 @@
 #define StartupPC       %ecx
 #endif // HOST_i386
 
+#ifdef HOST_x86_64
+
+/* The offsets of the registers from the beginning of the thread object.
+ * Only the registers the callee must preserve (and the stack pointer,
+ * and the return address) need saving: SWITCH is called like any other
+ * routine.
+ */
+#define _RSP     0
+#define _RBX     8
+#define _RBP     16
+#define _R12     24
+#define _R13     32
+#define _R14     40
+#define _R15     48
+#define _PC      56
+
+/* These definitions are used in Thread::AllocateStack(). */
+#define PCState         (_PC/8-1)
+#define FPState         (_RBP/8-1)
+#define InitialPCState  (_R12/8-1)
+#define InitialArgState (_R13/8-1)
+#define WhenDonePCState (_R14/8-1)
+#define StartupPCState  (_R15/8-1)
+
+#define InitialPC       %r12
+#define InitialArg      %r13
+#define WhenDonePC      %r14
+#define StartupPC       %r15
+#endif // HOST_x86_64
+
 // Roberto Rossi (roberto@csr.unibo.it) - 1994
 #ifdef HOST_ALPHA
 
@@ -25,6 +25,23 @@
 #include "synch.h"
 #include "system.h"
 
+//----------------------------------------------------------------------
+// CountAcquire
+// 	With lockstat on, count a synchronization object having been
+//	taken by the current thread, and the wait, if it had to, since
+//	"start".
+//----------------------------------------------------------------------
+
+static void
+CountAcquire(LockStats *profile, bool waited, int start)
+{
+    if (profile == NULL)
+	return;
+    profile->acquires++;
+    if (waited)
+	profile->Waited(currentThread->getName(), stats->totalTicks - start);
+}
+
 //----------------------------------------------------------------------
 // Semaphore::Semaphore
 // 	Initialize a semaphore, so that it can be used for synchronization.
@@ -37,7 +54,9 @@ Semaphore::Semaphore(const char* debugName, int initialValue)
 {
     name = (char*)debugName;
     value = initialValue;
-    queue = new List;
+    queue = new ThreadQueue;
+    profile = (stats != NULL) ?		// not yet, in static constructors
+	stats->NewLock("semaphore", name) : NULL;
 }
 
 //----------------------------------------------------------------------
@@ -65,15 +84,79 @@ void
 Semaphore::P()
 {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
+    int start = stats->totalTicks;
+    bool waited = FALSE;
     
     while (value == 0) { 			// semaphore not available
-	queue->Append((void *)currentThread);	// so go to sleep
+	queue->Append(currentThread);	// so go to sleep
 	currentThread->Sleep();
+	waited = TRUE;
+    } 
+    value--; 					// semaphore available, 
+						// consume its value
+    CountAcquire(profile, waited, start);
+    
+    (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
+}
+
+//----------------------------------------------------------------------
+// SemaphoreTimeout
+// 	The alarm for a P with a timeout, going off: if the thread is
+//	still waiting on the semaphore, take it off, and wake it up.  (If
+//	it isn't, a V already woke it.)
+//----------------------------------------------------------------------
+
+struct SemaphoreWait {
+    ThreadQueue *queue;			// what the thread is waiting on
+    Thread *thread;
+};
+
+static void
+SemaphoreTimeout(_int arg)
+{
+    SemaphoreWait *wait = (SemaphoreWait *) arg;
+
+    if (wait->queue->Remove(wait->thread))
+	scheduler->ReadyToRun(wait->thread);
+}
+
+//----------------------------------------------------------------------
+// Semaphore::P
+// 	Wait until semaphore value > 0, then decrement, as above; but give
+//	up once "timeout" ticks of simulated time have passed, with an
+//	alarm (see alarm.h) to wake us up if no V does.  Return TRUE if
+//	we did decrement the value, FALSE if we gave up.
+//----------------------------------------------------------------------
+
+bool
+Semaphore::P(int timeout)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
+    int start = stats->totalTicks;
+    int deadline = start + timeout;
+    bool waited = FALSE;
+    SemaphoreWait wait;
+    AlarmEntry entry;
+
+    wait.queue = queue;
+    wait.thread = currentThread;
+    while (value == 0) { 			// semaphore not available
+	if (stats->totalTicks >= deadline) {	// and no more time to wait
+	    (void) interrupt->SetLevel(oldLevel);
+	    return FALSE;
+	}
+	queue->Append(currentThread);	// so go to sleep, until a V
+	alarmClock->Set(&entry, deadline, SemaphoreTimeout, (_int) &wait);
+	currentThread->Sleep();		// or the deadline
+	alarmClock->Cancel(&entry);
+	waited = TRUE;
     } 
     value--; 					// semaphore available, 
 						// consume its value
+    CountAcquire(profile, waited, start);
     
     (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -90,7 +173,7 @@ Semaphore::V()
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    thread = (Thread *)queue->Remove();
+    thread = queue->Remove();
     if (thread != NULL)	   // make thread ready, consuming the V immediately
 	scheduler->ReadyToRun(thread);
     value++;
@@ -110,7 +193,9 @@ Lock::Lock(const char* debugName)
 {
     name = (char*)debugName;
     owner = NULL;
-    lock = new Semaphore(name,1);
+    waiters = new ThreadQueue;
+    profile = (stats != NULL) ? stats->NewLock("lock", name) : NULL;
+    acquiredAt = 0;
 }
 
 
@@ -121,52 +206,89 @@ Lock::Lock(const char* debugName)
 //----------------------------------------------------------------------
 Lock::~Lock() 
 {
-    delete lock;
+    delete waiters;
 }
 
 //----------------------------------------------------------------------
 // Lock::Acquire
-//      Use a binary semaphore to implement the lock.  Record which 
-//      thread acquired the lock in order to assure that only the
-//      same thread releases it.
+//      Wait until the lock is free, then record which thread acquired
+//      it, in order to assure that only the same thread releases it.
+//
+//	Kernel code is only ever interrupted when it turns interrupts
+//	back on (that is when simulated time advances), so testing and
+//	setting the owner is atomic as it stands; we only need to turn
+//	interrupts off if we have to wait.
 //----------------------------------------------------------------------
 void Lock::Acquire() 
 {
+    ASSERT(owner != currentThread);	// no recursive locking
+    stats->thisCPU->numLockAcquires++;
+    if (owner == NULL) {		// fast path: the lock is free
+	owner = currentThread;
+	if (profile != NULL) {
+	    profile->acquires++;
+	    acquiredAt = stats->totalTicks;
+	}
+	return;
+    }
+
     IntStatus oldLevel = interrupt->SetLevel(IntOff);  // disable interrupts
+    int start = stats->totalTicks;
 
-    lock->P();                            // procure the semaphore
+    stats->thisCPU->numLockContended++;
+    while (owner != NULL) {		// lock is busy, go to sleep
+	waiters->Append(currentThread);
+	currentThread->Sleep();
+    }
     owner = currentThread;                // record the new owner of the lock
+    CountAcquire(profile, TRUE, start);
+    acquiredAt = stats->totalTicks;
     (void) interrupt->SetLevel(oldLevel); // re-enable interrupts
 }
 
 //----------------------------------------------------------------------
 // Lock::Release
-//      Set the lock to be free (i.e. vanquish the semaphore).  Check
-//      that the currentThread is allowed to release this lock.
+//      Set the lock to be free, waking up a thread waiting for it if
+//      there is one (only then do we turn interrupts off).  Check that
+//      the currentThread is allowed to release this lock.
 //----------------------------------------------------------------------
 void Lock::Release() 
 {
-    IntStatus oldLevel = interrupt->SetLevel(IntOff);  // disable interrupts
-
     // Ensure: a) lock is BUSY  b) this thread is the same one that acquired it.
     ASSERT(currentThread == owner);        
     owner = NULL;                          // clear the owner
-    lock->V();                             // vanquish the semaphore
+    if (profile != NULL)
+	profile->Held(stats->totalTicks - acquiredAt);
+    if (waiters->IsEmpty())		   // fast path: no one to wake up
+	return;
+
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);  // disable interrupts
+    Thread *thread = waiters->Remove();
+
+    if (thread != NULL)			// make thread ready; it tries
+	scheduler->ReadyToRun(thread);	// for the lock again when it runs
     (void) interrupt->SetLevel(oldLevel);
 }
 
 
+//----------------------------------------------------------------------
+// Lock::AddWaiter
+//      "thread" (which is asleep, waiting on a condition that has just
+//      been signalled) should now wait for the lock; make it one of the
+//      threads Release wakes up.  Interrupts are assumed to be off.
+//----------------------------------------------------------------------
+void Lock::AddWaiter(Thread *thread)
+{
+    ASSERT(interrupt->getLevel() == IntOff);
+    waiters->Append(thread);
+}
+
 //----------------------------------------------------------------------
 // Lock::isHeldByCurrentThread
 //----------------------------------------------------------------------
 bool Lock::isHeldByCurrentThread()
 {
-    bool result;
-    IntStatus oldLevel = interrupt->SetLevel(IntOff);
-
-    result = currentThread == owner;
-    (void) interrupt->SetLevel(oldLevel);
-    return(result);
+    return (bool)(currentThread == owner);	// a single read is atomic
 }
 
 //----------------------------------------------------------------------
@@ -179,8 +301,9 @@ bool Lock::isHeldByCurrentThread()
 Condition::Condition(const char* debugName) 
 { 
     name = (char*)debugName;
-    queue = new List;
+    queue = new ThreadQueue;
     lock = NULL;
+    profile = (stats != NULL) ? stats->NewLock("condition", name) : NULL;
 }
 
 //----------------------------------------------------------------------
@@ -198,7 +321,8 @@ Condition::~Condition()
 // Condition::Wait
 //
 //      Release the lock, relinquish the CPU until signaled, then
-//      re-acquire the lock.
+//      re-acquire the lock.  Signal puts us on the lock's waiters, so
+//      we are woken when it is next released.
 //
 //      Pre-conditions:  currentThread is holding the lock; threads in
 //      the queue are waiting on the same lock.
@@ -206,6 +330,7 @@ Condition::~Condition()
 void Condition::Wait(Lock* conditionLock) 
 { 
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int start = stats->totalTicks;
 
     ASSERT(conditionLock->isHeldByCurrentThread());  // check pre-condition
     if(queue->IsEmpty()) {
@@ -216,6 +341,7 @@ void Condition::Wait(Lock* conditionLock)
     conditionLock->Release();      // release the lock
     currentThread->Sleep();        // goto sleep
     conditionLock->Acquire();      // awaken: re-acquire the lock
+    CountAcquire(profile, TRUE, start);
     (void) interrupt->SetLevel(oldLevel);
 }
 
@@ -234,8 +360,8 @@ void Condition::Signal(Lock* conditionLock)
     ASSERT(conditionLock->isHeldByCurrentThread());
     if(!queue->IsEmpty()) {
 	ASSERT(lock == conditionLock);
-	nextThread = (Thread *)queue->Remove();
-	scheduler->ReadyToRun(nextThread);      // wake up the thread
+	nextThread = queue->Remove();
+	conditionLock->AddWaiter(nextThread);	// wake it for the lock
     } 
     (void) interrupt->SetLevel(oldLevel);
 }
@@ -255,9 +381,239 @@ void Condition::Broadcast(Lock* conditionLock)
     ASSERT(conditionLock->isHeldByCurrentThread());
     if(!queue->IsEmpty()) {
 	ASSERT(lock == conditionLock);
-	while( (nextThread = (Thread *)queue->Remove()) ) {
-	    scheduler->ReadyToRun(nextThread);  // wake up the thread
+	while( (nextThread = queue->Remove()) ) {
+	    conditionLock->AddWaiter(nextThread);  // wake it for the lock
 	}
     } 
     (void) interrupt->SetLevel(oldLevel);
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a reader-writer lock, held by no one.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(const char* debugName)
+{
+    name = (char*)debugName;
+    lock = new Lock(debugName);
+    okToRead = new Condition(debugName);
+    okToWrite = new Condition(debugName);
+    activeReaders = waitingReaders = waitingWriters = admitted = 0;
+    activeWriter = FALSE;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	De-allocate the lock; assume no one holds it, or is waiting.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    delete okToWrite;
+    delete okToRead;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead
+//      Wait until no writer holds the lock, and none is waiting for it
+//      -- unless this thread is in the batch let in by the last writer
+//      -- and then take a share of it.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireRead()
+{
+    lock->Acquire();
+    waitingReaders++;
+    while (activeWriter || ((waitingWriters > 0) && (admitted == 0)))
+	okToRead->Wait(lock);
+    waitingReaders--;
+    if (admitted > 0)
+	admitted--;
+    activeReaders++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseRead
+//      Give up a share of the lock; the last reader out lets a writer
+//      in, once the whole batch has been through.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseRead()
+{
+    lock->Acquire();
+    ASSERT(activeReaders > 0);
+    activeReaders--;
+    if ((activeReaders == 0) && (admitted == 0))
+	okToWrite->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite
+//      Wait until no one holds the lock (and the readers let in by the
+//      last writer have all been through), then take it.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireWrite()
+{
+    lock->Acquire();
+    waitingWriters++;
+    while (activeWriter || (activeReaders > 0) || (admitted > 0))
+	okToWrite->Wait(lock);
+    waitingWriters--;
+    activeWriter = TRUE;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseWrite
+//      Give up the lock: to every waiting reader, as a batch, if there
+//      are any; otherwise to the next writer.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseWrite()
+{
+    lock->Acquire();
+    ASSERT(activeWriter);
+    activeWriter = FALSE;
+    if (waitingReaders > 0) {
+	admitted = waitingReaders;
+	okToRead->Broadcast(lock);
+    } else
+	okToWrite->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// WakeAll
+// 	Put every thread waiting on "queue" on the ready list.  Interrupts
+//	are assumed to be disabled.
+//----------------------------------------------------------------------
+
+static void
+WakeAll(ThreadQueue *queue)
+{
+    Thread *thread;
+
+    while ((thread = queue->Remove()) != NULL)
+	scheduler->ReadyToRun(thread);
+}
+
+//----------------------------------------------------------------------
+// Barrier::Barrier
+// 	Initialize a barrier for "threadCount" threads, none of which has
+//	arrived yet.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+Barrier::Barrier(const char* debugName, int threadCount)
+{
+    ASSERT(threadCount > 0);
+    name = (char*)debugName;
+    numThreads = threadCount;
+    numArrived = 0;
+    queue = new ThreadQueue;
+}
+
+//----------------------------------------------------------------------
+// Barrier::~Barrier
+// 	De-allocate a barrier, when no longer needed.
+//----------------------------------------------------------------------
+
+Barrier::~Barrier()
+{
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// Barrier::Wait
+// 	Wait for the rest of the threads to arrive.  The last one wakes
+//	everyone up, and starts the next round; the others just sleep,
+//	since no one else wakes them.
+//----------------------------------------------------------------------
+
+void
+Barrier::Wait()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (++numArrived == numThreads) {
+	DEBUG('t', "Barrier %s: all %d threads are here\n", name,
+	      numThreads);
+	numArrived = 0;
+	WakeAll(queue);
+    } else {
+	queue->Append(currentThread);
+	currentThread->Sleep();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// CountDownLatch::CountDownLatch
+// 	Initialize a latch that opens after "initialCount" calls to
+//	CountDown.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+CountDownLatch::CountDownLatch(const char* debugName, int initialCount)
+{
+    ASSERT(initialCount >= 0);
+    name = (char*)debugName;
+    count = initialCount;
+    queue = new ThreadQueue;
+}
+
+//----------------------------------------------------------------------
+// CountDownLatch::~CountDownLatch
+// 	De-allocate a latch, when no longer needed.
+//----------------------------------------------------------------------
+
+CountDownLatch::~CountDownLatch()
+{
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// CountDownLatch::CountDown
+// 	Count one event; if it was the last, wake up everyone waiting.
+//----------------------------------------------------------------------
+
+void
+CountDownLatch::CountDown()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(count > 0);
+    if (--count == 0)
+	WakeAll(queue);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// CountDownLatch::Await
+// 	Wait until the count reaches zero (if it has not already).
+//----------------------------------------------------------------------
+
+void
+CountDownLatch::Await()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (count > 0) {
+	queue->Append(currentThread);
+	currentThread->Sleep();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
@@ -5,7 +5,8 @@
 //	locks, and condition variables.  The implementation for
 //	semaphores is given; for the latter two, only the procedure
 //	interface is given -- they are to be implemented as part of 
-//	the first assignment.
+//	the first assignment.  Reader-writer locks, barriers and
+//	countdown latches are defined at the end.
 //
 //	Note that all the synchronization objects take a "name" as
 //	part of the initialization.  This is solely for debugging purposes.
@@ -19,7 +20,8 @@
 
 #include "copyright.h"
 #include "thread.h"
-#include "list.h"
+#include "threadqueue.h"
+#include "stats.h"
 
 
 // The following class defines a "semaphore" whose value is a non-negative
@@ -45,11 +47,15 @@ class Semaphore {
     
     void P();	 // these are the only operations on a semaphore
     void V();	 // they are both *atomic*
+    bool P(int timeout);	// P, but give up after "timeout" ticks
+				// of simulated time; FALSE if we did
     
   private:
     char* name;  // useful for debugging
     int value;         // semaphore value, always >= 0
-    List *queue;       // threads waiting in P() for the value to be > 0
+    ThreadQueue *queue;       // threads waiting in P() for the value to be > 0
+    LockStats *profile;		// its contention profile, or NULL if
+				// lockstat is off (see stats.h)
 };
 
 // The following class defines a "lock".  A lock can be BUSY or FREE.
@@ -63,6 +69,12 @@ class Semaphore {
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
+//
+// Most locks are free when they are acquired, and have no one waiting
+// when they are released; in those cases, Acquire and Release just
+// test and set the owner, without turning interrupts off and on (which
+// costs simulated time, and a check for pending interrupts).  A thread
+// only goes through the list of waiters if the lock is busy.
 
 class Lock {
   public:
@@ -77,11 +89,18 @@ class Lock {
 					// holds this lock.  Useful for
 					// checking in Release, and in
 					// Condition variable ops below.
+    void AddWaiter(Thread *thread);	// make "thread", which is already
+					// asleep, wait for the lock as if
+					// it had called Acquire (used by
+					// Condition, below)
 
   private:
     char* name;				// for debugging
     Thread *owner;                      // remember who acquired the lock
-    Semaphore *lock;                    // use semaphore for the actual lock
+					// (NULL if the lock is FREE)
+    ThreadQueue *waiters;			// threads waiting in Acquire
+    LockStats *profile;			// its contention profile, or NULL
+    int acquiredAt;			// ... and when it was last taken
 };
 
 // The following class defines a "condition variable".  A condition
@@ -115,6 +134,12 @@ class Lock {
 // The consequence of using Mesa-style semantics is that some other thread
 // can acquire the lock, and change data structures, before the woken
 // thread gets a chance to run.
+//
+// Since the signaller holds the lock, a woken thread could not get it
+// yet anyway; so rather than putting it on the ready list (where it
+// would only run to block again in Acquire), Signal and Broadcast move
+// it straight to the lock's waiters.  Each Release then wakes just one
+// of them.
 
 class Condition {
   public:
@@ -133,8 +158,94 @@ class Condition {
 
   private:
     char* name;
-    List* queue;  // threads waiting on the condition
+    ThreadQueue *queue;  // threads waiting on the condition
     Lock* lock;   // debugging aid:  used to check correctness of
                   // arguments to Wait, Signal and Broacast
+    LockStats *profile;		// its contention profile, or NULL
+};
+
+// The following class defines a "reader-writer lock".  Any number of
+// readers may hold the lock at once, or else a single writer:
+//
+//	AcquireRead -- wait until no writer holds the lock, then share it
+//	ReleaseRead -- give up a share
+//	AcquireWrite -- wait until no one holds the lock, then take it
+//	ReleaseWrite -- give it up
+//
+// Writers are preferred: once a writer is waiting, new readers wait
+// too, so a stream of readers cannot starve it.  In return, when a
+// writer releases the lock, every reader waiting at that moment is let
+// in together, as a batch, ahead of the next writer -- so writers
+// cannot starve readers either.
+
+class RWLock {
+  public:
+    RWLock(const char* debugName);	// initialize lock to be FREE
+    ~RWLock();
+    char* getName() { return name; }
+
+    void AcquireRead();
+    void ReleaseRead();
+    void AcquireWrite();
+    void ReleaseWrite();
+
+  private:
+    char* name;
+    Lock *lock;				// protects the fields below
+    Condition *okToRead;		// readers wait here
+    Condition *okToWrite;		// writers wait here
+    int activeReaders;			// readers holding the lock
+    bool activeWriter;			// is a writer holding it?
+    int waitingReaders;
+    int waitingWriters;
+    int admitted;			// readers of the current batch not
+					// yet in
+};
+
+// The following class defines a "barrier" for a fixed number of
+// threads.  There is only one operation on a barrier:
+//
+//	Wait -- wait until all the threads have called Wait, then go on
+//
+// The last thread to arrive puts all the others on the ready list, in
+// one pass, and the barrier is then ready for the next round.
+
+class Barrier {
+  public:
+    Barrier(const char* debugName, int threadCount);
+    ~Barrier();				// assume no one is waiting
+    char* getName() { return name; }
+
+    void Wait();
+
+  private:
+    char* name;
+    int numThreads;			// how many threads meet here
+    int numArrived;			// how many of them have, this round
+    ThreadQueue *queue;			// threads waiting for the rest
+};
+
+// The following class defines a "countdown latch", which lets threads
+// wait for some number of events (N workers finishing, say):
+//
+//	CountDown -- one more event has happened
+//	Await -- wait until all of them have
+//
+// Once the count reaches zero, the latch stays open: Await returns at
+// once.  As with a barrier, the waiters are all woken in one pass.
+
+class CountDownLatch {
+  public:
+    CountDownLatch(const char* debugName, int initialCount);
+    ~CountDownLatch();			// assume no one is waiting
+    char* getName() { return name; }
+
+    void CountDown();
+    void Await();
+
+  private:
+    char* name;
+    int count;				// events still to happen
+    ThreadQueue *queue;			// threads waiting for them
 };
 #endif // SYNCH_H
@@ -0,0 +1,241 @@
+// synchbench.cc
+//	Microbenchmarks of the thread system.  See synchbench.h.
+//
+//	Each benchmark forks the threads it needs and waits on the
+//	"benchDone" semaphore until they have all finished, so that the
+//	next one starts with nothing else on the ready list.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "synch.h"
+#include "synchlist.h"
+#include "synchbench.h"
+
+static const char *benchName;		// the benchmark being timed,
+static int benchTicks;			// and when it started, in simulated
+static unsigned long long benchHostTime;	// and host time
+
+static int benchCount;			// operations each thread does
+static Semaphore *benchDone;		// V'ed by each thread as it finishes
+
+static Semaphore *ping, *pong;		// SemaphoreThread
+static Lock *benchLock;			// LockThread, BroadcastThread
+static Condition *allWaiting, *go;	// BroadcastThread
+static int numWaiting, generation;
+static SynchList *benchList;		// ListThread
+static int benchBatch;
+
+//----------------------------------------------------------------------
+// BenchStart, BenchEnd
+// 	Note the simulated and host time at the start of a benchmark;
+//	and at the end, print how much of each it took per operation.
+//
+//	"name" -- the benchmark, to print
+//	"numOps" -- the operations it did
+//----------------------------------------------------------------------
+
+void
+BenchStart(const char *name)
+{
+    benchName = name;
+    benchTicks = stats->totalTicks;
+    benchHostTime = HostNanoseconds();
+}
+
+void
+BenchEnd(int numOps)
+{
+    unsigned long long hostTime = HostNanoseconds() - benchHostTime;
+
+    if (numOps < 1)
+	numOps = 1;
+    printf("bench %s ops %d ticks/op %.1f ns/op %.0f\n", benchName, numOps,
+	(double) (stats->totalTicks - benchTicks) / numOps,
+	(double) hostTime / numOps);
+}
+
+//----------------------------------------------------------------------
+// ForkBench
+// 	Fork "n" threads to run "func", numbered from 0, and wait for them
+//	all to finish.
+//----------------------------------------------------------------------
+
+static void
+ForkBench(VoidFunctionPtr func, int n)
+{
+    for (int i = 0; i < n; i++)
+	(new Thread("bench"))->Fork(func, i);
+    for (int i = 0; i < n; i++)
+	benchDone->P();
+}
+
+//----------------------------------------------------------------------
+// YieldThread
+// 	Yield "benchCount" times: with two of these, each Yield is a
+//	context switch to the other.
+//----------------------------------------------------------------------
+
+static void
+YieldThread(_int which)
+{
+    for (int i = 0; i < benchCount; i++)
+	currentThread->Yield();
+    benchDone->V();
+}
+
+//----------------------------------------------------------------------
+// SemaphoreThread
+// 	Hand control back and forth through two semaphores: thread 0 V's
+//	"ping" and waits on "pong", thread 1 the other way round.  Each
+//	handoff wakes up the other thread, which was waiting.
+//----------------------------------------------------------------------
+
+static void
+SemaphoreThread(_int which)
+{
+    for (int i = 0; i < benchCount; i++)
+	if (which == 0) {
+	    ping->V();
+	    pong->P();
+	} else {
+	    ping->P();
+	    pong->V();
+	}
+    benchDone->V();
+}
+
+//----------------------------------------------------------------------
+// LockThread
+// 	Acquire and release "benchLock" "benchCount" times, yielding while
+//	holding it, so that the other threads find it busy.
+//----------------------------------------------------------------------
+
+static void
+LockThread(_int which)
+{
+    for (int i = 0; i < benchCount; i++) {
+	benchLock->Acquire();
+	currentThread->Yield();
+	benchLock->Release();
+    }
+    benchDone->V();
+}
+
+//----------------------------------------------------------------------
+// BroadcastThread
+// 	Thread 0 waits until all the others are waiting on "go", and
+//	wakes them all with one Broadcast, "benchCount" times; the others
+//	each wait for it that many times.
+//----------------------------------------------------------------------
+
+static void
+BroadcastThread(_int which)
+{
+    benchLock->Acquire();
+    for (int i = 0; i < benchCount; i++)
+	if (which == 0) {
+	    while (numWaiting < BenchThreads)
+		allWaiting->Wait(benchLock);
+	    numWaiting = 0;
+	    generation++;
+	    go->Broadcast(benchLock);
+	} else {
+	    int myGeneration = generation;
+
+	    numWaiting++;
+	    allWaiting->Signal(benchLock);
+	    while (generation == myGeneration)
+		go->Wait(benchLock);
+	}
+    benchLock->Release();
+    benchDone->V();
+}
+
+//----------------------------------------------------------------------
+// ListThread
+// 	Thread 0 appends "benchCount" items to "benchList", which is
+//	bounded, so it waits whenever it gets too far ahead; thread 1
+//	removes them, "benchBatch" at a time at most.
+//----------------------------------------------------------------------
+
+static void
+ListThread(_int which)
+{
+    void *items[BenchListSize];
+
+    if (which == 0)
+	for (int i = 0; i < benchCount; i++)
+	    benchList->Append((void *) (_int) (i + 1));
+    else
+	for (int i = 0; i < benchCount; ) {
+	    if (benchBatch == 1) {
+		(void) benchList->Remove();
+		i++;
+	    } else
+		i += benchList->RemoveBatch(items, benchBatch);
+	}
+    benchDone->V();
+}
+
+//----------------------------------------------------------------------
+// SynchBench
+// 	Run each of the benchmarks, with each thread doing "count"
+//	operations, and print what they cost.  Run by "nachos -bench".
+//----------------------------------------------------------------------
+
+void
+SynchBench(int count)
+{
+    int acquires, contended;
+
+    benchCount = count;
+    benchDone = new Semaphore("bench done", 0);
+
+    BenchStart("yield");
+    ForkBench(YieldThread, 2);
+    BenchEnd(2 * count);
+
+    ping = new Semaphore("ping", 0);
+    pong = new Semaphore("pong", 0);
+    BenchStart("semaphore");
+    ForkBench(SemaphoreThread, 2);
+    BenchEnd(2 * count);
+    delete ping;
+    delete pong;
+
+    benchLock = new Lock("bench");
+    acquires = stats->Total().numLockAcquires;
+    contended = stats->Total().numLockContended;
+    BenchStart("lock");
+    ForkBench(LockThread, BenchThreads);
+    BenchEnd(BenchThreads * count);
+    printf("  lock acquires %d, contended %d\n",
+	stats->Total().numLockAcquires - acquires,
+	stats->Total().numLockContended - contended);
+
+    benchList = new SynchList(BenchListSize);
+    benchBatch = 1;
+    BenchStart("synchlist");
+    ForkBench(ListThread, 2);
+    BenchEnd(count);
+    benchBatch = BenchListSize;
+    BenchStart("synchlist batch");
+    ForkBench(ListThread, 2);
+    BenchEnd(count);
+
+    allWaiting = new Condition("all waiting");
+    go = new Condition("go");
+    numWaiting = generation = 0;
+    BenchStart("broadcast");
+    ForkBench(BroadcastThread, BenchThreads + 1);
+    BenchEnd(count);
+    delete allWaiting;
+    delete go;
+    delete benchLock;
+
+    delete benchDone;
+}
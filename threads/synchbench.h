@@ -0,0 +1,36 @@
+// synchbench.h
+//	Microbenchmarks of the thread system: how much a context switch,
+//	a semaphore handoff, a contended lock, an item through a bounded
+//	SynchList (one at a time, and in batches), a broadcast, or (in
+//	lab3 and monitor) a message through a ring costs.
+//
+//	Each benchmark is bracketed by BenchStart and BenchEnd, which
+//	print one line for it, giving both the simulated ticks and the
+//	host nanoseconds per operation:
+//
+//	    bench <name> ops <n> ticks/op <t> ns/op <h>
+//
+//	The simulated cost shows what the kernel charges (cf. stats.h);
+//	the host cost is the simulator's own speed.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SYNCHBENCH_H
+#define SYNCHBENCH_H
+
+#include "copyright.h"
+
+#define BenchThreads	4	// threads contending in the Lock and
+				// Broadcast benchmarks
+
+#define BenchListSize	16	// capacity of the SynchList benchmark's
+				// list, and its largest batch
+
+extern void SynchBench(int count);	// Run each benchmark, "count" times
+
+extern void BenchStart(const char *name);	// Start timing a benchmark
+extern void BenchEnd(int numOps);	// Print what it cost, per operation
+
+#endif // SYNCHBENCH_H
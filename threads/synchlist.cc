@@ -20,13 +20,19 @@
 //	Allocate and initialize the data structures needed for a 
 //	synchronized list, empty to start with.
 //	Elements can now be added to the list.
+//
+//	"limit" is the most items it can hold, or 0 for no limit.
 //----------------------------------------------------------------------
 
-SynchList::SynchList()
+SynchList::SynchList(int limit)
 {
+    ASSERT(limit >= 0);
     list = new List();
     lock = new Lock("list lock"); 
     listEmpty = new Condition("list empty cond");
+    listFull = new Condition("list full cond");
+    capacity = limit;
+    count = 0;
 }
 
 //----------------------------------------------------------------------
@@ -39,12 +45,14 @@ SynchList::~SynchList()
     delete list; 
     delete lock;
     delete listEmpty;
+    delete listFull;
 }
 
 //----------------------------------------------------------------------
 // SynchList::Append
 //      Append an "item" to the end of the list.  Wake up anyone
-//	waiting for an element to be appended.
+//	waiting for an element to be appended.  If the list is full,
+//	first wait until there is room.
 //
 //	"item" is the thing to put on the list, it can be a pointer to 
 //		anything.
@@ -54,7 +62,10 @@ void
 SynchList::Append(void *item)
 {
     lock->Acquire();		// enforce mutual exclusive access to the list 
+    while ((capacity > 0) && (count == capacity))
+	listFull->Wait(lock);	// wait until there's room
     list->Append(item);
+    count++;
     listEmpty->Signal(lock);	// wake up a waiter, if any
     lock->Release();
 }
@@ -77,10 +88,41 @@ SynchList::Remove()
 	listEmpty->Wait(lock);		// wait until list isn't empty
     item = list->Remove();
     ASSERT(item != NULL);
+    count--;
+    if (capacity > 0)
+	listFull->Signal(lock);		// there's room for one more
     lock->Release();
     return item;
 }
 
+//----------------------------------------------------------------------
+// SynchList::RemoveBatch
+//      Remove up to "max" items from the beginning of the list, in
+//	order, into "items": as many as there are, waiting only if there
+//	are none.  A consumer that can deal with several at a time pays
+//	for the lock, and the wait, once for all of them.
+// Returns:
+//	How many were removed (at least one).
+//----------------------------------------------------------------------
+
+int
+SynchList::RemoveBatch(void **items, int max)
+{
+    int n = 0;
+
+    ASSERT(max > 0);
+    lock->Acquire();
+    while (list->IsEmpty())
+	listEmpty->Wait(lock);
+    while ((n < max) && !list->IsEmpty())
+	items[n++] = list->Remove();
+    count -= n;
+    if (capacity > 0)
+	listFull->Broadcast(lock);	// there's room for "n" more
+    lock->Release();
+    return n;
+}
+
 //----------------------------------------------------------------------
 // SynchList::Mapcar
 //      Apply function to every item on the list.  Obey mutual exclusion
@@ -20,16 +20,30 @@
 //	1. Threads trying to remove an item from a list will
 //	wait until the list has an element on it.
 //	2. One thread at a time can access list data structures
+//	3. If the list has a capacity, threads trying to append an item
+//	wait until there is room for it -- so a producer can't get
+//	ahead of its consumers by more than that.
+//
+// A consumer can take all the items there are (up to some number) at
+// once, with RemoveBatch, for one lock acquire and at most one wait,
+// instead of one each per item.
 
 class SynchList {
   public:
-    SynchList();		// initialize a synchronized list
+    SynchList(int limit = 0);	// initialize a synchronized list,
+				// holding at most "limit" items (0 for
+				// no limit)
     ~SynchList();		// de-allocate a synchronized list
 
     void Append(void *item);	// append item to the end of the list,
 				// and wake up any thread waiting in remove
+				// (first waiting for room, if it is full)
     void *Remove();		// remove the first item from the front of
 				// the list, waiting if the list is empty
+    int RemoveBatch(void **items, int max);
+				// remove up to "max" items into "items",
+				// waiting only if the list is empty; return
+				// how many
 				// apply function to every item in the list
     void Mapcar(VoidFunctionPtr func);
 
@@ -37,6 +51,9 @@ class SynchList {
     List *list;			// the unsynchronized list
     Lock *lock;			// enforce mutual exclusive access to the list
     Condition *listEmpty;	// wait in Remove if the list is empty
+    Condition *listFull;	// wait in Append if the list is full
+    int capacity;		// the most items it may hold; 0, no limit
+    int count;			// how many it holds
 };
 
 #endif // SYNCHLIST_H
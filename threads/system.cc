@@ -7,6 +7,10 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "trace.h"
+#ifdef USER_PROGRAM
+#include "checkpoint.h"
+#endif
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -18,6 +22,7 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+Alarm *alarmClock;			// threads waiting for a time
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -60,7 +65,8 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(_int dummy)
 {
-    if (interrupt->getStatus() != IdleMode)
+    alarmClock->Tick();
+    if ((interrupt->getStatus() != IdleMode) && scheduler->TimerTick())
 	interrupt->YieldOnReturn();
 }
 
@@ -80,17 +86,56 @@ Initialize(int argc, char **argv)
     int argCount;
     char* debugArgs = (char*)"";
     bool randomYield = FALSE;
+    bool feedback = FALSE;	// multilevel feedback queue scheduling
+    bool stride = FALSE;	// stride (proportional share) scheduling
+    int numCPUs = 1;		// simulated processors
+    int numNodes = 1;		// NUMA nodes they and memory are on
+    bool tickless = FALSE;	// no timer interrupts while idle
+    bool lockStats = FALSE;	// profile lock contention
+    bool edf = FALSE;		// real-time threads (which need the timer)
+    bool perThreadStats = FALSE;	// keep statistics for every thread
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool cacheDecoded = FALSE;	// keep decoded user instructions
+    bool runBlocks = FALSE;	// run user code a basic block at a time
+    bool jit = FALSE;		// compile hot blocks to host code
+    bool batchTicks = FALSE;	// only check interrupts when one is due
+    bool parallel = FALSE;	// run other CPUs' user code on host threads
+#ifdef USE_TLB
+    int tlbEntries = TLBSize;	// number of TLB entries (0 => page table)
+#else
+    int tlbEntries = 0;
+#endif
+    int tlbWays = TLBWays;	// TLB associativity
+    bool superPages = FALSE;	// map aligned runs of pages as superpages
+    int profileTicks = 0;	// user ticks between PC samples (0: none)
+    int l1Size = 0;		// bytes in each L1 cache (0: no cache model),
+    int l1Line = 0, l1Ways = 0;	// their shape,
+    int l1Penalty = 0;		// and the ticks a miss costs
+    int remoteTicks = 0;	// extra ticks for a remote memory access
+    char *checkpointFile = NULL;	// where to save the user program,
+    int checkpointTicks = 0;	// and when
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    DiskSchedulingPolicy diskPolicy = CLOOKDiskScheduling;
+    int cacheSize = DefaultCacheSize;	// sectors in the sector cache
+    int numDisks = 1;			// disks striped together
+    char *diskMap = NULL;	// where to write the disk heatmap
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     double order = 1;           // network orderability
     int netname = 0;		// UNIX socket name
+    int rxRing = DefaultRxRing;	// packets the network device can hold
+    bool coalesce = FALSE;	// put several messages in a packet
+    int flowCredits = 0;	// messages one machine may have waiting
+				// in each box of another; 0 for no limit
+    int edfPeriod = 0;		// real-time parameters for the threads
+    int edfDeadline = 0, edfBudget = 0;	// delivering messages
 #endif
     
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
@@ -108,15 +153,166 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-record")) {
+	    ASSERT(argc > 1);
+	    RecordHostEvents(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-replay")) {
+	    ASSERT(argc > 1);
+	    ReplayHostEvents(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-mlfq"))
+	    feedback = TRUE;
+	else if (!strcmp(*argv, "-stride"))
+	    stride = TRUE;
+	else if (!strcmp(*argv, "-tickless"))
+	    tickless = TRUE;
+	else if (!strcmp(*argv, "-lockstat"))
+	    lockStats = TRUE;
+	else if (!strcmp(*argv, "-S"))
+	    perThreadStats = TRUE;
+	else if (!strcmp(*argv, "-trace")) {
+	    ASSERT(argc > 1);
+	    TraceInit(*(argv + 1));		// see trace.cc
+	    argCount = 2;
+	}
+	else if (!strcmp(*argv, "-smp")) {
+	    ASSERT(argc > 1);
+	    numCPUs = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-numa")) {
+	    ASSERT(argc > 2);
+	    numNodes = atoi(*(argv + 1));	// see Machine::SetNUMA
+	    ASSERT(numNodes > 0);
+#ifdef USER_PROGRAM
+	    remoteTicks = atoi(*(argv + 2));	// (only user memory is timed)
+#endif
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-quantum")) {
+	    ASSERT(argc > 1);
+	    timerTicks = atoi(*(argv + 1));
+	    ASSERT(timerTicks > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-usertick")) {
+	    ASSERT(argc > 1);
+	    userTick = atoi(*(argv + 1));
+	    ASSERT(userTick > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-systick")) {
+	    ASSERT(argc > 1);
+	    systemTick = atoi(*(argv + 1));
+	    ASSERT(systemTick > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-intcost")) {
+	    ASSERT(argc > 1);
+	    interruptTicks = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-switchcost")) {
+	    ASSERT(argc > 1);
+	    switchTicks = atoi(*(argv + 1));
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	if (!strcmp(*argv, "-dc"))
+	    cacheDecoded = TRUE;
+	if (!strcmp(*argv, "-bb"))
+	    runBlocks = TRUE;
+	if (!strcmp(*argv, "-jit"))
+	    runBlocks = jit = TRUE;
+	if (!strcmp(*argv, "-bt"))
+	    batchTicks = TRUE;
+	if (!strcmp(*argv, "-hp"))
+	    parallel = TRUE;			// see mipspar.cc
+	if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    tlbEntries = atoi(*(argv + 1));
+	    if ((tlbEntries < 0) || (tlbEntries == 1)) {
+		printf("Usage: -tlb <entries>, with 0 for no TLB, or at "
+		       "least 2\n");	// see Machine::Machine
+		Exit(1);
+	    }
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlbways")) {
+	    ASSERT(argc > 1);
+	    tlbWays = atoi(*(argv + 1));
+	    if (tlbWays < 2) {
+		printf("Usage: -tlbways <ways>, with at least 2\n");
+		Exit(1);
+	    }
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-super"))
+	    superPages = TRUE;			// see translate.h
+	else if (!strcmp(*argv, "-prof")) {
+	    ASSERT(argc > 1);
+	    profileTicks = atoi(*(argv + 1));	// see profile.h
+	    ASSERT(profileTicks > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-l1")) {
+	    ASSERT(argc > 4);
+	    l1Size = atoi(*(argv + 1));		// see memcache.h
+	    l1Line = atoi(*(argv + 2));
+	    l1Ways = atoi(*(argv + 3));
+	    l1Penalty = atoi(*(argv + 4));
+	    argCount = 5;
+	} else if (!strcmp(*argv, "-ckpt")) {
+	    ASSERT(argc > 2);
+	    checkpointTicks = atoi(*(argv + 1));	// see checkpoint.h
+	    checkpointFile = *(argv + 2);
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-mem")) {
+	    ASSERT(argc > 1);
+	    numPhysPages = atoi(*(argv + 1));	// see machine.h
+	    ASSERT(numPhysPages > 0);
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-ds")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fifo"))
+		diskPolicy = FIFODiskScheduling;
+	    else if (!strcmp(*(argv + 1), "sstf"))
+		diskPolicy = SSTFDiskScheduling;
+	    else if (!strcmp(*(argv + 1), "scan"))
+		diskPolicy = SCANDiskScheduling;
+	    else if (!strcmp(*(argv + 1), "clook"))
+		diskPolicy = CLOOKDiskScheduling;
+	    else
+		printf("Unknown disk scheduling policy %s, using clook\n",
+		       *(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cache")) {
+	    ASSERT(argc > 1);
+	    cacheSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-raid")) {
+	    ASSERT(argc > 1);
+	    numDisks = atoi(*(argv + 1));	// see SynchDisk::SynchDisk
+	    ASSERT((numDisks > 0) && (numDisks <= MaxDisks));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tracks")) {
+	    ASSERT(argc > 1);
+	    numTracks = atoi(*(argv + 1));	// see Disk::Disk
+	    ASSERT(numTracks > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-diskmap")) {
+	    ASSERT(argc > 1);
+	    diskMap = *(argv + 1);		// see Statistics::PrintDisk
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-mmap"))
+	    mapDisk = TRUE;			// see Disk::Disk
+	else if (!strcmp(*argv, "-ssd"))
+	    diskModel = FlashDisk;		// see Disk::RunLatency
+	else if (!strcmp(*argv, "-lfs"))
+	    logStructured = TRUE;		// see FileSystem::FileSystem
+
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-n")) {
 	    ASSERT(argc > 1);
@@ -130,16 +326,53 @@ Initialize(int argc, char **argv)
 	    ASSERT(argc > 1);
 	    netname = atoi(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-rx")) {
+	    ASSERT(argc > 1);
+	    rxRing = atoi(*(argv + 1));
+	    ASSERT(rxRing > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-coalesce"))
+	    coalesce = TRUE;
+	else if (!strcmp(*argv, "-fc")) {
+	    ASSERT(argc > 1);
+	    flowCredits = atoi(*(argv + 1));	// see PostOffice::SetFlowControl
+	    ASSERT((flowCredits > 0) && (flowCredits <= MaxFlowWindow));
+	    argCount = 2;
+	}
+	else if (!strcmp(*argv, "-edf")) {
+	    ASSERT(argc > 3);
+	    edfPeriod = atoi(*(argv + 1));	// see Scheduler::SetRealTime
+	    edfDeadline = atoi(*(argv + 2));
+	    edfBudget = atoi(*(argv + 3));
+	    ASSERT((edfPeriod > 0) && (edfDeadline > 0) && (edfBudget > 0));
+	    edf = TRUE;
+	    argCount = 4;
+	}
+	else if (!strcmp(*argv, "-hosts")) {
+	    ASSERT(argc > 1);
+	    ReadHostMap(*(argv + 1));		// see sysdep.cc
+	    argCount = 2;
 	}
 #endif
     }
 
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
+    stats->lockStats = lockStats;
+    stats->perThread = perThreadStats;
     interrupt = new Interrupt;			// start up interrupt handling
+    interrupt->SetTickless(tickless);
     scheduler = new Scheduler();		// initialize the ready queue
-    if (randomYield)				// start the timer (if needed)
+    if (feedback)
+	scheduler->SetPolicy(FeedbackScheduling);
+    else if (stride)
+	scheduler->SetPolicy(StrideScheduling);
+    scheduler->SetCPUs(numCPUs);
+    scheduler->SetNodes(numNodes);
+    if (randomYield || feedback || stride || edf)	// start the timer
+								// (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
+    alarmClock = new Alarm();
 
     threadToBeDestroyed = NULL;
 
@@ -153,11 +386,32 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    if (tlbWays > tlbEntries)			// a single, fully associative set
+	tlbWays = tlbEntries;
+    machine = new Machine(debugUserProg, cacheDecoded, runBlocks,
+		batchTicks, tlbEntries, tlbWays);	// this must come first
+    machine->SetProfiling(profileTicks);
+    if (jit)
+	machine->EnableJIT();
+    if (l1Size > 0)
+	machine->SetCaches(l1Size, l1Line, l1Ways, l1Penalty);
+    machine->SetNUMA(numNodes, remoteTicks);
+    if (superPages)
+	machine->EnableSuperPages();
+    if (parallel && !machine->SetParallel()) {
+	printf("Usage: -hp, with -smp <CPUs> of at least 2 and -bt, and "
+	       "no -tlb, -dc, -bb, -l1 or -numa\n");
+	Exit(1);
+    }
+    if (checkpointFile != NULL)
+	ScheduleCheckpoint(checkpointFile, checkpointTicks);
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    stats->diskMapFile = diskMap;
+    synchDisk = new SynchDisk("DISK", numDisks);
+    synchDisk->SetPolicy(diskPolicy);
+    synchDisk->SetCacheSize(cacheSize);
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -165,7 +419,12 @@ Initialize(int argc, char **argv)
 #endif
 
 #ifdef NETWORK
-    postOffice = new PostOffice(netname, rely, order, 10);
+    postOffice = new PostOffice(netname, rely, order, 10, rxRing);
+    postOffice->SetCoalescing(coalesce);
+    if (flowCredits > 0)
+	postOffice->SetFlowControl(flowCredits);
+    if (edf && !postOffice->SetRealTime(edfPeriod, edfDeadline, edfBudget))
+	printf("Not enough CPU for real-time message delivery\n");
 #endif
 }
 
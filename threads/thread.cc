@@ -24,6 +24,168 @@
 					// execution stack, for detecting 
 					// stack overflows
 
+// Getting an execution stack from the host is expensive -- an allocation
+// plus two mprotect calls to fence it (see AllocBoundedArray) -- and
+// threads are created and finished constantly, so when a thread is
+// deleted we keep its stack, still fenced, for the next Fork.
+//
+// Since threads can ask for different stack sizes, stacks are pooled
+// by size class: class i holds stacks of MinStackSize << i words, and
+// a request is rounded up to the size of its class.  Stacks bigger
+// than the largest class are not pooled.
+
+#define StackPoolSize	32		// most stacks kept per class
+#define NumStackClasses	6		// MinStackSize up to 32 times that
+
+static int *stackPool[NumStackClasses][StackPoolSize];
+					// stacks free for reuse
+static int stackPoolCount[NumStackClasses];	// how many there are
+
+// The Thread objects themselves come and go just as often, so their
+// storage is pooled too, in slabs.  A deleted thread's storage keeps
+// its stack, which the next Thread made in it takes over, so a thread
+// forked in the place of one that has finished costs neither the host
+// allocator nor even a trip to the stack pool.  The most recently
+// freed storage is used first, so the object and the stack are the
+// ones most likely to still be in the host's cache.
+
+#define ThreadSlabSize	16		// Thread objects allocated from the
+					// host at a time
+
+class FreeThread {			// the storage of a deleted Thread
+  public:
+    FreeThread *next;			// the next one in the pool
+    int *stack;				// the stack it kept, or NULL
+    int stackSize;			// its size, in words
+};
+
+static FreeThread *freeThreads = NULL;	// Thread storage not in use
+static int numKeptStacks = 0;		// stacks kept in it, at most
+					// StackPoolSize
+
+// A stack on its way between a Thread and its storage: from the
+// destructor to operator delete, and from operator new to the
+// constructor.  Each pair is called back to back, by one "delete" or
+// "new" expression.
+
+static int *handedStack = NULL;
+static int handedStackSize = 0;
+
+//----------------------------------------------------------------------
+// StackClass
+//	Return the size class for a stack of "size" words, rounding "size"
+//	up to the size of the class; -1 if it is too big for any class.
+//----------------------------------------------------------------------
+
+static int
+StackClass(int *size)
+{
+    int which, classSize = MinStackSize;
+
+    for (which = 0; which < NumStackClasses; which++, classSize <<= 1)
+	if (*size <= classSize) {
+	    *size = classSize;
+	    return which;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// GetStack, PutStack
+//	Take an execution stack of "size" words from the pool, allocating
+//	a new one only if there is none of that class; and give one back
+//	to the pool, or to the host if the pool is full.
+//----------------------------------------------------------------------
+
+static int *
+GetStack(int size)
+{
+    int which = StackClass(&size);
+
+    if ((which >= 0) && (stackPoolCount[which] > 0)) {
+	stats->numStackPoolHits++;
+	return stackPool[which][--stackPoolCount[which]];
+    }
+    stats->numStackPoolMisses++;
+    return (int *) AllocBoundedArray(size * sizeof(_int));
+}
+
+static void
+PutStack(int *stack, int size)
+{
+    int which = StackClass(&size);
+
+    if ((which >= 0) && (stackPoolCount[which] < StackPoolSize))
+	stackPool[which][stackPoolCount[which]++] = stack;
+    else
+	DeallocBoundedArray((char *) stack, size * sizeof(_int));
+}
+
+//----------------------------------------------------------------------
+// Thread::operator new
+// 	Allocate the storage for a thread: the most recently freed one,
+//	if there is any, or else one of a new slab from the host (the
+//	rest go in the pool).  If it kept the stack of the thread that
+//	had it, hand that to the constructor.
+//
+//	No locking is needed, as nothing in here can cause a context
+//	switch.
+//----------------------------------------------------------------------
+
+void *
+Thread::operator new(size_t size)
+{
+    FreeThread *t;
+
+    ASSERT(size == sizeof(Thread));
+    if (freeThreads == NULL) {
+	char *slab = new char[ThreadSlabSize * size];
+
+	stats->numThreadPoolMisses++;
+	for (int i = 0; i < ThreadSlabSize; i++) {
+	    t = (FreeThread *) (slab + i * size);
+	    t->next = freeThreads;
+	    t->stack = NULL;
+	    freeThreads = t;
+	}
+    } else
+	stats->numThreadPoolHits++;
+    t = freeThreads;
+    freeThreads = t->next;
+    if (t->stack != NULL) {
+	numKeptStacks--;
+	handedStack = t->stack;
+	handedStackSize = t->stackSize;
+    }
+    return (void *) t;
+}
+
+//----------------------------------------------------------------------
+// Thread::operator delete
+// 	Put the storage for a thread back in the pool, along with the
+//	stack the destructor handed over, if any.  Only so many stacks
+//	are kept this way; the rest go back to the stack pool.
+//----------------------------------------------------------------------
+
+void
+Thread::operator delete(void *ptr)
+{
+    FreeThread *t = (FreeThread *) ptr;
+
+    t->stack = NULL;
+    if (handedStack != NULL) {
+	if (numKeptStacks < StackPoolSize) {
+	    numKeptStacks++;
+	    t->stack = handedStack;
+	    t->stackSize = handedStackSize;
+	} else
+	    PutStack(handedStack, handedStackSize);
+	handedStack = NULL;
+    }
+    t->next = freeThreads;
+    freeThreads = t;
+}
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -32,14 +194,26 @@
 //	"threadName" is an arbitrary string, useful for debugging.
 //----------------------------------------------------------------------
 
-Thread::Thread(char* threadName)
+Thread::Thread(const char* threadName)
 {
-    name = threadName;
+    name = (char*)threadName;
     stackTop = NULL;
-    stack = NULL;
+    stack = handedStack;		// kept by the storage, if any
+    stackSize = handedStackSize;
+    handedStack = NULL;
     status = JUST_CREATED;
+    level = 0;
+    cpu = -1;
+    affinity = -1;
+    account = stats->NewThread(name);
+    readySince = stats->totalTicks;
+    realTime = NULL;
 #ifdef USER_PROGRAM
     space = NULL;
+    userPreempted = FALSE;
+    userPageTable = NULL;
+    userPageDirectory = NULL;
+    userPageTableSize = 0;
 #endif
 }
 
@@ -60,8 +234,18 @@ Thread::~Thread()
     DEBUG('t', "Deleting thread \"%s\"\n", name);
 
     ASSERT(this != currentThread);
-    if (stack != NULL)
-		DeallocBoundedArray((char *) stack, StackSize * sizeof(_int));
+    if (realTime != NULL)
+	scheduler->SetRealTime(this, 0, 0, 0);	// give back its load
+    stats->EndThread(account);
+    if (stack != NULL) {
+	int size = stackSize;
+
+	if (StackClass(&size) >= 0)
+	    handedStack = stack;	// keep it with the storage (see
+	else				// operator delete)
+	    PutStack(stack, stackSize);
+	handedStackSize = stackSize;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -75,19 +259,29 @@ Thread::~Thread()
 //	to the structure as "arg".
 //
 // 	Implemented as the following steps:
-//		1. Allocate a stack
+//		1. Allocate a stack (reusing the one kept by the
+//		thread's storage, or that of another deleted thread,
+//		if there is one)
 //		2. Initialize the stack so that a call to SWITCH will
 //		cause it to run the procedure
 //		3. Put the thread on the ready queue
 // 	
 //	"func" is the procedure to run concurrently.
 //	"arg" is a single argument to be passed to the procedure.
+//	"size" is the size of its stack, in words: a thread that doesn't
+//	need much can ask for a smaller stack than the default StackSize
 //----------------------------------------------------------------------
 
 void 
 Thread::Fork(VoidFunctionPtr func, _int arg)
 {
-#ifdef HOST_ALPHA
+    Fork(func, arg, StackSize);
+}
+
+void 
+Thread::Fork(VoidFunctionPtr func, _int arg, int size)
+{
+#ifdef HOST_64BIT
     DEBUG('t', "Forking thread \"%s\" with func = 0x%lx, arg = %ld\n",
 	  name, (long) func, arg);
 #else
@@ -95,7 +289,8 @@ Thread::Fork(VoidFunctionPtr func, _int arg)
 	  name, (int) func, arg);
 #endif
     
-    StackAllocate(func, arg);
+    ASSERT(size > 0);
+    StackAllocate(func, arg, size);
 
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
     scheduler->ReadyToRun(this);	// ReadyToRun assumes that interrupts 
@@ -123,7 +318,7 @@ Thread::CheckOverflow()
 {
     if (stack != NULL)
 #ifdef HOST_SNAKE			// Stacks grow upward on the Snakes
-	ASSERT((unsigned int)stack[StackSize - 1] == STACK_FENCEPOST);
+	ASSERT((unsigned int)stack[stackSize - 1] == STACK_FENCEPOST);
 #else
 	ASSERT((unsigned int)*stack == STACK_FENCEPOST);
 #endif
@@ -230,6 +425,21 @@ Thread::Sleep ()
     scheduler->Run(nextThread); // returns when we've been signalled
 }
 
+//----------------------------------------------------------------------
+// Thread::SleepFor
+// 	Relinquish the CPU until "ticks" of simulated time have passed,
+//	on the alarm clock (see alarm.h), rather than spinning with Yield:
+//	the thread is not on the ready list until its time comes.
+//----------------------------------------------------------------------
+
+void
+Thread::SleepFor(int ticks)
+{
+    ASSERT(this == currentThread);
+    
+    alarmClock->SleepUntil(stats->totalTicks + ticks);
+}
+
 //----------------------------------------------------------------------
 // ThreadFinish, InterruptEnable, ThreadPrint
 //	Dummy functions because C++ does not allow a pointer to a member
@@ -252,24 +462,35 @@ void ThreadPrint(_int arg){ Thread *t = (Thread *)arg; t->Print(); }
 //
 //	"func" is the procedure to be forked
 //	"arg" is the parameter to be passed to the procedure
+//	"size" is how big the stack must be, in words
 //----------------------------------------------------------------------
 
 void
-Thread::StackAllocate (VoidFunctionPtr func, _int arg)
+Thread::StackAllocate (VoidFunctionPtr func, _int arg, int size)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(_int));
+    (void) StackClass(&size);		// all of its class is ours to use
+    if ((stack != NULL) && (stackSize != size)) {
+	PutStack(stack, stackSize);	// the kept one is the wrong size
+	stack = NULL;
+    }
+    if (stack != NULL)
+	stats->numStackPoolHits++;
+    else {
+	stackSize = size;
+	stack = GetStack(stackSize);
+    }
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
     stackTop = stack + 16;	// HP requires 64-byte frame marker
-    stack[StackSize - 1] = STACK_FENCEPOST;
+    stack[stackSize - 1] = STACK_FENCEPOST;
 #else
     // i386 & MIPS & SPARC & ALPHA stack works from high addresses to low addresses
 #ifdef HOST_SPARC
     // SPARC stack must contains at least 1 activation record to start with.
-    stackTop = stack + StackSize - 96;
-#else  // HOST_MIPS  || HOST_i386 || HOST_ALPHA
-    stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
+    stackTop = stack + stackSize - 96;
+#else  // HOST_MIPS  || HOST_i386 || HOST_x86_64 || HOST_ALPHA
+    stackTop = stack + stackSize - 4;	// -4 to be on the safe side!
 #ifdef HOST_i386
     // the 80386 passes the return address on the stack.  In order for
     // SWITCH() to go to ThreadRoot when we switch to this thread, the
@@ -370,13 +591,27 @@ Thread::StackAllocate (VoidFunctionPtr func, _int arg)
 //	Note that a user program thread has *two* sets of CPU registers -- 
 //	one for its state while executing user code, one for its state 
 //	while executing kernel code.  This routine saves the former.
+//
+//	The translations it was using are noted too, so that a helper CPU
+//	can run its code while it is switched out (see mipspar.cc).
+//
+//	"processor" -- the machine it was running on, if not the main one
 //----------------------------------------------------------------------
 
 void
 Thread::SaveUserState()
+{
+    SaveUserState(machine);
+}
+
+void
+Thread::SaveUserState(Machine *processor)
 {
     for (int i = 0; i < NumTotalRegs; i++)
-	userRegisters[i] = machine->ReadRegister(i);
+	userRegisters[i] = processor->ReadRegister(i);
+    userPageTable = processor->pageTable;
+    userPageDirectory = processor->pageDirectory;
+    userPageTableSize = processor->pageTableSize;
 }
 
 //----------------------------------------------------------------------
@@ -386,12 +621,22 @@ Thread::SaveUserState()
 //	Note that a user program thread has *two* sets of CPU registers -- 
 //	one for its state while executing user code, one for its state 
 //	while executing kernel code.  This routine restores the former.
+//	The translations are the address space's to restore (see
+//	AddrSpace::RestoreState); a helper CPU is given them by its caller.
+//
+//	"processor" -- the machine to run it on, if not the main one
 //----------------------------------------------------------------------
 
 void
 Thread::RestoreUserState()
+{
+    RestoreUserState(machine);
+}
+
+void
+Thread::RestoreUserState(Machine *processor)
 {
     for (int i = 0; i < NumTotalRegs; i++)
-	machine->WriteRegister(i, userRegisters[i]);
+	processor->WriteRegister(i, userRegisters[i]);
 }
 #endif
@@ -39,6 +39,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "stats.h"
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -54,12 +55,32 @@
 
 // Size of the thread's private execution stack.
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
-#define StackSize	(sizeof(_int) * 1024)	// in words
+#define StackSize	(sizeof(_int) * 1024)	// in words, by default
+#define MinStackSize	256			// smallest we hand out
 
 
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 
+// The parameters of a real-time thread (see Scheduler::SetRealTime),
+// all in ticks, and where the job it is running is up to.  Each time
+// the thread wakes up, it starts a job that must be done (that is,
+// the thread must block again) "deadline" ticks later, using at most
+// "budget" ticks of CPU; it starts at most one job every "period".
+
+class RealTime {
+  public:
+    int period;			// the least time between job starts
+    int deadline;		// how long after it starts a job is due
+    int budget;			// the CPU time a job may use
+    int load;			// budget / min(deadline, period), per mille
+
+    int jobDeadline;		// when the current job is due
+    int budgetLeft;		// the CPU time it has left
+    int nextRelease;		// the earliest the next job may start
+    bool jobDone;		// is the thread waiting for its next job?
+};
+
 // external function, dummy routine whose sole job is to call Thread::Print
 extern void ThreadPrint(_int arg);	 
 
@@ -82,37 +103,68 @@ class Thread {
     _int machineState[MachineStateSize];  // all registers except for stackTop
 
   public:
-    Thread(char* debugName);		// initialize a Thread 
+    Thread(const char* debugName);	// initialize a Thread 
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
 					// must not be running when delete 
 					// is called
+    static void *operator new(size_t size);	// take one from the pool
+    static void operator delete(void *ptr);	// put it back
 
     // basic thread operations
 
     void Fork(VoidFunctionPtr func, _int arg); 	// Make thread run (*func)(arg)
+    void Fork(VoidFunctionPtr func, _int arg, int size);
+						// ... on a stack of "size" words
     void Yield();  				// Relinquish the CPU if any 
 						// other thread is runnable
     void Sleep();  				// Put the thread to sleep and 
 						// relinquish the processor
+    void SleepFor(int ticks);			// Sleep until "ticks" of
+						// simulated time have passed
     void Finish();  				// The thread is done executing
     
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
+    ThreadStatus getStatus() { return status; }
+    int getLevel() { return level; }	// feedback queue level (see
+    void setLevel(int l) { level = l; }	// scheduler.h)
+    int getCPU() { return cpu; }	// the CPU it last ran on, or -1
+    void setCPU(int c) { cpu = c; }
+    int getAffinity() { return affinity; }	// the CPUs it may run on,
+    void setAffinity(int mask) { affinity = mask; }	// a bit for each
     char* getName() { return (name); }
     void Print() { printf("%s, ", name); }
 
+    Thread *queueNext;			// the next thread on the ThreadQueue
+					// this one is on (see threadqueue.h)
+    int queueKey;			// its key there, if sorted
+
+    ThreadStats *account;		// the CPU time charged to it, etc.
+					// (see Scheduler::Run)
+    int readySince;			// when it was last put on the
+					// ready list
+    RealTime *realTime;			// its real-time parameters, or
+					// NULL if it is not real-time
+
   private:
     // some of the private data for this class is listed above
     
     int* stack; 	 		// Bottom of the stack 
 					// NULL if this is the main thread
 					// (If NULL, don't deallocate stack)
+					// May be set before Fork, if the
+					// storage came with a kept stack
+    int stackSize;			// size of the stack, in words
     ThreadStatus status;		// ready, running or blocked
+    int level;				// its level in the ready queue
+    int cpu;				// the CPU whose queue it is on
+    int affinity;			// bit c set if it may run on CPU c
+					// (all set, to begin with)
     char* name;
 
-    void StackAllocate(VoidFunctionPtr func, _int arg);
+    void StackAllocate(VoidFunctionPtr func, _int arg, int size);
     					// Allocate a stack for thread.
 					// Used internally by Fork()
 
@@ -126,8 +178,17 @@ class Thread {
   public:
     void SaveUserState();		// save user-level register state
     void RestoreUserState();		// restore user-level register state
+    void SaveUserState(Machine *processor);	// ... the same, from and
+    void RestoreUserState(Machine *processor);	// to a helper CPU (see
+						// mipspar.cc)
 
     AddrSpace *space;			// User code this thread is running.
+    bool userPreempted;			// switched out between two of its
+					// user instructions, so the rest can
+					// be run ahead of it (see mipspar.cc)
+    TranslationEntry *userPageTable;	// the translations it was running
+    TranslationEntry **userPageDirectory;	// with, saved with its
+    unsigned int userPageTableSize;		// registers
 #endif
 };
 
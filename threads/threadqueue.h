@@ -0,0 +1,131 @@
+// threadqueue.h 
+//	Data structures for queues of threads: the ready list, and the
+//	threads waiting on a semaphore, lock or condition.
+//
+//	A List (list.h) allocates a ListElement for every item put on it,
+//	and frees it when the item comes off, which would put the heap
+//	allocator on every context switch and every time a thread blocks.
+//	But a thread is never on more than one of these queues at a time,
+//	so the link can simply live in the Thread itself (see queueNext
+//	in thread.h): putting a thread on a ThreadQueue, or taking it off,
+//	allocates nothing.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef THREADQUEUE_H
+#define THREADQUEUE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "thread.h"
+
+// The following class defines a queue of threads, linked through the
+// threads themselves.  It has the same operations as List, except that
+// the items are Threads.
+
+class ThreadQueue {
+  public:
+    ThreadQueue() { first = last = NULL; }	// initialize the queue
+
+    void Append(Thread *thread);	// put thread at the end
+    void Prepend(Thread *thread);	// put thread at the beginning
+    Thread *Remove();			// take the first thread off, or
+					// return NULL if there is none
+    bool Remove(Thread *thread);	// take thread off, wherever it is;
+					// FALSE if it wasn't on the queue
+    bool IsEmpty() { return (bool)(first == NULL); }
+    Thread *First() { return first; }	// the first thread, without
+					// taking it off (the rest follow
+					// it, through queueNext)
+    void Mapcar(VoidFunctionPtr func);	// apply "func" to every thread
+
+    void SortedInsert(Thread *thread, int sortKey);
+					// put thread in order by
+					// "sortKey", after any equal ones
+
+  private:
+    Thread *first;			// head of the queue, NULL if empty
+    Thread *last;			// last thread on the queue
+};
+
+inline void
+ThreadQueue::Append(Thread *thread)
+{
+    thread->queueNext = NULL;
+    if (first == NULL)
+	first = thread;
+    else
+	last->queueNext = thread;
+    last = thread;
+}
+
+inline void
+ThreadQueue::Prepend(Thread *thread)
+{
+    thread->queueNext = first;
+    if (first == NULL)
+	last = thread;
+    first = thread;
+}
+
+inline Thread *
+ThreadQueue::Remove()
+{
+    Thread *thread = first;
+
+    if (thread != NULL) {
+	first = thread->queueNext;
+	if (first == NULL)
+	    last = NULL;
+	thread->queueNext = NULL;
+    }
+    return thread;
+}
+
+inline bool
+ThreadQueue::Remove(Thread *thread)
+{
+    Thread *prev = NULL, *t;
+
+    for (t = first; (t != NULL) && (t != thread); t = t->queueNext)
+	prev = t;
+    if (t == NULL)
+	return FALSE;
+    if (prev == NULL)
+	first = t->queueNext;
+    else
+	prev->queueNext = t->queueNext;
+    if (last == t)
+	last = prev;
+    t->queueNext = NULL;
+    return TRUE;
+}
+
+inline void
+ThreadQueue::Mapcar(VoidFunctionPtr func)
+{
+    for (Thread *t = first; t != NULL; t = t->queueNext)
+	(*func)((_int) t);
+}
+
+inline void
+ThreadQueue::SortedInsert(Thread *thread, int sortKey)
+{
+    Thread *prev = NULL, *t;
+
+    thread->queueKey = sortKey;
+    for (t = first; (t != NULL) && (t->queueKey <= sortKey); t = t->queueNext)
+	prev = t;
+    if (prev == NULL)
+	Prepend(thread);
+    else if (t == NULL)
+	Append(thread);
+    else {
+	thread->queueNext = t;
+	prev->queueNext = thread;
+    }
+}
+
+#endif // THREADQUEUE_H
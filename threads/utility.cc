@@ -13,7 +13,7 @@
 // if you have problems with va_start, try both of these alternatives
 #include <stdarg.h>
 
-static char *enableFlags = NULL; // controls which DEBUG messages are printed 
+bool debugEnabled[256];		// controls which DEBUG messages are printed
 
 //----------------------------------------------------------------------
 // DebugInit
@@ -22,6 +22,9 @@ static char *enableFlags = NULL; // controls which DEBUG messages are printed
 //
 //	If the flag is "+", we enable all DEBUG messages.
 //
+//	The flags are kept as a table, so that DEBUG (a macro, see
+//	utility.h) can check one without a call, or a search of the list.
+//
 // 	"flagList" is a string of characters for whose DEBUG messages are 
 //		to be enabled.
 //----------------------------------------------------------------------
@@ -29,39 +32,34 @@ static char *enableFlags = NULL; // controls which DEBUG messages are printed
 void
 DebugInit(char *flagList)
 {
-    enableFlags = flagList;
-}
-
-//----------------------------------------------------------------------
-// DebugIsEnabled
-//      Return TRUE if DEBUG messages with "flag" are to be printed.
-//----------------------------------------------------------------------
+    int i;
 
-bool
-DebugIsEnabled(char flag)
-{
-    if (enableFlags != NULL)
-       return (bool)((strchr(enableFlags, flag) != 0) 
-		|| (strchr(enableFlags, '+') != 0));
-    else
-      return FALSE;
+    for (i = 0; i < 256; i++)
+	debugEnabled[i] = FALSE;
+    if (flagList == NULL)
+	return;
+    if (strchr(flagList, '+') != NULL) {
+	for (i = 0; i < 256; i++)
+	    debugEnabled[i] = TRUE;
+	return;
+    }
+    for (char *f = flagList; *f != '\0'; f++)
+	debugEnabled[(unsigned char) *f] = TRUE;
 }
 
 //----------------------------------------------------------------------
-// DEBUG
-//      Print a debug message, if flag is enabled.  Like printf,
-//	only with an extra argument on the front.
+// DebugPrint
+//      Print a debug message, whose flag DEBUG has found enabled.  Like
+//	printf.
 //----------------------------------------------------------------------
 
 void 
-DEBUG(char flag, const char *format, ...)
+DebugPrint(const char *format, ...)
 {
-    if (DebugIsEnabled(flag)) {
-	va_list ap;
-	// You will get an unused variable message here -- ignore it.
-	va_start(ap, format);
-	vfprintf(stdout, format, ap);
-	va_end(ap);
-	fflush(stdout);
-    }
+    va_list ap;
+    // You will get an unused variable message here -- ignore it.
+    va_start(ap, format);
+    vfprintf(stdout, format, ap);
+    va_end(ap);
+    fflush(stdout);
 }
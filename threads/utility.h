@@ -25,9 +25,10 @@
 
 #include "copyright.h"
 
-#ifdef HOST_ALPHA		// Needed because of gcc uses 64 bit pointers and
-#define _int long		// 32 bit integers on the DEC ALPHA architecture.
-#else
+#if defined(HOST_ALPHA) || defined(HOST_x86_64)
+#define HOST_64BIT		// Needed because of gcc uses 64 bit pointers and
+#define _int long		// 32 bit integers on the DEC ALPHA and x86-64
+#else				// architectures.
 #define _int int
 #endif
 
@@ -78,13 +79,33 @@ typedef void (*VoidNoArgFunctionPtr)();
 #include "sysdep.h"				
 
 // Interface to debugging routines.
+//
+// DEBUG is a macro, so that when its flag is off (as it nearly always
+// is) all it costs is a look in the table of enabled flags: the message
+// isn't formatted, its arguments aren't even evaluated, and there is no
+// call.  Compiling with -DNODEBUG ("make NODEBUG=1") leaves out the DEBUG
+// messages altogether; the compiler still checks them, but generates
+// no code for them.
 
 extern void DebugInit(char* flags);	// enable printing debug messages
 
-extern bool DebugIsEnabled(char flag); 	// Is this debug flag enabled?
+extern bool debugEnabled[256];		// which flags are enabled, by
+					// character
 
-extern void DEBUG (char flag, const char* format, ...);  	// Print debug message 
-							// if flag is enabled
+extern void DebugPrint(const char* format, ...);	// Print a debug message
+
+#ifdef NODEBUG
+#define DebugIsEnabled(flag)	FALSE
+#else
+#define DebugIsEnabled(flag)	(debugEnabled[(unsigned char) (flag)])
+#endif					// Is this debug flag enabled?
+
+#define DEBUG(flag, ...)						      \
+    do {								      \
+	if (DebugIsEnabled(flag))					      \
+	    DebugPrint(__VA_ARGS__);					      \
+    } while (0)				// Print debug message if flag is
+					// enabled
 
 //----------------------------------------------------------------------
 // ASSERT
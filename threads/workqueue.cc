@@ -0,0 +1,141 @@
+// workqueue.cc
+//	Routines for a kernel work queue.  See workqueue.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "workqueue.h"
+
+// Something queued, to be done.
+
+class WorkItem {
+  public:
+    VoidFunctionPtr func;		// what to call,
+    _int arg;				// and with what
+};
+
+//----------------------------------------------------------------------
+// WorkerThread
+// 	Dummy function because C++ does not allow a pointer to a member
+//	function: the body of each worker thread.
+//----------------------------------------------------------------------
+
+static void
+WorkerThread(_int arg)
+{
+    ((WorkQueue *) arg)->Work();
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::WorkQueue
+// 	Make an empty work queue, and fork its worker threads.
+//
+//	"debugName" is an arbitrary name, useful for debugging; the
+//		workers have the same name.
+//	"workers" is how many threads do the work: as many pieces of
+//		work as that can be going on at once.
+//----------------------------------------------------------------------
+
+WorkQueue::WorkQueue(const char *debugName, int workers)
+{
+    name = debugName;
+    work = new List;
+    workQueued = new Semaphore(debugName, 0);
+    lock = new Lock(debugName);
+    allDone = new Condition(debugName);
+    numWorkers = workers;
+    numBusy = 0;
+    for (int i = 0; i < numWorkers; i++)
+	(new Thread((char *) debugName))->Fork(WorkerThread, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::~WorkQueue
+// 	De-allocate a work queue.  Since the workers never finish, only
+//	one made without any can be.
+//----------------------------------------------------------------------
+
+WorkQueue::~WorkQueue()
+{
+    ASSERT(numWorkers == 0);
+    ASSERT(work->IsEmpty());
+    delete work;
+    delete workQueued;
+    delete lock;
+    delete allDone;
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::Queue
+// 	Have a worker call func(arg), after any work of the same or higher
+//	priority already queued.  Returns at once, without waiting, so
+//	that it can be called from an interrupt handler.
+//----------------------------------------------------------------------
+
+void
+WorkQueue::Queue(VoidFunctionPtr func, _int arg, int priority)
+{
+    WorkItem *item = new WorkItem;
+    IntStatus oldLevel;
+
+    item->func = func;
+    item->arg = arg;
+    DEBUG('t', "Queueing work on \"%s\", priority %d\n", name, priority);
+    oldLevel = interrupt->SetLevel(IntOff);
+    work->SortedInsert((void *) item, -priority);	// highest first
+    (void) interrupt->SetLevel(oldLevel);
+    workQueued->V();
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::Drain
+// 	Wait until everything queued has been done, and no worker is
+//	busy.  (Work queued meanwhile is waited for too.)
+//----------------------------------------------------------------------
+
+void
+WorkQueue::Drain()
+{
+    lock->Acquire();
+    while (!work->IsEmpty() || (numBusy > 0))
+	allDone->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::Work
+// 	The body of a worker: take the first thing off the queue, waiting
+//	if there is nothing, and do it; and so on for ever.  numBusy is
+//	changed under the lock, so that Drain sees it and the list change
+//	together.
+//----------------------------------------------------------------------
+
+void
+WorkQueue::Work()
+{
+    for (;;) {
+	WorkItem *item;
+	IntStatus oldLevel;
+
+	workQueued->P();
+	lock->Acquire();
+	oldLevel = interrupt->SetLevel(IntOff);
+	item = (WorkItem *) work->Remove();
+	(void) interrupt->SetLevel(oldLevel);
+	ASSERT(item != NULL);
+	numBusy++;
+	lock->Release();
+
+	(*item->func)(item->arg);
+	delete item;
+
+	lock->Acquire();
+	numBusy--;
+	if (work->IsEmpty() && (numBusy == 0))
+	    allDone->Broadcast(lock);
+	lock->Release();
+    }
+}
@@ -0,0 +1,68 @@
+// workqueue.h
+//	Data structures for a kernel work queue: deferred work, done by a
+//	fixed pool of worker threads.
+//
+//	Work that has to be done later, outside an interrupt handler or
+//	off the path of a system call -- a disk completion, flushing a
+//	cache, paging out, retransmitting a packet -- would otherwise
+//	each need a kernel thread of its own, with a stack, waiting for
+//	it.  Instead it can be queued here, as a function and an argument
+//	(like Thread::Fork), and one of the workers calls it.  However
+//	many kinds of work there are, the threads are bounded; and a
+//	worker that finds more queued when it is done goes straight on to
+//	it, without a context switch.
+//
+//	Work is done highest priority first, and in the order it was
+//	queued, within a priority.  Work should not wait for long (for
+//	other queued work, say), since it holds up a worker meanwhile.
+//
+//	Work can be queued from an interrupt handler: the list is
+//	protected by turning interrupts off, and the workers wait on a
+//	semaphore, which is V'ed for each piece of work, as SynchDisk
+//	does for each request done.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "list.h"
+#include "synch.h"
+
+#define WorkLow		-1		// priorities for Queue
+#define WorkNormal	0
+#define WorkHigh	1
+
+// The following class defines a work queue, and its worker threads.
+// The workers never finish, so a work queue lasts as long as the
+// kernel does.
+
+class WorkQueue {
+  public:
+    WorkQueue(const char *debugName, int workers);
+					// Fork the workers, with nothing to do
+    ~WorkQueue();			// Only if it has no workers
+
+    void Queue(VoidFunctionPtr func, _int arg, int priority = WorkNormal);
+					// Have a worker call func(arg)
+    void Drain();			// Wait until all the work queued
+					// has been done
+
+    void Work();			// What each worker does: never returns
+
+  private:
+    const char *name;			// useful for debugging
+    List *work;				// WorkItems, by priority; only
+					// touched with interrupts off
+    Semaphore *workQueued;		// V'ed for each WorkItem
+    Lock *lock;				// protects numBusy, for Drain
+    Condition *allDone;			// wait in Drain for it to be done
+    int numWorkers;			// the workers,
+    int numBusy;			// how many are doing something
+};
+
+#endif // WORKQUEUE_H
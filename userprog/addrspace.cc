@@ -19,6 +19,10 @@
 #include "system.h"
 #include "addrspace.h"
 #include "noff.h"
+#include "compressed.h"
+
+static int lastASID = 0;		// the ASID given to the last address
+					// space made (0 is none's)
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -42,6 +46,30 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// PagedBase
+// 	If "noffH" is the header of a paged NOFF file (see noff.h) laid
+//	out in pages of our PageSize, return where virtual address 0
+//	would be in the file, so that virtual page "p" is the PageSize
+//	bytes at PagedBase + p * PageSize.  Otherwise, return -1.
+//----------------------------------------------------------------------
+
+static int
+PagedBase(NoffHeader *noffH)
+{
+    int base = noffH->code.inFileAddr - noffH->code.virtualAddr;
+
+    if ((noffH->noffMagic != NOFFPAGEDMAGIC) || (NOFFPAGESIZE != PageSize))
+	return -1;
+    if (noffH->code.size == 0)
+	base = noffH->initData.inFileAddr - noffH->initData.virtualAddr;
+    if ((base % PageSize != 0) || ((noffH->initData.size > 0)
+	    && (noffH->initData.inFileAddr - noffH->initData.virtualAddr
+		!= base)))
+	return -1;
+    return base;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -54,6 +82,10 @@ SwapHeader (NoffHeader *noffH)
 //	memory.  For now, this is really simple (1:1), since we are
 //	only uniprogramming, and we have a single unsegmented page table
 //
+//	If the file is paged (see noff.h), the code and data are read in
+//	whole pages, in one go; if it is compressed, its pages are read
+//	in one go, and decompressed as they are copied in.
+//
 //	"executable" is the file containing the object code to load into memory
 //----------------------------------------------------------------------
 
@@ -61,12 +93,17 @@ AddrSpace::AddrSpace(OpenFile *executable)
 {
     NoffHeader noffH;
     unsigned int i, size;
+    int base;
 
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
+    if (!IsNoffMagic(noffH.noffMagic) && 
+		IsNoffMagic(WordToHost(noffH.noffMagic)))
     	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    ASSERT(IsNoffMagic(noffH.noffMagic));
+    profile = machine->IsProfiling() ?
+		new Profile(NULL, executable, &noffH) : NULL;
+    asid = ++lastASID;
+    cacheCounts = machine->CachesEnabled() ? new CacheCounts : NULL;
 
 // how big is address space?
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
@@ -75,7 +112,8 @@ AddrSpace::AddrSpace(OpenFile *executable)
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
 
-    ASSERT(numPages <= NumPhysPages);		// check we're not trying
+    ASSERT(numPages <= (unsigned int) numPhysPages);
+						// check we're not trying
 						// to run anything too big --
 						// at least until we have
 						// virtual memory
@@ -93,13 +131,36 @@ AddrSpace::AddrSpace(OpenFile *executable)
 	pageTable[i].readOnly = FALSE;  // if the code segment was entirely on 
 					// a separate page, we could set its 
 					// pages to be read-only
+	pageTable[i].superPage = FALSE;
     }
+    FindSuperPages();
     
 // zero out the entire address space, to zero the unitialized data segment 
 // and the stack segment
     bzero(machine->mainMemory, size);
+    machine->InvalidateDecodeCache(0, size);
 
 // then, copy in the code and data segments into memory
+    if (noffH.noffMagic == NOFFLZMAGIC) {
+	CompressedImage image(executable);
+
+	ASSERT(image.NumPages() <= (int) numPages);
+        DEBUG('a', "Initializing %d pages, from a compressed file\n",
+			image.NumPages());
+	if (image.NumPages() > 0)
+	    image.ReadPages(0, image.NumPages(), machine->mainMemory);
+	return;
+    }
+    if ((base = PagedBase(&noffH)) >= 0) {
+	int end = max(noffH.code.virtualAddr + noffH.code.size,
+		      noffH.initData.virtualAddr + noffH.initData.size);
+
+	end = min(divRoundUp(end, PageSize) * PageSize, (int) size);
+        DEBUG('a', "Initializing %d pages, from a paged file\n",
+			divRoundUp(end, PageSize));
+	executable->ReadAt(machine->mainMemory, end, base);
+	return;
+    }
     if (noffH.code.size > 0) {
         DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
 			noffH.code.virtualAddr, noffH.code.size);
@@ -115,16 +176,67 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create an address space with nothing in it, for a program being
+//	restored from a checkpoint (see RestoreProcess): the caller fills
+//	in the page table, and the memory it maps.
+//
+//	"pages" -- the size of the address space, in pages
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(int pages)
+{
+    ASSERT((pages > 0) && (pages <= numPhysPages));
+    numPages = pages;
+    profile = NULL;
+    asid = ++lastASID;
+    cacheCounts = machine->CachesEnabled() ? new CacheCounts : NULL;
+    pageTable = new TranslationEntry[pages];
+    for (int i = 0; i < pages; i++) {
+	pageTable[i].virtualPage = i;
+	pageTable[i].valid = FALSE;
+	pageTable[i].superPage = FALSE;
+    }
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space, and take its translations out of the
+//	TLB, if there is one.  If the L1 cache model is on, report how
+//	well our accesses did in it.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+    if (cacheCounts != NULL) {
+	PrintCacheCounts();
+	if (machine->cacheCounts == cacheCounts)
+	    machine->cacheCounts = NULL;
+	delete cacheCounts;
+    }
+    if (machine->tlb != NULL)
+	for (int i = 0; i < machine->tlbSize; i++)
+	    if (machine->tlbASID[i] == asid)
+		machine->tlb[i].valid = FALSE;
    delete [] pageTable;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::PrintCacheCounts
+// 	Print the hit rates of our instruction fetches, loads and stores
+//	in the L1 cache model.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PrintCacheCounts()
+{
+    char name[32];
+
+    sprintf(name, "address space %d", asid);
+    cacheCounts->Print(name);
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::InitRegisters
 // 	Set the initial values for the user-level register set.
@@ -162,11 +274,21 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	If there is a TLB, we save the use/dirty bits of each of our
+//	entries in it back into the page table.  The entries themselves
+//	stay: they are tagged with our ASID, so no other address space
+//	can use them, and if we run again before they are replaced, we
+//	find them there still.  (Until then, nothing sets their bits.)
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
-{}
+{
+    if (machine->tlb == NULL)
+	return;
+    for (int i = 0; i < machine->tlbSize; i++)
+	if (machine->tlb[i].valid && (machine->tlbASID[i] == asid))
+	    SyncTLBEntry(&machine->tlb[i]);
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
@@ -174,10 +296,142 @@ void AddrSpace::SaveState()
 //	this address space can run.
 //
 //      For now, tell the machine where to find the page table.
+//	With a TLB, the hardware never sees the page table: we just set
+//	the ASID register to ours, so that only our entries match, and
+//	the kernel refills the TLB on a miss (see ExceptionHandler).
+//	Either way, the last translations made were another space's.
+//	Our accesses through the L1 cache model are counted as ours.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
+    machine->FlushMicroTLB();
+    machine->cacheCounts = cacheCounts;
+    if (machine->tlb != NULL) {
+	machine->asid = asid;
+	return;
+    }
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
 }
+
+//----------------------------------------------------------------------
+// AddrSpace::PageTableEntry
+// 	Return this address space's translation for virtual page "vpn",
+//	for refilling the TLB.  Returns NULL if "vpn" is beyond the end
+//	of the address space.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::PageTableEntry(int vpn)
+{
+    if ((vpn < 0) || ((unsigned int)vpn >= numPages))
+	return NULL;
+    return &pageTable[vpn];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SyncTLBEntry
+// 	The TLB holds copies of page table entries, so the hardware
+//	sets the use and dirty bits in the copy.  Before a TLB entry
+//	is replaced or flushed, copy those bits back into the page table.
+//
+//	"entry" -- a valid TLB entry for this address space
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SyncTLBEntry(TranslationEntry *entry)
+{
+    int count = entry->superPage ? SuperPageSize : 1;
+
+    for (int i = 0; i < count; i++) {	// a superpage's bits go to
+	TranslationEntry *pte =		// every page of it
+	    PageTableEntry(entry->virtualPage + i);
+
+	ASSERT(pte != NULL);
+	if (entry->use)
+	    pte->use = TRUE;
+	if (entry->dirty)
+	    pte->dirty = TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MapPages
+// 	Grow the address space by "count" pages, after the stack, for the
+//	kernel to share with the program (see NetDoorbell).  As with the
+//	rest of the address space, virtual page # = phys page #, so their
+//	frames are the ones after ours; the kernel can reach them in
+//	mainMemory as long as we run.  Returns the first new page, or -1
+//	(changing nothing) if physical memory has no room for them.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::MapPages(int count)
+{
+    TranslationEntry *old = pageTable;
+    int first = numPages;
+
+    if (first + count > numPhysPages)
+	return -1;
+    pageTable = new TranslationEntry[first + count];
+    bcopy(old, pageTable, first * sizeof(TranslationEntry));
+    delete [] old;
+    for (int i = first; i < first + count; i++) {
+	pageTable[i].virtualPage = i;
+	pageTable[i].physicalPage = i;
+	pageTable[i].valid = TRUE;
+	pageTable[i].use = FALSE;
+	pageTable[i].dirty = FALSE;
+	pageTable[i].readOnly = FALSE;
+	pageTable[i].superPage = FALSE;
+    }
+    numPages = first + count;
+    bzero(&machine->mainMemory[first * PageSize], count * PageSize);
+    machine->InvalidateDecodeCache(first * PageSize, count * PageSize);
+    FindSuperPages();
+    RestoreState();			// the machine has the old table
+    DEBUG('a', "Mapped %d pages at page %d\n", count, first);
+    return first;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindSuperPages
+// 	If the TLB can hold superpages, mark each aligned run of
+//	SuperPageSize pages that can be one: all of them valid, with the
+//	same protection, in an aligned run of frames, in order.  Any other
+//	run is left (or, if it was one before, put back) as single pages,
+//	and its superpage translation, if any, taken out of the TLB.  Done
+//	whenever the page table is filled in.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::FindSuperPages()
+{
+    bool enabled = (bool)((machine->tlb != NULL)
+			  && machine->SuperPagesEnabled());
+
+    for (unsigned int first = 0; first < numPages; first += SuperPageSize) {
+	TranslationEntry *base = &pageTable[first];
+	bool promote = (bool)(enabled && (first + SuperPageSize <= numPages)
+			      && base->valid
+			      && (base->physicalPage % SuperPageSize == 0));
+	int i;
+
+	for (i = 1; promote && (i < SuperPageSize); i++)
+	    promote = (bool)(base[i].valid
+			     && (base[i].physicalPage == base->physicalPage + i)
+			     && (base[i].readOnly == base->readOnly));
+	if (!promote && base->superPage)		// demote it
+	    for (i = 0; i < machine->tlbSize; i++)
+		if (machine->tlb[i].valid && machine->tlb[i].superPage
+			&& (machine->tlb[i].virtualPage == (int) first)
+			&& (machine->tlbASID[i] == asid)) {
+		    SyncTLBEntry(&machine->tlb[i]);
+		    machine->tlb[i].valid = FALSE;
+		}
+	for (i = 0; (i < SuperPageSize) && (first + i < numPages); i++)
+	    base[i].superPage = promote;
+    }
+    machine->FlushMicroTLB();
+}
@@ -15,6 +15,8 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "profile.h"
+#include "memcache.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
 
@@ -23,6 +25,9 @@ class AddrSpace {
     AddrSpace(OpenFile *executable);	// Create an address space,
 					// initializing it with the program
 					// stored in the file "executable"
+    AddrSpace(int pages);		// Create an empty address space of
+					// "pages" pages, to be filled in
+					// from a checkpoint
     ~AddrSpace();			// De-allocate an address space
 
     void InitRegisters();		// Initialize user-level CPU registers,
@@ -31,11 +36,40 @@ class AddrSpace {
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
+    TranslationEntry *PageTableEntry(int vpn);
+					// Return the translation for virtual
+					// page "vpn", NULL if out of range
+    int NumPages() { return numPages; }	// Pages in the address space
+    void SyncTLBEntry(TranslationEntry *entry);
+					// Copy the use/dirty bits of a TLB
+					// entry back into the page table
+    int getASID() { return asid; }	// Our tag on our TLB entries
+    void FindSuperPages();		// Mark the runs of pages that can
+					// be mapped as superpages
+    int MapPages(int count);		// Add "count" zeroed pages to the
+					// end; return the first, -1 if
+					// memory is full
+    Profile *getProfile() { return profile; }
+					// Where PC samples are counted, NULL
+					// if we aren't profiling
+    bool SharesFrames() { return FALSE; }
+					// Can other spaces write any of our
+					// frames?  Never: none are shared
+
   private:
+    void PrintCacheCounts();		// Report our L1 hit rates, if we
+					// counted them
+
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    Profile *profile;			// Our profile, if profiling (it
+					// outlives us, to be printed at Halt)
+    int asid;				// our address space identifier, for
+					// the TLB; never used again
+    CacheCounts *cacheCounts;		// our accesses through the L1 cache
+					// model, NULL if it is off
 };
 
 #endif // ADDRSPACE_H
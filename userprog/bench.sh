@@ -0,0 +1,75 @@
+#!/bin/sh
+# bench.sh
+#	Measure how fast the simulator itself runs: each test program,
+#	under each way the machine has of running user code, timed on
+#	the host's wall clock.  Run by "make bench".
+#
+#	One line is printed per run, with fields separated by tabs (the
+#	first line names them), for comparing runs with other tools:
+#
+#	    program	the user program (../test/<program>.noff)
+#	    engine	interp (Machine::OneInstruction only), dc (the
+#			decoded-instruction cache), bb (basic blocks, with
+#			the cache), or bt (basic blocks and batched ticks)
+#	    wall_ms	host wall-clock time for the run, in milliseconds
+#	    total_ticks	simulated time at the end (stats->totalTicks)
+#	    user_ticks	simulated user time; one tick per instruction
+#	    mips	simulated instructions per host second, in millions
+#
+#	The runs should all end with the same user_ticks for a program;
+#	if they don't, an engine is broken, and we say so.
+#
+#	usage: bench.sh [nachos [program ...]]
+#
+# Copyright (c) 1992-1993 The Regents of the University of California.
+# All rights reserved.  See copyright.h for copyright notice and limitation
+# of liability and disclaimer of warranty provisions.
+
+nachos=${1:-./nachos}
+[ $# -gt 0 ] && shift
+programs=${*:-"halt matmult sort"}
+status=0
+
+# the time now, in milliseconds (date only has nanoseconds on some hosts)
+now() {
+    t=`date +%s%N 2>/dev/null`
+    case "$t" in
+      *N|"") echo `date +%s`000 ;;
+      *) echo `expr $t / 1000000` ;;
+    esac
+}
+
+printf "program\tengine\twall_ms\ttotal_ticks\tuser_ticks\tmips\n"
+for program in $programs; do
+    expected=
+    for engine in interp dc bb bt; do
+	case $engine in
+	  interp) flags= ;;
+	  dc) flags=-dc ;;
+	  bb) flags="-dc -bb" ;;
+	  bt) flags="-dc -bb -bt" ;;
+	esac
+	start=`now`
+	ticks=`$nachos $flags -x ../test/$program.noff </dev/null 2>&1 \
+		| sed -n 's/^Ticks: total \([0-9]*\), .*, user \([0-9]*\)$/\1 \2/p'`
+	end=`now`
+	if [ -z "$ticks" ]; then
+	    echo "bench: $program did not finish under $engine" >&2
+	    status=1
+	    continue
+	fi
+	set -- $ticks
+	printf "%s\t%s\t%d\t%d\t%d\t%s\n" $program $engine `expr $end - $start` \
+	    $1 $2 `echo "$2 $end $start" \
+		   | awk '{ ms = $2 - $3; if (ms < 1) ms = 1;
+			    printf "%.2f", $1 / ms / 1000 }'`
+	if [ -z "$expected" ]; then
+	    expected=$2
+	elif [ "$2" != "$expected" ]; then
+	    echo "bench: $program ran $2 instructions under $engine," \
+		 "not $expected" >&2
+	    status=1
+	fi
+    done
+done
+exit $status
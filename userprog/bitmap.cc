@@ -22,8 +22,18 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    numClear = numBits;
+    hint = 0;
+    numGroups = divRoundUp(numWords, GroupWords);
+    groupClear = new int[numGroups];
+    groupDirty = new bool[numGroups];
+    for (int i = 0; i < numGroups; i++) {
+	groupClear[i] = min(numBits - i * GroupWords * BitsInWord,
+			    GroupWords * BitsInWord);
+	groupDirty[i] = TRUE;		// not on disk yet
+    }
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +43,9 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
+    delete [] groupClear;
+    delete [] groupDirty;
 }
 
 //----------------------------------------------------------------------
@@ -47,7 +59,12 @@ void
 BitMap::Mark(int which) 
 { 
     ASSERT(which >= 0 && which < numBits);
+    if (!Test(which)) {
+	numClear--;
+	groupClear[which / BitsInWord / GroupWords]--;
+    }
     map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    groupDirty[which / BitsInWord / GroupWords] = TRUE;
 }
     
 //----------------------------------------------------------------------
@@ -61,7 +78,12 @@ void
 BitMap::Clear(int which) 
 {
     ASSERT(which >= 0 && which < numBits);
+    if (Test(which)) {
+	numClear++;
+	groupClear[which / BitsInWord / GroupWords]++;
+    }
     map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    groupDirty[which / BitsInWord / GroupWords] = TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -89,33 +111,121 @@ BitMap::Test(int which)
 //	(In other words, find and allocate a bit.)
 //
 //	If no bits are clear, return -1.
+//
+//	We start from the word where the last bit was found, wrapping
+//	around at the end, and skip whole groups, and then whole words,
+//	that have no clear bits.
 //----------------------------------------------------------------------
 
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    int group = hint / GroupWords;
+
+    if (numClear == 0)
+	return -1;
+    for (int n = 0; n <= numGroups; n++, group = (group + 1) % numGroups) {
+	if (groupClear[group] == 0)
+	    continue;			// the summary says it is full
+	int first = (n == 0) ? hint : group * GroupWords;
+	int last = min((group + 1) * GroupWords, numWords);
+
+	for (int word = first; word < last; word++) {
+	    unsigned int free = FreeBits(word);
+
+	    if (free != 0) {
+		int which = word * BitsInWord + __builtin_ctz(free);
+
+		hint = word;
+		Mark(which);
+		return which;
+	    }
 	}
+    }
+    ASSERT(FALSE);			// numClear said there was one
     return -1;
 }
 
 //----------------------------------------------------------------------
-// BitMap::NumClear
-// 	Return the number of clear bits in the bitmap.
-//	(In other words, how many bits are unallocated?)
+// BitMap::FindRun
+// 	Return the number of the first of "count" bits in a row that are
+//	all clear, as for allocating contiguous sectors.  As a side effect,
+//	set them.
+//
+//	If there are no such bits, return -1.
 //----------------------------------------------------------------------
 
-int 
-BitMap::NumClear() 
+int
+BitMap::FindRun(int count)
 {
-    int count = 0;
+    int start = 0, length = 0;
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
-    return count;
+    ASSERT(count > 0);
+    if (numClear < count)
+	return -1;
+    for (int i = 0; i < numBits; ) {
+	if (((i % (GroupWords * BitsInWord)) == 0)
+		&& (groupClear[i / BitsInWord / GroupWords] == 0)) {
+	    length = 0;			// skip a group with no clear bits
+	    i += GroupWords * BitsInWord;
+	    continue;
+	}
+	if (((i % BitsInWord) == 0) && (FreeBits(i / BitsInWord) == 0)) {
+	    length = 0;			// skip a word with no clear bits
+	    i += BitsInWord;
+	    continue;
+	}
+	if (Test(i))
+	    length = 0;
+	else {
+	    if (length++ == 0)
+		start = i;
+	    if (length == count) {
+		for (int j = start; j < start + count; j++)
+		    Mark(j);
+		return start;
+	    }
+	}
+	i++;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FreeBits
+// 	Return the clear bits of word "word" of the bitmap, as set bits;
+//	bits past the end of the bitmap in the last word don't count.
+//----------------------------------------------------------------------
+
+unsigned int
+BitMap::FreeBits(int word)
+{
+    unsigned int free = ~map[word];
+
+    if ((word == numWords - 1) && ((numBits % BitsInWord) != 0))
+	free &= (1U << (numBits % BitsInWord)) - 1;
+    return free;
+}
+
+//----------------------------------------------------------------------
+// BitMap::Recount
+// 	Recompute the number of clear bits, in all and in each group,
+//	after the whole bitmap has been replaced.
+//----------------------------------------------------------------------
+
+void
+BitMap::Recount()
+{
+    for (int i = 0; i < numGroups; i++)
+	groupClear[i] = 0;
+    numClear = 0;
+    for (int i = 0; i < numWords; i++) {
+	int free = __builtin_popcount(FreeBits(i));
+
+	groupClear[i / GroupWords] += free;
+	numClear += free;
+    }
+    hint = 0;
 }
 
 //----------------------------------------------------------------------
@@ -140,7 +250,8 @@ BitMap::Print()
 
 //----------------------------------------------------------------------
 // BitMap::FetchFromFile
-// 	Initialize the contents of a bitmap from a Nachos file.
+// 	Initialize the contents of a bitmap from a Nachos file.  It is
+//	then the same as the file, so no group needs writing back.
 //
 //	"file" is the place to read the bitmap from
 //----------------------------------------------------------------------
@@ -149,11 +260,16 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
+    for (int i = 0; i < numGroups; i++)
+	groupDirty[i] = FALSE;
 }
 
 //----------------------------------------------------------------------
 // BitMap::WriteBack
-// 	Store the contents of a bitmap to a Nachos file.
+// 	Store the contents of a bitmap to a Nachos file: the groups that
+//	have changed since it was read from (or written to) the file --
+//	all of them, for a new bitmap.  A group is a sector of the file.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -161,5 +277,13 @@ BitMap::FetchFrom(OpenFile *file)
 void
 BitMap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    for (int i = 0; i < numGroups; i++) {
+	if (!groupDirty[i])
+	    continue;
+	int words = min(GroupWords, numWords - i * GroupWords);
+
+	file->WriteAt((char *)&map[i * GroupWords], words * sizeof(unsigned),
+		      i * GroupWords * sizeof(unsigned));
+	groupDirty[i] = FALSE;
+    }
 }
@@ -18,10 +18,14 @@
 #include "copyright.h"
 #include "utility.h"
 #include "openfile.h"
+#include "disk.h"
 
 // Definitions helpful for representing a bitmap as an array of integers
 #define BitsInByte 	8
 #define BitsInWord 	32
+#define GroupWords	(int)(SectorSize / sizeof(unsigned int))
+					// words in a group: one sector of
+					// the file a bitmap is stored in
 
 // The following class defines a "bitmap" -- an array of bits,
 // each of which can be independently set, cleared, and tested.
@@ -30,6 +34,18 @@
 // for instance, disk sectors, or main memory pages.
 // Each bit represents whether the corresponding sector or page is
 // in use or free.
+//
+// The bits are searched a word at a time, starting from where the last
+// one was found (next fit), and the number of clear bits is kept up to
+// date as bits are set and cleared, so Find and NumClear don't have to
+// look at every bit.
+//
+// The words are also divided into groups of GroupWords, and a summary
+// keeps how many clear bits each group has, so that a search skips a
+// full group without looking at it -- on a large disk that is nearly
+// full, most of them.  The summary is only in memory (FetchFrom works
+// it out), along with which groups have changed since the bitmap was
+// last read or written: WriteBack only writes those, a sector each.
 
 class BitMap {
   public:
@@ -43,7 +59,10 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
-    int NumClear();		// Return the number of clear bits
+    int FindRun(int count);	// Return the first of "count" clear bits
+				// in a row, setting them; -1 if there
+				// are no such bits
+    int NumClear() { return numClear; }	// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
     
@@ -59,6 +78,16 @@ class BitMap {
 					//  multiple of the number of bits in
 					//  a word)
     unsigned int *map;			// bit storage
+    int numClear;			// number of bits that are clear
+    int hint;				// word where Find starts looking
+    int numGroups;			// number of groups of GroupWords words
+    int *groupClear;			// number of bits clear in each group
+    bool *groupDirty;			// has each changed since FetchFrom
+					// or WriteBack?
+
+    unsigned int FreeBits(int word);	// the clear bits in map[word]
+					// (not counting any past numBits)
+    void Recount();			// recompute numClear, and the summary
 };
 
 #endif // BITMAP_H
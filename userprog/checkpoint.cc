@@ -0,0 +1,174 @@
+// checkpoint.cc
+//	Routines to save a user program to a checkpoint, and to carry on
+//	from one.  See checkpoint.h.
+//
+//	The checkpoint is taken by an interrupt, scheduled at boot, so
+//	that the machine does not have to check for it every instruction.
+//	Interrupts are only taken between instructions, so the program's
+//	registers and memory are then as they would be in a context
+//	switch.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "addrspace.h"
+#include "checkpoint.h"
+
+static char *checkpointFile;		// where to write the checkpoint
+
+//----------------------------------------------------------------------
+// WriteCheckpoint
+// 	Save the program that is running, and the machine, to "fileName".
+//----------------------------------------------------------------------
+
+static void
+WriteCheckpoint(char *fileName)
+{
+    AddrSpace *space = currentThread->space;
+    CheckpointHeader header;
+    int registers[NumTotalRegs];
+    int fd, i;
+
+    space->SaveState();			// the TLB's use and dirty bits,
+					// into the page table
+    header.magic = CHECKPOINTMAGIC;
+    header.numPhysPages = numPhysPages;
+    header.pageSize = PageSize;
+    header.numPages = space->NumPages();
+    header.totalTicks = stats->totalTicks;
+    header.idleTicks = stats->idleTicks;
+    header.systemTicks = stats->systemTicks;
+    header.userTicks = stats->userTicks;
+    header.numDiskReads = stats->numDiskReads;
+    header.numDiskWrites = stats->numDiskWrites;
+    header.numConsoleCharsRead = stats->numConsoleCharsRead;
+    header.numConsoleCharsWritten = stats->numConsoleCharsWritten;
+    header.numPageFaults = stats->numPageFaults;
+    header.numTLBHits = stats->Total().numTLBHits;
+    header.numTLBMisses = stats->Total().numTLBMisses;
+    for (i = 0; i < NumTotalRegs; i++)
+	registers[i] = machine->ReadRegister(i);
+
+    fd = OpenForWrite(fileName);
+    WriteFile(fd, (char *) &header, sizeof(header));
+    for (i = 0; i < header.numPages; i++)
+	WriteFile(fd, (char *) space->PageTableEntry(i),
+		  sizeof(TranslationEntry));
+    WriteFile(fd, machine->mainMemory, MemorySize);
+    WriteFile(fd, (char *) registers, sizeof(registers));
+    interrupt->SavePending(fd);
+    Close(fd);
+    printf("Checkpoint written to %s, at time %d\n", fileName,
+	   stats->totalTicks);
+}
+
+//----------------------------------------------------------------------
+// CheckpointInterrupt
+// 	The interrupt handler for a checkpoint.  If the machine was
+//	running user code, save it; if it was in the kernel (in the
+//	middle of a system call, say), try again a tick later, once the
+//	program is back in user mode.
+//
+//	"dummy" is because every interrupt handler takes one argument,
+//		whether it needs it or not.
+//----------------------------------------------------------------------
+
+static void
+CheckpointInterrupt(_int dummy)
+{
+    MachineStatus status = interrupt->getInterruptedStatus();
+
+    if ((status == IdleMode) || (currentThread->space == NULL)) {
+	printf("No user program running at time %d; no checkpoint taken\n",
+	       stats->totalTicks);
+	return;
+    }
+    if (status != UserMode) {
+	interrupt->Schedule(CheckpointInterrupt, 0, 1, CheckpointInt);
+	return;
+    }
+    WriteCheckpoint(checkpointFile);
+}
+
+//----------------------------------------------------------------------
+// ScheduleCheckpoint
+// 	Arrange for the program running at time "when" to be saved to
+//	"fileName".  Called at boot, for -ckpt.
+//----------------------------------------------------------------------
+
+void
+ScheduleCheckpoint(char *fileName, int when)
+{
+    ASSERT(when > stats->totalTicks);
+    checkpointFile = fileName;
+    interrupt->Schedule(CheckpointInterrupt, 0, when - stats->totalTicks,
+			CheckpointInt);
+}
+
+//----------------------------------------------------------------------
+// RestoreProcess
+// 	Run a user program from a checkpoint, instead of from the start
+//	(cf. StartProcess): read back its address space, memory and
+//	registers, set the clock and the statistics to what they were,
+//	move the pending interrupts to when they were due, and jump to
+//	where it left off.
+//----------------------------------------------------------------------
+
+void
+RestoreProcess(char *fileName)
+{
+    int fd = OpenForReadWrite(fileName, FALSE);
+    CheckpointHeader header;
+    AddrSpace *space;
+    int registers[NumTotalRegs];
+    int bootTicks, i;
+
+    if (fd < 0) {
+	printf("Unable to open checkpoint %s\n", fileName);
+	return;
+    }
+    if ((ReadPartial(fd, (char *) &header, sizeof(header))
+		!= sizeof(header))
+	    || (header.magic != CHECKPOINTMAGIC)
+	    || (header.numPhysPages != numPhysPages)
+	    || (header.pageSize != PageSize)) {
+	printf("%s is not a checkpoint of this machine\n", fileName);
+	Close(fd);
+	return;
+    }
+
+    space = new AddrSpace(header.numPages);
+    for (i = 0; i < header.numPages; i++)
+	Read(fd, (char *) space->PageTableEntry(i), sizeof(TranslationEntry));
+    space->FindSuperPages();		// this machine may not have them
+    Read(fd, machine->mainMemory, MemorySize);
+    machine->InvalidateDecodeCache(0, MemorySize);
+    Read(fd, (char *) registers, sizeof(registers));
+    for (i = 0; i < NumTotalRegs; i++)
+	machine->WriteRegister(i, registers[i]);
+
+    bootTicks = stats->totalTicks;
+    stats->totalTicks = header.totalTicks;
+    stats->idleTicks = header.idleTicks;
+    stats->systemTicks = header.systemTicks;
+    stats->userTicks = header.userTicks;
+    stats->numDiskReads = header.numDiskReads;
+    stats->numDiskWrites = header.numDiskWrites;
+    stats->numConsoleCharsRead = header.numConsoleCharsRead;
+    stats->numConsoleCharsWritten = header.numConsoleCharsWritten;
+    stats->numPageFaults = header.numPageFaults;
+    stats->thisCPU->numTLBHits = header.numTLBHits;
+    stats->thisCPU->numTLBMisses = header.numTLBMisses;
+    interrupt->RestorePending(fd, bootTicks);
+    Close(fd);
+    DEBUG('a', "Restored %s, %d pages, at time %d\n", fileName,
+	  header.numPages, stats->totalTicks);
+
+    currentThread->space = space;
+    space->RestoreState();		// load page table register
+    machine->Run();			// carry on with the user program
+    ASSERT(FALSE);			// machine->Run never returns
+}
@@ -0,0 +1,59 @@
+// checkpoint.h
+//	Data structures for saving the state of a user program, and the
+//	simulated machine it is running on, to a host file, so that a
+//	later run of Nachos can carry on from there instead of starting
+//	the program from scratch.
+//
+//	"nachos -ckpt <ticks> <file> -x <program>" takes a checkpoint when
+//	the clock reaches <ticks> (or just after, once the program is
+//	back in user mode), and carries on.  "nachos -restore <file>"
+//	then boots, and resumes the program where the checkpoint was
+//	taken, at the same simulated time.
+//
+//	A checkpoint holds the header below; then the program's page
+//	table; all of physical memory; the CPU registers; and the
+//	interrupts that were pending, and when (see
+//	Interrupt::SavePending).  It is written in the host's byte order,
+//	to be read back by the same build of Nachos.
+//
+//	Only the state a user program can see is saved.  The kernel --
+//	its threads and their stacks -- is started afresh by the restoring
+//	run, so we only checkpoint a single program, in user mode.  The
+//	disk (with FILESYS) is already a host file, and is left as it is.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "copyright.h"
+
+#define CHECKPOINTMAGIC	0x4e43504b	// checkpoint files begin with this
+
+typedef struct checkpointHeader {
+    int magic;			// CHECKPOINTMAGIC
+    int numPhysPages;		// the machine's memory (which must match
+    int pageSize;		// that of the machine restoring it)
+    int numPages;		// the program's address space, in pages
+
+    int totalTicks;		// the statistics, when it was taken: the
+    int idleTicks;		// simulated time,
+    int systemTicks;
+    int userTicks;
+    int numDiskReads;		// and what the devices and the kernel
+    int numDiskWrites;		// had done by then
+    int numConsoleCharsRead;
+    int numConsoleCharsWritten;
+    int numPageFaults;
+    int numTLBHits;
+    int numTLBMisses;
+} CheckpointHeader;
+
+extern void ScheduleCheckpoint(char *fileName, int when);
+				// Save the program running at time "when"
+extern void RestoreProcess(char *fileName);
+				// Carry on from a checkpoint; never returns
+
+#endif // CHECKPOINT_H
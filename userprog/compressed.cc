@@ -0,0 +1,179 @@
+// compressed.cc
+//	Routines to read the pages of a compressed executable.  See
+//	compressed.h; the pages are compressed by coff2noff.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "compressed.h"
+#include "noff.h"
+
+//----------------------------------------------------------------------
+// CompressPage
+// 	Compress the PageSize bytes at "page" into "compressed", as
+//	coff2noff does (see noff.h), and return how many bytes that took.
+//	"compressed" must have room for PageSize + PageSize / 8 + 1 bytes.  Each match
+//	is the longest there is.
+//----------------------------------------------------------------------
+
+int
+CompressPage(char *page, char *compressed)
+{
+    unsigned char *in = (unsigned char *) page;
+    unsigned char *out = (unsigned char *) compressed;
+    int i = 0, o = 0, flags = 0, bit = 8;
+
+    while (i < PageSize) {
+	int best = 0, bestOffset = 0, j, n;
+
+	if (bit == 8) {			// start a new group
+	    flags = o++;
+	    out[flags] = 0;
+	    bit = 0;
+	}
+	for (j = (i > NOFFLZMAXOFFSET) ? i - NOFFLZMAXOFFSET : 0; j < i; j++) {
+	    for (n = 0; (n < NOFFLZMAXMATCH) && (i + n < PageSize)
+			&& (in[j + n] == in[i + n]); n++)
+		;
+	    if (n > best) {
+		best = n;
+		bestOffset = i - j;
+	    }
+	}
+	if (best >= NOFFLZMINMATCH) {
+	    out[flags] |= 1 << bit;
+	    out[o++] = bestOffset >> 4;
+	    out[o++] = ((bestOffset & 0xf) << 4) | (best - NOFFLZMINMATCH);
+	    i += best;
+	} else
+	    out[o++] = in[i++];
+	bit++;
+    }
+    return o;
+}
+
+//----------------------------------------------------------------------
+// Decompress
+// 	Decompress the "inSize" bytes of one page, at "in", into the
+//	PageSize bytes at "out".  A page that is PageSize bytes long
+//	was stored as it is.
+//----------------------------------------------------------------------
+
+static void
+Decompress(unsigned char *in, int inSize, unsigned char *out)
+{
+    int i = 0, o = 0, flags = 0, bit = 8;
+
+    if (inSize == PageSize) {
+	bcopy(in, out, PageSize);
+	return;
+    }
+    while ((i < inSize) && (o < PageSize)) {
+	if (bit == 8) {			// the flags for the next 8 items
+	    flags = in[i++];
+	    bit = 0;
+	    continue;
+	}
+	if (flags & (1 << bit)) {	// a match
+	    int offset, length;
+
+	    ASSERT(i + 1 < inSize);
+	    offset = (in[i] << 4) | (in[i + 1] >> 4);
+	    length = (in[i + 1] & 0xf) + NOFFLZMINMATCH;
+	    i += 2;
+	    ASSERT((offset > 0) && (offset <= o) && (o + length <= PageSize));
+	    for (; length > 0; length--, o++)
+		out[o] = out[o - offset];
+	} else				// a literal
+	    out[o++] = in[i++];
+	bit++;
+    }
+    ASSERT((i == inSize) && (o == PageSize));	// else, a corrupt file
+}
+
+//----------------------------------------------------------------------
+// DecompressPage
+// 	Decompress a page that CompressPage compressed to "size" bytes,
+//	at "compressed", into the PageSize bytes at "page".
+//----------------------------------------------------------------------
+
+void
+DecompressPage(char *compressed, int size, char *page)
+{
+    Decompress((unsigned char *) compressed, size, (unsigned char *) page);
+}
+
+//----------------------------------------------------------------------
+// CompressedImage::CompressedImage
+// 	Read the page index that follows the header of a compressed
+//	executable.  Like the header, it is in the byte order of the
+//	machine coff2noff ran on.
+//
+//	"file" -- the executable, whose header says it is compressed
+//----------------------------------------------------------------------
+
+CompressedImage::CompressedImage(OpenFile *file)
+{
+    NoffPageIndex index;
+    bool swapped;
+
+    executable = file;
+    executable->ReadAt((char *) &index, sizeof(index), sizeof(NoffHeader));
+    swapped = (bool)(index.pageSize != NOFFPAGESIZE);
+    if (swapped) {
+	index.numPages = WordToHost(index.numPages);
+	index.pageSize = WordToHost(index.pageSize);
+    }
+    ASSERT((index.pageSize == PageSize) && (index.numPages >= 0));
+
+    numPages = index.numPages;
+    offsets = new int[numPages + 1];
+    executable->ReadAt((char *) offsets, (numPages + 1) * sizeof(int),
+		       sizeof(NoffHeader) + sizeof(index));
+    for (int i = 0; i <= numPages; i++) {
+	if (swapped)
+	    offsets[i] = WordToHost(offsets[i]);
+	ASSERT((i == 0) || ((offsets[i] > offsets[i - 1])
+			    && (offsets[i] - offsets[i - 1] <= PageSize)));
+    }
+    DEBUG('a', "Compressed executable: %d pages in %d bytes\n", numPages,
+	  offsets[numPages] - offsets[0]);
+}
+
+//----------------------------------------------------------------------
+// CompressedImage::~CompressedImage
+// 	De-allocate the page index.
+//----------------------------------------------------------------------
+
+CompressedImage::~CompressedImage()
+{
+    delete [] offsets;
+}
+
+//----------------------------------------------------------------------
+// CompressedImage::ReadPages
+// 	Read pages "firstPage" to "firstPage" + "count" - 1, which are
+//	next to each other in the file, in one go; and decompress each
+//	into its PageSize bytes of "into".
+//----------------------------------------------------------------------
+
+void
+CompressedImage::ReadPages(int firstPage, int count, char *into)
+{
+    int start, size;
+    char *buffer;
+
+    ASSERT((firstPage >= 0) && (count > 0) && (firstPage + count <= numPages));
+    start = offsets[firstPage];
+    size = offsets[firstPage + count] - start;
+    buffer = new char[size];
+    ASSERT(executable->ReadAt(buffer, size, start) == size);
+    for (int p = firstPage; p < firstPage + count; p++)
+	Decompress((unsigned char *) &buffer[offsets[p] - start],
+		   offsets[p + 1] - offsets[p],
+		   (unsigned char *) &into[(p - firstPage) * PageSize]);
+    delete [] buffer;
+}
@@ -0,0 +1,60 @@
+// compressed.h
+//	Data structures for reading a compressed executable: a NOFF file
+//	made by "coff2noff -z", whose pages of code and data are each
+//	compressed on their own (see noff.h for the format).
+//
+//	Such a file takes fewer sectors of the disk, and reading a page
+//	of it reads fewer sectors; decompressing it costs host time, but
+//	no simulated time.  Since every page can be decompressed by
+//	itself, a program can still be brought in a page at a time, on
+//	demand.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef COMPRESSED_H
+#define COMPRESSED_H
+
+#include "copyright.h"
+#include "openfile.h"
+
+// The following class defines the page index of a compressed
+// executable, which says where each compressed page is in the file.
+
+class CompressedImage {
+  public:
+    CompressedImage(OpenFile *executable);
+				// Read the page index of "executable", whose
+				// header says it is compressed
+    ~CompressedImage();
+
+    int NumPages() { return numPages; }
+				// Pages of code and data, from virtual
+				// page 0 on
+    void ReadPages(int firstPage, int count, char *into);
+				// Read "count" pages, from "firstPage" on,
+				// with one read of the file, and decompress
+				// them into "into"
+    void ReadPage(int page, char *into) { ReadPages(page, 1, into); }
+    int EndOfPages() { return offsets[numPages]; }
+				// Where the pages end in the file (and the
+				// symbol table, if any, begins)
+
+  private:
+    OpenFile *executable;	// the file (which we don't close)
+    int numPages;		// the pages in it, and where each
+    int *offsets;		// begins; offsets[numPages] is where the
+				// last one ends
+};
+
+// Compressing a single page, in memory, the same way (for the
+// compressed swap cache, see ../lab7/swapcache.h).
+
+int CompressPage(char *page, char *compressed);
+				// compress the PageSize bytes at "page";
+				// return how many bytes it took
+void DecompressPage(char *compressed, int size, char *page);
+				// and back again
+
+#endif // COMPRESSED_H
@@ -4,8 +4,8 @@
 //	transfer back to here from user code:
 //
 //	syscall -- The user code explicitly requests to call a procedure
-//	in the Nachos kernel.  Right now, the only function we support is
-//	"Halt".
+//	in the Nachos kernel.  Right now, the only functions we support are
+//	"Halt", and, with the network, "NetDoorbell".
 //
 //	exceptions -- The user code does something that the CPU can't handle.
 //	For instance, accessing memory that doesn't exist, arithmetic errors,
@@ -14,7 +14,7 @@
 //	Interrupts (which can also cause control to transfer from user
 //	code into the Nachos kernel) are handled elsewhere.
 //
-// For now, this only handles the Halt() system call.
+// For now, this only handles the Halt() and NetDoorbell() system calls.
 // Everything else core dumps.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -24,6 +24,101 @@
 #include "copyright.h"
 #include "system.h"
 #include "syscall.h"
+#ifdef NETWORK
+#include "netring.h"
+#endif
+
+//----------------------------------------------------------------------
+// RefillTLB
+// 	Handle a TLB miss on the virtual address "badVAddr", by loading
+//	the translation from the current address space's page table into
+//	the slot the hardware picks, tagged with its ASID, and saving the
+//	bits of the entry being replaced if it is ours (another address
+//	space's bits were saved when it last gave up the CPU).  When we
+//	return, the faulting instruction is re-run.
+//
+//	Since every page of a user program is loaded in advance, a miss
+//	on a page that is not in the page table is a program error.
+//
+//	A page marked as part of a superpage (see FindSuperPages) is
+//	loaded as the whole superpage, in one entry.
+//----------------------------------------------------------------------
+
+static void
+RefillTLB(int badVAddr)
+{
+    int vpn = (unsigned) badVAddr / PageSize;
+    TranslationEntry *pte = currentThread->space->PageTableEntry(vpn);
+    TranslationEntry *slot;
+
+    if ((pte == NULL) || !pte->valid) {
+	printf("Invalid user address 0x%x\n", badVAddr);
+	ASSERT(FALSE);
+    }
+    if (pte->superPage)				// load its first page,
+	pte = currentThread->space->PageTableEntry(vpn & ~(SuperPageSize - 1));
+    slot = machine->TLBVictim(vpn, pte->superPage);	// as a superpage
+    if (slot->valid
+	    && (machine->tlbASID[slot - machine->tlb] == machine->asid))
+	currentThread->space->SyncTLBEntry(slot);
+    *slot = *pte;
+    machine->tlbASID[slot - machine->tlb] = currentThread->space->getASID();
+    DEBUG('a', "TLB refill: virtual page %d -> frame %d\n", vpn,
+	  pte->physicalPage);
+}
+
+#ifdef NETWORK
+//----------------------------------------------------------------------
+// AdvancePC
+// 	Move the PC past the syscall instruction, so that we return to the
+//	instruction after it.
+//----------------------------------------------------------------------
+
+static void
+AdvancePC()
+{
+    machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+    machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+    machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg) + 4);
+}
+
+static int ringBox = -1;		// the box whose rings are mapped, if
+static int ringAddr;			// any, and where (only one program
+					// runs at a time)
+
+//----------------------------------------------------------------------
+// RingDoorbell
+// 	The NetDoorbell system call: send the messages the program has put
+//	in the transmit ring of mailbox "box", and, if "wait", wait for one
+//	in its receive ring (see netring.h).  The first call maps the box's
+//	rings into the address space, in pages added after the stack.
+//	Returns the virtual address of the rings, or 0 if they could not
+//	be mapped.
+//----------------------------------------------------------------------
+
+static int
+RingDoorbell(int box, int wait)
+{
+    if (ringBox < 0) {
+	AddrSpace *space = currentThread->space;
+	int first;
+
+	if ((box < 0) || (box >= postOffice->NumBoxes())
+		|| ((first = space->MapPages(NetRingPages)) < 0))
+	    return 0;
+	if (!postOffice->MapRings(box,
+			space->PageTableEntry(first)->physicalPage)) {
+	    DEBUG('n', "Mailbox %d cannot be mapped\n", box);
+	    return 0;			// the pages stay, unused
+	}
+	ringBox = box;
+	ringAddr = first * PageSize;
+    } else if (box != ringBox)
+	return 0;
+    postOffice->Doorbell(box, wait != 0);
+    return ringAddr;
+}
+#endif
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -55,7 +150,18 @@ ExceptionHandler(ExceptionType which)
 
     if ((which == SyscallException) && (type == SC_Halt)) {
 	DEBUG('a', "Shutdown, initiated by user program.\n");
+#ifdef FILESYS
+	synchDisk->Sync();		// don't lose what is only cached
+#endif
    	interrupt->Halt();
+#ifdef NETWORK
+    } else if ((which == SyscallException) && (type == SC_NetDoorbell)) {
+	machine->WriteRegister(2, RingDoorbell(machine->ReadRegister(4),
+					       machine->ReadRegister(5)));
+	AdvancePC();
+#endif
+    } else if ((which == PageFaultException) && (machine->tlb != NULL)) {
+	RefillTLB(machine->ReadRegister(BadVAddrReg));
     } else {
 	printf("Unexpected user mode exception %d %d\n", which, type);
 	ASSERT(FALSE);
@@ -0,0 +1,274 @@
+// profile.cc
+//	Routines for the sampling profiler of user programs.  See
+//	profile.h.
+//
+//	Counting a sample is just an increment; working out which
+//	procedure each instruction is in, and sorting, is left until the
+//	profile is printed.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "profile.h"
+#include "compressed.h"
+
+static Profile *firstProfile = NULL;	// every profile, in the order
+static Profile *lastProfile = NULL;	// they were made
+static int numProfiles = 0;
+
+//----------------------------------------------------------------------
+// ProfileSample
+// 	Called by the machine every time it samples the PC (see
+//	Machine::Run): count the sample in the profile of the address
+//	space that is running, if it has one.
+//----------------------------------------------------------------------
+
+void
+ProfileSample(int pc)
+{
+    if ((currentThread->space != NULL)
+	    && (currentThread->space->getProfile() != NULL))
+	currentThread->space->getProfile()->Sample(pc);
+}
+
+//----------------------------------------------------------------------
+// PrintProfiles
+// 	Print every profile made, at Halt.
+//----------------------------------------------------------------------
+
+void
+PrintProfiles()
+{
+    for (Profile *p = firstProfile; p != NULL; p = p->next)
+	p->Print();
+}
+
+//----------------------------------------------------------------------
+// Profile::Profile
+// 	Make an empty profile for a program, and put it on the list
+//	of those to print at Halt.
+//
+//	"programName" -- what to call the program (NULL: just number it)
+//	"executable" -- the NOFF file the program was loaded from, for its
+//		symbol table
+//	"noffH" -- the header of that file
+//----------------------------------------------------------------------
+
+Profile::Profile(char *programName, OpenFile *executable, NoffHeader *noffH)
+{
+    numProfiles++;
+    if (programName == NULL) {
+	name = new char[32];
+	sprintf(name, "address space %d", numProfiles);
+    } else {
+	name = new char[strlen(programName) + 1];
+	strcpy(name, programName);
+    }
+    codeStart = noffH->code.virtualAddr;
+    codeSize = noffH->code.size;
+    counts = new int[divRoundUp(codeSize, 4)];
+    for (int i = 0; i < divRoundUp(codeSize, 4); i++)
+	counts[i] = 0;
+    numSamples = numOutside = 0;
+    ReadSymbols(executable, noffH);
+
+    next = NULL;
+    if (lastProfile == NULL)
+	firstProfile = this;
+    else
+	lastProfile->next = this;
+    lastProfile = this;
+}
+
+//----------------------------------------------------------------------
+// Profile::~Profile
+// 	De-allocate a profile.
+//----------------------------------------------------------------------
+
+Profile::~Profile()
+{
+    delete [] name;
+    delete [] counts;
+    delete [] symbols;
+    delete [] symbolNames;
+}
+
+//----------------------------------------------------------------------
+// Profile::ReadSymbols
+// 	Read in the symbol table that follows the segments of a NOFF file,
+//	if it has one.  It is written in the byte order of the machine
+//	coff2noff ran on, like the header.  In a compressed file, it
+//	follows the compressed pages instead.
+//----------------------------------------------------------------------
+
+void
+Profile::ReadSymbols(OpenFile *executable, NoffHeader *noffH)
+{
+    NoffSymbolHeader symH;
+    int where = sizeof(NoffHeader);
+    bool swapped;
+    int i;
+
+    numSymbols = 0;
+    symbols = NULL;
+    symbolNames = NULL;
+    if (noffH->noffMagic == NOFFLZMAGIC)
+	where = CompressedImage(executable).EndOfPages();
+    else {
+	if (noffH->code.size > 0)
+	    where = max(where, noffH->code.inFileAddr + noffH->code.size);
+	if (noffH->initData.size > 0)
+	    where = max(where,
+			noffH->initData.inFileAddr + noffH->initData.size);
+    }
+
+    if (executable->ReadAt((char *) &symH, sizeof(symH), where)
+	    != sizeof(symH))
+	return;				// no symbol table
+    swapped = (bool)(symH.symMagic != NOFFSYMMAGIC);
+    if (swapped) {
+	if (WordToHost(symH.symMagic) != NOFFSYMMAGIC)
+	    return;			// something else
+	symH.numSymbols = WordToHost(symH.numSymbols);
+	symH.stringSize = WordToHost(symH.stringSize);
+    }
+    if ((symH.numSymbols <= 0) || (symH.stringSize <= 0))
+	return;
+
+    where += sizeof(symH);
+    symbols = new NoffSymbol[symH.numSymbols];
+    symbolNames = new char[symH.stringSize + 1];
+    if ((executable->ReadAt((char *) symbols,
+			    symH.numSymbols * sizeof(NoffSymbol), where)
+	    != (int) (symH.numSymbols * sizeof(NoffSymbol)))
+	|| (executable->ReadAt(symbolNames, symH.stringSize,
+			       where + symH.numSymbols * sizeof(NoffSymbol))
+	    != symH.stringSize)) {
+	delete [] symbols;		// cut short
+	delete [] symbolNames;
+	symbols = NULL;
+	symbolNames = NULL;
+	return;
+    }
+    symbolNames[symH.stringSize] = '\0';
+    for (i = 0; i < symH.numSymbols; i++) {
+	if (swapped) {
+	    symbols[i].value = WordToHost(symbols[i].value);
+	    symbols[i].name = WordToHost(symbols[i].name);
+	}
+	if ((symbols[i].name < 0) || (symbols[i].name >= symH.stringSize))
+	    symbols[i].name = symH.stringSize;	// the empty string
+    }
+    numSymbols = symH.numSymbols;
+    DEBUG('a', "Profile of %s: %d symbols\n", name, numSymbols);
+}
+
+//----------------------------------------------------------------------
+// Profile::Sample
+// 	Count a sample of the PC.
+//----------------------------------------------------------------------
+
+void
+Profile::Sample(int pc)
+{
+    numSamples++;
+    if ((pc >= codeStart) && (pc < codeStart + codeSize))
+	counts[(pc - codeStart) / 4]++;
+    else
+	numOutside++;
+}
+
+//----------------------------------------------------------------------
+// Profile::FindSymbol
+// 	Return the procedure containing "pc": the last one that starts at
+//	or before it (the symbols are sorted by address).  -1 if there is
+//	none.
+//----------------------------------------------------------------------
+
+int
+Profile::FindSymbol(int pc)
+{
+    int low = 0, high = numSymbols - 1, found = -1;
+
+    while (low <= high) {
+	int middle = (low + high) / 2;
+
+	if (symbols[middle].value <= pc) {
+	    found = middle;
+	    low = middle + 1;
+	} else
+	    high = middle - 1;
+    }
+    return found;
+}
+
+//----------------------------------------------------------------------
+// Profile::Print
+// 	Print where the samples were: if we know the procedures, how
+//	many were in each, most first; and then the ProfileHotSpots
+//	instructions with the most.
+//----------------------------------------------------------------------
+
+void
+Profile::Print()
+{
+    int numWords = divRoundUp(codeSize, 4);
+    int *left, best, i, n;
+
+    printf("Profile of %s: %d samples, %d outside the code\n", name,
+	   numSamples, numOutside);
+    if (numSamples == numOutside)
+	return;
+
+    if (numSymbols > 0) {
+	left = new int[numSymbols + 1];	// the last is for code before
+	for (i = 0; i <= numSymbols; i++)	// the first procedure
+	    left[i] = 0;
+	for (i = 0; i < numWords; i++)
+	    if (counts[i] > 0) {
+		int s = FindSymbol(codeStart + i * 4);
+
+		left[(s < 0) ? numSymbols : s] += counts[i];
+	    }
+	for (;;) {
+	    best = -1;
+	    for (i = 0; i <= numSymbols; i++)
+		if ((left[i] > 0) && ((best < 0) || (left[i] > left[best])))
+		    best = i;
+	    if (best < 0)
+		break;
+	    printf("  %5.1f%% %8d  %s\n", 100.0 * left[best] / numSamples,
+		   left[best], (best == numSymbols) ? "(unknown)"
+		   : &symbolNames[symbols[best].name]);
+	    left[best] = 0;
+	}
+	delete [] left;
+    }
+
+    printf("  Hottest instructions:\n");
+    left = new int[numWords];
+    for (i = 0; i < numWords; i++)
+	left[i] = counts[i];
+    for (n = 0; n < ProfileHotSpots; n++) {
+	best = -1;
+	for (i = 0; i < numWords; i++)
+	    if ((left[i] > 0) && ((best < 0) || (left[i] > left[best])))
+		best = i;
+	if (best < 0)
+	    break;
+	int pc = codeStart + best * 4;
+	int s = FindSymbol(pc);
+
+	printf("  %5.1f%% %8d  0x%x", 100.0 * left[best] / numSamples,
+	       left[best], pc);
+	if (s >= 0)
+	    printf(" (%s+0x%x)", &symbolNames[symbols[s].name],
+		   pc - symbols[s].value);
+	printf("\n");
+	left[best] = 0;
+    }
+    delete [] left;
+}
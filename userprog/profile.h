@@ -0,0 +1,63 @@
+// profile.h
+//	Data structures for a sampling profiler of user programs.
+//
+//	When profiling is on (see Machine::SetProfiling), the machine
+//	samples the PC every so many ticks of user time, and each sample
+//	is counted in the profile of the address space that is running:
+//	a histogram with a bucket for each instruction in its code.
+//
+//	If the program's NOFF file has a symbol table (coff2noff keeps
+//	one, see noff.h), the profile also says which procedure each
+//	sample was in.  At Halt, every profile is printed: the time spent
+//	in each procedure, and the hottest instructions.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "openfile.h"
+#include "noff.h"
+
+#define ProfileHotSpots	10	// instructions listed in a profile
+
+// The following class defines the profile of one address space.
+// Profiles last until they are printed, at Halt, even after their
+// address spaces are gone.
+
+class Profile {
+  public:
+    Profile(char *programName, OpenFile *executable, NoffHeader *noffH);
+				// An empty profile of the program in
+				// "executable"; "programName" may be NULL
+    ~Profile();
+
+    void Sample(int pc);	// Count a sample of the PC
+    void Print();		// Print where the samples were
+
+    Profile *next;		// the next profile, in the order they
+				// were made (see PrintProfiles)
+
+  private:
+    char *name;			// what to call the program
+    int codeStart;		// where the code is, in the address space,
+    int codeSize;		// and how big (in bytes)
+    int *counts;		// samples of each instruction in it
+    int numSamples;		// all the samples
+    int numOutside;		// ... of which, those not in the code
+
+    int numSymbols;		// the procedures in the code, by address,
+    NoffSymbol *symbols;	// and their names (none if the file had
+    char *symbolNames;		// no symbol table)
+
+    void ReadSymbols(OpenFile *executable, NoffHeader *noffH);
+				// Read in the symbol table, if there is one
+    int FindSymbol(int pc);	// The procedure "pc" is in, or -1
+};
+
+extern void PrintProfiles();	// Print every profile, at Halt
+
+#endif // PROFILE_H
@@ -0,0 +1,239 @@
+// synchconsole.cc
+//	Routines to synchronously access the console.  The console device
+//	is asynchronous: PutChar returns at once, with an interrupt when
+//	the character is out, and an interrupt announces each character
+//	typed.  This is a layer on top of it, in which a thread waits for
+//	those interrupts, as SynchDisk does for the disk.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "synchconsole.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// ConsoleReadAvail, ConsoleWriteDone
+// 	Console interrupt handlers.  Need these to be C routines, because
+//	C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+ConsoleReadAvail(_int arg)
+{
+    ((SynchConsole *)arg)->ReadAvail();
+}
+
+static void
+ConsoleWriteDone(_int arg)
+{
+    ((SynchConsole *)arg)->WriteDone();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::SynchConsole
+// 	Initialize the synchronous interface to the console, in turn
+//	initializing the console device.
+//
+//	"readFile" -- UNIX file simulating the keyboard (NULL -> use stdin)
+//	"writeFile" -- UNIX file simulating the display (NULL -> use stdout)
+//----------------------------------------------------------------------
+
+SynchConsole::SynchConsole(char *readFile, char *writeFile)
+{
+    readAvail = new Semaphore("console read avail", 0);
+    writeDone = new Semaphore("console write done", 0);
+    readLock = new Lock("console read lock");
+    writeLock = new Lock("console write lock");
+    inHead = inCount = 0;
+    inStalled = FALSE;
+    outHead = outCount = outReady = outBusy = 0;
+    console = new Console(readFile, writeFile, ConsoleReadAvail,
+			  ConsoleWriteDone, (_int) this);
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::~SynchConsole
+// 	De-allocate data structures needed for the synchronous console
+//	abstraction.
+//----------------------------------------------------------------------
+
+SynchConsole::~SynchConsole()
+{
+    delete console;
+    delete readLock;
+    delete writeLock;
+    delete readAvail;
+    delete writeDone;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Write
+// 	Output characters to the display.  They are put in the output
+//	ring, and given to the device, as one request, at the end of each
+//	line (or whenever the ring fills up).  We only wait if there is
+//	no room left in the ring.
+//
+//	"from" -- the characters to output
+//	"numBytes" -- how many there are
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Write(char *from, int numBytes)
+{
+    IntStatus oldLevel;
+
+    writeLock->Acquire();
+    oldLevel = interrupt->SetLevel(IntOff);
+    for (int i = 0; i < numBytes; i++) {
+	while (outCount == ConsoleBufferSize) {	// full, so send what
+	    outReady = outCount;		// there is, and wait for
+	    StartOutput();			// some of it to be done
+	    writeDone->P();
+	}
+	outBuf[(outHead + outCount++) % ConsoleBufferSize] = from[i];
+	if (from[i] == '\n') {
+	    outReady = outCount;
+	    StartOutput();
+	}
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    writeLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::PutString
+// 	Output a null-terminated string to the display, as Write does.
+//
+//	"from" -- the string
+//----------------------------------------------------------------------
+
+void
+SynchConsole::PutString(char *from)
+{
+    Write(from, strlen(from));
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Flush
+// 	Put whatever has been written, and is still in the ring (the
+//	start of a line, say), on the display, and wait until it is.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Flush()
+{
+    IntStatus oldLevel;
+
+    writeLock->Acquire();
+    oldLevel = interrupt->SetLevel(IntOff);
+    outReady = outCount;
+    StartOutput();
+    while (outCount > 0)
+	writeDone->P();
+    (void) interrupt->SetLevel(oldLevel);
+    writeLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::StartOutput
+// 	If the device is free, give it as much of the output that is
+//	ready to go as is in one piece in the ring.  Called with
+//	interrupts off.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::StartOutput()
+{
+    if ((outBusy > 0) || (outReady == 0))
+	return;
+    outBusy = min(outReady, ConsoleBufferSize - outHead);
+    console->PutChars(&outBuf[outHead], outBusy);
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Read
+// 	Read characters typed on the keyboard, waiting for each to be
+//	typed, up to the end of a line (the newline is returned too), or
+//	until "numBytes" have been read.  Returns how many were read.
+//	Characters typed before we were called are already in the input
+//	ring, so we only wait if it runs out.
+//
+//	Anything written but not yet on the display (a prompt, say) is
+//	put there first.
+//
+//	"into" -- the buffer to put the characters in
+//	"numBytes" -- the most to read
+//----------------------------------------------------------------------
+
+int
+SynchConsole::Read(char *into, int numBytes)
+{
+    int numRead = 0;
+    IntStatus oldLevel;
+
+    Flush();
+    readLock->Acquire();
+    while (numRead < numBytes) {
+	readAvail->P();			// wait for a character
+	oldLevel = interrupt->SetLevel(IntOff);
+	ASSERT(inCount > 0);
+	into[numRead] = inBuf[inHead];
+	inHead = (inHead + 1) % ConsoleBufferSize;
+	inCount--;
+	if (inStalled) {		// there's room for it now
+	    inStalled = FALSE;
+	    TakeChar();
+	}
+	(void) interrupt->SetLevel(oldLevel);
+	if (into[numRead++] == '\n')
+	    break;
+    }
+    readLock->Release();
+    return numRead;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::TakeChar
+// 	Move the character the device has just had typed into the input
+//	ring, if there is room for it; if not, leave it in the device
+//	(which can't then take in any more) until there is.  Called with
+//	interrupts off.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::TakeChar()
+{
+    if (inCount == ConsoleBufferSize) {
+	inStalled = TRUE;
+	return;
+    }
+    inBuf[(inHead + inCount++) % ConsoleBufferSize] = console->GetChar();
+    readAvail->V();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::ReadAvail, SynchConsole::WriteDone
+// 	Console interrupt handlers: take in a character that was typed,
+//	waking up a thread waiting for one; or let go of the characters
+//	just output, start on the next, and wake up a thread waiting for
+//	room.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::ReadAvail()
+{
+    TakeChar();
+}
+
+void
+SynchConsole::WriteDone()
+{
+    outHead = (outHead + outBusy) % ConsoleBufferSize;
+    outCount -= outBusy;
+    outReady -= outBusy;
+    outBusy = 0;
+    StartOutput();
+    writeDone->V();
+}
@@ -0,0 +1,77 @@
+// synchconsole.h
+//	Data structures to export a synchronous interface to the console
+//	device, for the Read and Write system calls on ConsoleInput and
+//	ConsoleOutput.
+//
+//	As with the disk, the raw console is asynchronous: a request to
+//	output a character returns at once, and an interrupt says when it
+//	is done; a character typed on the keyboard is announced by an
+//	interrupt.  This layer makes a thread wait for those interrupts,
+//	and lets only one thread read, and one thread write, at a time.
+//
+//	Both directions go through a ring buffer, so that a thread only
+//	has to wait when there is no input typed yet, or no room for its
+//	output.  Output is buffered a line at a time: the characters
+//	written go out together, as one request to the device, at the end
+//	of each line, when the ring fills up, or on Flush.  Input is taken
+//	off the device as it is typed, whether or not anyone is reading.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SYNCHCONSOLE_H
+#define SYNCHCONSOLE_H
+
+#include "console.h"
+#include "synch.h"
+
+#define ConsoleBufferSize	128	// characters buffered, each way
+
+// The following class defines a "synchronous" console abstraction.
+
+class SynchConsole {
+  public:
+    SynchConsole(char *readFile, char *writeFile);
+					// Initialize the console; NULL
+					// means use stdin/stdout
+    ~SynchConsole();
+
+    void Write(char *from, int numBytes);
+					// Output the characters, waiting
+					// only for room for them
+    void PutString(char *from);		// Write a null-terminated string
+    void Flush();			// Wait until all that has been
+					// written is on the display
+    int Read(char *into, int numBytes);	// Wait for a line, or "numBytes"
+					// characters, whichever is less;
+					// return how many were read
+
+    void ReadAvail();			// Called by the console interrupt
+    void WriteDone();			// handlers
+
+  private:
+    Console *console;			// the raw console device
+    Semaphore *readAvail;		// to wait for a character to be
+    Semaphore *writeDone;		// typed, or to be output
+    Lock *readLock;			// only one read, and one write,
+    Lock *writeLock;			// at a time
+
+    // the rings are shared with the interrupt handlers, so they are
+    // only touched with interrupts off
+    char inBuf[ConsoleBufferSize];	// typed, not yet read
+    int inHead, inCount;
+    bool inStalled;			// a character is waiting in the
+					// device, for room in inBuf
+    char outBuf[ConsoleBufferSize];	// written, not yet on the display:
+    int outHead, outCount;		// from outHead, "outReady" of them
+    int outReady, outBusy;		// can go out, and "outBusy" are on
+					// their way
+
+    void TakeChar();			// Move a typed character to inBuf
+    void StartOutput();			// Give the device what is ready
+};
+
+#endif // SYNCHCONSOLE_H
@@ -29,6 +29,21 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_ReadV	11
+#define SC_WriteV	12
+#define SC_Mmap		13
+#define SC_Munmap	14
+#define SC_ThreadCreate	15
+#define SC_ShmCreate	16
+#define SC_ShmAttach	17
+#define SC_ShmDetach	18
+#define SC_Pipe		19
+#define SC_RingEnter	20
+#define SC_Sbrk		21
+#define SC_SetAffinity	22
+#define SC_Memcpy	23
+#define SC_Memset	24
+#define SC_NetDoorbell	25
 
 #ifndef IN_ASM
 
@@ -55,9 +70,11 @@ void Exit(int status);
 typedef int SpaceId;	
  
 /* Run the executable, stored in the Nachos file "name", and return the 
- * address space identifier
+ * address space identifier.  "argv" is a NULL-terminated array of
+ * argument strings (or NULL, for none), copied onto the new program's
+ * stack and passed to its main(argc, argv).
  */
-SpaceId Exec(char *name);
+SpaceId Exec(char *name, char **argv);
  
 /* Only return once the the user program "id" has finished.  
  * Return the exit status.
@@ -108,22 +125,192 @@ int Read(char *buffer, int size, OpenFileId id);
 /* Close the file, we're done reading and writing to it. */
 void Close(OpenFileId id);
 
+/* One of the buffers for ReadV or WriteV. */
+typedef struct {
+    char *buffer;
+    int size;
+} IoVec;
+
+/* At most this many buffers can be passed to ReadV or WriteV. */
+#define MaxIoVecs	16
+
+/* Read into the "count" buffers in "vec", filling each in turn, as one
+ * Read of their total size would.  Return the number of bytes read.
+ */
+int ReadV(IoVec *vec, int count, OpenFileId id);
+
+/* Write the "count" buffers in "vec", one after the other, with a single
+ * system call.  Return the number of bytes written.  A program writing
+ * many small records can collect them in a vector and write them all
+ * at once, paying for one trap instead of one per record.
+ */
+int WriteV(IoVec *vec, int count, OpenFileId id);
+
+/* Map the whole of the open file "id" into the address space, and return
+ * the address it starts at (or -1).  Loads and stores there read and
+ * write the file: pages are read in when first touched, and the ones
+ * changed are written back when they are evicted, or by Munmap.  The file
+ * does not grow.  Closing "id" does not unmap it.
+ */
+char *Mmap(OpenFileId id);
+
+/* Unmap the file mapped at "addr", writing back what changed. */
+int Munmap(char *addr);
+
+/* Shared memory: memory that several processes map at once, to pass
+ * data to each other with no Read or Write, and no copying.
+ *
+ * ShmCreate makes a segment of "size" bytes, all zero, and returns its
+ * identifier, a small integer, or -1.  ShmAttach maps segment "id" into
+ * the address space, and returns the address it starts at (or -1);
+ * ShmDetach unmaps the segment attached at "addr" (returning 0, or -1).
+ * A segment lasts until the last process attached to it detaches it,
+ * or exits.
+ */
+int ShmCreate(int size);
+char *ShmAttach(int id);
+int ShmDetach(char *addr);
+
+/* Make a pipe: a stream of bytes, from whoever writes ends[1] to whoever
+ * reads ends[0], through a buffer in the kernel.  Returns 0, or -1.
+ * The ends are OpenFileIds, read, written and closed like files; Fork
+ * and Exec pass them on, as the same ids, so that processes can be
+ * connected in a pipeline.  Read returns what the pipe holds (waiting
+ * for at least a byte), and 0 once it is empty and every write end is
+ * closed; Write waits while the pipe is full, and fails once every
+ * read end is closed.
+ */
+int Pipe(OpenFileId *ends);
+
+/* A ring of system call requests, and of their completions, in the
+ * program's own memory, to do many Opens, Reads, Writes and Closes for
+ * the cost of one trap.  The program queues requests at req[reqTail %
+ * RingEntries], moving reqTail on, and calls RingEnter; the kernel does
+ * them in order -- each as the call named by "op" (SC_Read, say) would,
+ * with its arguments in arg1, arg2 and arg3 -- and posts a completion
+ * for each, with the same "tag" and the call's result, at done[doneTail %
+ * RingEntries], moving reqHead and doneTail on.  It stops when there is
+ * no room for completions: the program takes them from doneHead on,
+ * moving it up to doneTail.  RingEnter returns how many requests were
+ * done (or -1, if the ring can't be read or written).
+ */
+#define RingEntries	16
+
+typedef struct {
+    int op;			/* SC_Open, SC_Read, SC_Write or SC_Close */
+    int arg1, arg2, arg3;	/* its arguments, in order */
+    int tag;			/* anything, passed back in the completion */
+} RingRequest;
+
+typedef struct {
+    int tag;			/* the request's */
+    int result;			/* what the call returned */
+} RingCompletion;
+
+typedef struct {
+    int reqHead, reqTail;	/* requests queued, from reqHead on */
+    int doneHead, doneTail;	/* completions posted, from doneHead on */
+    RingRequest req[RingEntries];
+    RingCompletion done[RingEntries];
+} SyscallRing;
+
+int RingEnter(SyscallRing *ring);
+
+/* Move the end of the heap -- memory just past the stack, empty to
+ * begin with -- on by "increment" bytes (back, if it is negative), and
+ * return where it ended before: with a positive "increment", the start
+ * of the new memory.  Returns (char *) -1 if the heap would shrink to
+ * less than nothing, or grow too big.  The new memory reads as zero;
+ * its pages are only allocated when first touched.
+ */
+char *Sbrk(int increment);
+
 
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 
  */
 
-/* Fork a thread to run a procedure ("func") in the *same* address space 
- * as the current thread.
+/* Fork a new process, running in a copy of the current address space
+ * (shared copy-on-write, so that Fork followed by Exec copies nothing).
+ * Returns the child's SpaceId to the caller, and 0 to the child -- or,
+ * if "func" is not NULL, the child calls "func" instead of returning.
  */
-void Fork(void (*func)());
+SpaceId Fork(void (*func)());
 
 /* Yield the CPU to another runnable thread, whether in this address space 
  * or not. 
  */
 void Yield();		
 
+/* Start a new thread in the current address space, calling func(arg) on
+ * a stack of its own; when "func" returns, the thread calls Exit(0).
+ * The threads share all of memory but their stacks, and so are much
+ * cheaper than processes.  Exit ends only the thread that calls it;
+ * the process exits when its last thread does, with the status its
+ * first thread gave.  Returns 0, or -1 if the address space has too many
+ * threads.
+ */
+int ThreadCreate(void (*func)(int), int arg);
+
+/* Restrict the calling thread to the simulated CPUs in "mask" -- bit c
+ * set if it may run on CPU c -- or, if "mask" is 0, let it run on any.
+ * If it is not on one of them now, it moves at once.  Returns the mask
+ * it had before, or -1 (changing nothing) if "mask" names none of the
+ * CPUs there are.
+ */
+int SetAffinity(int mask);
+
+/* Copy "size" bytes from "from" to "to", or set "size" bytes at "to" to
+ * the byte "c", as the C library's memcpy and memset would, but in the
+ * kernel, at far less than the cost of a loop of loads and stores.
+ * The ranges given to Memcpy must not overlap.  Returns 0, or -1 if
+ * part of either range is not a valid address (or, for Memcpy, if
+ * they overlap), in which case only the part before it was written.
+ */
+int Memcpy(char *to, char *from, int size);
+int Memset(char *to, int c, int size);
+
+/* Networking without the kernel in the way of each message: a mailbox's
+ * messages are put by the kernel straight into a receive ring in the
+ * program's own memory, as they come in, and the program puts those it
+ * sends in a transmit ring beside it.  Each ring is read at "head" and
+ * written at "tail", counts of the slots ever taken out and put in; the
+ * reader moves only the head, and the writer only the tail, so neither
+ * needs a lock.  A slot is free to be written once the head has passed
+ * it.
+ */
+#define NetRingSlots	8	/* messages a ring holds */
+#define NetSlotData	40	/* bytes of data a message can have */
+
+typedef struct {
+    int machine;		/* receive: who sent it; transmit: who for */
+    int box;			/* receive: the box to reply to; transmit:
+				 * the box it is for */
+    int length;			/* bytes of data */
+    char data[NetSlotData];
+} NetSlot;
+
+typedef struct {
+    int head;			/* slots taken out, by the reader */
+    int tail;			/* slots put in, by the writer */
+    NetSlot slot[NetRingSlots];	/* message n is in slot[n % NetRingSlots] */
+} NetRing;
+
+typedef struct {
+    NetRing rx;			/* messages that have come in */
+    NetRing tx;			/* messages to go out */
+} NetRings;
+
+/* Ring the doorbell of mailbox "box": send the messages put in its
+ * transmit ring, and, if "wait" is non-zero, wait until its receive
+ * ring has a message in it.  The first call maps the box's rings into
+ * the address space.  Returns where they are, or 0 if they could not
+ * be mapped (the box is not a valid one, there is no memory left for
+ * them, or another box's are mapped already).
+ */
+NetRings *NetDoorbell(int box, int wait);
+
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */